@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+/*====================================================================================================================*
+ * Imports                                                                                                            *
+ *====================================================================================================================*/
+
+// This must come first.
+#define _POSIX_C_SOURCE 199309L
+
+#include "latency.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*====================================================================================================================*
+ * Constants                                                                                                          *
+ *====================================================================================================================*/
+
+/**
+ * @brief 10^9
+ */
+#define GIGA 1000000000
+
+/**
+ * @brief Time over which the frequency of the time-stamp counter is measured, in nanoseconds.
+ */
+#define CALIBRATION_NS 10000000
+
+/*====================================================================================================================*
+ * Private Variables                                                                                                  *
+ *====================================================================================================================*/
+
+/**
+ * @brief Cycles of the time-stamp counter per nanosecond, or zero if it was not measured yet.
+ */
+static double cycles_per_ns = 0;
+
+/*====================================================================================================================*
+ * Private Functions                                                                                                  *
+ *====================================================================================================================*/
+
+/**
+ * @brief Reads the monotonic clock in nanoseconds.
+ */
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts = {0};
+
+    assert(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+
+    return ((uint64_t)ts.tv_sec * GIGA + (uint64_t)ts.tv_nsec);
+}
+
+/**
+ * @brief Measures the frequency of the time-stamp counter against the monotonic clock, once.
+ */
+static double get_cycles_per_ns(void)
+{
+    if (cycles_per_ns == 0)
+    {
+        const uint64_t start_ns = monotonic_ns();
+        const uint64_t start = latency_now();
+        uint64_t end_ns = 0;
+
+        while ((end_ns = monotonic_ns()) - start_ns < CALIBRATION_NS)
+            ;
+        cycles_per_ns = (double)(latency_now() - start) / (double)(end_ns - start_ns);
+        assert(cycles_per_ns > 0);
+    }
+
+    return (cycles_per_ns);
+}
+
+/**
+ * @brief Orders two samples.
+ */
+static int compare_samples(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t *)a;
+    const uint64_t y = *(const uint64_t *)b;
+
+    return ((x > y) - (x < y));
+}
+
+/*====================================================================================================================*
+ * Public Functions                                                                                                   *
+ *====================================================================================================================*/
+
+/**
+ * @brief Reads the time-stamp counter. Falls back to the monotonic clock on processors that do not have one.
+ */
+uint64_t latency_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (__rdtsc());
+#elif defined(__aarch64__)
+    uint64_t cycles = 0;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(cycles));
+    return (cycles);
+#else
+    return (monotonic_ns());
+#endif
+}
+
+/**
+ * @brief Converts cycles of the time-stamp counter to nanoseconds.
+ */
+uint64_t latency_to_ns(uint64_t cycles)
+{
+    return ((uint64_t)((double)cycles / get_cycles_per_ns()));
+}
+
+/**
+ * @brief Converts nanoseconds to cycles of the time-stamp counter.
+ */
+uint64_t latency_from_ns(uint64_t ns)
+{
+    return ((uint64_t)((double)ns * get_cycles_per_ns()));
+}
+
+/**
+ * @brief Initializes a set of at most capacity samples.
+ */
+void latency_init(struct latency *l, size_t capacity)
+{
+    assert(capacity > 0);
+    assert((l->samples = malloc(sizeof(uint64_t) * capacity)) != NULL);
+    l->nsamples = 0;
+    l->capacity = capacity;
+    l->sorted = 0;
+
+    // Measure the time-stamp counter now rather than while samples are taken.
+    get_cycles_per_ns();
+}
+
+/**
+ * @brief Releases a set of samples.
+ */
+void latency_free(struct latency *l)
+{
+    free(l->samples);
+    l->samples = NULL;
+    l->nsamples = 0;
+    l->capacity = 0;
+}
+
+/**
+ * @brief Records the time between start and end.
+ */
+void latency_record(struct latency *l, uint64_t start, uint64_t end)
+{
+    if (l->nsamples < l->capacity)
+    {
+        l->samples[l->nsamples++] = end - start;
+        l->sorted = 0;
+    }
+}
+
+/**
+ * @brief Returns the q-th quantile of the samples in nanoseconds.
+ */
+uint64_t latency_percentile_ns(struct latency *l, double q)
+{
+    size_t i = 0;
+
+    assert(q >= 0 && q <= 1);
+    if (l->nsamples == 0)
+        return (0);
+
+    if (!l->sorted)
+    {
+        qsort(l->samples, l->nsamples, sizeof(uint64_t), compare_samples);
+        l->sorted = 1;
+    }
+
+    // Nearest rank.
+    i = (size_t)(q * (double)l->nsamples);
+    if (i >= l->nsamples)
+        i = l->nsamples - 1;
+
+    return (latency_to_ns(l->samples[i]));
+}
+
+/**
+ * @brief Returns the mean of the samples in nanoseconds.
+ */
+uint64_t latency_mean_ns(const struct latency *l)
+{
+    double sum = 0;
+
+    if (l->nsamples == 0)
+        return (0);
+
+    for (size_t i = 0; i < l->nsamples; i++)
+        sum += (double)l->samples[i];
+
+    return (latency_to_ns((uint64_t)(sum / (double)l->nsamples)));
+}
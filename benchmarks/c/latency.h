@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Samples of a latency, in cycles of the time-stamp counter.
+ */
+struct latency
+{
+    uint64_t *samples; /**< Samples.                   */
+    size_t nsamples;   /**< Number of samples.         */
+    size_t capacity;   /**< Maximum number of samples. */
+    int sorted;        /**< Are the samples sorted?    */
+};
+
+/**
+ * @brief Reads the time-stamp counter.
+ *
+ * @return The current value of the time-stamp counter.
+ */
+extern uint64_t latency_now(void);
+
+/**
+ * @brief Converts cycles of the time-stamp counter to nanoseconds.
+ *
+ * @param cycles Number of cycles.
+ *
+ * @return The number of nanoseconds.
+ */
+extern uint64_t latency_to_ns(uint64_t cycles);
+
+/**
+ * @brief Converts nanoseconds to cycles of the time-stamp counter.
+ *
+ * @param ns Number of nanoseconds.
+ *
+ * @return The number of cycles.
+ */
+extern uint64_t latency_from_ns(uint64_t ns);
+
+/**
+ * @brief Initializes a set of at most capacity samples.
+ */
+extern void latency_init(struct latency *l, size_t capacity);
+
+/**
+ * @brief Releases a set of samples.
+ */
+extern void latency_free(struct latency *l);
+
+/**
+ * @brief Records the time between start and end. Samples past the capacity are dropped.
+ */
+extern void latency_record(struct latency *l, uint64_t start, uint64_t end);
+
+/**
+ * @brief Returns the q-th quantile of the samples in nanoseconds, where q is between 0 and 1.
+ */
+extern uint64_t latency_percentile_ns(struct latency *l, double q);
+
+/**
+ * @brief Returns the mean of the samples in nanoseconds.
+ */
+extern uint64_t latency_mean_ns(const struct latency *l);
+
+#endif /* !LATENCY_H_ */
@@ -7,17 +7,480 @@
  * Imports                                                                                                            *
  *====================================================================================================================*/
 
+#ifdef __linux__
+#include <arpa/inet.h>
+#endif
+
+#include "latency.h"
+#include "report.h"
 #include "stopwatch.h"
 #include <assert.h>
 #include <demi/libos.h>
 #include <demi/sga.h>
 #include <demi/wait.h>
+#include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+/*====================================================================================================================*
+ * Constants                                                                                                          *
+ *====================================================================================================================*/
+
+/**
+ * @brief Port of the UDP socket used by the microbenchmarks of batched system calls.
+ */
+#define BENCH_PORT 12345
+
+/**
+ * @brief Size of the scatter-gather arrays used by the microbenchmarks of batched system calls.
+ */
+#define BENCH_SGA_SIZE 64
+
+/**
+ * @brief Maximum number of pending connections on the listening socket of the echo server.
+ */
+#define ECHO_BACKLOG 1024
+
+/**
+ * @brief Default parameters of the echo benchmarks.
+ */
+#define DEFAULT_BUFSIZE 64
+#define DEFAULT_NREQUESTS 100000
+#define DEFAULT_RATE 10000
+#define DEFAULT_NCONNS 1
+
+/**
+ * @brief Number of connections that the scaling benchmark grows by at each step.
+ */
+#define SCALE_FACTOR 10
+
+/*====================================================================================================================*
+ * Structures                                                                                                         *
+ *====================================================================================================================*/
+
+/**
+ * @brief Parameters of the echo benchmarks.
+ */
+struct echo_args
+{
+    const char *suite;  /**< Benchmark to run: "rtt", "load" or "scale". */
+    size_t bufsize;     /**< Size of each request.                       */
+    unsigned nrequests; /**< Number of requests.                         */
+    unsigned rate;      /**< Requests per second of the open-loop load.  */
+    unsigned nconns;    /**< Number of connections.                      */
+};
+
+/**
+ * @brief A connection of the echo client. Each connection carries one request at a time, except under open-loop load.
+ */
+struct echo_conn
+{
+    int qd;              /**< I/O queue descriptor.                                        */
+    demi_sgarray_t sga;  /**< Request, which is pushed again and again.                     */
+    uint64_t sent_at;    /**< Time at which the oldest pending request was (to be) sent.    */
+    size_t received;     /**< Bytes received of the oldest pending request.                 */
+    unsigned nsent;      /**< Number of requests sent.                                      */
+    unsigned ncompleted; /**< Number of requests whose echo was received.                   */
+};
+
+/*====================================================================================================================*
+ * Helper Functions                                                                                                   *
+ *====================================================================================================================*/
+
+/**
+ * @brief Creates a UDP socket that is bound to the loopback interface.
+ *
+ * @return The I/O queue descriptor of the socket.
+ */
+static int bench_socket(void)
+{
+    int sockqd = -1;
+    struct sockaddr_in addr = {0};
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(BENCH_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    assert(demi_socket(&sockqd, AF_INET, SOCK_DGRAM, 0) == 0);
+    assert(demi_bind(sockqd, (const struct sockaddr *)&addr, sizeof(struct sockaddr_in)) == 0);
+
+    return (sockqd);
+}
+
+/**
+ * @brief Adds the percentiles of a set of latency samples to the current result.
+ */
+static void report_latency(struct latency *l)
+{
+    report_metric("p50_ns", (double)latency_percentile_ns(l, 0.50));
+    report_metric("p99_ns", (double)latency_percentile_ns(l, 0.99));
+    report_metric("p999_ns", (double)latency_percentile_ns(l, 0.999));
+    report_metric("mean_ns", (double)latency_mean_ns(l));
+}
+
+/**
+ * @brief Waits on a wait set until an operation completes, retrying when the default timeout expires.
+ */
+static void waitset_wait_retry(demi_qresult_t *qr, int wsd)
+{
+    int ret = 0;
+
+    while ((ret = demi_waitset_wait(qr, wsd, NULL)) == ETIMEDOUT)
+        ;
+    assert(ret == 0);
+}
+
+/**
+ * @brief Issues a pop on a socket and adds it to a wait set.
+ */
+static void pop_add(int wsd, int qd)
+{
+    demi_qtoken_t qt = -1;
+
+    assert(demi_pop(&qt, qd) == 0);
+    assert(demi_waitset_add(wsd, qt) == 0);
+}
+
+/**
+ * @brief Issues a push on a socket and adds it to a wait set.
+ */
+static void push_add(int wsd, int qd, demi_sgarray_t *sga)
+{
+    demi_qtoken_t qt = -1;
+
+    assert(demi_push(&qt, qd, sga) == 0);
+    assert(demi_waitset_add(wsd, qt) == 0);
+}
+
+/**
+ * @brief Waits for every operation in a set of queue tokens to complete, so that the LibOS releases their results.
+ *
+ * Pending operations on a socket fail once it is closed, so this can reap them after a call to demi_close().
+ */
+static void reap_all(const demi_qtoken_t *qts, const int NUM_QTS)
+{
+    for (int i = 0; i < NUM_QTS; i++)
+    {
+        demi_qresult_t qr = {0};
+
+        assert(demi_wait(&qr, qts[i], NULL) == 0);
+    }
+}
+
+/**
+ * @brief Returns the number of bytes in a scatter-gather array.
+ */
+static size_t sga_len(const demi_sgarray_t *sga)
+{
+    size_t len = 0;
+
+    for (uint32_t i = 0; i < sga->sga_numsegs; i++)
+        len += sga->sga_segs[i].sgaseg_len;
+
+    return (len);
+}
+
+/*====================================================================================================================*
+ * System Calls in demi/libos.h                                                                                       *
+ *====================================================================================================================*/
+
+/**
+ * @brief Microbenchmark for demi_push_n().
+ *
+ * The socket is not connected, so the pushes fail once they run. This measures the cost of issuing them.
+ */
+static void microbench_push_n(const unsigned NUM_ITERS, const int NUM_OPS)
+{
+    int *qds = NULL;
+    demi_qtoken_t *qts = NULL;
+    demi_sgarray_t *sgas = NULL;
+    demi_sgarray_t sga = {0};
+    int sockqd = bench_socket();
+
+    assert(NUM_ITERS > 0);
+    assert(NUM_OPS > 0);
+
+    // Allocate arrays of operations. Every operation pushes the same scatter-gather array.
+    assert((qds = malloc(sizeof(int) * NUM_OPS)) != NULL);
+    assert((qts = malloc(sizeof(demi_qtoken_t) * NUM_OPS)) != NULL);
+    assert((sgas = malloc(sizeof(demi_sgarray_t) * NUM_OPS)) != NULL);
+    sga = demi_sgaalloc(BENCH_SGA_SIZE);
+    assert(sga.sga_buf != NULL);
+    for (int i = 0; i < NUM_OPS; i++)
+    {
+        qds[i] = sockqd;
+        sgas[i] = sga;
+    }
+
+    stopwatch_reset();
+
+    for (unsigned i = 0; i < NUM_ITERS; i++)
+    {
+        int nsubmitted = 0;
+
+        stopwatch_start();
+        assert(demi_push_n(qts, qds, sgas, NUM_OPS, &nsubmitted) == 0);
+        stopwatch_stop();
+        assert(nsubmitted == NUM_OPS);
+        reap_all(qts, nsubmitted);
+    }
+
+    report_begin("push_n", NUM_OPS);
+    report_metric("ns_per_op", (double)stopwatch_read() / NUM_OPS);
+    report_end();
+
+    // Release resources.
+    assert(demi_close(sockqd) == 0);
+    assert(demi_sgafree(&sga) == 0);
+    free(sgas);
+    free(qts);
+    free(qds);
+}
+
+/**
+ * @brief Microbenchmark for demi_pushto_n().
+ *
+ * Every datagram goes to the same destination on the loopback interface, so the pushes complete. This measures the
+ * cost of issuing them and waiting for them to complete.
+ */
+static void microbench_pushto_n(const unsigned NUM_ITERS, const int NUM_OPS)
+{
+    int *qds = NULL;
+    demi_qtoken_t *qts = NULL;
+    demi_sgarray_t *sgas = NULL;
+    const struct sockaddr **dest_addrs = NULL;
+    demi_sgarray_t sga = {0};
+    struct sockaddr_in dest_addr = {0};
+    int sockqd = bench_socket();
+
+    assert(NUM_ITERS > 0);
+    assert(NUM_OPS > 0);
+
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_port = htons(BENCH_PORT + 1);
+    dest_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    // Allocate arrays of operations. Every operation pushes the same scatter-gather array to the same destination.
+    assert((qds = malloc(sizeof(int) * NUM_OPS)) != NULL);
+    assert((qts = malloc(sizeof(demi_qtoken_t) * NUM_OPS)) != NULL);
+    assert((sgas = malloc(sizeof(demi_sgarray_t) * NUM_OPS)) != NULL);
+    assert((dest_addrs = malloc(sizeof(struct sockaddr *) * NUM_OPS)) != NULL);
+    sga = demi_sgaalloc(BENCH_SGA_SIZE);
+    assert(sga.sga_buf != NULL);
+    for (int i = 0; i < NUM_OPS; i++)
+    {
+        qds[i] = sockqd;
+        sgas[i] = sga;
+        dest_addrs[i] = (const struct sockaddr *)&dest_addr;
+    }
+
+    stopwatch_reset();
+
+    for (unsigned i = 0; i < NUM_ITERS; i++)
+    {
+        int nsubmitted = 0;
+        demi_qresult_t qr = {0};
+
+        stopwatch_start();
+        assert(demi_pushto_n(qts, qds, sgas, dest_addrs, sizeof(struct sockaddr_in), NUM_OPS, &nsubmitted) == 0);
+        for (int j = 0; j < nsubmitted; j++)
+            assert(demi_wait(&qr, qts[j], NULL) == 0);
+        stopwatch_stop();
+        assert(nsubmitted == NUM_OPS);
+    }
+
+    report_begin("pushto_n", NUM_OPS);
+    report_metric("ns_per_op", (double)stopwatch_read() / NUM_OPS);
+    report_end();
+
+    // Release resources.
+    assert(demi_close(sockqd) == 0);
+    assert(demi_sgafree(&sga) == 0);
+    free(dest_addrs);
+    free(sgas);
+    free(qts);
+    free(qds);
+}
+
+/**
+ * @brief Microbenchmark for demi_pop_n().
+ *
+ * No data is ever sent to the socket, so the pops only complete once it is closed. This measures the cost of issuing
+ * them.
+ */
+static void microbench_pop_n(const unsigned NUM_ITERS, const int NUM_OPS)
+{
+    int *qds = NULL;
+    demi_qtoken_t *qts = NULL;
+    int sockqd = bench_socket();
+
+    assert(NUM_ITERS > 0);
+    assert(NUM_OPS > 0);
+
+    // Allocate arrays of operations. Every iteration keeps its own queue tokens, so that they can be reaped at the end.
+    assert((qds = malloc(sizeof(int) * NUM_OPS)) != NULL);
+    assert((qts = malloc(sizeof(demi_qtoken_t) * NUM_OPS * NUM_ITERS)) != NULL);
+    for (int i = 0; i < NUM_OPS; i++)
+        qds[i] = sockqd;
+
+    stopwatch_reset();
+
+    for (unsigned i = 0; i < NUM_ITERS; i++)
+    {
+        int nsubmitted = 0;
+
+        stopwatch_start();
+        assert(demi_pop_n(&qts[i * NUM_OPS], qds, NUM_OPS, &nsubmitted) == 0);
+        stopwatch_stop();
+        assert(nsubmitted == NUM_OPS);
+    }
+
+    report_begin("pop_n", NUM_OPS);
+    report_metric("ns_per_op", (double)stopwatch_read() / NUM_OPS);
+    report_end();
+
+    // Release resources.
+    assert(demi_close(sockqd) == 0);
+    reap_all(qts, NUM_OPS * NUM_ITERS);
+    free(qts);
+    free(qds);
+}
+
+/**
+ * @brief Microbenchmark for creating queue tokens with demi_pop().
+ *
+ * No data is ever sent to the socket, so the pops never complete. This measures the latency of a single call, which
+ * creates a queue token and a coroutine.
+ */
+static void microbench_qtoken(const unsigned NUM_ITERS)
+{
+    struct latency l = {0};
+    int sockqd = bench_socket();
+
+    assert(NUM_ITERS > 0);
+
+    latency_init(&l, NUM_ITERS);
+
+    for (unsigned i = 0; i < NUM_ITERS; i++)
+    {
+        demi_qtoken_t qt = -1;
+        uint64_t start = latency_now();
+        assert(demi_pop(&qt, sockqd) == 0);
+        latency_record(&l, start, latency_now());
+    }
+
+    report_begin("qtoken", 1);
+    report_latency(&l);
+    report_end();
+
+    // Release resources.
+    assert(demi_close(sockqd) == 0);
+    latency_free(&l);
+}
+
+/**
+ * @brief Microbenchmark for a push, a pop and the waits for both, on a UDP socket that sends to itself.
+ *
+ * This needs a loopback path, so it is skipped on LibOSes where datagrams to the local address never come back.
+ */
+static void microbench_roundtrip(const unsigned NUM_ITERS, const size_t SIZE)
+{
+    struct latency l = {0};
+    struct sockaddr_in addr = {0};
+    demi_sgarray_t sga = {0};
+    const struct timespec timeout = {.tv_sec = 1, .tv_nsec = 0};
+    int sockqd = bench_socket();
+
+    assert(NUM_ITERS > 0);
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(BENCH_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    latency_init(&l, NUM_ITERS);
+    sga = demi_sgaalloc(SIZE);
+    assert(sga.sga_buf != NULL);
+
+    for (unsigned i = 0; i < NUM_ITERS; i++)
+    {
+        demi_qtoken_t qt = -1;
+        demi_qresult_t qr = {0};
+        int ret = 0;
+        uint64_t start = latency_now();
+
+        assert(demi_pushto(&qt, sockqd, &sga, (const struct sockaddr *)&addr, sizeof(struct sockaddr_in)) == 0);
+        assert(demi_wait(&qr, qt, NULL) == 0);
+        assert(qr.qr_opcode == DEMI_OPC_PUSH);
+        assert(demi_pop(&qt, sockqd) == 0);
+        if ((ret = demi_wait(&qr, qt, &timeout)) == ETIMEDOUT)
+        {
+            fprintf(stderr, "roundtrip: skipped, datagrams to the local address do not come back\n");
+            break;
+        }
+        assert(ret == 0);
+        latency_record(&l, start, latency_now());
+        assert(qr.qr_opcode == DEMI_OPC_POP);
+        assert(demi_sgafree(&qr.qr_value.sga) == 0);
+    }
+
+    if (l.nsamples > 0)
+    {
+        report_begin("roundtrip", (long long)SIZE);
+        report_latency(&l);
+        report_end();
+    }
+
+    // Release resources.
+    assert(demi_close(sockqd) == 0);
+    assert(demi_sgafree(&sga) == 0);
+    latency_free(&l);
+}
+
+/*====================================================================================================================*
+ * System Calls in demi/sga.h                                                                                         *
+ *====================================================================================================================*/
+
+/**
+ * @brief Microbenchmark for demi_sgaalloc() and demi_sgafree().
+ */
+static void microbench_sgaalloc(const unsigned NUM_ITERS, const size_t SIZE)
+{
+    struct latency alloc = {0};
+    struct latency release = {0};
+
+    assert(NUM_ITERS > 0);
+
+    latency_init(&alloc, NUM_ITERS);
+    latency_init(&release, NUM_ITERS);
+
+    for (unsigned i = 0; i < NUM_ITERS; i++)
+    {
+        demi_sgarray_t sga = {0};
+        uint64_t start = latency_now();
+        sga = demi_sgaalloc(SIZE);
+        uint64_t middle = latency_now();
+        assert(sga.sga_buf != NULL);
+        assert(demi_sgafree(&sga) == 0);
+        latency_record(&alloc, start, middle);
+        latency_record(&release, middle, latency_now());
+    }
+
+    report_begin("sgaalloc", (long long)SIZE);
+    report_latency(&alloc);
+    report_end();
+    report_begin("sgafree", (long long)SIZE);
+    report_latency(&release);
+    report_end();
+
+    // Release resources.
+    latency_free(&release);
+    latency_free(&alloc);
+}
+
 /*====================================================================================================================*
  * System Calls in demi/wait.h                                                                                        *
  *====================================================================================================================*/
@@ -50,28 +513,631 @@ static void microbench_wait_any(const unsigned NUM_ITERS, const unsigned NUM_QTS
         stopwatch_stop();
     }
 
-    printf("demi_wait_any() takes about %lld nanoseconds.\n", stopwatch_read());
+    report_begin("wait_any", NUM_QTS);
+    report_metric("ns_per_call", (double)stopwatch_read());
+    report_end();
+
+    // Release resources.
+    free(qts);
+}
+
+/**
+ * @brief Microbenchmark for demi_waitset_wait(), compared against demi_wait_any() on the same queue tokens.
+ *
+ * No data is ever sent to the socket, so the pops never complete and every wait times out. This measures the cost of
+ * a wait that finds nothing, which demi_wait_any() pays once per queue token.
+ */
+static void microbench_waitset_wait(const unsigned NUM_ITERS, const int NUM_QTS)
+{
+    int *qds = NULL;
+    demi_qtoken_t *qts = NULL;
+    int nsubmitted = 0;
+    int wsd = -1;
+    int sockqd = bench_socket();
+
+    assert(NUM_ITERS > 0);
+    assert(NUM_QTS > 0);
+
+    // Issue one pending pop for every queue token and register them in a wait set.
+    assert((qds = malloc(sizeof(int) * NUM_QTS)) != NULL);
+    assert((qts = malloc(sizeof(demi_qtoken_t) * NUM_QTS)) != NULL);
+    for (int i = 0; i < NUM_QTS; i++)
+        qds[i] = sockqd;
+    assert(demi_pop_n(qts, qds, NUM_QTS, &nsubmitted) == 0);
+    assert(nsubmitted == NUM_QTS);
+    assert(demi_waitset_create(&wsd) == 0);
+    for (int i = 0; i < NUM_QTS; i++)
+        assert(demi_waitset_add(wsd, qts[i]) == 0);
+
+    stopwatch_reset();
+
+    for (unsigned i = 0; i < NUM_ITERS; i++)
+    {
+        demi_qresult_t qr = {};
+        struct timespec timeout = {.tv_sec = 0, .tv_nsec = 0};
+
+        stopwatch_start();
+        assert(demi_waitset_wait(&qr, wsd, &timeout) != 0);
+        stopwatch_stop();
+    }
+
+    report_begin("waitset_wait", NUM_QTS);
+    report_metric("ns_per_call", (double)stopwatch_read());
+    report_end();
+
+    stopwatch_reset();
+
+    for (unsigned i = 0; i < NUM_ITERS; i++)
+    {
+        demi_qresult_t qr = {};
+        int ready_offset = -1;
+        struct timespec timeout = {.tv_sec = 0, .tv_nsec = 0};
+
+        stopwatch_start();
+        assert(demi_wait_any(&qr, &ready_offset, qts, NUM_QTS, &timeout) != 0);
+        stopwatch_stop();
+    }
+
+    report_begin("waitset_wait_any", NUM_QTS);
+    report_metric("ns_per_call", (double)stopwatch_read());
+    report_end();
+
+    // Release resources.
+    assert(demi_waitset_close(wsd) == 0);
+    assert(demi_close(sockqd) == 0);
+    reap_all(qts, NUM_QTS);
+    free(qts);
+    free(qds);
+}
+
+/**
+ * @brief Consumes all entries in a completion queue of NUM_ENTRIES entries.
+ *
+ * @return The number of entries that were consumed.
+ */
+static int cq_drain(demi_cq_t *cq, const unsigned NUM_ENTRIES)
+{
+    int count = 0;
+    const uint64_t tail = __atomic_load_n(&cq->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (cq->cq_head != tail)
+    {
+        const demi_qresult_t *qr = &DEMI_CQ_ENTRIES(cq)[cq->cq_head & (NUM_ENTRIES - 1)];
+        assert(qr->qr_opcode == DEMI_OPC_PUSH || qr->qr_opcode == DEMI_OPC_FAILED);
+        __atomic_store_n(&cq->cq_head, cq->cq_head + 1, __ATOMIC_RELEASE);
+        count++;
+    }
+
+    return (count);
+}
+
+/**
+ * @brief Microbenchmark for harvesting completions from a completion queue, compared against demi_wait_next_n().
+ *
+ * The socket is not connected, so the pushes fail once they run. This measures the cost of collecting their results.
+ */
+static void microbench_cq_harvest(const unsigned NUM_ITERS, const int NUM_OPS)
+{
+    const unsigned NUM_ENTRIES = 1024;
+    int *qds = NULL;
+    demi_qtoken_t *qts = NULL;
+    demi_sgarray_t *sgas = NULL;
+    demi_qresult_t *qrs = NULL;
+    demi_cq_t *cq = NULL;
+    demi_sgarray_t sga = {0};
+    int sockqd = bench_socket();
+
+    assert(NUM_ITERS > 0);
+    assert(NUM_OPS > 0 && (unsigned)NUM_OPS < NUM_ENTRIES);
+
+    // Allocate arrays of operations. Every operation pushes the same scatter-gather array.
+    assert((qds = malloc(sizeof(int) * NUM_OPS)) != NULL);
+    assert((qts = malloc(sizeof(demi_qtoken_t) * NUM_OPS)) != NULL);
+    assert((sgas = malloc(sizeof(demi_sgarray_t) * NUM_OPS)) != NULL);
+    assert((qrs = malloc(sizeof(demi_qresult_t) * NUM_OPS)) != NULL);
+    assert((cq = calloc(1, DEMI_CQ_SIZE(NUM_ENTRIES))) != NULL);
+    sga = demi_sgaalloc(BENCH_SGA_SIZE);
+    assert(sga.sga_buf != NULL);
+    for (int i = 0; i < NUM_OPS; i++)
+    {
+        qds[i] = sockqd;
+        sgas[i] = sga;
+    }
+
+    // Harvest with demi_wait_next_n().
+    stopwatch_reset();
+
+    for (unsigned i = 0; i < NUM_ITERS; i++)
+    {
+        int nsubmitted = 0;
+        int nharvested = 0;
+
+        assert(demi_push_n(qts, qds, sgas, NUM_OPS, &nsubmitted) == 0);
+        stopwatch_start();
+        while (nharvested < NUM_OPS)
+        {
+            int nqrs = 0;
+            assert(demi_wait_next_n(qrs, NUM_OPS - nharvested, &nqrs, NULL) == 0);
+            nharvested += nqrs;
+        }
+        stopwatch_stop();
+    }
+
+    report_begin("wait_next_n", NUM_OPS);
+    report_metric("ns_per_op", (double)stopwatch_read() / NUM_OPS);
+    report_end();
+
+    // Harvest from a completion queue.
+    assert(demi_cq_register(cq, DEMI_CQ_SIZE(NUM_ENTRIES)) == 0);
+    stopwatch_reset();
+
+    for (unsigned i = 0; i < NUM_ITERS; i++)
+    {
+        int nsubmitted = 0;
+        int nharvested = 0;
+
+        assert(demi_push_n(qts, qds, sgas, NUM_OPS, &nsubmitted) == 0);
+        stopwatch_start();
+        while ((nharvested += cq_drain(cq, NUM_ENTRIES)) < NUM_OPS)
+            assert(demi_poll() == 0);
+        stopwatch_stop();
+    }
+
+    report_begin("cq_harvest", NUM_OPS);
+    report_metric("ns_per_op", (double)stopwatch_read() / NUM_OPS);
+    report_end();
 
     // Release resources.
+    assert(demi_cq_unregister() == 0);
+    assert(demi_close(sockqd) == 0);
+    assert(demi_sgafree(&sga) == 0);
+    free(cq);
+    free(qrs);
+    free(sgas);
     free(qts);
+    free(qds);
+}
+
+/*====================================================================================================================*
+ * Echo Benchmarks                                                                                                    *
+ *====================================================================================================================*/
+
+/**
+ * @brief Runs an echo server, which sends back everything that it receives on TCP connections, until it is killed.
+ */
+static void echo_server(const struct sockaddr_in *local)
+{
+    int sockqd = -1;
+    int wsd = -1;
+    demi_qtoken_t qt = -1;
+    demi_sgarray_t *pushed = NULL;
+    int npushed = 0;
+
+    assert(demi_socket(&sockqd, AF_INET, SOCK_STREAM, 0) == 0);
+    assert(demi_bind(sockqd, (const struct sockaddr *)local, sizeof(struct sockaddr_in)) == 0);
+    assert(demi_listen(sockqd, ECHO_BACKLOG) == 0);
+    assert(demi_waitset_create(&wsd) == 0);
+    assert(demi_accept(&qt, sockqd) == 0);
+    assert(demi_waitset_add(wsd, qt) == 0);
+
+    // Every connection has either a pop or a push pending, so the buffer of the push of a connection is kept in pushed,
+    // which is indexed by I/O queue descriptor, until that push completes.
+    for (;;)
+    {
+        demi_qresult_t qr = {0};
+
+        waitset_wait_retry(&qr, wsd);
+        switch (qr.qr_opcode)
+        {
+            case DEMI_OPC_ACCEPT:
+                pop_add(wsd, qr.qr_value.ares.qd);
+                assert(demi_accept(&qt, sockqd) == 0);
+                assert(demi_waitset_add(wsd, qt) == 0);
+                break;
+            case DEMI_OPC_POP:
+                if (sga_len(&qr.qr_value.sga) == 0)
+                {
+                    // The client closed the connection.
+                    assert(demi_sgafree(&qr.qr_value.sga) == 0);
+                    assert(demi_close(qr.qr_qd) == 0);
+                    break;
+                }
+                if (qr.qr_qd >= npushed)
+                {
+                    npushed = qr.qr_qd + 1;
+                    assert((pushed = realloc(pushed, sizeof(demi_sgarray_t) * npushed)) != NULL);
+                }
+                pushed[qr.qr_qd] = qr.qr_value.sga;
+                push_add(wsd, qr.qr_qd, &pushed[qr.qr_qd]);
+                break;
+            case DEMI_OPC_PUSH:
+                assert(demi_sgafree(&pushed[qr.qr_qd]) == 0);
+                pop_add(wsd, qr.qr_qd);
+                break;
+            case DEMI_OPC_FAILED:
+                // The connection broke, so drop it. The listening socket keeps accepting.
+                if (qr.qr_qd != sockqd)
+                    demi_close(qr.qr_qd);
+                break;
+            default:
+                assert(false);
+        }
+    }
+}
+
+/**
+ * @brief Opens nconns connections to the echo server at remote and registers them in conn_of, which is indexed by I/O
+ * queue descriptor.
+ *
+ * @return The array of connections.
+ */
+static struct echo_conn *echo_connect(const struct sockaddr_in *remote, const struct echo_args *args, int wsd,
+                                      struct echo_conn ***conn_of, int *max_qd)
+{
+    struct echo_conn *conns = NULL;
+
+    assert((conns = calloc(args->nconns, sizeof(struct echo_conn))) != NULL);
+
+    // Connect all sockets at once.
+    *max_qd = 0;
+    for (unsigned i = 0; i < args->nconns; i++)
+    {
+        demi_qtoken_t qt = -1;
+        assert(demi_socket(&conns[i].qd, AF_INET, SOCK_STREAM, 0) == 0);
+        assert(demi_connect(&qt, conns[i].qd, (const struct sockaddr *)remote, sizeof(struct sockaddr_in)) == 0);
+        assert(demi_waitset_add(wsd, qt) == 0);
+        if (conns[i].qd > *max_qd)
+            *max_qd = conns[i].qd;
+        conns[i].sga = demi_sgaalloc(args->bufsize);
+        assert(conns[i].sga.sga_buf != NULL);
+        memset(conns[i].sga.sga_segs[0].sgaseg_buf, 1, conns[i].sga.sga_segs[0].sgaseg_len);
+    }
+    for (unsigned i = 0; i < args->nconns; i++)
+    {
+        demi_qresult_t qr = {0};
+        waitset_wait_retry(&qr, wsd);
+        assert(qr.qr_opcode == DEMI_OPC_CONNECT);
+    }
+
+    assert((*conn_of = calloc(*max_qd + 1, sizeof(struct echo_conn *))) != NULL);
+    for (unsigned i = 0; i < args->nconns; i++)
+        (*conn_of)[conns[i].qd] = &conns[i];
+
+    return (conns);
+}
+
+/**
+ * @brief Closes the connections that echo_connect() opened. Operations that are still pending are cancelled.
+ */
+static void echo_disconnect(struct echo_conn *conns, struct echo_conn **conn_of, unsigned nconns)
+{
+    for (unsigned i = 0; i < nconns; i++)
+    {
+        assert(demi_close(conns[i].qd) == 0);
+        assert(demi_sgafree(&conns[i].sga) == 0);
+    }
+    free(conn_of);
+    free(conns);
+}
+
+/**
+ * @brief Handles the completion of an operation of the echo client. Returns the number of requests whose echo was
+ * fully received, and records their latency from the time at which they were sent, or were due to be sent on an open
+ * loop.
+ */
+static unsigned echo_complete(const demi_qresult_t *qr, struct echo_conn **conn_of, const struct echo_args *args,
+                              struct latency *l, const uint64_t *due)
+{
+    struct echo_conn *conn = conn_of[qr->qr_qd];
+    demi_sgarray_t sga = qr->qr_value.sga;
+    unsigned ncompleted = 0;
+
+    if (qr->qr_opcode == DEMI_OPC_PUSH)
+        return (0);
+    assert(qr->qr_opcode == DEMI_OPC_POP);
+    assert(sga_len(&sga) > 0);
+
+    conn->received += sga_len(&sga);
+    assert(demi_sgafree(&sga) == 0);
+    while (conn->received >= args->bufsize)
+    {
+        const uint64_t now = latency_now();
+        latency_record(l, due != NULL ? due[conn->ncompleted] : conn->sent_at, now);
+        conn->received -= args->bufsize;
+        conn->ncompleted++;
+        conn->sent_at = now;
+        ncompleted++;
+    }
+
+    return (ncompleted);
+}
+
+/**
+ * @brief Runs a closed-loop echo benchmark, where each connection sends a request as soon as the previous one was
+ * echoed, until nrequests requests were echoed in total.
+ */
+static void echo_closed_loop(const char *name, const struct sockaddr_in *remote, const struct echo_args *args)
+{
+    struct echo_conn **conn_of = NULL;
+    struct echo_conn *conns = NULL;
+    struct latency l = {0};
+    unsigned nsent = 0;
+    unsigned ncompleted = 0;
+    int max_qd = 0;
+    int wsd = -1;
+    uint64_t start = 0;
+
+    assert(demi_waitset_create(&wsd) == 0);
+    conns = echo_connect(remote, args, wsd, &conn_of, &max_qd);
+    latency_init(&l, args->nrequests);
+
+    start = latency_now();
+    for (unsigned i = 0; i < args->nconns && nsent < args->nrequests; i++, nsent++)
+    {
+        conns[i].sent_at = latency_now();
+        conns[i].nsent++;
+        push_add(wsd, conns[i].qd, &conns[i].sga);
+        pop_add(wsd, conns[i].qd);
+    }
+    while (ncompleted < args->nrequests)
+    {
+        demi_qresult_t qr = {0};
+        struct echo_conn *conn = NULL;
+        unsigned n = 0;
+
+        waitset_wait_retry(&qr, wsd);
+        if ((n = echo_complete(&qr, conn_of, args, &l, NULL)) == 0 && qr.qr_opcode == DEMI_OPC_PUSH)
+            continue;
+        ncompleted += n;
+        conn = conn_of[qr.qr_qd];
+        if (n > 0 && nsent < args->nrequests)
+        {
+            push_add(wsd, conn->qd, &conn->sga);
+            conn->nsent++;
+            nsent++;
+        }
+        // Keep receiving until the echo of every request that was sent on this connection came back.
+        if (conn->ncompleted < conn->nsent || conn->received > 0)
+            pop_add(wsd, conn->qd);
+    }
+
+    report_begin(name, args->nconns);
+    report_metric("requests_per_sec", (double)ncompleted * 1e9 / (double)latency_to_ns(latency_now() - start));
+    report_latency(&l);
+    report_end();
+
+    // Release resources.
+    echo_disconnect(conns, conn_of, args->nconns);
+    assert(demi_waitset_close(wsd) == 0);
+    latency_free(&l);
+}
+
+/**
+ * @brief Runs an open-loop echo benchmark, where requests are sent at a fixed rate no matter how long their echoes
+ * take, round-robin over the connections. Latencies are measured from the time at which each request was due, so
+ * that requests that queue up behind a slow one are not hidden.
+ */
+static void echo_open_loop(const struct sockaddr_in *remote, const struct echo_args *args)
+{
+    struct echo_conn **conn_of = NULL;
+    struct echo_conn *conns = NULL;
+    uint64_t **due = NULL;
+    struct latency l = {0};
+    const uint64_t interval = latency_from_ns(1000000000ull / args->rate);
+    const unsigned per_conn = args->nrequests / args->nconns + 1;
+    unsigned nsent = 0;
+    unsigned ncompleted = 0;
+    int max_qd = 0;
+    int wsd = -1;
+    uint64_t start = 0;
+
+    assert(args->rate > 0);
+    assert(demi_waitset_create(&wsd) == 0);
+    conns = echo_connect(remote, args, wsd, &conn_of, &max_qd);
+    latency_init(&l, args->nrequests);
+
+    // Due times of the requests of every connection, in the order in which they are sent.
+    assert((due = calloc(args->nconns, sizeof(uint64_t *))) != NULL);
+    for (unsigned i = 0; i < args->nconns; i++)
+    {
+        assert((due[i] = malloc(sizeof(uint64_t) * per_conn)) != NULL);
+        pop_add(wsd, conns[i].qd);
+    }
+
+    start = latency_now();
+    while (ncompleted < args->nrequests)
+    {
+        const struct timespec timeout = {.tv_sec = 0, .tv_nsec = 0};
+        demi_qresult_t qr = {0};
+        const uint64_t now = latency_now();
+        int ret = 0;
+
+        // Send every request that is due.
+        while (nsent < args->nrequests && start + nsent * interval <= now)
+        {
+            struct echo_conn *conn = &conns[nsent % args->nconns];
+            due[nsent % args->nconns][conn->nsent++] = start + nsent * interval;
+            push_add(wsd, conn->qd, &conn->sga);
+            nsent++;
+        }
+
+        if ((ret = demi_waitset_wait(&qr, wsd, &timeout)) == ETIMEDOUT)
+            continue;
+        assert(ret == 0);
+        if (qr.qr_opcode == DEMI_OPC_POP)
+        {
+            struct echo_conn *conn = conn_of[qr.qr_qd];
+            ncompleted += echo_complete(&qr, conn_of, args, &l, due[conn - conns]);
+            pop_add(wsd, conn->qd);
+        }
+        else
+            assert(qr.qr_opcode == DEMI_OPC_PUSH);
+    }
+
+    report_begin("echo_load", args->rate);
+    report_metric("requests_per_sec", (double)ncompleted * 1e9 / (double)latency_to_ns(latency_now() - start));
+    report_latency(&l);
+    report_end();
+
+    // Release resources.
+    for (unsigned i = 0; i < args->nconns; i++)
+        free(due[i]);
+    free(due);
+    echo_disconnect(conns, conn_of, args->nconns);
+    assert(demi_waitset_close(wsd) == 0);
+    latency_free(&l);
+}
+
+/**
+ * @brief Runs the echo benchmark of args->suite against the echo server at remote.
+ */
+static void echo_client(const struct sockaddr_in *remote, const struct echo_args *args)
+{
+    assert(args->nconns > 0);
+    assert(args->nrequests > 0);
+    assert(args->bufsize > 0);
+
+    if (!strcmp(args->suite, "rtt"))
+        echo_closed_loop("echo_rtt", remote, args);
+    else if (!strcmp(args->suite, "load"))
+        echo_open_loop(remote, args);
+    else if (!strcmp(args->suite, "scale"))
+    {
+        // Grow the number of connections up to args->nconns, with as many requests in flight as connections.
+        struct echo_args step = *args;
+        for (step.nconns = 1;; step.nconns *= SCALE_FACTOR)
+        {
+            if (step.nconns > args->nconns)
+                step.nconns = args->nconns;
+            step.nrequests = args->nrequests > step.nconns ? args->nrequests : step.nconns;
+            echo_closed_loop("echo_scale", remote, &step);
+            if (step.nconns == args->nconns)
+                break;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "unknown suite: %s\n", args->suite);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*===================================================================================================================*
+ * usage()                                                                                                           *
+ *===================================================================================================================*/
+
+/**
+ * @brief Prints program usage and exits.
+ *
+ * @param progname Program name.
+ */
+static void usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s [--json FILE] [OPTIONS]\n", progname);
+    fprintf(stderr, "Runs the microbenchmarks, or the echo benchmarks if a peer is given.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --json FILE           Write results in JSON to FILE, or to the standard output if FILE is -.\n");
+    fprintf(stderr, "  --server ADDR PORT    Run an echo server on ADDR:PORT.\n");
+    fprintf(stderr, "  --client ADDR PORT    Run an echo client against the server on ADDR:PORT.\n");
+    fprintf(stderr, "  --suite rtt|load|scale\n");
+    fprintf(stderr, "                        Closed-loop round trips, open-loop load at a fixed rate, or closed-loop\n");
+    fprintf(stderr, "                        round trips over a growing number of connections (default: rtt).\n");
+    fprintf(stderr, "  --bufsize N           Size of each request in bytes (default: %d).\n", DEFAULT_BUFSIZE);
+    fprintf(stderr, "  --nrequests N         Number of requests (default: %d).\n", DEFAULT_NREQUESTS);
+    fprintf(stderr, "  --rate N              Requests per second of the open-loop load (default: %d).\n", DEFAULT_RATE);
+    fprintf(stderr, "  --nconns N            Number of connections, or maximum number of them when scaling (default: %d).\n",
+            DEFAULT_NCONNS);
+
+    exit(EXIT_FAILURE);
 }
 
 /*===================================================================================================================*
  * main()                                                                                                            *
  *===================================================================================================================*/
 
+/**
+ * @brief Runs the microbenchmarks.
+ */
+static void microbenchmarks(void)
+{
+    microbench_wait_any(100000, 1048576);
+
+    // Waits on many pending operations, where a wait set should not slow down as the number of operations grows.
+    const int wait_set_sizes[] = {1024, 16384};
+    for (size_t i = 0; i < sizeof(wait_set_sizes) / sizeof(wait_set_sizes[0]); i++)
+        microbench_waitset_wait(1000, wait_set_sizes[i]);
+
+    // Batched system calls, where a batch of one is the cost of a single push or pop.
+    const int batch_sizes[] = {1, 8, 64};
+    for (size_t i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); i++)
+    {
+        microbench_push_n(1000, batch_sizes[i]);
+        microbench_pushto_n(1000, batch_sizes[i]);
+        microbench_pop_n(1000, batch_sizes[i]);
+    }
+
+    // Harvests batches of completions, where a completion queue needs no call per completion.
+    for (size_t i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); i++)
+        microbench_cq_harvest(1000, batch_sizes[i]);
+
+    // Allocations and round trips of small and large buffers.
+    const size_t sga_sizes[] = {64, 1024, 8192};
+    for (size_t i = 0; i < sizeof(sga_sizes) / sizeof(sga_sizes[0]); i++)
+    {
+        microbench_sgaalloc(100000, sga_sizes[i]);
+        microbench_roundtrip(10000, sga_sizes[i]);
+    }
+
+    microbench_qtoken(10000);
+}
+
 /**
  * @brief Drives the application.
  *
- * @param argc Argument count (unused).
- * @param argv Argument vector (unused).
+ * @param argc Argument count.
+ * @param argv Argument vector.
  *
  * @return On successful completion EXIT_SUCCESS is returned.
  */
 int main(int argc, char *const argv[])
 {
-    ((void)argc);
-    ((void)argv);
+    const char *json = NULL;
+    const char *peer = NULL;
+    struct sockaddr_in addr = {0};
+    struct echo_args echo = {
+        .suite = "rtt",
+        .bufsize = DEFAULT_BUFSIZE,
+        .nrequests = DEFAULT_NREQUESTS,
+        .rate = DEFAULT_RATE,
+        .nconns = DEFAULT_NCONNS,
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--json") && i + 1 < argc)
+            json = argv[++i];
+        else if ((!strcmp(argv[i], "--server") || !strcmp(argv[i], "--client")) && i + 2 < argc)
+        {
+            peer = argv[i];
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons((uint16_t)atoi(argv[i + 2]));
+            if (inet_pton(AF_INET, argv[i + 1], &addr.sin_addr) != 1)
+                usage(argv[0]);
+            i += 2;
+        }
+        else if (!strcmp(argv[i], "--suite") && i + 1 < argc)
+            echo.suite = argv[++i];
+        else if (!strcmp(argv[i], "--bufsize") && i + 1 < argc)
+            echo.bufsize = (size_t)atol(argv[++i]);
+        else if (!strcmp(argv[i], "--nrequests") && i + 1 < argc)
+            echo.nrequests = (unsigned)atol(argv[++i]);
+        else if (!strcmp(argv[i], "--rate") && i + 1 < argc)
+            echo.rate = (unsigned)atol(argv[++i]);
+        else if (!strcmp(argv[i], "--nconns") && i + 1 < argc)
+            echo.nconns = (unsigned)atol(argv[++i]);
+        else
+            usage(argv[0]);
+    }
 
     // This shall never fail.
     const struct demi_args args = {
@@ -81,7 +1147,14 @@ int main(int argc, char *const argv[])
     };
     assert(demi_init(&args) == 0);
 
-    microbench_wait_any(100000, 1048576);
+    report_open(json, getenv("LIBOS"));
+    if (peer == NULL)
+        microbenchmarks();
+    else if (!strcmp(peer, "--server"))
+        echo_server(&addr);
+    else
+        echo_client(&addr, &echo);
+    report_close();
 
     return (EXIT_SUCCESS);
 }
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+/*====================================================================================================================*
+ * Imports                                                                                                            *
+ *====================================================================================================================*/
+
+#include "report.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/*====================================================================================================================*
+ * Private Variables                                                                                                  *
+ *====================================================================================================================*/
+
+/**
+ * @brief Report.
+ */
+static struct
+{
+    FILE *file;       /**< Output file, or NULL for none.           */
+    bool to_stdout;   /**< Is the output file the standard output?  */
+    bool in_result;   /**< Is a result being written?               */
+    int nresults;     /**< Number of results written so far.        */
+    int nmetrics;     /**< Number of metrics in the current result. */
+    const char *name; /**< Name of the current benchmark.           */
+    long long n;      /**< Parameter of the current benchmark.      */
+} report = {.file = NULL, .to_stdout = false, .in_result = false, .nresults = 0, .nmetrics = 0};
+
+/*====================================================================================================================*
+ * Public Functions                                                                                                   *
+ *====================================================================================================================*/
+
+/**
+ * @brief Starts a report.
+ */
+void report_open(const char *path, const char *libos)
+{
+    if (path == NULL)
+        return;
+
+    report.to_stdout = !strcmp(path, "-");
+    assert((report.file = report.to_stdout ? stdout : fopen(path, "w")) != NULL);
+
+    // Names of benchmarks and LibOSes are plain identifiers, so they need no escaping.
+    fprintf(report.file, "{\"libos\": \"%s\", \"results\": [", libos != NULL ? libos : "unknown");
+}
+
+/**
+ * @brief Starts the result of a benchmark.
+ */
+void report_begin(const char *name, long long n)
+{
+    assert(!report.in_result);
+
+    report.in_result = true;
+    report.nmetrics = 0;
+    report.name = name;
+    report.n = n;
+
+    if (report.file != NULL)
+        fprintf(report.file, "%s{\"name\": \"%s\", \"n\": %lld, \"metrics\": {", report.nresults > 0 ? ", " : "", name,
+                n);
+}
+
+/**
+ * @brief Adds a metric to the current result and prints it.
+ */
+void report_metric(const char *metric, double value)
+{
+    assert(report.in_result);
+
+    // Results go to the standard error when the report goes to the standard output, so they do not mix.
+    fprintf(report.to_stdout ? stderr : stdout, "%s (n=%lld): %s = %.2f\n", report.name, report.n, metric, value);
+
+    if (report.file != NULL)
+        fprintf(report.file, "%s\"%s\": %.2f", report.nmetrics > 0 ? ", " : "", metric, value);
+    report.nmetrics++;
+}
+
+/**
+ * @brief Ends the current result.
+ */
+void report_end(void)
+{
+    assert(report.in_result);
+
+    report.in_result = false;
+    report.nresults++;
+
+    if (report.file != NULL)
+    {
+        fprintf(report.file, "}}");
+        fflush(report.file);
+    }
+}
+
+/**
+ * @brief Writes the report out and closes it.
+ */
+void report_close(void)
+{
+    assert(!report.in_result);
+
+    if (report.file == NULL)
+        return;
+
+    fprintf(report.file, "]}\n");
+    if (report.to_stdout)
+        fflush(report.file);
+    else
+        assert(fclose(report.file) == 0);
+    report.file = NULL;
+}
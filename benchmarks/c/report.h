@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) Microsoft Corporation.
+ * Licensed under the MIT license.
+ */
+
+#ifndef REPORT_H_
+#define REPORT_H_
+
+/**
+ * @brief Starts a report, which is written in JSON to the file at path once it is closed. If path is NULL, results are
+ * only printed.
+ *
+ * @param path  Path of the output file, or "-" for the standard output.
+ * @param libos Name of the LibOS that runs the benchmarks.
+ */
+extern void report_open(const char *path, const char *libos);
+
+/**
+ * @brief Starts the result of the benchmark name, which ran with parameter n.
+ */
+extern void report_begin(const char *name, long long n);
+
+/**
+ * @brief Adds a metric to the current result and prints it.
+ */
+extern void report_metric(const char *metric, double value);
+
+/**
+ * @brief Ends the current result.
+ */
+extern void report_end(void);
+
+/**
+ * @brief Writes the report out and closes it.
+ */
+extern void report_close(void);
+
+#endif /* !REPORT_H_ */
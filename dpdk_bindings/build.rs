@@ -95,6 +95,7 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_eth_dev_get_mtu")
         .allowlist_function("rte_eth_dev_info_get")
         .allowlist_function("rte_eth_dev_is_valid_port")
+        .allowlist_function("rte_eth_dev_rss_reta_update")
         .allowlist_function("rte_eth_dev_set_mtu")
         .allowlist_function("rte_eth_dev_socket_id")
         .allowlist_function("rte_eth_dev_start")
@@ -121,6 +122,7 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_socket_id")
         .allowlist_function("rte_strerror")
         .allowlist_type("rte_eth_fc_conf")
+        .allowlist_type("rte_eth_rss_reta_entry64")
         .allowlist_type("rte_eth_rxconf")
         .allowlist_type("rte_eth_txconf")
         .allowlist_type("rte_ether_addr")
@@ -132,6 +134,7 @@ fn os_build() -> Result<()> {
         .allowlist_var("RTE_ETH_LINK_UP")
         .allowlist_var("RTE_ETH_MQ_RX_RSS")
         .allowlist_var("RTE_ETH_MQ_TX_NONE")
+        .allowlist_var("RTE_ETH_RETA_GROUP_SIZE")
         .allowlist_var("RTE_ETH_RSS_IP")
         .allowlist_var("RTE_ETH_RX_OFFLOAD_IPV4_CKSUM")
         .allowlist_var("RTE_ETH_RX_OFFLOAD_TCP_CKSUM")
@@ -247,6 +250,7 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_eth_dev_get_mtu")
         .allowlist_function("rte_eth_dev_info_get")
         .allowlist_function("rte_eth_dev_is_valid_port")
+        .allowlist_function("rte_eth_dev_rss_reta_update")
         .allowlist_function("rte_eth_dev_set_mtu")
         .allowlist_function("rte_eth_dev_socket_id")
         .allowlist_function("rte_eth_dev_start")
@@ -273,6 +277,7 @@ fn os_build() -> Result<()> {
         .allowlist_function("rte_socket_id")
         .allowlist_function("rte_strerror")
         .allowlist_type("rte_eth_fc_conf")
+        .allowlist_type("rte_eth_rss_reta_entry64")
         .allowlist_type("rte_eth_rxconf")
         .allowlist_type("rte_eth_txconf")
         .allowlist_type("rte_ether_addr")
@@ -284,6 +289,7 @@ fn os_build() -> Result<()> {
         .allowlist_var("RTE_ETH_LINK_UP")
         .allowlist_var("RTE_ETH_MQ_RX_RSS")
         .allowlist_var("RTE_ETH_MQ_TX_NONE")
+        .allowlist_var("RTE_ETH_RETA_GROUP_SIZE")
         .allowlist_var("RTE_ETH_RSS_IP")
         .allowlist_var("RTE_ETH_RX_OFFLOAD_IPV4_CKSUM")
         .allowlist_var("RTE_ETH_RX_OFFLOAD_TCP_CKSUM")
@@ -90,7 +90,22 @@ int rte_eth_tx_offload_udp_cksum_()
 
 int rte_eth_rx_offload_udp_cksum_()
 {
-    return RTE_ETH_RX_OFFLOAD_TCP_CKSUM;
+    return RTE_ETH_RX_OFFLOAD_UDP_CKSUM;
+}
+
+int rte_eth_rx_offload_ipv4_cksum_()
+{
+    return RTE_ETH_RX_OFFLOAD_IPV4_CKSUM;
+}
+
+int rte_eth_tx_offload_ipv4_cksum_()
+{
+    return RTE_ETH_TX_OFFLOAD_IPV4_CKSUM;
+}
+
+int rte_eth_tx_offload_tcp_tso_()
+{
+    return RTE_ETH_TX_OFFLOAD_TCP_TSO;
 }
 
 int rte_eth_tx_offload_multi_segs_()
@@ -102,3 +117,63 @@ char *rte_pktmbuf_prepend_(struct rte_mbuf *m, uint16_t len)
 {
     return rte_pktmbuf_prepend(m, len);
 }
+
+uint16_t rte_eth_tx_prepare_(uint16_t port_id, uint16_t queue_id, struct rte_mbuf **tx_pkts, uint16_t nb_pkts)
+{
+    return rte_eth_tx_prepare(port_id, queue_id, tx_pkts, nb_pkts);
+}
+
+uint64_t rte_mbuf_f_tx_ipv4_()
+{
+    return RTE_MBUF_F_TX_IPV4;
+}
+
+uint64_t rte_mbuf_f_tx_ip_cksum_()
+{
+    return RTE_MBUF_F_TX_IP_CKSUM;
+}
+
+uint64_t rte_mbuf_f_tx_tcp_cksum_()
+{
+    return RTE_MBUF_F_TX_TCP_CKSUM;
+}
+
+uint64_t rte_mbuf_f_tx_udp_cksum_()
+{
+    return RTE_MBUF_F_TX_UDP_CKSUM;
+}
+
+uint64_t rte_mbuf_f_tx_tcp_seg_()
+{
+    return RTE_MBUF_F_TX_TCP_SEG;
+}
+
+uint64_t rte_mbuf_f_rx_ip_cksum_mask_()
+{
+    return RTE_MBUF_F_RX_IP_CKSUM_MASK;
+}
+
+uint64_t rte_mbuf_f_rx_ip_cksum_bad_()
+{
+    return RTE_MBUF_F_RX_IP_CKSUM_BAD;
+}
+
+uint64_t rte_mbuf_f_rx_l4_cksum_mask_()
+{
+    return RTE_MBUF_F_RX_L4_CKSUM_MASK;
+}
+
+uint64_t rte_mbuf_f_rx_l4_cksum_bad_()
+{
+    return RTE_MBUF_F_RX_L4_CKSUM_BAD;
+}
+
+void rte_mbuf_set_tx_offload_(struct rte_mbuf *m, uint64_t ol_flags, uint16_t l2_len, uint16_t l3_len,
+                              uint16_t l4_len, uint16_t tso_segsz)
+{
+    m->ol_flags = (m->ol_flags & ~RTE_MBUF_F_TX_OFFLOAD_MASK) | ol_flags;
+    m->l2_len = l2_len;
+    m->l3_len = l3_len;
+    m->l4_len = l4_len;
+    m->tso_segsz = tso_segsz;
+}
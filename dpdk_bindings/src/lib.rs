@@ -29,7 +29,21 @@ extern "C" {
     fn rte_eth_rx_offload_tcp_cksum_() -> c_int;
     fn rte_eth_rx_offload_udp_cksum_() -> c_int;
     fn rte_eth_tx_offload_multi_segs_() -> c_int;
+    fn rte_eth_rx_offload_ipv4_cksum_() -> c_int;
+    fn rte_eth_tx_offload_ipv4_cksum_() -> c_int;
+    fn rte_eth_tx_offload_tcp_tso_() -> c_int;
     fn rte_pktmbuf_prepend_(m: *mut rte_mbuf, len: u16) -> *mut c_char;
+    fn rte_eth_tx_prepare_(port_id: u16, queue_id: u16, tx_pkts: *mut *mut rte_mbuf, nb_pkts: u16) -> u16;
+    fn rte_mbuf_f_tx_ipv4_() -> u64;
+    fn rte_mbuf_f_tx_ip_cksum_() -> u64;
+    fn rte_mbuf_f_tx_tcp_cksum_() -> u64;
+    fn rte_mbuf_f_tx_udp_cksum_() -> u64;
+    fn rte_mbuf_f_tx_tcp_seg_() -> u64;
+    fn rte_mbuf_f_rx_ip_cksum_mask_() -> u64;
+    fn rte_mbuf_f_rx_ip_cksum_bad_() -> u64;
+    fn rte_mbuf_f_rx_l4_cksum_mask_() -> u64;
+    fn rte_mbuf_f_rx_l4_cksum_bad_() -> u64;
+    fn rte_mbuf_set_tx_offload_(m: *mut rte_mbuf, ol_flags: u64, l2_len: u16, l3_len: u16, l4_len: u16, tso_segsz: u16);
 }
 
 #[cfg(all(feature = "mlx5", target_os = "windows"))]
@@ -147,6 +161,21 @@ pub unsafe fn rte_eth_rx_offload_udp_cksum() -> c_int {
     rte_eth_rx_offload_udp_cksum_()
 }
 
+#[inline]
+pub unsafe fn rte_eth_rx_offload_ipv4_cksum() -> c_int {
+    rte_eth_rx_offload_ipv4_cksum_()
+}
+
+#[inline]
+pub unsafe fn rte_eth_tx_offload_ipv4_cksum() -> c_int {
+    rte_eth_tx_offload_ipv4_cksum_()
+}
+
+#[inline]
+pub unsafe fn rte_eth_tx_offload_tcp_tso() -> c_int {
+    rte_eth_tx_offload_tcp_tso_()
+}
+
 #[inline]
 pub unsafe fn rte_eth_tx_offload_multi_segs() -> c_int {
     rte_eth_tx_offload_multi_segs_()
@@ -156,3 +185,65 @@ pub unsafe fn rte_eth_tx_offload_multi_segs() -> c_int {
 pub unsafe fn rte_pktmbuf_prepend(m: *mut rte_mbuf, len: u16) -> *mut c_char {
     rte_pktmbuf_prepend_(m, len)
 }
+
+#[inline]
+pub unsafe fn rte_eth_tx_prepare(port_id: u16, queue_id: u16, tx_pkts: *mut *mut rte_mbuf, nb_pkts: u16) -> u16 {
+    rte_eth_tx_prepare_(port_id, queue_id, tx_pkts, nb_pkts)
+}
+
+#[inline]
+pub unsafe fn rte_mbuf_f_tx_ipv4() -> u64 {
+    rte_mbuf_f_tx_ipv4_()
+}
+
+#[inline]
+pub unsafe fn rte_mbuf_f_tx_ip_cksum() -> u64 {
+    rte_mbuf_f_tx_ip_cksum_()
+}
+
+#[inline]
+pub unsafe fn rte_mbuf_f_tx_tcp_cksum() -> u64 {
+    rte_mbuf_f_tx_tcp_cksum_()
+}
+
+#[inline]
+pub unsafe fn rte_mbuf_f_tx_udp_cksum() -> u64 {
+    rte_mbuf_f_tx_udp_cksum_()
+}
+
+#[inline]
+pub unsafe fn rte_mbuf_f_tx_tcp_seg() -> u64 {
+    rte_mbuf_f_tx_tcp_seg_()
+}
+
+#[inline]
+pub unsafe fn rte_mbuf_f_rx_ip_cksum_mask() -> u64 {
+    rte_mbuf_f_rx_ip_cksum_mask_()
+}
+
+#[inline]
+pub unsafe fn rte_mbuf_f_rx_ip_cksum_bad() -> u64 {
+    rte_mbuf_f_rx_ip_cksum_bad_()
+}
+
+#[inline]
+pub unsafe fn rte_mbuf_f_rx_l4_cksum_mask() -> u64 {
+    rte_mbuf_f_rx_l4_cksum_mask_()
+}
+
+#[inline]
+pub unsafe fn rte_mbuf_f_rx_l4_cksum_bad() -> u64 {
+    rte_mbuf_f_rx_l4_cksum_bad_()
+}
+
+#[inline]
+pub unsafe fn rte_mbuf_set_tx_offload(
+    m: *mut rte_mbuf,
+    ol_flags: u64,
+    l2_len: u16,
+    l3_len: u16,
+    l4_len: u16,
+    tso_segsz: u16,
+) {
+    rte_mbuf_set_tx_offload_(m, ol_flags, l2_len, l3_len, l4_len, tso_segsz)
+}
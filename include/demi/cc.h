@@ -13,7 +13,9 @@
 #define _In_reads_(s)
 #define _In_reads_bytes_(b)
 #define _Out_
+#define _Out_writes_(s)
 #define _Out_writes_to_(s, c)
+#define _Inout_updates_bytes_(b)
 #define _Deref_pre_z_
 #endif
 
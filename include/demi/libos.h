@@ -45,6 +45,28 @@ extern "C"
     ATTR_NONNULL(1)
     extern int demi_socket(_Out_ int *sockqd_out, _In_ int domain, _In_ int type, _In_ int protocol);
 
+    /**
+     * @brief Creates a pipe I/O queue that another process opens with demi_open_pipe().
+     *
+     * @param memqd_out Storage location for the pipe I/O queue descriptor.
+     * @param name      Name of the pipe.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1, 2)
+    extern int demi_create_pipe(_Out_ int *memqd_out, _In_ const char *name);
+
+    /**
+     * @brief Opens a pipe I/O queue that another process created with demi_create_pipe().
+     *
+     * @param memqd_out Storage location for the pipe I/O queue descriptor.
+     * @param name      Name of the pipe.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1, 2)
+    extern int demi_open_pipe(_Out_ int *memqd_out, _In_ const char *name);
+
     /**
      * @brief Sets as passive a socket I/O queue.
      *
@@ -139,6 +161,57 @@ extern "C"
     ATTR_NONNULL(1)
     extern int demi_pop(_Out_ demi_qtoken_t *qt_out, _In_ int qd);
 
+    /**
+     * @brief Asynchronously pushes a batch of scatter-gather arrays to I/O queues.
+     *
+     * @param qts_out    Store locations for the I/O queue tokens, one for each operation.
+     * @param qds        Target I/O queue descriptors, where sgas[i] is pushed to qds[i].
+     * @param sgas       Scatter-gather arrays to push.
+     * @param n          Number of operations in the batch.
+     * @param nsubmitted Store location for the number of operations that were issued.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead, and
+     * the operations that follow the one that failed are not issued.
+     */
+    ATTR_NONNULL(1, 2, 3, 5)
+    extern int demi_push_n(_Out_writes_(n) demi_qtoken_t qts_out[], _In_reads_(n) const int qds[],
+                           _In_reads_(n) const demi_sgarray_t sgas[], _In_ int n, _Out_ int *nsubmitted);
+
+    /**
+     * @brief Asynchronously pushes a batch of scatter-gather arrays to UDP sockets.
+     *
+     * @param qts_out    Store locations for the I/O queue tokens, one for each operation.
+     * @param sockqds    I/O queue descriptors of the target sockets, where sgas[i] is pushed on sockqds[i].
+     * @param sgas       Scatter-gather arrays to push.
+     * @param dest_addrs Addresses of the destination hosts, where sgas[i] is pushed to dest_addrs[i].
+     * @param size       Effective size of every socket address data structure.
+     * @param n          Number of operations in the batch.
+     * @param nsubmitted Store location for the number of operations that were issued.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead, and
+     * the operations that follow the one that failed are not issued.
+     */
+    ATTR_NONNULL(1, 2, 3, 4, 7)
+    extern int demi_pushto_n(_Out_writes_(n) demi_qtoken_t qts_out[], _In_reads_(n) const int sockqds[],
+                             _In_reads_(n) const demi_sgarray_t sgas[],
+                             _In_reads_(n) const struct sockaddr *const dest_addrs[], _In_ socklen_t size, _In_ int n,
+                             _Out_ int *nsubmitted);
+
+    /**
+     * @brief Asynchronously pops scatter-gather arrays from a batch of I/O queues.
+     *
+     * @param qts_out    Store locations for the I/O queue tokens, one for each operation.
+     * @param qds        Target I/O queue descriptors.
+     * @param n          Number of operations in the batch.
+     * @param nsubmitted Store location for the number of operations that were issued.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead, and
+     * the operations that follow the one that failed are not issued.
+     */
+    ATTR_NONNULL(1, 2, 4)
+    extern int demi_pop_n(_Out_writes_(n) demi_qtoken_t qts_out[], _In_reads_(n) const int qds[], _In_ int n,
+                          _Out_ int *nsubmitted);
+
     /**
      * @brief Sets socket options.
      *
@@ -178,6 +251,17 @@ extern "C"
     ATTR_NONNULL(2)
     extern int demi_getpeername(_In_ int qd, _Out_writes_to_(addrlen, *addrlen) struct sockaddr *addr, _In_ socklen_t *addrlen);
 
+    /**
+     * @brief Returns the statistics of an I/O queue or of the calling thread.
+     *
+     * @param qd        Target I/O queue descriptor, or DEMI_STATS_ALL for the statistics of the calling thread.
+     * @param stats_out Storage location for the statistics.
+     *
+     * @return On success, zero is returned. On failure, a positive error code is returned.
+     */
+    ATTR_NONNULL(2)
+    extern int demi_getstats(_In_ int qd, _Out_ demi_stats_t *stats_out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,7 +16,10 @@ extern "C"
     /**
      * @brief Allocates a scatter-gather array.
      *
-     * @param size Size of the scatter-gather array.
+     * Sizes larger than DEMI_SGASEG_MAXSIZE are spread across several segments, so callers must walk sga_segs up to
+     * sga_numsegs rather than assume a single segment.
+     *
+     * @param size Size of the scatter-gather array (at most DEMI_SGARRAY_MAXSIZE * DEMI_SGASEG_MAXSIZE).
      *
      * @return On successful completion, the allocated scatter-gather array is returned. On error, a null scatter-gather
      * array is returned instead.
@@ -24,6 +27,18 @@ extern "C"
     ATTR_NODISCARD
     extern demi_sgarray_t demi_sgaalloc(_In_ size_t size);
 
+    /**
+     * @brief Allocates a scatter-gather array with multiple segments.
+     *
+     * @param seglens  Size of each segment of the scatter-gather array.
+     * @param numsegs  Number of segments in the scatter-gather array (at most DEMI_SGARRAY_MAXSIZE).
+     *
+     * @return On successful completion, the allocated scatter-gather array is returned. On error, a null scatter-gather
+     * array is returned instead.
+     */
+    ATTR_NODISCARD
+    extern demi_sgarray_t demi_sgaallocv(_In_reads_(numsegs) const size_t seglens[], _In_ uint32_t numsegs);
+
     /**
      * @brief Releases a scatter-gather array.
      *
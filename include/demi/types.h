@@ -25,7 +25,12 @@ extern "C"
 /**
  * @brief Maximum number of segments in a scatter-gather array.
  */
-#define DEMI_SGARRAY_MAXSIZE 1
+#define DEMI_SGARRAY_MAXSIZE 16
+
+/**
+ * @brief Maximum size in bytes of a segment of a scatter-gather array.
+ */
+#define DEMI_SGASEG_MAXSIZE (63 * 1024)
 
     /**
      * @brief An I/O queue token.
@@ -126,11 +131,78 @@ extern "C"
             demi_sgarray_t sga;        /**< Pushed/popped scatter-gather array. */
             demi_accept_result_t ares; /**< Accept result.                      */
         } qr_value;
+        uint32_t qr_pad; /**< Padding to the size of the structure in Rust, which is not packed. */
     } demi_qresult_t;
 #ifdef _WIN32
 #pragma pack(pop)
 #endif
 
+    /**
+     * @brief Header of a completion queue that is shared with Demikernel.
+     *
+     * A completion queue of n entries is a region of DEMI_CQ_SIZE(n) bytes, where n is a power of two. The header is
+     * followed by the entries, which are reached with DEMI_CQ_ENTRIES(). Demikernel writes the entry at index
+     * (cq_tail % n) and then advances cq_tail. The application consumes the entry at index (cq_head % n) and then
+     * advances cq_head. Both indexes only increase, and the queue is empty when they are equal. At most n - 1 entries
+     * are in the queue at a time.
+     */
+    typedef struct demi_cq
+    {
+        uint64_t cq_head; /**< Index of the next entry to consume. Only written by the application. */
+        uint64_t cq_tail; /**< Index of the next entry to produce. Only written by Demikernel.      */
+    } demi_cq_t;
+
+/**
+ * @brief Size in bytes of a completion queue of n entries.
+ */
+#define DEMI_CQ_SIZE(n) (sizeof(demi_cq_t) + (n) * sizeof(demi_qresult_t))
+
+/**
+ * @brief Entries of a completion queue.
+ */
+#define DEMI_CQ_ENTRIES(cq) ((demi_qresult_t *)((demi_cq_t *)(cq) + 1))
+
+/**
+ * @brief I/O queue descriptor that demi_getstats() takes for the statistics of the calling thread.
+ */
+#define DEMI_STATS_ALL (-1)
+
+    /**
+     * @brief Summary of a latency histogram. Latencies are in nanoseconds and percentiles are within 1/16 of the true
+     * value.
+     */
+    typedef struct demi_latency
+    {
+        uint64_t count;   /**< Number of samples.   */
+        uint64_t min_ns;  /**< Smallest sample.     */
+        uint64_t mean_ns; /**< Mean of the samples. */
+        uint64_t p50_ns;  /**< Median.              */
+        uint64_t p99_ns;  /**< 99th percentile.     */
+        uint64_t p999_ns; /**< 99.9th percentile.   */
+        uint64_t max_ns;  /**< Largest sample.      */
+    } demi_latency_t;
+
+    /**
+     * @brief Statistics of an I/O queue or of a thread. Counters only increase, so rates are differences between two
+     * snapshots. A push completes once it is acknowledged only on TCP sockets of the catnip and catpowder LibOSes.
+     * Elsewhere, it completes once the data was handed to the kernel or the device, so push_completion is not a round
+     * trip time.
+     */
+    typedef struct demi_stats
+    {
+        uint64_t packets_in;            /**< Packets received.                                          */
+        uint64_t packets_out;           /**< Packets sent.                                              */
+        uint64_t bytes_in;              /**< Bytes received.                                            */
+        uint64_t bytes_out;             /**< Bytes sent.                                                */
+        uint64_t drops;                 /**< Packets dropped.                                           */
+        uint64_t retransmits;           /**< TCP segments sent again.                                   */
+        uint64_t rto_fires;             /**< Expirations of the TCP retransmission timer.               */
+        uint64_t ooo_bytes;             /**< TCP bytes that arrived out of order.                       */
+        uint64_t mempool_exhausted;     /**< Allocations that failed because a memory pool was empty.   */
+        demi_latency_t push_completion; /**< Time from a push until it completes (see demi_getstats()). */
+        demi_latency_t pop_wait;        /**< Time from a pop until data is available.                   */
+    } demi_stats_t;
+
     // Callback Function.
     typedef void (*demi_callback_t)(const char *, uint32_t, uint64_t);
 
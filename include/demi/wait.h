@@ -57,6 +57,87 @@ extern "C"
     extern int demi_wait_next_n(_Out_writes_to_(num_qrs, *ready_offset) demi_qresult_t *qr_out, _In_ int num_qrs,
                                 _Out_ int *num_qrs_out, _In_opt_ const struct timespec *timeout);
 
+    /**
+     * @brief Creates an empty wait set.
+     *
+     * @param wsd_out Store location for the descriptor of the new wait set.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_waitset_create(_Out_ int *wsd_out);
+
+    /**
+     * @brief Releases a wait set. Pending I/O operations in the wait set are not affected.
+     *
+     * @param wsd Target wait set descriptor.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_waitset_close(_In_ int wsd);
+
+    /**
+     * @brief Adds a pending asynchronous I/O operation to a wait set. An I/O operation belongs to at most one wait set.
+     *
+     * @param wsd Target wait set descriptor.
+     * @param qt  I/O queue token of the target operation.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_waitset_add(_In_ int wsd, _In_ demi_qtoken_t qt);
+
+    /**
+     * @brief Removes a pending asynchronous I/O operation from a wait set.
+     *
+     * @param wsd Target wait set descriptor.
+     * @param qt  I/O queue token of the target operation.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_waitset_remove(_In_ int wsd, _In_ demi_qtoken_t qt);
+
+    /**
+     * @brief Waits for the first asynchronous I/O operation in a wait set to complete. The completed I/O operation
+     * leaves the wait set. Unlike demi_wait_any(), the cost of this call does not depend on the number of I/O
+     * operations in the wait set.
+     *
+     * @param qr_out  Store location for the result of the completed I/O operation.
+     * @param wsd     Target wait set descriptor.
+     * @param timeout Timeout interval in seconds and nanoseconds.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_waitset_wait(_Out_ demi_qresult_t *qr_out, _In_ int wsd, _In_opt_ const struct timespec *timeout);
+
+    /**
+     * @brief Registers a completion queue. Results of asynchronous I/O operations that complete while the application
+     * is not waiting on them are written into the completion queue, from where the application reads them directly.
+     * Results that do not fit in the completion queue, and results of operations in a wait set, are kept until they
+     * are waited on instead.
+     *
+     * @param cq   Memory region of the completion queue. It must remain valid until demi_cq_unregister() is called.
+     * @param size Size in bytes of the memory region, as given by DEMI_CQ_SIZE().
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    ATTR_NONNULL(1)
+    extern int demi_cq_register(_Inout_updates_bytes_(size) demi_cq_t *cq, _In_ size_t size);
+
+    /**
+     * @brief Unregisters the completion queue.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_cq_unregister(void);
+
+    /**
+     * @brief Runs asynchronous I/O operations that are ready to make progress, without waiting for any of them.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_poll(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -242,4 +242,11 @@ test-clean:
 #=======================================================================================================================
 
 run-benchmarks-c: all-benchmarks-c $(BINDIR)/syscalls.elf
-	timeout $(TIMEOUT_SECONDS) $(BINDIR)/benchmarks.elf
+	timeout $(TIMEOUT_SECONDS) $(BINDIR)/benchmarks.elf $(ARGS)
+
+# Replays the frames that a host received in the pcap capture at PCAP through inetstack. The results are printed on a
+# line of their own, which "tools/benchmark.py compare" reads.
+export PCAP ?=
+
+run-replay-rust:
+	timeout $(TIMEOUT_SECONDS) $(CARGO) test --lib $(CARGO_FLAGS) $(CARGO_FEATURES) -- --nocapture --exact inetstack::test_helpers::replay::test::test_replay_pcap
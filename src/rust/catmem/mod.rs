@@ -0,0 +1,341 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+mod queue;
+mod ring;
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    catmem::queue::SharedCatmemQueue,
+    demikernel::config::Config,
+    runtime::{
+        completion_queue::{CompletionQueue, ResultFormatter},
+        fail::Fail,
+        limits,
+        memory::{buffer_into_sgarray, DemiBuffer, MemoryRuntime},
+        queue::{downcast_queue, OperationResult},
+        types::{demi_opcode_t, demi_qr_value_t, demi_qresult_t, demi_sgarray_t},
+        QDesc, QToken, SharedDemiRuntime, SharedObject, TaskId, WaitSetId,
+    },
+};
+use ::futures::FutureExt;
+use ::std::{
+    mem,
+    ops::{Deref, DerefMut},
+    time::Duration,
+};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// [CatmemLibOS] provides the Demikernel API on top of pipes between processes. A pipe is a pair of lock-free rings on
+/// shared memory. Pushes copy their data into a ring and pops copy it back out, so no system call is made.
+pub struct CatmemLibOS {
+    runtime: SharedDemiRuntime,
+    /// Size of the shared memory region of each ring.
+    ring_size: usize,
+    /// Do rings live on hugepages?
+    hugepages: bool,
+    /// How long pops check an empty ring on every pass of the scheduler.
+    spin: Duration,
+    /// How long pops wait between checks of an empty ring after that. Zero means that they keep checking on every pass.
+    sleep: Duration,
+}
+
+#[derive(Clone)]
+pub struct SharedCatmemLibOS(SharedObject<CatmemLibOS>);
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl SharedCatmemLibOS {
+    pub fn new(config: &Config, runtime: SharedDemiRuntime) -> Result<Self, Fail> {
+        Ok(Self(SharedObject::new(CatmemLibOS {
+            runtime,
+            ring_size: config.catmem_ring_size()?,
+            hugepages: config.catmem_hugepages()?,
+            spin: config.catmem_spin()?,
+            sleep: config.catmem_sleep()?,
+        })))
+    }
+
+    /// Creates the pipe named `name` and returns a queue for its creating end.
+    pub fn create_pipe(&mut self, name: &str) -> Result<QDesc, Fail> {
+        trace!("create_pipe() name={:?}", name);
+        let task_group: TaskId = self.runtime.create_task_group();
+        match SharedCatmemQueue::create(name, self.ring_size, self.hugepages, task_group) {
+            Ok(queue) => Ok(self.runtime.alloc_queue(queue)),
+            Err(e) => {
+                self.runtime.remove_task_group(task_group);
+                Err(e)
+            },
+        }
+    }
+
+    /// Opens the pipe named `name`, which another process created, and returns a queue for its opening end.
+    pub fn open_pipe(&mut self, name: &str) -> Result<QDesc, Fail> {
+        trace!("open_pipe() name={:?}", name);
+        let task_group: TaskId = self.runtime.create_task_group();
+        match SharedCatmemQueue::open(name, self.ring_size, self.hugepages, task_group) {
+            Ok(queue) => Ok(self.runtime.alloc_queue(queue)),
+            Err(e) => {
+                self.runtime.remove_task_group(task_group);
+                Err(e)
+            },
+        }
+    }
+
+    /// Closes a queue. Pending operations on it fail and the other end of the pipe sees its end once it has popped
+    /// everything that was pushed.
+    pub fn async_close(&mut self, qd: QDesc) -> Result<QToken, Fail> {
+        trace!("async_close() qd={:?}", qd);
+        let mut queue: SharedCatmemQueue = self.get_shared_queue(&qd)?;
+        queue.close();
+        let coroutine = Box::pin(self.clone().close_coroutine(qd).fuse());
+        self.runtime
+            .insert_io_coroutine_with_group_id(queue.task_group(), "ioc::catmem::close", coroutine)
+    }
+
+    async fn close_coroutine(mut self, qd: QDesc) -> (QDesc, OperationResult) {
+        // Other coroutines of the queue hold references to it and fail the next time they run.
+        match self.runtime.free_queue::<SharedCatmemQueue>(&qd) {
+            Ok(queue) => {
+                // The task group goes away once its last coroutine, which may be this one, completes.
+                self.runtime.remove_task_group(queue.task_group());
+                (qd, OperationResult::Close)
+            },
+            Err(e) => (qd, OperationResult::Failed(e)),
+        }
+    }
+
+    /// Pushes every segment of `sga` as a message to a queue.
+    pub fn push(&mut self, qd: QDesc, sga: &demi_sgarray_t) -> Result<QToken, Fail> {
+        trace!("push() qd={:?}", qd);
+        let buf: DemiBuffer = self.clone_sgarray(sga)?;
+        if buf.total_len() == 0 {
+            let cause: &str = "zero-length buffer";
+            warn!("push(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, cause));
+        }
+
+        let queue: SharedCatmemQueue = self.get_shared_queue(&qd)?;
+        let coroutine = Box::pin(self.clone().push_coroutine(qd, queue.clone(), buf).fuse());
+        self.runtime
+            .insert_io_coroutine_with_group_id(queue.task_group(), "ioc::catmem::push", coroutine)
+    }
+
+    async fn push_coroutine(
+        self,
+        qd: QDesc,
+        mut queue: SharedCatmemQueue,
+        buf: DemiBuffer,
+    ) -> (QDesc, OperationResult) {
+        match queue.push_coroutine(buf).await {
+            Ok(()) => (qd, OperationResult::Push),
+            Err(e) => {
+                warn!("push() qd={:?}: {:?}", qd, &e);
+                (qd, OperationResult::Failed(e))
+            },
+        }
+    }
+
+    /// Pops the next message, or at most `size` bytes of it, from a queue.
+    pub fn pop(&mut self, qd: QDesc, size: Option<usize>) -> Result<QToken, Fail> {
+        trace!("pop() qd={:?}, size={:?}", qd, size);
+
+        // We just assert 'size' here, because it was previously checked at PDPIX layer.
+        debug_assert!(size.is_none() || ((size.unwrap() > 0) && (size.unwrap() <= limits::POP_SIZE_MAX)));
+
+        let queue: SharedCatmemQueue = self.get_shared_queue(&qd)?;
+        let coroutine = Box::pin(self.clone().pop_coroutine(qd, queue.clone(), size).fuse());
+        self.runtime
+            .insert_io_coroutine_with_group_id(queue.task_group(), "ioc::catmem::pop", coroutine)
+    }
+
+    async fn pop_coroutine(
+        self,
+        qd: QDesc,
+        mut queue: SharedCatmemQueue,
+        size: Option<usize>,
+    ) -> (QDesc, OperationResult) {
+        match queue.pop_coroutine(size, self.spin, self.sleep).await {
+            Ok(buf) => (qd, OperationResult::Pop(None, buf)),
+            Err(e) => {
+                warn!("pop() qd={:?}: {:?}", qd, &e);
+                (qd, OperationResult::Failed(e))
+            },
+        }
+    }
+
+    /// Waits for a pending I/O operation to complete or a timeout to expire.
+    /// This is just a single-token convenience wrapper for wait_any().
+    pub fn wait(&mut self, qt: QToken, timeout: Duration) -> Result<demi_qresult_t, Fail> {
+        trace!("wait(): qt={:?}, timeout={:?}", qt, timeout);
+        let (offset, qr): (usize, demi_qresult_t) = self.wait_any(&[qt], timeout)?;
+        debug_assert_eq!(offset, 0);
+        Ok(qr)
+    }
+
+    /// Waits for any of the given pending I/O operations to complete or a timeout to expire.
+    pub fn wait_any(&mut self, qts: &[QToken], timeout: Duration) -> Result<(usize, demi_qresult_t), Fail> {
+        let (offset, qt, qd, result) = self.runtime.wait_any(qts, timeout)?;
+        Ok((offset, create_result(result, qd, qt)))
+    }
+
+    /// Creates an empty wait set.
+    pub fn create_wait_set(&mut self) -> WaitSetId {
+        trace!("create_wait_set()");
+        self.runtime.create_wait_set()
+    }
+
+    /// Releases a wait set.
+    pub fn close_wait_set(&mut self, wsd: WaitSetId) -> Result<(), Fail> {
+        trace!("close_wait_set(): wsd={:?}", wsd);
+        self.runtime.close_wait_set(wsd)
+    }
+
+    /// Adds a pending I/O operation to a wait set.
+    pub fn wait_set_add(&mut self, wsd: WaitSetId, qt: QToken) -> Result<(), Fail> {
+        trace!("wait_set_add(): wsd={:?}, qt={:?}", wsd, qt);
+        self.runtime.wait_set_add(wsd, qt)
+    }
+
+    /// Removes a pending I/O operation from a wait set.
+    pub fn wait_set_remove(&mut self, wsd: WaitSetId, qt: QToken) -> Result<(), Fail> {
+        trace!("wait_set_remove(): wsd={:?}, qt={:?}", wsd, qt);
+        self.runtime.wait_set_remove(wsd, qt)
+    }
+
+    /// Waits for any of the pending I/O operations in a wait set to complete or a timeout to expire.
+    pub fn wait_set_wait(&mut self, wsd: WaitSetId, timeout: Duration) -> Result<demi_qresult_t, Fail> {
+        let (qt, qd, result) = self.runtime.wait_set_wait(wsd, timeout)?;
+        Ok(create_result(result, qd, qt))
+    }
+
+    /// Waits in a loop until the next task is complete, passing the result to `acceptor`. This process continues until
+    /// either the acceptor returns false (in which case the method returns Ok), or the timeout has expired (in which
+    /// the method returns an `Err` indicating timeout).
+    pub fn wait_next_n<Acceptor: FnMut(demi_qresult_t) -> bool>(
+        &mut self,
+        mut acceptor: Acceptor,
+        timeout: Duration,
+    ) -> Result<(), Fail> {
+        self.runtime
+            .wait_next_n(|qt, qd, result| acceptor(create_result(result, qd, qt)), timeout)
+    }
+
+    /// Registers a completion queue in the `size` bytes of application memory at `ptr`.
+    pub fn register_completion_queue(&mut self, ptr: *mut u8, size: usize) -> Result<(), Fail> {
+        trace!("register_completion_queue(): ptr={:?}, size={:?}", ptr, size);
+        let format: ResultFormatter =
+            Box::new(|qt: QToken, qd: QDesc, result: OperationResult| create_result(result, qd, qt));
+        let cq: CompletionQueue = CompletionQueue::from_raw_parts(ptr, size, format)?;
+        self.runtime.register_completion_queue(cq)
+    }
+
+    /// Unregisters the completion queue.
+    pub fn unregister_completion_queue(&mut self) -> Result<(), Fail> {
+        trace!("unregister_completion_queue()");
+        self.runtime.unregister_completion_queue()
+    }
+
+    /// Runs all runnable coroutines.
+    pub fn poll(&mut self) {
+        self.runtime.poll()
+    }
+
+    fn get_shared_queue(&self, qd: &QDesc) -> Result<SharedCatmemQueue, Fail> {
+        self.runtime.get_shared_queue::<SharedCatmemQueue>(qd)
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Converts the result of a completed operation into its representation for the application.
+fn create_result(result: OperationResult, qd: QDesc, qt: QToken) -> demi_qresult_t {
+    let failed = |e: Fail| -> demi_qresult_t {
+        warn!("Operation Failed: {:?}", e);
+        demi_qresult_t {
+            qr_opcode: demi_opcode_t::DEMI_OPC_FAILED,
+            qr_qd: qd.into(),
+            qr_qt: qt.into(),
+            qr_ret: e.errno as i64,
+            qr_value: unsafe { mem::zeroed() },
+            qr_pad: 0,
+        }
+    };
+    match result {
+        OperationResult::Push => demi_qresult_t {
+            qr_opcode: demi_opcode_t::DEMI_OPC_PUSH,
+            qr_qd: qd.into(),
+            qr_qt: qt.into(),
+            qr_ret: 0,
+            qr_value: unsafe { mem::zeroed() },
+            qr_pad: 0,
+        },
+        OperationResult::Pop(_, bytes) => match buffer_into_sgarray(bytes) {
+            Ok(sga) => demi_qresult_t {
+                qr_opcode: demi_opcode_t::DEMI_OPC_POP,
+                qr_qd: qd.into(),
+                qr_qt: qt.into(),
+                qr_ret: 0,
+                qr_value: demi_qr_value_t { sga },
+                qr_pad: 0,
+            },
+            Err(e) => failed(e),
+        },
+        OperationResult::Close => demi_qresult_t {
+            qr_opcode: demi_opcode_t::DEMI_OPC_CLOSE,
+            qr_qd: qd.into(),
+            qr_qt: qt.into(),
+            qr_ret: 0,
+            qr_value: unsafe { mem::zeroed() },
+            qr_pad: 0,
+        },
+        OperationResult::Failed(e) => failed(e),
+        // Memory queues neither connect nor accept.
+        OperationResult::Connect | OperationResult::Accept(_) => {
+            failed(Fail::new(libc::ENOTSUP, "operation not supported on memory queues"))
+        },
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+/// Scatter-gather arrays come from the heap, like on other LibOSes that have no memory of their own.
+impl MemoryRuntime for SharedCatmemLibOS {}
+
+impl Drop for CatmemLibOS {
+    // Closes all pipes, so that processes on their other ends do not wait for messages that never come.
+    fn drop(&mut self) {
+        for boxed_queue in self.runtime.get_mut_qtable().drain() {
+            match downcast_queue::<SharedCatmemQueue>(boxed_queue) {
+                Ok(mut queue) => queue.close(),
+                Err(_) => error!("drop(): attempting to drop something that is not a SharedCatmemQueue"),
+            }
+        }
+    }
+}
+
+impl Deref for SharedCatmemLibOS {
+    type Target = CatmemLibOS;
+
+    fn deref(&self) -> &Self::Target {
+        self.0.deref()
+    }
+}
+
+impl DerefMut for SharedCatmemLibOS {
+    fn deref_mut(&mut self) -> &mut Self::Target {
+        self.0.deref_mut()
+    }
+}
@@ -0,0 +1,243 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    catmem::ring::PipeRing,
+    collections::shared_ring::SharedRingBuffer,
+    runtime::{
+        fail::Fail,
+        memory::DemiBuffer,
+        poll_yield,
+        queue::{IoQueue, QType},
+        yield_with_timeout, DemiRuntime, SharedObject, TaskId,
+    },
+};
+use ::std::{
+    any::Any,
+    ops::{Deref, DerefMut},
+    time::{Duration, Instant},
+};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// One end of a pipe. A pipe is made of two rings on shared memory, one for each direction, so both ends can push and
+/// pop. Every segment of a pushed scatter-gather array is one message, which a single pop returns, unless the pop asks
+/// for fewer bytes.
+pub struct CatmemQueue {
+    /// Ring that this end pushes to.
+    tx: SharedRingBuffer<PipeRing>,
+    /// Ring that this end pops from.
+    rx: SharedRingBuffer<PipeRing>,
+    /// Rest of the last message that did not fit in the pop that removed it from the ring.
+    pending: Option<DemiBuffer>,
+    /// Was this end closed?
+    closed: bool,
+    /// Task group that runs the coroutines of this queue.
+    task_group: TaskId,
+}
+
+#[derive(Clone)]
+pub struct SharedCatmemQueue(SharedObject<CatmemQueue>);
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl SharedCatmemQueue {
+    /// Creates the pipe named `name` and returns its creating end. Each ring of the pipe takes `ring_size` bytes of
+    /// shared memory, rounded up to the size of a hugepage if `hugepages` is set.
+    pub fn create(name: &str, ring_size: usize, hugepages: bool, task_group: TaskId) -> Result<Self, Fail> {
+        let (to_opener, to_creator): (String, String) = Self::ring_names(name);
+        let tx: SharedRingBuffer<PipeRing> = match hugepages {
+            true => SharedRingBuffer::create_on_hugepages(&to_opener, ring_size)?,
+            false => SharedRingBuffer::create(&to_opener, ring_size)?,
+        };
+        let rx: SharedRingBuffer<PipeRing> = match hugepages {
+            true => SharedRingBuffer::create_on_hugepages(&to_creator, ring_size)?,
+            false => SharedRingBuffer::create(&to_creator, ring_size)?,
+        };
+        Ok(Self::new(tx, rx, task_group))
+    }
+
+    /// Opens the pipe named `name`, which was created with the same `ring_size` and `hugepages`, and returns its
+    /// opening end.
+    pub fn open(name: &str, ring_size: usize, hugepages: bool, task_group: TaskId) -> Result<Self, Fail> {
+        let (to_opener, to_creator): (String, String) = Self::ring_names(name);
+        let tx: SharedRingBuffer<PipeRing> = match hugepages {
+            true => SharedRingBuffer::open_on_hugepages(&to_creator, ring_size)?,
+            false => SharedRingBuffer::open(&to_creator, ring_size)?,
+        };
+        let rx: SharedRingBuffer<PipeRing> = match hugepages {
+            true => SharedRingBuffer::open_on_hugepages(&to_opener, ring_size)?,
+            false => SharedRingBuffer::open(&to_opener, ring_size)?,
+        };
+        Ok(Self::new(tx, rx, task_group))
+    }
+
+    fn new(tx: SharedRingBuffer<PipeRing>, rx: SharedRingBuffer<PipeRing>, task_group: TaskId) -> Self {
+        Self(SharedObject::new(CatmemQueue {
+            tx,
+            rx,
+            pending: None,
+            closed: false,
+            task_group,
+        }))
+    }
+
+    /// Returns the names of the rings that carry messages to the opening end and to the creating end of a pipe.
+    fn ring_names(name: &str) -> (String, String) {
+        (format!("{}.to-opener", name), format!("{}.to-creator", name))
+    }
+
+    /// Returns the task group that runs the coroutines of this queue.
+    pub fn task_group(&self) -> TaskId {
+        self.task_group
+    }
+
+    /// Pushes every segment of `buf` as a message. Messages are copied into the ring as soon as there is room for them.
+    pub async fn push_coroutine(&mut self, buf: DemiBuffer) -> Result<(), Fail> {
+        let max_len: usize = self.tx.max_message_len();
+        if let Some(len) = buf
+            .segments()
+            .map(|segment: &[u8]| segment.len())
+            .find(|len: &usize| *len > max_len)
+        {
+            let cause: String = format!("segment does not fit in the ring (len={:?}, max={:?})", len, max_len);
+            error!("push_coroutine(): {}", cause);
+            return Err(Fail::new(libc::EMSGSIZE, &cause));
+        }
+
+        for segment in buf.segments().filter(|segment: &&[u8]| !segment.is_empty()) {
+            loop {
+                if self.closed {
+                    let cause: &str = "queue was closed";
+                    warn!("push_coroutine(): {}", cause);
+                    return Err(Fail::new(libc::ECANCELED, cause));
+                }
+                // The other end reads nothing once it has closed.
+                if self.rx.is_closed() {
+                    let cause: &str = "other end of the pipe was closed";
+                    warn!("push_coroutine(): {}", cause);
+                    return Err(Fail::new(libc::EPIPE, cause));
+                }
+                match self.tx.try_push(segment) {
+                    Ok(_) => break,
+                    Err(e) if DemiRuntime::should_retry(e.errno) => poll_yield().await,
+                    Err(e) => return Err(e),
+                }
+            }
+        }
+        Ok(())
+    }
+
+    /// Pops the next message, or at most `size` bytes of it. The rest of the message is kept for the next pop. While
+    /// there is nothing to pop, this checks again on every pass of the scheduler for `spin`, and then every `sleep`. An
+    /// empty buffer is returned once the other end is closed and everything it pushed was popped.
+    pub async fn pop_coroutine(
+        &mut self,
+        size: Option<usize>,
+        spin: Duration,
+        sleep: Duration,
+    ) -> Result<DemiBuffer, Fail> {
+        let mut buf: DemiBuffer = match self.pending.take() {
+            Some(buf) => buf,
+            None => self.pop_message(spin, sleep).await?,
+        };
+        if let Some(size) = size {
+            if size < buf.len() {
+                self.pending = Some(buf.split_back(size)?);
+            }
+        }
+        Ok(buf)
+    }
+
+    async fn pop_message(&mut self, spin: Duration, sleep: Duration) -> Result<DemiBuffer, Fail> {
+        let mut idle_since: Option<Instant> = None;
+        loop {
+            if self.closed {
+                let cause: &str = "queue was closed";
+                warn!("pop_coroutine(): {}", cause);
+                return Err(Fail::new(libc::ECANCELED, cause));
+            }
+
+            if let Some(len) = self.rx.peek_len() {
+                let mut buf: DemiBuffer = DemiBuffer::new(len as u16);
+                match self.rx.try_pop(&mut buf[..]) {
+                    Ok(nbytes) => {
+                        buf.trim(len - nbytes)?;
+                        return Ok(buf);
+                    },
+                    // Another process popped that message first, and the next one may be larger.
+                    Err(e) if DemiRuntime::should_retry(e.errno) || e.errno == libc::EINVAL => continue,
+                    Err(e) => return Err(e),
+                }
+            }
+
+            // Check for messages once again after seeing the close, because they may have been pushed before it.
+            if self.rx.is_closed() && self.rx.is_empty() {
+                return Ok(DemiBuffer::new(0));
+            }
+
+            // Waiting on a timer rather than blocking lets the other coroutines run, and lets the runtime put the
+            // thread to sleep according to its idle policy once none of them has anything to do.
+            let now: Instant = Instant::now();
+            match idle_since {
+                Some(since) if !sleep.is_zero() && now.duration_since(since) >= spin => yield_with_timeout(sleep).await,
+                Some(_) => poll_yield().await,
+                None => {
+                    idle_since = Some(now);
+                    poll_yield().await
+                },
+            }
+        }
+    }
+
+    /// Closes this end of the pipe. The other end pops what was already pushed and then sees the end of the pipe.
+    /// Operations that are still pending on this end fail.
+    pub fn close(&mut self) {
+        self.closed = true;
+        self.tx.close();
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl IoQueue for SharedCatmemQueue {
+    fn get_qtype(&self) -> QType {
+        QType::MemoryQueue
+    }
+
+    fn as_any_ref(&self) -> &dyn Any {
+        self
+    }
+
+    fn as_any_mut(&mut self) -> &mut dyn Any {
+        self
+    }
+
+    fn as_any(self: Box<Self>) -> Box<dyn Any> {
+        self
+    }
+}
+
+impl Deref for SharedCatmemQueue {
+    type Target = CatmemQueue;
+
+    fn deref(&self) -> &Self::Target {
+        self.0.deref()
+    }
+}
+
+impl DerefMut for SharedCatmemQueue {
+    fn deref_mut(&mut self) -> &mut Self::Target {
+        self.0.deref_mut()
+    }
+}
@@ -0,0 +1,149 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    collections::{concurrent_ring::ConcurrentRingBuffer, ring::Ring},
+    pal::CPU_DATA_CACHE_LINE_SIZE_IN_BYTES,
+    runtime::fail::Fail,
+};
+use ::std::{
+    mem,
+    sync::atomic::{self, AtomicU32},
+};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// State that the two ends of a pipe share next to the messages of a ring. It fills a cache line of its own, so that
+/// checking it does not bounce the cache lines that hold the offsets of the ring.
+#[repr(C)]
+struct ControlBlock {
+    /// Non-zero once the producing end of the pipe is closed.
+    closed: AtomicU32,
+}
+
+/// A ring of variable-sized messages on shared memory, which the producing end may close.
+pub struct PipeRing {
+    control: *const ControlBlock,
+    ring: ConcurrentRingBuffer,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl PipeRing {
+    /// Attempts to push a message. Fails with `EAGAIN` if the ring is full.
+    pub fn try_push(&self, buf: &[u8]) -> Result<usize, Fail> {
+        self.ring.try_push(buf)
+    }
+
+    /// Returns the length in bytes of the largest message that fits in the ring.
+    pub fn max_message_len(&self) -> usize {
+        self.ring.max_message_len()
+    }
+
+    /// Returns the length of the next message, if any.
+    pub fn peek_len(&self) -> Option<usize> {
+        self.ring.peek_len()
+    }
+
+    /// Attempts to pop the next message into `buf`. Fails with `EAGAIN` if there is none and with `EINVAL` if it does
+    /// not fit in `buf`.
+    pub fn try_pop(&self, buf: &mut [u8]) -> Result<usize, Fail> {
+        self.ring.try_pop(buf)
+    }
+
+    /// Checks if the ring holds no messages.
+    pub fn is_empty(&self) -> bool {
+        self.ring.is_empty()
+    }
+
+    /// Marks the ring as closed. Messages that are already in the ring can still be popped.
+    pub fn close(&self) {
+        self.control().closed.store(1, atomic::Ordering::Release);
+    }
+
+    /// Checks if the ring was closed.
+    pub fn is_closed(&self) -> bool {
+        self.control().closed.load(atomic::Ordering::Acquire) != 0
+    }
+
+    fn control(&self) -> &ControlBlock {
+        // The control block lives as long as the shared memory region that holds this ring.
+        unsafe { &*self.control }
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Ring for PipeRing {
+    /// Constructs a ring on the `size` bytes at `ptr`. The control block takes the first cache line and the messages
+    /// take the rest.
+    fn from_raw_parts(init: bool, ptr: *mut u8, size: usize) -> Result<Self, Fail> {
+        const _: () = assert!(mem::size_of::<ControlBlock>() <= CPU_DATA_CACHE_LINE_SIZE_IN_BYTES);
+        if ptr.is_null() || ptr.align_offset(mem::align_of::<ControlBlock>()) != 0 {
+            let cause: &str = "cannot construct a pipe ring from a null or unaligned pointer";
+            error!("from_raw_parts(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, cause));
+        }
+        if size <= CPU_DATA_CACHE_LINE_SIZE_IN_BYTES {
+            let cause: String = format!("cannot construct a pipe ring with insufficient space (size={:?})", size);
+            error!("from_raw_parts(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        let control: *const ControlBlock = ptr as *const ControlBlock;
+        if init {
+            let control: &ControlBlock = unsafe { &*control };
+            control.closed.store(0, atomic::Ordering::Relaxed);
+        }
+        let ring: ConcurrentRingBuffer = ConcurrentRingBuffer::from_raw_parts(
+            init,
+            unsafe { ptr.add(CPU_DATA_CACHE_LINE_SIZE_IN_BYTES) },
+            size - CPU_DATA_CACHE_LINE_SIZE_IN_BYTES,
+        )?;
+        Ok(Self { control, ring })
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::{catmem::ring::PipeRing, collections::shared_ring::SharedRingBuffer};
+    use ::anyhow::Result;
+
+    /// Size of the shared memory regions of the rings that are used in tests.
+    const RING_SIZE: usize = 4096;
+
+    /// Tests if messages pushed on one end of a ring are popped on the other end, and if closing it is seen there.
+    #[test]
+    fn pipe_ring_push_pop_close() -> Result<()> {
+        let creator: SharedRingBuffer<PipeRing> = SharedRingBuffer::create("catmem-test-pipe-ring-close", RING_SIZE)?;
+        let opener: SharedRingBuffer<PipeRing> = SharedRingBuffer::open("catmem-test-pipe-ring-close", RING_SIZE)?;
+
+        crate::ensure_eq!(creator.try_push(b"hello")?, 5);
+        crate::ensure_eq!(opener.peek_len(), Some(5));
+
+        let mut buf: [u8; 8] = [0; 8];
+        crate::ensure_eq!(opener.try_pop(&mut buf)?, 5);
+        crate::ensure_eq!(&buf[..5], b"hello");
+        crate::ensure_eq!(opener.peek_len(), None::<usize>);
+
+        crate::ensure_eq!(opener.is_closed(), false);
+        creator.close();
+        crate::ensure_eq!(opener.is_closed(), true);
+
+        Ok(())
+    }
+}
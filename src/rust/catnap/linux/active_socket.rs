@@ -8,21 +8,50 @@
 use crate::{
     catnap::transport::get_libc_err,
     collections::{async_queue::AsyncQueue, async_value::SharedAsyncValue},
-    expect_ok,
-    runtime::{fail::Fail, limits, memory::DemiBuffer, DemiRuntime},
+    expect_ok, expect_some,
+    perftools::stats::{self, Counter},
+    runtime::{fail::Fail, limits, memory::DemiBuffer, types::DEMI_SGARRAY_MAXLEN, DemiRuntime},
 };
-use ::socket2::Socket;
-use ::std::{cmp::min, io, mem::MaybeUninit, net::SocketAddr};
+use ::arrayvec::ArrayVec;
+use ::socket2::{SockAddr, Socket};
+use ::std::{
+    cmp::min,
+    collections::VecDeque,
+    io::{self, IoSlice},
+    mem::{self, MaybeUninit},
+    net::SocketAddr,
+    os::fd::{AsRawFd, RawFd},
+    ptr,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Maximum number of datagrams that the kernel segments out of a single send (`UDP_MAX_SEGMENTS` in Linux).
+const UDP_MAX_SEGMENTS: usize = 64;
+
+/// Maximum payload of a datagram that the kernel segments, which is bound by the maximum size of an IPv4 packet.
+const UDP_MAX_PAYLOAD_SIZE: usize = u16::MAX as usize - 20 - 8;
+
+/// Size of the buffers for receives on sockets where the kernel may coalesce datagrams.
+const UDP_GRO_RECV_SIZE: u16 = u16::MAX;
+
+/// Room for the one control message that comes with segmented sends and coalesced receives. It is made of words, so that
+/// it is aligned for a `struct cmsghdr`, and is larger than `CMSG_SPACE(sizeof(int))`.
+type ControlBuffer = [u64; 4];
 
 //======================================================================================================================
 // Structures
 //======================================================================================================================
 
-/// This structure represents outgoing packets.
-struct Outgoing {
-    addr: Option<SocketAddr>,
-    buf: DemiBuffer,
-    result: SharedAsyncValue<Option<Result<(), Fail>>>,
+/// This structure represents outgoing packets. The segments of a chained buffer are sent with a single vectored
+/// write: `buf` is the segment that goes out first and `rest` holds the ones that follow it.
+pub struct Outgoing {
+    pub addr: Option<SocketAddr>,
+    pub buf: DemiBuffer,
+    pub rest: VecDeque<DemiBuffer>,
+    pub result: SharedAsyncValue<Option<Result<(), Fail>>>,
 }
 
 /// This structure represents the metadata for an active established socket: the socket itself and the queue of
@@ -32,6 +61,13 @@ pub struct ActiveSocketData {
     send_queue: AsyncQueue<Outgoing>,
     recv_queue: AsyncQueue<Result<(Option<SocketAddr>, DemiBuffer), Fail>>,
     closed: bool,
+    /// Whether a send is in flight on io_uring. Sends go out one at a time, so that they stay in order.
+    sending: bool,
+    /// Whether consecutive datagrams to the same destination are handed to the kernel with a single send, so that it
+    /// segments them (`UDP_SEGMENT`).
+    udp_gso: bool,
+    /// Whether the kernel may coalesce datagrams from the same source into a single receive (`UDP_GRO`).
+    udp_gro: bool,
 }
 
 //======================================================================================================================
@@ -45,6 +81,44 @@ impl ActiveSocketData {
             send_queue: AsyncQueue::default(),
             recv_queue: AsyncQueue::default(),
             closed: false,
+            sending: false,
+            udp_gso: false,
+            udp_gro: false,
+        }
+    }
+
+    /// Turns on UDP segmentation offload for sends and UDP receive offload for receives, if the kernel supports them.
+    /// This is only for datagram sockets whose I/O goes through [ActiveSocketData::poll_send] and
+    /// [ActiveSocketData::poll_recv].
+    pub fn enable_udp_offloads(&mut self) {
+        let fd: RawFd = self.socket.as_raw_fd();
+        // Kernels that support segmentation offload let us read the default segment size.
+        let mut segment_size: libc::c_int = 0;
+        let mut len: libc::socklen_t = mem::size_of::<libc::c_int>() as libc::socklen_t;
+        self.udp_gso = unsafe {
+            libc::getsockopt(
+                fd,
+                libc::SOL_UDP,
+                libc::UDP_SEGMENT,
+                &mut segment_size as *mut libc::c_int as *mut libc::c_void,
+                &mut len,
+            )
+        } == 0;
+        let enable: libc::c_int = 1;
+        self.udp_gro = unsafe {
+            libc::setsockopt(
+                fd,
+                libc::SOL_UDP,
+                libc::UDP_GRO,
+                &enable as *const libc::c_int as *const libc::c_void,
+                mem::size_of::<libc::c_int>() as libc::socklen_t,
+            )
+        } == 0;
+        if !self.udp_gso || !self.udp_gro {
+            warn!(
+                "enable_udp_offloads(): kernel does not support all UDP offloads (gso={:?}, gro={:?})",
+                self.udp_gso, self.udp_gro
+            );
         }
     }
 
@@ -52,9 +126,13 @@ impl ActiveSocketData {
     /// buffer for write to indicate that we want to know when the socket is ready for writing but do not have data to
     /// write (i.e., to detect when connect finishes).
     pub fn poll_send(&mut self) {
+        if self.udp_gso && self.poll_send_segmented() {
+            return;
+        }
         if let Some(Outgoing {
             addr,
             mut buf,
+            mut rest,
             mut result,
         }) = self.send_queue.try_pop()
         {
@@ -64,31 +142,52 @@ impl ActiveSocketData {
                 return;
             }
             // Try to send the buffer.
-            let io_result: Result<usize, io::Error> = match addr {
-                Some(addr) => self.socket.send_to(&buf, &addr.clone().into()),
-                None => self.socket.send(&buf),
+            let io_result: Result<usize, io::Error> = if rest.is_empty() {
+                match addr {
+                    Some(addr) => self.socket.send_to(&buf, &addr.clone().into()),
+                    None => self.socket.send(&buf),
+                }
+            } else {
+                let mut slices: ArrayVec<IoSlice, DEMI_SGARRAY_MAXLEN> = ArrayVec::new();
+                slices.push(IoSlice::new(&buf));
+                for segment in rest.iter().take(DEMI_SGARRAY_MAXLEN - 1) {
+                    slices.push(IoSlice::new(segment));
+                }
+                match addr {
+                    Some(addr) => self.socket.send_to_vectored(&slices, &addr.clone().into()),
+                    None => self.socket.send_vectored(&slices),
+                }
             };
             match io_result {
                 // Operation completed.
                 Ok(nbytes) => {
                     trace!("data pushed ({:?}/{:?} bytes)", nbytes, buf.len());
-                    expect_ok!(
-                        buf.adjust(nbytes as usize),
-                        "OS should not have sent more bytes than in the buffer"
-                    );
-                    if buf.is_empty() {
+                    stats::count(Counter::PacketsOut, 1);
+                    stats::count(Counter::BytesOut, nbytes as u64);
+                    Self::consume(&mut buf, &mut rest, nbytes);
+                    if buf.is_empty() && rest.is_empty() {
                         // Done sending this buffer
                         result.set(Some(Ok(())));
                     } else {
                         // Only sent part of the buffer so try again later.
-                        self.send_queue.push_front(Outgoing { addr, buf, result });
+                        self.send_queue.push_front(Outgoing {
+                            addr,
+                            buf,
+                            rest,
+                            result,
+                        });
                     }
                 },
                 Err(e) => {
                     let errno: i32 = get_libc_err(e);
                     if DemiRuntime::should_retry(errno) {
                         // Put the buffer back and try again later.
-                        self.send_queue.push_front(Outgoing { addr, buf, result });
+                        self.send_queue.push_front(Outgoing {
+                            addr,
+                            buf,
+                            rest,
+                            result,
+                        });
                     } else {
                         let cause: String = format!("failed to send on socket: {:?}", errno);
                         error!("poll_send(): {}", cause);
@@ -99,10 +198,122 @@ impl ActiveSocketData {
         }
     }
 
+    /// Sends the datagrams at the front of the send queue with a single system call and lets the kernel segment them,
+    /// if there are at least two of them to the same destination. Every datagram but the last one must be as large as
+    /// the first one, so the batch ends at the first shorter one. Returns whether the front of the queue was handled;
+    /// otherwise it is left for a regular send.
+    fn poll_send_segmented(&mut self) -> bool {
+        let (addr, segment_size): (SocketAddr, usize) = match self.send_queue.get_front() {
+            Some(Outgoing {
+                addr: Some(addr),
+                buf,
+                rest,
+                ..
+            }) if rest.is_empty() && !buf.is_empty() => (*addr, buf.len()),
+            _ => return false,
+        };
+        let mut count: usize = 0;
+        let mut nbytes: usize = 0;
+        for outgoing in self.send_queue.get_values() {
+            let len: usize = outgoing.buf.len();
+            if count == UDP_MAX_SEGMENTS
+                || outgoing.addr != Some(addr)
+                || !outgoing.rest.is_empty()
+                || len == 0
+                || len > segment_size
+                || nbytes + len > UDP_MAX_PAYLOAD_SIZE
+            {
+                break;
+            }
+            count += 1;
+            nbytes += len;
+            if len < segment_size {
+                break;
+            }
+        }
+        if count < 2 {
+            return false;
+        }
+
+        let mut batch: ArrayVec<Outgoing, UDP_MAX_SEGMENTS> = ArrayVec::new();
+        while batch.len() < count {
+            batch.push(expect_some!(
+                self.send_queue.try_pop(),
+                "should have counted this datagram"
+            ));
+        }
+        let result: Result<usize, io::Error> = {
+            let slices: ArrayVec<IoSlice, UDP_MAX_SEGMENTS> = batch
+                .iter()
+                .map(|outgoing: &Outgoing| IoSlice::new(&outgoing.buf))
+                .collect();
+            send_segmented(&self.socket, addr, segment_size, &slices)
+        };
+        match result {
+            Ok(nbytes) => {
+                trace!("datagrams pushed ({:?} datagrams, {:?} bytes)", count, nbytes);
+                stats::count(Counter::PacketsOut, count as u64);
+                stats::count(Counter::BytesOut, nbytes as u64);
+                for mut outgoing in batch {
+                    outgoing.result.set(Some(Ok(())));
+                }
+                true
+            },
+            Err(e) => {
+                let errno: i32 = get_libc_err(e);
+                // Put the datagrams back in order.
+                for outgoing in batch.into_iter().rev() {
+                    self.send_queue.push_front(outgoing);
+                }
+                if DemiRuntime::should_retry(errno) {
+                    return true;
+                }
+                // Only these mean that the kernel cannot segment datagrams for this socket at all, so send them one by
+                // one from now on. Anything else, such as a device that cannot segment this batch (EIO) or a batch
+                // that the kernel rejects (EINVAL), only makes the front datagram go out on its own, and the next send
+                // tries segmentation again. The regular send reports errors that are not about segmentation.
+                if errno == libc::ENOPROTOOPT || errno == libc::EOPNOTSUPP {
+                    warn!("poll_send(): disabling UDP segmentation offload (errno={:?})", errno);
+                    self.udp_gso = false;
+                } else {
+                    debug!(
+                        "poll_send(): sending a datagram without segmentation (errno={:?})",
+                        errno
+                    );
+                }
+                false
+            },
+        }
+    }
+
+    /// Drops the first `nbytes` bytes that the OS has sent from the segments in `buf` and `rest`. When this returns,
+    /// `buf` is either the first segment that has not been sent completely or an empty buffer if everything was sent.
+    pub fn consume(buf: &mut DemiBuffer, rest: &mut VecDeque<DemiBuffer>, mut nbytes: usize) {
+        loop {
+            let len: usize = min(nbytes, buf.len());
+            expect_ok!(buf.adjust(len), "OS should not have sent more bytes than in the buffer");
+            nbytes -= len;
+            if !buf.is_empty() {
+                break;
+            }
+            match rest.pop_front() {
+                Some(segment) => *buf = segment,
+                None => break,
+            }
+            if nbytes == 0 {
+                break;
+            }
+        }
+        debug_assert_eq!(nbytes, 0);
+    }
+
     /// Polls the socket for incoming data on an incoming epoll event. Inserts any received data into the incoming
     /// queue.
     /// TODO: Incoming queue should possibly be byte oriented.
     pub fn poll_recv(&mut self) {
+        if self.udp_gro {
+            return self.poll_recv_coalesced();
+        }
         let mut buf: DemiBuffer = DemiBuffer::new(limits::POP_SIZE_MAX as u16);
         if self.closed {
             return;
@@ -117,6 +328,8 @@ impl ActiveSocketData {
                     self.recv_queue.push(Err(e));
                 } else {
                     trace!("data popped ({:?} bytes)", nbytes);
+                    stats::count(Counter::PacketsIn, 1);
+                    stats::count(Counter::BytesIn, nbytes as u64);
                     if buf.len() == 0 {
                         self.closed = true;
                     }
@@ -134,12 +347,99 @@ impl ActiveSocketData {
         }
     }
 
+    /// Receives on a socket where the kernel may coalesce datagrams from the same source and splits what it returns back
+    /// into datagrams before inserting them into the incoming queue.
+    fn poll_recv_coalesced(&mut self) {
+        if self.closed {
+            return;
+        }
+        let mut buf: DemiBuffer = DemiBuffer::new(UDP_GRO_RECV_SIZE);
+        match recv_coalesced(&self.socket, &mut buf[..]) {
+            Ok((nbytes, socketaddr, segment_size)) => {
+                if let Err(e) = buf.trim(buf.len() - nbytes) {
+                    self.recv_queue.push(Err(e));
+                    return;
+                }
+                trace!("data popped ({:?} bytes)", nbytes);
+                if buf.len() == 0 {
+                    self.closed = true;
+                }
+                // Datagrams that were not coalesced come without a segment size.
+                let segment_size: usize = segment_size.unwrap_or(nbytes).max(1);
+                stats::count(Counter::PacketsIn, nbytes.div_ceil(segment_size).max(1) as u64);
+                stats::count(Counter::BytesIn, nbytes as u64);
+                while buf.len() > segment_size {
+                    match buf.split_back(segment_size) {
+                        Ok(rest) => self.recv_queue.push(Ok((socketaddr, mem::replace(&mut buf, rest)))),
+                        Err(e) => {
+                            self.recv_queue.push(Err(e));
+                            return;
+                        },
+                    }
+                }
+                self.recv_queue.push(Ok((socketaddr, buf)));
+            },
+            Err(e) => {
+                let errno: i32 = get_libc_err(e);
+                if !DemiRuntime::should_retry(errno) {
+                    let cause: String = format!("failed to receive on socket: {:?}", errno);
+                    error!("poll_recv(): {}", cause);
+                    self.recv_queue.push(Err(Fail::new(errno, &cause)));
+                }
+            },
+        }
+    }
+
+    /// Takes the next outgoing message to hand to io_uring, unless a send is already in flight.
+    pub fn start_send(&mut self) -> Option<Outgoing> {
+        if self.sending {
+            return None;
+        }
+        let outgoing: Option<Outgoing> = self.send_queue.try_pop();
+        self.sending = outgoing.is_some();
+        outgoing
+    }
+
+    /// Records that the send that io_uring had in flight completed.
+    pub fn finish_send(&mut self) {
+        self.sending = false;
+    }
+
+    /// Inserts data that io_uring received into the incoming queue.
+    pub fn push_received(&mut self, result: Result<(Option<SocketAddr>, DemiBuffer), Fail>) {
+        if self.closed {
+            return;
+        }
+        if let Ok((_, ref buf)) = result {
+            trace!("data popped ({:?} bytes)", buf.len());
+            stats::count(Counter::PacketsIn, 1);
+            stats::count(Counter::BytesIn, buf.len() as u64);
+            if buf.len() == 0 {
+                self.closed = true;
+            }
+        }
+        self.recv_queue.push(result);
+    }
+
     /// Pushes data to the socket. Blocks until completion.
     pub async fn push(&mut self, addr: Option<SocketAddr>, buf: DemiBuffer) -> Result<(), Fail> {
         let mut result: SharedAsyncValue<Option<Result<(), Fail>>> = SharedAsyncValue::new(None);
+        let (buf, rest): (DemiBuffer, VecDeque<DemiBuffer>) = if buf.is_multi_segment() {
+            // Empty segments are dropped, so that they cannot be taken for a dummy request.
+            let mut rest: VecDeque<DemiBuffer> = buf
+                .into_segments()
+                .into_iter()
+                .filter(|segment: &DemiBuffer| !segment.is_empty())
+                .collect();
+            let buf: DemiBuffer = rest.pop_front().unwrap_or_else(|| DemiBuffer::new(0));
+            (buf, rest)
+        } else {
+            (buf, VecDeque::new())
+        };
         self.send_queue.push(Outgoing {
             addr,
             buf,
+            rest,
             result: result.clone(),
         });
         loop {
@@ -176,3 +476,79 @@ impl ActiveSocketData {
         &mut self.socket
     }
 }
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Sends the datagrams in `slices` to `addr` with a single `sendmsg()` and asks the kernel to split them back into
+/// datagrams of `segment_size` bytes, so every slice but the last one must have exactly that size.
+fn send_segmented(
+    socket: &Socket,
+    addr: SocketAddr,
+    segment_size: usize,
+    slices: &[IoSlice],
+) -> Result<usize, io::Error> {
+    let addr: SockAddr = SockAddr::from(addr);
+    let mut control: ControlBuffer = [0; 4];
+    let mut msghdr: libc::msghdr = unsafe { mem::zeroed() };
+    msghdr.msg_name = addr.as_ptr() as *mut libc::c_void;
+    msghdr.msg_namelen = addr.len();
+    // Safety: IoSlice is guaranteed to be ABI compatible with iovec on Unix.
+    msghdr.msg_iov = slices.as_ptr() as *mut libc::iovec;
+    msghdr.msg_iovlen = slices.len() as _;
+    msghdr.msg_control = control.as_mut_ptr() as *mut libc::c_void;
+    msghdr.msg_controllen = unsafe { libc::CMSG_SPACE(mem::size_of::<u16>() as u32) } as _;
+    debug_assert!(msghdr.msg_controllen as usize <= mem::size_of::<ControlBuffer>());
+    unsafe {
+        let cmsg: *mut libc::cmsghdr = libc::CMSG_FIRSTHDR(&msghdr);
+        (*cmsg).cmsg_level = libc::SOL_UDP;
+        (*cmsg).cmsg_type = libc::UDP_SEGMENT;
+        (*cmsg).cmsg_len = libc::CMSG_LEN(mem::size_of::<u16>() as u32) as _;
+        ptr::write_unaligned(libc::CMSG_DATA(cmsg) as *mut u16, segment_size as u16);
+    }
+    match unsafe { libc::sendmsg(socket.as_raw_fd(), &msghdr, 0) } {
+        nbytes if nbytes >= 0 => Ok(nbytes as usize),
+        _ => Err(io::Error::last_os_error()),
+    }
+}
+
+/// Receives into `buf` with `recvmsg()`. Returns the number of bytes received, the address of the source and, if the
+/// kernel coalesced several datagrams into `buf`, the size of all but the last one.
+fn recv_coalesced(socket: &Socket, buf: &mut [u8]) -> Result<(usize, Option<SocketAddr>, Option<usize>), io::Error> {
+    let mut control: ControlBuffer = [0; 4];
+    let mut iovec: libc::iovec = libc::iovec {
+        iov_base: buf.as_mut_ptr() as *mut libc::c_void,
+        iov_len: buf.len(),
+    };
+    let ((nbytes, msghdr), addr): ((usize, libc::msghdr), SockAddr) = unsafe {
+        SockAddr::try_init(|storage: *mut libc::sockaddr_storage, len: *mut libc::socklen_t| {
+            let mut msghdr: libc::msghdr = mem::zeroed();
+            msghdr.msg_name = storage as *mut libc::c_void;
+            msghdr.msg_namelen = *len;
+            msghdr.msg_iov = &mut iovec;
+            msghdr.msg_iovlen = 1;
+            msghdr.msg_control = control.as_mut_ptr() as *mut libc::c_void;
+            msghdr.msg_controllen = mem::size_of::<ControlBuffer>() as _;
+            match libc::recvmsg(socket.as_raw_fd(), &mut msghdr, 0) {
+                nbytes if nbytes >= 0 => {
+                    *len = msghdr.msg_namelen;
+                    Ok((nbytes as usize, msghdr))
+                },
+                _ => Err(io::Error::last_os_error()),
+            }
+        })?
+    };
+
+    let mut segment_size: Option<usize> = None;
+    unsafe {
+        let mut cmsg: *mut libc::cmsghdr = libc::CMSG_FIRSTHDR(&msghdr);
+        while !cmsg.is_null() {
+            if (*cmsg).cmsg_level == libc::SOL_UDP && (*cmsg).cmsg_type == libc::UDP_GRO {
+                segment_size = Some(ptr::read_unaligned(libc::CMSG_DATA(cmsg) as *const libc::c_int) as usize);
+            }
+            cmsg = libc::CMSG_NXTHDR(&msghdr, cmsg);
+        }
+    }
+    Ok((nbytes, addr.as_socket(), segment_size))
+}
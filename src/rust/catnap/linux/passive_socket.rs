@@ -58,6 +58,14 @@ impl PassiveSocketData {
         }
     }
 
+    /// Inserts a connection that io_uring accepted into the accept queue.
+    pub fn push_accepted(&mut self, result: Result<(Socket, SocketAddr), Fail>) {
+        if let Ok((ref new_socket, _)) = result {
+            trace!("connection accepted ({:?})", new_socket);
+        }
+        self.accept_queue.push(result)
+    }
+
     /// Block until a new connection arrives.
     pub async fn accept(&mut self) -> Result<(Socket, SocketAddr), Fail> {
         self.accept_queue.pop(None).await?
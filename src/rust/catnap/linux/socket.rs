@@ -49,6 +49,14 @@ impl SharedSocketData {
         )))
     }
 
+    /// Turns on the UDP offloads of an active datagram socket. See [ActiveSocketData::enable_udp_offloads].
+    pub fn enable_udp_offloads(&mut self) {
+        match self.deref_mut() {
+            SocketData::Active(data) => data.enable_udp_offloads(),
+            _ => unreachable!("should only enable UDP offloads on active sockets"),
+        }
+    }
+
     /// Moves an inactive socket to a passive listening socket.
     pub fn move_socket_to_passive(&mut self) {
         let socket: Socket = match self.deref_mut() {
@@ -8,20 +8,29 @@
 mod active_socket;
 mod passive_socket;
 mod socket;
+mod uring;
+mod uring_backend;
 
 //======================================================================================================================
 // Imports
 //======================================================================================================================
 
 use crate::{
-    catnap::transport::socket::{SharedSocketData, SocketData},
+    catnap::transport::{
+        socket::{SharedSocketData, SocketData},
+        uring_backend::UringBackend,
+    },
+    collections::async_value::SharedAsyncValue,
+    demi_sgarray_t,
     demikernel::config::Config,
-    expect_ok, expect_some,
+    expect_some,
     runtime::{
         fail::Fail,
-        memory::{DemiBuffer, MemoryRuntime},
+        memory::{self, DemiBuffer, MemoryRuntime, SizeClassPools},
         network::{
-            socket::option::{SocketOption, TcpSocketOptions},
+            socket::option::{
+                CongestionControlAlgorithm, SocketOption, TcpSocketOptions, MAX_CONGESTION_CONTROL_NAME_LEN,
+            },
             transport::NetworkTransport,
         },
         poll_yield, DemiRuntime, SharedDemiRuntime, SharedObject,
@@ -36,6 +45,7 @@ use ::std::{
     net::{Shutdown, SocketAddr, SocketAddrV4},
     ops::{Deref, DerefMut},
     os::fd::{AsRawFd, RawFd},
+    rc::Rc,
 };
 
 //======================================================================================================================
@@ -51,10 +61,15 @@ const EPOLL_BATCH_SIZE: usize = 1024;
 
 /// Underlying network transport.
 pub struct CatnapTransport {
-    epoll_fd: RawFd,
+    /// Waits for readiness, unless io_uring is enabled.
+    epoll_fd: Option<RawFd>,
     socket_table: Slab<SharedSocketData>,
     runtime: SharedDemiRuntime,
     options: TcpSocketOptions,
+    /// Pools that scatter-gather arrays are allocated from, if enabled.
+    sga_pools: Option<Rc<SizeClassPools>>,
+    /// Hands I/O to io_uring instead of waiting for readiness with epoll, if enabled.
+    uring: Option<UringBackend>,
 }
 
 /// Shared network transport across coroutines.
@@ -71,40 +86,62 @@ type SockDesc = <SharedCatnapTransport as NetworkTransport>::SocketDescriptor;
 impl SharedCatnapTransport {
     /// Create a new Linux-based network transport.
     pub fn new(config: &Config, runtime: &mut SharedDemiRuntime) -> Result<Self, Fail> {
-        // Create epoll socket.
-        // Linux ignores the size argument to epoll, it just has to be more than 0.
-        let epoll_fd: RawFd = match unsafe { libc::epoll_create(10) } {
-            fd if fd >= 0 => fd.into(),
-            _ => {
-                let errno: libc::c_int = unsafe { *libc::__errno_location() };
-                panic!("could not create epoll socket: {:?}", errno);
+        let sga_pools: Option<Rc<SizeClassPools>> = SizeClassPools::from_config(config)?;
+        let use_io_uring: bool = match config.catnap_io_uring() {
+            Ok(use_io_uring) => use_io_uring,
+            Err(_) => {
+                warn!("No setting for the catnap backend. Using epoll by default.");
+                false
             },
         };
+        let (epoll_fd, uring): (Option<RawFd>, Option<UringBackend>) = if use_io_uring {
+            (None, Some(UringBackend::new(sga_pools.clone())?))
+        } else {
+            // Create epoll socket.
+            // Linux ignores the size argument to epoll, it just has to be more than 0.
+            match unsafe { libc::epoll_create(10) } {
+                fd if fd >= 0 => (Some(fd.into()), None),
+                _ => {
+                    let errno: libc::c_int = unsafe { *libc::__errno_location() };
+                    panic!("could not create epoll socket: {:?}", errno);
+                },
+            }
+        };
 
-        // Set up background task for polling epoll API.
+        // Set up background task for polling epoll API or io_uring.
         let me: Self = Self(SharedObject::new(CatnapTransport {
             epoll_fd,
             socket_table: Slab::<SharedSocketData>::new(),
             runtime: runtime.clone(),
             options: TcpSocketOptions::new(config)?,
+            sga_pools,
+            uring,
         }));
         let mut me2: Self = me.clone();
-        runtime.insert_background_coroutine(
-            "bgc::catnap::transport::epoll",
-            Box::pin(async move { me2.poll().await }.fuse()),
-        )?;
+        if use_io_uring {
+            runtime.insert_background_coroutine(
+                "bgc::catnap::transport::io_uring",
+                Box::pin(async move { me2.poll_uring().await }.fuse()),
+            )?;
+        } else {
+            runtime.insert_background_coroutine(
+                "bgc::catnap::transport::epoll",
+                Box::pin(async move { me2.poll().await }.fuse()),
+            )?;
+        }
         Ok(me)
     }
 
     /// This function registers a handler for incoming and outgoing I/O on the socket. There should only be one of
     /// these per socket.
     fn register_epoll(&mut self, sd: &SockDesc, events: u32) -> Result<(), Fail> {
+        let epoll_fd: RawFd = expect_some!(self.epoll_fd, "epoll should be enabled");
         let fd: RawFd = self.raw_fd_from_sd(sd);
         let mut epoll_event: libc::epoll_event = libc::epoll_event {
             events,
             u64: *sd as u64,
         };
-        match unsafe { libc::epoll_ctl(self.epoll_fd, libc::EPOLL_CTL_ADD, fd, &mut epoll_event) } {
+        match unsafe { libc::epoll_ctl(epoll_fd, libc::EPOLL_CTL_ADD, fd, &mut epoll_event) } {
             0 => Ok(()),
             _ => {
                 let errno: libc::c_int = unsafe { *libc::__errno_location() };
@@ -117,12 +154,13 @@ impl SharedCatnapTransport {
 
     /// THis function removes the handlers for incoming and outgoing I/O on the socket.
     fn unregister_epoll(&mut self, sd: &SockDesc, events: u32) -> Result<(), Fail> {
+        let epoll_fd: RawFd = expect_some!(self.epoll_fd, "epoll should be enabled");
         let fd: RawFd = self.raw_fd_from_sd(sd);
         let mut epoll_event: libc::epoll_event = libc::epoll_event {
             events,
             u64: *sd as u64,
         };
-        match unsafe { libc::epoll_ctl(self.epoll_fd, libc::EPOLL_CTL_DEL, fd, &mut epoll_event) } {
+        match unsafe { libc::epoll_ctl(epoll_fd, libc::EPOLL_CTL_DEL, fd, &mut epoll_event) } {
             0 => Ok(()),
             _ => {
                 let errno: libc::c_int = unsafe { *libc::__errno_location() };
@@ -139,11 +177,12 @@ impl SharedCatnapTransport {
 
     /// Background function for checking for epoll events.
     async fn poll(&mut self) {
+        let epoll_fd: RawFd = expect_some!(self.epoll_fd, "epoll should be enabled");
         let mut events: Vec<libc::epoll_event> = Vec::with_capacity(EPOLL_BATCH_SIZE);
         loop {
             match unsafe {
                 libc::epoll_wait(
-                    self.epoll_fd,
+                    epoll_fd,
                     events.as_mut_ptr() as *mut libc::epoll_event,
                     EPOLL_BATCH_SIZE as i32,
                     0,
@@ -204,6 +243,64 @@ impl SharedCatnapTransport {
         }
     }
 
+    /// Background function for handing I/O to io_uring and handling its completions.
+    async fn poll_uring(&mut self) {
+        loop {
+            if let Err(e) = expect_some!(self.uring.as_mut(), "io_uring should be enabled").poll() {
+                // Only a ring that was torn down stops taking submissions for good.
+                if e.errno == libc::EBADF || e.errno == libc::ENXIO {
+                    error!("poll_uring(): io_uring failed: {:?}", e);
+                    break;
+                }
+                warn!("poll_uring(): {:?}", e);
+            }
+            // Yield for one iteration.
+            poll_yield().await;
+        }
+    }
+
+    /// Connects `sd` to `remote` with io_uring and starts receiving on it once connected.
+    async fn connect_uring(&mut self, sd: &SockDesc, remote: SocketAddr) -> Result<(), Fail> {
+        let data: SharedSocketData = self.data_from_sd(sd).clone();
+        let mut result: SharedAsyncValue<Option<Result<(), Fail>>> =
+            expect_some!(self.uring.as_mut(), "io_uring should be enabled").connect(&data, remote);
+        loop {
+            match result.get() {
+                Some(Ok(())) => return self.start_receiving(sd, true),
+                Some(Err(e)) => return Err(e),
+                None => {
+                    result.wait_for_change(None).await?;
+                },
+            }
+        }
+    }
+
+    /// Starts receiving on the established socket `sd`: with a multishot receive on io_uring or by registering it
+    /// with epoll.
+    fn start_receiving(&mut self, sd: &SockDesc, is_stream: bool) -> Result<(), Fail> {
+        let data: SharedSocketData = self.data_from_sd(sd).clone();
+        if let Some(uring) = self.uring.as_mut() {
+            uring.receive(&data, is_stream);
+            return Ok(());
+        }
+        self.register_epoll(sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32)
+    }
+
+    /// Stops all I/O on `sd` before it is removed from the socket table: cancels its operations on io_uring or
+    /// unregisters it from epoll.
+    fn stop_io(&mut self, sd: &SockDesc) -> Result<(), Fail> {
+        let fd: RawFd = self.raw_fd_from_sd(sd);
+        if let Some(uring) = self.uring.as_mut() {
+            uring.cancel(fd);
+            return Ok(());
+        }
+        match self.data_from_sd(sd).deref_mut() {
+            SocketData::Active(_) => self.unregister_epoll(sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32),
+            SocketData::Passive(_) => self.unregister_epoll(sd, libc::EPOLLIN as u32),
+            _ => Ok(()),
+        }
+    }
+
     /// Internal function to get the raw file descriptor from a socket, given the socket descriptor.
     fn raw_fd_from_sd(&self, sd: &SockDesc) -> RawFd {
         expect_some!(self.socket_table.get(*sd), "shoudld have been allocated").as_raw_fd()
@@ -320,8 +417,13 @@ impl NetworkTransport for SharedCatnapTransport {
         let sd: Self::SocketDescriptor = match typ {
             Type::STREAM => self.socket_table.insert(SharedSocketData::new_inactive(socket)),
             Type::DGRAM => {
-                let new_sd: Self::SocketDescriptor = self.socket_table.insert(SharedSocketData::new_active(socket));
-                self.register_epoll(&new_sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32)?;
+                let mut data: SharedSocketData = SharedSocketData::new_active(socket);
+                // Receives on io_uring do not split coalesced datagrams, so offloads are only for epoll.
+                if self.uring.is_none() {
+                    data.enable_udp_offloads();
+                }
+                let new_sd: Self::SocketDescriptor = self.socket_table.insert(data);
+                self.start_receiving(&new_sd, false)?;
                 new_sd
             },
             _ => unreachable!("We should have returned an error by now"),
@@ -364,6 +466,32 @@ impl NetworkTransport for SharedCatnapTransport {
                     Ok(())
                 }
             },
+            SocketOption::CongestionControl(algorithm) => {
+                // The kernel knows the algorithms by the same names, if their modules are loaded.
+                let name: &str = algorithm.name();
+                let ret: libc::c_int = unsafe {
+                    libc::setsockopt(
+                        socket.as_raw_fd(),
+                        libc::IPPROTO_TCP,
+                        libc::TCP_CONGESTION,
+                        name.as_ptr() as *const libc::c_void,
+                        name.len() as libc::socklen_t,
+                    )
+                };
+                if ret != 0 {
+                    let errno: libc::c_int = unsafe { *libc::__errno_location() };
+                    let cause: String = format!("TCP_CONGESTION failed: {:?}", errno);
+                    error!("set_socket_option(): {}", cause);
+                    Err(Fail::new(errno, &cause))
+                } else {
+                    Ok(())
+                }
+            },
+            SocketOption::Priority(_) => {
+                let cause: &str = "socket priorities are set on the queue, not on the transport";
+                warn!("set_socket_option(): {}", cause);
+                Err(Fail::new(libc::ENOPROTOOPT, cause))
+            },
         }
     }
 
@@ -404,6 +532,43 @@ impl NetworkTransport for SharedCatnapTransport {
                     Err(Fail::new(errno, &cause))
                 },
             },
+            SocketOption::CongestionControl(_) => {
+                let mut name: [u8; MAX_CONGESTION_CONTROL_NAME_LEN] = [0; MAX_CONGESTION_CONTROL_NAME_LEN];
+                let mut len: libc::socklen_t = name.len() as libc::socklen_t;
+                let ret: libc::c_int = unsafe {
+                    libc::getsockopt(
+                        socket.as_raw_fd(),
+                        libc::IPPROTO_TCP,
+                        libc::TCP_CONGESTION,
+                        name.as_mut_ptr() as *mut libc::c_void,
+                        &mut len,
+                    )
+                };
+                if ret != 0 {
+                    let errno: libc::c_int = unsafe { *libc::__errno_location() };
+                    let cause: String = format!("TCP_CONGESTION failed: {:?}", errno);
+                    error!("get_socket_option(): {}", cause);
+                    return Err(Fail::new(errno, &cause));
+                }
+                let name: &[u8] = &name[..len as usize];
+                let name: &[u8] = &name[..name.iter().position(|b| *b == 0).unwrap_or(name.len())];
+                match std::str::from_utf8(name)
+                    .ok()
+                    .and_then(CongestionControlAlgorithm::from_kernel_name)
+                {
+                    Some(algorithm) => Ok(SocketOption::CongestionControl(algorithm)),
+                    None => {
+                        let cause: String = format!("invalid congestion control algorithm: {:?}", name);
+                        error!("get_socket_option(): {}", cause);
+                        Err(Fail::new(libc::EINVAL, &cause))
+                    },
+                }
+            },
+            SocketOption::Priority(_) => {
+                let cause: &str = "socket priorities are set on the queue, not on the transport";
+                warn!("get_socket_option(): {}", cause);
+                Err(Fail::new(libc::ENOPROTOOPT, cause))
+            },
         }
     }
 
@@ -463,7 +628,7 @@ impl NetworkTransport for SharedCatnapTransport {
     }
 
     /// Sets a socket to passive listening on the underlying transport and registers it to accept incoming connections
-    /// with epoll.
+    /// with epoll, or keeps a multishot accept armed on io_uring.
     fn listen(&mut self, sd: &mut Self::SocketDescriptor, backlog: usize) -> Result<(), Fail> {
         timer!("catnap::linux::transport::listen");
         trace!("Listen to");
@@ -475,7 +640,11 @@ impl NetworkTransport for SharedCatnapTransport {
 
         // Update socket state.
         self.data_from_sd(sd).move_socket_to_passive();
-        self.register_epoll(&sd, libc::EPOLLIN as u32)?;
+        let data: SharedSocketData = self.data_from_sd(sd).clone();
+        match self.uring.as_mut() {
+            Some(uring) => uring.accept(&data),
+            None => self.register_epoll(&sd, libc::EPOLLIN as u32)?,
+        }
 
         Ok(())
     }
@@ -507,7 +676,7 @@ impl NetworkTransport for SharedCatnapTransport {
 
         let new_data: SharedSocketData = SharedSocketData::new_active(new_socket);
         let new_sd: usize = self.socket_table.insert(new_data);
-        self.register_epoll(&new_sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32)?;
+        self.start_receiving(&new_sd, true)?;
         Ok((new_sd, addr))
     }
 
@@ -516,6 +685,9 @@ impl NetworkTransport for SharedCatnapTransport {
     async fn connect(&mut self, sd: &mut Self::SocketDescriptor, remote: SocketAddr) -> Result<(), Fail> {
         timer!("catnap::linux::transport::connect");
         self.data_from_sd(sd).move_socket_to_active();
+        if self.uring.is_some() {
+            return self.connect_uring(sd, remote).await;
+        }
         self.register_epoll(&sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32)?;
 
         loop {
@@ -559,12 +731,8 @@ impl NetworkTransport for SharedCatnapTransport {
                 },
             }
         }
-        // Check whether we need to remove epoll events.
-        match data.deref_mut() {
-            SocketData::Active(_) => self.unregister_epoll(sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32)?,
-            SocketData::Passive(_) => self.unregister_epoll(sd, libc::EPOLLIN as u32)?,
-            _ => (),
-        };
+        // Check whether we need to remove epoll events or cancel operations on io_uring.
+        self.stop_io(sd)?;
         self.socket_table.remove(*sd);
         Ok(())
     }
@@ -579,9 +747,14 @@ impl NetworkTransport for SharedCatnapTransport {
     ) -> Result<(), Fail> {
         timer!("catnap::linux::transport::push");
         {
-            self.data_from_sd(sd).push(addr, buf.clone()).await?;
+            // The message is queued before io_uring looks at the socket on its next poll.
+            let mut data: SharedSocketData = self.data_from_sd(sd).clone();
+            if let Some(uring) = self.uring.as_mut() {
+                uring.schedule_send(&data);
+            }
+            data.push(addr, buf.clone()).await?;
             // Clear out the original buffer.
-            expect_ok!(buf.trim(buf.len()), "Should be able to empty the buffer");
+            buf.clear();
             Ok(())
         }
     }
@@ -616,12 +789,8 @@ impl NetworkTransport for SharedCatnapTransport {
                 }
             },
         }
-        // Check whether we need to remove epoll events.
-        match data.deref_mut() {
-            SocketData::Active(_) => self.unregister_epoll(sd, (libc::EPOLLIN | libc::EPOLLOUT) as u32)?,
-            SocketData::Passive(_) => self.unregister_epoll(sd, libc::EPOLLIN as u32)?,
-            _ => (),
-        };
+        // Check whether we need to remove epoll events or cancel operations on io_uring.
+        self.stop_io(sd)?;
         self.socket_table.remove(*sd);
         Ok(())
     }
@@ -631,4 +800,16 @@ impl NetworkTransport for SharedCatnapTransport {
     }
 }
 
-impl MemoryRuntime for SharedCatnapTransport {}
+impl MemoryRuntime for SharedCatnapTransport {
+    /// Allocates a scatter-gather array, from the size-class pools if they are enabled.
+    fn sgaallocv(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
+        match self.sga_pools {
+            Some(ref pools) => memory::alloc_sgarray(seglens, |size: usize| -> Result<DemiBuffer, Fail> {
+                pools.alloc(size, 0)
+            }),
+            None => memory::alloc_sgarray(seglens, |size: usize| -> Result<DemiBuffer, Fail> {
+                Ok(DemiBuffer::new(size as u16))
+            }),
+        }
+    }
+}
@@ -0,0 +1,528 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Minimal io_uring interface.
+//!
+//! This talks to the kernel through the raw system calls and mirrors the structures of `linux/io_uring.h`, so it only
+//! covers what the catnap backend needs: a submission queue that is filled in place and handed to the kernel in
+//! batches, a completion queue that is drained without any system call, and a ring of provided buffers that receives
+//! pick their buffers from.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::fail::Fail;
+use ::std::{
+    alloc::{self, Layout},
+    mem,
+    os::fd::RawFd,
+    ptr,
+    sync::atomic::{AtomicU16, AtomicU32, Ordering},
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+pub const IORING_OP_NOP: u8 = 0;
+pub const IORING_OP_SENDMSG: u8 = 9;
+pub const IORING_OP_RECVMSG: u8 = 10;
+pub const IORING_OP_ACCEPT: u8 = 13;
+pub const IORING_OP_ASYNC_CANCEL: u8 = 14;
+pub const IORING_OP_CONNECT: u8 = 16;
+pub const IORING_OP_SEND: u8 = 26;
+pub const IORING_OP_RECV: u8 = 27;
+pub const IORING_OP_SEND_ZC: u8 = 47;
+pub const IORING_OP_SENDMSG_ZC: u8 = 48;
+
+pub const IOSQE_BUFFER_SELECT: u8 = 1 << 5;
+
+pub const IORING_RECV_MULTISHOT: u16 = 1 << 1;
+pub const IORING_ACCEPT_MULTISHOT: u16 = 1 << 0;
+pub const IORING_ASYNC_CANCEL_ALL: u32 = 1 << 0;
+pub const IORING_ASYNC_CANCEL_FD: u32 = 1 << 1;
+
+pub const IORING_CQE_F_BUFFER: u32 = 1 << 0;
+pub const IORING_CQE_F_MORE: u32 = 1 << 1;
+pub const IORING_CQE_F_NOTIF: u32 = 1 << 3;
+pub const IORING_CQE_BUFFER_SHIFT: u32 = 16;
+
+const IORING_OFF_SQ_RING: libc::off_t = 0;
+const IORING_OFF_SQES: libc::off_t = 0x10000000;
+const IORING_FEAT_SINGLE_MMAP: u32 = 1 << 0;
+const IORING_FEAT_NODROP: u32 = 1 << 1;
+const IORING_SQ_CQ_OVERFLOW: u32 = 1 << 1;
+const IORING_ENTER_GETEVENTS: u32 = 1 << 0;
+const IORING_REGISTER_PROBE: u32 = 8;
+const IORING_REGISTER_PBUF_RING: u32 = 22;
+const IO_URING_OP_SUPPORTED: u16 = 1 << 0;
+
+/// Number of opcodes that are probed for support.
+const PROBE_OPS: usize = 64;
+
+/// Page size, which the ring of provided buffers is aligned to.
+const PAGE_SIZE: usize = 4096;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Offsets of the fields of the submission ring (`struct io_sqring_offsets`).
+#[repr(C)]
+#[derive(Default)]
+struct SqRingOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    flags: u32,
+    dropped: u32,
+    array: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+/// Offsets of the fields of the completion ring (`struct io_cqring_offsets`).
+#[repr(C)]
+#[derive(Default)]
+struct CqRingOffsets {
+    head: u32,
+    tail: u32,
+    ring_mask: u32,
+    ring_entries: u32,
+    overflow: u32,
+    cqes: u32,
+    flags: u32,
+    resv1: u32,
+    user_addr: u64,
+}
+
+/// Parameters of a ring (`struct io_uring_params`).
+#[repr(C)]
+#[derive(Default)]
+struct Params {
+    sq_entries: u32,
+    cq_entries: u32,
+    flags: u32,
+    sq_thread_cpu: u32,
+    sq_thread_idle: u32,
+    features: u32,
+    wq_fd: u32,
+    resv: [u32; 3],
+    sq_off: SqRingOffsets,
+    cq_off: CqRingOffsets,
+}
+
+/// Submission queue entry (`struct io_uring_sqe`). Fields that live in unions are named after the use that this
+/// module makes of them.
+#[repr(C)]
+#[derive(Clone, Copy, Default)]
+pub struct Sqe {
+    pub opcode: u8,
+    pub flags: u8,
+    /// Flags of accept, receive and send operations.
+    pub ioprio: u16,
+    pub fd: i32,
+    /// Offset, or length of the address of a connect operation.
+    pub off: u64,
+    pub addr: u64,
+    pub len: u32,
+    /// Flags of the operation (e.g. `msg_flags`, `accept_flags` or `cancel_flags`).
+    pub op_flags: u32,
+    pub user_data: u64,
+    /// Buffer group of operations that select a provided buffer.
+    pub buf_group: u16,
+    pub personality: u16,
+    pub file_index: u32,
+    pub addr3: u64,
+    pub pad: u64,
+}
+
+/// Completion queue entry (`struct io_uring_cqe`).
+#[repr(C)]
+#[derive(Clone, Copy, Debug)]
+pub struct Cqe {
+    pub user_data: u64,
+    pub res: i32,
+    pub flags: u32,
+}
+
+/// A provided buffer (`struct io_uring_buf`). The tail of the ring overlaps with the reserved field of the first one.
+#[repr(C)]
+struct ProvidedBuffer {
+    addr: u64,
+    len: u32,
+    bid: u16,
+    resv: u16,
+}
+
+/// Registration of a ring of provided buffers (`struct io_uring_buf_reg`).
+#[repr(C)]
+struct BufferRingRegistration {
+    ring_addr: u64,
+    ring_entries: u32,
+    bgid: u16,
+    flags: u16,
+    resv: [u64; 3],
+}
+
+/// Support of an opcode (`struct io_uring_probe_op`).
+#[repr(C)]
+#[derive(Clone, Copy, Default)]
+struct ProbeOp {
+    op: u8,
+    resv: u8,
+    flags: u16,
+    resv2: u32,
+}
+
+/// Supported opcodes (`struct io_uring_probe`) followed by room for [PROBE_OPS] of them.
+#[repr(C)]
+struct Probe {
+    last_op: u8,
+    ops_len: u8,
+    resv: u16,
+    resv2: [u32; 3],
+    ops: [ProbeOp; PROBE_OPS],
+}
+
+/// An io_uring instance.
+pub struct IoUring {
+    fd: RawFd,
+    /// Mapping of the submission and completion rings.
+    rings: *mut u8,
+    rings_size: usize,
+    /// Mapping of the submission queue entries.
+    sqes: *mut Sqe,
+    sqes_size: usize,
+    sq_head: *const AtomicU32,
+    sq_tail: *const AtomicU32,
+    sq_flags: *const AtomicU32,
+    sq_mask: u32,
+    sq_entries: u32,
+    sq_array: *mut u32,
+    cq_head: *const AtomicU32,
+    cq_tail: *const AtomicU32,
+    cq_mask: u32,
+    cqes: *const Cqe,
+    /// Entries that were queued but not handed to the kernel yet.
+    unsubmitted: u32,
+}
+
+/// A ring of buffers that the kernel picks from for operations that select a provided buffer.
+pub struct BufferRing {
+    ring: *mut ProvidedBuffer,
+    entries: u16,
+    tail: u16,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl IoUring {
+    /// Creates a ring with room for `entries` submissions.
+    pub fn new(entries: u32) -> Result<Self, Fail> {
+        let mut params: Params = Params::default();
+        let fd: RawFd = match unsafe { libc::syscall(libc::SYS_io_uring_setup, entries, &mut params as *mut Params) } {
+            fd if fd >= 0 => fd as RawFd,
+            _ => {
+                let errno: libc::c_int = unsafe { *libc::__errno_location() };
+                let cause: String = format!("failed to set up io_uring (errno={:?})", errno);
+                error!("new(): {}", cause);
+                return Err(Fail::new(errno, &cause));
+            },
+        };
+
+        // Older kernels map the two rings separately and may drop completions, which the backend does not handle.
+        let required: u32 = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP;
+        if params.features & required != required {
+            unsafe { libc::close(fd) };
+            let cause: String = format!("io_uring lacks required features (features={:#x})", params.features);
+            error!("new(): {}", cause);
+            return Err(Fail::new(libc::ENOTSUP, &cause));
+        }
+
+        let sq_size: usize = params.sq_off.array as usize + params.sq_entries as usize * mem::size_of::<u32>();
+        let cq_size: usize = params.cq_off.cqes as usize + params.cq_entries as usize * mem::size_of::<Cqe>();
+        let rings_size: usize = sq_size.max(cq_size);
+        let rings: *mut u8 = match Self::map(fd, rings_size, IORING_OFF_SQ_RING) {
+            Ok(rings) => rings,
+            Err(e) => {
+                unsafe { libc::close(fd) };
+                return Err(e);
+            },
+        };
+        let sqes_size: usize = params.sq_entries as usize * mem::size_of::<Sqe>();
+        let sqes: *mut Sqe = match Self::map(fd, sqes_size, IORING_OFF_SQES) {
+            Ok(sqes) => sqes as *mut Sqe,
+            Err(e) => {
+                unsafe {
+                    libc::munmap(rings as *mut libc::c_void, rings_size);
+                    libc::close(fd);
+                };
+                return Err(e);
+            },
+        };
+
+        // Safety: the offsets come from the kernel and are within the mapping of the rings.
+        unsafe {
+            let at = |offset: u32| -> *mut u8 { rings.add(offset as usize) };
+            Ok(Self {
+                fd,
+                rings,
+                rings_size,
+                sqes,
+                sqes_size,
+                sq_head: at(params.sq_off.head) as *const AtomicU32,
+                sq_tail: at(params.sq_off.tail) as *const AtomicU32,
+                sq_flags: at(params.sq_off.flags) as *const AtomicU32,
+                sq_mask: *(at(params.sq_off.ring_mask) as *const u32),
+                sq_entries: params.sq_entries,
+                sq_array: at(params.sq_off.array) as *mut u32,
+                cq_head: at(params.cq_off.head) as *const AtomicU32,
+                cq_tail: at(params.cq_off.tail) as *const AtomicU32,
+                cq_mask: *(at(params.cq_off.ring_mask) as *const u32),
+                cqes: at(params.cq_off.cqes) as *const Cqe,
+                unsubmitted: 0,
+            })
+        }
+    }
+
+    /// Maps `size` bytes of the ring at `offset`.
+    fn map(fd: RawFd, size: usize, offset: libc::off_t) -> Result<*mut u8, Fail> {
+        match unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                size,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED | libc::MAP_POPULATE,
+                fd,
+                offset,
+            )
+        } {
+            libc::MAP_FAILED => {
+                let errno: libc::c_int = unsafe { *libc::__errno_location() };
+                let cause: String = format!("failed to map io_uring (offset={:#x}, errno={:?})", offset, errno);
+                error!("map(): {}", cause);
+                Err(Fail::new(errno, &cause))
+            },
+            addr => Ok(addr as *mut u8),
+        }
+    }
+
+    /// Checks whether the kernel supports `opcode`.
+    pub fn supports(&self, opcode: u8) -> bool {
+        let mut probe: Probe = Probe {
+            last_op: 0,
+            ops_len: 0,
+            resv: 0,
+            resv2: [0; 3],
+            ops: [ProbeOp::default(); PROBE_OPS],
+        };
+        let ret: libc::c_long = unsafe {
+            libc::syscall(
+                libc::SYS_io_uring_register,
+                self.fd,
+                IORING_REGISTER_PROBE,
+                &mut probe as *mut Probe,
+                PROBE_OPS as u32,
+            )
+        };
+        ret == 0
+            && opcode <= probe.last_op
+            && (opcode as usize) < PROBE_OPS
+            && probe.ops[opcode as usize].flags & IO_URING_OP_SUPPORTED != 0
+    }
+
+    /// Queues `sqe`. It reaches the kernel on the next call to [Self::submit], unless the submission queue is full, in
+    /// which case everything that was queued is submitted first.
+    pub fn push(&mut self, sqe: Sqe) -> Result<(), Fail> {
+        // Safety: the kernel only moves the head forward, and only we write the tail.
+        let tail: u32 = unsafe { (*self.sq_tail).load(Ordering::Relaxed) };
+        if tail.wrapping_sub(unsafe { (*self.sq_head).load(Ordering::Acquire) }) == self.sq_entries {
+            self.submit()?;
+            if tail.wrapping_sub(unsafe { (*self.sq_head).load(Ordering::Acquire) }) == self.sq_entries {
+                let cause: &str = "io_uring submission queue is full";
+                warn!("push(): {}", cause);
+                return Err(Fail::new(libc::EBUSY, cause));
+            }
+        }
+
+        let index: u32 = tail & self.sq_mask;
+        // Safety: the index is within the submission queue and the kernel does not read the slot until the tail moves.
+        unsafe {
+            ptr::write(self.sqes.add(index as usize), sqe);
+            ptr::write(self.sq_array.add(index as usize), index);
+            (*self.sq_tail).store(tail.wrapping_add(1), Ordering::Release);
+        }
+        self.unsubmitted += 1;
+        Ok(())
+    }
+
+    /// Turns the entries on file descriptor `fd` that were queued but not handed to the kernel yet into no-ops whose
+    /// completions carry `user_data`, and hands what the entries carried in `user_data` to `f`. Cancellations are left
+    /// alone.
+    pub fn discard<F: FnMut(u64)>(&mut self, fd: RawFd, user_data: u64, mut f: F) {
+        // Safety: only we write the tail, and the kernel does not read the entries past the ones that it was handed.
+        let tail: u32 = unsafe { (*self.sq_tail).load(Ordering::Relaxed) };
+        for i in 0..self.unsubmitted {
+            let index: u32 = tail.wrapping_sub(self.unsubmitted - i) & self.sq_mask;
+            let sqe: &mut Sqe = unsafe { &mut *self.sqes.add(index as usize) };
+            if sqe.fd == fd && sqe.opcode != IORING_OP_ASYNC_CANCEL {
+                f(sqe.user_data);
+                *sqe = Sqe {
+                    opcode: IORING_OP_NOP,
+                    fd: -1,
+                    user_data,
+                    ..Default::default()
+                };
+            }
+        }
+    }
+
+    /// Hands all queued entries to the kernel with a single system call. No system call is made if nothing is queued
+    /// and no completion is waiting in the kernel for room in the completion queue. Returns the number of entries that
+    /// were submitted.
+    pub fn submit(&mut self) -> Result<usize, Fail> {
+        let overflow: bool = unsafe { (*self.sq_flags).load(Ordering::Acquire) } & IORING_SQ_CQ_OVERFLOW != 0;
+        if self.unsubmitted == 0 && !overflow {
+            return Ok(0);
+        }
+        let flags: u32 = if overflow { IORING_ENTER_GETEVENTS } else { 0 };
+        match unsafe {
+            libc::syscall(
+                libc::SYS_io_uring_enter,
+                self.fd,
+                self.unsubmitted,
+                0,
+                flags,
+                ptr::null::<libc::sigset_t>(),
+                0,
+            )
+        } {
+            submitted if submitted >= 0 => {
+                self.unsubmitted -= submitted as u32;
+                Ok(submitted as usize)
+            },
+            _ => {
+                let errno: libc::c_int = unsafe { *libc::__errno_location() };
+                match errno {
+                    // Entries stay queued and go out on the next call.
+                    libc::EINTR | libc::EAGAIN | libc::EBUSY => Ok(0),
+                    _ => {
+                        let cause: String = format!("failed to submit to io_uring (errno={:?})", errno);
+                        error!("submit(): {}", cause);
+                        Err(Fail::new(errno, &cause))
+                    },
+                }
+            },
+        }
+    }
+
+    /// Hands every completion that is ready to `f`, without any system call. Returns the number of completions.
+    pub fn reap<F: FnMut(Cqe)>(&mut self, mut f: F) -> usize {
+        // Safety: only we write the head, and the kernel does not overwrite entries until the head moves past them.
+        let mut head: u32 = unsafe { (*self.cq_head).load(Ordering::Relaxed) };
+        let tail: u32 = unsafe { (*self.cq_tail).load(Ordering::Acquire) };
+        let count: usize = tail.wrapping_sub(head) as usize;
+        while head != tail {
+            let cqe: Cqe = unsafe { ptr::read(self.cqes.add((head & self.cq_mask) as usize)) };
+            head = head.wrapping_add(1);
+            // Release the entry before handling it, so that the handler can queue new work.
+            unsafe { (*self.cq_head).store(head, Ordering::Release) };
+            f(cqe);
+        }
+        count
+    }
+
+    /// Registers a ring of `entries` provided buffers as buffer group `bgid`. The number of entries must be a power of
+    /// two.
+    pub fn register_buffer_ring(&mut self, bgid: u16, entries: u16) -> Result<BufferRing, Fail> {
+        debug_assert!(entries.is_power_of_two());
+        let layout: Layout = BufferRing::layout(entries);
+        let ring: *mut ProvidedBuffer = unsafe { alloc::alloc_zeroed(layout) } as *mut ProvidedBuffer;
+        if ring.is_null() {
+            alloc::handle_alloc_error(layout);
+        }
+        let registration: BufferRingRegistration = BufferRingRegistration {
+            ring_addr: ring as u64,
+            ring_entries: entries as u32,
+            bgid,
+            flags: 0,
+            resv: [0; 3],
+        };
+        let ret: libc::c_long = unsafe {
+            libc::syscall(
+                libc::SYS_io_uring_register,
+                self.fd,
+                IORING_REGISTER_PBUF_RING,
+                &registration as *const BufferRingRegistration,
+                1,
+            )
+        };
+        if ret != 0 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            unsafe { alloc::dealloc(ring as *mut u8, layout) };
+            let cause: String = format!("failed to register provided buffers (errno={:?})", errno);
+            error!("register_buffer_ring(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        Ok(BufferRing { ring, entries, tail: 0 })
+    }
+}
+
+impl BufferRing {
+    fn layout(entries: u16) -> Layout {
+        match Layout::from_size_align(entries as usize * mem::size_of::<ProvidedBuffer>(), PAGE_SIZE) {
+            Ok(layout) => layout,
+            Err(_) => unreachable!("the ring of provided buffers has a valid layout"),
+        }
+    }
+
+    /// Adds the `len` bytes at `addr` to the ring as buffer `bid`. The kernel sees the buffer after the next call to
+    /// [Self::publish].
+    pub fn add(&mut self, addr: *mut u8, len: u32, bid: u16) {
+        let index: usize = (self.tail & (self.entries - 1)) as usize;
+        // Safety: the index is within the ring and the kernel only reads entries before the published tail. The tail
+        // overlaps with the reserved field of the first entry, so that field is left alone.
+        unsafe {
+            let entry: *mut ProvidedBuffer = self.ring.add(index);
+            ptr::addr_of_mut!((*entry).addr).write(addr as u64);
+            ptr::addr_of_mut!((*entry).len).write(len);
+            ptr::addr_of_mut!((*entry).bid).write(bid);
+        }
+        self.tail = self.tail.wrapping_add(1);
+    }
+
+    /// Makes the buffers that were added visible to the kernel.
+    pub fn publish(&mut self) {
+        // Safety: the tail is a 16-bit field at the end of the first entry, which is suitably aligned.
+        unsafe {
+            let tail: *const AtomicU16 = ptr::addr_of!((*self.ring).resv) as *const AtomicU16;
+            (*tail).store(self.tail, Ordering::Release);
+        }
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Drop for IoUring {
+    fn drop(&mut self) {
+        // Closing the ring cancels all of its operations and drops its registrations.
+        unsafe {
+            libc::munmap(self.sqes as *mut libc::c_void, self.sqes_size);
+            libc::munmap(self.rings as *mut libc::c_void, self.rings_size);
+            libc::close(self.fd);
+        }
+    }
+}
+
+impl Drop for BufferRing {
+    fn drop(&mut self) {
+        unsafe { alloc::dealloc(self.ring as *mut u8, Self::layout(self.entries)) };
+    }
+}
@@ -0,0 +1,884 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! io_uring backend for the catnap transport.
+//!
+//! Instead of waiting for readiness with epoll and then issuing a system call per operation, this backend hands the
+//! operations themselves to the kernel. Listening sockets keep a multishot accept armed and established sockets keep a
+//! multishot receive armed, so a single submission yields a completion for every connection or message that arrives.
+//! Receives pick their buffers from a ring of provided buffers, which are handed over to the application as they are.
+//! Sends are queued in the submission queue as they are pushed and large ones go out with zero copy. All of the work
+//! that is queued during a pass of the scheduler reaches the kernel with a single system call, and completions are
+//! drained from shared memory without any.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    catnap::transport::{
+        active_socket::{ActiveSocketData, Outgoing},
+        socket::{SharedSocketData, SocketData},
+        uring::{self, BufferRing, Cqe, IoUring, Sqe},
+    },
+    collections::async_value::SharedAsyncValue,
+    expect_some,
+    perftools::stats::{self, Counter},
+    runtime::{
+        fail::Fail,
+        limits,
+        memory::{DemiBuffer, SizeClassPools},
+        types::DEMI_SGARRAY_MAXLEN,
+    },
+};
+use ::slab::Slab;
+use ::socket2::{SockAddr, Socket};
+use ::std::{
+    cmp::min,
+    mem,
+    net::SocketAddr,
+    ops::DerefMut,
+    os::fd::{AsRawFd, FromRawFd, RawFd},
+    ptr,
+    rc::Rc,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of entries in the submission queue.
+const RING_ENTRIES: u32 = 1024;
+
+/// Number of provided buffers that receives pick from.
+const NUM_RECV_BUFFERS: u16 = 256;
+
+/// Buffer group of the provided buffers.
+const RECV_BUFFER_GROUP: u16 = 0;
+
+/// Room that a datagram receive reserves in front of the payload for the header and the source address.
+const RECVMSG_HEADER_SIZE: usize = mem::size_of::<RecvMsgOut>() + mem::size_of::<libc::sockaddr_storage>();
+
+/// Size of a provided buffer. This fits the payload of a receive on the epoll backend.
+const RECV_BUFFER_SIZE: usize = limits::RECVBUF_SIZE_MAX + RECVMSG_HEADER_SIZE;
+
+/// Pushes of at least this many bytes are sent with zero copy, if the kernel supports it. Below this, pinning the
+/// pages and waiting for the notification costs more than the copy.
+const SEND_ZC_THRESHOLD: usize = 16 * 1024;
+
+/// Tags submissions whose completions carry nothing to handle.
+const IGNORED: u64 = u64::MAX;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Header that a multishot datagram receive writes at the start of a buffer (`struct io_uring_recvmsg_out`).
+#[repr(C)]
+struct RecvMsgOut {
+    namelen: u32,
+    controllen: u32,
+    payloadlen: u32,
+    flags: u32,
+}
+
+/// A send that was handed to the kernel, with everything that the kernel reads while it is in flight.
+struct SendOperation {
+    data: SharedSocketData,
+    outgoing: Outgoing,
+    /// Destination, for datagrams.
+    addr: Option<SockAddr>,
+    iovecs: Vec<libc::iovec>,
+    msghdr: libc::msghdr,
+    /// Result of a zero-copy send, while it waits for the kernel to let go of the buffers.
+    result: Option<i32>,
+}
+
+/// An operation that was handed to the kernel. Operations hold on to their socket, so that its file descriptor stays
+/// open until they complete.
+enum Operation {
+    /// Multishot accept on a listening socket.
+    Accept(SharedSocketData),
+    /// Multishot receive on a stream socket.
+    Recv(SharedSocketData),
+    /// Multishot receive on a datagram socket, which also reports the source of every datagram.
+    RecvMsg(SharedSocketData, Box<libc::msghdr>),
+    Connect {
+        /// The socket and the address are only kept alive until the connect completes.
+        _data: SharedSocketData,
+        _addr: Box<SockAddr>,
+        result: SharedAsyncValue<Option<Result<(), Fail>>>,
+    },
+    Send(Box<SendOperation>),
+}
+
+/// io_uring backend.
+pub struct UringBackend {
+    /// This comes first so that the ring is torn down before the memory that the kernel may still write to.
+    ring: IoUring,
+    buffer_ring: BufferRing,
+    /// Provided buffers, by buffer ID. The kernel owns a buffer from the time it is added to the ring until a receive
+    /// completes into it.
+    recv_buffers: Vec<Option<DemiBuffer>>,
+    /// Pools that provided buffers come from, if enabled.
+    sga_pools: Option<Rc<SizeClassPools>>,
+    ops: Slab<Operation>,
+    /// Whether large sends go out with zero copy.
+    zero_copy: bool,
+    /// Sockets that may have new outgoing messages.
+    pending_sends: Vec<SharedSocketData>,
+    /// Multishot operations that stopped for lack of resources and are armed again on the next poll.
+    stalled: Vec<usize>,
+    /// Entries that did not fit in the submission queue, in order. They are queued first on the next poll.
+    deferred: Vec<Sqe>,
+    completions: Vec<Cqe>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl UringBackend {
+    pub fn new(sga_pools: Option<Rc<SizeClassPools>>) -> Result<Self, Fail> {
+        let mut ring: IoUring = IoUring::new(RING_ENTRIES)?;
+        let zero_copy: bool = ring.supports(uring::IORING_OP_SEND_ZC) && ring.supports(uring::IORING_OP_SENDMSG_ZC);
+        if !zero_copy {
+            warn!("new(): io_uring does not support zero-copy sends, copying all of them");
+        }
+        // Rings of provided buffers and multishot operations came along in Linux 5.19.
+        let buffer_ring: BufferRing = ring.register_buffer_ring(RECV_BUFFER_GROUP, NUM_RECV_BUFFERS)?;
+
+        let mut me: Self = Self {
+            ring,
+            buffer_ring,
+            recv_buffers: (0..NUM_RECV_BUFFERS).map(|_| None).collect(),
+            sga_pools,
+            ops: Slab::new(),
+            zero_copy,
+            pending_sends: Vec::new(),
+            stalled: Vec::new(),
+            deferred: Vec::new(),
+            completions: Vec::with_capacity(RING_ENTRIES as usize),
+        };
+        for bid in 0..NUM_RECV_BUFFERS {
+            me.provide_buffer(bid)?;
+        }
+        me.buffer_ring.publish();
+        Ok(me)
+    }
+
+    /// Keeps a multishot accept armed on the listening socket `data`.
+    pub fn accept(&mut self, data: &SharedSocketData) {
+        let key: usize = self.ops.insert(Operation::Accept(data.clone()));
+        self.arm(key)
+    }
+
+    /// Keeps a multishot receive armed on the established socket `data`.
+    pub fn receive(&mut self, data: &SharedSocketData, is_stream: bool) {
+        let op: Operation = if is_stream {
+            Operation::Recv(data.clone())
+        } else {
+            // Only the sizes of the address and the control data are read from the header. The kernel reserves that
+            // much room in every buffer.
+            let mut msghdr: Box<libc::msghdr> = Box::new(unsafe { mem::zeroed() });
+            msghdr.msg_namelen = mem::size_of::<libc::sockaddr_storage>() as libc::socklen_t;
+            Operation::RecvMsg(data.clone(), msghdr)
+        };
+        let key: usize = self.ops.insert(op);
+        self.arm(key)
+    }
+
+    /// Connects `data` to `remote`. The returned value is set when the connection is established or fails.
+    pub fn connect(
+        &mut self,
+        data: &SharedSocketData,
+        remote: SocketAddr,
+    ) -> SharedAsyncValue<Option<Result<(), Fail>>> {
+        let addr: Box<SockAddr> = Box::new(SockAddr::from(remote));
+        let result: SharedAsyncValue<Option<Result<(), Fail>>> = SharedAsyncValue::new(None);
+        let sqe: Sqe = Sqe {
+            opcode: uring::IORING_OP_CONNECT,
+            fd: data.as_raw_fd(),
+            addr: addr.as_ptr() as u64,
+            off: addr.len() as u64,
+            ..Default::default()
+        };
+        let key: usize = self.ops.insert(Operation::Connect {
+            _data: data.clone(),
+            _addr: addr,
+            result: result.clone(),
+        });
+        self.submit(key, sqe);
+        result
+    }
+
+    /// Notes that `data` may have new outgoing messages. They are handed to the kernel on the next poll.
+    pub fn schedule_send(&mut self, data: &SharedSocketData) {
+        self.pending_sends.push(data.clone());
+    }
+
+    /// Cancels all operations on the socket with file descriptor `fd`. The socket is closed once they complete.
+    pub fn cancel(&mut self, fd: RawFd) {
+        // Work on the socket that the kernel was not handed yet is dropped, rather than started after the cancellation.
+        self.pending_sends
+            .retain(|data: &SharedSocketData| data.as_raw_fd() != fd);
+        let ops: &mut Slab<Operation> = &mut self.ops;
+        self.stalled.retain(|key: &usize| -> bool {
+            let cancelled: bool = matches!(
+                &ops[*key],
+                Operation::Accept(data) | Operation::Recv(data) | Operation::RecvMsg(data, _) if data.as_raw_fd() == fd
+            );
+            if cancelled {
+                ops.remove(*key);
+            }
+            !cancelled
+        });
+        let mut completions: Vec<Cqe> = mem::take(&mut self.completions);
+        let cancelled = |user_data: u64| -> Cqe {
+            Cqe {
+                user_data,
+                res: -libc::ECANCELED,
+                flags: 0,
+            }
+        };
+        self.deferred.retain(|sqe: &Sqe| -> bool {
+            let discarded: bool =
+                sqe.fd == fd && sqe.opcode != uring::IORING_OP_ASYNC_CANCEL && sqe.user_data != IGNORED;
+            if discarded {
+                completions.push(cancelled(sqe.user_data));
+            }
+            !discarded
+        });
+        self.ring
+            .discard(fd, IGNORED, |user_data: u64| completions.push(cancelled(user_data)));
+        for cqe in completions.drain(..) {
+            if let Err(e) = self.complete(cqe) {
+                warn!("cancel(): {:?}", e);
+            }
+        }
+        self.completions = completions;
+
+        self.queue(Sqe {
+            opcode: uring::IORING_OP_ASYNC_CANCEL,
+            fd,
+            op_flags: uring::IORING_ASYNC_CANCEL_FD | uring::IORING_ASYNC_CANCEL_ALL,
+            user_data: IGNORED,
+            ..Default::default()
+        });
+    }
+
+    /// Hands all queued work to the kernel and handles all completions. Operations that fail only fail on their own,
+    /// so this only returns an error if the ring itself does not take submissions.
+    pub fn poll(&mut self) -> Result<(), Fail> {
+        for sqe in mem::take(&mut self.deferred) {
+            self.queue(sqe);
+        }
+        for data in mem::take(&mut self.pending_sends) {
+            self.start_send(data);
+        }
+        for key in mem::take(&mut self.stalled) {
+            self.arm(key);
+        }
+        let submitted: Result<usize, Fail> = self.ring.submit();
+
+        let mut completions: Vec<Cqe> = mem::take(&mut self.completions);
+        self.ring.reap(|cqe: Cqe| completions.push(cqe));
+        for cqe in completions.drain(..) {
+            if let Err(e) = self.complete(cqe) {
+                warn!("poll(): {:?}", e);
+            }
+        }
+        self.completions = completions;
+        self.buffer_ring.publish();
+        submitted.map(|_| ())
+    }
+
+    /// Queues the multishot operation at `key`.
+    fn arm(&mut self, key: usize) {
+        let sqe: Sqe = match &self.ops[key] {
+            Operation::Accept(data) => Sqe {
+                opcode: uring::IORING_OP_ACCEPT,
+                ioprio: uring::IORING_ACCEPT_MULTISHOT,
+                fd: data.as_raw_fd(),
+                op_flags: (libc::SOCK_NONBLOCK | libc::SOCK_CLOEXEC) as u32,
+                ..Default::default()
+            },
+            Operation::Recv(data) => Sqe {
+                opcode: uring::IORING_OP_RECV,
+                flags: uring::IOSQE_BUFFER_SELECT,
+                ioprio: uring::IORING_RECV_MULTISHOT,
+                fd: data.as_raw_fd(),
+                buf_group: RECV_BUFFER_GROUP,
+                ..Default::default()
+            },
+            Operation::RecvMsg(data, msghdr) => Sqe {
+                opcode: uring::IORING_OP_RECVMSG,
+                flags: uring::IOSQE_BUFFER_SELECT,
+                ioprio: uring::IORING_RECV_MULTISHOT,
+                fd: data.as_raw_fd(),
+                addr: msghdr.as_ref() as *const libc::msghdr as u64,
+                len: 1,
+                buf_group: RECV_BUFFER_GROUP,
+                ..Default::default()
+            },
+            Operation::Connect { .. } | Operation::Send(_) => unreachable!("only multishot operations are armed"),
+        };
+        self.submit(key, sqe)
+    }
+
+    /// Queues `sqe` on behalf of the operation at `key`.
+    fn submit(&mut self, key: usize, mut sqe: Sqe) {
+        sqe.user_data = key as u64;
+        self.queue(sqe)
+    }
+
+    /// Queues `sqe`, or defers it to the next poll if the submission queue is full. If the ring does not take it, the
+    /// operation that it belongs to fails.
+    fn queue(&mut self, sqe: Sqe) {
+        // Entries that were deferred go first.
+        if !self.deferred.is_empty() {
+            self.deferred.push(sqe);
+            return;
+        }
+        match self.ring.push(sqe) {
+            Ok(()) => (),
+            Err(e) if e.errno == libc::EBUSY => self.deferred.push(sqe),
+            Err(e) if sqe.user_data == IGNORED => warn!("queue(): could not queue entry: {:?}", e),
+            Err(e) => self.fail(sqe.user_data as usize, e),
+        }
+    }
+
+    /// Fails the operation at `key` with `e`, when the kernel was not handed it.
+    fn fail(&mut self, key: usize, e: Fail) {
+        match self.ops.remove(key) {
+            Operation::Accept(mut data) => {
+                if let SocketData::Passive(passive) = data.deref_mut() {
+                    passive.push_accepted(Err(e));
+                }
+            },
+            Operation::Recv(mut data) | Operation::RecvMsg(mut data, _) => {
+                if let SocketData::Active(active) = data.deref_mut() {
+                    active.push_received(Err(e));
+                }
+            },
+            Operation::Connect { mut result, .. } => result.set(Some(Err(e))),
+            Operation::Send(op) => {
+                let SendOperation {
+                    mut data, mut outgoing, ..
+                } = *op;
+                outgoing.result.set(Some(Err(e)));
+                if let SocketData::Active(active) = data.deref_mut() {
+                    active.finish_send();
+                }
+                self.start_send(data)
+            },
+        }
+    }
+
+    /// Adds a new buffer to the ring of provided buffers as buffer `bid`.
+    fn provide_buffer(&mut self, bid: u16) -> Result<(), Fail> {
+        let mut buf: DemiBuffer = match self.sga_pools {
+            Some(ref pools) => pools.alloc(RECV_BUFFER_SIZE, 0)?,
+            None => DemiBuffer::new(RECV_BUFFER_SIZE as u16),
+        };
+        self.buffer_ring.add(buf.as_mut_ptr(), buf.len() as u32, bid);
+        self.recv_buffers[bid as usize] = Some(buf);
+        Ok(())
+    }
+
+    /// Takes the provided buffer that the completion `cqe` used, if any, and puts a new one in its place.
+    fn take_buffer(&mut self, cqe: &Cqe) -> Result<Option<DemiBuffer>, Fail> {
+        if cqe.flags & uring::IORING_CQE_F_BUFFER == 0 {
+            return Ok(None);
+        }
+        let bid: u16 = (cqe.flags >> uring::IORING_CQE_BUFFER_SHIFT) as u16;
+        let buf: DemiBuffer = expect_some!(
+            self.recv_buffers[bid as usize].take(),
+            "the kernel only picks buffers from the ring"
+        );
+        self.provide_buffer(bid)?;
+        Ok(Some(buf))
+    }
+
+    /// Handles the completion `cqe`.
+    fn complete(&mut self, cqe: Cqe) -> Result<(), Fail> {
+        if cqe.user_data == IGNORED {
+            return Ok(());
+        }
+        let key: usize = cqe.user_data as usize;
+        // Multishot operations stop when this is not set.
+        let more: bool = cqe.flags & uring::IORING_CQE_F_MORE != 0;
+        match self.ops.get_mut(key) {
+            Some(Operation::Accept(data)) => {
+                let mut data: SharedSocketData = data.clone();
+                if let Some(result) = Self::accepted(cqe.res) {
+                    if let SocketData::Passive(passive) = data.deref_mut() {
+                        passive.push_accepted(result);
+                    }
+                }
+                if !more {
+                    match cqe.res {
+                        res if res >= 0 => self.arm(key),
+                        // The listening socket is closing.
+                        res if res == -libc::ECANCELED || res == -libc::EBADF || res == -libc::EINVAL => {
+                            self.ops.remove(key);
+                        },
+                        // Running out of file descriptors or memory does not last, so accept again on the next poll.
+                        _ => self.stalled.push(key),
+                    }
+                }
+                Ok(())
+            },
+            Some(Operation::Recv(data)) | Some(Operation::RecvMsg(data, _)) => {
+                let mut data: SharedSocketData = data.clone();
+                let buf: Option<DemiBuffer> = self.take_buffer(&cqe)?;
+                let is_stream: bool = matches!(self.ops[key], Operation::Recv(_));
+                if cqe.res == -libc::ENOBUFS {
+                    // Receive again once buffers have been put back in the ring.
+                    self.stalled.push(key);
+                    return Ok(());
+                }
+                if let Some(result) = Self::received(cqe.res, buf, is_stream) {
+                    if let SocketData::Active(active) = data.deref_mut() {
+                        active.push_received(result);
+                    }
+                }
+                if !more {
+                    if cqe.res > 0 {
+                        self.arm(key);
+                    } else {
+                        self.ops.remove(key);
+                    }
+                }
+                Ok(())
+            },
+            Some(Operation::Connect { .. }) => {
+                if let Operation::Connect { mut result, .. } = self.ops.remove(key) {
+                    result.set(Some(match cqe.res {
+                        res if res >= 0 => Ok(()),
+                        res => {
+                            let cause: String = format!("failed to connect on socket: {:?}", -res);
+                            error!("complete(): {}", cause);
+                            Err(Fail::new(-res, &cause))
+                        },
+                    }));
+                }
+                Ok(())
+            },
+            Some(Operation::Send(op)) => {
+                // A zero-copy send completes twice: first with its result and then once the kernel is done with the
+                // buffers.
+                let res: i32 = if cqe.flags & uring::IORING_CQE_F_NOTIF != 0 {
+                    expect_some!(op.result, "the result comes before the notification")
+                } else if more {
+                    op.result = Some(cqe.res);
+                    return Ok(());
+                } else {
+                    cqe.res
+                };
+                match self.ops.remove(key) {
+                    Operation::Send(op) => self.finish_send(op, res),
+                    _ => unreachable!("the operation is a send"),
+                }
+                Ok(())
+            },
+            None => {
+                warn!(
+                    "complete(): completion for unknown operation (user_data={:?})",
+                    cqe.user_data
+                );
+                Ok(())
+            },
+        }
+    }
+
+    /// Turns the result of an accept into a new connection. Returns nothing if the accept was cancelled.
+    fn accepted(res: i32) -> Option<Result<(Socket, SocketAddr), Fail>> {
+        if res == -libc::ECANCELED {
+            return None;
+        }
+        if res < 0 {
+            let cause: String = format!("failed to accept on socket: {:?}", -res);
+            error!("accepted(): {}", cause);
+            return Some(Err(Fail::new(-res, &cause)));
+        }
+        // Safety: the kernel hands over the new file descriptor.
+        let new_socket: Socket = unsafe { Socket::from_raw_fd(res) };
+        match new_socket.peer_addr().map(|addr: SockAddr| addr.as_socket()) {
+            Ok(Some(addr)) => Some(Ok((new_socket, addr))),
+            _ => {
+                let cause: &str = "failed to get address of new connection";
+                error!("accepted(): {}", cause);
+                Some(Err(Fail::new(libc::ENOTCONN, cause)))
+            },
+        }
+    }
+
+    /// Turns the result of a receive into incoming data. Returns nothing if the receive was cancelled.
+    fn received(
+        res: i32,
+        buf: Option<DemiBuffer>,
+        is_stream: bool,
+    ) -> Option<Result<(Option<SocketAddr>, DemiBuffer), Fail>> {
+        if res == -libc::ECANCELED {
+            return None;
+        }
+        if res < 0 {
+            let cause: String = format!("failed to receive on socket: {:?}", -res);
+            error!("received(): {}", cause);
+            return Some(Err(Fail::new(-res, &cause)));
+        }
+        let mut buf: DemiBuffer = match buf {
+            Some(buf) => buf,
+            // The connection was closed.
+            None => return Some(Ok((None, DemiBuffer::new(0)))),
+        };
+        let nbytes: usize = res as usize;
+        if is_stream {
+            return Some(buf.trim(buf.len() - nbytes).map(|()| (None, buf)));
+        }
+
+        // Safety: the kernel wrote the header and the source address at the start of the buffer.
+        let (header, addr): (RecvMsgOut, Option<SocketAddr>) = unsafe {
+            let header: RecvMsgOut = ptr::read_unaligned(buf.as_ptr() as *const RecvMsgOut);
+            let mut storage: libc::sockaddr_storage = mem::zeroed();
+            let namelen: usize = min(header.namelen as usize, mem::size_of::<libc::sockaddr_storage>());
+            ptr::copy_nonoverlapping(
+                buf.as_ptr().add(mem::size_of::<RecvMsgOut>()),
+                &mut storage as *mut libc::sockaddr_storage as *mut u8,
+                namelen,
+            );
+            (header, SockAddr::new(storage, namelen as libc::socklen_t).as_socket())
+        };
+        let payload: usize = nbytes - RECVMSG_HEADER_SIZE - header.controllen as usize;
+        if let Err(e) = buf.adjust(RECVMSG_HEADER_SIZE + header.controllen as usize) {
+            return Some(Err(e));
+        }
+        Some(buf.trim(buf.len() - payload).map(|()| (addr, buf)))
+    }
+
+    /// Hands the next outgoing message of `data` to the kernel, unless a send is already in flight on it.
+    fn start_send(&mut self, mut data: SharedSocketData) {
+        let outgoing: Outgoing = match data.deref_mut() {
+            SocketData::Active(active) => match active.start_send() {
+                Some(outgoing) => outgoing,
+                None => return,
+            },
+            _ => return,
+        };
+        self.send(data, outgoing)
+    }
+
+    /// Hands `outgoing` to the kernel.
+    fn send(&mut self, mut data: SharedSocketData, mut outgoing: Outgoing) {
+        // A dummy request has nothing to send.
+        if outgoing.buf.is_empty() && outgoing.rest.is_empty() {
+            outgoing.result.set(Some(Ok(())));
+            if let SocketData::Active(active) = data.deref_mut() {
+                active.finish_send();
+            }
+            return self.start_send(data);
+        }
+
+        let len: usize = outgoing
+            .rest
+            .iter()
+            .fold(outgoing.buf.len(), |len: usize, segment: &DemiBuffer| {
+                len + segment.len()
+            });
+        let zero_copy: bool = self.zero_copy && len >= SEND_ZC_THRESHOLD;
+        let fd: RawFd = data.as_raw_fd();
+        let mut op: Box<SendOperation> = Box::new(SendOperation {
+            data,
+            addr: outgoing.addr.map(SockAddr::from),
+            outgoing,
+            iovecs: Vec::new(),
+            msghdr: unsafe { mem::zeroed() },
+            result: None,
+        });
+        let sqe: Sqe = if op.outgoing.rest.is_empty() && op.addr.is_none() {
+            Sqe {
+                opcode: if zero_copy {
+                    uring::IORING_OP_SEND_ZC
+                } else {
+                    uring::IORING_OP_SEND
+                },
+                fd,
+                addr: op.outgoing.buf.as_ptr() as u64,
+                len: op.outgoing.buf.len() as u32,
+                op_flags: libc::MSG_NOSIGNAL as u32,
+                ..Default::default()
+            }
+        } else {
+            // The segments, the header and the destination live in the box, which does not move while the kernel reads
+            // them.
+            let op: &mut SendOperation = op.as_mut();
+            op.iovecs.push(libc::iovec {
+                iov_base: op.outgoing.buf.as_ptr() as *mut libc::c_void,
+                iov_len: op.outgoing.buf.len(),
+            });
+            for segment in op.outgoing.rest.iter().take(DEMI_SGARRAY_MAXLEN - 1) {
+                op.iovecs.push(libc::iovec {
+                    iov_base: segment.as_ptr() as *mut libc::c_void,
+                    iov_len: segment.len(),
+                });
+            }
+            op.msghdr.msg_iov = op.iovecs.as_mut_ptr();
+            op.msghdr.msg_iovlen = op.iovecs.len() as _;
+            if let Some(ref addr) = op.addr {
+                op.msghdr.msg_name = addr.as_ptr() as *mut libc::c_void;
+                op.msghdr.msg_namelen = addr.len();
+            }
+            Sqe {
+                opcode: if zero_copy {
+                    uring::IORING_OP_SENDMSG_ZC
+                } else {
+                    uring::IORING_OP_SENDMSG
+                },
+                fd,
+                addr: &op.msghdr as *const libc::msghdr as u64,
+                len: 1,
+                op_flags: libc::MSG_NOSIGNAL as u32,
+                ..Default::default()
+            }
+        };
+        let key: usize = self.ops.insert(Operation::Send(op));
+        self.submit(key, sqe)
+    }
+
+    /// Handles the result `res` of the send `op`. What was not sent yet goes out right away and the next outgoing
+    /// message follows once everything was sent, unless the send was cancelled.
+    fn finish_send(&mut self, op: Box<SendOperation>, res: i32) {
+        let SendOperation {
+            mut data, mut outgoing, ..
+        } = *op;
+        if res == -libc::ECANCELED {
+            let cause: &str = "send was cancelled";
+            debug!("finish_send(): {}", cause);
+            outgoing.result.set(Some(Err(Fail::new(libc::ECANCELED, cause))));
+            if let SocketData::Active(active) = data.deref_mut() {
+                active.finish_send();
+            }
+            return;
+        }
+        if res < 0 {
+            let cause: String = format!("failed to send on socket: {:?}", -res);
+            error!("finish_send(): {}", cause);
+            outgoing.result.set(Some(Err(Fail::new(-res, &cause))));
+        } else {
+            trace!("data pushed ({:?} bytes)", res);
+            stats::count(Counter::PacketsOut, 1);
+            stats::count(Counter::BytesOut, res as u64);
+            ActiveSocketData::consume(&mut outgoing.buf, &mut outgoing.rest, res as usize);
+            if !outgoing.buf.is_empty() || !outgoing.rest.is_empty() {
+                return self.send(data, outgoing);
+            }
+            outgoing.result.set(Some(Ok(())));
+        }
+        if let SocketData::Active(active) = data.deref_mut() {
+            active.finish_send();
+        }
+        self.start_send(data)
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::{
+        catnap::transport::{
+            socket::SharedSocketData,
+            uring::Cqe,
+            uring_backend::{Operation, UringBackend},
+        },
+        expect_some,
+        runtime::{fail::Fail, memory::DemiBuffer},
+    };
+    use ::anyhow::{bail, Result};
+    use ::socket2::{Domain, Protocol, Socket, Type};
+    use ::std::{
+        future::Future,
+        net::{Ipv4Addr, SocketAddr, SocketAddrV4},
+        os::fd::AsRawFd,
+        pin::pin,
+        task::{Context, Poll, Waker},
+        thread,
+        time::Duration,
+    };
+
+    /// Number of times that the backend is polled before a test gives up.
+    const MAX_POLLS: usize = 1000;
+
+    /// Creates a backend, or returns `None` if the kernel does not support io_uring, like in many containers.
+    fn new_backend() -> Result<Option<UringBackend>> {
+        match UringBackend::new(None) {
+            Ok(backend) => Ok(Some(backend)),
+            // Containers often forbid io_uring, and kernels before 5.19 lack rings of provided buffers.
+            Err(e) if [libc::ENOSYS, libc::EPERM, libc::ENOTSUP, libc::EINVAL].contains(&e.errno) => {
+                warn!("new_backend(): io_uring is not available: {:?}", e);
+                Ok(None)
+            },
+            Err(e) => bail!("failed to create io_uring backend: {:?}", e),
+        }
+    }
+
+    /// Opens a TCP connection on the loopback interface and returns both of its ends.
+    fn connected_pair() -> Result<(SharedSocketData, SharedSocketData)> {
+        let listener: Socket = Socket::new(Domain::IPV4, Type::STREAM, Some(Protocol::TCP))?;
+        listener.bind(&SocketAddr::V4(SocketAddrV4::new(Ipv4Addr::LOCALHOST, 0)).into())?;
+        listener.listen(1)?;
+        let client: Socket = Socket::new(Domain::IPV4, Type::STREAM, Some(Protocol::TCP))?;
+        client.connect(&listener.local_addr()?)?;
+        let (server, _): (Socket, _) = listener.accept()?;
+        client.set_nonblocking(true)?;
+        server.set_nonblocking(true)?;
+        Ok((
+            SharedSocketData::new_active(client),
+            SharedSocketData::new_active(server),
+        ))
+    }
+
+    /// Polls `future` and the backend in turns until the future completes.
+    fn run_until<T>(backend: &mut UringBackend, future: impl Future<Output = T>) -> Result<T> {
+        let mut future = pin!(future);
+        let mut context: Context = Context::from_waker(Waker::noop());
+        for _ in 0..MAX_POLLS {
+            if let Poll::Ready(output) = future.as_mut().poll(&mut context) {
+                return Ok(output);
+            }
+            backend.poll()?;
+            thread::sleep(Duration::from_millis(1));
+        }
+        bail!("operation did not complete")
+    }
+
+    /// Checks that data pushed on one end of a connection is popped on the other.
+    #[test]
+    fn test_uring_push_pop() -> Result<()> {
+        let mut backend: UringBackend = match new_backend()? {
+            Some(backend) => backend,
+            None => return Ok(()),
+        };
+        let (client, mut server): (SharedSocketData, SharedSocketData) = connected_pair()?;
+        backend.receive(&server, true);
+
+        let payload: &[u8] = b"demikernel";
+        let buf: DemiBuffer = DemiBuffer::from_slice(payload)?;
+        let mut pusher: SharedSocketData = client.clone();
+        let push = pusher.push(None, buf);
+        backend.schedule_send(&client);
+        run_until(&mut backend, push)??;
+
+        let (addr, buf): (Option<SocketAddr>, DemiBuffer) = run_until(&mut backend, server.pop(1024))??;
+        crate::ensure_eq!(addr, None);
+        crate::ensure_eq!(&buf[..], payload);
+        Ok(())
+    }
+
+    /// Checks that a listening socket keeps accepting after its multishot accept ends with an error, such as running out
+    /// of file descriptors.
+    #[test]
+    fn test_uring_accept_resumes_after_error() -> Result<()> {
+        let mut backend: UringBackend = match new_backend()? {
+            Some(backend) => backend,
+            None => return Ok(()),
+        };
+        let socket: Socket = Socket::new(Domain::IPV4, Type::STREAM, Some(Protocol::TCP))?;
+        socket.bind(&SocketAddr::V4(SocketAddrV4::new(Ipv4Addr::LOCALHOST, 0)).into())?;
+        socket.listen(1)?;
+        socket.set_nonblocking(true)?;
+        let local: SocketAddr = expect_some!(socket.local_addr()?.as_socket(), "should be an IPv4 address");
+        let mut listener: SharedSocketData = SharedSocketData::new_inactive(socket);
+        listener.move_socket_to_passive();
+        backend.accept(&listener);
+
+        // The accept ends as if the process ran out of file descriptors.
+        let key: usize = match backend.ops.iter().next() {
+            Some((key, Operation::Accept(_))) => key,
+            _ => bail!("accept should be armed"),
+        };
+        backend.complete(Cqe {
+            user_data: key as u64,
+            res: -libc::EMFILE,
+            flags: 0,
+        })?;
+        let mut acceptor: SharedSocketData = listener.clone();
+        match run_until(&mut backend, acceptor.accept())? {
+            Err(e) => crate::ensure_eq!(e.errno, libc::EMFILE),
+            Ok(_) => bail!("accept should have failed"),
+        }
+
+        // It is armed again, and the next connection is accepted.
+        backend.poll()?;
+        crate::ensure_eq!(backend.stalled.is_empty(), true);
+        crate::ensure_eq!(backend.ops.contains(key), true);
+        let client: Socket = Socket::new(Domain::IPV4, Type::STREAM, Some(Protocol::TCP))?;
+        client.connect(&local.into())?;
+        let (_, remote): (Socket, SocketAddr) = run_until(&mut backend, acceptor.accept())??;
+        crate::ensure_eq!(
+            remote,
+            expect_some!(client.local_addr()?.as_socket(), "should be an IPv4 address")
+        );
+        Ok(())
+    }
+
+    /// Checks that cancelling the operations on a socket completes all of them.
+    #[test]
+    fn test_uring_cancel() -> Result<()> {
+        let mut backend: UringBackend = match new_backend()? {
+            Some(backend) => backend,
+            None => return Ok(()),
+        };
+        let (_client, server): (SharedSocketData, SharedSocketData) = connected_pair()?;
+        backend.receive(&server, true);
+        backend.poll()?;
+        crate::ensure_eq!(backend.ops.len(), 1);
+
+        backend.cancel(server.as_raw_fd());
+        for _ in 0..MAX_POLLS {
+            if backend.ops.is_empty() {
+                return Ok(());
+            }
+            backend.poll()?;
+            thread::sleep(Duration::from_millis(1));
+        }
+        bail!("receive was not cancelled")
+    }
+
+    /// Checks that cancelling the operations on a socket drops those that were not handed to the kernel yet.
+    #[test]
+    fn test_uring_cancel_drops_queued() -> Result<()> {
+        let mut backend: UringBackend = match new_backend()? {
+            Some(backend) => backend,
+            None => return Ok(()),
+        };
+        let (client, server): (SharedSocketData, SharedSocketData) = connected_pair()?;
+        backend.receive(&server, true);
+
+        // Queue a push whose send is only started on the next poll.
+        let buf: DemiBuffer = DemiBuffer::from_slice(b"demikernel")?;
+        let mut pusher: SharedSocketData = client.clone();
+        let mut push = pin!(pusher.push(None, buf));
+        let mut context: Context = Context::from_waker(Waker::noop());
+        crate::ensure_eq!(push.as_mut().poll(&mut context).is_pending(), true);
+        backend.schedule_send(&client);
+
+        // Both are dropped right away, without waiting for the kernel.
+        backend.cancel(server.as_raw_fd());
+        backend.cancel(client.as_raw_fd());
+        crate::ensure_eq!(backend.ops.is_empty(), true);
+        crate::ensure_eq!(backend.pending_sends.is_empty(), true);
+        backend.poll()?;
+        crate::ensure_eq!(backend.ops.is_empty(), true);
+        match push.as_mut().poll(&mut context) {
+            Poll::Pending => Ok(()),
+            Poll::Ready(result) => {
+                let result: Result<(), Fail> = result;
+                bail!("push should not have been sent: {:?}", result)
+            },
+        }
+    }
+}
@@ -15,9 +15,18 @@ use std::{cell::Cell, marker::PhantomData, pin::Pin};
 use windows::Win32::{
     Foundation::{CloseHandle, FALSE, HANDLE, INVALID_HANDLE_VALUE, NTSTATUS, WAIT_TIMEOUT, WIN32_ERROR},
     Networking::WinSock::SOCKET,
+    Storage::FileSystem::SetFileCompletionNotificationModes,
     System::IO::{CreateIoCompletionPort, GetQueuedCompletionStatusEx, OVERLAPPED, OVERLAPPED_ENTRY},
 };
 
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+// Constants missing from windows crate.
+const FILE_SKIP_COMPLETION_PORT_ON_SUCCESS: u8 = 0x1;
+const FILE_SKIP_SET_EVENT_ON_HANDLE: u8 = 0x2;
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -33,6 +42,16 @@ pub struct OverlappedResult {
     pub bytes_transferred: u32,
 }
 
+/// How an overlapped I/O operation started, as returned by the `start` function given to `IoCompletionPort::do_io`.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum OverlappedStart {
+    /// The operation is in progress, and its OVERLAPPED will be dequeued from the completion port once it completes.
+    Pending,
+    /// The operation completed synchronously on a handle that skips the completion port on success (see
+    /// `IoCompletionPort::associate_socket`), so its OVERLAPPED already holds the result and will never be dequeued.
+    Completed,
+}
+
 /// Data required by the I/O completion port processor to process I/O completions.
 #[repr(C)]
 struct OverlappedCompletion<S: Unpin> {
@@ -60,6 +79,8 @@ pub struct IoCompletionPort<S: Unpin> {
     iocp: HANDLE,
     /// Ongoing overlapped I/O operations. This is purely for reference counting
     ops: PinSlab<OverlappedCompletion<S>>,
+    /// Completions dequeued from the completion port at once. The length of this buffer is the batch size.
+    entries: Box<[OVERLAPPED_ENTRY]>,
     /// Marker to prevent this type from implementing `Sync`.
     _marker: PhantomData<Cell<()>>,
 }
@@ -91,8 +112,9 @@ impl OverlappedResult {
 }
 
 impl<S: Unpin> IoCompletionPort<S> {
-    /// Create a new I/O completion port.
-    pub fn new() -> Result<IoCompletionPort<S>, Fail> {
+    /// Create a new I/O completion port, which dequeues up to `batch_size` completions at once.
+    pub fn new(batch_size: usize) -> Result<IoCompletionPort<S>, Fail> {
+        debug_assert!(batch_size > 0);
         let iocp: HANDLE = match unsafe { CreateIoCompletionPort(INVALID_HANDLE_VALUE, None, 0, 1) } {
             Ok(handle) => handle,
             Err(err) => return Err(err.into()),
@@ -107,15 +129,33 @@ impl<S: Unpin> IoCompletionPort<S> {
         Ok(IoCompletionPort {
             iocp,
             ops: PinSlab::<OverlappedCompletion<S>>::default(),
+            entries: vec![OVERLAPPED_ENTRY::default(); batch_size].into_boxed_slice(),
             _marker: PhantomData,
         })
     }
 
     /// Associate socket `s` with this I/O completion port. All overlapped I/O operations for `s` which complete on this
-    /// completion port will return `completion_key` in the `OverlappedResults` structure.
-    #[allow(unused)]
-    pub fn associate_socket(&self, s: SOCKET, completion_key: usize) -> Result<(), Fail> {
-        self.associate_handle(HANDLE(s.0 as isize), completion_key)
+    /// completion port will return `completion_key` in the `OverlappedResults` structure. If `skip_on_success` is set,
+    /// operations that complete synchronously are not queued to the completion port, which saves a round trip through
+    /// the port for every operation that finds data or buffer space ready; this is only sound for sockets whose
+    /// providers all hand out IFS handles. Returns whether the socket skips the completion port on success, which the
+    /// `start` functions given to `do_io` must report as `OverlappedStart::Completed`.
+    pub fn associate_socket(&self, s: SOCKET, completion_key: usize, skip_on_success: bool) -> Result<bool, Fail> {
+        let handle: HANDLE = HANDLE(s.0 as isize);
+        self.associate_handle(handle, completion_key)?;
+        if !skip_on_success {
+            return Ok(false);
+        }
+
+        let flags: u8 = FILE_SKIP_COMPLETION_PORT_ON_SUCCESS | FILE_SKIP_SET_EVENT_ON_HANDLE;
+        match unsafe { SetFileCompletionNotificationModes(handle, flags) } {
+            Ok(()) => Ok(true),
+            Err(err) => {
+                // Completions still go through the port, which is slower but correct.
+                warn!("associate_socket(): failed to skip completion port on success: {}", err);
+                Ok(false)
+            },
+        }
     }
 
     /// Associate a file handle with this I/O completion port. All overlapped I/O operations for `handle` which complete
@@ -129,14 +169,16 @@ impl<S: Unpin> IoCompletionPort<S> {
 
     /// Perform an asynchronous overlapped I/O operation. This method requires three functions: one to start the I/O
     /// (`start`), one to cancel the I/O on cancellation (`cancel`), and one to finish/clean up and interpret the
-    /// results (`finish`). `start` and `cancel` accept an OVERLAPPED pointer for controlling the I/O operation as
-    /// well as the state value (initialized by `state`). If `start` fails, this method will abort without calling
-    /// `cancel` or `finish`. In this instance, the OVERLAPPED passed to `start` must never be dequeued from the I/O
-    /// completion port. If `start` must fail in a way that may result in the OVERLAPPED being dequeued, the method must
-    /// return Ok(()) and indicate failure via the `finish` callback (presumably using `state`). `cancel` is invoked iff
-    /// the Yielder wakes with an `ECANCELLED` error. When the OVERLAPPED passed to `start` is dequeued from the
-    /// completion port, `finish` is invoked with the OverlappedResult type and the state (the same reference passed to
-    /// `start`). The return of `finish` is returned from the method.
+    /// results (`finish`). If `start` reports that the operation completed synchronously, `finish` is invoked right
+    /// away, without waiting on the completion port; the completion key of the result is then 0. `start` and `cancel`
+    /// accept an OVERLAPPED pointer for controlling the I/O operation as well as the state value (initialized by
+    /// `state`). If `start` fails, this method will abort without calling `cancel` or `finish`. In this instance, the
+    /// OVERLAPPED passed to `start` must never be dequeued from the I/O completion port. If `start` must fail in a way
+    /// that may result in the OVERLAPPED being dequeued, the method must return Ok(()) and indicate failure via the
+    /// `finish` callback (presumably using `state`). `cancel` is invoked iff the Yielder wakes with an `ECANCELLED`
+    /// error. When the OVERLAPPED passed to `start` is dequeued from the completion port, `finish` is invoked with the
+    /// OverlappedResult type and the state (the same reference passed to `start`). The return of `finish` is returned
+    /// from the method.
     ///
     /// Safety: `start` should return Ok(...) iff the I/O is started and the OVERLAPPED parameter will
     /// eventually be dequeued from the completion port; if this requirement is not met, resources will leak. Likewise,
@@ -146,7 +188,7 @@ impl<S: Unpin> IoCompletionPort<S> {
     /// the same file/socket.
     pub async unsafe fn do_io<F1, F2, R>(&mut self, state: S, start: F1, finish: F2) -> Result<R, Fail>
     where
-        for<'a> F1: FnOnce(Pin<&'a mut S>, *mut OVERLAPPED) -> Result<(), Fail>,
+        for<'a> F1: FnOnce(Pin<&'a mut S>, *mut OVERLAPPED) -> Result<OverlappedStart, Fail>,
         for<'a> F2: FnOnce(Pin<&'a mut S>, OverlappedResult) -> Result<R, Fail>,
     {
         // Allocate a new Overlapped completion in the pin slab.
@@ -169,7 +211,7 @@ impl<S: Unpin> IoCompletionPort<S> {
         let overlapped: *mut OVERLAPPED = pinned_completion.as_mut().marshal();
         let result: Result<R, Fail> = match start(pinned_completion.as_mut().get_state(), overlapped) {
             // Operation in progress, pending overlapped completion.
-            Ok(()) => {
+            Ok(OverlappedStart::Pending) => {
                 while let Some(mut cv) = pinned_completion.as_ref().get_cv() {
                     cv.wait().await;
                 }
@@ -183,6 +225,13 @@ impl<S: Unpin> IoCompletionPort<S> {
                 finish(pinned_completion.as_mut().get_state(), overlapped_result)
             },
 
+            // Operation completed synchronously and the OS already filled in the OVERLAPPED.
+            Ok(OverlappedStart::Completed) => {
+                let overlapped_result: OverlappedResult =
+                    OverlappedResult::new(pinned_completion.as_mut().overlapped, 0);
+                finish(pinned_completion.as_mut().get_state(), overlapped_result)
+            },
+
             // Operation failed to start.
             Err(err) => Err(err),
         };
@@ -193,7 +242,7 @@ impl<S: Unpin> IoCompletionPort<S> {
 
     /// Process a single overlapped entry.
     #[allow(unused)]
-    fn process_overlapped(&mut self, entry: &OVERLAPPED_ENTRY) {
+    fn process_overlapped(ops: &mut PinSlab<OverlappedCompletion<S>>, entry: &OVERLAPPED_ENTRY) {
         if let Some(overlapped) = std::ptr::NonNull::new(entry.lpOverlapped) {
             // Safety: this is valid as long as the caller follows the contract: all queued OVERLAPPED instances are
             // generated by `IoCompletionPort` API.
@@ -208,28 +257,24 @@ impl<S: Unpin> IoCompletionPort<S> {
                 // This can happen due to a failed cancellation or any other error on the do_overlapped path.
                 trace!("I/O dropped for completion key {}", entry.lpCompletionKey);
                 if let Some(pinslab_index) = overlapped.as_mut().get_pinslab_index() {
-                    self.ops.remove_unpin(pinslab_index);
+                    ops.remove_unpin(pinslab_index);
                 }
             }
         }
     }
 
-    /// Process entries by peeking the completion port.
+    /// Process entries by peeking the completion port, a batch at a time, until it is drained.
     #[allow(unused)]
     pub fn process_events(&mut self) -> Result<(), Fail> {
-        // Arbitrarily chosen batch size; should be updated after tuning.
-        const BATCH_SIZE: usize = 4;
-        let mut entries: [OVERLAPPED_ENTRY; BATCH_SIZE] = [OVERLAPPED_ENTRY::default(); BATCH_SIZE];
-
         loop {
             let mut dequeued: u32 = 0;
-            match unsafe { GetQueuedCompletionStatusEx(self.iocp, entries.as_mut_slice(), &mut dequeued, 0, FALSE) } {
+            match unsafe { GetQueuedCompletionStatusEx(self.iocp, &mut self.entries, &mut dequeued, 0, FALSE) } {
                 Ok(()) => {
-                    for i in 0..dequeued {
-                        self.process_overlapped(&entries[i as usize]);
+                    for entry in &self.entries[..dequeued as usize] {
+                        Self::process_overlapped(&mut self.ops, entry);
                     }
 
-                    if dequeued < BATCH_SIZE as u32 {
+                    if (dequeued as usize) < self.entries.len() {
                         return Ok(());
                     }
                 },
@@ -348,6 +393,9 @@ mod tests {
         },
     };
 
+    /// Number of completions that the completion ports of these tests dequeue at once.
+    const BATCH_SIZE: usize = 4;
+
     struct SafeHandle(HANDLE);
 
     // A future wrapper which will poll the wrapped future exactly once.
@@ -383,7 +431,7 @@ mod tests {
 
     /// Create an I/O completion port, mapping the error return to
     fn make_iocp<S: Unpin>() -> Result<IoCompletionPort<S>> {
-        IoCompletionPort::new().map_err(|err: Fail| anyhow!("Failed to create I/O completion port: {}", err))
+        IoCompletionPort::new(BATCH_SIZE).map_err(|err: Fail| anyhow!("Failed to create I/O completion port: {}", err))
     }
 
     /// Post an overlapped instance to the I/O completion port.
@@ -401,16 +449,17 @@ mod tests {
         Fail::new(libc::EFAULT, error.to_string().as_str())
     }
 
-    // Check if an overlapped Result is ok, turning ERROR_IO_PENDING into an Ok(()).
-    fn is_overlapped_ok(result: Result<(), windows::core::Error>) -> Result<(), Fail> {
+    // Check if an overlapped Result is ok, turning ERROR_IO_PENDING into an Ok(...). Handles in these tests do not skip
+    // the completion port on success, so operations are always pending.
+    fn is_overlapped_ok(result: Result<(), windows::core::Error>) -> Result<OverlappedStart, Fail> {
         if let Err(err) = result {
             if err.code() == HRESULT::from(ERROR_IO_PENDING) {
-                Ok(())
+                Ok(OverlappedStart::Pending)
             } else {
                 Err(err.into())
             }
         } else {
-            Ok(())
+            Ok(OverlappedStart::Pending)
         }
     }
 
@@ -496,6 +545,80 @@ mod tests {
         Ok(())
     }
 
+    /// Test that the event processor drains more completions than fit in a batch.
+    #[test]
+    fn test_event_processor_batches() -> Result<()> {
+        const COMPLETION_KEY: usize = 456;
+        const NUM_COMPLETIONS: usize = 2 * BATCH_SIZE + 1;
+        let mut iocp: IoCompletionPort<()> = make_iocp()?;
+        let mut completions: Vec<Pin<Box<OverlappedCompletion<()>>>> = (0..NUM_COMPLETIONS)
+            .map(|_| Box::pin(OverlappedCompletion::new(())))
+            .collect();
+
+        for completion in completions.iter_mut() {
+            post_completion(&iocp, completion.as_mut().marshal(), COMPLETION_KEY)?;
+        }
+
+        iocp.process_events()?;
+
+        for completion in completions.iter() {
+            ensure!(
+                completion.condition_variable.is_none(),
+                "yielder should be cleared by iocp"
+            );
+            ensure_eq!(completion.completion_key, COMPLETION_KEY, "completion key not updated");
+        }
+
+        Ok(())
+    }
+
+    /// Test that an operation which completes synchronously finishes without going through the completion port.
+    #[test]
+    fn test_synchronous_completion() -> Result<()> {
+        const BYTES_TRANSFERRED: u32 = 42;
+        let mut iocp: UnsafeCell<IoCompletionPort<()>> = UnsafeCell::new(make_iocp().map_err(anyhow_fail)?);
+        let iocp_ref: &mut IoCompletionPort<()> = unsafe { &mut *iocp.get() };
+
+        let server = run_as_io_op(async move {
+            let nbytes: u32 = unsafe {
+                iocp_ref.do_io(
+                    (),
+                    |_: Pin<&mut ()>, overlapped: *mut OVERLAPPED| -> Result<OverlappedStart, Fail> {
+                        // Fill in the OVERLAPPED as the OS does for operations that complete synchronously.
+                        (*overlapped).Internal = 0;
+                        (*overlapped).InternalHigh = BYTES_TRANSFERRED as usize;
+                        Ok(OverlappedStart::Completed)
+                    },
+                    |_: Pin<&mut ()>, result: OverlappedResult| -> Result<u32, Fail> {
+                        result.ok().and(Ok(result.bytes_transferred))
+                    },
+                )
+            }
+            .await?;
+
+            if nbytes == BYTES_TRANSFERRED {
+                Ok(OperationResult::Close)
+            } else {
+                Err(Fail::new(libc::EINVAL, "wrong number of bytes transferred"))
+            }
+        })
+        .fuse();
+
+        let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
+        let server_task: QToken = runtime.insert_io_coroutine("ioc_server", Box::pin(server)).unwrap();
+
+        // The completion port is never polled.
+        match runtime.run_any(&[server_task], Duration::ZERO) {
+            Some((_, _, OperationResult::Close)) => (),
+            Some((_, _, OperationResult::Failed(e))) => bail!("operation failed: {}", e),
+            _ => bail!("operation should have completed"),
+        }
+        // This was the first operation, so it took the first slot.
+        ensure!(!iocp.get_mut().ops.contains(0), "completion should be unpinned");
+
+        Ok(())
+    }
+
     #[test]
     fn test_overlapped_named_pipe() -> Result<()> {
         const MESSAGE: &str = "Hello world!";
@@ -525,7 +648,7 @@ mod tests {
                 unsafe {
                     iocp_ref.do_io(
                         Rc::new(Vec::<u8>::new()),
-                        |_: Pin<&mut Rc<Vec<u8>>>, overlapped: *mut OVERLAPPED| -> Result<(), Fail> {
+                        |_: Pin<&mut Rc<Vec<u8>>>, overlapped: *mut OVERLAPPED| -> Result<OverlappedStart, Fail> {
                             server_state.fetch_add(1, Ordering::Relaxed);
                             is_overlapped_ok(ConnectNamedPipe(server_pipe.0, Some(overlapped)))
                         },
@@ -541,7 +664,7 @@ mod tests {
                 buffer = unsafe {
                     iocp_ref.do_io(
                         buffer,
-                        |state: Pin<&mut Rc<Vec<u8>>>, overlapped: *mut OVERLAPPED| -> Result<(), Fail> {
+                        |state: Pin<&mut Rc<Vec<u8>>>, overlapped: *mut OVERLAPPED| -> Result<OverlappedStart, Fail> {
                             let vec: &mut Vec<u8> = Rc::get_mut(state.get_mut()).unwrap();
                             vec.resize(BUFFER_SIZE as usize, 0u8);
                             is_overlapped_ok(ReadFile(
@@ -673,7 +796,7 @@ mod tests {
                 unsafe {
                     iocp_ref.do_io(
                         (),
-                        |_: Pin<&mut ()>, overlapped: *mut OVERLAPPED| -> Result<(), Fail> {
+                        |_: Pin<&mut ()>, overlapped: *mut OVERLAPPED| -> Result<OverlappedStart, Fail> {
                             server_state.fetch_add(1, Ordering::Relaxed);
                             is_overlapped_ok(ConnectNamedPipe(server_pipe.0, Some(overlapped)))
                         },
@@ -8,7 +8,7 @@
 use crate::{
     catnap::transport::{
         error::{expect_last_wsa_error, get_overlapped_api_result},
-        overlapped::{IoCompletionPort, OverlappedResult},
+        overlapped::{IoCompletionPort, OverlappedResult, OverlappedStart},
         winsock::{SocketExtensions, WinsockRuntime},
     },
     runtime::{fail::Fail, memory::DemiBuffer, network::socket::option::TcpSocketOptions},
@@ -30,7 +30,7 @@ use windows::{
             FROM_PROTOCOL_INFO, INVALID_SOCKET, IPPROTO_TCP, LINGER, SD_BOTH, SIO_KEEPALIVE_VALS, SOCKADDR,
             SOCKADDR_IN, SOCKADDR_IN6, SOCKADDR_INET, SOCKADDR_STORAGE, SOCKET, SOCKET_ERROR, SOL_SOCKET, SO_KEEPALIVE,
             SO_LINGER, SO_PROTOCOL_INFOW, SO_UPDATE_ACCEPT_CONTEXT, SO_UPDATE_CONNECT_CONTEXT, TCP_NODELAY, WSABUF,
-            WSAEINVAL, WSAPROTOCOL_INFOW, WSA_FLAG_OVERLAPPED,
+            WSAEINVAL, WSAPROTOCOL_INFOW, WSA_FLAG_OVERLAPPED, XP1_IFS_HANDLES,
         },
         System::IO::{CancelIoEx, OVERLAPPED},
     },
@@ -54,6 +54,8 @@ const ACCEPT_BUFFER_LEN: usize = (SOCKADDR_BUF_SIZE) * 2;
 pub struct Socket {
     s: SOCKET,
     extensions: Rc<SocketExtensions>,
+    /// Whether operations on this socket that complete synchronously skip the completion port.
+    skip_completion_on_success: bool,
 }
 
 /// State type used by `Socket::start_accept` and `Socket::finish_accept`.
@@ -113,12 +115,38 @@ impl Socket {
         extensions: Rc<SocketExtensions>,
         iocp: &IoCompletionPort<SocketOpState>,
     ) -> Result<Socket, Fail> {
-        let s: Socket = Socket { s, extensions };
+        let mut s: Socket = Socket {
+            s,
+            extensions,
+            skip_completion_on_success: false,
+        };
         s.setup_socket(protocol, options)?;
-        iocp.associate_socket(s.s, 0)?;
+        s.associate(iocp)?;
         Ok(s)
     }
 
+    /// Associate this socket with `iocp`, skipping the completion port for operations that complete synchronously if
+    /// every provider of the socket hands out IFS handles. Completions of other providers may be posted to the port
+    /// regardless.
+    fn associate(&mut self, iocp: &IoCompletionPort<SocketOpState>) -> Result<(), Fail> {
+        // Safety: SO_PROTOCOL_INFOW fills out a WSAPROTOCOL_INFOW structure.
+        let protocol: WSAPROTOCOL_INFOW =
+            unsafe { WinsockRuntime::do_getsockopt(self.s, SOL_SOCKET, SO_PROTOCOL_INFOW) }?;
+        let ifs_handles: bool = protocol.dwServiceFlags1 & XP1_IFS_HANDLES != 0;
+        self.skip_completion_on_success = iocp.associate_socket(self.s, 0, ifs_handles)?;
+        Ok(())
+    }
+
+    /// Translate the return code of an overlapped API into how the operation started.
+    fn overlapped_start(&self, api_success: bool) -> Result<OverlappedStart, Fail> {
+        get_overlapped_api_result(api_success)?;
+        if api_success && self.skip_completion_on_success {
+            Ok(OverlappedStart::Completed)
+        } else {
+            Ok(OverlappedStart::Pending)
+        }
+    }
+
     /// Translate a SocketAddr to SOCKADDR_INET and byte length.
     fn translate_address(addr: SocketAddr) -> (SOCKADDR_INET, i32) {
         match addr {
@@ -219,15 +247,19 @@ impl Socket {
             )
         }?;
 
-        Ok(Socket { s, extensions })
+        Ok(Socket {
+            s,
+            extensions,
+            skip_completion_on_success: false,
+        })
     }
 
     /// Begin disconnecting a connection-oriented socket. If called on a non-stream-based socket or an unconnected
     /// stream-based socket, this method will return an `ENOTCONN` failure.
-    pub fn start_disconnect(&self, overlapped: *mut OVERLAPPED) -> Result<(), Fail> {
+    pub fn start_disconnect(&self, overlapped: *mut OVERLAPPED) -> Result<OverlappedStart, Fail> {
         let result: bool = unsafe { self.extensions.disconnectex.unwrap()(self.s, overlapped, 0, 0).as_bool() };
 
-        get_overlapped_api_result(result)
+        self.overlapped_start(result)
     }
 
     /// Call once the overlapped operation started by `start_disconnect` has completed to finish disconnecting and
@@ -285,7 +317,11 @@ impl Socket {
 
     /// Start an overlapped accept operation; this must be called from inside IoCompletionPort::do_io/do_socket_io.
     /// Once the operation completes, the AcceptState can be given to `finish_accept` to finish the operation.
-    pub fn start_accept(&self, state: Pin<&mut SocketOpState>, overlapped: *mut OVERLAPPED) -> Result<(), Fail> {
+    pub fn start_accept(
+        &self,
+        state: Pin<&mut SocketOpState>,
+        overlapped: *mut OVERLAPPED,
+    ) -> Result<OverlappedStart, Fail> {
         let accept_result: &mut AcceptState = match state.get_mut() {
             SocketOpState::Accept(ref mut accept_result) => accept_result,
             _ => unreachable!("must be an accept operation"),
@@ -312,11 +348,10 @@ impl Socket {
         }
         .as_bool();
 
-        get_overlapped_api_result(success).and_then(|_| {
-            // Safety: the socket does not require structural pinning.
-            accept_result.new_socket = Some(new_socket);
-            Ok(())
-        })
+        let start: OverlappedStart = self.overlapped_start(success)?;
+        // Safety: the socket does not require structural pinning.
+        accept_result.new_socket = Some(new_socket);
+        Ok(start)
     }
 
     /// Finish an accept operation, once the overlapped accept call has completed. Calling this method before the I/O
@@ -341,7 +376,7 @@ impl Socket {
         // no receive, or whether it is equal to the local+remote address buffer length. It is safe to assume addresses
         // were provisioned correctly by the API.
         // Safety: the socket does not require structural pinning.
-        let new_socket = accept_result
+        let mut new_socket: Socket = accept_result
             .new_socket
             .take()
             .ok_or_else(|| Fail::new(libc::EINVAL, "invalid state"))?;
@@ -351,7 +386,7 @@ impl Socket {
         // Safety: FFI call to Windows API; no specific considerations.
         unsafe { WinsockRuntime::do_setsockopt(new_socket.s, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT, Some(&self.s)) }?;
 
-        iocp.associate_socket(new_socket.s, 0)?;
+        new_socket.associate(iocp)?;
 
         let (local_addr, remote_addr) = unsafe {
             // NB socket2 uses the windows-sys crate, so type names are qualified here to prevent confusion with Windows
@@ -396,7 +431,7 @@ impl Socket {
     }
 
     /// Start an overlapped connect operation.
-    pub fn start_connect(&self, remote: SocketAddr, overlapped: *mut OVERLAPPED) -> Result<(), Fail> {
+    pub fn start_connect(&self, remote: SocketAddr, overlapped: *mut OVERLAPPED) -> Result<OverlappedStart, Fail> {
         // Constants missing from windows crate.
         const IN6ADDR_ANY: SocketAddrV6 = SocketAddrV6::new(Ipv6Addr::UNSPECIFIED, 0, 0, 0);
         const INADDR_ANY: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::UNSPECIFIED, 0);
@@ -427,7 +462,7 @@ impl Socket {
             .as_bool()
         };
 
-        get_overlapped_api_result(success)
+        self.overlapped_start(success)
     }
 
     /// Finish a connect operation started by start_connect.
@@ -441,9 +476,13 @@ impl Socket {
     }
 
     /// Start a pop operation, as intended for use with `IoCompletionPort::do_io_with`. The operation may complete
-    /// immediately, in which case an overlapped completion is not scheduled. To indicate this case, this method will
-    /// return EAGAIN and update `buffer` according to the number of bytes received.
-    pub fn start_pop(&self, state: Pin<&mut SocketOpState>, overlapped: *mut OVERLAPPED) -> Result<(), Fail> {
+    /// immediately, in which case an overlapped completion is not scheduled if the socket skips the completion port on
+    /// success. To indicate this case, this method will return `OverlappedStart::Completed`.
+    pub fn start_pop(
+        &self,
+        state: Pin<&mut SocketOpState>,
+        overlapped: *mut OVERLAPPED,
+    ) -> Result<OverlappedStart, Fail> {
         let pop_state: &mut PopState = match state.get_mut() {
             SocketOpState::Pop(ref mut pop_state) => pop_state,
             _ => unreachable!("must be an accept operation"),
@@ -474,7 +513,7 @@ impl Socket {
             result != SOCKET_ERROR
         };
 
-        get_overlapped_api_result(success)
+        self.overlapped_start(success)
     }
 
     /// Finish an overlapped pop operation started with start_pop.
@@ -520,7 +559,7 @@ impl Socket {
         state: Pin<&mut SocketOpState>,
         addr: Option<SocketAddr>,
         overlapped: *mut OVERLAPPED,
-    ) -> Result<(), Fail> {
+    ) -> Result<OverlappedStart, Fail> {
         let buffer: &mut DemiBuffer = match state.get_mut() {
             SocketOpState::Push(ref mut buffer) => buffer,
             _ => unreachable!("must be an accept operation"),
@@ -557,7 +596,7 @@ impl Socket {
             result != SOCKET_ERROR
         };
 
-        get_overlapped_api_result(success)
+        self.overlapped_start(success)
     }
 
     /// Finish a push operation started with start_push.
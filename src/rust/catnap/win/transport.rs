@@ -12,15 +12,17 @@ mod winsock;
 
 use crate::{
     catnap::transport::{
-        overlapped::{IoCompletionPort, OverlappedResult},
+        overlapped::{IoCompletionPort, OverlappedResult, OverlappedStart},
         socket::{AcceptState, PopState, Socket, SocketOpState},
         winsock::WinsockRuntime,
     },
+    demi_sgarray_t,
     demikernel::config::Config,
     expect_ok,
+    perftools::stats::{self, Counter},
     runtime::{
         fail::Fail,
-        memory::{DemiBuffer, MemoryRuntime},
+        memory::{self, DemiBuffer, MemoryRuntime, SizeClassPools},
         network::{
             socket::option::{SocketOption, TcpSocketOptions},
             transport::NetworkTransport,
@@ -32,12 +34,20 @@ use ::futures::FutureExt;
 use std::{
     net::{SocketAddr, SocketAddrV4},
     pin::Pin,
+    rc::Rc,
 };
 use windows::Win32::{
     Networking::WinSock::{WSAGetLastError, IPPROTO, IPPROTO_TCP, IPPROTO_UDP},
     System::IO::OVERLAPPED,
 };
 
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of completions dequeued from the I/O completion port at once, if the configuration does not say.
+const DEFAULT_IOCP_BATCH_SIZE: usize = 64;
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -55,6 +65,9 @@ pub struct CatnapTransport {
 
     /// Shared Demikernel runtime.
     runtime: SharedDemiRuntime,
+
+    /// Pools that scatter-gather arrays are allocated from, if enabled.
+    sga_pools: Option<Rc<SizeClassPools>>,
 }
 
 /// A network transport built on top of Windows overlapped I/O.
@@ -68,11 +81,22 @@ pub struct SharedCatnapTransport(SharedObject<CatnapTransport>);
 impl SharedCatnapTransport {
     /// Create a new transport instance.
     pub fn new(config: &Config, runtime: &mut SharedDemiRuntime) -> Result<Self, Fail> {
+        let batch_size: usize = match config.catnap_iocp_batch_size() {
+            Ok(batch_size) => batch_size,
+            Err(_) => {
+                warn!(
+                    "No setting for the completion batch size. Using {} by default.",
+                    DEFAULT_IOCP_BATCH_SIZE
+                );
+                DEFAULT_IOCP_BATCH_SIZE
+            },
+        };
         let me: Self = Self(SharedObject::new(CatnapTransport {
             winsock: expect_ok!(WinsockRuntime::new(), "failed to initialize WinSock"),
-            iocp: expect_ok!(IoCompletionPort::new(), "failed to setup I/O completion port"),
+            iocp: expect_ok!(IoCompletionPort::new(batch_size), "failed to setup I/O completion port"),
             options: TcpSocketOptions::new(config)?,
             runtime: runtime.clone(),
+            sga_pools: SizeClassPools::from_config(config)?,
         }));
 
         runtime.insert_background_coroutine(
@@ -134,6 +158,16 @@ impl NetworkTransport for SharedCatnapTransport {
             SocketOption::Linger(linger) => socket.set_linger(linger),
             SocketOption::KeepAlive(tcp_keepalive) => socket.set_tcp_keepalive(&tcp_keepalive),
             SocketOption::NoDelay(nagle_enabled) => socket.set_nagle(nagle_enabled),
+            SocketOption::CongestionControl(_) => {
+                let cause: &str = "Windows does not let sockets pick a congestion control algorithm";
+                error!("set_socket_option(): {}", cause);
+                Err(Fail::new(libc::ENOTSUP, cause))
+            },
+            SocketOption::Priority(_) => {
+                let cause: &str = "socket priorities are set on the queue, not on the transport";
+                warn!("set_socket_option(): {}", cause);
+                Err(Fail::new(libc::ENOPROTOOPT, cause))
+            },
         }
     }
 
@@ -149,6 +183,16 @@ impl NetworkTransport for SharedCatnapTransport {
             SocketOption::Linger(_) => Ok(SocketOption::Linger(socket.get_linger()?)),
             SocketOption::KeepAlive(_) => Ok(SocketOption::KeepAlive(socket.get_tcp_keepalive()?)),
             SocketOption::NoDelay(_) => Ok(SocketOption::NoDelay(socket.get_nagle()?)),
+            SocketOption::CongestionControl(_) => {
+                let cause: &str = "Windows does not let sockets pick a congestion control algorithm";
+                error!("get_socket_option(): {}", cause);
+                Err(Fail::new(libc::ENOTSUP, cause))
+            },
+            SocketOption::Priority(_) => {
+                let cause: &str = "socket priorities are set on the queue, not on the transport";
+                warn!("get_socket_option(): {}", cause);
+                Err(Fail::new(libc::ENOPROTOOPT, cause))
+            },
         }
     }
 
@@ -203,9 +247,9 @@ impl NetworkTransport for SharedCatnapTransport {
     /// Accept a connection on the specified socket. The coroutine will not finish until a connection is successfully
     /// accepted or `yielder` is cancelled.
     async fn accept(&mut self, socket: &mut Self::SocketDescriptor) -> Result<(Socket, SocketAddr), Fail> {
-        let start = |accept_result: Pin<&mut SocketOpState>, overlapped: *mut OVERLAPPED| -> Result<(), Fail> {
-            socket.start_accept(accept_result, overlapped)
-        };
+        let start = |accept_result: Pin<&mut SocketOpState>,
+                     overlapped: *mut OVERLAPPED|
+         -> Result<OverlappedStart, Fail> { socket.start_accept(accept_result, overlapped) };
         let me_finish: Self = self.clone();
         let finish = |accept_result: Pin<&mut SocketOpState>,
                       result: OverlappedResult|
@@ -228,7 +272,7 @@ impl NetworkTransport for SharedCatnapTransport {
         unsafe {
             self.0.iocp.do_io(
                 SocketOpState::Connect,
-                |_: Pin<&mut SocketOpState>, overlapped: *mut OVERLAPPED| -> Result<(), Fail> {
+                |_: Pin<&mut SocketOpState>, overlapped: *mut OVERLAPPED| -> Result<OverlappedStart, Fail> {
                     socket.start_connect(remote, overlapped)
                 },
                 |_: Pin<&mut SocketOpState>, result: OverlappedResult| -> Result<(), Fail> {
@@ -249,7 +293,7 @@ impl NetworkTransport for SharedCatnapTransport {
         unsafe {
             self.0.iocp.do_io(
                 SocketOpState::Pop(PopState::new(buf.clone())),
-                |state: Pin<&mut SocketOpState>, overlapped: *mut OVERLAPPED| -> Result<(), Fail> {
+                |state: Pin<&mut SocketOpState>, overlapped: *mut OVERLAPPED| -> Result<OverlappedStart, Fail> {
                     socket.start_pop(state, overlapped)
                 },
                 |state: Pin<&mut SocketOpState>,
@@ -262,6 +306,8 @@ impl NetworkTransport for SharedCatnapTransport {
             buf.trim(buf.len() - nbytes)?;
             if nbytes > 0 {
                 trace!("data received ({:?}/{:?} bytes)", nbytes, size);
+                stats::count(Counter::PacketsIn, 1);
+                stats::count(Counter::BytesIn, nbytes as u64);
             } else {
                 trace!("not data received");
             }
@@ -278,11 +324,15 @@ impl NetworkTransport for SharedCatnapTransport {
         buf: &mut DemiBuffer,
         addr: Option<SocketAddr>,
     ) -> Result<(), Fail> {
+        // Overlapped sends take a single buffer, so we gather the segments of a chained buffer into one.
+        if buf.is_multi_segment() {
+            *buf = buf.coalesce(0)?;
+        }
         loop {
             let result: Result<usize, Fail> = unsafe {
                 self.0.iocp.do_io(
                     SocketOpState::Push(buf.clone()),
-                    |state: Pin<&mut SocketOpState>, overlapped: *mut OVERLAPPED| -> Result<(), Fail> {
+                    |state: Pin<&mut SocketOpState>, overlapped: *mut OVERLAPPED| -> Result<OverlappedStart, Fail> {
                         socket.start_push(state, addr, overlapped)
                     },
                     |_: Pin<&mut SocketOpState>, result: OverlappedResult| -> Result<usize, Fail> {
@@ -295,6 +345,8 @@ impl NetworkTransport for SharedCatnapTransport {
             match result {
                 Ok(nbytes) => {
                     trace!("data pushed ({:?}/{:?} bytes)", nbytes, buf.len());
+                    stats::count(Counter::PacketsOut, 1);
+                    stats::count(Counter::BytesOut, nbytes as u64);
                     buf.adjust(nbytes)?;
                     if buf.is_empty() {
                         return Ok(());
@@ -316,4 +368,16 @@ impl NetworkTransport for SharedCatnapTransport {
     }
 }
 
-impl MemoryRuntime for SharedCatnapTransport {}
+impl MemoryRuntime for SharedCatnapTransport {
+    /// Allocates a scatter-gather array, from the size-class pools if they are enabled.
+    fn sgaallocv(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
+        match self.0.sga_pools {
+            Some(ref pools) => memory::alloc_sgarray(seglens, |size: usize| -> Result<DemiBuffer, Fail> {
+                pools.alloc(size, 0)
+            }),
+            None => memory::alloc_sgarray(seglens, |size: usize| -> Result<DemiBuffer, Fail> {
+                Ok(DemiBuffer::new(size as u16))
+            }),
+        }
+    }
+}
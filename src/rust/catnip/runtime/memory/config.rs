@@ -5,7 +5,9 @@
 // Imports
 //======================================================================================================================
 
-use crate::catnip::runtime::memory::consts::{DEFAULT_BODY_POOL_SIZE, DEFAULT_CACHE_SIZE, DEFAULT_MAX_BODY_SIZE};
+use crate::catnip::runtime::memory::consts::{
+    DEFAULT_BODY_POOL_SIZE, DEFAULT_CACHE_SIZE, DEFAULT_HEADER_POOL_SIZE, DEFAULT_MAX_BODY_SIZE, HEADER_BODY_SIZE,
+};
 
 //======================================================================================================================
 // Structures
@@ -17,9 +19,12 @@ pub struct MemoryConfig {
     /// What is the maximum body size? This should effectively be the MSS + RTE_PKTMBUF_HEADROOM.
     max_body_size: usize,
 
-    /// How many buffers are within the body pool?
+    /// How many buffers are within each body pool?
     body_pool_size: usize,
 
+    /// How many buffers are within the header pool?
+    header_pool_size: usize,
+
     /// How many buffers should remain within `rte_mempool`'s per-thread cache?
     cache_size: usize,
 }
@@ -61,10 +66,30 @@ impl MemoryConfig {
         self.body_pool_size
     }
 
+    /// Returns the header pool size config stored in the target [MemoryConfig].
+    pub fn get_header_pool_size(&self) -> usize {
+        self.header_pool_size
+    }
+
     /// Returns the cache size config stored in the target [MemoryConfig].
     pub fn get_cache_size(&self) -> usize {
         self.cache_size
     }
+
+    /// Returns the body size and the number of buffers of every size class, from the smallest to the largest. The
+    /// header class always comes first, followed by a class of standard frames and, if the max body size calls for it,
+    /// a class of jumbo frames. The largest class is the one that the NIC receives into.
+    pub fn get_size_classes(&self) -> Vec<(usize, usize)> {
+        let mut classes: Vec<(usize, usize)> = Vec::with_capacity(3);
+        if HEADER_BODY_SIZE < self.max_body_size {
+            classes.push((HEADER_BODY_SIZE, self.header_pool_size));
+        }
+        if DEFAULT_MAX_BODY_SIZE < self.max_body_size {
+            classes.push((DEFAULT_MAX_BODY_SIZE, self.body_pool_size));
+        }
+        classes.push((self.max_body_size, self.body_pool_size));
+        classes
+    }
 }
 
 //======================================================================================================================
@@ -77,6 +102,7 @@ impl Default for MemoryConfig {
         Self {
             max_body_size: DEFAULT_MAX_BODY_SIZE,
             body_pool_size: DEFAULT_BODY_POOL_SIZE,
+            header_pool_size: DEFAULT_HEADER_POOL_SIZE,
             cache_size: DEFAULT_CACHE_SIZE,
         }
     }
@@ -11,9 +11,15 @@ use crate::runtime::libdpdk::{RTE_MBUF_DEFAULT_BUF_SIZE, RTE_PKTMBUF_HEADROOM};
 // Constants
 //======================================================================================================================
 
-/// Default number of buffers in the body pool.
+/// Default number of buffers in every body pool.
 pub const DEFAULT_BODY_POOL_SIZE: usize = 8192 - 1;
 
+/// Default number of buffers in the header pool.
+pub const DEFAULT_HEADER_POOL_SIZE: usize = 8192 - 1;
+
+/// Body size of the header pool. This fits the headers of ACKs and other control packets, along with small payloads.
+pub const HEADER_BODY_SIZE: usize = (256 + RTE_PKTMBUF_HEADROOM) as usize;
+
 /// Default value for maximum body size.
 pub const DEFAULT_MAX_BODY_SIZE: usize = (RTE_MBUF_DEFAULT_BUF_SIZE + RTE_PKTMBUF_HEADROOM) as usize;
 
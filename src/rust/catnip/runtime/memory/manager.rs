@@ -10,18 +10,13 @@ use crate::{
     inetstack::protocols::MAX_HEADER_SIZE,
     runtime::{
         fail::Fail,
-        libdpdk::{rte_mbuf, rte_mempool},
-        memory::DemiBuffer,
-        types::{demi_sgarray_t, demi_sgaseg_t},
+        libdpdk::{rte_mbuf, rte_mempool, rte_pktmbuf_chain, rte_pktmbuf_free},
+        memory::{self, DemiBuffer},
+        types::demi_sgarray_t,
     },
 };
 use ::anyhow::Error;
-use ::libc::c_void;
-use ::std::{
-    ffi::CString,
-    mem,
-    ptr::{self, NonNull},
-};
+use ::std::{cmp, ffi::CString, ptr};
 
 //======================================================================================================================
 // Exports
@@ -38,10 +33,9 @@ pub use crate::catnip::runtime::memory::config::MemoryConfig;
 /// Memory Manager
 #[derive(Debug)]
 pub struct MemoryManager {
-    config: MemoryConfig,
-
-    // Large body pool for buffers given to the application for zero-copy.
-    body_pool: MemoryPool,
+    // Body pools for buffers given to the application for zero-copy, one per size class, from the smallest to the
+    // largest. The largest one also feeds the RX queue.
+    body_pools: Vec<MemoryPool>,
 }
 
 //======================================================================================================================
@@ -49,162 +43,135 @@ pub struct MemoryManager {
 //======================================================================================================================
 
 impl MemoryManager {
-    pub fn new(max_body_size: usize) -> Result<Self, Error> {
+    /// Creates the memory manager of the RX/TX queue pair `queue_id`, with its memory pools on NUMA socket
+    /// `socket_id`. Memory pool names must be unique in the process, so they are tagged with the queue and the size
+    /// class.
+    pub fn new(max_body_size: usize, queue_id: u16, socket_id: i32) -> Result<Self, Error> {
         let config: MemoryConfig = MemoryConfig::new(Some(max_body_size), None, None);
-        let body_pool: MemoryPool = MemoryPool::new(
-            CString::new("body_pool")?,
-            config.get_max_body_size(),
-            config.get_body_pool_size(),
-            config.get_cache_size(),
-        )?;
-
-        Ok(Self { config, body_pool })
-    }
+        let mut body_pools: Vec<MemoryPool> = Vec::new();
+        for (body_size, pool_size) in config.get_size_classes() {
+            body_pools.push(MemoryPool::new(
+                CString::new(format!("body_pool_{}_{}", queue_id, body_size))?,
+                body_size,
+                pool_size,
+                config.get_cache_size(),
+                socket_id,
+            )?);
+        }
 
-    pub fn into_sgarray(&self, buf: DemiBuffer) -> Result<demi_sgarray_t, Fail> {
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: buf.len() as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+        Ok(Self { body_pools })
     }
 
-    /// TODO: Review the need of this function after we are done with the refactor of the DPDK runtime.
-    pub fn alloc_body_mbuf(&self) -> Result<DemiBuffer, Fail> {
-        let mbuf_ptr: *mut rte_mbuf = self.body_pool.alloc_mbuf(None)?;
-        Ok(unsafe { DemiBuffer::from_mbuf(mbuf_ptr) })
+    pub fn into_sgarray(&self, buf: DemiBuffer) -> Result<demi_sgarray_t, Fail> {
+        memory::buffer_into_sgarray(buf)
     }
 
-    pub fn alloc_sgarray(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // TODO: Allocate an array of buffers if requested size is too large for a single buffer.
-
-        if size == 0 {
-            let cause: String = format!("cannot allocate a zero-sized buffer");
-            error!("sgaalloc(): {}", cause);
-            return Err(Fail::new(libc::EINVAL, &cause));
-        }
+    /// Copies `data` into a chain of body mbufs and returns the head of the chain. Data that fits in a single mbuf is
+    /// copied into a single mbuf of the smallest size class that fits it.
+    pub fn copy_into_mbuf_chain(&self, data: &[u8]) -> Result<*mut rte_mbuf, Fail> {
+        let max_data_size: usize = self.get_max_data_size();
+        let mut head: *mut rte_mbuf = ptr::null_mut();
+        let mut remaining: &[u8] = data;
+        loop {
+            let mbuf_ptr: *mut rte_mbuf = match self.alloc_mbuf(cmp::min(remaining.len(), max_data_size)) {
+                Ok(mbuf_ptr) => mbuf_ptr,
+                Err(e) => {
+                    if !head.is_null() {
+                        unsafe { rte_pktmbuf_free(head) };
+                    }
+                    return Err(e);
+                },
+            };
+
+            // Safety: `mbuf_ptr` is a valid pointer to a properly initialized `rte_mbuf` struct, whose data area
+            // spans `data_len` bytes after the headroom.
+            unsafe {
+                let len: usize = cmp::min((*mbuf_ptr).data_len as usize, remaining.len());
+                let dst: *mut u8 = ((*mbuf_ptr).buf_addr as *mut u8).add((*mbuf_ptr).data_off as usize);
+                ptr::copy_nonoverlapping(remaining.as_ptr(), dst, len);
+                (*mbuf_ptr).data_len = len as u16;
+                (*mbuf_ptr).pkt_len = len as u32;
+                remaining = &remaining[len..];
+
+                if head.is_null() {
+                    head = mbuf_ptr;
+                } else if rte_pktmbuf_chain(head, mbuf_ptr) != 0 {
+                    rte_pktmbuf_free(mbuf_ptr);
+                    rte_pktmbuf_free(head);
+                    let cause: String = format!("too many segments in mbuf chain (len={:?})", data.len());
+                    error!("copy_into_mbuf_chain(): {}", cause);
+                    return Err(Fail::new(libc::EMSGSIZE, &cause));
+                }
+            }
 
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
+            if remaining.is_empty() {
+                return Ok(head);
+            }
         }
+    }
 
-        // First allocate the underlying DemiBuffer.
-        let buf: DemiBuffer = if size <= self.config.get_max_body_size() {
-            // Allocate a DPDK-managed buffer.
-            let mbuf_ptr: *mut rte_mbuf = self.body_pool.alloc_mbuf(Some(size))?;
-            // Safety: `mbuf_ptr` is a valid pointer to a properly initialized `rte_mbuf` struct.
-            unsafe { DemiBuffer::from_mbuf(mbuf_ptr) }
-        } else {
-            // Allocate a heap-managed buffer.
-            DemiBuffer::new_with_headroom(size as u16, MAX_HEADER_SIZE as u16)
-        };
-
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
+    pub fn alloc_sgarray(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
+        // Segments of a scatter-gather array are chained together, and a chain cannot mix DPDK-managed and
+        // heap-managed buffers. Hence, we only use the body pools if every segment fits in a body buffer.
+        let max_data_size: usize = self.get_max_data_size();
+        let use_body_pool: bool = seglens.iter().all(|seglen: &usize| *seglen <= max_data_size);
+
+        memory::alloc_sgarray(seglens, |size: usize| -> Result<DemiBuffer, Fail> {
+            if use_body_pool {
+                // Allocate a DPDK-managed buffer from the smallest size class that fits the segment.
+                let mbuf_ptr: *mut rte_mbuf = self.alloc_mbuf(size)?;
+                // Safety: `mbuf_ptr` is a valid pointer to a properly initialized `rte_mbuf` struct.
+                Ok(unsafe { DemiBuffer::from_mbuf(mbuf_ptr) })
+            } else {
+                // Allocate a heap-managed buffer.
+                Ok(DemiBuffer::new_with_headroom(size as u16, MAX_HEADER_SIZE as u16))
+            }
         })
     }
 
     pub fn free_sgarray(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
-        }
-
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
-        }
-
-        // Convert back to a DemiBuffer and drop it.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
-        drop(buf);
-
-        Ok(())
+        memory::free_sgarray(sga)
     }
 
     /// Clones a scatter-gather array into a DemiBuffer.
     pub fn clone_sgarray(&self, sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
-        }
-
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
-        }
-
-        // Convert back to a DemiBuffer.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
-        let mut clone: DemiBuffer = buf.clone();
-
-        // Don't drop buf, as it holds the same reference to the data as the sgarray (which should keep it).
-        mem::forget(buf);
-
-        // Check to see if the user has reduced the size of the buffer described by the sgarray segment since we
-        // provided it to them.  They could have increased the starting address of the buffer (`sgaseg_buf`),
-        // decreased the ending address of the buffer (`sgaseg_buf + sgaseg_len`), or both.
-        let sga_data: *const u8 = sga.sga_segs[0].sgaseg_buf as *const u8;
-        let sga_len: usize = sga.sga_segs[0].sgaseg_len as usize;
-        let clone_data: *const u8 = clone.as_ptr();
-        let mut clone_len: usize = clone.len();
-        if sga_data != clone_data || sga_len != clone_len {
-            // We need to adjust the DemiBuffer to match the user's changes.
-
-            // First check that the user didn't do something non-sensical, like change the buffer description to
-            // reference address space outside of the allocated memory area.
-            if sga_data < clone_data || sga_data.addr() + sga_len > clone_data.addr() + clone_len {
-                return Err(Fail::new(
-                    libc::EINVAL,
-                    "demi_sgarray_t describes data outside backing buffer's allocated region",
-                ));
-            }
+        memory::clone_sgarray(sga)
+    }
 
-            // Calculate the amount the new starting address is ahead of the old.  And then adjust `clone` to match.
-            let adjustment_amount: usize = sga_data.addr() - clone_data.addr();
-            clone.adjust(adjustment_amount)?;
+    /// Returns the chunks of memory that back the body pools, each given as its start address and length.
+    pub fn memory_spans(&self) -> Vec<(*mut u8, usize)> {
+        self.body_pools.iter().flat_map(MemoryPool::memory_spans).collect()
+    }
 
-            // An adjustment above would have reduced clone.len() by the adjustment amount.
-            clone_len -= adjustment_amount;
-            debug_assert_eq!(clone_len, clone.len());
+    /// Returns a raw pointer to the body pool of the largest size class, which feeds the RX queue.
+    /// TODO: Review the need of this function after we are done with the refactor of the DPDK runtime.
+    pub fn body_pool(&self) -> *mut rte_mempool {
+        self.largest_body_pool().into_raw()
+    }
 
-            // Trim the clone down to size.
-            let trim_amount: usize = clone_len - sga_len;
-            clone.trim(trim_amount)?;
-        }
+    /// Returns the number of bytes of data that an mbuf of the largest size class holds after its headroom.
+    fn get_max_data_size(&self) -> usize {
+        self.largest_body_pool().get_max_data_size()
+    }
 
-        Ok(clone)
+    fn largest_body_pool(&self) -> &MemoryPool {
+        // This unwrap won't panic as there is always at least one size class.
+        self.body_pools.last().unwrap()
     }
 
-    /// Returns a raw pointer to the underlying body pool.
-    /// TODO: Review the need of this function after we are done with the refactor of the DPDK runtime.
-    pub fn body_pool(&self) -> *mut rte_mempool {
-        self.body_pool.into_raw()
+    /// Allocates an mbuf with `size` bytes of data from the smallest size class that fits it. If that class runs out
+    /// of mbufs, the next larger class that fits is used instead.
+    fn alloc_mbuf(&self, size: usize) -> Result<*mut rte_mbuf, Fail> {
+        let mut result: Result<*mut rte_mbuf, Fail> = Err(Fail::new(libc::EFAULT, "cannot allocate a mbuf this big"));
+        for body_pool in self.body_pools.iter() {
+            if body_pool.get_max_data_size() < size {
+                continue;
+            }
+            result = body_pool.alloc_mbuf(Some(size));
+            if result.is_ok() {
+                break;
+            }
+        }
+        result
     }
 }
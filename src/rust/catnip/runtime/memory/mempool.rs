@@ -5,13 +5,17 @@
 // Imports
 //======================================================================================================================
 
-use crate::runtime::{
-    fail::Fail,
-    libdpdk::{
-        rte_errno, rte_mbuf, rte_mempool, rte_pktmbuf_alloc, rte_pktmbuf_free, rte_pktmbuf_pool_create, rte_socket_id,
+use crate::{
+    perftools::stats::{self, Counter},
+    runtime::{
+        fail::Fail,
+        libdpdk::{
+            rte_errno, rte_mbuf, rte_mempool, rte_mempool_mem_iter, rte_mempool_memhdr, rte_pktmbuf_alloc,
+            rte_pktmbuf_free, rte_pktmbuf_pool_create, RTE_PKTMBUF_HEADROOM,
+        },
     },
 };
-use ::std::ffi::CString;
+use ::std::{ffi::CString, os::raw::c_uint};
 
 //======================================================================================================================
 // Structures
@@ -22,6 +26,8 @@ use ::std::ffi::CString;
 pub struct MemoryPool {
     /// Underlying memory pool.
     pool: *mut rte_mempool,
+    /// Size of the data room of every mbuf in the pool, headroom included.
+    data_room_size: usize,
 }
 
 //======================================================================================================================
@@ -30,8 +36,15 @@ pub struct MemoryPool {
 
 /// Associated functions for memory pool.
 impl MemoryPool {
-    /// Creates a new memory pool.
-    pub fn new(name: CString, data_room_size: usize, pool_size: usize, cache_size: usize) -> Result<Self, Fail> {
+    /// Creates a new memory pool in the memory of NUMA socket `socket_id`. Every lcore that allocates from the pool
+    /// keeps a private cache of up to `cache_size` mbufs.
+    pub fn new(
+        name: CString,
+        data_room_size: usize,
+        pool_size: usize,
+        cache_size: usize,
+        socket_id: i32,
+    ) -> Result<Self, Fail> {
         let pool: *mut rte_mempool = unsafe {
             rte_pktmbuf_pool_create(
                 name.as_ptr(),
@@ -39,7 +52,7 @@ impl MemoryPool {
                 cache_size as u32,
                 0,
                 data_room_size as u16,
-                rte_socket_id() as i32,
+                socket_id,
             )
         };
 
@@ -51,7 +64,12 @@ impl MemoryPool {
             return Err(Fail::new(libc::EAGAIN, &cause));
         }
 
-        Ok(Self { pool })
+        Ok(Self { pool, data_room_size })
+    }
+
+    /// Returns the number of bytes of data that an mbuf of the pool holds after its headroom.
+    pub fn get_max_data_size(&self) -> usize {
+        self.data_room_size.saturating_sub(RTE_PKTMBUF_HEADROOM as usize)
     }
 
     /// Gets a raw pointer to the underlying memory pool.
@@ -59,6 +77,20 @@ impl MemoryPool {
         self.pool
     }
 
+    /// Returns the chunks of memory that back the pool, each given as its start address and length.
+    pub fn memory_spans(&self) -> Vec<(*mut u8, usize)> {
+        let mut spans: Vec<(*mut u8, usize)> = Vec::new();
+        // Safety: the pool is valid and the callback only runs for the duration of the call.
+        unsafe {
+            rte_mempool_mem_iter(
+                self.pool,
+                Some(push_memory_span),
+                &mut spans as *mut Vec<(*mut u8, usize)> as *mut libc::c_void,
+            )
+        };
+        spans
+    }
+
     /// Allocates a mbuf in the target memory pool.
     pub fn alloc_mbuf(&self, size: Option<usize>) -> Result<*mut rte_mbuf, Fail> {
         // TODO: Drop the following warning once DPDK memory management is more stable.
@@ -70,6 +102,7 @@ impl MemoryPool {
             let rte_errno: libc::c_int = unsafe { rte_errno() };
             let cause: String = format!("cannot allocate an mbuf at this time: {:?}", rte_errno);
             warn!("alloc_mbuf(): {}", cause);
+            stats::count(Counter::MempoolExhausted, 1);
 
             return Err(Fail::new(libc::ENOMEM, &cause));
         }
@@ -94,3 +127,18 @@ impl MemoryPool {
         Ok(mbuf_ptr)
     }
 }
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Callback of `rte_mempool_mem_iter()` that records a chunk of memory of a pool in the vector pointed to by `opaque`.
+unsafe extern "C" fn push_memory_span(
+    _pool: *mut rte_mempool,
+    opaque: *mut libc::c_void,
+    memhdr: *mut rte_mempool_memhdr,
+    _mem_idx: c_uint,
+) {
+    let spans: &mut Vec<(*mut u8, usize)> = &mut *(opaque as *mut Vec<(*mut u8, usize)>);
+    spans.push(((*memhdr).addr as *mut u8, (*memhdr).len));
+}
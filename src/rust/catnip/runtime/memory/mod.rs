@@ -36,9 +36,9 @@ impl MemoryRuntime for SharedDPDKRuntime {
         self.mm.into_sgarray(buf)
     }
 
-    /// Allocates a [demi_sgarray_t].
-    fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        self.mm.alloc_sgarray(size)
+    /// Allocates a [demi_sgarray_t] with one segment per entry of `seglens`.
+    fn sgaallocv(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
+        self.mm.alloc_sgarray(seglens)
     }
 
     /// Releases a [demi_sgarray_t].
@@ -11,23 +11,36 @@ use self::memory::{consts::DEFAULT_MAX_BODY_SIZE, MemoryManager};
 use crate::{
     demikernel::config::Config,
     expect_some,
-    inetstack::protocols::layer1::PhysicalLayer,
+    inetstack::protocols::{
+        layer1::PhysicalLayer,
+        layer2::{EtherType2, ETHERNET2_HEADER_SIZE},
+        layer3::{ipv4::IPV4_HEADER_MIN_SIZE, IpProtocol},
+        layer4::{tcp::header::MIN_TCP_HEADER_SIZE, udp::header::UDP_HEADER_SIZE},
+    },
     runtime::{
         fail::Fail,
         libdpdk::{
             rte_delay_us_block, rte_eal_init, rte_errno, rte_eth_conf, rte_eth_dev_configure, rte_eth_dev_count_avail,
             rte_eth_dev_get_mtu, rte_eth_dev_info, rte_eth_dev_info_get, rte_eth_dev_is_valid_port,
-            rte_eth_dev_set_mtu, rte_eth_dev_start, rte_eth_find_next_owned_by, rte_eth_link, rte_eth_link_get_nowait,
-            rte_eth_promiscuous_enable, rte_eth_rss_ip, rte_eth_rx_burst,
-            rte_eth_rx_mq_mode_RTE_ETH_MQ_RX_RSS as RTE_ETH_MQ_RX_RSS, rte_eth_rx_offload_tcp_cksum,
-            rte_eth_rx_offload_udp_cksum, rte_eth_rx_queue_setup, rte_eth_rxconf, rte_eth_tx_burst,
-            rte_eth_tx_mq_mode_RTE_ETH_MQ_TX_NONE as RTE_ETH_MQ_TX_NONE, rte_eth_tx_offload_multi_segs,
-            rte_eth_tx_offload_tcp_cksum, rte_eth_tx_offload_udp_cksum, rte_eth_tx_queue_setup, rte_eth_txconf,
-            rte_mbuf, RTE_ETHER_MAX_JUMBO_FRAME_LEN, RTE_ETHER_MAX_LEN, RTE_ETH_DEV_NO_OWNER, RTE_ETH_LINK_FULL_DUPLEX,
-            RTE_ETH_LINK_UP, RTE_PKTMBUF_HEADROOM,
+            rte_eth_dev_rss_reta_update, rte_eth_dev_set_mtu, rte_eth_dev_socket_id, rte_eth_dev_start,
+            rte_eth_find_next_owned_by, rte_eth_link, rte_eth_link_get_nowait, rte_eth_promiscuous_enable,
+            rte_eth_rss_ip, rte_eth_rss_reta_entry64, rte_eth_rx_burst,
+            rte_eth_rx_mq_mode_RTE_ETH_MQ_RX_RSS as RTE_ETH_MQ_RX_RSS, rte_eth_rx_offload_ipv4_cksum,
+            rte_eth_rx_offload_tcp_cksum, rte_eth_rx_offload_udp_cksum, rte_eth_rx_queue_setup, rte_eth_rxconf,
+            rte_eth_tx_burst, rte_eth_tx_mq_mode_RTE_ETH_MQ_TX_NONE as RTE_ETH_MQ_TX_NONE,
+            rte_eth_tx_offload_ipv4_cksum, rte_eth_tx_offload_multi_segs, rte_eth_tx_offload_tcp_cksum,
+            rte_eth_tx_offload_tcp_tso, rte_eth_tx_offload_udp_cksum, rte_eth_tx_prepare, rte_eth_tx_queue_setup,
+            rte_eth_txconf, rte_mbuf, rte_mbuf_f_rx_ip_cksum_bad, rte_mbuf_f_rx_ip_cksum_mask,
+            rte_mbuf_f_rx_l4_cksum_bad, rte_mbuf_f_rx_l4_cksum_mask, rte_mbuf_f_tx_ip_cksum, rte_mbuf_f_tx_ipv4,
+            rte_mbuf_f_tx_tcp_cksum, rte_mbuf_f_tx_tcp_seg, rte_mbuf_f_tx_udp_cksum, rte_mbuf_set_tx_offload,
+            rte_pktmbuf_free, RTE_ETHER_MAX_JUMBO_FRAME_LEN, RTE_ETHER_MAX_LEN, RTE_ETH_DEV_NO_OWNER,
+            RTE_ETH_LINK_FULL_DUPLEX, RTE_ETH_LINK_UP, RTE_ETH_RETA_GROUP_SIZE, RTE_PKTMBUF_HEADROOM,
+        },
+        memory::{prefault, DemiBuffer},
+        network::{
+            consts::{DEFAULT_RECEIVE_BATCH_SIZE, RECEIVE_BATCH_SIZE},
+            rss::{RssSteering, RSS_KEY_LEN, RSS_SYMMETRIC_KEY},
         },
-        memory::DemiBuffer,
-        network::consts::RECEIVE_BATCH_SIZE,
         SharedObject,
     },
     timer,
@@ -38,16 +51,95 @@ use ::std::{
     mem,
     mem::MaybeUninit,
     ops::{Deref, DerefMut},
+    slice,
+    sync::{Mutex, MutexGuard},
     time::Duration,
 };
 
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of staged mbufs at which we flush the TX staging ring without waiting for the end of the poll pass.
+const TX_BURST_SIZE: usize = 32;
+
+/// Capacity that we reserve for the TX staging ring, which is also the most mbufs that we offer in a single burst. This
+/// leaves room for retrying mbufs that the NIC did not accept in a previous burst while still staging new ones.
+const TX_STAGING_RING_SIZE: usize = 8 * TX_BURST_SIZE;
+
+//======================================================================================================================
+// Static Variables
+//======================================================================================================================
+
+/// State of the DPDK port, which is shared by the runtimes of all cores in the process. It is set up by the first runtime
+/// that is created.
+static DPDK_PORT: Mutex<Option<DPDKPort>> = Mutex::new(None);
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
 
+/// Statistics for the TX staging ring.
+#[derive(Clone, Copy, Debug, Default)]
+pub struct TxStats {
+    /// Number of calls to rte_eth_tx_burst().
+    pub flushes: u64,
+    /// Number of mbufs accepted by the NIC.
+    pub packets_sent: u64,
+    /// Number of bursts in which the NIC accepted fewer mbufs than we offered.
+    pub partial_sends: u64,
+    /// Number of mbufs that were left in the staging ring to be retried in a later burst.
+    pub retried: u64,
+    /// Number of mbufs staged beyond the reserved capacity of the staging ring, because the NIC refused packets.
+    pub overflowed: u64,
+    /// Number of mbufs dropped because the NIC cannot apply the offloads that they request.
+    pub offload_rejected: u64,
+}
+
+/// Offload flags that we set on outgoing mbufs and check on incoming ones. Transmit flags are only set if the matching
+/// offload is enabled on the port. DPDK only exposes these flags as macros, so we look them up once.
+#[derive(Clone, Copy, Debug)]
+struct MbufOffloads {
+    /// Flags that request the NIC to compute the IPv4 header checksum.
+    tx_ipv4: u64,
+    /// Flags that request the NIC to compute the TCP checksum.
+    tx_tcp: u64,
+    /// Flags that request the NIC to compute the UDP checksum.
+    tx_udp: u64,
+    /// Flag that requests the NIC to cut a TCP segment into MSS-sized packets.
+    tx_tcp_seg: u64,
+    rx_ip_cksum_mask: u64,
+    rx_ip_cksum_bad: u64,
+    rx_l4_cksum_mask: u64,
+    rx_l4_cksum_bad: u64,
+}
+
+/// Process-wide state of a DPDK port that is split into several RX/TX queue pairs. Each runtime claims one queue pair
+/// for the lifetime of the process and serves it on its own core, without sharing any state with the other runtimes.
+struct DPDKPort {
+    port_id: u16,
+    /// Number of entries in the redirection table of the port.
+    reta_size: u16,
+    /// Memory managers that feed the RX queues, indexed by queue. A runtime takes the one of the queue that it claims.
+    memory_managers: Vec<Option<MemoryManager>>,
+    /// Transmit offloads that are enabled on the port.
+    tx_offloads: u64,
+}
+
 pub struct DPDKRuntime {
     mm: MemoryManager,
     port_id: u16,
+    /// RX/TX queue pair that is served by this runtime.
+    queue_id: u16,
+    /// Flow steering across the queues of the port. This is only set if the port has more than one queue.
+    rss_steering: Option<RssSteering>,
+    /// Maximum number of mbufs that we pull from the NIC on every receive.
+    rx_batch_size: u16,
+    /// Offloads that are requested on outgoing mbufs.
+    mbuf_offloads: MbufOffloads,
+    /// Outgoing mbufs that have not yet been handed to the NIC.
+    tx_staging: Vec<*mut rte_mbuf>,
+    tx_stats: TxStats,
 }
 
 #[derive(Clone)]
@@ -75,15 +167,91 @@ impl SharedDPDKRuntime {
             },
         };
 
-        let (mm, port_id): (MemoryManager, u16) = Self::initialize_dpdk(
-            &config.eal_init_args()?,
-            config.enable_jumbo_frames()?,
-            config.mtu()?,
-            tcp_offload.unwrap_or(false),
-            udp_offload.unwrap_or(false),
-        )?;
+        let tso_offload: bool = match config.tcp_segmentation_offload() {
+            Ok(offload) => offload,
+            Err(_) => {
+                warn!("No setting for TCP segmentation offload. Turning off by default.");
+                false
+            },
+        };
 
-        Ok(Self(SharedObject::<DPDKRuntime>::new(DPDKRuntime { mm, port_id })))
+        let rx_batch_size: usize = match config.receive_batch_size()? {
+            Some(batch_size) => batch_size,
+            None => {
+                warn!(
+                    "No setting for receive batch size. Using {} by default.",
+                    DEFAULT_RECEIVE_BATCH_SIZE
+                );
+                DEFAULT_RECEIVE_BATCH_SIZE
+            },
+        };
+
+        let prefault_pools: bool = match config.prefault_pools() {
+            Ok(prefault) => prefault,
+            Err(_) => {
+                warn!("No setting for prefaulting pools. Disabling it by default.");
+                false
+            },
+        };
+
+        let num_queues: u16 = match config.num_queues() {
+            Ok(num_queues) => num_queues,
+            Err(_) => {
+                warn!("No setting for number of queues. Using a single queue by default.");
+                1
+            },
+        };
+
+        let mut port: MutexGuard<Option<DPDKPort>> = match DPDK_PORT.lock() {
+            Ok(port) => port,
+            Err(_) => {
+                let cause: String = format!("state of the DPDK port is poisoned");
+                error!("new(): {}", cause);
+                return Err(Fail::new(libc::EIO, &cause));
+            },
+        };
+        // The first runtime of the process initializes DPDK and sets up the queues of all cores.
+        if port.is_none() {
+            *port = Some(Self::initialize_dpdk(
+                &config.eal_init_args()?,
+                config.enable_jumbo_frames()?,
+                config.mtu()?,
+                tcp_offload.unwrap_or(false),
+                udp_offload.unwrap_or(false),
+                tso_offload,
+                num_queues,
+                prefault_pools,
+            )?);
+        }
+        let port: &mut DPDKPort = expect_some!(port.as_mut(), "DPDK port should be initialized");
+        let (queue_id, mm): (u16, MemoryManager) = port.claim_queue()?;
+        let rss_steering: Option<RssSteering> = if port.num_queues() > 1 {
+            Some(RssSteering::new(queue_id, port.num_queues(), port.reta_size))
+        } else {
+            None
+        };
+        trace!(
+            "new(): serving queue {} of {} on port {}",
+            queue_id,
+            port.num_queues(),
+            port.port_id
+        );
+
+        Ok(Self(SharedObject::<DPDKRuntime>::new(DPDKRuntime {
+            mm,
+            port_id: port.port_id,
+            queue_id,
+            rss_steering,
+            rx_batch_size: rx_batch_size as u16,
+            mbuf_offloads: MbufOffloads::new(port.tx_offloads),
+            tx_staging: Vec::<*mut rte_mbuf>::with_capacity(TX_STAGING_RING_SIZE),
+            tx_stats: TxStats::default(),
+        })))
+    }
+
+    /// Returns the statistics of the TX staging ring.
+    pub fn get_tx_stats(&self) -> TxStats {
+        self.tx_stats
     }
 
     fn initialize_dpdk(
@@ -92,7 +260,10 @@ impl SharedDPDKRuntime {
         mtu: u16,
         tcp_checksum_offload: bool,
         udp_checksum_offload: bool,
-    ) -> Result<(MemoryManager, u16), Fail> {
+        tcp_segmentation_offload: bool,
+        num_queues: u16,
+        prefault_pools: bool,
+    ) -> Result<DPDKPort, Fail> {
         std::env::set_var("MLX5_SHUT_UP_BF", "1");
         std::env::set_var("MLX5_SINGLE_THREADED", "1");
         std::env::set_var("MLX4_SINGLE_THREADED", "1");
@@ -116,24 +287,43 @@ impl SharedDPDKRuntime {
             DEFAULT_MAX_BODY_SIZE
         };
 
-        let memory_manager = match MemoryManager::new(max_body_size) {
-            Ok(manager) => manager,
-            Err(e) => {
-                let cause: String = format!("Failed to set up memory manager: {:?}", e);
-                error!("initialize_dpdk(): {}", cause);
-                return Err(Fail::new(libc::EIO, &cause));
-            },
-        };
-
         let owner: u64 = RTE_ETH_DEV_NO_OWNER as u64;
         let port_id: u16 = unsafe { rte_eth_find_next_owned_by(0, owner) as u16 };
-        Self::initialize_dpdk_port(
+        // Place the memory pools on the NUMA socket of the port, so the NIC does not reach across sockets for them.
+        // DPDK reports SOCKET_ID_ANY if it does not know the socket, which lets it pick one.
+        let socket_id: i32 = unsafe { rte_eth_dev_socket_id(port_id) };
+        trace!("DPDK reports that port {} is on NUMA socket {}.", port_id, socket_id);
+
+        let mut memory_managers: Vec<MemoryManager> = Vec::<MemoryManager>::with_capacity(num_queues as usize);
+        for queue_id in 0..num_queues {
+            match MemoryManager::new(max_body_size, queue_id, socket_id) {
+                Ok(manager) => memory_managers.push(manager),
+                Err(e) => {
+                    let cause: String = format!("Failed to set up memory manager: {:?}", e);
+                    error!("initialize_dpdk(): {}", cause);
+                    return Err(Fail::new(libc::EIO, &cause));
+                },
+            };
+        }
+
+        // Touch the pools of all queues at once, so that large pools are spread across threads.
+        if prefault_pools {
+            let spans: Vec<(*mut u8, usize)> = memory_managers.iter().flat_map(MemoryManager::memory_spans).collect();
+            // Safety: the pools were just created, so nothing else accesses their memory yet.
+            if let Err(e) = unsafe { prefault(&spans) } {
+                warn!("initialize_dpdk(): failed to lock memory pools: {:?}", e);
+            }
+        }
+
+        let (reta_size, tx_offloads): (u16, u64) = Self::initialize_dpdk_port(
             port_id,
-            &memory_manager,
+            socket_id,
+            &memory_managers,
             use_jumbo_frames,
             mtu,
             tcp_checksum_offload,
             udp_checksum_offload,
+            tcp_segmentation_offload,
         )?;
 
         // TODO: Where is this function?
@@ -141,19 +331,28 @@ impl SharedDPDKRuntime {
         //     eprintln!("WARNING: Too many lcores enabled. Only 1 used.");
         // }
 
-        Ok((memory_manager, port_id))
+        Ok(DPDKPort {
+            port_id,
+            reta_size,
+            memory_managers: memory_managers.into_iter().map(Some).collect(),
+            tx_offloads,
+        })
     }
 
+    /// Sets up one RX/TX queue pair per memory manager on the target port and returns the size of its redirection table,
+    /// along with the transmit offloads that are enabled on it.
     fn initialize_dpdk_port(
         port_id: u16,
-        memory_manager: &MemoryManager,
+        socket_id: i32,
+        memory_managers: &[MemoryManager],
         use_jumbo_frames: bool,
         mtu: u16,
         tcp_checksum_offload: bool,
         udp_checksum_offload: bool,
-    ) -> Result<(), Fail> {
-        let rx_rings: u16 = 1;
-        let tx_rings: u16 = 1;
+        tcp_segmentation_offload: bool,
+    ) -> Result<(u16, u64), Fail> {
+        let rx_rings: u16 = memory_managers.len() as u16;
+        let tx_rings: u16 = memory_managers.len() as u16;
         let rx_ring_size: u16 = 2048;
         let tx_ring_size: u16 = 2048;
         let nb_rxd: u16 = rx_ring_size;
@@ -174,6 +373,15 @@ impl SharedDPDKRuntime {
         };
 
         println!("dev_info: {:?}", dev_info);
+        if rx_rings > dev_info.max_rx_queues || tx_rings > dev_info.max_tx_queues {
+            let cause: String = format!(
+                "port does not support this many queues (num_queues={:?}, max_rx_queues={:?}, max_tx_queues={:?})",
+                rx_rings, dev_info.max_rx_queues, dev_info.max_tx_queues
+            );
+            error!("initialize_dpdk_port(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
         let mut port_conf: rte_eth_conf = unsafe { MaybeUninit::zeroed().assume_init() };
         port_conf.rxmode.max_lro_pkt_size = if use_jumbo_frames {
             RTE_ETHER_MAX_JUMBO_FRAME_LEN
@@ -188,6 +396,28 @@ impl SharedDPDKRuntime {
         }
         port_conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
         port_conf.rx_adv_conf.rss_conf.rss_hf = unsafe { rte_eth_rss_ip() as u64 } | dev_info.flow_type_rss_offloads;
+        // Use a symmetric key, so that both directions of a flow are steered to the same queue. The key is copied by
+        // rte_eth_dev_configure(), so it only needs to outlive that call.
+        let mut rss_key: [u8; RSS_KEY_LEN] = RSS_SYMMETRIC_KEY;
+        if dev_info.hash_key_size == 0 || dev_info.hash_key_size as usize == RSS_KEY_LEN {
+            port_conf.rx_adv_conf.rss_conf.rss_key = rss_key.as_mut_ptr();
+            port_conf.rx_adv_conf.rss_conf.rss_key_len = RSS_KEY_LEN as u8;
+        } else if rx_rings > 1 {
+            // We steer connections to queues by computing the hash of their flows ourselves, which only works if the
+            // NIC uses our key.
+            let cause: String = format!(
+                "port does not support our RSS key size (hash_key_size={:?}, rss_key_len={:?})",
+                dev_info.hash_key_size, RSS_KEY_LEN
+            );
+            error!("initialize_dpdk_port(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        } else {
+            // There is a single queue, so there is nothing to steer and the default key does just as well.
+            warn!(
+                "initialize_dpdk_port(): unsupported RSS key size, keeping the default key (hash_key_size={:?})",
+                dev_info.hash_key_size
+            );
+        }
 
         port_conf.txmode.mq_mode = RTE_ETH_MQ_TX_NONE;
         if tcp_checksum_offload {
@@ -196,6 +426,27 @@ impl SharedDPDKRuntime {
         if udp_checksum_offload {
             port_conf.txmode.offloads |= unsafe { rte_eth_tx_offload_udp_cksum() as u64 };
         }
+        if tcp_segmentation_offload {
+            let tso: u64 = unsafe { rte_eth_tx_offload_tcp_tso() as u64 };
+            if dev_info.tx_offload_capa & tso == 0 {
+                let cause: String = format!("port does not support TCP segmentation offload");
+                error!("initialize_dpdk_port(): {}", cause);
+                return Err(Fail::new(libc::EINVAL, &cause));
+            }
+            // The NIC computes the checksum of every segment that it cuts.
+            port_conf.txmode.offloads |= tso | unsafe { rte_eth_tx_offload_tcp_cksum() as u64 };
+        }
+        // If we offload anything, also offload the IPv4 header checksum when the port can do it.
+        if tcp_checksum_offload || udp_checksum_offload || tcp_segmentation_offload {
+            let rx_ipv4_cksum: u64 = unsafe { rte_eth_rx_offload_ipv4_cksum() as u64 };
+            if dev_info.rx_offload_capa & rx_ipv4_cksum != 0 {
+                port_conf.rxmode.offloads |= rx_ipv4_cksum;
+            }
+            let tx_ipv4_cksum: u64 = unsafe { rte_eth_tx_offload_ipv4_cksum() as u64 };
+            if dev_info.tx_offload_capa & tx_ipv4_cksum != 0 {
+                port_conf.txmode.offloads |= tx_ipv4_cksum;
+            }
+        }
         port_conf.txmode.offloads |= unsafe { rte_eth_tx_offload_multi_segs() as u64 };
 
         let mut rx_conf: rte_eth_rxconf = unsafe { MaybeUninit::zeroed().assume_init() };
@@ -235,7 +486,8 @@ impl SharedDPDKRuntime {
             }
         }
 
-        let socket_id: u32 = 0;
+        // Rings take the socket as an unsigned value, which maps SOCKET_ID_ANY to the same bits.
+        let socket_id: u32 = socket_id as u32;
 
         unsafe {
             for i in 0..rx_rings {
@@ -245,7 +497,7 @@ impl SharedDPDKRuntime {
                     nb_rxd,
                     socket_id,
                     &rx_conf as *const _,
-                    memory_manager.body_pool(),
+                    memory_managers[i as usize].body_pool(),
                 ) != 0
                 {
                     let cause: String = format!("Failed to set up rx queue");
@@ -268,6 +520,10 @@ impl SharedDPDKRuntime {
             rte_eth_promiscuous_enable(port_id);
         }
 
+        if rx_rings > 1 {
+            Self::initialize_dpdk_reta(port_id, dev_info.reta_size, rx_rings)?;
+        }
+
         if unsafe { rte_eth_dev_is_valid_port(port_id) } == 0 {
             let cause: String = format!("Invalid port id");
             error!("initialize_dpdk_port(): {}", cause);
@@ -304,10 +560,220 @@ impl SharedDPDKRuntime {
             retry_count -= 1;
         }
 
+        Ok((dev_info.reta_size, port_conf.txmode.offloads))
+    }
+
+    /// Spreads the entries of the redirection table of the target port round-robin across its queues, so that
+    /// [RssSteering] can tell on which queue a flow lands.
+    fn initialize_dpdk_reta(port_id: u16, reta_size: u16, num_queues: u16) -> Result<(), Fail> {
+        let group_size: usize = RTE_ETH_RETA_GROUP_SIZE as usize;
+        let num_groups: usize = (reta_size as usize + group_size - 1) / group_size;
+        let mut reta_conf: Vec<rte_eth_rss_reta_entry64> = (0..num_groups)
+            .map(|_| unsafe { MaybeUninit::<rte_eth_rss_reta_entry64>::zeroed().assume_init() })
+            .collect();
+        for i in 0..reta_size as usize {
+            let entry: &mut rte_eth_rss_reta_entry64 = &mut reta_conf[i / group_size];
+            entry.mask |= 1 << (i % group_size);
+            entry.reta[i % group_size] = (i % num_queues as usize) as u16;
+        }
+
+        if unsafe { rte_eth_dev_rss_reta_update(port_id, reta_conf.as_mut_ptr(), reta_size) } != 0 {
+            let cause: String = format!("Failed to update redirection table (reta_size={:?})", reta_size);
+            error!("initialize_dpdk_reta(): {}", cause);
+            return Err(Fail::new(libc::EIO, &cause));
+        }
+
         Ok(())
     }
 }
 
+impl DPDKPort {
+    /// Returns the number of RX/TX queue pairs of the port.
+    fn num_queues(&self) -> u16 {
+        self.memory_managers.len() as u16
+    }
+
+    /// Claims the first RX/TX queue pair of the port that is not served by any runtime yet.
+    fn claim_queue(&mut self) -> Result<(u16, MemoryManager), Fail> {
+        for (queue_id, memory_manager) in self.memory_managers.iter_mut().enumerate() {
+            if let Some(memory_manager) = memory_manager.take() {
+                return Ok((queue_id as u16, memory_manager));
+            }
+        }
+        let cause: String = format!("all queues of the port are in use (num_queues={:?})", self.num_queues());
+        error!("claim_queue(): {}", cause);
+        Err(Fail::new(libc::EBUSY, &cause))
+    }
+}
+
+impl MbufOffloads {
+    /// Looks up the offload flags of the mbufs that are sent on a port with the `tx_offloads` transmit offloads.
+    fn new(tx_offloads: u64) -> Self {
+        let enabled = |offload: libc::c_int, flags: u64| -> u64 {
+            if tx_offloads & offload as u64 != 0 {
+                flags
+            } else {
+                0
+            }
+        };
+
+        unsafe {
+            Self {
+                tx_ipv4: enabled(
+                    rte_eth_tx_offload_ipv4_cksum(),
+                    rte_mbuf_f_tx_ipv4() | rte_mbuf_f_tx_ip_cksum(),
+                ),
+                tx_tcp: enabled(
+                    rte_eth_tx_offload_tcp_cksum(),
+                    rte_mbuf_f_tx_ipv4() | rte_mbuf_f_tx_tcp_cksum(),
+                ),
+                tx_udp: enabled(
+                    rte_eth_tx_offload_udp_cksum(),
+                    rte_mbuf_f_tx_ipv4() | rte_mbuf_f_tx_udp_cksum(),
+                ),
+                tx_tcp_seg: enabled(rte_eth_tx_offload_tcp_tso(), rte_mbuf_f_tx_tcp_seg()),
+                rx_ip_cksum_mask: rte_mbuf_f_rx_ip_cksum_mask(),
+                rx_ip_cksum_bad: rte_mbuf_f_rx_ip_cksum_bad(),
+                rx_l4_cksum_mask: rte_mbuf_f_rx_l4_cksum_mask(),
+                rx_l4_cksum_bad: rte_mbuf_f_rx_l4_cksum_bad(),
+            }
+        }
+    }
+
+    /// Checks if the NIC found a bad IPv4 or L4 checksum in an incoming mbuf.
+    fn has_bad_checksum(&self, ol_flags: u64) -> bool {
+        ol_flags & self.rx_ip_cksum_mask == self.rx_ip_cksum_bad
+            || ol_flags & self.rx_l4_cksum_mask == self.rx_l4_cksum_bad
+    }
+}
+
+impl DPDKRuntime {
+    /// Fills in the offload metadata of an outgoing mbuf, so that the NIC computes the checksums of the packet and, if
+    /// `tso_segment_size` is not zero, cuts its TCP payload into segments of that size. The headers of the packet must
+    /// be in the first segment of the mbuf.
+    fn set_tx_offload(&self, mbuf_ptr: *mut rte_mbuf, tso_segment_size: u16) {
+        let offloads: &MbufOffloads = &self.mbuf_offloads;
+        if offloads.tx_ipv4 | offloads.tx_tcp | offloads.tx_udp == 0 {
+            return;
+        }
+
+        // Safety: `mbuf_ptr` is a valid pointer to a properly initialized `rte_mbuf` struct.
+        let data: &[u8] = unsafe {
+            slice::from_raw_parts(
+                ((*mbuf_ptr).buf_addr as *const u8).add((*mbuf_ptr).data_off as usize),
+                (*mbuf_ptr).data_len as usize,
+            )
+        };
+
+        // Only IPv4 packets carry checksums that the NIC computes.
+        let l2_len: usize = ETHERNET2_HEADER_SIZE;
+        if data.len() < l2_len + IPV4_HEADER_MIN_SIZE as usize
+            || u16::from_be_bytes([data[12], data[13]]) != EtherType2::Ipv4 as u16
+        {
+            return;
+        }
+        let l3_len: usize = (data[l2_len] & 0xf) as usize * 4;
+        let protocol: u8 = data[l2_len + 9];
+
+        let mut ol_flags: u64 = offloads.tx_ipv4;
+        let mut l4_len: usize = 0;
+        let mut tso_segsz: u16 = 0;
+        if protocol == IpProtocol::TCP as u8 && data.len() >= l2_len + l3_len + MIN_TCP_HEADER_SIZE {
+            ol_flags |= offloads.tx_tcp;
+            l4_len = (data[l2_len + l3_len + 12] >> 4) as usize * 4;
+            if tso_segment_size > 0 && offloads.tx_tcp_seg != 0 {
+                ol_flags |= offloads.tx_tcp_seg;
+                tso_segsz = tso_segment_size;
+            }
+        } else if protocol == IpProtocol::UDP as u8 {
+            ol_flags |= offloads.tx_udp;
+            l4_len = UDP_HEADER_SIZE;
+        }
+
+        unsafe {
+            rte_mbuf_set_tx_offload(
+                mbuf_ptr,
+                ol_flags,
+                l2_len as u16,
+                l3_len as u16,
+                l4_len as u16,
+                tso_segsz,
+            )
+        };
+    }
+
+    /// Hands up to [TX_STAGING_RING_SIZE] staged mbufs to the NIC in a single burst. Mbufs that the NIC does not accept
+    /// are kept at the front of the staging ring, so they are retried (in order) in the next burst.
+    fn flush_tx_staging(&mut self) {
+        if self.tx_staging.is_empty() {
+            return;
+        }
+        let num_offered: usize = self.tx_staging.len().min(TX_STAGING_RING_SIZE);
+
+        // Let the driver fix up the headers of the mbufs that request offloads (e.g. pseudo-header checksums). This
+        // stops at the first mbuf that the NIC cannot send as requested, which we drop.
+        let num_prepared: usize = unsafe {
+            rte_eth_tx_prepare(
+                self.port_id,
+                self.queue_id,
+                self.tx_staging.as_mut_ptr(),
+                num_offered as u16,
+            )
+        } as usize;
+        if num_prepared < num_offered {
+            let rte_errno: libc::c_int = unsafe { rte_errno() };
+            warn!(
+                "flush_tx_staging(): dropping mbuf with unsupported offloads (rte_errno={:?})",
+                rte_errno
+            );
+            let mbuf_ptr: *mut rte_mbuf = self.tx_staging.remove(num_prepared);
+            unsafe { rte_pktmbuf_free(mbuf_ptr) };
+            self.tx_stats.offload_rejected += 1;
+        }
+
+        let num_staged: usize = num_prepared;
+        let num_sent: usize = unsafe {
+            rte_eth_tx_burst(
+                self.port_id,
+                self.queue_id,
+                self.tx_staging.as_mut_ptr(),
+                num_staged as u16,
+            )
+        } as usize;
+        debug_assert!(num_sent <= num_staged);
+
+        self.tx_stats.flushes += 1;
+        self.tx_stats.packets_sent += num_sent as u64;
+        if num_sent < num_staged {
+            trace!(
+                "flush_tx_staging(): partial send (staged={:?}, sent={:?})",
+                num_staged,
+                num_sent
+            );
+            self.tx_stats.partial_sends += 1;
+            self.tx_stats.retried += (num_staged - num_sent) as u64;
+        }
+
+        // The NIC now owns the mbufs that it accepted, so just forget about them.
+        self.tx_staging.drain(..num_sent);
+    }
+}
+
+// Safety: the memory pools of a queue are only ever used by the runtime that claimed it, so moving them across threads
+// along with the port state cannot lead to concurrent accesses.
+unsafe impl Send for DPDKPort {}
+
+impl Drop for DPDKRuntime {
+    fn drop(&mut self) {
+        // Give the NIC one last chance to take the staged mbufs and release whatever is left.
+        self.flush_tx_staging();
+        for mbuf_ptr in self.tx_staging.drain(..) {
+            unsafe { rte_pktmbuf_free(mbuf_ptr) };
+        }
+        debug!("drop(): tx_stats={:?}", self.tx_stats);
+    }
+}
+
 impl Deref for SharedDPDKRuntime {
     type Target = DPDKRuntime;
 
@@ -325,42 +791,74 @@ impl DerefMut for SharedDPDKRuntime {
 impl PhysicalLayer for SharedDPDKRuntime {
     fn transmit(&mut self, pkt: DemiBuffer) -> Result<(), Fail> {
         timer!("catnip::runtime::transmit");
+        let tso_segment_size: u16 = pkt.tso_segment_size();
         // Grab the packet and copy it if necessary. In general, this copy will happen for small packets without
-        // payloads because we allocate actual data-carrying application buffers from the DPDK pool.
-        let outgoing_pkt: DemiBuffer = match pkt {
-            buf if buf.is_dpdk_allocated() => buf,
-            buf => {
-                let mut mbuf: DemiBuffer = self.mm.alloc_body_mbuf().expect("should be able to allocate mbuf");
-                debug_assert!(buf.len() < mbuf.len());
-                mbuf.trim(mbuf.len() - buf.len()).expect("Should be able to trim");
-                mbuf.copy_from_slice(&buf);
-
-                mbuf
-            },
+        // payloads because we allocate actual data-carrying application buffers from the DPDK pool. Large application
+        // buffers that the NIC segments for us do not fit in a single mbuf, so they are copied into a chain.
+        let mbuf_ptr: *mut rte_mbuf = match pkt {
+            buf if buf.is_dpdk_allocated() => expect_some!(buf.into_mbuf(), "mbuf cannot be empty"),
+            buf => self.mm.copy_into_mbuf_chain(&buf)?,
         };
+        self.set_tx_offload(mbuf_ptr, tso_segment_size);
+
+        // If the staging ring is full, the NIC has been refusing packets for a while. Try to drain it, and keep the
+        // packet for a later burst if that does not help. The staging ring then grows, but only until the memory pool
+        // runs out of mbufs, which stops the network stack from building more packets.
+        if self.tx_staging.len() >= TX_STAGING_RING_SIZE {
+            self.flush_tx_staging();
+            if self.tx_staging.len() >= TX_STAGING_RING_SIZE {
+                trace!(
+                    "transmit(): TX staging ring is full (staged={:?})",
+                    self.tx_staging.len()
+                );
+                self.tx_stats.overflowed += 1;
+            }
+        }
+        self.tx_staging.push(mbuf_ptr);
+
+        if self.tx_staging.len() >= TX_BURST_SIZE {
+            self.flush_tx_staging();
+        }
+        Ok(())
+    }
 
-        let mut mbuf_ptr: *mut rte_mbuf = expect_some!(outgoing_pkt.into_mbuf(), "mbuf cannot be empty");
-        let num_sent: u16 = unsafe { rte_eth_tx_burst(self.port_id, 0, &mut mbuf_ptr, 1) };
-        debug_assert_eq!(num_sent, 1);
+    fn flush(&mut self) -> Result<(), Fail> {
+        timer!("catnip::runtime::flush");
+        self.flush_tx_staging();
         Ok(())
     }
 
     fn receive(&mut self) -> Result<ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>, Fail> {
         timer!("catnip::runtime::receive");
 
-        let mut out = ArrayVec::new();
+        let mut out: ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE> = ArrayVec::new();
         let mut packets: [*mut rte_mbuf; RECEIVE_BATCH_SIZE] = unsafe { mem::zeroed() };
-        let nb_rx = unsafe { rte_eth_rx_burst(self.port_id, 0, packets.as_mut_ptr(), RECEIVE_BATCH_SIZE as u16) };
-        assert!(nb_rx as usize <= RECEIVE_BATCH_SIZE);
-
-        {
-            for &packet in &packets[..nb_rx as usize] {
-                // Safety: `packet` is a valid pointer to a properly initialized `rte_mbuf` struct.
-                let buf: DemiBuffer = unsafe { DemiBuffer::from_mbuf(packet) };
-                out.push(buf);
+        let nb_rx: u16 =
+            unsafe { rte_eth_rx_burst(self.port_id, self.queue_id, packets.as_mut_ptr(), self.rx_batch_size) };
+        debug_assert!(nb_rx <= self.rx_batch_size);
+
+        // Wrap the whole burst in one go. The mbufs are handed up the stack as they are, without copying, except for
+        // those in which the NIC found a bad checksum, since the stack skips the checksums that are offloaded.
+        // Safety: the first `nb_rx` entries are valid pointers to properly initialized `rte_mbuf` structs.
+        let mbuf_offloads: MbufOffloads = self.mbuf_offloads;
+        out.extend(packets[..nb_rx as usize].iter().filter_map(|&packet| unsafe {
+            if mbuf_offloads.has_bad_checksum((*packet).ol_flags) {
+                trace!("receive(): dropping packet with bad checksum");
+                rte_pktmbuf_free(packet);
+                None
+            } else {
+                Some(DemiBuffer::from_mbuf(packet))
             }
-        }
+        }));
 
         Ok(out)
     }
+
+    fn rss_steering(&self) -> Option<RssSteering> {
+        self.rss_steering
+    }
+
+    fn tcp_segmentation_offload(&self) -> bool {
+        self.mbuf_offloads.tx_tcp_seg != 0
+    }
 }
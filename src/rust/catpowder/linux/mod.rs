@@ -2,41 +2,66 @@
 // Licensed under the MIT license.
 
 mod rawsocket;
+mod xsk;
 
 //======================================================================================================================
 // Imports
 //======================================================================================================================
 
 use crate::{
-    catpowder::linux::rawsocket::{RawSocket, RawSocketAddr},
-    demi_sgarray_t, demi_sgaseg_t,
+    catpowder::linux::{
+        rawsocket::{PacketRing, RawSocket, RawSocketAddr, MAX_MSGS_PER_CALL},
+        xsk::XskQueues,
+    },
+    demi_sgarray_t,
     demikernel::config::Config,
     expect_ok,
-    inetstack::protocols::{layer1::PhysicalLayer, layer2::Ethernet2Header, MAX_HEADER_SIZE},
+    inetstack::protocols::{layer1::PhysicalLayer, MAX_HEADER_SIZE},
     runtime::{
         fail::Fail,
         limits,
-        memory::{DemiBuffer, MemoryRuntime},
-        network::consts::RECEIVE_BATCH_SIZE,
+        memory::{self, DemiBuffer, MemoryRuntime, SizeClassPools},
+        network::consts::{DEFAULT_RECEIVE_BATCH_SIZE, RECEIVE_BATCH_SIZE},
         Runtime, SharedObject,
     },
 };
 use ::arrayvec::ArrayVec;
-use ::libc::c_void;
-use ::std::{
-    fs,
-    mem::{self, MaybeUninit},
-    num::ParseIntError,
-};
+use ::std::{fs, num::ParseIntError, rc::Rc};
 
 //======================================================================================================================
 // Structures
 //======================================================================================================================
 
+/// How packets move between the interface and us.
+enum PacketIo {
+    /// Through PACKET_MMAP rings that a raw socket shares with the kernel.
+    Ring {
+        /// Declared before the socket, which the rings belong to, so that they are unmapped before it gets closed.
+        ring: PacketRing,
+        _socket: RawSocket,
+    },
+    /// Through batches of recvmmsg() and sendmmsg() calls on a raw socket, if the rings are disabled or could not be
+    /// set up.
+    Batch {
+        socket: RawSocket,
+        /// Buffers that packets are received into before we copy them out.
+        rx_scratch: Vec<Vec<u8>>,
+        /// Packets that wait for the next sendmmsg().
+        tx_staging: ArrayVec<DemiBuffer, MAX_MSGS_PER_CALL>,
+        /// Number of staged packets that were dropped because the socket would never take them.
+        tx_dropped: u64,
+    },
+    /// Through AF_XDP sockets, which bypass the kernel network stack.
+    Xdp(XskQueues),
+}
+
 #[derive(Clone)]
 pub struct LinuxRuntime {
-    ifindex: i32,
-    socket: SharedObject<RawSocket>,
+    io: SharedObject<PacketIo>,
+    /// Maximum number of packets that we pull from the interface on every receive.
+    recv_batch_size: usize,
+    /// Pools that scatter-gather arrays are allocated from, if enabled.
+    sga_pools: Option<Rc<SizeClassPools>>,
 }
 
 //======================================================================================================================
@@ -45,19 +70,65 @@ pub struct LinuxRuntime {
 
 impl LinuxRuntime {
     pub fn new(config: &Config) -> Result<Self, Fail> {
-        let mac_addr: [u8; 6] = [0; 6];
-        let ifindex: i32 = match Self::get_ifindex(&config.local_interface_name()?) {
+        let ifname: String = config.local_interface_name()?;
+        let ifindex: i32 = match Self::get_ifindex(&ifname) {
             Ok(ifindex) => ifindex,
             Err(_) => return Err(Fail::new(libc::EINVAL, "could not parse ifindex")),
         };
+
+        let recv_batch_size: usize = match config.receive_batch_size()? {
+            Some(batch_size) => batch_size,
+            None => {
+                warn!(
+                    "No setting for receive batch size. Using {} by default.",
+                    DEFAULT_RECEIVE_BATCH_SIZE
+                );
+                DEFAULT_RECEIVE_BATCH_SIZE
+            },
+        };
+
+        let af_xdp: bool = match config.linux_af_xdp() {
+            Ok(enabled) => enabled,
+            Err(_) => {
+                warn!("No setting for AF_XDP sockets. Using raw sockets by default.");
+                false
+            },
+        };
+        let io: PacketIo = match af_xdp {
+            true => PacketIo::Xdp(XskQueues::new(&ifname, ifindex as u32)?),
+            false => Self::new_raw_socket_io(config, ifindex)?,
+        };
+
+        Ok(Self {
+            io: SharedObject::<PacketIo>::new(io),
+            recv_batch_size,
+            sga_pools: SizeClassPools::from_config(config)?,
+        })
+    }
+
+    fn new_raw_socket_io(config: &Config, ifindex: i32) -> Result<PacketIo, Fail> {
+        let mac_addr: [u8; 6] = [0; 6];
         let socket: RawSocket = RawSocket::new()?;
         let sockaddr: RawSocketAddr = RawSocketAddr::new(ifindex, &mac_addr);
         socket.bind(&sockaddr)?;
 
-        Ok(Self {
-            ifindex,
-            socket: SharedObject::<RawSocket>::new(socket),
-        })
+        let packet_mmap: bool = match config.linux_packet_mmap() {
+            Ok(enabled) => enabled,
+            Err(_) => {
+                warn!("No setting for packet rings. Not using them by default.");
+                false
+            },
+        };
+        if packet_mmap {
+            match PacketRing::new(&socket) {
+                Ok(ring) => return Ok(PacketIo::Ring { ring, _socket: socket }),
+                Err(e) => warn!(
+                    "Could not set up packet rings, using recvmmsg()/sendmmsg() instead: {:?}",
+                    e
+                ),
+            }
+        }
+        Ok(PacketIo::new_batch(socket))
     }
 
     fn get_ifindex(ifname: &str) -> Result<i32, ParseIntError> {
@@ -66,6 +137,52 @@ impl LinuxRuntime {
             .trim()
             .parse()
     }
+
+    /// Hands the staged packets to sendmmsg() until the socket stops taking them. The packets that the socket did not
+    /// take stay staged, in order, if it is only busy. A packet that the socket rejects for any other reason is dropped,
+    /// so that it does not hold back the ones behind it.
+    fn flush_tx_staging(
+        socket: &RawSocket,
+        tx_staging: &mut ArrayVec<DemiBuffer, MAX_MSGS_PER_CALL>,
+        tx_dropped: &mut u64,
+    ) {
+        while !tx_staging.is_empty() {
+            match socket.sendmmsg(tx_staging) {
+                Ok(0) => break,
+                Ok(num_sent) => {
+                    tx_staging.drain(..num_sent);
+                },
+                Err(e) if e.errno == libc::EAGAIN || e.errno == libc::ENOBUFS => {
+                    trace!(
+                        "flush_tx_staging(): device is busy (staged={:?}): {:?}",
+                        tx_staging.len(),
+                        e
+                    );
+                    break;
+                },
+                Err(e) => {
+                    // The kernel reports an error only for the first packet, so that is the one that it rejected.
+                    tx_staging.remove(0);
+                    *tx_dropped += 1;
+                    warn!(
+                        "flush_tx_staging(): dropped packet (dropped={:?}): {:?}",
+                        *tx_dropped, e
+                    );
+                },
+            }
+        }
+    }
+}
+
+impl PacketIo {
+    fn new_batch(socket: RawSocket) -> Self {
+        Self::Batch {
+            socket,
+            rx_scratch: vec![vec![0; limits::RECVBUF_SIZE_MAX]; MAX_MSGS_PER_CALL],
+            tx_staging: ArrayVec::new(),
+            tx_dropped: 0,
+        }
+    }
 }
 
 //======================================================================================================================
@@ -73,88 +190,119 @@ impl LinuxRuntime {
 //======================================================================================================================
 
 impl MemoryRuntime for LinuxRuntime {
-    fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // TODO: Allocate an array of buffers if requested size is too large for a single buffer.
-
-        if size == 0 {
-            let cause: String = format!("cannot allocate a zero-sized buffer");
-            error!("sgaalloc(): {}", cause);
-            return Err(Fail::new(libc::EINVAL, &cause));
+    fn sgaallocv(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
+        // Always allocate with header space for now even if we do not need it.
+        if let PacketIo::Xdp(ref queues) = *self.io {
+            // Buffers of the UMEM region are sent without a copy.
+            return memory::alloc_sgarray(seglens, |size: usize| -> Result<DemiBuffer, Fail> {
+                match queues.alloc(size, MAX_HEADER_SIZE) {
+                    Some(buf) => Ok(buf),
+                    None => Ok(DemiBuffer::new_with_headroom(size as u16, MAX_HEADER_SIZE as u16)),
+                }
+            });
         }
-
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
+        match self.sga_pools {
+            Some(ref pools) => memory::alloc_sgarray(seglens, |size: usize| -> Result<DemiBuffer, Fail> {
+                pools.alloc(size, MAX_HEADER_SIZE)
+            }),
+            None => memory::alloc_sgarray(seglens, |size: usize| -> Result<DemiBuffer, Fail> {
+                Ok(DemiBuffer::new_with_headroom(size as u16, MAX_HEADER_SIZE as u16))
+            }),
         }
-
-        // Always allocate with header space for now even if we do not need it.
-        let buf: DemiBuffer = DemiBuffer::new_with_headroom(size as u16, MAX_HEADER_SIZE as u16);
-
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
     }
 }
 
 impl Runtime for LinuxRuntime {}
 
 impl PhysicalLayer for LinuxRuntime {
+    /// Stages a packet for the next flush.
     fn transmit(&mut self, pkt: DemiBuffer) -> Result<(), Fail> {
-        // We clone the packet so as to not remove the ethernet header from the outgoing message.
-        let header = Ethernet2Header::parse_and_strip(&mut pkt.clone()).unwrap();
-        let dest_addr_arr: [u8; 6] = header.dst_addr().to_array();
-        let dest_sockaddr: RawSocketAddr = RawSocketAddr::new(self.ifindex, &dest_addr_arr);
-
-        match self.socket.sendto(&pkt, &dest_sockaddr) {
-            Ok(size) if size == pkt.len() => Ok(()),
-            Ok(size) => {
-                let cause = format!(
-                    "Incorrect number of bytes sent: packet_size={:?} sent={:?}",
-                    pkt.len(),
-                    size
-                );
-                warn!("{}", cause);
-                Err(Fail::new(libc::EAGAIN, &cause))
+        match *self.io {
+            PacketIo::Ring { ref mut ring, .. } => {
+                // Once the TX ring is attached, the kernel sends every packet of the socket from there.
+                if !PacketRing::fits(&pkt) {
+                    let cause: String = format!("packet does not fit in a TX frame (len={:?})", pkt.total_len());
+                    warn!("transmit(): {}", cause);
+                    return Err(Fail::new(libc::EMSGSIZE, &cause));
+                }
+                // If the TX ring is full, the kernel has not caught up on the frames that we handed it yet. Ask it again
+                // before giving up.
+                if ring.stage(&pkt) {
+                    return Ok(());
+                }
+                ring.flush()?;
+                if ring.stage(&pkt) {
+                    return Ok(());
+                }
+                let cause: &str = "TX ring is full";
+                warn!("transmit(): {}", cause);
+                Err(Fail::new(libc::EAGAIN, cause))
             },
-            Err(e) => {
-                let cause = "send failed";
-                warn!("transmit(): {} {:?}", cause, e);
-                Err(Fail::new(libc::EIO, &cause))
+            PacketIo::Batch {
+                ref socket,
+                ref mut tx_staging,
+                ref mut tx_dropped,
+                ..
+            } => {
+                if tx_staging.is_full() {
+                    Self::flush_tx_staging(socket, tx_staging, tx_dropped);
+                    if tx_staging.is_full() {
+                        let cause: &str = "TX staging ring is full";
+                        warn!("transmit(): {}", cause);
+                        return Err(Fail::new(libc::EAGAIN, cause));
+                    }
+                }
+                tx_staging.push(pkt);
+                Ok(())
             },
+            PacketIo::Xdp(ref mut queues) => queues.stage(pkt),
         }
     }
 
-    // TODO: This routine currently only tries to receive a single packet buffer, not a batch of them.
+    fn flush(&mut self) -> Result<(), Fail> {
+        match *self.io {
+            PacketIo::Ring { ref mut ring, .. } => ring.flush(),
+            PacketIo::Batch {
+                ref socket,
+                ref mut tx_staging,
+                ref mut tx_dropped,
+                ..
+            } => {
+                Self::flush_tx_staging(socket, tx_staging, tx_dropped);
+                Ok(())
+            },
+            PacketIo::Xdp(ref mut queues) => {
+                queues.flush();
+                Ok(())
+            },
+        }
+    }
+
+    /// Drains up to `recv_batch_size` packets from the interface, stopping early once it has no more data.
     fn receive(&mut self) -> Result<ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>, Fail> {
-        // TODO: This routine contains an extra copy of the entire incoming packet that could potentially be removed.
-
-        // TODO: change this function to operate directly on DemiBuffer rather than on MaybeUninit<u8>.
-
-        // This use-case is an example for MaybeUninit in the docs.
-        let mut out: [MaybeUninit<u8>; limits::RECVBUF_SIZE_MAX] =
-            [unsafe { MaybeUninit::uninit().assume_init() }; limits::RECVBUF_SIZE_MAX];
-        if let Ok((nbytes, _origin_addr)) = self.socket.recvfrom(&mut out[..]) {
-            let mut ret: ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE> = ArrayVec::new();
-            unsafe {
-                let bytes: [u8; limits::RECVBUF_SIZE_MAX] =
-                    mem::transmute::<[MaybeUninit<u8>; limits::RECVBUF_SIZE_MAX], [u8; limits::RECVBUF_SIZE_MAX]>(out);
-                let mut dbuf: DemiBuffer = DemiBuffer::from_slice(&bytes)?;
-                dbuf.trim(limits::RECVBUF_SIZE_MAX - nbytes)?;
-                ret.push(dbuf);
-            }
-            Ok(ret)
-        } else {
-            Ok(ArrayVec::new())
+        let mut ret: ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE> = ArrayVec::new();
+        match *self.io {
+            PacketIo::Ring { ref mut ring, .. } => ring.receive(self.recv_batch_size, &mut ret)?,
+            PacketIo::Batch {
+                ref socket,
+                ref mut rx_scratch,
+                ..
+            } => {
+                // TODO: This routine contains an extra copy of each incoming packet that could potentially be removed.
+                let batch_size: usize = self.recv_batch_size.min(rx_scratch.len());
+                // The socket is non-blocking, so EAGAIN means that there is nothing to receive.
+                match socket.recvmmsg(&mut rx_scratch[..batch_size]) {
+                    Ok(lengths) => {
+                        for (buf, nbytes) in rx_scratch.iter().zip(lengths) {
+                            ret.push(DemiBuffer::from_slice(&buf[..nbytes])?);
+                        }
+                    },
+                    Err(e) if e.errno == libc::EAGAIN => (),
+                    Err(e) => return Err(e),
+                }
+            },
+            PacketIo::Xdp(ref mut queues) => queues.receive(self.recv_batch_size, &mut ret)?,
         }
+        Ok(ret)
     }
 }
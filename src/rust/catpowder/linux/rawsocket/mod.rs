@@ -3,10 +3,12 @@
 
 mod rawsockaddr;
 mod rawsocket;
+mod ring;
 
 //======================================================================================================================
 // Exports
 //======================================================================================================================
 
 pub use rawsockaddr::RawSocketAddr;
-pub use rawsocket::RawSocket;
+pub use rawsocket::{RawSocket, MAX_MSGS_PER_CALL};
+pub use ring::PacketRing;
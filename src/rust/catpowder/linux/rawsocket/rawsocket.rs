@@ -7,16 +7,23 @@
 
 use crate::{
     catpowder::linux::RawSocketAddr,
-    pal::{SockAddrIn, Socklen},
-    runtime::fail::Fail,
+    pal::Socklen,
+    runtime::{fail::Fail, memory::DemiBuffer},
 };
-use ::std::{mem, mem::MaybeUninit};
+use ::arrayvec::ArrayVec;
+use ::std::{mem, ptr};
 use libc::sockaddr;
 
 //======================================================================================================================
 // Constants & Structures
 //======================================================================================================================
 
+/// Maximum number of packets that we move through a raw socket with a single system call.
+pub const MAX_MSGS_PER_CALL: usize = 64;
+
+/// Maximum number of segments of a packet that we send through a raw socket.
+const MAX_SEGMENTS_PER_MSG: usize = 4;
+
 pub struct RawSocket(libc::c_int);
 
 //======================================================================================================================
@@ -53,49 +60,95 @@ impl RawSocket {
         Ok(())
     }
 
-    /// Sends data through a raw socket.
-    pub fn sendto(&self, buf: &[u8], rawaddr: &RawSocketAddr) -> Result<usize, Fail> {
-        let buf_len: usize = buf.len();
-        let buf_ptr: *const libc::c_void = buf.as_ptr() as *const libc::c_void;
-        let (addr_ptr, addrlen): (*const sockaddr, Socklen) = rawaddr.as_sockaddr_ptr();
+    /// Sends up to [MAX_MSGS_PER_CALL] packets through a raw socket with a single system call. The packets go to the
+    /// interface that the socket is bound to. Returns the number of packets that were sent, which the kernel counts
+    /// from the first one.
+    pub fn sendmmsg(&self, pkts: &[DemiBuffer]) -> Result<usize, Fail> {
+        let pkts: &[DemiBuffer] = &pkts[..pkts.len().min(MAX_MSGS_PER_CALL)];
+        let mut iovecs: ArrayVec<[libc::iovec; MAX_SEGMENTS_PER_MSG], MAX_MSGS_PER_CALL> = ArrayVec::new();
+        let mut msgs: ArrayVec<libc::mmsghdr, MAX_MSGS_PER_CALL> = ArrayVec::new();
+        for pkt in pkts {
+            if pkt.num_segments() > MAX_SEGMENTS_PER_MSG {
+                let cause: String = format!("too many segments (num_segments={:?})", pkt.num_segments());
+                warn!("sendmmsg(): {}", cause);
+                return Err(Fail::new(libc::EINVAL, &cause));
+            }
+            let mut iov: [libc::iovec; MAX_SEGMENTS_PER_MSG] = [libc::iovec {
+                iov_base: ptr::null_mut(),
+                iov_len: 0,
+            }; MAX_SEGMENTS_PER_MSG];
+            for (i, segment) in pkt.segments().enumerate() {
+                iov[i] = libc::iovec {
+                    iov_base: segment.as_ptr() as *mut libc::c_void,
+                    iov_len: segment.len(),
+                };
+            }
+            iovecs.push(iov);
+        }
+        for (pkt, iov) in pkts.iter().zip(iovecs.iter_mut()) {
+            let mut msg: libc::mmsghdr = unsafe { mem::zeroed() };
+            msg.msg_hdr.msg_iov = iov.as_mut_ptr();
+            msg.msg_hdr.msg_iovlen = pkt.num_segments();
+            msgs.push(msg);
+        }
 
-        let nbytes: i32 =
-            unsafe { libc::sendto(self.0, buf_ptr, buf_len, libc::MSG_DONTWAIT, addr_ptr, addrlen) as i32 };
+        let nmsgs: i32 = unsafe { libc::sendmmsg(self.0, msgs.as_mut_ptr(), msgs.len() as u32, libc::MSG_DONTWAIT) };
 
-        // Check if we failed to send data through raw socket.
-        if nbytes == -1 {
-            return Err(Fail::new(libc::EAGAIN, "failed to send data through raw socket"));
+        // The kernel only fails the call if it could not send the first packet.
+        if nmsgs == -1 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            let cause: String = format!("failed to send data through raw socket (errno={:?})", errno);
+            trace!("sendmmsg(): {}", cause);
+            return Err(Fail::new(errno, &cause));
         }
 
-        Ok(nbytes as usize)
+        Ok(nmsgs as usize)
     }
 
-    /// Receives data from a raw socket.
-    pub fn recvfrom(&self, buf: &[MaybeUninit<u8>]) -> Result<(usize, RawSocketAddr), Fail> {
-        let buf_ptr: *mut libc::c_void = buf.as_ptr() as *mut libc::c_void;
-        let buf_len: usize = buf.len();
-        let mut addrlen: Socklen = mem::size_of::<SockAddrIn>() as u32;
-        let mut rawaddr: RawSocketAddr = RawSocketAddr::default();
-        let addrlen_ptr: *mut Socklen = &mut addrlen as *mut Socklen;
-        let (addr_ptr, _): (*mut sockaddr, Socklen) = rawaddr.as_sockaddr_mut_ptr();
-
-        let nbytes: i32 = unsafe {
-            libc::recvfrom(
+    /// Receives up to [MAX_MSGS_PER_CALL] packets from a raw socket with a single system call, one into each of the
+    /// buffers. Returns the number of bytes that were received into each of the first buffers.
+    pub fn recvmmsg(&self, bufs: &mut [Vec<u8>]) -> Result<ArrayVec<usize, MAX_MSGS_PER_CALL>, Fail> {
+        let mut iovecs: ArrayVec<libc::iovec, MAX_MSGS_PER_CALL> = ArrayVec::new();
+        let mut msgs: ArrayVec<libc::mmsghdr, MAX_MSGS_PER_CALL> = ArrayVec::new();
+        for buf in bufs.iter_mut().take(MAX_MSGS_PER_CALL) {
+            iovecs.push(libc::iovec {
+                iov_base: buf.as_mut_ptr() as *mut libc::c_void,
+                iov_len: buf.len(),
+            });
+        }
+        for iov in iovecs.iter_mut() {
+            let mut msg: libc::mmsghdr = unsafe { mem::zeroed() };
+            msg.msg_hdr.msg_iov = iov as *mut libc::iovec;
+            msg.msg_hdr.msg_iovlen = 1;
+            msgs.push(msg);
+        }
+
+        let nmsgs: i32 = unsafe {
+            libc::recvmmsg(
                 self.0,
-                buf_ptr,
-                buf_len,
+                msgs.as_mut_ptr(),
+                msgs.len() as u32,
                 libc::MSG_DONTWAIT,
-                addr_ptr,
-                addrlen_ptr as *mut u32,
-            ) as i32
+                ptr::null_mut(),
+            )
         };
 
         // Check if we failed to receive data from raw socket.
-        if nbytes == -1 {
-            return Err(Fail::new(libc::EAGAIN, "failed to receive data from raw socket"));
+        if nmsgs == -1 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            let cause: String = format!("failed to receive data from raw socket (errno={:?})", errno);
+            trace!("recvmmsg(): {}", cause);
+            return Err(Fail::new(errno, &cause));
         }
 
-        Ok((nbytes as usize, rawaddr))
+        Ok(msgs[..nmsgs as usize]
+            .iter()
+            .map(|msg: &libc::mmsghdr| msg.msg_len as usize)
+            .collect())
+    }
+
+    pub fn as_raw_fd(&self) -> libc::c_int {
+        self.0
     }
 }
 
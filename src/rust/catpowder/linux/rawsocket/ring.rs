@@ -0,0 +1,315 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! PACKET_MMAP rings of a raw socket.
+//!
+//! The kernel and us exchange packets through a TPACKET_V3 RX ring and a TX ring that share a single mapping. The RX
+//! ring is made of blocks that the kernel fills with many packets and hands over to us as a whole, so that a full
+//! receive batch costs no system call at all. The TX ring is made of fixed-size frames that we fill and mark as ready,
+//! and a single `sendto()` asks the kernel to send all of them.
+//!
+//! This trades latency for throughput. Under load, blocks fill up quickly and the RX ring saves a system call for every
+//! batch. At low rates, a block is only handed over once its retire timeout expires, so a packet may wait for up to
+//! [RX_RETIRE_BLOCK_TIMEOUT_MS] before we see it. This is why the rings are only used when the configuration asks for
+//! them.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    catpowder::linux::rawsocket::RawSocket,
+    runtime::{fail::Fail, memory::DemiBuffer, network::consts::RECEIVE_BATCH_SIZE},
+};
+use ::arrayvec::ArrayVec;
+use ::std::{
+    mem, ptr,
+    sync::atomic::{AtomicU32, Ordering},
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Size of a block of the RX ring. This must be a multiple of the page size.
+const RX_BLOCK_SIZE: usize = 1 << 18;
+/// Number of blocks in the RX ring.
+const RX_BLOCK_NR: usize = 32;
+/// Nominal frame size of the RX ring. Packets are packed back to back in a block, so this only bounds their size.
+const RX_FRAME_SIZE: usize = 2048;
+/// Milliseconds after which the kernel hands over a block that is not full. This bounds the extra latency that the RX
+/// ring adds to a packet at low rates. It cannot be lower than 1.
+const RX_RETIRE_BLOCK_TIMEOUT_MS: u32 = 1;
+
+/// Size of a block of the TX ring. This must be a multiple of the page size.
+const TX_BLOCK_SIZE: usize = 1 << 16;
+/// Number of blocks in the TX ring.
+const TX_BLOCK_NR: usize = 64;
+/// Size of a frame of the TX ring. This has room for a jumbo Ethernet frame.
+const TX_FRAME_SIZE: usize = 1 << 14;
+/// Number of frames in the TX ring.
+const TX_FRAME_NR: usize = (TX_BLOCK_SIZE / TX_FRAME_SIZE) * TX_BLOCK_NR;
+/// Offset of the packet in a frame of the TX ring, right after the aligned frame header.
+const TX_DATA_OFFSET: usize = libc::TPACKET3_HDRLEN - mem::size_of::<libc::sockaddr_ll>();
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Position in the RX block that we are currently reading.
+struct RxCursor {
+    /// Offset of the next packet, from the start of the block.
+    offset: usize,
+    /// Number of packets left in the block.
+    remaining: u32,
+}
+
+pub struct PacketRing {
+    /// Raw socket that the rings are attached to.
+    sockfd: libc::c_int,
+    /// Start of the mapping. The RX ring comes first and the TX ring follows it.
+    base: *mut u8,
+    /// Index of the RX block that the kernel hands over next.
+    rx_block: usize,
+    /// Position in the RX block that we hold, if any.
+    rx_cursor: Option<RxCursor>,
+    /// Index of the TX frame that we fill next.
+    tx_frame: usize,
+    /// Number of TX frames that we filled since we last asked the kernel to send them.
+    tx_pending: usize,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl PacketRing {
+    /// Attaches a TPACKET_V3 RX ring and TX ring to a raw socket and maps them into our address space.
+    pub fn new(socket: &RawSocket) -> Result<Self, Fail> {
+        let sockfd: libc::c_int = socket.as_raw_fd();
+        Self::setsockopt(
+            sockfd,
+            libc::PACKET_VERSION,
+            &(libc::tpacket_versions::TPACKET_V3 as libc::c_int),
+        )?;
+        // Have the kernel skip malformed TX frames instead of stopping at them.
+        Self::setsockopt(sockfd, libc::PACKET_LOSS, &(1 as libc::c_int))?;
+
+        let rx_req: libc::tpacket_req3 = libc::tpacket_req3 {
+            tp_block_size: RX_BLOCK_SIZE as u32,
+            tp_block_nr: RX_BLOCK_NR as u32,
+            tp_frame_size: RX_FRAME_SIZE as u32,
+            tp_frame_nr: ((RX_BLOCK_SIZE / RX_FRAME_SIZE) * RX_BLOCK_NR) as u32,
+            tp_retire_blk_tov: RX_RETIRE_BLOCK_TIMEOUT_MS,
+            tp_sizeof_priv: 0,
+            tp_feature_req_word: 0,
+        };
+        Self::setsockopt(sockfd, libc::PACKET_RX_RING, &rx_req)?;
+
+        // The kernel rejects TX rings that ask for block timeouts, private areas or features.
+        let tx_req: libc::tpacket_req3 = libc::tpacket_req3 {
+            tp_block_size: TX_BLOCK_SIZE as u32,
+            tp_block_nr: TX_BLOCK_NR as u32,
+            tp_frame_size: TX_FRAME_SIZE as u32,
+            tp_frame_nr: TX_FRAME_NR as u32,
+            tp_retire_blk_tov: 0,
+            tp_sizeof_priv: 0,
+            tp_feature_req_word: 0,
+        };
+        if let Err(e) = Self::setsockopt(sockfd, libc::PACKET_TX_RING, &tx_req) {
+            Self::detach(sockfd);
+            return Err(e);
+        }
+
+        let base: *mut libc::c_void = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                Self::mapping_size(),
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED | libc::MAP_POPULATE,
+                sockfd,
+                0,
+            )
+        };
+        if base == libc::MAP_FAILED {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            let cause: String = format!("failed to map packet rings (errno={:?})", errno);
+            error!("new(): {}", cause);
+            Self::detach(sockfd);
+            return Err(Fail::new(errno, &cause));
+        }
+        trace!("Mapping packet rings of raw socket fd={:?}", sockfd);
+
+        Ok(Self {
+            sockfd,
+            base: base as *mut u8,
+            rx_block: 0,
+            rx_cursor: None,
+            tx_frame: 0,
+            tx_pending: 0,
+        })
+    }
+
+    /// Copies up to `max` packets that the kernel handed over into `out`, stopping early once the RX ring has no more
+    /// packets. Blocks are given back to the kernel as soon as we have read all of their packets.
+    pub fn receive(&mut self, max: usize, out: &mut ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>) -> Result<(), Fail> {
+        while out.len() < max {
+            let block: *mut u8 = unsafe { self.base.add(self.rx_block * RX_BLOCK_SIZE) };
+            let desc: *mut libc::tpacket_block_desc = block as *mut libc::tpacket_block_desc;
+            let cursor: &mut RxCursor = match self.rx_cursor {
+                Some(ref mut cursor) => cursor,
+                None => {
+                    // Safety: the block descriptor lies at the start of the block, which is mapped.
+                    let status: &AtomicU32 = unsafe { Self::status(ptr::addr_of_mut!((*desc).hdr.bh1.block_status)) };
+                    if status.load(Ordering::Acquire) & libc::TP_STATUS_USER == 0 {
+                        break;
+                    }
+                    let (offset, remaining): (u32, u32) =
+                        unsafe { ((*desc).hdr.bh1.offset_to_first_pkt, (*desc).hdr.bh1.num_pkts) };
+                    self.rx_cursor.insert(RxCursor {
+                        offset: offset as usize,
+                        remaining,
+                    })
+                },
+            };
+
+            while cursor.remaining > 0 && out.len() < max {
+                // Safety: the kernel lays out the packets of a block it handed over back to back inside of it.
+                let hdr: &libc::tpacket3_hdr = unsafe { &*(block.add(cursor.offset) as *const libc::tpacket3_hdr) };
+                let bytes: &[u8] = unsafe {
+                    ::std::slice::from_raw_parts(
+                        block.add(cursor.offset + hdr.tp_mac as usize),
+                        hdr.tp_snaplen as usize,
+                    )
+                };
+                cursor.offset += hdr.tp_next_offset as usize;
+                cursor.remaining -= 1;
+                out.push(DemiBuffer::from_slice(bytes)?);
+            }
+
+            if cursor.remaining == 0 {
+                let status: &AtomicU32 = unsafe { Self::status(ptr::addr_of_mut!((*desc).hdr.bh1.block_status)) };
+                status.store(libc::TP_STATUS_KERNEL, Ordering::Release);
+                self.rx_block = (self.rx_block + 1) % RX_BLOCK_NR;
+                self.rx_cursor = None;
+            }
+        }
+        Ok(())
+    }
+
+    /// Checks whether a packet fits in a frame of the TX ring.
+    pub fn fits(pkt: &DemiBuffer) -> bool {
+        TX_DATA_OFFSET + pkt.total_len() <= TX_FRAME_SIZE
+    }
+
+    /// Copies a packet that fits in a frame into the next free frame of the TX ring. Returns false if the kernel has not
+    /// sent that frame yet. The packet goes out on the next [PacketRing::flush].
+    pub fn stage(&mut self, pkt: &DemiBuffer) -> bool {
+        debug_assert!(Self::fits(pkt));
+        let len: usize = pkt.total_len();
+        let frame: *mut u8 = unsafe {
+            self.base
+                .add(RX_BLOCK_SIZE * RX_BLOCK_NR + self.tx_frame * TX_FRAME_SIZE)
+        };
+        let hdr: *mut libc::tpacket3_hdr = frame as *mut libc::tpacket3_hdr;
+        // Safety: the frame header lies at the start of the frame, which is mapped.
+        let status: &AtomicU32 = unsafe { Self::status(ptr::addr_of_mut!((*hdr).tp_status)) };
+        if status.load(Ordering::Acquire) != libc::TP_STATUS_AVAILABLE {
+            return false;
+        }
+
+        let mut offset: usize = TX_DATA_OFFSET;
+        for segment in pkt.segments() {
+            unsafe { ptr::copy_nonoverlapping(segment.as_ptr(), frame.add(offset), segment.len()) };
+            offset += segment.len();
+        }
+        unsafe {
+            (*hdr).tp_len = len as u32;
+            (*hdr).tp_next_offset = 0;
+        }
+        status.store(libc::TP_STATUS_SEND_REQUEST, Ordering::Release);
+
+        self.tx_frame = (self.tx_frame + 1) % TX_FRAME_NR;
+        self.tx_pending += 1;
+        true
+    }
+
+    /// Asks the kernel to send every frame that we filled since the last flush.
+    pub fn flush(&mut self) -> Result<(), Fail> {
+        if self.tx_pending == 0 {
+            return Ok(());
+        }
+
+        let ret: isize = unsafe { libc::sendto(self.sockfd, ptr::null(), 0, libc::MSG_DONTWAIT, ptr::null(), 0) };
+        if ret == -1 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            // The frames stay marked as ready, so the next flush sends them.
+            if errno == libc::EAGAIN || errno == libc::ENOBUFS {
+                trace!("flush(): device is busy (pending={:?})", self.tx_pending);
+                return Ok(());
+            }
+            let cause: String = format!("failed to send packet ring (errno={:?})", errno);
+            warn!("flush(): {}", cause);
+            return Err(Fail::new(libc::EIO, &cause));
+        }
+
+        self.tx_pending = 0;
+        Ok(())
+    }
+
+    /// Takes back the rings from a raw socket that we could not set up completely, so that packets get queued on the
+    /// socket again.
+    fn detach(sockfd: libc::c_int) {
+        let req: libc::tpacket_req3 = unsafe { mem::zeroed() };
+        for name in [libc::PACKET_RX_RING, libc::PACKET_TX_RING] {
+            if let Err(e) = Self::setsockopt(sockfd, name, &req) {
+                warn!("detach(): could not release packet ring (fd={:?}): {:?}", sockfd, e);
+            }
+        }
+    }
+
+    fn mapping_size() -> usize {
+        RX_BLOCK_SIZE * RX_BLOCK_NR + TX_BLOCK_SIZE * TX_BLOCK_NR
+    }
+
+    /// Views a status word that the kernel shares with us as an atomic.
+    unsafe fn status<'a>(word: *mut u32) -> &'a AtomicU32 {
+        &*(word as *const AtomicU32)
+    }
+
+    fn setsockopt<T>(sockfd: libc::c_int, name: libc::c_int, value: &T) -> Result<(), Fail> {
+        let ret: libc::c_int = unsafe {
+            libc::setsockopt(
+                sockfd,
+                libc::SOL_PACKET,
+                name,
+                value as *const T as *const libc::c_void,
+                mem::size_of::<T>() as libc::socklen_t,
+            )
+        };
+        if ret == -1 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            let cause: String = format!(
+                "failed to set packet socket option (name={:?}, errno={:?})",
+                name, errno
+            );
+            warn!("setsockopt(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        Ok(())
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+/// Unmaps the packet rings. The kernel frees them when the raw socket gets closed.
+impl Drop for PacketRing {
+    fn drop(&mut self) {
+        if unsafe { libc::munmap(self.base as *mut libc::c_void, Self::mapping_size()) } != 0 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            warn!("could not unmap packet rings (fd={:?}): {:?}", self.sockfd, errno);
+        }
+    }
+}
@@ -0,0 +1,145 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! AF_XDP sockets, which exchange packets with the driver through rings and a UMEM region that are shared with the
+//! kernel, bypassing the kernel network stack.
+
+mod program;
+mod queue;
+mod ring;
+mod socket;
+mod umem;
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    catpowder::linux::xsk::{program::XdpProgram, queue::XskQueue},
+    runtime::{fail::Fail, memory::DemiBuffer, network::consts::RECEIVE_BATCH_SIZE},
+};
+use ::arrayvec::ArrayVec;
+use ::std::{ffi::CString, mem};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+const SIOCETHTOOL: libc::c_ulong = 0x8946;
+const ETHTOOL_GCHANNELS: u32 = 0x3c;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Channels of an interface (struct ethtool_channels).
+#[repr(C)]
+#[derive(Default)]
+struct EthtoolChannels {
+    cmd: u32,
+    max_rx: u32,
+    max_tx: u32,
+    max_other: u32,
+    max_combined: u32,
+    rx_count: u32,
+    tx_count: u32,
+    other_count: u32,
+    combined_count: u32,
+}
+
+/// AF_XDP sockets on every receive queue of an interface. Packets are sent through the socket of the first queue.
+pub struct XskQueues {
+    /// Declared first so that the program stops redirecting packets before the sockets get closed.
+    _program: XdpProgram,
+    queues: Vec<XskQueue>,
+    /// Queue that the next receive starts from, so that no queue starves the others.
+    next_rx: usize,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl XskQueues {
+    /// Binds a socket to every receive queue of an interface and attaches the program that steers packets to them.
+    pub fn new(ifname: &str, ifindex: u32) -> Result<Self, Fail> {
+        let num_queues: u32 = Self::num_queues(ifname);
+        let program: XdpProgram = XdpProgram::new(ifindex, num_queues)?;
+        let mut queues: Vec<XskQueue> = Vec::with_capacity(num_queues as usize);
+        for queue_id in 0..num_queues {
+            let queue: XskQueue = XskQueue::new(ifindex, queue_id, queue_id == 0, program.is_native())?;
+            program.insert(queue_id, queue.socket().as_raw_fd())?;
+            queues.push(queue);
+        }
+        Ok(Self {
+            _program: program,
+            queues,
+            next_rx: 0,
+        })
+    }
+
+    /// Allocates a buffer that can be sent without a copy, if one of `size` bytes after `headroom` bytes fits in a
+    /// frame and any is free.
+    pub fn alloc(&self, size: usize, headroom: usize) -> Option<DemiBuffer> {
+        self.queues[0].umem().alloc_with_headroom(size, headroom)
+    }
+
+    /// Moves up to `max` received packets to `out`, visiting the queues in turn.
+    pub fn receive(&mut self, max: usize, out: &mut ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>) -> Result<(), Fail> {
+        let num_queues: usize = self.queues.len();
+        for i in 0..num_queues {
+            let remaining: usize = max.saturating_sub(out.len());
+            if remaining == 0 {
+                break;
+            }
+            self.queues[(self.next_rx + i) % num_queues].receive(remaining, out)?;
+        }
+        self.next_rx = (self.next_rx + 1) % num_queues;
+        Ok(())
+    }
+
+    pub fn stage(&mut self, pkt: DemiBuffer) -> Result<(), Fail> {
+        self.queues[0].stage(pkt)
+    }
+
+    pub fn flush(&mut self) {
+        self.queues[0].flush()
+    }
+
+    /// Reads the number of receive queues of an interface. Falls back to a single queue if the driver does not tell.
+    fn num_queues(ifname: &str) -> u32 {
+        let mut channels: EthtoolChannels = EthtoolChannels {
+            cmd: ETHTOOL_GCHANNELS,
+            ..Default::default()
+        };
+        let name: CString = match CString::new(ifname) {
+            Ok(name) => name,
+            Err(_) => return 1,
+        };
+        let mut ifr: libc::ifreq = unsafe { mem::zeroed() };
+        for (dst, src) in ifr
+            .ifr_name
+            .iter_mut()
+            .zip(name.as_bytes().iter().take(libc::IFNAMSIZ - 1))
+        {
+            *dst = *src as libc::c_char;
+        }
+        ifr.ifr_ifru.ifru_data = &mut channels as *mut EthtoolChannels as *mut libc::c_char;
+
+        let sockfd: libc::c_int = unsafe { libc::socket(libc::AF_INET, libc::SOCK_DGRAM | libc::SOCK_CLOEXEC, 0) };
+        if sockfd == -1 {
+            return 1;
+        }
+        let ret: libc::c_int = unsafe { libc::ioctl(sockfd, SIOCETHTOOL as _, &mut ifr as *mut libc::ifreq) };
+        unsafe { libc::close(sockfd) };
+        if ret == -1 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            warn!(
+                "num_queues(): could not read channels of {:?} (errno={:?})",
+                ifname, errno
+            );
+            return 1;
+        }
+        (channels.rx_count + channels.combined_count).max(1)
+    }
+}
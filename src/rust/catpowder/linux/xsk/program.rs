@@ -0,0 +1,272 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! The XDP program that steers the packets of an interface to AF_XDP sockets.
+//!
+//! The program is small enough to be written down as raw eBPF instructions, which spares us from depending on libbpf.
+//! It looks up the socket of the queue that a packet arrived on in an XSKMAP and redirects the packet there, or lets
+//! the packet through to the kernel stack if that queue has no socket.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::fail::Fail;
+use ::std::{ffi::CStr, mem};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+const BPF_MAP_CREATE: libc::c_long = 0;
+const BPF_MAP_UPDATE_ELEM: libc::c_long = 2;
+const BPF_PROG_LOAD: libc::c_long = 5;
+const BPF_LINK_CREATE: libc::c_long = 28;
+
+const BPF_MAP_TYPE_XSKMAP: u32 = 17;
+const BPF_PROG_TYPE_XDP: u32 = 6;
+const BPF_XDP: u32 = 37;
+
+/// Attaches the program in the driver, which is needed for zero-copy sockets.
+pub const XDP_FLAGS_DRV_MODE: u32 = 1 << 2;
+/// Attaches the program in the generic path of the kernel, which works on any interface.
+pub const XDP_FLAGS_SKB_MODE: u32 = 1 << 1;
+
+const XDP_PASS: i32 = 2;
+const BPF_FUNC_REDIRECT_MAP: i32 = 51;
+const BPF_PSEUDO_MAP_FD: u8 = 1;
+/// Offset of the index of the receive queue in the context of an XDP program (struct xdp_md).
+const XDP_MD_RX_QUEUE_INDEX: i16 = 16;
+
+const LICENSE: &CStr = c"Dual MIT/GPL";
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// An eBPF instruction (struct bpf_insn).
+#[repr(C)]
+#[derive(Clone, Copy)]
+struct BpfInsn {
+    code: u8,
+    /// Destination register in the low nibble and source register in the high one.
+    regs: u8,
+    off: i16,
+    imm: i32,
+}
+
+/// Arguments of BPF_MAP_CREATE.
+#[repr(C)]
+#[derive(Default)]
+struct MapCreateAttr {
+    map_type: u32,
+    key_size: u32,
+    value_size: u32,
+    max_entries: u32,
+    map_flags: u32,
+}
+
+/// Arguments of BPF_MAP_UPDATE_ELEM.
+#[repr(C)]
+#[derive(Default)]
+struct MapUpdateAttr {
+    map_fd: u32,
+    _pad: u32,
+    key: u64,
+    value: u64,
+    flags: u64,
+}
+
+/// Arguments of BPF_PROG_LOAD.
+#[repr(C)]
+#[derive(Default)]
+struct ProgLoadAttr {
+    prog_type: u32,
+    insn_cnt: u32,
+    insns: u64,
+    license: u64,
+    log_level: u32,
+    log_size: u32,
+    log_buf: u64,
+    kern_version: u32,
+    prog_flags: u32,
+    prog_name: [u8; 16],
+    prog_ifindex: u32,
+    expected_attach_type: u32,
+}
+
+/// Arguments of BPF_LINK_CREATE.
+#[repr(C)]
+#[derive(Default)]
+struct LinkCreateAttr {
+    prog_fd: u32,
+    target_ifindex: u32,
+    attach_type: u32,
+    flags: u32,
+}
+
+/// An XDP program that is attached to an interface, along with the map of the sockets that it redirects packets to.
+/// The program stays attached until it is dropped.
+pub struct XdpProgram {
+    map_fd: libc::c_int,
+    prog_fd: libc::c_int,
+    link_fd: libc::c_int,
+    /// Whether the program runs in the driver rather than in the generic path of the kernel.
+    native: bool,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl BpfInsn {
+    const fn new(code: u8, dst: u8, src: u8, off: i16, imm: i32) -> Self {
+        Self {
+            code,
+            regs: (src << 4) | dst,
+            off,
+            imm,
+        }
+    }
+}
+
+impl XdpProgram {
+    /// Attaches a program that redirects the packets of up to `num_queues` queues of an interface. The program runs in
+    /// the driver if it supports XDP and in the generic path of the kernel otherwise.
+    pub fn new(ifindex: u32, num_queues: u32) -> Result<Self, Fail> {
+        let map_attr: MapCreateAttr = MapCreateAttr {
+            map_type: BPF_MAP_TYPE_XSKMAP,
+            key_size: mem::size_of::<u32>() as u32,
+            value_size: mem::size_of::<u32>() as u32,
+            max_entries: num_queues,
+            ..Default::default()
+        };
+        let map_fd: libc::c_int = Self::bpf(BPF_MAP_CREATE, &map_attr, "create XSKMAP")?;
+
+        let prog_fd: libc::c_int = match Self::load(map_fd) {
+            Ok(prog_fd) => prog_fd,
+            Err(e) => {
+                unsafe { libc::close(map_fd) };
+                return Err(e);
+            },
+        };
+
+        let mut native: bool = true;
+        let link_fd: libc::c_int = match Self::attach(prog_fd, ifindex, XDP_FLAGS_DRV_MODE) {
+            Ok(link_fd) => link_fd,
+            Err(_) => {
+                native = false;
+                match Self::attach(prog_fd, ifindex, XDP_FLAGS_SKB_MODE) {
+                    Ok(link_fd) => link_fd,
+                    Err(e) => {
+                        unsafe {
+                            libc::close(prog_fd);
+                            libc::close(map_fd);
+                        }
+                        return Err(e);
+                    },
+                }
+            },
+        };
+        trace!("Attached XDP program to interface {:?} (native={:?})", ifindex, native);
+
+        Ok(Self {
+            map_fd,
+            prog_fd,
+            link_fd,
+            native,
+        })
+    }
+
+    /// Has the program redirect the packets of queue `queue_id` to the AF_XDP socket `sockfd`.
+    pub fn insert(&self, queue_id: u32, sockfd: libc::c_int) -> Result<(), Fail> {
+        let key: u32 = queue_id;
+        let value: u32 = sockfd as u32;
+        let attr: MapUpdateAttr = MapUpdateAttr {
+            map_fd: self.map_fd as u32,
+            key: &key as *const u32 as u64,
+            value: &value as *const u32 as u64,
+            ..Default::default()
+        };
+        Self::bpf(BPF_MAP_UPDATE_ELEM, &attr, "insert socket into XSKMAP")?;
+        Ok(())
+    }
+
+    /// Whether the program runs in the driver, so that sockets can be bound in zero-copy mode.
+    pub fn is_native(&self) -> bool {
+        self.native
+    }
+
+    fn load(map_fd: libc::c_int) -> Result<libc::c_int, Fail> {
+        let insns: [BpfInsn; 6] = [
+            // r2 = ctx->rx_queue_index
+            BpfInsn::new(0x61, 2, 1, XDP_MD_RX_QUEUE_INDEX, 0),
+            // r1 = map
+            BpfInsn::new(0x18, 1, BPF_PSEUDO_MAP_FD, 0, map_fd),
+            BpfInsn::new(0, 0, 0, 0, 0),
+            // r3 = XDP_PASS, which is returned if the queue has no socket
+            BpfInsn::new(0xb7, 3, 0, 0, XDP_PASS),
+            // r0 = bpf_redirect_map(r1, r2, r3)
+            BpfInsn::new(0x85, 0, 0, 0, BPF_FUNC_REDIRECT_MAP),
+            // return r0
+            BpfInsn::new(0x95, 0, 0, 0, 0),
+        ];
+        let mut prog_name: [u8; 16] = [0; 16];
+        prog_name[..10].copy_from_slice(b"demikernel");
+        let attr: ProgLoadAttr = ProgLoadAttr {
+            prog_type: BPF_PROG_TYPE_XDP,
+            insn_cnt: insns.len() as u32,
+            insns: insns.as_ptr() as u64,
+            license: LICENSE.as_ptr() as u64,
+            prog_name,
+            expected_attach_type: BPF_XDP,
+            ..Default::default()
+        };
+        Self::bpf(BPF_PROG_LOAD, &attr, "load XDP program")
+    }
+
+    fn attach(prog_fd: libc::c_int, ifindex: u32, flags: u32) -> Result<libc::c_int, Fail> {
+        let attr: LinkCreateAttr = LinkCreateAttr {
+            prog_fd: prog_fd as u32,
+            target_ifindex: ifindex,
+            attach_type: BPF_XDP,
+            flags,
+        };
+        Self::bpf(BPF_LINK_CREATE, &attr, "attach XDP program")
+    }
+
+    /// Issues a bpf() system call and returns the file descriptor that it creates, if any.
+    fn bpf<T>(cmd: libc::c_long, attr: &T, what: &str) -> Result<libc::c_int, Fail> {
+        let ret: libc::c_long = unsafe {
+            libc::syscall(
+                libc::SYS_bpf,
+                cmd,
+                attr as *const T,
+                mem::size_of::<T>() as libc::c_uint,
+            )
+        };
+        if ret < 0 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            let cause: String = format!("failed to {} (errno={:?})", what, errno);
+            warn!("bpf(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        Ok(ret as libc::c_int)
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+/// Detaches the program from the interface.
+impl Drop for XdpProgram {
+    fn drop(&mut self) {
+        for fd in [self.link_fd, self.prog_fd, self.map_fd] {
+            if unsafe { libc::close(fd) } < 0 {
+                let errno: libc::c_int = unsafe { *libc::__errno_location() };
+                warn!("drop(): could not close XDP program (fd={:?}): {:?}", fd, errno);
+            }
+        }
+    }
+}
@@ -0,0 +1,295 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    catpowder::linux::xsk::{
+        ring::XskRing,
+        socket::{
+            XdpDesc, XdpMmapOffsets, XskSocket, XDP_COPY, XDP_PGOFF_RX_RING, XDP_PGOFF_TX_RING, XDP_RX_RING,
+            XDP_TX_RING, XDP_UMEM_COMPLETION_RING, XDP_UMEM_FILL_RING, XDP_UMEM_PGOFF_COMPLETION_RING,
+            XDP_UMEM_PGOFF_FILL_RING, XDP_UMEM_REG, XDP_USE_NEED_WAKEUP, XDP_ZEROCOPY,
+        },
+        umem::{Umem, FRAME_SIZE},
+    },
+    perftools::stats::{self, Counter},
+    runtime::{fail::Fail, memory::DemiBuffer, network::consts::RECEIVE_BATCH_SIZE},
+};
+use ::arrayvec::ArrayVec;
+use ::std::{collections::VecDeque, mem, ptr};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of elements of every ring of a queue.
+const RING_SIZE: u32 = 2048;
+/// Number of frames of the UMEM region of a queue. Half of them are lent to the kernel through the fill ring and the
+/// rest serve packets that we send or hold on to.
+const NUM_FRAMES: usize = 2 * RING_SIZE as usize;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// An AF_XDP socket that is bound to one queue of an interface, along with its rings and UMEM region.
+pub struct XskQueue {
+    // The rings are declared first so that they are unmapped before the socket gets closed, and the UMEM region is
+    // declared last so that the kernel lets go of it before we do.
+    rx: XskRing,
+    fill: XskRing,
+    completion: XskRing,
+    tx: Option<XskRing>,
+    /// Packets that the kernel sends from the TX ring, in order. Each one is kept alive until its completion.
+    tx_inflight: VecDeque<DemiBuffer>,
+    socket: XskSocket,
+    umem: Umem,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl XskQueue {
+    /// Binds a socket to queue `queue_id` of an interface. Only sockets with `transmit` set can send packets. Sockets
+    /// are bound in zero-copy mode if `native` is set and the driver supports it, and in copy mode otherwise.
+    pub fn new(ifindex: u32, queue_id: u32, transmit: bool, native: bool) -> Result<Self, Fail> {
+        let socket: XskSocket = XskSocket::new()?;
+        let mut umem: Umem = Umem::new(NUM_FRAMES)?;
+        socket.setsockopt(XDP_UMEM_REG, &umem.reg())?;
+        socket.setsockopt(XDP_UMEM_FILL_RING, &RING_SIZE)?;
+        socket.setsockopt(XDP_UMEM_COMPLETION_RING, &RING_SIZE)?;
+        socket.setsockopt(XDP_RX_RING, &RING_SIZE)?;
+        if transmit {
+            socket.setsockopt(XDP_TX_RING, &RING_SIZE)?;
+        }
+
+        let offsets: XdpMmapOffsets = socket.mmap_offsets()?;
+        let addr_size: usize = mem::size_of::<u64>();
+        let desc_size: usize = mem::size_of::<XdpDesc>();
+        let mut fill: XskRing = XskRing::new(&socket, &offsets.fr, XDP_UMEM_PGOFF_FILL_RING, RING_SIZE, addr_size)?;
+        let completion: XskRing = XskRing::new(
+            &socket,
+            &offsets.cr,
+            XDP_UMEM_PGOFF_COMPLETION_RING,
+            RING_SIZE,
+            addr_size,
+        )?;
+        let rx: XskRing = XskRing::new(&socket, &offsets.rx, XDP_PGOFF_RX_RING, RING_SIZE, desc_size)?;
+        let tx: Option<XskRing> = match transmit {
+            true => Some(XskRing::new(
+                &socket,
+                &offsets.tx,
+                XDP_PGOFF_TX_RING,
+                RING_SIZE,
+                desc_size,
+            )?),
+            false => None,
+        };
+
+        // The fill ring must hold buffers before the socket is bound, or the first packets get dropped.
+        Self::refill(&mut fill, &mut umem);
+
+        let zerocopy: bool = native
+            && socket
+                .bind(ifindex, queue_id, XDP_ZEROCOPY | XDP_USE_NEED_WAKEUP)
+                .is_ok();
+        if !zerocopy {
+            socket.bind(ifindex, queue_id, XDP_COPY | XDP_USE_NEED_WAKEUP)?;
+        }
+        trace!(
+            "Bound AF_XDP socket to queue {:?} of interface {:?} (zerocopy={:?})",
+            queue_id,
+            ifindex,
+            zerocopy
+        );
+
+        Ok(Self {
+            rx,
+            fill,
+            completion,
+            tx,
+            tx_inflight: VecDeque::new(),
+            socket,
+            umem,
+        })
+    }
+
+    pub fn socket(&self) -> &XskSocket {
+        &self.socket
+    }
+
+    pub fn umem(&self) -> &Umem {
+        &self.umem
+    }
+
+    /// Moves up to `max` received packets to `out`, without copying them.
+    pub fn receive(&mut self, max: usize, out: &mut ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>) -> Result<(), Fail> {
+        let mut idx: u32 = 0;
+        let count: u32 = self
+            .rx
+            .consumer_reserve(max.min(out.remaining_capacity()) as u32, &mut idx);
+        let mut ret: Result<(), Fail> = Ok(());
+        for i in 0..count {
+            // Safety: the kernel produced this descriptor and does not touch it again until we release it.
+            let (addr, len): (u64, usize) = unsafe {
+                let desc: *const XdpDesc = self.rx.get_element(idx.wrapping_add(i)) as *const XdpDesc;
+                (
+                    ptr::read(ptr::addr_of!((*desc).addr)),
+                    ptr::read(ptr::addr_of!((*desc).len)) as usize,
+                )
+            };
+            match self.umem.reclaim(addr, len) {
+                Ok(buf) => out.push(buf),
+                Err(e) => ret = Err(e),
+            }
+        }
+        if count > 0 {
+            self.rx.consumer_release();
+        }
+
+        Self::refill(&mut self.fill, &mut self.umem);
+        if self.fill.needs_wakeup() {
+            self.socket.wakeup_rx();
+        }
+        ret
+    }
+
+    /// Places a packet in the TX ring. Packets that live in the UMEM region are sent as they are and any other packet
+    /// is copied into a free frame. A descriptor only covers a single frame, so chained packets are always copied.
+    pub fn stage(&mut self, pkt: DemiBuffer) -> Result<(), Fail> {
+        let pkt: DemiBuffer = match self.umem.addr_of(&pkt) {
+            Some(_) if !pkt.is_multi_segment() => pkt,
+            _ => self.copy_into_umem(&pkt)?,
+        };
+        // This unwrap will never panic, as the packet lives in the region by now.
+        let addr: u64 = self.umem.addr_of(&pkt).unwrap();
+        debug_assert!(!pkt.is_multi_segment());
+
+        let tx: &mut XskRing = match self.tx {
+            Some(ref mut tx) => tx,
+            None => {
+                let cause: &str = "queue does not send packets";
+                error!("stage(): {}", cause);
+                return Err(Fail::new(libc::EOPNOTSUPP, cause));
+            },
+        };
+        let mut idx: u32 = 0;
+        if tx.producer_reserve(1, &mut idx) == 0 {
+            // The kernel has not caught up on the packets that we handed it yet. Ask it again before giving up.
+            Self::kick(&self.socket, tx);
+            Self::reap_completions(&mut self.completion, &mut self.tx_inflight);
+            if tx.producer_reserve(1, &mut idx) == 0 {
+                let cause: &str = "TX ring is full";
+                warn!("stage(): {}", cause);
+                return Err(Fail::new(libc::EAGAIN, cause));
+            }
+        }
+        // Safety: the descriptor is free, so the kernel does not read it until we submit it.
+        unsafe {
+            ptr::write(
+                tx.get_element(idx) as *mut XdpDesc,
+                XdpDesc {
+                    addr,
+                    len: pkt.len() as u32,
+                    options: 0,
+                },
+            )
+        };
+        tx.producer_submit(1);
+        self.tx_inflight.push_back(pkt);
+        Ok(())
+    }
+
+    /// Asks the kernel to send the packets of the TX ring and releases the packets that it is done with.
+    pub fn flush(&mut self) {
+        if let Some(ref mut tx) = self.tx {
+            Self::kick(&self.socket, tx);
+            Self::reap_completions(&mut self.completion, &mut self.tx_inflight);
+        }
+    }
+
+    /// Copies a packet into a free frame of the UMEM region.
+    fn copy_into_umem(&mut self, pkt: &DemiBuffer) -> Result<DemiBuffer, Fail> {
+        let len: usize = pkt.total_len();
+        let mut buf: DemiBuffer = match self.umem.alloc() {
+            Some(buf) => buf,
+            None => {
+                // Frames come back as the kernel completes the packets that we sent.
+                Self::reap_completions(&mut self.completion, &mut self.tx_inflight);
+                match self.umem.alloc() {
+                    Some(buf) => buf,
+                    None => {
+                        let cause: &str = "no free UMEM frames";
+                        warn!("copy_into_umem(): {}", cause);
+                        stats::count(Counter::MempoolExhausted, 1);
+                        return Err(Fail::new(libc::EAGAIN, cause));
+                    },
+                }
+            },
+        };
+        if len > buf.len() {
+            let cause: String = format!("packet does not fit in a UMEM frame (len={:?})", len);
+            warn!("copy_into_umem(): {}", cause);
+            return Err(Fail::new(libc::EMSGSIZE, &cause));
+        }
+
+        let mut offset: usize = 0;
+        for segment in pkt.segments() {
+            buf[offset..offset + segment.len()].copy_from_slice(segment);
+            offset += segment.len();
+        }
+        let tail: usize = buf.len() - len;
+        buf.trim(tail)?;
+        Ok(buf)
+    }
+
+    /// Tops up the fill ring with free buffers of the UMEM region.
+    fn refill(fill: &mut XskRing, umem: &mut Umem) {
+        let mut idx: u32 = 0;
+        let free: u32 = fill.producer_reserve(RING_SIZE, &mut idx);
+        let mut count: u32 = 0;
+        while count < free {
+            let buf: DemiBuffer = match umem.alloc() {
+                Some(buf) => buf,
+                None => break,
+            };
+            let addr: u64 = umem.lend(buf);
+            // Safety: the element is free, so the kernel does not read it until we submit it.
+            unsafe { ptr::write(fill.get_element(idx.wrapping_add(count)) as *mut u64, addr) };
+            count += 1;
+        }
+        if count > 0 {
+            fill.producer_submit(count);
+        }
+    }
+
+    /// Wakes the kernel up if it waits for us to send the packets of the TX ring.
+    fn kick(socket: &XskSocket, tx: &mut XskRing) {
+        if tx.producer_outstanding() > 0 && tx.needs_wakeup() {
+            socket.wakeup_tx();
+        }
+    }
+
+    /// Releases the packets that the kernel sent. The kernel completes packets in the order that we submitted them.
+    fn reap_completions(completion: &mut XskRing, tx_inflight: &mut VecDeque<DemiBuffer>) {
+        let mut idx: u32 = 0;
+        let count: u32 = completion.consumer_reserve(RING_SIZE, &mut idx);
+        for i in 0..count {
+            let pkt: Option<DemiBuffer> = tx_inflight.pop_front();
+            debug_assert_eq!(
+                pkt.as_ref().map(|pkt| pkt.as_ptr() as usize % FRAME_SIZE),
+                Some(
+                    unsafe { ptr::read(completion.get_element(idx.wrapping_add(i)) as *const u64) } as usize
+                        % FRAME_SIZE
+                )
+            );
+        }
+        if count > 0 {
+            completion.consumer_release();
+        }
+    }
+}
@@ -0,0 +1,142 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    catpowder::linux::xsk::socket::{XdpRingOffset, XskSocket},
+    runtime::fail::Fail,
+};
+use ::std::{
+    ffi::c_void,
+    sync::atomic::{AtomicU32, Ordering},
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Flag that the kernel raises on a ring when it needs a system call to make progress on it.
+const XDP_RING_NEED_WAKEUP: u32 = 1 << 0;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A single-producer single-consumer ring that an AF_XDP socket shares with the kernel. We either produce into the
+/// ring (fill and TX rings) or consume from it (RX and completion rings), never both.
+pub struct XskRing {
+    producer: *const AtomicU32,
+    consumer: *const AtomicU32,
+    flags: *const AtomicU32,
+    elements: *mut u8,
+    element_size: usize,
+    mask: u32,
+    /// Our own index into the ring, which is ahead of the shared one by the elements that we reserved.
+    cached_index: u32,
+    /// The index of the other side, as we last read it.
+    cached_other: u32,
+    map: *mut c_void,
+    map_len: usize,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl XskRing {
+    /// Maps a ring of `size` elements of `element_size` bytes, which lives at `pgoff` in the mappings of `socket`.
+    pub(super) fn new(
+        socket: &XskSocket,
+        offsets: &XdpRingOffset,
+        pgoff: libc::off_t,
+        size: u32,
+        element_size: usize,
+    ) -> Result<Self, Fail> {
+        debug_assert!(size.is_power_of_two());
+        let map_len: usize = offsets.desc as usize + size as usize * element_size;
+        let map: *mut c_void = socket.mmap(map_len, pgoff)?;
+        let at = |offset: u64| -> *mut u8 { unsafe { (map as *mut u8).add(offset as usize) } };
+        Ok(Self {
+            producer: at(offsets.producer) as *const AtomicU32,
+            consumer: at(offsets.consumer) as *const AtomicU32,
+            flags: at(offsets.flags) as *const AtomicU32,
+            elements: at(offsets.desc),
+            element_size,
+            mask: size - 1,
+            cached_index: 0,
+            cached_other: 0,
+            map,
+            map_len,
+        })
+    }
+
+    /// Reserves up to `count` elements that the kernel produced. Returns the number of reserved elements, which start
+    /// at `idx`.
+    pub(super) fn consumer_reserve(&mut self, count: u32, idx: &mut u32) -> u32 {
+        let mut available: u32 = self.cached_other.wrapping_sub(self.cached_index);
+        if available < count {
+            self.cached_other = unsafe { (*self.producer).load(Ordering::Acquire) };
+            available = self.cached_other.wrapping_sub(self.cached_index);
+        }
+        let reserved: u32 = available.min(count);
+        *idx = self.cached_index;
+        self.cached_index = self.cached_index.wrapping_add(reserved);
+        reserved
+    }
+
+    /// Gives the elements that we reserved and read back to the kernel.
+    pub(super) fn consumer_release(&mut self) {
+        unsafe { (*self.consumer).store(self.cached_index, Ordering::Release) };
+    }
+
+    /// Looks for up to `count` free elements to produce into. Returns the number of free elements, which start at
+    /// `idx`. Only the elements that get submitted are taken.
+    pub(super) fn producer_reserve(&mut self, count: u32, idx: &mut u32) -> u32 {
+        let size: u32 = self.mask + 1;
+        let mut free: u32 = size - self.cached_index.wrapping_sub(self.cached_other);
+        if free < count {
+            self.cached_other = unsafe { (*self.consumer).load(Ordering::Acquire) };
+            free = size - self.cached_index.wrapping_sub(self.cached_other);
+        }
+        *idx = self.cached_index;
+        free.min(count)
+    }
+
+    /// Hands the first `count` elements that we reserved and wrote over to the kernel.
+    pub(super) fn producer_submit(&mut self, count: u32) {
+        self.cached_index = self.cached_index.wrapping_add(count);
+        unsafe { (*self.producer).store(self.cached_index, Ordering::Release) };
+    }
+
+    /// Returns the number of elements that we produced and the kernel has not consumed yet.
+    pub(super) fn producer_outstanding(&mut self) -> u32 {
+        self.cached_other = unsafe { (*self.consumer).load(Ordering::Acquire) };
+        self.cached_index.wrapping_sub(self.cached_other)
+    }
+
+    /// Checks whether the kernel waits for a system call to make progress on the ring.
+    pub(super) fn needs_wakeup(&self) -> bool {
+        unsafe { (*self.flags).load(Ordering::Relaxed) & XDP_RING_NEED_WAKEUP != 0 }
+    }
+
+    /// Gets the element at the target index.
+    pub(super) fn get_element(&self, idx: u32) -> *mut c_void {
+        unsafe { self.elements.add((idx & self.mask) as usize * self.element_size) as *mut c_void }
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Drop for XskRing {
+    fn drop(&mut self) {
+        if unsafe { libc::munmap(self.map, self.map_len) } != 0 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            warn!("drop(): failed to unmap ring (errno={:?})", errno);
+        }
+    }
+}
@@ -0,0 +1,251 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::fail::Fail;
+use ::std::{ffi::c_void, mem, ptr};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+const SOL_XDP: libc::c_int = 283;
+
+pub const XDP_MMAP_OFFSETS: libc::c_int = 1;
+pub const XDP_RX_RING: libc::c_int = 2;
+pub const XDP_TX_RING: libc::c_int = 3;
+pub const XDP_UMEM_REG: libc::c_int = 4;
+pub const XDP_UMEM_FILL_RING: libc::c_int = 5;
+pub const XDP_UMEM_COMPLETION_RING: libc::c_int = 6;
+
+pub const XDP_PGOFF_RX_RING: libc::off_t = 0;
+pub const XDP_PGOFF_TX_RING: libc::off_t = 0x80000000;
+pub const XDP_UMEM_PGOFF_FILL_RING: libc::off_t = 0x100000000;
+pub const XDP_UMEM_PGOFF_COMPLETION_RING: libc::off_t = 0x180000000;
+
+pub const XDP_COPY: u16 = 1 << 1;
+pub const XDP_ZEROCOPY: u16 = 1 << 2;
+pub const XDP_USE_NEED_WAKEUP: u16 = 1 << 3;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Registration of a UMEM region (struct xdp_umem_reg).
+#[repr(C)]
+#[derive(Default)]
+pub struct XdpUmemReg {
+    pub addr: u64,
+    pub len: u64,
+    pub chunk_size: u32,
+    pub headroom: u32,
+    pub flags: u32,
+    pub tx_metadata_len: u32,
+}
+
+/// Offsets of the fields of a ring in its mapping (struct xdp_ring_offset).
+#[repr(C)]
+#[derive(Default)]
+pub struct XdpRingOffset {
+    pub producer: u64,
+    pub consumer: u64,
+    pub desc: u64,
+    pub flags: u64,
+}
+
+/// Offsets of the fields of all rings of a socket (struct xdp_mmap_offsets).
+#[repr(C)]
+#[derive(Default)]
+pub struct XdpMmapOffsets {
+    pub rx: XdpRingOffset,
+    pub tx: XdpRingOffset,
+    pub fr: XdpRingOffset,
+    pub cr: XdpRingOffset,
+}
+
+/// Descriptor of a packet in the RX and TX rings (struct xdp_desc).
+#[repr(C)]
+pub struct XdpDesc {
+    pub addr: u64,
+    pub len: u32,
+    pub options: u32,
+}
+
+/// Address that an AF_XDP socket binds to (struct sockaddr_xdp).
+#[repr(C)]
+struct SockAddrXdp {
+    sxdp_family: u16,
+    sxdp_flags: u16,
+    sxdp_ifindex: u32,
+    sxdp_queue_id: u32,
+    sxdp_shared_umem_fd: u32,
+}
+
+/// An AF_XDP socket.
+pub struct XskSocket(libc::c_int);
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl XskSocket {
+    pub fn new() -> Result<Self, Fail> {
+        let sockfd: libc::c_int = unsafe { libc::socket(libc::AF_XDP, libc::SOCK_RAW | libc::SOCK_CLOEXEC, 0) };
+        if sockfd == -1 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            let cause: String = format!("failed to create AF_XDP socket (errno={:?})", errno);
+            error!("new(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        trace!("Creating AF_XDP socket with fd={:?}", sockfd);
+        Ok(Self(sockfd))
+    }
+
+    pub fn setsockopt<T>(&self, name: libc::c_int, value: &T) -> Result<(), Fail> {
+        let ret: libc::c_int = unsafe {
+            libc::setsockopt(
+                self.0,
+                SOL_XDP,
+                name,
+                value as *const T as *const c_void,
+                mem::size_of::<T>() as libc::socklen_t,
+            )
+        };
+        if ret == -1 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            let cause: String = format!(
+                "failed to set AF_XDP socket option (name={:?}, errno={:?})",
+                name, errno
+            );
+            error!("setsockopt(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        Ok(())
+    }
+
+    /// Reads where the fields of the rings of the socket lie in their mappings.
+    pub fn mmap_offsets(&self) -> Result<XdpMmapOffsets, Fail> {
+        let mut offsets: XdpMmapOffsets = XdpMmapOffsets::default();
+        let mut len: libc::socklen_t = mem::size_of::<XdpMmapOffsets>() as libc::socklen_t;
+        let ret: libc::c_int = unsafe {
+            libc::getsockopt(
+                self.0,
+                SOL_XDP,
+                XDP_MMAP_OFFSETS,
+                &mut offsets as *mut XdpMmapOffsets as *mut c_void,
+                &mut len,
+            )
+        };
+        if ret == -1 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            let cause: String = format!("failed to read ring offsets (errno={:?})", errno);
+            error!("mmap_offsets(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        Ok(offsets)
+    }
+
+    /// Maps `len` bytes of the ring that lives at `pgoff`.
+    pub fn mmap(&self, len: usize, pgoff: libc::off_t) -> Result<*mut c_void, Fail> {
+        let map: *mut c_void = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED | libc::MAP_POPULATE,
+                self.0,
+                pgoff,
+            )
+        };
+        if map == libc::MAP_FAILED {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            let cause: String = format!("failed to map ring (pgoff={:#x}, errno={:?})", pgoff, errno);
+            error!("mmap(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        Ok(map)
+    }
+
+    /// Binds the socket to a queue of an interface.
+    pub fn bind(&self, ifindex: u32, queue_id: u32, flags: u16) -> Result<(), Fail> {
+        let addr: SockAddrXdp = SockAddrXdp {
+            sxdp_family: libc::AF_XDP as u16,
+            sxdp_flags: flags,
+            sxdp_ifindex: ifindex,
+            sxdp_queue_id: queue_id,
+            sxdp_shared_umem_fd: 0,
+        };
+        let ret: libc::c_int = unsafe {
+            libc::bind(
+                self.0,
+                &addr as *const SockAddrXdp as *const libc::sockaddr,
+                mem::size_of::<SockAddrXdp>() as libc::socklen_t,
+            )
+        };
+        if ret == -1 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            let cause: String = format!(
+                "failed to bind AF_XDP socket (ifindex={:?}, queue_id={:?}, flags={:#x}, errno={:?})",
+                ifindex, queue_id, flags, errno
+            );
+            warn!("bind(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        Ok(())
+    }
+
+    /// Asks the kernel to pick up buffers from the fill ring.
+    pub fn wakeup_rx(&self) {
+        let ret: isize = unsafe {
+            libc::recvfrom(
+                self.0,
+                ptr::null_mut(),
+                0,
+                libc::MSG_DONTWAIT,
+                ptr::null_mut(),
+                ptr::null_mut(),
+            )
+        };
+        if ret == -1 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            if errno != libc::EAGAIN {
+                warn!("wakeup_rx(): failed to wake up kernel (errno={:?})", errno);
+            }
+        }
+    }
+
+    /// Asks the kernel to send the packets of the TX ring.
+    pub fn wakeup_tx(&self) {
+        let ret: isize = unsafe { libc::sendto(self.0, ptr::null(), 0, libc::MSG_DONTWAIT, ptr::null(), 0) };
+        if ret == -1 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            // The kernel sends packets in bounded batches and tells us to come back for the rest.
+            if errno != libc::EAGAIN && errno != libc::EBUSY && errno != libc::ENOBUFS {
+                warn!("wakeup_tx(): failed to wake up kernel (errno={:?})", errno);
+            }
+        }
+    }
+
+    pub fn as_raw_fd(&self) -> libc::c_int {
+        self.0
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+/// Closes the AF_XDP socket.
+impl Drop for XskSocket {
+    fn drop(&mut self) {
+        if unsafe { libc::close(self.0) } < 0 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            warn!("could not close AF_XDP socket (fd={:?}): {:?}", self.0, errno);
+        } else {
+            trace!("Closing AF_XDP socket fd={:?}", self.0)
+        }
+    }
+}
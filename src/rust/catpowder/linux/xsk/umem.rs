@@ -0,0 +1,181 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    catpowder::linux::xsk::socket::XdpUmemReg,
+    runtime::{
+        fail::Fail,
+        memory::{BufferPool, DemiBuffer, BUFFER_METADATA_SIZE},
+    },
+};
+use ::std::{mem::MaybeUninit, num::NonZeroUsize, ptr, ptr::NonNull};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Size of a frame of the UMEM region. Every frame holds a single buffer of the pool, metadata included.
+pub const FRAME_SIZE: usize = 4096;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A UMEM region, which is the memory that an AF_XDP socket receives packets into and sends packets from. The frames
+/// of the region make up a pool of buffers, so received packets are handed to the network stack as [DemiBuffer]s
+/// without a copy, and buffers of the pool are sent without a copy.
+pub struct Umem {
+    base: NonNull<u8>,
+    len: usize,
+    pool: BufferPool,
+    /// Buffers that the kernel holds to receive packets into, by frame.
+    lent: Vec<Option<NonNull<u8>>>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl Umem {
+    /// Maps a UMEM region of `num_frames` frames and carves the buffers of its pool out of it.
+    pub fn new(num_frames: usize) -> Result<Self, Fail> {
+        let len: usize = num_frames * FRAME_SIZE;
+        let base: *mut libc::c_void = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_PRIVATE | libc::MAP_ANONYMOUS | libc::MAP_POPULATE,
+                -1,
+                0,
+            )
+        };
+        if base == libc::MAP_FAILED {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            let cause: String = format!("failed to map UMEM region (len={:?}, errno={:?})", len, errno);
+            error!("new(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        // This unwrap will never panic, as mmap() does not map anything at address zero.
+        let base: NonNull<u8> = NonNull::new(base as *mut u8).unwrap();
+
+        let pool: BufferPool = match BufferPool::new((FRAME_SIZE - BUFFER_METADATA_SIZE) as u16) {
+            Ok(pool) => pool,
+            Err(e) => {
+                let cause: String = format!("invalid UMEM frame size: {:?}", e);
+                error!("new(): {}", cause);
+                return Err(Fail::new(libc::EINVAL, &cause));
+            },
+        };
+        // Buffers span exactly one frame, so packing them page by page makes every buffer start on a frame.
+        // Safety: the region lives as long as the UMEM, and longer if any of its buffers is still in use.
+        unsafe {
+            pool.pool().populate(
+                NonNull::slice_from_raw_parts(base.cast::<MaybeUninit<u8>>(), len),
+                NonZeroUsize::new(FRAME_SIZE).unwrap(),
+            )?
+        };
+        debug_assert_eq!(pool.pool().len(), num_frames);
+
+        Ok(Self {
+            base,
+            len,
+            pool,
+            lent: vec![None; num_frames],
+        })
+    }
+
+    /// Describes the region for registration with an AF_XDP socket. The kernel places packets after the metadata of
+    /// the buffers.
+    pub fn reg(&self) -> XdpUmemReg {
+        XdpUmemReg {
+            addr: self.base.as_ptr() as u64,
+            len: self.len as u64,
+            chunk_size: FRAME_SIZE as u32,
+            headroom: BUFFER_METADATA_SIZE as u32,
+            ..Default::default()
+        }
+    }
+
+    /// Allocates a buffer of the pool, if any is free.
+    pub fn alloc(&self) -> Option<DemiBuffer> {
+        DemiBuffer::new_in_pool(&self.pool)
+    }
+
+    /// Allocates a buffer of the pool with `size` bytes of data after `headroom` bytes of headroom, if it fits in a
+    /// frame and any is free.
+    pub fn alloc_with_headroom(&self, size: usize, headroom: usize) -> Option<DemiBuffer> {
+        if size + headroom > FRAME_SIZE - BUFFER_METADATA_SIZE {
+            return None;
+        }
+        DemiBuffer::new_in_pool_with_headroom(&self.pool, size as u16, headroom as u16)
+    }
+
+    /// Returns the address, relative to the region, of the data of a buffer that lives in the region.
+    pub fn addr_of(&self, buf: &DemiBuffer) -> Option<u64> {
+        if buf.is_multi_segment() {
+            return None;
+        }
+        let offset: usize = (buf.as_ptr() as usize).wrapping_sub(self.base.as_ptr() as usize);
+        if offset < self.len {
+            Some(offset as u64)
+        } else {
+            None
+        }
+    }
+
+    /// Hands a free buffer of the pool over to the kernel to receive a packet into. Returns the address of its frame.
+    pub fn lend(&mut self, buf: DemiBuffer) -> u64 {
+        // This unwrap will never panic, as buffers of the pool always live in the region.
+        let frame: usize = self.addr_of(&buf).unwrap() as usize / FRAME_SIZE;
+        debug_assert!(self.lent[frame].is_none());
+        self.lent[frame] = Some(buf.into_raw());
+        (frame * FRAME_SIZE) as u64
+    }
+
+    /// Takes back the buffer that the kernel received a packet of `len` bytes into, at address `addr`.
+    pub fn reclaim(&mut self, addr: u64, len: usize) -> Result<DemiBuffer, Fail> {
+        let frame: usize = addr as usize / FRAME_SIZE;
+        let token: NonNull<u8> = match self.lent.get_mut(frame).and_then(Option::take) {
+            Some(token) => token,
+            None => {
+                let cause: String = format!("kernel returned a frame that it does not hold (addr={:#x})", addr);
+                error!("reclaim(): {}", cause);
+                return Err(Fail::new(libc::EFAULT, &cause));
+            },
+        };
+        // Safety: the token comes from a buffer that we handed over to the kernel, and we take it back only once.
+        let mut buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
+        let offset: usize = addr as usize - frame * FRAME_SIZE - BUFFER_METADATA_SIZE;
+        let tail: usize = buf.len() - offset - len;
+        buf.adjust(offset)?;
+        buf.trim(tail)?;
+        Ok(buf)
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Drop for Umem {
+    fn drop(&mut self) {
+        for token in self.lent.iter_mut().filter_map(Option::take) {
+            // Safety: the kernel no longer touches the region once the socket is closed.
+            drop(unsafe { DemiBuffer::from_raw(token) });
+        }
+        // Buffers that are still in use keep pointing into the region, so leak it if there are any.
+        if self.pool.pool().len() < self.len / FRAME_SIZE {
+            warn!("drop(): leaking UMEM region with buffers in use");
+            return;
+        }
+        if unsafe { libc::munmap(self.base.as_ptr() as *mut libc::c_void, self.len) } != 0 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            warn!("drop(): failed to unmap UMEM region (errno={:?})", errno);
+        }
+    }
+}
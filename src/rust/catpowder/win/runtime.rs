@@ -10,20 +10,19 @@ use crate::{
         api::XdpApi,
         ring::{RxRing, TxRing, XdpBuffer},
     },
-    demi_sgarray_t, demi_sgaseg_t,
+    demi_sgarray_t,
     demikernel::config::Config,
     inetstack::protocols::{layer1::PhysicalLayer, MAX_HEADER_SIZE},
     runtime::{
         fail::Fail,
         libxdp,
-        memory::{DemiBuffer, MemoryRuntime},
-        network::consts::RECEIVE_BATCH_SIZE,
+        memory::{self, DemiBuffer, MemoryRuntime, SizeClassPools},
+        network::consts::{DEFAULT_RECEIVE_BATCH_SIZE, RECEIVE_BATCH_SIZE},
         Runtime, SharedObject,
     },
 };
 use ::arrayvec::ArrayVec;
-use ::libc::c_void;
-use ::std::{borrow::BorrowMut, mem};
+use ::std::{borrow::BorrowMut, rc::Rc};
 use windows::Win32::{
     Foundation::ERROR_INSUFFICIENT_BUFFER,
     System::SystemInformation::{
@@ -45,6 +44,10 @@ struct CatpowderRuntimeInner {
     tx: TxRing,
     rx_rings: Vec<RxRing>,
     vf_rx_rings: Vec<RxRing>,
+    /// Maximum number of packets that we pull from the RX rings on every receive.
+    recv_batch_size: usize,
+    /// Pools that scatter-gather arrays are allocated from, if enabled.
+    sga_pools: Option<Rc<SizeClassPools>>,
 }
 //======================================================================================================================
 // Implementations
@@ -63,6 +66,17 @@ impl SharedCatpowderRuntime {
         let ifindex: u32 = config.local_interface_index()?;
         let vf_if_index = config.local_vf_interface_index(); // N.B. this one is optional
 
+        let recv_batch_size: usize = match config.receive_batch_size()? {
+            Some(batch_size) => batch_size,
+            None => {
+                warn!(
+                    "No setting for receive batch size. Using {} by default.",
+                    DEFAULT_RECEIVE_BATCH_SIZE
+                );
+                DEFAULT_RECEIVE_BATCH_SIZE
+            },
+        };
+
         trace!("Creating XDP runtime.");
         let mut api: XdpApi = XdpApi::new()?;
 
@@ -94,6 +108,8 @@ impl SharedCatpowderRuntime {
                 tx,
                 rx_rings,
                 vf_rx_rings,
+                recv_batch_size,
+                sga_pools: SizeClassPools::from_config(config)?,
             })))
         } else {
             Ok(Self(SharedObject::new(CatpowderRuntimeInner {
@@ -101,6 +117,8 @@ impl SharedCatpowderRuntime {
                 tx,
                 rx_rings,
                 vf_rx_rings: Vec::new(),
+                recv_batch_size,
+                sga_pools: SizeClassPools::from_config(config)?,
             })))
         }
     }
@@ -161,8 +179,12 @@ impl PhysicalLayer for SharedCatpowderRuntime {
     fn receive(&mut self) -> Result<ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>, Fail> {
         let mut ret: ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE> = ArrayVec::new();
         let mut idx: u32 = 0;
+        let recv_batch_size: usize = self.0.recv_batch_size;
 
         for rx in self.0.borrow_mut().rx_rings.iter_mut() {
+            if ret.len() >= recv_batch_size {
+                break;
+            }
             if rx.reserve_rx(Self::RING_LENGTH, &mut idx) == Self::RING_LENGTH {
                 let xdp_buffer: XdpBuffer = rx.get_buffer(idx);
                 let dbuf: DemiBuffer = DemiBuffer::from_slice(&*xdp_buffer)?;
@@ -174,14 +196,13 @@ impl PhysicalLayer for SharedCatpowderRuntime {
                 // NB for now there is only ever one element in the fill ring, so we don't have to
                 // change the ring contents.
                 rx.submit_rx_fill(Self::RING_LENGTH);
-
-                if ret.is_full() {
-                    break;
-                }
             }
         }
 
         for rx in self.0.borrow_mut().vf_rx_rings.iter_mut() {
+            if ret.len() >= recv_batch_size {
+                break;
+            }
             if rx.reserve_rx(Self::RING_LENGTH, &mut idx) == Self::RING_LENGTH {
                 let xdp_buffer: XdpBuffer = rx.get_buffer(idx);
                 let dbuf: DemiBuffer = DemiBuffer::from_slice(&*xdp_buffer)?;
@@ -193,10 +214,6 @@ impl PhysicalLayer for SharedCatpowderRuntime {
                 // NB for now there is only ever one element in the fill ring, so we don't have to
                 // change the ring contents.
                 rx.submit_rx_fill(Self::RING_LENGTH);
-
-                if ret.is_full() {
-                    break;
-                }
             }
         }
 
@@ -295,39 +312,16 @@ fn deduce_rss_settings(api: &mut XdpApi, ifindex: u32) -> Result<u32, Fail> {
 /// Memory runtime trait implementation for XDP Runtime.
 impl MemoryRuntime for SharedCatpowderRuntime {
     /// Allocates a scatter-gather array.
-    fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // TODO: Allocate an array of buffers if requested size is too large for a single buffer.
-
-        // We can't allocate a zero-sized buffer.
-        if size == 0 {
-            let cause: String = format!("cannot allocate a zero-sized buffer");
-            error!("sgaalloc(): {}", cause);
-            return Err(Fail::new(libc::EINVAL, &cause));
-        }
-
-        // We can't allocate more than a single buffer.
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
-        }
-
-        // First allocate the underlying DemiBuffer.
+    fn sgaallocv(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
         // Always allocate with header space for now even if we do not need it.
-        let buf: DemiBuffer = DemiBuffer::new_with_headroom(size as u16, MAX_HEADER_SIZE as u16);
-
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+        match self.0.sga_pools {
+            Some(ref pools) => memory::alloc_sgarray(seglens, |size: usize| -> Result<DemiBuffer, Fail> {
+                pools.alloc(size, MAX_HEADER_SIZE)
+            }),
+            None => memory::alloc_sgarray(seglens, |size: usize| -> Result<DemiBuffer, Fail> {
+                Ok(DemiBuffer::new_with_headroom(size as u16, MAX_HEADER_SIZE as u16))
+            }),
+        }
     }
 }
 
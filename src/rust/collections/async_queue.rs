@@ -31,6 +31,8 @@ const DEFAULT_QUEUE_SIZE: usize = 1024;
 pub struct AsyncQueue<T> {
     queue: VecDeque<T>,
     cond_var: SharedConditionVariable,
+    /// Number of items that the queue makes room for when the first one is pushed to it.
+    lazy_capacity: usize,
 }
 
 pub struct SharedAsyncQueue<T>(SharedObject<AsyncQueue<T>>);
@@ -46,21 +48,41 @@ impl<T> AsyncQueue<T> {
         Self {
             queue: VecDeque::<T>::with_capacity(size),
             cond_var: SharedConditionVariable::default(),
+            lazy_capacity: 0,
+        }
+    }
+
+    /// This function creates an async queue that takes no memory until the first item is pushed to it, and then makes
+    /// room for `size` items at once. This suits queues of which many are created but few are used.
+    pub fn with_lazy_capacity(size: usize) -> Self {
+        Self {
+            queue: VecDeque::<T>::new(),
+            cond_var: SharedConditionVariable::default(),
+            lazy_capacity: size,
         }
     }
 
     /// Push to a async queue. Currently async queues are unbounded, so we can synchronously push to them but we will
     /// add bounds checking in the future.
     pub fn push(&mut self, item: T) {
+        self.reserve_lazily();
         self.queue.push_back(item);
         self.cond_var.signal();
     }
 
     pub fn push_front(&mut self, item: T) {
+        self.reserve_lazily();
         self.queue.push_front(item);
         self.cond_var.signal();
     }
 
+    /// Makes room for the lazy capacity of the queue, if nothing was ever pushed to it.
+    fn reserve_lazily(&mut self) {
+        if self.queue.capacity() == 0 {
+            self.queue.reserve(self.lazy_capacity);
+        }
+    }
+
     /// Pop from an async queue. If the queue is empty, this function blocks until it finds something in the queue.
     pub async fn pop(&mut self, timeout: Option<Duration>) -> Result<T, Fail> {
         let wait_condition = async {
@@ -123,6 +145,11 @@ impl<T> SharedAsyncQueue<T> {
     pub fn with_capacity(size: usize) -> Self {
         Self(SharedObject::<AsyncQueue<T>>::new(AsyncQueue::with_capacity(size)))
     }
+
+    /// This function creates a shared async queue that takes no memory until the first item is pushed to it.
+    pub fn with_lazy_capacity(size: usize) -> Self {
+        Self(SharedObject::<AsyncQueue<T>>::new(AsyncQueue::with_lazy_capacity(size)))
+    }
 }
 
 //======================================================================================================================
@@ -134,6 +161,7 @@ impl<T> Default for AsyncQueue<T> {
         Self {
             queue: VecDeque::<T>::with_capacity(DEFAULT_QUEUE_SIZE),
             cond_var: SharedConditionVariable::default(),
+            lazy_capacity: 0,
         }
     }
 }
@@ -107,6 +107,11 @@ impl ConcurrentRingBuffer {
         self.buffer.capacity()
     }
 
+    /// Returns the length in bytes of the largest message that fits in the target ring buffer.
+    pub fn max_message_len(&self) -> usize {
+        (self.capacity().saturating_sub(2 * HEADER_SIZE)).min((1 << (8 * HEADER_SIZE)) - 1)
+    }
+
     #[allow(unused)]
     pub fn remaining_capacity(&self) -> usize {
         timer!("collections::concurrent_ring::remaining_capacity");
@@ -238,14 +243,27 @@ impl ConcurrentRingBuffer {
         }
     }
 
-    /// Atomically writes a header at the indicated offset and returns the previous one.
+    /// Returns the length of the next message in the ring buffer without removing it, or `None` if there is none.
+    pub fn peek_len(&self) -> Option<usize> {
+        timer!("collections::concurrent_ring::peek_len");
+        match self.header(peek(self.pop_offset)).load(atomic::Ordering::Acquire) {
+            0 => None,
+            len => Some(len as usize),
+        }
+    }
+
+    /// Atomically writes a header at the indicated offset and returns the previous one. Writing a header publishes the
+    /// payload that was copied before it and reading it acquires that payload, even across processes.
     fn write_header(&self, offset: usize, val: usize) -> usize {
         timer!("collections::concurrent_ring::write_header");
+        self.header(offset).swap(val as u16, atomic::Ordering::AcqRel) as usize
+    }
+
+    fn header(&self, offset: usize) -> &AtomicU16 {
         assert!(offset % 2 == 0);
         let buffer_ptr: *mut u8 = unsafe { self.buffer.get_mut() }.as_mut_ptr();
         let header_ptr: *mut u16 = unsafe { buffer_ptr.add(offset) } as *mut u16;
-        let header: &AtomicU16 = unsafe { &*header_ptr.cast() };
-        header.swap(val as u16, atomic::Ordering::Relaxed) as usize
+        unsafe { &*header_ptr.cast() }
     }
 
     /// Given a [push_offset] and [pop_offset] into the ring buffer, return available space for writing data. Always
@@ -298,8 +316,7 @@ impl ConcurrentRingBuffer {
     }
 
     /// Peeks the target ring buffer and checks if it is empty.
-    #[cfg(test)]
-    fn is_empty(&self) -> bool {
+    pub fn is_empty(&self) -> bool {
         let push_offset: usize = peek(self.push_offset);
         let pop_offset: usize = peek(self.pop_offset);
         pop_offset == push_offset
@@ -374,8 +391,10 @@ impl Ring for ConcurrentRingBuffer {
             buffer: raw_array::RawArray::<u8>::from_raw_parts(buffer_ptr, capacity - size_of_ring)?,
             is_managed: false,
         };
-        // Intialize the header to 0.
-        me.write_header(0, 0);
+        // Intialize the header to 0, unless the ring buffer already holds messages.
+        if init {
+            me.write_header(0, 0);
+        }
         Ok(me)
     }
 }
@@ -389,10 +408,11 @@ fn peek(ptr: *mut usize) -> usize {
     ptr.load(atomic::Ordering::Relaxed)
 }
 
-/// Compares and increments the value at [ptr] only if it has not changed since the last time we read it.
+/// Compares and increments the value at [ptr] only if it has not changed since the last time we read it. This must not
+/// fail spuriously, because releasing space expects it to succeed.
 fn check_and_set(ptr: *mut usize, current: usize, new: usize) -> Result<usize, usize> {
     let ptr: &AtomicUsize = unsafe { &*ptr.cast() };
-    ptr.compare_exchange_weak(current, new, atomic::Ordering::Acquire, atomic::Ordering::Relaxed)
+    ptr.compare_exchange(current, new, atomic::Ordering::AcqRel, atomic::Ordering::Relaxed)
 }
 
 /// Align to [HEADER_SIZE] for the header offset.
@@ -607,6 +627,21 @@ mod test {
         Ok(())
     }
 
+    /// Tests if the largest message that is said to fit in an empty ring buffer does, and if a larger one does not.
+    #[test]
+    fn try_push_max_message_len() -> Result<()> {
+        let ring: ConcurrentRingBuffer = do_new()?;
+        let max_len: usize = ring.max_message_len();
+
+        let too_large: Vec<u8> = vec![0xff; max_len + 1];
+        crate::ensure_eq!(ring.try_push(&too_large).is_err(), true);
+
+        let largest: Vec<u8> = vec![0xff; max_len];
+        crate::ensure_eq!(ring.try_push(&largest)?, max_len);
+
+        Ok(())
+    }
+
     #[test]
     fn try_pop_invalid() -> Result<()> {
         let ring: ConcurrentRingBuffer = do_new()?;
@@ -3,7 +3,13 @@
 
 pub mod async_queue;
 pub mod async_value;
+pub mod concurrent_ring;
 pub mod hashttlcache;
 pub mod id_map;
 pub mod intrusive;
 pub mod pin_slab;
+pub mod raw_array;
+pub mod ring;
+#[cfg(target_os = "linux")]
+pub mod shared_ring;
+pub mod timing_wheel;
@@ -1,8 +1,6 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT license.
 
-// TODO: Remove allowances on this module.
-
 //======================================================================================================================
 // Imports
 //======================================================================================================================
@@ -147,7 +145,6 @@ where
     }
 
     /// Returns the effective capacity of the target ring buffer.
-    #[allow(unused)]
     pub fn capacity(&self) -> S {
         timer!("collections::ring::capacity");
         // Safety: capacity fits in S, as validated during construction.
@@ -191,6 +188,12 @@ where
         (RingProducer::new(self), RingConsumer::new(self))
     }
 
+    /// Opens the ring buffer for production only. This is for rings whose consumer lives elsewhere, for instance in
+    /// another process or in application code that reads the shared memory directly.
+    pub fn producer<'a>(&'a self) -> RingProducer<'a, T, S> {
+        RingProducer::new(self)
+    }
+
     /// Atomically load and acquire the `front` index.
     fn get_front(&self) -> S {
         timer!("collections::ring::get_front");
@@ -211,7 +214,6 @@ where
     }
 
     /// Atomically store and release the `back` index.
-    #[allow(unused)]
     fn set_back(&self, val: S) {
         timer!("collections::ring::set_back");
         S::atomic_store_release(unsafe { &mut *self.back_ptr }, val);
@@ -229,7 +231,6 @@ where
 
     /// Create a mutable slice from the underlying ring buffer according to the bounds in `range`. Does not perform
     /// any bounds checking.
-    #[allow(unused)]
     unsafe fn get_unchecked_mut_slice<'a>(&'a self, range: Range<usize>) -> &'a mut [T] {
         // Safety: The underlying array must be made valid/available by the RingBuffer constructor.
         let arr: &mut [T] = unsafe { self.buffer.get_mut() };
@@ -244,7 +245,6 @@ where
     S: IntSize,
 {
     /// Creates a ring producer.
-    #[allow(unused)]
     fn new(ring: &'a RingBuffer<T, S>) -> RingProducer<'a, T, S> {
         let mut ret: Self = Self {
             ring,
@@ -260,21 +260,18 @@ where
     }
 
     /// Get the number of free elements in the ring based on the cached state from the previous ring synchronization.
-    #[allow(unused)]
     pub fn get_ready_count(&self) -> S {
         self.cached_front - self.cached_back
     }
 
     /// Synchronize with the underlying ring buffer and get the number of free elements in the ring. This is similar to
     /// get_ready_count, except that it first synchronizes state with the underlying RingBuffer.
-    #[allow(unused)]
     pub fn sync_get_ready_count(&mut self) -> S {
         self.sync();
         self.get_ready_count()
     }
 
     /// Validate that a reservation of `count` elements is valid.
-    #[allow(unused)]
     fn validate_enqueue(&mut self, count: S) -> Result<(), Fail> {
         // NB cached_front is advanced by buf.capacity() so we only add it when we reload the cached value
         if self.get_ready_count() >= count || self.sync_get_ready_count() >= count {
@@ -286,7 +283,6 @@ where
 
     /// Start an enqueue operation, consuming self and returning a new RingEnqueue. If there are not enough free slots
     /// in the ring buffer to enqueue `count` `T`'s, the operation will return an error.
-    #[allow(unused)]
     pub fn try_enqueue(&mut self, val: T) -> Result<(), Fail> {
         self.validate_enqueue(S::from(1u8))?;
 
@@ -462,7 +458,7 @@ where
         let back_ptr: *mut S = ptr as *mut S;
         unsafe { ptr = ptr.add(size_of_s) };
         let buffer_ptr: *mut u8 = {
-            let padding: usize = ptr.align_offset(size_of_t);
+            let padding: usize = ptr.align_offset(mem::align_of::<T>());
             size_of_ring += padding;
             unsafe { ptr.add(padding) }
         };
@@ -42,6 +42,20 @@ impl<T: Ring> SharedRingBuffer<T> {
         let ring: T = T::from_raw_parts(false, shm.as_mut_ptr(), shm.len())?;
         Ok(SharedRingBuffer { shm, ring })
     }
+
+    /// Same as [create](Self::create), but the ring buffer lives on hugepages.
+    pub fn create_on_hugepages(name: &str, capacity: usize) -> Result<Self, Fail> {
+        let mut shm: SharedMemory = SharedMemory::create_on_hugepages(&name, capacity)?;
+        let ring: T = T::from_raw_parts(true, shm.as_mut_ptr(), shm.len())?;
+        Ok(SharedRingBuffer { shm, ring })
+    }
+
+    /// Same as [open](Self::open), for ring buffers created by [create_on_hugepages](Self::create_on_hugepages).
+    pub fn open_on_hugepages(name: &str, capacity: usize) -> Result<Self, Fail> {
+        let mut shm: SharedMemory = SharedMemory::open_on_hugepages(&name, capacity)?;
+        let ring: T = T::from_raw_parts(false, shm.as_mut_ptr(), shm.len())?;
+        Ok(SharedRingBuffer { shm, ring })
+    }
 }
 
 //======================================================================================================================
@@ -0,0 +1,336 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Hierarchical timing wheel.
+//!
+//! The wheel has [NUM_LEVELS] levels of [NUM_SLOTS] slots each. A slot at level `l` spans `NUM_SLOTS^l` ticks, so a
+//! level spans as many ticks as a single slot in the level above it. An entry is stored in the lowest level whose
+//! slots tell its deadline apart from the current time, which takes O(1). Every slot is a doubly-linked list threaded
+//! through a slab, so an entry is removed in O(1) too, and its memory is reclaimed right away. As time advances, the
+//! wheel jumps straight to the next occupied slot with the help of a per-level occupancy bitmap. Entries in a slot that
+//! is reached are either expired or cascade down to a lower level, which happens at most once per level.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use ::slab::Slab;
+use ::std::mem;
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of bits of a deadline that index into a level.
+const SLOT_BITS: usize = 6;
+
+/// Number of slots in a level. This matches the width of the occupancy bitmap.
+const NUM_SLOTS: usize = 1 << SLOT_BITS;
+
+/// Number of levels, which is enough to hold any 64-bit deadline.
+const NUM_LEVELS: usize = u64::BITS as usize / SLOT_BITS + 1;
+
+/// Marks the end of a list.
+const NIL: u32 = u32::MAX;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// An entry at some slot of the wheel.
+struct Entry<T> {
+    /// Expiration time, in ticks.
+    deadline: u64,
+    /// Previous entry in the slot.
+    prev: u32,
+    /// Next entry in the slot.
+    next: u32,
+    /// Level of the slot.
+    level: u8,
+    /// Index of the slot in its level.
+    slot: u8,
+    value: T,
+}
+
+/// A level of the wheel.
+struct Level {
+    /// Bit `i` is set if slot `i` holds any entry.
+    occupied: u64,
+    /// First entry of every slot.
+    heads: [u32; NUM_SLOTS],
+}
+
+/// A hierarchical timing wheel that holds values of type `T` until their deadline.
+pub struct TimingWheel<T> {
+    /// Current time, in ticks. All deadlines before it have expired.
+    elapsed: u64,
+    levels: [Level; NUM_LEVELS],
+    entries: Slab<Entry<T>>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl<T> TimingWheel<T> {
+    pub fn new() -> Self {
+        Self {
+            elapsed: 0,
+            levels: ::std::array::from_fn(|_| Level {
+                occupied: 0,
+                heads: [NIL; NUM_SLOTS],
+            }),
+            entries: Slab::new(),
+        }
+    }
+
+    /// Returns the current time, in ticks.
+    pub fn elapsed(&self) -> u64 {
+        self.elapsed
+    }
+
+    /// Returns the number of entries in the wheel.
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    /// Checks if the wheel holds no entries.
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+
+    /// Returns the number of bytes that the wheel takes in memory, leaving out the bookkeeping of the slab.
+    pub fn footprint(&self) -> usize {
+        mem::size_of::<Self>() + self.entries.capacity() * mem::size_of::<Entry<T>>()
+    }
+
+    /// Returns a time that is not after the earliest deadline in the wheel, if there is any. The time is exact when the
+    /// earliest deadline is less than [NUM_SLOTS] ticks away.
+    pub fn next_deadline(&self) -> Option<u64> {
+        self.next_occupied_slot().map(|(_, _, start)| start)
+    }
+
+    /// Adds `value` to the wheel until `deadline` and returns a key to it. A deadline that is not after the current
+    /// time expires on the next call to [Self::advance].
+    pub fn insert(&mut self, deadline: u64, value: T) -> usize {
+        let key: usize = self.entries.insert(Entry {
+            deadline,
+            prev: NIL,
+            next: NIL,
+            level: 0,
+            slot: 0,
+            value,
+        });
+        debug_assert!(key < NIL as usize);
+        self.link(key as u32);
+        key
+    }
+
+    /// Returns the value that is stored under `key`, if any.
+    pub fn get(&self, key: usize) -> Option<&T> {
+        self.entries.get(key).map(|entry: &Entry<T>| &entry.value)
+    }
+
+    /// Removes the value that is stored under `key` from the wheel and returns it, if any.
+    pub fn remove(&mut self, key: usize) -> Option<T> {
+        if !self.entries.contains(key) {
+            return None;
+        }
+        self.unlink(key as u32);
+        Some(self.entries.remove(key).value)
+    }
+
+    /// Removes all values from the wheel and moves the current time to `now`.
+    pub fn reset(&mut self, now: u64) {
+        for level in self.levels.iter_mut() {
+            level.occupied = 0;
+            level.heads = [NIL; NUM_SLOTS];
+        }
+        self.entries.clear();
+        self.elapsed = now;
+    }
+
+    /// Moves the current time forward to `now` and hands every value whose deadline is not after it to `expire`.
+    pub fn advance<F: FnMut(T)>(&mut self, now: u64, mut expire: F) {
+        debug_assert!(self.elapsed <= now);
+        while let Some((level, slot, start)) = self.next_occupied_slot() {
+            if start > now {
+                break;
+            }
+            self.elapsed = start;
+
+            // Take the whole slot and sort its entries out: they either expire or cascade down to a lower level.
+            let mut cursor: u32 = self.levels[level].heads[slot];
+            self.levels[level].heads[slot] = NIL;
+            self.levels[level].occupied &= !(1 << slot);
+            while cursor != NIL {
+                let key: usize = cursor as usize;
+                cursor = self.entries[key].next;
+                if self.entries[key].deadline <= now {
+                    expire(self.entries.remove(key).value);
+                } else {
+                    self.link(key as u32);
+                }
+            }
+        }
+        self.elapsed = now;
+    }
+
+    /// Finds the earliest slot that holds any entry and returns its level, its index and the time at which it starts.
+    /// Entries at a level have later deadlines than all entries at the levels below it, so the first level with any
+    /// entry has the earliest slot.
+    fn next_occupied_slot(&self) -> Option<(usize, usize, u64)> {
+        for (level_index, level) in self.levels.iter().enumerate() {
+            if level.occupied == 0 {
+                continue;
+            }
+            let shift: usize = level_index * SLOT_BITS;
+            let current: usize = ((self.elapsed >> shift) as usize) & (NUM_SLOTS - 1);
+            // Entries are linked relative to a time that is not after the current one and not after their deadlines,
+            // so no slot before the current one is occupied.
+            debug_assert_eq!(level.occupied & ((1 << current) - 1), 0);
+            let slot: usize = level.occupied.trailing_zeros() as usize;
+            // The topmost level spans all time.
+            let level_mask: u64 = u64::MAX.checked_shl((shift + SLOT_BITS) as u32).unwrap_or(0);
+            let start: u64 = (self.elapsed & level_mask) + ((slot as u64) << shift);
+            return Some((level_index, slot, start));
+        }
+        None
+    }
+
+    /// Adds the entry at `key` to the slot that matches its deadline.
+    fn link(&mut self, key: u32) {
+        let deadline: u64 = self.entries[key as usize].deadline.max(self.elapsed);
+        // The level is given by the highest group of bits in which the deadline and the current time differ.
+        let differing: u64 = (self.elapsed ^ deadline) | (NUM_SLOTS as u64 - 1);
+        let level: usize = (u64::BITS - 1 - differing.leading_zeros()) as usize / SLOT_BITS;
+        let slot: usize = ((deadline >> (level * SLOT_BITS)) as usize) & (NUM_SLOTS - 1);
+
+        let head: u32 = self.levels[level].heads[slot];
+        if head != NIL {
+            self.entries[head as usize].prev = key;
+        }
+        let entry: &mut Entry<T> = &mut self.entries[key as usize];
+        entry.prev = NIL;
+        entry.next = head;
+        entry.level = level as u8;
+        entry.slot = slot as u8;
+        self.levels[level].heads[slot] = key;
+        self.levels[level].occupied |= 1 << slot;
+    }
+
+    /// Removes the entry at `key` from its slot.
+    fn unlink(&mut self, key: u32) {
+        let (prev, next, level, slot): (u32, u32, usize, usize) = {
+            let entry: &Entry<T> = &self.entries[key as usize];
+            (entry.prev, entry.next, entry.level as usize, entry.slot as usize)
+        };
+        if next != NIL {
+            self.entries[next as usize].prev = prev;
+        }
+        if prev != NIL {
+            self.entries[prev as usize].next = next;
+        } else {
+            self.levels[level].heads[slot] = next;
+            if next == NIL {
+                self.levels[level].occupied &= !(1 << slot);
+            }
+        }
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl<T> Default for TimingWheel<T> {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::collections::timing_wheel::TimingWheel;
+    use ::anyhow::Result;
+    use ::rand::Rng;
+
+    /// Advances `wheel` to `now` and returns the values that expired, in ascending order.
+    fn advance(wheel: &mut TimingWheel<u64>, now: u64) -> Vec<u64> {
+        let mut expired: Vec<u64> = Vec::new();
+        wheel.advance(now, |value: u64| expired.push(value));
+        expired.sort();
+        expired
+    }
+
+    /// Checks that values expire exactly at their deadlines, across all levels.
+    #[test]
+    fn test_timing_wheel_expires_at_deadline() -> Result<()> {
+        let mut wheel: TimingWheel<u64> = TimingWheel::new();
+        let deadlines: [u64; 6] = [0, 1, 63, 64, 4097, 1 << 40];
+        for deadline in deadlines {
+            wheel.insert(deadline, deadline);
+        }
+
+        crate::ensure_eq!(advance(&mut wheel, 0), vec![0]);
+        crate::ensure_eq!(advance(&mut wheel, 62), vec![1]);
+        crate::ensure_eq!(advance(&mut wheel, 64), vec![63, 64]);
+        crate::ensure_eq!(advance(&mut wheel, 4096), Vec::<u64>::new());
+        crate::ensure_eq!(advance(&mut wheel, 4097), vec![4097]);
+        crate::ensure_eq!(advance(&mut wheel, (1 << 40) - 1), Vec::<u64>::new());
+        crate::ensure_eq!(advance(&mut wheel, u64::MAX), vec![1 << 40]);
+        crate::ensure_eq!(wheel.is_empty(), true);
+
+        Ok(())
+    }
+
+    /// Checks that removed values never expire and that their keys are reused.
+    #[test]
+    fn test_timing_wheel_remove() -> Result<()> {
+        let mut wheel: TimingWheel<u64> = TimingWheel::new();
+        let a: usize = wheel.insert(100, 1);
+        let b: usize = wheel.insert(100, 2);
+        let c: usize = wheel.insert(100, 3);
+
+        crate::ensure_eq!(wheel.remove(b), Some(2));
+        crate::ensure_eq!(wheel.remove(b), None);
+        crate::ensure_eq!(wheel.get(a), Some(&1));
+        crate::ensure_eq!(wheel.len(), 2);
+        crate::ensure_eq!(wheel.insert(200, 4), b);
+
+        crate::ensure_eq!(wheel.remove(a), Some(1));
+        crate::ensure_eq!(wheel.remove(c), Some(3));
+        crate::ensure_eq!(advance(&mut wheel, 150), Vec::<u64>::new());
+        crate::ensure_eq!(advance(&mut wheel, 200), vec![4]);
+
+        Ok(())
+    }
+
+    /// Checks the wheel against a sorted list of deadlines, with values added while time advances.
+    #[test]
+    fn test_timing_wheel_random() -> Result<()> {
+        let mut rng = rand::thread_rng();
+        let mut wheel: TimingWheel<u64> = TimingWheel::new();
+        let mut pending: Vec<u64> = Vec::new();
+        let mut now: u64 = 0;
+        for _ in 0..1000 {
+            for _ in 0..8 {
+                let deadline: u64 = now + rng.gen_range(0..1_000_000);
+                wheel.insert(deadline, deadline);
+                pending.push(deadline);
+            }
+            now += rng.gen_range(0..10_000);
+            let mut expected: Vec<u64> = pending.iter().copied().filter(|deadline| *deadline <= now).collect();
+            expected.sort();
+            pending.retain(|deadline| *deadline > now);
+            crate::ensure_eq!(advance(&mut wheel, now), expected);
+        }
+        crate::ensure_eq!(wheel.len(), pending.len());
+
+        Ok(())
+    }
+}
@@ -5,6 +5,8 @@
 // Imports
 //======================================================================================================================
 
+#[cfg(target_os = "linux")]
+use crate::pal::SO_PRIORITY;
 use crate::{
     demikernel::libos::{name::LibOSName, LibOS},
     pal::{
@@ -14,15 +16,19 @@ use crate::{
     runtime::{
         fail::Fail,
         logging,
-        types::{demi_args_t, demi_callback_t, demi_qresult_t, demi_qtoken_t, demi_sgarray_t, demi_sgaseg_t},
-        QToken,
+        types::{
+            demi_args_t, demi_callback_t, demi_qresult_t, demi_qtoken_t, demi_sgarray_t, demi_sgaseg_t, demi_stats_t,
+            DEMI_SGARRAY_MAXLEN,
+        },
+        QDesc, QToken, WaitSetId,
     },
     SocketOption,
 };
-use ::libc::{c_int, c_void};
+use ::libc::{c_char, c_int, c_void};
 use ::socket2::SockAddr;
 use ::std::{
     cell::RefCell,
+    ffi::CStr,
     mem::{self, MaybeUninit},
     net::{SocketAddr, SocketAddrV4},
     ptr, slice,
@@ -103,6 +109,22 @@ pub extern "C" fn demi_socket(qd_out: *mut c_int, domain: c_int, socket_type: c_
     }
 }
 
+#[no_mangle]
+pub extern "C" fn demi_create_pipe(memqd_out: *mut c_int, name: *const c_char) -> c_int {
+    trace!("demi_create_pipe()");
+    do_pipe_syscall("demi_create_pipe", memqd_out, name, |libos: &mut LibOS, name: &str| {
+        libos.create_pipe(name)
+    })
+}
+
+#[no_mangle]
+pub extern "C" fn demi_open_pipe(memqd_out: *mut c_int, name: *const c_char) -> c_int {
+    trace!("demi_open_pipe()");
+    do_pipe_syscall("demi_open_pipe", memqd_out, name, |libos: &mut LibOS, name: &str| {
+        libos.open_pipe(name)
+    })
+}
+
 #[no_mangle]
 pub extern "C" fn demi_bind(qd: c_int, saddr: *const sockaddr, size: Socklen) -> c_int {
     trace!("demi_bind()");
@@ -370,6 +392,156 @@ pub extern "C" fn demi_pop(qtok_out: *mut demi_qtoken_t, qd: c_int) -> c_int {
     }
 }
 
+#[no_mangle]
+pub extern "C" fn demi_push_n(
+    qts_out: *mut demi_qtoken_t,
+    qds: *const c_int,
+    sgas: *const demi_sgarray_t,
+    n: c_int,
+    nsubmitted: *mut c_int,
+) -> c_int {
+    trace!("demi_push_n() {:?}", n);
+
+    // Check arguments. Nothing is issued on any of the error paths.
+    if nsubmitted.is_null() {
+        warn!("demi_push_n() invalid argument");
+        return libc::EINVAL;
+    }
+    unsafe { *nsubmitted = 0 };
+    if qts_out.is_null() || qds.is_null() || sgas.is_null() || n < 0 {
+        warn!("demi_push_n() invalid argument");
+        return libc::EINVAL;
+    }
+
+    // Safety: We have to trust that our user is providing arrays of `n` elements. Queue tokens and queue descriptors
+    // have the same layout as their C counterparts.
+    let qts_out: &mut [QToken] = unsafe { slice::from_raw_parts_mut(qts_out as *mut QToken, n as usize) };
+    let qds: &[QDesc] = unsafe { slice::from_raw_parts(qds as *const QDesc, n as usize) };
+    let sgas: &[demi_sgarray_t] = unsafe { slice::from_raw_parts(sgas, n as usize) };
+
+    // Issue push operations.
+    let mut count: usize = 0;
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.push_n(qds, sgas, qts_out, &mut count) {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_push_n() failed: {:?}", e);
+            e.errno
+        },
+    });
+    unsafe { *nsubmitted = count as c_int };
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_pushto_n(
+    qts_out: *mut demi_qtoken_t,
+    sockqds: *const c_int,
+    sgas: *const demi_sgarray_t,
+    saddrs: *const *const sockaddr,
+    size: Socklen,
+    n: c_int,
+    nsubmitted: *mut c_int,
+) -> c_int {
+    trace!("demi_pushto_n() {:?}", n);
+
+    // Check arguments. Nothing is issued on any of the error paths.
+    if nsubmitted.is_null() {
+        warn!("demi_pushto_n() invalid argument");
+        return libc::EINVAL;
+    }
+    unsafe { *nsubmitted = 0 };
+    if qts_out.is_null() || sockqds.is_null() || sgas.is_null() || saddrs.is_null() || n < 0 {
+        warn!("demi_pushto_n() invalid argument");
+        return libc::EINVAL;
+    }
+
+    // Safety: We have to trust that our user is providing arrays of `n` elements. Queue tokens and queue descriptors
+    // have the same layout as their C counterparts.
+    let qts_out: &mut [QToken] = unsafe { slice::from_raw_parts_mut(qts_out as *mut QToken, n as usize) };
+    let qds: &[QDesc] = unsafe { slice::from_raw_parts(sockqds as *const QDesc, n as usize) };
+    let sgas: &[demi_sgarray_t] = unsafe { slice::from_raw_parts(sgas, n as usize) };
+    let saddrs: &[*const sockaddr] = unsafe { slice::from_raw_parts(saddrs, n as usize) };
+
+    // Get socket addresses. Nothing is issued if any of them is invalid.
+    let mut endpoints: Vec<SocketAddr> = Vec::with_capacity(n as usize);
+    for saddr in saddrs {
+        if saddr.is_null() {
+            return libc::EINVAL;
+        }
+        match sockaddr_to_socketaddr(*saddr, size) {
+            Ok(endpoint) => endpoints.push(endpoint),
+            Err(e) => {
+                trace!("demi_pushto_n() failed: {:?}", e);
+                return e.errno;
+            },
+        }
+    }
+
+    // Issue pushto operations.
+    let mut count: usize = 0;
+    let ret: Result<i32, Fail> = do_syscall(
+        |libos| match libos.pushto_n(qds, sgas, &endpoints, qts_out, &mut count) {
+            Ok(()) => 0,
+            Err(e) => {
+                trace!("demi_pushto_n() failed: {:?}", e);
+                e.errno
+            },
+        },
+    );
+    unsafe { *nsubmitted = count as c_int };
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_pop_n(
+    qts_out: *mut demi_qtoken_t,
+    qds: *const c_int,
+    n: c_int,
+    nsubmitted: *mut c_int,
+) -> c_int {
+    trace!("demi_pop_n() {:?}", n);
+
+    // Check arguments. Nothing is issued on any of the error paths.
+    if nsubmitted.is_null() {
+        warn!("demi_pop_n() invalid argument");
+        return libc::EINVAL;
+    }
+    unsafe { *nsubmitted = 0 };
+    if qts_out.is_null() || qds.is_null() || n < 0 {
+        warn!("demi_pop_n() invalid argument");
+        return libc::EINVAL;
+    }
+
+    // Safety: We have to trust that our user is providing arrays of `n` elements. Queue tokens and queue descriptors
+    // have the same layout as their C counterparts.
+    let qts_out: &mut [QToken] = unsafe { slice::from_raw_parts_mut(qts_out as *mut QToken, n as usize) };
+    let qds: &[QDesc] = unsafe { slice::from_raw_parts(qds as *const QDesc, n as usize) };
+
+    // Issue pop operations.
+    let mut count: usize = 0;
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.pop_n(qds, qts_out, &mut count) {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_pop_n() failed: {:?}", e);
+            e.errno
+        },
+    });
+    unsafe { *nsubmitted = count as c_int };
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
 #[no_mangle]
 pub extern "C" fn demi_wait(qr_out: *mut demi_qresult_t, qt: demi_qtoken_t, timeout: *const libc::timespec) -> c_int {
     trace!("demi_wait() {:?} {:?} {:?}", qr_out, qt, timeout);
@@ -525,21 +697,187 @@ pub extern "C" fn demi_wait_next_n(
     }
 }
 
+#[no_mangle]
+pub extern "C" fn demi_waitset_create(wsd_out: *mut c_int) -> c_int {
+    trace!("demi_waitset_create() {:?}", wsd_out);
+
+    // Check for invalid storage location.
+    if wsd_out.is_null() {
+        warn!("demi_waitset_create() wsd_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Issue create wait set operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| {
+        let wsd: WaitSetId = libos.create_wait_set();
+        unsafe { *wsd_out = wsd.into() };
+        0
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_waitset_close(wsd: c_int) -> c_int {
+    trace!("demi_waitset_close() {:?}", wsd);
+
+    // Issue close wait set operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.close_wait_set(wsd.into()) {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_waitset_close() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_waitset_add(wsd: c_int, qt: demi_qtoken_t) -> c_int {
+    trace!("demi_waitset_add() {:?} {:?}", wsd, qt);
+
+    // Issue wait set add operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.wait_set_add(wsd.into(), qt.into()) {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_waitset_add() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_waitset_remove(wsd: c_int, qt: demi_qtoken_t) -> c_int {
+    trace!("demi_waitset_remove() {:?} {:?}", wsd, qt);
+
+    // Issue wait set remove operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.wait_set_remove(wsd.into(), qt.into()) {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_waitset_remove() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_waitset_wait(qr_out: *mut demi_qresult_t, wsd: c_int, timeout: *const libc::timespec) -> c_int {
+    trace!("demi_waitset_wait() {:?} {:?} {:?}", qr_out, wsd, timeout);
+
+    // Check for invalid storage location for queue result.
+    if qr_out.is_null() {
+        warn!("qr_out is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Convert timespec to Duration.
+    let duration: Option<Duration> = if timeout.is_null() {
+        None
+    } else {
+        // Safety: We have to trust that our user is providing a valid timeout pointer for us to dereference.
+        Some(unsafe { Duration::new((*timeout).tv_sec as u64, (*timeout).tv_nsec as u32) })
+    };
+
+    // Issue wait set wait operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.wait_set_wait(wsd.into(), duration) {
+        Ok(r) => {
+            unsafe { *qr_out = r };
+            0
+        },
+        Err(e) => {
+            trace!("demi_waitset_wait() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_cq_register(cq: *mut c_void, size: libc::size_t) -> c_int {
+    trace!("demi_cq_register() {:?} {:?}", cq, size);
+
+    // Check for invalid completion queue.
+    if cq.is_null() {
+        warn!("demi_cq_register() cq is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // Issue register completion queue operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.register_completion_queue(cq as *mut u8, size) {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_cq_register() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_cq_unregister() -> c_int {
+    trace!("demi_cq_unregister()");
+
+    // Issue unregister completion queue operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.unregister_completion_queue() {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_cq_unregister() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn demi_poll() -> c_int {
+    trace!("demi_poll()");
+
+    // Run all runnable coroutines.
+    let ret: Result<i32, Fail> = do_syscall(|libos| {
+        libos.poll();
+        0
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
 #[no_mangle]
 pub extern "C" fn demi_sgaalloc(size: libc::size_t) -> demi_sgarray_t {
     trace!("demi_sgaalloc()");
 
-    let null_sga: demi_sgarray_t = {
-        demi_sgarray_t {
-            sga_buf: ptr::null_mut() as *mut _,
-            sga_numsegs: 0,
-            sga_segs: [demi_sgaseg_t {
-                sgaseg_buf: ptr::null_mut() as *mut c_void,
-                sgaseg_len: 0,
-            }; 1],
-            sga_addr: unsafe { mem::zeroed() },
-        }
-    };
+    let null_sga: demi_sgarray_t = null_sgarray();
 
     // Issue sgaalloc operation.
     let ret: Result<demi_sgarray_t, Fail> = do_syscall(|libos| -> demi_sgarray_t {
@@ -561,6 +899,42 @@ pub extern "C" fn demi_sgaalloc(size: libc::size_t) -> demi_sgarray_t {
     }
 }
 
+#[no_mangle]
+pub extern "C" fn demi_sgaallocv(seglens: *const libc::size_t, numsegs: u32) -> demi_sgarray_t {
+    trace!("demi_sgaallocv()");
+
+    let null_sga: demi_sgarray_t = null_sgarray();
+
+    // Check arguments.
+    if seglens.is_null() || numsegs == 0 || numsegs as usize > DEMI_SGARRAY_MAXLEN {
+        warn!("demi_sgaallocv(): invalid segment sizes");
+        return null_sga;
+    }
+
+    // Get segment sizes.
+    // Safety: We have to trust that our user is providing a valid array of `numsegs` sizes.
+    let seglens: &[usize] = unsafe { slice::from_raw_parts(seglens as *const usize, numsegs as usize) };
+
+    // Issue sgaallocv operation.
+    let ret: Result<demi_sgarray_t, Fail> = do_syscall(|libos| -> demi_sgarray_t {
+        match libos.sgaallocv(seglens) {
+            Ok(sga) => sga,
+            Err(e) => {
+                trace!("demi_sgaallocv() failed: {:?}", e);
+                null_sga
+            },
+        }
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => {
+            trace!("demi_sgaallocv() failed: {:?}", e);
+            null_sga
+        },
+    }
+}
+
 #[no_mangle]
 pub extern "C" fn demi_sgafree(sga: *mut demi_sgarray_t) -> c_int {
     trace!("demi_sgfree()");
@@ -628,8 +1002,31 @@ pub extern "C" fn demi_setsockopt(
                 _ => SocketOption::Linger(Some(Duration::from_secs(linger.l_linger as u64))),
             }
         },
+        // WinSock has no such option.
+        #[cfg(target_os = "linux")]
+        SO_PRIORITY => {
+            // Check for invalid storage locations.
+            if optval.is_null() {
+                error!("demi_setsockopt(): priority value is a null pointer");
+                return libc::EINVAL;
+            }
+
+            if optlen as usize != mem::size_of::<c_int>() {
+                warn!("demi_setsockopt(): priority len is incorrect");
+                return libc::EINVAL;
+            }
+
+            let priority: c_int = unsafe { *(optval as *const c_int) };
+            match u8::try_from(priority) {
+                Ok(priority) => SocketOption::Priority(priority),
+                Err(_) => {
+                    warn!("demi_setsockopt(): priority value is invalid");
+                    return libc::EINVAL;
+                },
+            }
+        },
         _ => {
-            error!("demi_setsockopt(): only SO_LINGER is supported right now");
+            error!("demi_setsockopt(): only SO_LINGER and SO_PRIORITY are supported right now");
             return libc::ENOPROTOOPT;
         },
     };
@@ -670,8 +1067,10 @@ pub extern "C" fn demi_getsockopt(
 
     let opt: SocketOption = match optname {
         SO_LINGER => SocketOption::Linger(None),
+        #[cfg(target_os = "linux")]
+        SO_PRIORITY => SocketOption::Priority(0),
         _ => {
-            error!("demi_getsockopt(): only SO_LINGER is supported right now");
+            error!("demi_getsockopt(): only SO_LINGER and SO_PRIORITY are supported right now");
             return libc::ENOPROTOOPT;
         },
     };
@@ -698,7 +1097,7 @@ pub extern "C" fn demi_getsockopt(
 
     match ret {
         Ok(option) => {
-            // Unpack the value based on the option. We only support linger right now.
+            // Unpack the value based on the option. We only support linger and priority right now.
             match option {
                 SocketOption::Linger(linger) => {
                     let result: Linger = match linger {
@@ -722,8 +1121,16 @@ pub extern "C" fn demi_getsockopt(
                         *optlen = result_length as Socklen;
                     }
                 },
+                SocketOption::Priority(priority) => {
+                    let result: c_int = priority as c_int;
+                    let result_length: usize = mem::size_of::<c_int>();
+                    unsafe {
+                        ptr::copy(&result as *const c_int as *const c_void, optval, result_length);
+                        *optlen = result_length as Socklen;
+                    }
+                },
                 _ => {
-                    let cause: String = format!("Only SO_LINGER is supported right now");
+                    let cause: String = format!("Only SO_LINGER and SO_PRIORITY are supported right now");
                     error!("demi_setsockopt(): {}", cause);
                     return libc::EINVAL;
                 },
@@ -792,10 +1199,79 @@ pub extern "C" fn demi_getpeername(qd: c_int, addr: *mut SockAddr, addrlen: *mut
     }
 }
 
+#[no_mangle]
+pub extern "C" fn demi_getstats(qd: c_int, stats_out: *mut demi_stats_t) -> c_int {
+    trace!("demi_getstats()");
+
+    if stats_out.is_null() {
+        warn!("demi_getstats() stats_out value is a null pointer");
+        return libc::EINVAL;
+    }
+
+    // A negative descriptor asks for the statistics of the calling thread.
+    let qd: Option<QDesc> = if qd < 0 { None } else { Some(qd.into()) };
+    let ret: Result<demi_stats_t, Fail> = match do_syscall(|libos| libos.get_stats(qd)) {
+        Ok(result) => result,
+        Err(e) => {
+            trace!("demi_getstats() failed: {:?}", e);
+            return e.errno;
+        },
+    };
+
+    match ret {
+        Ok(stats) => {
+            unsafe { *stats_out = stats };
+            0
+        },
+        Err(e) => {
+            trace!("demi_getstats() failed: {:?}", e);
+            e.errno
+        },
+    }
+}
+
 //======================================================================================================================
 // Standalone Functions
 //======================================================================================================================
 
+/// Runs `op`, which creates or opens the pipe named `name`, and stores the I/O queue descriptor of the pipe in
+/// `memqd_out`.
+fn do_pipe_syscall<F: FnOnce(&mut LibOS, &str) -> Result<QDesc, Fail>>(
+    syscall: &str,
+    memqd_out: *mut c_int,
+    name: *const c_char,
+    op: F,
+) -> c_int {
+    if memqd_out.is_null() || name.is_null() {
+        warn!("{}() memqd_out or name is a null pointer", syscall);
+        return libc::EINVAL;
+    }
+
+    let name: &str = match unsafe { CStr::from_ptr(name) }.to_str() {
+        Ok(name) => name,
+        Err(_) => {
+            warn!("{}() name is not valid UTF-8", syscall);
+            return libc::EINVAL;
+        },
+    };
+
+    let ret: Result<i32, Fail> = do_syscall(|libos| match op(libos, name) {
+        Ok(qd) => {
+            unsafe { *memqd_out = qd.into() };
+            0
+        },
+        Err(e) => {
+            trace!("{}() failed: {:?}", syscall, e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
 fn do_syscall<T>(f: impl FnOnce(&mut LibOS) -> T) -> Result<T, Fail> {
     THREAD_LOCAL_LIBOS.with(|libos| match libos.try_borrow_mut() {
         Ok(mut libos) => match libos.as_mut() {
@@ -806,6 +1282,19 @@ fn do_syscall<T>(f: impl FnOnce(&mut LibOS) -> T) -> Result<T, Fail> {
     })
 }
 
+/// Returns the null scatter-gather array, which is handed out when allocations fail.
+fn null_sgarray() -> demi_sgarray_t {
+    demi_sgarray_t {
+        sga_buf: ptr::null_mut() as *mut _,
+        sga_numsegs: 0,
+        sga_segs: [demi_sgaseg_t {
+            sgaseg_buf: ptr::null_mut() as *mut c_void,
+            sgaseg_len: 0,
+        }; DEMI_SGARRAY_MAXLEN],
+        sga_addr: unsafe { mem::zeroed() },
+    }
+}
+
 fn sockaddr_to_socketaddr(saddr: *const sockaddr, size: Socklen) -> Result<SocketAddr, Fail> {
     let check_name_len = |len: usize, exact: bool| {
         if (size as usize) < len || (exact && size as usize != len) {
@@ -855,6 +1344,8 @@ mod test {
     use libc::c_int;
     use socket2::{Domain, Protocol, SockAddr, Type};
 
+    #[cfg(target_os = "linux")]
+    use crate::pal::SO_PRIORITY;
     use crate::{
         demikernel::bindings::{demi_getsockopt, demi_init, demi_setsockopt, demi_socket, sockaddr_to_socketaddr},
         ensure_eq, ensure_neq,
@@ -1023,4 +1514,78 @@ mod test {
 
         Ok(())
     }
+
+    #[test]
+    #[cfg(target_os = "linux")]
+    fn test_set_and_get_priority() -> anyhow::Result<()> {
+        // Initialize Demikernel
+
+        use crate::runtime::types::demi_args_t;
+        let args: demi_args_t = demi_args_t::default();
+        let result: c_int = demi_init(&args);
+        ensure_eq!(result, 0);
+
+        let mut qd: c_int = 0;
+        let result: c_int = demi_socket(
+            &mut qd as *mut c_int,
+            Domain::IPV4.into(),
+            Type::STREAM.into(),
+            Protocol::TCP.into(),
+        );
+
+        ensure_eq!(result, 0);
+        ensure_neq!(qd, 0);
+
+        // Sockets start with the lowest priority.
+        let mut priority_check: c_int = -1;
+        let mut priority_check_len: usize = 0;
+        let result: c_int = demi_getsockopt(
+            qd,
+            SOL_SOCKET,
+            SO_PRIORITY,
+            &mut priority_check as *mut c_int as *mut c_void,
+            &mut priority_check_len as *mut usize as *mut Socklen,
+        );
+
+        ensure_eq!(result, 0);
+        ensure_eq!(priority_check_len, mem::size_of::<c_int>());
+        ensure_eq!(priority_check, 0);
+
+        // Raise the priority.
+        let priority: c_int = 5;
+        let result: c_int = demi_setsockopt(
+            qd,
+            SOL_SOCKET,
+            SO_PRIORITY,
+            &priority as *const c_int as *const c_void,
+            mem::size_of::<c_int>() as Socklen,
+        );
+
+        ensure_eq!(result, 0);
+        let result: c_int = demi_getsockopt(
+            qd,
+            SOL_SOCKET,
+            SO_PRIORITY,
+            &mut priority_check as *mut c_int as *mut c_void,
+            &mut priority_check_len as *mut usize as *mut Socklen,
+        );
+
+        ensure_eq!(result, 0);
+        ensure_eq!(priority_check, 5);
+
+        // Priorities out of range are rejected.
+        for priority in [-1, 7] {
+            let priority: c_int = priority;
+            let result: c_int = demi_setsockopt(
+                qd,
+                SOL_SOCKET,
+                SO_PRIORITY,
+                &priority as *const c_int as *const c_void,
+                mem::size_of::<c_int>() as Socklen,
+            );
+            ensure_eq!(result, libc::EINVAL);
+        }
+
+        Ok(())
+    }
 }
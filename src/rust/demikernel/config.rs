@@ -5,7 +5,15 @@
 // Imports
 //======================================================================================================================
 
-use crate::{pal::KeepAlive, runtime::fail::Fail, MacAddress};
+use crate::{
+    pal::KeepAlive,
+    runtime::{
+        fail::Fail,
+        idle::IdlePolicy,
+        network::{consts::RECEIVE_BATCH_SIZE, socket::option::CongestionControlAlgorithm},
+    },
+    MacAddress,
+};
 #[cfg(any(feature = "catnip-libos"))]
 use ::std::ffi::CString;
 use ::std::{collections::HashMap, fs::File, io::Read, net::Ipv4Addr, ops::Index, str::FromStr, time::Duration};
@@ -23,6 +31,19 @@ mod global_config {
     pub const LOCAL_IPV4_ADDR: &str = "local_ipv4_addr";
     // Local MAC address.
     pub const LOCAL_LINK_ADDR: &str = "local_link_addr";
+    // What waits do while no operation completes, and for how long.
+    pub const IDLE_POLICY: &str = "idle_policy";
+    pub const IDLE_SPIN_US: &str = "idle_spin_us";
+    pub const IDLE_YIELD_US: &str = "idle_yield_us";
+    pub const IDLE_SLEEP_US: &str = "idle_sleep_us";
+    // Whether scatter-gather arrays come from size-class pools on LibOSes that allocate them from the heap, and whether
+    // those pools live in hugepages.
+    pub const SGAALLOC_POOLS: &str = "sgaalloc_pools";
+    pub const SGAALLOC_HUGEPAGES: &str = "sgaalloc_hugepages";
+    // Whether memory pools are faulted in and locked in memory when they are created.
+    pub const PREFAULT_POOLS: &str = "prefault_pools";
+    // Period at which statistics are handed to the callback that was given at initialization.
+    pub const STATS_EXPORT_INTERVAL_MS: &str = "stats_export_interval_ms";
 }
 
 // These apply to all LibOSes.
@@ -31,6 +52,7 @@ mod tcp_socket_options {
     pub const KEEP_ALIVE: &str = "keepalive";
     pub const LINGER: &str = "linger";
     pub const NO_DELAY: &str = "nodelay";
+    pub const CONGESTION_CONTROL: &str = "congestion_control";
 }
 
 // These only apply to the inetstack.
@@ -45,6 +67,9 @@ mod inetstack_config {
     pub const ENABLE_JUMBO_FRAMES: &str = "enable_jumbo_frames";
     pub const UDP_CHECKSUM_OFFLOAD: &str = "udp_checksum_offload";
     pub const TCP_CHECKSUM_OFFLOAD: &str = "tcp_checksum_offload";
+    pub const TCP_SEGMENTATION_OFFLOAD: &str = "tcp_segmentation_offload";
+    pub const RECEIVE_BATCH_SIZE: &str = "receive_batch_size";
+    pub const TCP_ZERO_COPY_POP: &str = "tcp_zero_copy_pop";
 }
 
 // DPDK options. These only apply to catnip.
@@ -52,6 +77,32 @@ mod inetstack_config {
 mod dpdk_config {
     pub const SECTION_NAME: &str = "dpdk";
     pub const EAL_INIT_ARGS: &str = "eal_init";
+    pub const NUM_QUEUES: &str = "num_queues";
+}
+
+// Catnap options. These only apply to catnap.
+#[cfg(feature = "catnap-libos")]
+mod catnap_config {
+    pub const SECTION_NAME: &str = "catnap";
+    // Either "epoll" or "io_uring". Only applies on Linux.
+    #[cfg(target_os = "linux")]
+    pub const BACKEND: &str = "catnap_backend";
+    // Number of completions dequeued from the I/O completion port at once. Only applies on Windows.
+    #[cfg(target_os = "windows")]
+    pub const IOCP_BATCH_SIZE: &str = "iocp_batch_size";
+}
+
+// Catmem options. These only apply to catmem.
+#[cfg(feature = "catmem-libos")]
+mod catmem_config {
+    pub const SECTION_NAME: &str = "catmem";
+    // Size of the shared memory region of each ring of a pipe.
+    pub const RING_SIZE: &str = "ring_size";
+    // Whether rings live in hugepages.
+    pub const HUGEPAGES: &str = "hugepages";
+    // How long pops spin on an empty ring, and then how long they sleep at most at a time.
+    pub const SPIN_US: &str = "spin_us";
+    pub const SLEEP_US: &str = "sleep_us";
 }
 
 // Raw socket option. This only applies to catpowder.
@@ -60,6 +111,13 @@ mod raw_socket_config {
     pub const SECTION_NAME: &str = "raw_socket";
     #[cfg(target_os = "linux")]
     pub const LOCAL_INTERFACE_NAME: &str = "linux_interface_name";
+    // Whether packets go through PACKET_MMAP rings rather than through batches of system calls. The rings may delay a
+    // received packet by up to 1 ms, so they are off unless enabled.
+    #[cfg(target_os = "linux")]
+    pub const PACKET_MMAP: &str = "linux_packet_mmap";
+    // Whether packets go through AF_XDP sockets rather than through a raw socket.
+    #[cfg(target_os = "linux")]
+    pub const AF_XDP: &str = "linux_af_xdp";
 
     // The primary interface index. This should be the virtualized interface for VMs.
     #[cfg(target_os = "windows")]
@@ -113,6 +171,16 @@ impl Config {
         Self::get_subsection(&self.0, dpdk_config::SECTION_NAME)
     }
 
+    #[cfg(feature = "catnap-libos")]
+    fn get_catnap_config(&self) -> Result<&Yaml, Fail> {
+        Self::get_subsection(&self.0, catnap_config::SECTION_NAME)
+    }
+
+    #[cfg(feature = "catmem-libos")]
+    fn get_catmem_config(&self) -> Result<&Yaml, Fail> {
+        Self::get_subsection(&self.0, catmem_config::SECTION_NAME)
+    }
+
     #[cfg(feature = "catpowder-libos")]
     fn get_raw_socket_config(&self) -> Result<&Yaml, Fail> {
         Self::get_subsection(&self.0, raw_socket_config::SECTION_NAME)
@@ -158,6 +226,89 @@ impl Config {
         }
     }
 
+    /// Global config: Reads what waits do while no operation completes. This is either "busy_poll", which spins on the
+    /// scheduler, or "adaptive", which spins for "idle_spin_us", then yields the core for "idle_yield_us" and then
+    /// sleeps for up to "idle_sleep_us" between passes over the scheduler. The values from the env vars take precedence
+    /// over the values from file. Returns `None` if no policy is set.
+    pub fn idle_policy(&self) -> Result<Option<IdlePolicy>, Fail> {
+        let policy: String = if let Some(policy) = Self::get_typed_env_option(global_config::IDLE_POLICY)? {
+            policy
+        } else {
+            let section: &Yaml = self.get_global_config()?;
+            if !Self::has_option(section, global_config::IDLE_POLICY) {
+                return Ok(None);
+            }
+            Self::get_typed_str_option(section, global_config::IDLE_POLICY, |val: &str| Some(val.to_string()))?
+        };
+
+        match policy.as_str() {
+            "busy_poll" => Ok(Some(IdlePolicy::BusyPoll)),
+            "adaptive" => Ok(Some(IdlePolicy::Adaptive {
+                spin: self.get_global_duration_us(global_config::IDLE_SPIN_US)?,
+                yield_for: self.get_global_duration_us(global_config::IDLE_YIELD_US)?,
+                max_sleep: self.get_global_duration_us(global_config::IDLE_SLEEP_US)?,
+            })),
+            _ => {
+                let cause: String = format!("unknown idle policy (idle_policy={:?})", policy);
+                error!("idle_policy(): {}", cause);
+                Err(Fail::new(libc::EINVAL, &cause))
+            },
+        }
+    }
+
+    /// Global config: Reads a duration in microseconds. The value from the env var takes precedence over the value
+    /// from file.
+    fn get_global_duration_us(&self, index: &str) -> Result<Duration, Fail> {
+        let us: u64 = if let Some(us) = Self::get_typed_env_option(index)? {
+            us
+        } else {
+            Self::get_int_option(self.get_global_config()?, index)?
+        };
+        Ok(Duration::from_micros(us))
+    }
+
+    /// Global config: Reads whether scatter-gather arrays are allocated from size-class pools rather than from the heap.
+    /// This applies to the LibOSes that do not have their own memory allocator. The value from the env var takes
+    /// precedence over the value from file.
+    pub fn sgaalloc_pools(&self) -> Result<bool, Fail> {
+        if let Some(enabled) = Self::get_typed_env_option(global_config::SGAALLOC_POOLS)? {
+            Ok(enabled)
+        } else {
+            Self::get_bool_option(self.get_global_config()?, global_config::SGAALLOC_POOLS)
+        }
+    }
+
+    /// Global config: Reads whether the size-class pools of scatter-gather arrays live in 2 MB hugepages. The value
+    /// from the env var takes precedence over the value from file.
+    pub fn sgaalloc_hugepages(&self) -> Result<bool, Fail> {
+        if let Some(enabled) = Self::get_typed_env_option(global_config::SGAALLOC_HUGEPAGES)? {
+            Ok(enabled)
+        } else {
+            Self::get_bool_option(self.get_global_config()?, global_config::SGAALLOC_HUGEPAGES)
+        }
+    }
+
+    /// Global config: Reads whether memory pools are faulted in and locked in memory when they are created. The value
+    /// from the env var takes precedence over the value from file.
+    pub fn prefault_pools(&self) -> Result<bool, Fail> {
+        if let Some(enabled) = Self::get_typed_env_option(global_config::PREFAULT_POOLS)? {
+            Ok(enabled)
+        } else {
+            Self::get_bool_option(self.get_global_config()?, global_config::PREFAULT_POOLS)
+        }
+    }
+
+    /// Global config: Reads the period at which statistics are exported, where zero disables the export. The value from
+    /// the env var takes precedence over the value from file.
+    pub fn stats_export_interval(&self) -> Result<Duration, Fail> {
+        let ms: u64 = if let Some(ms) = Self::get_typed_env_option(global_config::STATS_EXPORT_INTERVAL_MS)? {
+            ms
+        } else {
+            Self::get_int_option(self.get_global_config()?, global_config::STATS_EXPORT_INTERVAL_MS)?
+        };
+        Ok(Duration::from_millis(ms))
+    }
+
     /// Tcp socket option: Reads TCP keepalive settings as a `tcp_keepalive` structure from "tcp_keepalive" subsection.
     pub fn tcp_keepalive(&self) -> Result<KeepAlive, Fail> {
         let section: &Yaml = Self::get_subsection(self.get_tcp_socket_options()?, tcp_socket_options::KEEP_ALIVE)?;
@@ -207,6 +358,29 @@ impl Config {
         }
     }
 
+    /// Tcp socket option: Reads the congestion control algorithm of TCP connections, which is "none", "cubic", "dctcp"
+    /// or "bbr". The value from the env var takes precedence over the value from file.
+    pub fn tcp_congestion_control(&self) -> Result<CongestionControlAlgorithm, Fail> {
+        let name: String = if let Some(name) = Self::get_typed_env_option(tcp_socket_options::CONGESTION_CONTROL)? {
+            name
+        } else {
+            Self::get_typed_str_option(
+                self.get_tcp_socket_options()?,
+                tcp_socket_options::CONGESTION_CONTROL,
+                |val: &str| Some(val.to_string()),
+            )?
+        };
+
+        match CongestionControlAlgorithm::from_name(&name) {
+            Some(algorithm) => Ok(algorithm),
+            None => {
+                let cause: String = format!("unknown congestion control algorithm (congestion_control={:?})", name);
+                error!("tcp_congestion_control(): {}", cause);
+                Err(Fail::new(libc::EINVAL, &cause))
+            },
+        }
+    }
+
     /// Tcp Config: Reads the "ARP table" parameter from the underlying configuration file. If no ARP table is present,
     /// then ARP is disabled. This cannot be passed in as an environment variable.
     pub fn arp_table(&self) -> Result<Option<HashMap<Ipv4Addr, MacAddress>>, Fail> {
@@ -271,6 +445,93 @@ impl Config {
         Ok(retries)
     }
 
+    #[cfg(all(feature = "catnap-libos", target_os = "linux"))]
+    /// Catnap config: Reads whether the "catnap_backend" is "io_uring" rather than "epoll". The value from the env var
+    /// takes precedence over the value from file.
+    pub fn catnap_io_uring(&self) -> Result<bool, Fail> {
+        let backend: String = if let Some(backend) = Self::get_typed_env_option(catnap_config::BACKEND)? {
+            backend
+        } else {
+            Self::get_typed_str_option(self.get_catnap_config()?, catnap_config::BACKEND, |val: &str| {
+                Some(val.to_string())
+            })?
+        };
+
+        match backend.as_str() {
+            "epoll" => Ok(false),
+            "io_uring" => Ok(true),
+            _ => {
+                let cause: String = format!("unknown catnap backend (catnap_backend={:?})", backend);
+                error!("catnap_io_uring(): {}", cause);
+                Err(Fail::new(libc::EINVAL, &cause))
+            },
+        }
+    }
+
+    #[cfg(all(feature = "catnap-libos", target_os = "windows"))]
+    /// Catnap config: Reads the number of completions that are dequeued from the I/O completion port at once. The
+    /// value from the env var takes precedence over the value from file.
+    pub fn catnap_iocp_batch_size(&self) -> Result<usize, Fail> {
+        let batch_size: usize = if let Some(batch_size) = Self::get_typed_env_option(catnap_config::IOCP_BATCH_SIZE)? {
+            batch_size
+        } else {
+            Self::get_int_option(self.get_catnap_config()?, catnap_config::IOCP_BATCH_SIZE)?
+        };
+
+        if batch_size == 0 {
+            let cause: String = format!("invalid completion batch size (iocp_batch_size={:?})", batch_size);
+            error!("catnap_iocp_batch_size(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        Ok(batch_size)
+    }
+
+    #[cfg(feature = "catmem-libos")]
+    /// Catmem config: Reads the size in bytes of the shared memory region of each ring of a pipe. Both ends of a pipe
+    /// must use the same size. The value from the env var takes precedence over the value from file.
+    pub fn catmem_ring_size(&self) -> Result<usize, Fail> {
+        if let Some(size) = Self::get_typed_env_option(catmem_config::RING_SIZE)? {
+            Ok(size)
+        } else {
+            Self::get_int_option(self.get_catmem_config()?, catmem_config::RING_SIZE)
+        }
+    }
+
+    #[cfg(feature = "catmem-libos")]
+    /// Catmem config: Reads whether the rings of pipes live in hugepages. Both ends of a pipe must agree on it. The
+    /// value from the env var takes precedence over the value from file.
+    pub fn catmem_hugepages(&self) -> Result<bool, Fail> {
+        if let Some(enabled) = Self::get_typed_env_option(catmem_config::HUGEPAGES)? {
+            Ok(enabled)
+        } else {
+            Self::get_bool_option(self.get_catmem_config()?, catmem_config::HUGEPAGES)
+        }
+    }
+
+    #[cfg(feature = "catmem-libos")]
+    /// Catmem config: Reads how long pops check an empty ring on every pass of the scheduler.
+    pub fn catmem_spin(&self) -> Result<Duration, Fail> {
+        self.get_catmem_duration_us(catmem_config::SPIN_US)
+    }
+
+    #[cfg(feature = "catmem-libos")]
+    /// Catmem config: Reads how often pops check an empty ring after that. Zero keeps them checking on every pass.
+    pub fn catmem_sleep(&self) -> Result<Duration, Fail> {
+        self.get_catmem_duration_us(catmem_config::SLEEP_US)
+    }
+
+    #[cfg(feature = "catmem-libos")]
+    /// Catmem config: Reads a duration in microseconds. The value from the env var takes precedence over the value
+    /// from file.
+    fn get_catmem_duration_us(&self, index: &str) -> Result<Duration, Fail> {
+        let us: u64 = if let Some(us) = Self::get_typed_env_option(index)? {
+            us
+        } else {
+            Self::get_int_option(self.get_catmem_config()?, index)?
+        };
+        Ok(Duration::from_micros(us))
+    }
+
     #[cfg(all(feature = "catpowder-libos", target_os = "linux"))]
     /// Global config: Reads the "local interface name" parameter from the environment variable and then the underlying
     /// configuration file.
@@ -287,6 +548,28 @@ impl Config {
         }
     }
 
+    #[cfg(all(feature = "catpowder-libos", target_os = "linux"))]
+    /// Raw socket config: Reads whether the raw socket exchanges packets with the kernel through TPACKET_V3 rings that
+    /// are mapped into our address space. The value from the env var takes precedence over the value from file.
+    pub fn linux_packet_mmap(&self) -> Result<bool, Fail> {
+        if let Some(enabled) = Self::get_typed_env_option(raw_socket_config::PACKET_MMAP)? {
+            Ok(enabled)
+        } else {
+            Self::get_bool_option(self.get_raw_socket_config()?, raw_socket_config::PACKET_MMAP)
+        }
+    }
+
+    #[cfg(all(feature = "catpowder-libos", target_os = "linux"))]
+    /// Raw socket config: Reads whether packets are exchanged with the interface through AF_XDP sockets instead of a
+    /// raw socket. The value from the env var takes precedence over the value from file.
+    pub fn linux_af_xdp(&self) -> Result<bool, Fail> {
+        if let Some(enabled) = Self::get_typed_env_option(raw_socket_config::AF_XDP)? {
+            Ok(enabled)
+        } else {
+            Self::get_bool_option(self.get_raw_socket_config()?, raw_socket_config::AF_XDP)
+        }
+    }
+
     #[cfg(all(feature = "catpowder-libos", target_os = "windows"))]
     /// Global config: Reads the "local interface index" parameter from the environment variable and then the underlying
     /// configuration file.
@@ -344,6 +627,25 @@ impl Config {
         Ok(result)
     }
 
+    #[cfg(feature = "catnip-libos")]
+    /// DPDK Config: Reads the number of RX/TX queue pairs to set up on the port. Each queue pair is served by its own
+    /// runtime, so this is the maximum number of cores that may run a catnip LibOS in this process. The value from the
+    /// env var takes precedence over the value from file.
+    pub fn num_queues(&self) -> Result<u16, Fail> {
+        let num_queues: u16 = if let Some(num_queues) = Self::get_typed_env_option(dpdk_config::NUM_QUEUES)? {
+            num_queues
+        } else {
+            Self::get_int_option(self.get_dpdk_config()?, dpdk_config::NUM_QUEUES)?
+        };
+
+        if num_queues == 0 {
+            let cause: String = format!("number of queues must be greater than zero");
+            error!("num_queues(): {}", cause);
+            return Err(Fail::new(libc::ERANGE, &cause));
+        }
+        Ok(num_queues)
+    }
+
     pub fn mtu(&self) -> Result<u16, Fail> {
         if let Some(addr) = Self::get_typed_env_option(inetstack_config::MTU)? {
             Ok(addr)
@@ -364,10 +666,48 @@ impl Config {
         Self::get_bool_option(self.get_inetstack_config()?, inetstack_config::UDP_CHECKSUM_OFFLOAD)
     }
 
+    /// Inetstack Config: Reads whether the TCP sender should hand segments larger than the MSS to the NIC and let it
+    /// cut them into MSS-sized packets (TCP segmentation offload).
+    pub fn tcp_segmentation_offload(&self) -> Result<bool, Fail> {
+        Self::get_bool_option(self.get_inetstack_config()?, inetstack_config::TCP_SEGMENTATION_OFFLOAD)
+    }
+
+    /// Inetstack Config: Reads whether a TCP pop should hand out all of the received segments that fit in a single
+    /// scatter-gather array, with one scatter-gather segment per received buffer, rather than one received buffer.
+    pub fn tcp_zero_copy_pop(&self) -> Result<bool, Fail> {
+        Self::get_bool_option(self.get_inetstack_config()?, inetstack_config::TCP_ZERO_COPY_POP)
+    }
+
     pub fn enable_jumbo_frames(&self) -> Result<bool, Fail> {
         Self::get_bool_option(self.get_inetstack_config()?, inetstack_config::ENABLE_JUMBO_FRAMES)
     }
 
+    /// Inetstack Config: Reads the maximum number of packets that the physical layer should hand to the network stack
+    /// on every receive. The value from the env var takes precedence over the value from file. This must lie in
+    /// `1..=RECEIVE_BATCH_SIZE`, since the batch is backed by a fixed-capacity array. Returns `None` if it is not set.
+    pub fn receive_batch_size(&self) -> Result<Option<usize>, Fail> {
+        let batch_size: usize =
+            if let Some(batch_size) = Self::get_typed_env_option(inetstack_config::RECEIVE_BATCH_SIZE)? {
+                batch_size
+            } else {
+                let section: &Yaml = self.get_inetstack_config()?;
+                if !Self::has_option(section, inetstack_config::RECEIVE_BATCH_SIZE) {
+                    return Ok(None);
+                }
+                Self::get_int_option(section, inetstack_config::RECEIVE_BATCH_SIZE)?
+            };
+
+        if batch_size == 0 || batch_size > RECEIVE_BATCH_SIZE {
+            let cause: String = format!(
+                "receive batch size must be between 1 and {} (batch_size={})",
+                RECEIVE_BATCH_SIZE, batch_size
+            );
+            error!("receive_batch_size(): {}", cause);
+            return Err(Fail::new(libc::ERANGE, &cause));
+        }
+        Ok(Some(batch_size))
+    }
+
     //======================================================================================================================
     // Static Functions
     //======================================================================================================================
@@ -385,6 +725,11 @@ impl Config {
         }
     }
 
+    /// Checks whether `yaml` has a value at `index`.
+    fn has_option(yaml: &Yaml, index: &str) -> bool {
+        !matches!(yaml.index(index), Yaml::BadValue)
+    }
+
     /// Index `yaml` to find the value at `index`, validating that the index exists.
     fn get_option<'a>(yaml: &'a Yaml, index: &str) -> Result<&'a Yaml, Fail> {
         match yaml.index(index) {
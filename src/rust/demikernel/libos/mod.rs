@@ -17,20 +17,24 @@ use crate::catpowder::SharedCatpowderRuntime;
 use crate::inetstack::SharedInetStack;
 #[cfg(feature = "profiler")]
 use crate::perftools::profiler::set_callback;
+#[cfg(feature = "catmem-libos")]
+use crate::{catmem::SharedCatmemLibOS, runtime::memory::MemoryRuntime};
 use crate::{
     demikernel::{
         config::Config,
         libos::network::{libos::SharedNetworkLibOS, NetworkLibOSWrapper},
     },
+    perftools::stats,
     runtime::{
         fail::Fail,
         limits, logging,
         network::socket::option::SocketOption,
-        types::{demi_callback_t, demi_qresult_t, demi_sgarray_t},
-        QDesc, QToken, SharedDemiRuntime,
+        types::{demi_callback_t, demi_qresult_t, demi_sgarray_t, demi_stats_t},
+        yield_with_timeout, QDesc, QToken, SharedDemiRuntime, WaitSetId,
     },
     timer,
 };
+use ::futures::FutureExt;
 use ::std::{
     env,
     net::{SocketAddr, SocketAddrV4},
@@ -49,6 +53,9 @@ const TIMEOUT_SECONDS: Duration = Duration::from_secs(256);
 
 pub enum LibOS {
     NetworkLibOS(NetworkLibOSWrapper),
+    /// Pipes between processes on shared memory. These have no sockets.
+    #[cfg(feature = "catmem-libos")]
+    MemoryLibOS(SharedCatmemLibOS),
 }
 
 //======================================================================================================================
@@ -56,7 +63,7 @@ pub enum LibOS {
 //======================================================================================================================
 
 impl LibOS {
-    pub fn new(libos_name: LibOSName, _perf_callback: Option<demi_callback_t>) -> Result<Self, Fail> {
+    pub fn new(libos_name: LibOSName, callback: Option<demi_callback_t>) -> Result<Self, Fail> {
         timer!("demikernel::new");
 
         logging::initialize();
@@ -72,13 +79,27 @@ impl LibOS {
         };
 
         #[cfg(feature = "profiler")]
-        if let Some(callback) = _perf_callback {
+        if let Some(callback) = callback {
             set_callback(callback)
         };
 
         let config: Config = Config::new(config_path)?;
         #[allow(unused_mut)]
         let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
+        match config.idle_policy()? {
+            Some(policy) => runtime.set_idle_policy(policy),
+            None => warn!("No setting for idle policy. Busy polling by default."),
+        };
+        match (config.stats_export_interval(), callback) {
+            (Ok(interval), Some(callback)) if !interval.is_zero() => {
+                runtime.insert_background_coroutine(
+                    "bgc::demikernel::export_stats",
+                    Box::pin(export_stats(callback, interval).fuse()),
+                )?;
+            },
+            (Ok(_), _) => (),
+            (Err(_), _) => warn!("No setting for statistics export. Statistics are not exported."),
+        };
         // Instantiate LibOS.
         #[allow(unreachable_patterns)]
         let libos: LibOS = match libos_name {
@@ -111,6 +132,8 @@ impl LibOS {
                     runtime, inetstack,
                 )))
             },
+            #[cfg(feature = "catmem-libos")]
+            LibOSName::Catmem => Self::MemoryLibOS(SharedCatmemLibOS::new(&config, runtime)?),
             _ => panic!("unsupported libos"),
         };
 
@@ -128,6 +151,8 @@ impl LibOS {
             timer!("demikernel::socket");
             match self {
                 LibOS::NetworkLibOS(libos) => libos.socket(domain, socket_type, protocol),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(_) => not_supported("socket"),
             }
         };
 
@@ -141,6 +166,8 @@ impl LibOS {
         let result: Result<(), Fail> = {
             match self {
                 LibOS::NetworkLibOS(libos) => libos.set_socket_option(sockqd, option),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(_) => not_supported("set_socket_option"),
             }
         };
 
@@ -154,6 +181,8 @@ impl LibOS {
         let result: Result<SocketOption, Fail> = {
             match self {
                 LibOS::NetworkLibOS(libos) => libos.get_socket_option(sockqd, option),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(_) => not_supported("get_socket_option"),
             }
         };
 
@@ -166,6 +195,27 @@ impl LibOS {
         let result: Result<SocketAddrV4, Fail> = {
             match self {
                 LibOS::NetworkLibOS(libos) => libos.getpeername(sockqd),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(_) => not_supported("getpeername"),
+            }
+        };
+
+        self.poll();
+
+        result
+    }
+
+    /// Returns the statistics of the socket referenced by [sockqd], or the statistics of the calling thread if there is
+    /// none.
+    pub fn get_stats(&mut self, sockqd: Option<QDesc>) -> Result<demi_stats_t, Fail> {
+        let result: Result<demi_stats_t, Fail> = {
+            match sockqd {
+                None => Ok(stats::snapshot()),
+                Some(sockqd) => match self {
+                    LibOS::NetworkLibOS(libos) => libos.get_stats(sockqd),
+                    #[cfg(feature = "catmem-libos")]
+                    LibOS::MemoryLibOS(_) => not_supported("get_stats"),
+                },
             }
         };
 
@@ -180,6 +230,8 @@ impl LibOS {
             timer!("demikernel::bind");
             match self {
                 LibOS::NetworkLibOS(libos) => libos.bind(sockqd, local),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(_) => not_supported("bind"),
             }
         };
 
@@ -195,6 +247,8 @@ impl LibOS {
             timer!("demikernel::listen");
             match self {
                 LibOS::NetworkLibOS(libos) => libos.listen(sockqd, backlog),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(_) => not_supported("listen"),
             }
         };
 
@@ -209,6 +263,8 @@ impl LibOS {
             timer!("demikernel::accept");
             match self {
                 LibOS::NetworkLibOS(libos) => libos.accept(sockqd),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(_) => not_supported("accept"),
             }
         };
 
@@ -223,6 +279,42 @@ impl LibOS {
             timer!("demikernel::connect");
             match self {
                 LibOS::NetworkLibOS(libos) => libos.connect(sockqd, remote),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(_) => not_supported("connect"),
+            }
+        };
+
+        self.poll();
+
+        result
+    }
+
+    /// Creates a pipe named `name` that another process opens with [LibOS::open_pipe].
+    #[allow(unused_variables)]
+    pub fn create_pipe(&mut self, name: &str) -> Result<QDesc, Fail> {
+        let result: Result<QDesc, Fail> = {
+            timer!("demikernel::create_pipe");
+            match self {
+                LibOS::NetworkLibOS(_) => not_supported("create_pipe"),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.create_pipe(name),
+            }
+        };
+
+        self.poll();
+
+        result
+    }
+
+    /// Opens a pipe named `name` that another process created with [LibOS::create_pipe].
+    #[allow(unused_variables)]
+    pub fn open_pipe(&mut self, name: &str) -> Result<QDesc, Fail> {
+        let result: Result<QDesc, Fail> = {
+            timer!("demikernel::open_pipe");
+            match self {
+                LibOS::NetworkLibOS(_) => not_supported("open_pipe"),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.open_pipe(name),
             }
         };
 
@@ -243,6 +335,14 @@ impl LibOS {
                     },
                     Err(e) => Err(e),
                 },
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => match libos.async_close(qd) {
+                    Ok(qt) => match self.wait(qt, None) {
+                        Ok(_) => Ok(()),
+                        Err(e) => Err(e),
+                    },
+                    Err(e) => Err(e),
+                },
             }
         };
 
@@ -256,6 +356,8 @@ impl LibOS {
             timer!("demikernel::async_close");
             match self {
                 LibOS::NetworkLibOS(libos) => libos.async_close(qd),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.async_close(qd),
             }
         };
 
@@ -270,6 +372,8 @@ impl LibOS {
             timer!("demikernel::push");
             match self {
                 LibOS::NetworkLibOS(libos) => libos.push(qd, sga),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.push(qd, sga),
             }
         };
 
@@ -285,6 +389,8 @@ impl LibOS {
             timer!("demikernel::pushto");
             match self {
                 LibOS::NetworkLibOS(libos) => libos.pushto(qd, sga, to),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(_) => not_supported("pushto"),
             }
         };
 
@@ -310,6 +416,112 @@ impl LibOS {
 
             match self {
                 LibOS::NetworkLibOS(libos) => libos.pop(qd, size),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.pop(qd, size),
+            }
+        };
+
+        self.poll();
+
+        result
+    }
+
+    /// Pushes a batch of scatter-gather arrays, where `sgas[i]` is pushed to the I/O queue `qds[i]` and the queue token
+    /// of that operation is stored in `qts_out[i]`. The operations are issued in order and the scheduler is polled
+    /// once for the whole batch rather than after every operation. If an operation fails, the ones that follow it are
+    /// not issued. Either way, `nsubmitted` holds the number of operations that were issued.
+    pub fn push_n(
+        &mut self,
+        qds: &[QDesc],
+        sgas: &[demi_sgarray_t],
+        qts_out: &mut [QToken],
+        nsubmitted: &mut usize,
+    ) -> Result<(), Fail> {
+        debug_assert_eq!(qds.len(), sgas.len());
+        debug_assert!(qts_out.len() >= qds.len());
+        let result: Result<(), Fail> = {
+            timer!("demikernel::push_n");
+            match self {
+                LibOS::NetworkLibOS(libos) => issue_batch(
+                    qds.iter()
+                        .zip(sgas.iter())
+                        .map(|(qd, sga): (&QDesc, &demi_sgarray_t)| libos.push(*qd, sga)),
+                    qts_out,
+                    nsubmitted,
+                ),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => issue_batch(
+                    qds.iter()
+                        .zip(sgas.iter())
+                        .map(|(qd, sga): (&QDesc, &demi_sgarray_t)| libos.push(*qd, sga)),
+                    qts_out,
+                    nsubmitted,
+                ),
+            }
+        };
+
+        self.poll();
+
+        result
+    }
+
+    /// Pushes a batch of scatter-gather arrays to UDP sockets, where `sgas[i]` is pushed to `tos[i]` on the socket
+    /// `qds[i]`. Operations are issued the same way as in [LibOS::push_n].
+    pub fn pushto_n(
+        &mut self,
+        qds: &[QDesc],
+        sgas: &[demi_sgarray_t],
+        tos: &[SocketAddr],
+        qts_out: &mut [QToken],
+        nsubmitted: &mut usize,
+    ) -> Result<(), Fail> {
+        debug_assert_eq!(qds.len(), sgas.len());
+        debug_assert_eq!(qds.len(), tos.len());
+        debug_assert!(qts_out.len() >= qds.len());
+        let result: Result<(), Fail> = {
+            timer!("demikernel::pushto_n");
+            match self {
+                LibOS::NetworkLibOS(libos) => issue_batch(
+                    qds.iter()
+                        .zip(sgas.iter())
+                        .zip(tos.iter())
+                        .map(|((qd, sga), to): ((&QDesc, &demi_sgarray_t), &SocketAddr)| libos.pushto(*qd, sga, *to)),
+                    qts_out,
+                    nsubmitted,
+                ),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(_) => {
+                    *nsubmitted = 0;
+                    not_supported("pushto_n")
+                },
+            }
+        };
+
+        self.poll();
+
+        result
+    }
+
+    /// Pops data from a batch of I/O queues, where the queue token of the pop on `qds[i]` is stored in `qts_out[i]`.
+    /// Like a pop without a size, every operation returns whatever the queue has. Operations are issued the same way as
+    /// in [LibOS::push_n].
+    pub fn pop_n(
+        &mut self,
+        qds: &[QDesc],
+        qts_out: &mut [QToken],
+        nsubmitted: &mut usize,
+    ) -> Result<(), Fail> {
+        debug_assert!(qts_out.len() >= qds.len());
+        let result: Result<(), Fail> = {
+            timer!("demikernel::pop_n");
+            match self {
+                LibOS::NetworkLibOS(libos) => {
+                    issue_batch(qds.iter().map(|qd: &QDesc| libos.pop(*qd, None)), qts_out, nsubmitted)
+                },
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => {
+                    issue_batch(qds.iter().map(|qd: &QDesc| libos.pop(*qd, None)), qts_out, nsubmitted)
+                },
             }
         };
 
@@ -324,6 +536,8 @@ impl LibOS {
         // No profiling scope here because we may enter a coroutine scope.
         match self {
             LibOS::NetworkLibOS(libos) => libos.wait(qt, timeout.unwrap_or(TIMEOUT_SECONDS)),
+            #[cfg(feature = "catmem-libos")]
+            LibOS::MemoryLibOS(libos) => libos.wait(qt, timeout.unwrap_or(TIMEOUT_SECONDS)),
         }
     }
 
@@ -332,9 +546,105 @@ impl LibOS {
         // No profiling scope here because we may enter a coroutine scope.
         match self {
             LibOS::NetworkLibOS(libos) => libos.wait_any(qts, timeout.unwrap_or(TIMEOUT_SECONDS)),
+            #[cfg(feature = "catmem-libos")]
+            LibOS::MemoryLibOS(libos) => libos.wait_any(qts, timeout.unwrap_or(TIMEOUT_SECONDS)),
         }
     }
 
+    /// Creates an empty wait set.
+    pub fn create_wait_set(&mut self) -> WaitSetId {
+        let result: WaitSetId = {
+            timer!("demikernel::create_wait_set");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.create_wait_set(),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.create_wait_set(),
+            }
+        };
+
+        result
+    }
+
+    /// Releases a wait set.
+    pub fn close_wait_set(&mut self, wsd: WaitSetId) -> Result<(), Fail> {
+        let result: Result<(), Fail> = {
+            timer!("demikernel::close_wait_set");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.close_wait_set(wsd),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.close_wait_set(wsd),
+            }
+        };
+
+        result
+    }
+
+    /// Adds a pending I/O operation to a wait set.
+    pub fn wait_set_add(&mut self, wsd: WaitSetId, qt: QToken) -> Result<(), Fail> {
+        let result: Result<(), Fail> = {
+            timer!("demikernel::wait_set_add");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.wait_set_add(wsd, qt),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.wait_set_add(wsd, qt),
+            }
+        };
+
+        result
+    }
+
+    /// Removes a pending I/O operation from a wait set.
+    pub fn wait_set_remove(&mut self, wsd: WaitSetId, qt: QToken) -> Result<(), Fail> {
+        let result: Result<(), Fail> = {
+            timer!("demikernel::wait_set_remove");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.wait_set_remove(wsd, qt),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.wait_set_remove(wsd, qt),
+            }
+        };
+
+        result
+    }
+
+    /// Waits for any of the pending I/O operations in a wait set to complete or a timeout to expire.
+    pub fn wait_set_wait(&mut self, wsd: WaitSetId, timeout: Option<Duration>) -> Result<demi_qresult_t, Fail> {
+        // No profiling scope here because we may enter a coroutine scope.
+        match self {
+            LibOS::NetworkLibOS(libos) => libos.wait_set_wait(wsd, timeout.unwrap_or(TIMEOUT_SECONDS)),
+            #[cfg(feature = "catmem-libos")]
+            LibOS::MemoryLibOS(libos) => libos.wait_set_wait(wsd, timeout.unwrap_or(TIMEOUT_SECONDS)),
+        }
+    }
+
+    /// Registers a completion queue in the `size` bytes of application memory at `ptr`.
+    pub fn register_completion_queue(&mut self, ptr: *mut u8, size: usize) -> Result<(), Fail> {
+        let result: Result<(), Fail> = {
+            timer!("demikernel::register_completion_queue");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.register_completion_queue(ptr, size),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.register_completion_queue(ptr, size),
+            }
+        };
+
+        result
+    }
+
+    /// Unregisters the completion queue.
+    pub fn unregister_completion_queue(&mut self) -> Result<(), Fail> {
+        let result: Result<(), Fail> = {
+            timer!("demikernel::unregister_completion_queue");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.unregister_completion_queue(),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.unregister_completion_queue(),
+            }
+        };
+
+        result
+    }
+
     /// Waits in a loop until the next task is complete, passing the result to `acceptor`. This process continues until
     /// either the acceptor returns false (in which case the method returns Ok), or the timeout has expired (in which
     /// the method returns an `Err` indicating timeout).
@@ -347,6 +657,8 @@ impl LibOS {
         // No profiling scope here because we may enter a coroutine scope.
         match self {
             LibOS::NetworkLibOS(libos) => libos.wait_next_n(acceptor, timeout.unwrap_or(TIMEOUT_SECONDS)),
+            #[cfg(feature = "catmem-libos")]
+            LibOS::MemoryLibOS(libos) => libos.wait_next_n(acceptor, timeout.unwrap_or(TIMEOUT_SECONDS)),
         }
     }
 
@@ -355,6 +667,21 @@ impl LibOS {
             timer!("demikernel::sgaalloc");
             match self {
                 LibOS::NetworkLibOS(libos) => libos.sgaalloc(size),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.sgaalloc(size),
+            }
+        };
+
+        result
+    }
+
+    pub fn sgaallocv(&mut self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
+        let result: Result<demi_sgarray_t, Fail> = {
+            timer!("demikernel::sgaallocv");
+            match self {
+                LibOS::NetworkLibOS(libos) => libos.sgaallocv(seglens),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.sgaallocv(seglens),
             }
         };
 
@@ -366,6 +693,8 @@ impl LibOS {
             timer!("demikernel::sgafree");
             match self {
                 LibOS::NetworkLibOS(libos) => libos.sgafree(sga),
+                #[cfg(feature = "catmem-libos")]
+                LibOS::MemoryLibOS(libos) => libos.sgafree(sga),
             }
         };
 
@@ -376,6 +705,42 @@ impl LibOS {
         // No profiling scope here because we may enter a coroutine scope.
         match self {
             LibOS::NetworkLibOS(libos) => libos.poll(),
+            #[cfg(feature = "catmem-libos")]
+            LibOS::MemoryLibOS(libos) => libos.poll(),
         }
     }
 }
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Fails an operation that the LibOS in use does not have.
+fn not_supported<T>(operation: &str) -> Result<T, Fail> {
+    let cause: String = format!("operation not supported by this LibOS (operation={:?})", operation);
+    error!("{}(): {}", operation, cause);
+    Err(Fail::new(libc::ENOTSUP, &cause))
+}
+
+/// Hands the statistics of the current thread to `callback` every `interval`.
+async fn export_stats(callback: demi_callback_t, interval: Duration) {
+    loop {
+        yield_with_timeout(interval).await;
+        stats::export(callback);
+    }
+}
+
+/// Issues the operations of a batch in order and stores their queue tokens in `qts_out`, stopping at the first
+/// operation that fails. On return, `nsubmitted` holds the number of operations that were issued.
+fn issue_batch<I: Iterator<Item = Result<QToken, Fail>>>(
+    ops: I,
+    qts_out: &mut [QToken],
+    nsubmitted: &mut usize,
+) -> Result<(), Fail> {
+    *nsubmitted = 0;
+    for (qt_out, op) in qts_out.iter_mut().zip(ops) {
+        *qt_out = op?;
+        *nsubmitted += 1;
+    }
+    Ok(())
+}
@@ -17,6 +17,7 @@ pub enum LibOSName {
     Catpowder,
     Catnap,
     Catnip,
+    Catmem,
 }
 
 //======================================================================================================================
@@ -43,6 +44,7 @@ impl From<String> for LibOSName {
             "catpowder" => LibOSName::Catpowder,
             "catnap" => LibOSName::Catnap,
             "catnip" => LibOSName::Catnip,
+            "catmem" => LibOSName::Catmem,
             _ => panic!("unknown libos"),
         }
     }
@@ -10,17 +10,21 @@ use crate::{
     expect_ok, expect_some,
     pal::{socketaddrv4_to_sockaddr, SOMAXCONN},
     runtime::{
+        completion_queue::{CompletionQueue, ResultFormatter},
         fail::Fail,
         limits,
         memory::DemiBuffer,
         network::{
-            socket::{option::SocketOption, SocketId},
+            socket::{
+                option::{SocketOption, MAX_SOCKET_PRIORITY},
+                SocketId,
+            },
             transport::NetworkTransport,
             unwrap_socketaddr,
         },
         queue::{downcast_queue, IoQueue, OperationResult},
-        types::{demi_accept_result_t, demi_opcode_t, demi_qr_value_t, demi_qresult_t, demi_sgarray_t},
-        QDesc, QToken, SharedDemiRuntime, SharedObject,
+        types::{demi_accept_result_t, demi_opcode_t, demi_qr_value_t, demi_qresult_t, demi_sgarray_t, demi_stats_t},
+        QDesc, QToken, SharedDemiRuntime, SharedObject, TaskId, WaitSetId,
     },
     QType,
 };
@@ -76,19 +80,47 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
             return Err(Fail::new(libc::ENOTSUP, &cause));
         }
 
-        let queue: SharedNetworkQueue<T> = SharedNetworkQueue::new(domain, typ, &mut self.transport)?;
+        // Every queue runs its coroutines in a task group of its own, so that busy queues cannot hold back others.
+        let task_group: TaskId = self.runtime.create_task_group();
+        let queue: SharedNetworkQueue<T> = match SharedNetworkQueue::new(domain, typ, &mut self.transport, task_group) {
+            Ok(queue) => queue,
+            Err(e) => {
+                self.runtime.remove_task_group(task_group);
+                return Err(e);
+            },
+        };
         let qd: QDesc = self.runtime.alloc_queue(queue);
         Ok(qd)
     }
 
     pub fn set_socket_option(&mut self, qd: QDesc, option: SocketOption) -> Result<(), Fail> {
         trace!("set_socket_option() qd={:?}, option={:?}", qd, option);
-        self.get_shared_queue(&qd)?.set_socket_option(option)
+        let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
+        match option {
+            // The priority of a queue is the weight of its task group in the scheduler, minus one.
+            SocketOption::Priority(priority) => {
+                if priority > MAX_SOCKET_PRIORITY {
+                    let cause: String = format!("invalid socket priority (qd={:?}, priority={:?})", qd, priority);
+                    warn!("set_socket_option(): {}", cause);
+                    return Err(Fail::new(libc::EINVAL, &cause));
+                }
+                self.runtime
+                    .set_task_group_weight(queue.task_group(), priority as usize + 1)
+            },
+            _ => queue.set_socket_option(option),
+        }
     }
 
     pub fn get_socket_option(&mut self, qd: QDesc, option: SocketOption) -> Result<SocketOption, Fail> {
         trace!("get_socket_option() qd={:?}, option={:?}", qd, option);
-        self.get_shared_queue(&qd)?.get_socket_option(option)
+        let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
+        match option {
+            SocketOption::Priority(_) => {
+                let weight: usize = self.runtime.get_task_group_weight(queue.task_group())?;
+                Ok(SocketOption::Priority((weight - 1) as u8))
+            },
+            _ => queue.get_socket_option(option),
+        }
     }
 
     pub fn getpeername(&mut self, qd: QDesc) -> Result<SocketAddrV4, Fail> {
@@ -96,6 +128,12 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         self.get_shared_queue(&qd)?.getpeername()
     }
 
+    /// Returns the statistics of the socket referred to by [qd].
+    pub fn get_stats(&mut self, qd: QDesc) -> Result<demi_stats_t, Fail> {
+        trace!("get_stats() qd={:?}", qd);
+        Ok(self.get_shared_queue(&qd)?.get_stats())
+    }
+
     /// This function contains the LibOS-level functionality needed to bind a SharedNetworkQueue to a local address.
     pub fn bind(&mut self, qd: QDesc, socket_addr: SocketAddr) -> Result<(), Fail> {
         trace!("bind() qd={:?}, local={:?}", qd, socket_addr);
@@ -155,11 +193,20 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         trace!("accept(): qd={:?}", qd);
 
         let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
+        let task_group: TaskId = queue.task_group();
         let coroutine_constructor = || -> Result<QToken, Fail> {
-            let coroutine = Box::pin(self.clone().accept_coroutine(qd).fuse());
-            self.runtime
-                .clone()
-                .insert_io_coroutine("ioc::network::libos::accept", coroutine)
+            // Task groups cannot be created from within coroutines, so create the one of the new queue right away.
+            let new_task_group: TaskId = self.runtime.clone().create_task_group();
+            let coroutine = Box::pin(self.clone().accept_coroutine(qd, new_task_group).fuse());
+            let result: Result<QToken, Fail> = self.runtime.clone().insert_io_coroutine_with_group_id(
+                task_group,
+                "ioc::network::libos::accept",
+                coroutine,
+            );
+            if result.is_err() {
+                self.runtime.clone().remove_task_group(new_task_group);
+            }
+            result
         };
 
         queue.accept(coroutine_constructor)
@@ -168,16 +215,19 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
     /// Asynchronous cross-queue code for accepting a connection. This function returns a coroutine that runs
     /// asynchronously to accept a connection and performs any necessary multi-queue operations at the LibOS-level after
     /// the accept succeeds or fails.
-    async fn accept_coroutine(mut self, qd: QDesc) -> (QDesc, OperationResult) {
+    async fn accept_coroutine(mut self, qd: QDesc, new_task_group: TaskId) -> (QDesc, OperationResult) {
         // Grab the queue, make sure it hasn't been closed in the meantime.
         // This will bump the Rc refcount so the coroutine can have it's own reference to the shared queue data
         // structure and the SharedNetworkQueue will not be freed until this coroutine finishes.
         let mut queue: SharedNetworkQueue<T> = match self.get_shared_queue(&qd) {
             Ok(queue) => queue.clone(),
-            Err(e) => return (qd, OperationResult::Failed(e)),
+            Err(e) => {
+                self.runtime.remove_task_group(new_task_group);
+                return (qd, OperationResult::Failed(e));
+            },
         };
         // Wait for the accept operation to complete.
-        match queue.accept_coroutine().await {
+        match queue.accept_coroutine(new_task_group).await {
             Ok(new_queue) => {
                 // TODO: Do we need to add this to the socket id to queue descriptor table?
                 // It is safe to call except here because the new queue is connected and it should be connected to a
@@ -193,6 +243,7 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
             },
             Err(e) => {
                 warn!("accept() listening_qd={:?}: {:?}", qd, &e);
+                self.runtime.remove_task_group(new_task_group);
                 (qd, OperationResult::Failed(e))
             },
         }
@@ -206,11 +257,14 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
 
         // FIXME: add IPv6 support; https://github.com/microsoft/demikernel/issues/935
         let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
+        let task_group: TaskId = queue.task_group();
         let coroutine_constructor = || -> Result<QToken, Fail> {
             let coroutine = Box::pin(self.clone().connect_coroutine(qd, remote).fuse());
-            self.runtime
-                .clone()
-                .insert_io_coroutine("ioc::network::libos::connect", coroutine)
+            self.runtime.clone().insert_io_coroutine_with_group_id(
+                task_group,
+                "ioc::network::libos::connect",
+                coroutine,
+            )
         };
 
         queue.connect(coroutine_constructor)
@@ -246,11 +300,12 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         trace!("async_close() qd={:?}", qd);
 
         let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
+        let task_group: TaskId = queue.task_group();
         let coroutine_constructor = || -> Result<QToken, Fail> {
             let coroutine = Box::pin(self.clone().close_coroutine(qd).fuse());
             self.runtime
                 .clone()
-                .insert_io_coroutine("ioc::network::libos::close", coroutine)
+                .insert_io_coroutine_with_group_id(task_group, "ioc::network::libos::close", coroutine)
         };
 
         queue.close(coroutine_constructor)
@@ -285,6 +340,8 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
                     self.runtime.free_queue::<SharedNetworkQueue<T>>(&qd),
                     "queue should exist"
                 );
+                // The task group goes away once its last coroutine, which may be this one, completes.
+                self.runtime.remove_task_group(queue.task_group());
                 (qd, OperationResult::Close)
             },
             Err(e) => {
@@ -299,18 +356,19 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
     /// begins.
     pub fn push(&mut self, qd: QDesc, sga: &demi_sgarray_t) -> Result<QToken, Fail> {
         let buf: DemiBuffer = self.transport.clone_sgarray(sga)?;
-        if buf.len() == 0 {
+        if buf.total_len() == 0 {
             let cause: String = format!("zero-length buffer");
             warn!("push(): {}", cause);
             return Err(Fail::new(libc::EINVAL, &cause));
         };
 
         let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
+        let task_group: TaskId = queue.task_group();
         let coroutine_constructor = || -> Result<QToken, Fail> {
             let coroutine = Box::pin(self.clone().push_coroutine(qd, buf).fuse());
             self.runtime
                 .clone()
-                .insert_io_coroutine("ioc::network::libos::push", coroutine)
+                .insert_io_coroutine_with_group_id(task_group, "ioc::network::libos::push", coroutine)
         };
 
         queue.push(coroutine_constructor)
@@ -344,16 +402,17 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         trace!("pushto() qd={:?}", qd);
 
         let buf: DemiBuffer = self.transport.clone_sgarray(sga)?;
-        if buf.len() == 0 {
+        if buf.total_len() == 0 {
             return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
         }
 
         let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
+        let task_group: TaskId = queue.task_group();
         let coroutine_constructor = || -> Result<QToken, Fail> {
             let coroutine = Box::pin(self.clone().pushto_coroutine(qd, buf, remote).fuse());
             self.runtime
                 .clone()
-                .insert_io_coroutine("ioc::network::libos::pushto", coroutine)
+                .insert_io_coroutine_with_group_id(task_group, "ioc::network::libos::pushto", coroutine)
         };
 
         queue.push(coroutine_constructor)
@@ -390,11 +449,12 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         debug_assert!(size.is_none() || ((size.unwrap() > 0) && (size.unwrap() <= limits::POP_SIZE_MAX)));
 
         let mut queue: SharedNetworkQueue<T> = self.get_shared_queue(&qd)?;
+        let task_group: TaskId = queue.task_group();
         let coroutine_constructor = || -> Result<QToken, Fail> {
             let coroutine = Box::pin(self.clone().pop_coroutine(qd, size).fuse());
             self.runtime
                 .clone()
-                .insert_io_coroutine("ioc::network::libos::pop", coroutine)
+                .insert_io_coroutine_with_group_id(task_group, "ioc::network::libos::pop", coroutine)
         };
 
         queue.pop(coroutine_constructor)
@@ -447,6 +507,36 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         Ok((offset, self.create_result(result, qd, qt)))
     }
 
+    /// Creates an empty wait set.
+    pub fn create_wait_set(&mut self) -> WaitSetId {
+        trace!("create_wait_set()");
+        self.runtime.create_wait_set()
+    }
+
+    /// Releases a wait set.
+    pub fn close_wait_set(&mut self, wsd: WaitSetId) -> Result<(), Fail> {
+        trace!("close_wait_set(): wsd={:?}", wsd);
+        self.runtime.close_wait_set(wsd)
+    }
+
+    /// Adds a pending I/O operation to a wait set.
+    pub fn wait_set_add(&mut self, wsd: WaitSetId, qt: QToken) -> Result<(), Fail> {
+        trace!("wait_set_add(): wsd={:?}, qt={:?}", wsd, qt);
+        self.runtime.wait_set_add(wsd, qt)
+    }
+
+    /// Removes a pending I/O operation from a wait set.
+    pub fn wait_set_remove(&mut self, wsd: WaitSetId, qt: QToken) -> Result<(), Fail> {
+        trace!("wait_set_remove(): wsd={:?}, qt={:?}", wsd, qt);
+        self.runtime.wait_set_remove(wsd, qt)
+    }
+
+    /// Waits for any of the pending I/O operations in a wait set to complete or a timeout to expire.
+    pub fn wait_set_wait(&mut self, wsd: WaitSetId, timeout: Duration) -> Result<demi_qresult_t, Fail> {
+        let (qt, qd, result) = self.runtime.wait_set_wait(wsd, timeout)?;
+        Ok(self.create_result(result, qd, qt))
+    }
+
     /// Waits in a loop until the next task is complete, passing the result to `acceptor`. This process continues until
     /// either the acceptor returns false (in which case the method returns Ok), or the timeout has expired (in which
     /// the method returns an `Err` indicating timeout).
@@ -461,80 +551,24 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
     }
 
     pub fn create_result(&self, result: OperationResult, qd: QDesc, qt: QToken) -> demi_qresult_t {
-        match result {
-            OperationResult::Connect => demi_qresult_t {
-                qr_opcode: demi_opcode_t::DEMI_OPC_CONNECT,
-                qr_qd: qd.into(),
-                qr_qt: qt.into(),
-                qr_ret: 0,
-                qr_value: unsafe { mem::zeroed() },
-            },
-            OperationResult::Accept((new_qd, addr)) => {
-                let saddr: libc::sockaddr = socketaddrv4_to_sockaddr(&addr);
-                let qr_value: demi_qr_value_t = demi_qr_value_t {
-                    ares: demi_accept_result_t {
-                        qd: new_qd.into(),
-                        addr: saddr,
-                    },
-                };
-                demi_qresult_t {
-                    qr_opcode: demi_opcode_t::DEMI_OPC_ACCEPT,
-                    qr_qd: qd.into(),
-                    qr_qt: qt.into(),
-                    qr_ret: 0,
-                    qr_value,
-                }
-            },
-            OperationResult::Push => demi_qresult_t {
-                qr_opcode: demi_opcode_t::DEMI_OPC_PUSH,
-                qr_qd: qd.into(),
-                qr_qt: qt.into(),
-                qr_ret: 0,
-                qr_value: unsafe { mem::zeroed() },
-            },
-            OperationResult::Pop(addr, bytes) => match self.transport.into_sgarray(bytes) {
-                Ok(mut sga) => {
-                    if let Some(addr) = addr {
-                        sga.sga_addr = socketaddrv4_to_sockaddr(&addr);
-                    }
-                    let qr_value: demi_qr_value_t = demi_qr_value_t { sga };
-                    demi_qresult_t {
-                        qr_opcode: demi_opcode_t::DEMI_OPC_POP,
-                        qr_qd: qd.into(),
-                        qr_qt: qt.into(),
-                        qr_ret: 0,
-                        qr_value,
-                    }
-                },
-                Err(e) => {
-                    warn!("Operation Failed: {:?}", e);
-                    demi_qresult_t {
-                        qr_opcode: demi_opcode_t::DEMI_OPC_FAILED,
-                        qr_qd: qd.into(),
-                        qr_qt: qt.into(),
-                        qr_ret: e.errno as i64,
-                        qr_value: unsafe { mem::zeroed() },
-                    }
-                },
-            },
-            OperationResult::Close => demi_qresult_t {
-                qr_opcode: demi_opcode_t::DEMI_OPC_CLOSE,
-                qr_qd: qd.into(),
-                qr_qt: qt.into(),
-                qr_ret: 0,
-                qr_value: unsafe { mem::zeroed() },
-            },
-            OperationResult::Failed(e) => {
-                warn!("Operation Failed: {:?}", e);
-                demi_qresult_t {
-                    qr_opcode: demi_opcode_t::DEMI_OPC_FAILED,
-                    qr_qd: qd.into(),
-                    qr_qt: qt.into(),
-                    qr_ret: e.errno as i64,
-                    qr_value: unsafe { mem::zeroed() },
-                }
-            },
-        }
+        create_result(&self.transport, result, qd, qt)
+    }
+
+    /// Registers a completion queue in the `size` bytes of application memory at `ptr`. Results of operations that
+    /// complete while the application is not waiting on them are written straight into it.
+    pub fn register_completion_queue(&mut self, ptr: *mut u8, size: usize) -> Result<(), Fail> {
+        trace!("register_completion_queue(): ptr={:?}, size={:?}", ptr, size);
+        let transport: T = self.transport.clone();
+        let format: ResultFormatter =
+            Box::new(move |qt: QToken, qd: QDesc, result: OperationResult| create_result(&transport, result, qd, qt));
+        let cq: CompletionQueue = CompletionQueue::from_raw_parts(ptr, size, format)?;
+        self.runtime.register_completion_queue(cq)
+    }
+
+    /// Unregisters the completion queue. Results of operations that complete afterwards are kept until waited on.
+    pub fn unregister_completion_queue(&mut self) -> Result<(), Fail> {
+        trace!("unregister_completion_queue()");
+        self.runtime.unregister_completion_queue()
     }
 
     /// Allocates a scatter-gather array.
@@ -542,6 +576,11 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
         self.transport.sgaalloc(size)
     }
 
+    /// Allocates a scatter-gather array with one segment of each of the sizes in `seglens`.
+    pub fn sgaallocv(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
+        self.transport.sgaallocv(seglens)
+    }
+
     /// Runs all runnable coroutines.
     pub fn poll(&mut self) {
         self.runtime.poll()
@@ -569,6 +608,95 @@ impl<T: NetworkTransport> SharedNetworkLibOS<T> {
     }
 }
 
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Converts the result of a completed operation into its representation for the application.
+fn create_result<T: NetworkTransport>(transport: &T, result: OperationResult, qd: QDesc, qt: QToken) -> demi_qresult_t {
+    match result {
+        OperationResult::Connect => demi_qresult_t {
+            qr_opcode: demi_opcode_t::DEMI_OPC_CONNECT,
+            qr_qd: qd.into(),
+            qr_qt: qt.into(),
+            qr_ret: 0,
+            qr_value: unsafe { mem::zeroed() },
+            qr_pad: 0,
+        },
+        OperationResult::Accept((new_qd, addr)) => {
+            let saddr: libc::sockaddr = socketaddrv4_to_sockaddr(&addr);
+            let qr_value: demi_qr_value_t = demi_qr_value_t {
+                ares: demi_accept_result_t {
+                    qd: new_qd.into(),
+                    addr: saddr,
+                },
+            };
+            demi_qresult_t {
+                qr_opcode: demi_opcode_t::DEMI_OPC_ACCEPT,
+                qr_qd: qd.into(),
+                qr_qt: qt.into(),
+                qr_ret: 0,
+                qr_value,
+                qr_pad: 0,
+            }
+        },
+        OperationResult::Push => demi_qresult_t {
+            qr_opcode: demi_opcode_t::DEMI_OPC_PUSH,
+            qr_qd: qd.into(),
+            qr_qt: qt.into(),
+            qr_ret: 0,
+            qr_value: unsafe { mem::zeroed() },
+            qr_pad: 0,
+        },
+        OperationResult::Pop(addr, bytes) => match transport.into_sgarray(bytes) {
+            Ok(mut sga) => {
+                if let Some(addr) = addr {
+                    sga.sga_addr = socketaddrv4_to_sockaddr(&addr);
+                }
+                let qr_value: demi_qr_value_t = demi_qr_value_t { sga };
+                demi_qresult_t {
+                    qr_opcode: demi_opcode_t::DEMI_OPC_POP,
+                    qr_qd: qd.into(),
+                    qr_qt: qt.into(),
+                    qr_ret: 0,
+                    qr_value,
+                    qr_pad: 0,
+                }
+            },
+            Err(e) => {
+                warn!("Operation Failed: {:?}", e);
+                demi_qresult_t {
+                    qr_opcode: demi_opcode_t::DEMI_OPC_FAILED,
+                    qr_qd: qd.into(),
+                    qr_qt: qt.into(),
+                    qr_ret: e.errno as i64,
+                    qr_value: unsafe { mem::zeroed() },
+                    qr_pad: 0,
+                }
+            },
+        },
+        OperationResult::Close => demi_qresult_t {
+            qr_opcode: demi_opcode_t::DEMI_OPC_CLOSE,
+            qr_qd: qd.into(),
+            qr_qt: qt.into(),
+            qr_ret: 0,
+            qr_value: unsafe { mem::zeroed() },
+            qr_pad: 0,
+        },
+        OperationResult::Failed(e) => {
+            warn!("Operation Failed: {:?}", e);
+            demi_qresult_t {
+                qr_opcode: demi_opcode_t::DEMI_OPC_FAILED,
+                qr_qd: qd.into(),
+                qr_qt: qt.into(),
+                qr_ret: e.errno as i64,
+                qr_value: unsafe { mem::zeroed() },
+                qr_pad: 0,
+            }
+        },
+    }
+}
+
 //======================================================================================================================
 // Trait Implementations
 //======================================================================================================================
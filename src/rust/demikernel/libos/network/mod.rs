@@ -18,8 +18,8 @@ use crate::{
     runtime::{
         fail::Fail,
         network::socket::option::SocketOption,
-        types::{demi_qresult_t, demi_sgarray_t},
-        QDesc, QToken,
+        types::{demi_qresult_t, demi_sgarray_t, demi_stats_t},
+        QDesc, QToken, WaitSetId,
     },
 };
 use ::std::{
@@ -106,6 +106,18 @@ impl NetworkLibOSWrapper {
         }
     }
 
+    /// Returns the statistics of a socket.
+    pub fn get_stats(&mut self, sockqd: QDesc) -> Result<demi_stats_t, Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.get_stats(sockqd),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.get_stats(sockqd),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.get_stats(sockqd),
+        }
+    }
+
     /// Binds a socket to a local address.
     pub fn bind(&mut self, sockqd: QDesc, local: SocketAddr) -> Result<(), Fail> {
         match self {
@@ -243,6 +255,90 @@ impl NetworkLibOSWrapper {
         }
     }
 
+    /// Creates an empty wait set.
+    pub fn create_wait_set(&mut self) -> WaitSetId {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.create_wait_set(),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.create_wait_set(),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.create_wait_set(),
+        }
+    }
+
+    /// Releases a wait set.
+    pub fn close_wait_set(&mut self, wsd: WaitSetId) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.close_wait_set(wsd),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.close_wait_set(wsd),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.close_wait_set(wsd),
+        }
+    }
+
+    /// Adds a pending I/O operation to a wait set.
+    pub fn wait_set_add(&mut self, wsd: WaitSetId, qt: QToken) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.wait_set_add(wsd, qt),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.wait_set_add(wsd, qt),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.wait_set_add(wsd, qt),
+        }
+    }
+
+    /// Removes a pending I/O operation from a wait set.
+    pub fn wait_set_remove(&mut self, wsd: WaitSetId, qt: QToken) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.wait_set_remove(wsd, qt),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.wait_set_remove(wsd, qt),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.wait_set_remove(wsd, qt),
+        }
+    }
+
+    /// Waits for any of the pending I/O operations in a wait set to complete or a timeout to expire.
+    pub fn wait_set_wait(&mut self, wsd: WaitSetId, timeout: Duration) -> Result<demi_qresult_t, Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.wait_set_wait(wsd, timeout),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.wait_set_wait(wsd, timeout),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.wait_set_wait(wsd, timeout),
+        }
+    }
+
+    /// Registers a completion queue in application memory.
+    pub fn register_completion_queue(&mut self, ptr: *mut u8, size: usize) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.register_completion_queue(ptr, size),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.register_completion_queue(ptr, size),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.register_completion_queue(ptr, size),
+        }
+    }
+
+    /// Unregisters the completion queue.
+    pub fn unregister_completion_queue(&mut self) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.unregister_completion_queue(),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.unregister_completion_queue(),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.unregister_completion_queue(),
+        }
+    }
+
     /// Waits in a loop until the next task is complete, passing the result to `acceptor`. This process continues until
     /// either the acceptor returns false (in which case the method returns Ok), or the timeout has expired (in which
     /// the method returns an `Err` indicating timeout).
@@ -289,6 +385,18 @@ impl NetworkLibOSWrapper {
         }
     }
 
+    /// Allocates a scatter-gather array with multiple segments.
+    pub fn sgaallocv(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOSWrapper::Catpowder(libos) => libos.sgaallocv(seglens),
+            #[cfg(all(feature = "catnap-libos"))]
+            NetworkLibOSWrapper::Catnap(libos) => libos.sgaallocv(seglens),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOSWrapper::Catnip(libos) => libos.sgaallocv(seglens),
+        }
+    }
+
     /// Releases a scatter-gather array.
     pub fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
         match self {
@@ -5,16 +5,20 @@
 // Imports
 //======================================================================================================================
 
-use crate::runtime::{
-    fail::Fail,
-    limits,
-    memory::DemiBuffer,
-    network::{
-        socket::{operation::SocketOp, option::SocketOption, state::SocketStateMachine},
-        transport::NetworkTransport,
+use crate::{
+    perftools::stats::{self, Counter, Counters, Latency},
+    runtime::{
+        fail::Fail,
+        limits,
+        memory::DemiBuffer,
+        network::{
+            socket::{operation::SocketOp, option::SocketOption, state::SocketStateMachine},
+            transport::NetworkTransport,
+        },
+        queue::{IoQueue, QType},
+        types::demi_stats_t,
+        QToken, SharedObject, TaskId,
     },
-    queue::{IoQueue, QType},
-    QToken, SharedObject,
 };
 use ::futures::{pin_mut, select_biased, FutureExt};
 use ::socket2::{Domain, Type};
@@ -22,6 +26,7 @@ use ::std::{
     any::Any,
     net::{SocketAddr, SocketAddrV4},
     ops::{Deref, DerefMut},
+    time::Instant,
 };
 
 //======================================================================================================================
@@ -43,6 +48,10 @@ pub struct NetworkQueue<T: NetworkTransport> {
     remote: Option<SocketAddr>,
     /// Underlying network transport.
     transport: T,
+    /// Task group that runs the coroutines of this queue.
+    task_group: TaskId,
+    /// Packets and bytes that were pushed to and popped from this queue.
+    counters: Counters,
 }
 
 #[derive(Clone)]
@@ -54,7 +63,7 @@ pub struct SharedNetworkQueue<T: NetworkTransport>(SharedObject<NetworkQueue<T>>
 
 /// Associate Functions for Catnap LibOS
 impl<T: NetworkTransport> SharedNetworkQueue<T> {
-    pub fn new(domain: Domain, typ: Type, transport: &mut T) -> Result<Self, Fail> {
+    pub fn new(domain: Domain, typ: Type, transport: &mut T, task_group: TaskId) -> Result<Self, Fail> {
         // This was previously checked in the LibOS layer.
         debug_assert!(typ == Type::STREAM || typ == Type::DGRAM);
 
@@ -73,6 +82,8 @@ impl<T: NetworkTransport> SharedNetworkQueue<T> {
             local: None,
             remote: None,
             transport: transport.clone(),
+            task_group,
+            counters: Counters::new(),
         })))
     }
 
@@ -93,6 +104,13 @@ impl<T: NetworkTransport> SharedNetworkQueue<T> {
         self.transport.clone().get_socket_option(&mut self.socket, option)
     }
 
+    /// Returns the packets and bytes that were pushed to and popped from this queue. Latencies are only kept per thread.
+    pub fn get_stats(&self) -> demi_stats_t {
+        let mut out: demi_stats_t = demi_stats_t::default();
+        self.counters.fill(&mut out);
+        out
+    }
+
     /// Gets the peer address connected to the socket.
     pub fn getpeername(&mut self) -> Result<SocketAddrV4, Fail> {
         self.transport.clone().getpeername(&mut self.socket)
@@ -143,8 +161,9 @@ impl<T: NetworkTransport> SharedNetworkQueue<T> {
     }
 
     /// Asynchronously accepts a new connection on the queue. This function contains all of the single-queue,
-    /// asynchronous code necessary to run an accept and any single-queue functionality after the accept completes.
-    pub async fn accept_coroutine(&mut self) -> Result<Self, Fail> {
+    /// asynchronous code necessary to run an accept and any single-queue functionality after the accept completes. The
+    /// coroutines of the new queue run in `task_group`.
+    pub async fn accept_coroutine(&mut self, task_group: TaskId) -> Result<Self, Fail> {
         // 1. Check if we are still in a state where we can accept.
         self.state_machine.may_accept()?;
 
@@ -175,6 +194,8 @@ impl<T: NetworkTransport> SharedNetworkQueue<T> {
             local: None,
             remote: Some(saddr),
             transport: self.transport.clone(),
+            task_group,
+            counters: Counters::new(),
         })))
     }
 
@@ -278,6 +299,8 @@ impl<T: NetworkTransport> SharedNetworkQueue<T> {
     /// necessary to push to the queue and any single-queue functionality after the push completes.
     pub async fn push_coroutine(&mut self, buf: &mut DemiBuffer, addr: Option<SocketAddr>) -> Result<(), Fail> {
         self.state_machine.may_push()?;
+        let issued: Instant = Instant::now();
+        let len: usize = buf.total_len();
 
         let result = {
             let mut state_machine: SocketStateMachine = self.state_machine.clone();
@@ -294,6 +317,9 @@ impl<T: NetworkTransport> SharedNetworkQueue<T> {
         };
         if result.is_ok() {
             debug_assert_eq!(buf.len(), 0);
+            self.counters.add(Counter::PacketsOut, 1);
+            self.counters.add(Counter::BytesOut, len as u64);
+            stats::record(Latency::PushCompletion, issued.elapsed());
         }
         result
     }
@@ -314,6 +340,7 @@ impl<T: NetworkTransport> SharedNetworkQueue<T> {
     pub async fn pop_coroutine(&mut self, size: Option<usize>) -> Result<(Option<SocketAddr>, DemiBuffer), Fail> {
         self.state_machine.may_pop()?;
         let size: usize = size.unwrap_or(limits::RECVBUF_SIZE_MAX);
+        let issued: Instant = Instant::now();
 
         let mut state_machine: SocketStateMachine = self.state_machine.clone();
         let mut transport: T = self.transport.clone();
@@ -322,10 +349,16 @@ impl<T: NetworkTransport> SharedNetworkQueue<T> {
         pin_mut!(state_tracker);
         pin_mut!(operation);
 
-        select_biased! {
+        let result: Result<(Option<SocketAddr>, DemiBuffer), Fail> = select_biased! {
             fail = state_tracker => Err(fail),
             result = operation => result,
+        };
+        if let Ok((_, ref buf)) = result {
+            self.counters.add(Counter::PacketsIn, 1);
+            self.counters.add(Counter::BytesIn, buf.len() as u64);
+            stats::record(Latency::PopWait, issued.elapsed());
         }
+        result
     }
 
     /// Generic function for spawning a control-path coroutine on [self].
@@ -357,6 +390,10 @@ impl<T: NetworkTransport> SharedNetworkQueue<T> {
     pub fn remote(&self) -> Option<SocketAddr> {
         self.remote
     }
+
+    pub fn task_group(&self) -> TaskId {
+        self.task_group
+    }
 }
 
 //======================================================================================================================
@@ -94,13 +94,15 @@ impl SharedInetStack {
 
     /// Scheduler will poll all futures that are ready to make progress.
     /// Then ask the runtime to receive new data which we will forward to the engine to parse and
-    /// route to the correct protocol.
+    /// route to the correct protocol. Packets staged for transmission during this pass (including any responses to the
+    /// packets that we just received) are flushed to the physical layer before yielding.
     pub async fn poll(mut self) {
         timer!("inetstack::poll");
         loop {
             for _ in 0..MAX_RECV_ITERS {
                 self.layer4_endpoint.poll_once();
             }
+            self.layer4_endpoint.flush();
             poll_yield().await;
         }
     }
@@ -310,8 +312,8 @@ impl MemoryRuntime for SharedInetStack {
         self.layer4_endpoint.into_sgarray(buf)
     }
 
-    fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        self.layer4_endpoint.sgaalloc(size)
+    fn sgaallocv(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
+        self.layer4_endpoint.sgaallocv(seglens)
     }
 
     fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
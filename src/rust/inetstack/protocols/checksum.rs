@@ -0,0 +1,395 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Internet checksum (RFC 1071) kernels.
+//!
+//! The one's complement sum of a buffer does not depend on the order in which its 16-bit words are added, nor on how
+//! wide the accumulator is, as long as the carries are folded back in at the end. The kernels below exploit this to
+//! add up native-endian words, many at a time, and swap the bytes of the folded result once. The fastest kernel that
+//! the CPU supports is picked the first time that a checksum is computed.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+#[cfg(target_arch = "aarch64")]
+use ::std::arch::aarch64::{uint32x4_t, vaddlvq_u32, vdupq_n_u32, vld1q_u8, vpadalq_u16, vreinterpretq_u16_u8};
+#[cfg(target_arch = "x86_64")]
+use ::std::arch::x86_64::{
+    __m128i, __m256i, _mm256_add_epi32, _mm256_and_si256, _mm256_loadu_si256, _mm256_set1_epi32, _mm256_setzero_si256,
+    _mm256_srli_epi32, _mm256_storeu_si256, _mm_add_epi32, _mm_blend_epi16, _mm_loadu_si128, _mm_setzero_si128,
+    _mm_srli_epi32, _mm_storeu_si128,
+};
+use ::std::sync::OnceLock;
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of bytes that a vector kernel adds up before it spills its 32-bit lanes into a 64-bit sum. Every lane grows by
+/// at most 2 * 0xffff per vector, so this keeps the lanes from overflowing for vectors of 16 bytes or more.
+const KERNEL_BLOCK_SIZE: usize = 256 * 1024;
+
+/// Buffers shorter than this (e.g. bare headers) are added up with the portable kernel, which is faster than setting up
+/// vectors for them.
+const MIN_VECTOR_KERNEL_LEN: usize = 128;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Adds up the native-endian 16-bit words of a buffer, padding an odd trailing byte with zero. The result is not
+/// folded.
+type SumKernel = unsafe fn(&[u8]) -> u64;
+
+//======================================================================================================================
+// Static Variables
+//======================================================================================================================
+
+/// Kernel that is used on this CPU.
+static SUM_KERNEL: OnceLock<SumKernel> = OnceLock::new();
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Computes the one's complement sum of the 16-bit big-endian words of `data`, padding an odd trailing byte with zero.
+/// The result is folded to 16 bits but not complemented, so sums of several buffers can be combined with
+/// [ones_complement_add]. Note that all buffers but the last one must have an even length.
+pub fn ones_complement_sum(data: &[u8]) -> u16 {
+    let sum: u16 = if data.len() < MIN_VECTOR_KERNEL_LEN {
+        fold(sum_scalar(data))
+    } else {
+        let kernel: SumKernel = *SUM_KERNEL.get_or_init(select_kernel);
+        // Safety: the kernel was picked only if the CPU supports the instructions that it uses.
+        fold(unsafe { kernel(data) })
+    };
+    if cfg!(target_endian = "little") {
+        sum.swap_bytes()
+    } else {
+        sum
+    }
+}
+
+/// Adds two one's complement sums.
+pub fn ones_complement_add(a: u16, b: u16) -> u16 {
+    let sum: u32 = a as u32 + b as u32;
+    ((sum & 0xffff) + (sum >> 16)) as u16
+}
+
+/// Computes the internet checksum of `data`.
+pub fn internet_checksum(data: &[u8]) -> u16 {
+    !ones_complement_add(0xffff, ones_complement_sum(data))
+}
+
+/// Updates `checksum` after the 16-bit word `old` of the checksummed data is replaced with `new`, without going over the
+/// data again. This is Eqn. 3 of RFC 1624: `HC' = ~(~HC + ~m + m')`.
+/// See: https://www.rfc-editor.org/rfc/rfc1624#section-3
+pub fn update16(checksum: u16, old: u16, new: u16) -> u16 {
+    !ones_complement_add(ones_complement_add(!checksum, !old), new)
+}
+
+/// Updates `checksum` after a 32-bit field of the checksummed data (e.g. a sequence number) is replaced. See
+/// [update16].
+pub fn update32(checksum: u16, old: u32, new: u32) -> u16 {
+    let checksum: u16 = update16(checksum, (old >> 16) as u16, (new >> 16) as u16);
+    update16(checksum, old as u16, new as u16)
+}
+
+/// Folds a sum of 16-bit words into 16 bits with end-around carries. This keeps the sum congruent modulo 0xffff and only
+/// returns zero if the sum is zero.
+fn fold(mut sum: u64) -> u16 {
+    sum = (sum & 0xffff_ffff) + (sum >> 32);
+    sum = (sum & 0xffff_ffff) + (sum >> 32);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum as u16
+}
+
+/// Picks the fastest kernel that the CPU supports.
+fn select_kernel() -> SumKernel {
+    #[cfg(target_arch = "x86_64")]
+    {
+        if is_x86_feature_detected!("avx2") {
+            return sum_avx2;
+        }
+        if is_x86_feature_detected!("sse4.1") {
+            return sum_sse41;
+        }
+    }
+    #[cfg(target_arch = "aarch64")]
+    {
+        if ::std::arch::is_aarch64_feature_detected!("neon") {
+            return sum_neon;
+        }
+    }
+    sum_scalar
+}
+
+/// Portable kernel. This adds up 64-bit words, one 32-bit half at a time, so that the sum cannot overflow.
+fn sum_scalar(data: &[u8]) -> u64 {
+    let mut sum: u64 = 0;
+    let mut chunks: ::std::slice::ChunksExact<u8> = data.chunks_exact(8);
+    for chunk in &mut chunks {
+        let word: u64 = u64::from_ne_bytes([
+            chunk[0], chunk[1], chunk[2], chunk[3], chunk[4], chunk[5], chunk[6], chunk[7],
+        ]);
+        sum += (word & 0xffff_ffff) + (word >> 32);
+    }
+
+    // Pad the tail with zeros. This also pads an odd trailing byte as the low-order byte of a big-endian word.
+    let remainder: &[u8] = chunks.remainder();
+    if !remainder.is_empty() {
+        let mut tail: [u8; 8] = [0; 8];
+        tail[..remainder.len()].copy_from_slice(remainder);
+        let word: u64 = u64::from_ne_bytes(tail);
+        sum += (word & 0xffff_ffff) + (word >> 32);
+    }
+    sum
+}
+
+/// AVX2 kernel. This splits every 32-bit lane into its two 16-bit words and adds both to the lane.
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn sum_avx2(data: &[u8]) -> u64 {
+    const VECTOR_SIZE: usize = 32;
+    let mask: __m256i = _mm256_set1_epi32(0xffff);
+    let mut sum: u64 = 0;
+    for block in data.chunks(KERNEL_BLOCK_SIZE) {
+        let mut acc: __m256i = _mm256_setzero_si256();
+        let mut chunks: ::std::slice::ChunksExact<u8> = block.chunks_exact(VECTOR_SIZE);
+        for chunk in &mut chunks {
+            let v: __m256i = _mm256_loadu_si256(chunk.as_ptr() as *const __m256i);
+            acc = _mm256_add_epi32(acc, _mm256_and_si256(v, mask));
+            acc = _mm256_add_epi32(acc, _mm256_srli_epi32(v, 16));
+        }
+
+        let mut lanes: [u32; 8] = [0; 8];
+        _mm256_storeu_si256(lanes.as_mut_ptr() as *mut __m256i, acc);
+        sum += lanes.iter().map(|&lane| lane as u64).sum::<u64>();
+        sum += sum_scalar(chunks.remainder());
+    }
+    sum
+}
+
+/// SSE4.1 kernel. This works like [sum_avx2] on vectors of half the width.
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse4.1")]
+unsafe fn sum_sse41(data: &[u8]) -> u64 {
+    const VECTOR_SIZE: usize = 16;
+    let zero: __m128i = _mm_setzero_si128();
+    let mut sum: u64 = 0;
+    for block in data.chunks(KERNEL_BLOCK_SIZE) {
+        let mut acc: __m128i = _mm_setzero_si128();
+        let mut chunks: ::std::slice::ChunksExact<u8> = block.chunks_exact(VECTOR_SIZE);
+        for chunk in &mut chunks {
+            let v: __m128i = _mm_loadu_si128(chunk.as_ptr() as *const __m128i);
+            // Keep the low-order word of every lane by blending zeros into the high-order ones.
+            acc = _mm_add_epi32(acc, _mm_blend_epi16(v, zero, 0xaa));
+            acc = _mm_add_epi32(acc, _mm_srli_epi32(v, 16));
+        }
+
+        let mut lanes: [u32; 4] = [0; 4];
+        _mm_storeu_si128(lanes.as_mut_ptr() as *mut __m128i, acc);
+        sum += lanes.iter().map(|&lane| lane as u64).sum::<u64>();
+        sum += sum_scalar(chunks.remainder());
+    }
+    sum
+}
+
+/// NEON kernel. This adds adjacent 16-bit words into 32-bit lanes with a single pairwise add-accumulate.
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn sum_neon(data: &[u8]) -> u64 {
+    const VECTOR_SIZE: usize = 16;
+    let mut sum: u64 = 0;
+    for block in data.chunks(KERNEL_BLOCK_SIZE) {
+        let mut acc: uint32x4_t = vdupq_n_u32(0);
+        let mut chunks: ::std::slice::ChunksExact<u8> = block.chunks_exact(VECTOR_SIZE);
+        for chunk in &mut chunks {
+            acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(chunk.as_ptr())));
+        }
+        sum += vaddlvq_u32(acc);
+        sum += sum_scalar(chunks.remainder());
+    }
+    sum
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use crate::inetstack::protocols::checksum::{
+        fold, internet_checksum, ones_complement_add, ones_complement_sum, select_kernel, sum_scalar, update16,
+        update32, SumKernel,
+    };
+    use ::anyhow::Result;
+    use ::rand::Rng;
+    use ::std::slice::ChunksExact;
+    use ::test::{black_box, Bencher};
+
+    /// Payload sizes that we check and benchmark, from a minimum-sized frame to a jumbo frame.
+    const PAYLOAD_SIZES: [usize; 6] = [64, 256, 1460, 1500, 4096, 9000];
+
+    /// Reference implementation, which adds up one big-endian word at a time and folds the same way as the header
+    /// checksums of the network stack did before they moved to this module.
+    fn reference_checksum(data: &[u8]) -> u16 {
+        let mut state: u32 = 0xffff;
+        let mut chunks_iter: ChunksExact<u8> = data.chunks_exact(2);
+        while let Some(chunk) = chunks_iter.next() {
+            state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
+        }
+        if let Some(&b) = chunks_iter.remainder().get(0) {
+            state += u16::from_be_bytes([b, 0]) as u32;
+        }
+        while state > 0xffff {
+            state -= 0xffff;
+        }
+        !state as u16
+    }
+
+    fn random_bytes(len: usize) -> Vec<u8> {
+        let mut rng = rand::thread_rng();
+        (0..len).map(|_| rng.gen::<u8>()).collect()
+    }
+
+    /// Checks that the selected kernel matches the reference implementation bit for bit, for every length and
+    /// alignment that the vector kernels handle differently.
+    #[test]
+    fn test_checksum_matches_reference() -> Result<()> {
+        let data: Vec<u8> = random_bytes(9000 + 64);
+        for offset in 0..4 {
+            for len in (0..300).chain(PAYLOAD_SIZES.iter().copied()) {
+                let buf: &[u8] = &data[offset..offset + len];
+                crate::ensure_eq!(internet_checksum(buf), reference_checksum(buf));
+            }
+        }
+
+        // Sums that fold to zero must be represented the same way too.
+        crate::ensure_eq!(internet_checksum(&[0xff; 64]), reference_checksum(&[0xff; 64]));
+        crate::ensure_eq!(internet_checksum(&[0x00; 64]), reference_checksum(&[0x00; 64]));
+
+        Ok(())
+    }
+
+    /// Checks that the selected kernel and the portable one agree on long buffers, which span several kernel blocks.
+    #[test]
+    fn test_kernels_agree() -> Result<()> {
+        let data: Vec<u8> = random_bytes(1024 * 1024 + 13);
+        let kernel: SumKernel = select_kernel();
+        crate::ensure_eq!(fold(unsafe { kernel(&data) }), fold(sum_scalar(&data)));
+
+        let data: Vec<u8> = vec![0xff; 1024 * 1024];
+        crate::ensure_eq!(fold(unsafe { kernel(&data) }), fold(sum_scalar(&data)));
+
+        Ok(())
+    }
+
+    /// Checks that the sums of the halves of a buffer add up to the sum of the whole buffer.
+    #[test]
+    fn test_ones_complement_add() -> Result<()> {
+        let data: Vec<u8> = random_bytes(1500);
+        let (head, tail): (&[u8], &[u8]) = data.split_at(40);
+        crate::ensure_eq!(
+            ones_complement_add(ones_complement_sum(head), ones_complement_sum(tail)),
+            ones_complement_sum(&data)
+        );
+
+        Ok(())
+    }
+
+    /// Checks that incremental updates give the same checksum as a full recomputation (RFC 1624).
+    #[test]
+    fn test_incremental_update() -> Result<()> {
+        let mut rng = rand::thread_rng();
+        let mut data: Vec<u8> = random_bytes(1460);
+        for _ in 0..1000 {
+            let checksum: u16 = internet_checksum(&data);
+
+            // Rewrite a 16-bit field (e.g. the window).
+            let offset: usize = 2 * rng.gen_range(0..data.len() / 2);
+            let old: u16 = u16::from_be_bytes([data[offset], data[offset + 1]]);
+            let new: u16 = rng.gen();
+            data[offset..offset + 2].copy_from_slice(&new.to_be_bytes());
+            let checksum: u16 = update16(checksum, old, new);
+            crate::ensure_eq!(checksum, internet_checksum(&data));
+
+            // Rewrite a 32-bit field (e.g. the acknowledgement number).
+            let offset: usize = 4 * rng.gen_range(0..data.len() / 4);
+            let old: u32 = u32::from_be_bytes([data[offset], data[offset + 1], data[offset + 2], data[offset + 3]]);
+            let new: u32 = rng.gen();
+            data[offset..offset + 4].copy_from_slice(&new.to_be_bytes());
+            crate::ensure_eq!(update32(checksum, old, new), internet_checksum(&data));
+        }
+
+        Ok(())
+    }
+
+    fn bench_checksum(b: &mut Bencher, len: usize, checksum: fn(&[u8]) -> u16) {
+        let data: Vec<u8> = random_bytes(len);
+        b.bytes = len as u64;
+        b.iter(|| checksum(black_box(&data)));
+    }
+
+    #[bench]
+    fn bench_checksum_64(b: &mut Bencher) {
+        bench_checksum(b, PAYLOAD_SIZES[0], internet_checksum);
+    }
+
+    #[bench]
+    fn bench_reference_checksum_64(b: &mut Bencher) {
+        bench_checksum(b, PAYLOAD_SIZES[0], reference_checksum);
+    }
+
+    #[bench]
+    fn bench_checksum_256(b: &mut Bencher) {
+        bench_checksum(b, PAYLOAD_SIZES[1], internet_checksum);
+    }
+
+    #[bench]
+    fn bench_reference_checksum_256(b: &mut Bencher) {
+        bench_checksum(b, PAYLOAD_SIZES[1], reference_checksum);
+    }
+
+    #[bench]
+    fn bench_checksum_1460(b: &mut Bencher) {
+        bench_checksum(b, PAYLOAD_SIZES[2], internet_checksum);
+    }
+
+    #[bench]
+    fn bench_reference_checksum_1460(b: &mut Bencher) {
+        bench_checksum(b, PAYLOAD_SIZES[2], reference_checksum);
+    }
+
+    #[bench]
+    fn bench_checksum_1500(b: &mut Bencher) {
+        bench_checksum(b, PAYLOAD_SIZES[3], internet_checksum);
+    }
+
+    #[bench]
+    fn bench_reference_checksum_1500(b: &mut Bencher) {
+        bench_checksum(b, PAYLOAD_SIZES[3], reference_checksum);
+    }
+
+    #[bench]
+    fn bench_checksum_4096(b: &mut Bencher) {
+        bench_checksum(b, PAYLOAD_SIZES[4], internet_checksum);
+    }
+
+    #[bench]
+    fn bench_reference_checksum_4096(b: &mut Bencher) {
+        bench_checksum(b, PAYLOAD_SIZES[4], reference_checksum);
+    }
+
+    #[bench]
+    fn bench_checksum_9000(b: &mut Bencher) {
+        bench_checksum(b, PAYLOAD_SIZES[5], internet_checksum);
+    }
+
+    #[bench]
+    fn bench_reference_checksum_9000(b: &mut Bencher) {
+        bench_checksum(b, PAYLOAD_SIZES[5], reference_checksum);
+    }
+}
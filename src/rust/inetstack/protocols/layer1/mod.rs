@@ -15,7 +15,7 @@ use arrayvec::ArrayVec;
 use crate::runtime::{
     fail::Fail,
     memory::{DemiBuffer, MemoryRuntime},
-    network::consts::RECEIVE_BATCH_SIZE,
+    network::{consts::RECEIVE_BATCH_SIZE, rss::RssSteering},
 };
 
 //======================================================================================================================
@@ -25,9 +25,27 @@ use crate::runtime::{
 /// API for the Physical Layer for any underlying hardware that implements a raw NIC interface (e.g., DPDK, raw
 /// sockets).
 pub trait PhysicalLayer: 'static + MemoryRuntime {
-    /// Transmits a single [PacketBuf].
+    /// Transmits a single [PacketBuf]. Implementations may stage the packet and only hand it to the hardware on the
+    /// next call to [flush](Self::flush).
     fn transmit(&mut self, pkt: DemiBuffer) -> Result<(), Fail>;
 
+    /// Hands any staged packets to the hardware. This is called once per poll pass of the network stack.
+    fn flush(&mut self) -> Result<(), Fail> {
+        Ok(())
+    }
+
     /// Receives a batch of [DemiBuffer].
     fn receive(&mut self) -> Result<ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>, Fail>;
+
+    /// Returns how the hardware steers incoming flows across receive queues, if this physical layer serves only one of
+    /// several queues. In that case, the network stack only sees the flows that are steered to its own queue.
+    fn rss_steering(&self) -> Option<RssSteering> {
+        None
+    }
+
+    /// Returns whether the hardware cuts TCP segments that are larger than the MSS into MSS-sized packets (see
+    /// [DemiBuffer::set_tso_segment_size]).
+    fn tcp_segmentation_offload(&self) -> bool {
+        false
+    }
 }
@@ -19,10 +19,11 @@ use crate::{
     demi_sgarray_t,
     demikernel::config::Config,
     inetstack::protocols::layer1::PhysicalLayer,
+    perftools::stats::{self, Counter},
     runtime::{
         fail::Fail,
         memory::{DemiBuffer, MemoryRuntime},
-        network::{consts::RECEIVE_BATCH_SIZE, types::MacAddress},
+        network::{consts::RECEIVE_BATCH_SIZE, rss::RssSteering, types::MacAddress},
         SharedObject,
     },
 };
@@ -56,10 +57,12 @@ impl SharedLayer2Endpoint {
     pub fn receive(&mut self) -> Result<ArrayVec<(EtherType2, DemiBuffer), RECEIVE_BATCH_SIZE>, Fail> {
         let mut batch: ArrayVec<(EtherType2, DemiBuffer), RECEIVE_BATCH_SIZE> = ArrayVec::new();
         for mut pkt in self.layer1_endpoint.receive()? {
+            stats::count(Counter::PacketsIn, 1);
+            stats::count(Counter::BytesIn, pkt.total_len() as u64);
             let header: Ethernet2Header = match Ethernet2Header::parse_and_strip(&mut pkt) {
                 Ok(result) => result,
                 Err(e) => {
-                    // TODO: Collect dropped packet statistics.
+                    stats::count(Counter::Drops, 1);
                     let cause: &str = "Invalid Ethernet header";
                     warn!("{}: {:?}", cause, e);
                     continue;
@@ -94,12 +97,34 @@ impl SharedLayer2Endpoint {
     ) -> Result<(), Fail> {
         let eth2_header: Ethernet2Header = Ethernet2Header::new(remote_link_addr, self.local_link_addr, eth2_type);
         eth2_header.serialize_and_attach(&mut pkt);
-        self.layer1_endpoint.transmit(pkt)
+        self.transmit_frame(pkt)
+    }
+
+    /// Transmits a frame whose Ethernet header was already attached.
+    pub fn transmit_frame(&mut self, frame: DemiBuffer) -> Result<(), Fail> {
+        let frame_size_bytes: u64 = frame.total_len() as u64;
+        self.layer1_endpoint.transmit(frame)?;
+        stats::count(Counter::PacketsOut, 1);
+        stats::count(Counter::BytesOut, frame_size_bytes);
+        Ok(())
+    }
+
+    /// Flushes packets staged in the physical layer.
+    pub fn flush(&mut self) -> Result<(), Fail> {
+        self.layer1_endpoint.flush()
     }
 
     pub fn get_local_link_addr(&self) -> MacAddress {
         self.local_link_addr
     }
+
+    pub fn get_rss_steering(&self) -> Option<RssSteering> {
+        self.layer1_endpoint.rss_steering()
+    }
+
+    pub fn get_tcp_segmentation_offload(&self) -> bool {
+        self.layer1_endpoint.tcp_segmentation_offload()
+    }
 }
 
 //======================================================================================================================
@@ -126,8 +151,8 @@ impl MemoryRuntime for Layer2Endpoint {
         self.layer1_endpoint.into_sgarray(buf)
     }
 
-    fn sgaalloc(&self, size_bytes: usize) -> Result<demi_sgarray_t, Fail> {
-        self.layer1_endpoint.sgaalloc(size_bytes)
+    fn sgaallocv(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
+        self.layer1_endpoint.sgaallocv(seglens)
     }
 
     fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
@@ -8,9 +8,10 @@ mod tests;
 // Imports
 //======================================================================================================================
 
-use crate::{collections::hashttlcache::HashTtlCache, runtime::network::types::MacAddress};
+use crate::runtime::network::types::MacAddress;
 use ::std::{
-    collections::HashMap,
+    cell::Cell,
+    collections::{HashMap, VecDeque},
     net::Ipv4Addr,
     time::{Duration, Instant},
 };
@@ -21,6 +22,9 @@ use ::std::{
 
 const DUMMY_MAC_ADDRESS: MacAddress = MacAddress::new([0; 6]);
 
+/// Number of neighbors up to which lookups scan the table instead of going through the index.
+const SCAN_MAX_NEIGHBORS: usize = 16;
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -28,23 +32,42 @@ const DUMMY_MAC_ADDRESS: MacAddress = MacAddress::new([0; 6]);
 #[derive(Debug)]
 struct Record {
     link_addr: MacAddress,
+    /// Time at which this resolution expires, or `None` for static resolutions.
+    expiration: Option<Instant>,
+    /// Was this resolution looked up since it was inserted?
+    hot: Cell<bool>,
+    /// Was this resolution handed out for refresh since it was inserted?
+    refreshing: bool,
+}
+
+/// Resolutions of an enabled ARP cache. The IPv4 addresses of the neighbors are kept in an array of their own, as
+/// integers, so that a lookup among a few neighbors is a scan over a handful of words. Larger tables also keep an index.
+struct Neighbors {
+    keys: Vec<u32>,
+    records: Vec<Record>,
+    /// Position of every neighbor in `keys` and `records`, once there are more than [SCAN_MAX_NEIGHBORS] of them.
+    index: HashMap<Ipv4Addr, usize>,
+    /// Expiration times of resolutions, in the order they were set. Every resolution gets the same time to live, so
+    /// this is sorted and expired resolutions are always at the front. Resolutions that were set again since leave a
+    /// stale time behind, which is skipped.
+    expirations: VecDeque<(Instant, Ipv4Addr)>,
+    ttl: Option<Duration>,
+    clock: Instant,
 }
 
 ///
 /// # ARP Cache
 /// - TODO: Allow multiple waiters for the same address
 /// - TODO: Deregister waiters here when the receiver goes away.
-/// - TODO: Implement eviction.
-/// - TODO: Implement remove.
 /// Cache for IPv4 Addresses. If set to None, then ARP is disabled.
-pub struct ArpCache(Option<HashTtlCache<Ipv4Addr, Record>>);
+pub struct ArpCache(Option<Neighbors>);
 
 //======================================================================================================================
 // Associate Functions
 //======================================================================================================================
 
 impl ArpCache {
-    /// Creates an ARP Cache.
+    /// Creates an ARP Cache. Resolutions in `values` are static and never expire.
     pub fn new(
         now: Instant,
         default_ttl: Option<Duration>,
@@ -52,30 +75,34 @@ impl ArpCache {
         is_enabled: bool,
     ) -> ArpCache {
         ArpCache(if is_enabled {
-            let hash_ttl_cache = HashTtlCache::<Ipv4Addr, Record>::new(now, default_ttl);
-            let mut cache: HashTtlCache<Ipv4Addr, Record> = hash_ttl_cache;
+            if let Some(ttl) = default_ttl {
+                assert!(ttl > Duration::ZERO);
+            }
+            let mut neighbors: Neighbors = Neighbors {
+                keys: Vec::new(),
+                records: Vec::new(),
+                index: HashMap::default(),
+                expirations: VecDeque::new(),
+                ttl: default_ttl,
+                clock: now,
+            };
             if let Some(values) = values {
                 for (&k, &v) in values {
-                    if let Some(record) = cache.insert(k, Record { link_addr: v }) {
-                        warn!(
-                            "Inserting two cache entries with the same address: address={:?} first MAC={:?} second \
-                             MAC={:?}",
-                            k, record, v
-                        );
-                    }
+                    neighbors.insert(k, v, None);
                 }
             };
-            Some(cache)
+            Some(neighbors)
         } else {
             None
         })
     }
 
-    /// Caches an address resolution.
+    /// Caches an address resolution, which expires after the default time to live. Returns the link address that
+    /// `ipv4_addr` resolved to before, if any.
     pub fn insert(&mut self, ipv4_addr: Ipv4Addr, link_addr: MacAddress) -> Option<MacAddress> {
-        if let Some(ref mut cache) = self.0 {
-            let record = Record { link_addr };
-            cache.insert(ipv4_addr, record).map(|r| r.link_addr)
+        if let Some(ref mut neighbors) = self.0 {
+            let expiration: Option<Instant> = neighbors.ttl.map(|ttl: Duration| neighbors.clock + ttl);
+            neighbors.insert(ipv4_addr, link_addr, expiration)
         } else {
             None
         }
@@ -83,8 +110,12 @@ impl ArpCache {
 
     /// Gets the MAC address of given IPv4 address.
     pub fn get(&self, ipv4_addr: Ipv4Addr) -> Option<&MacAddress> {
-        if let Some(ref cache) = self.0 {
-            cache.get(&ipv4_addr).map(|r| &r.link_addr)
+        if let Some(ref neighbors) = self.0 {
+            neighbors.position(ipv4_addr).map(|i: usize| {
+                let record: &Record = &neighbors.records[i];
+                record.hot.set(true);
+                &record.link_addr
+            })
         } else {
             Some(&DUMMY_MAC_ADDRESS)
         }
@@ -93,27 +124,130 @@ impl ArpCache {
     /// Clears the ARP cache.
     #[allow(unused)]
     pub fn clear(&mut self) {
-        if let Some(ref mut cache) = self.0 {
-            cache.clear()
+        if let Some(ref mut neighbors) = self.0 {
+            neighbors.keys.clear();
+            neighbors.records.clear();
+            neighbors.index.clear();
+            neighbors.expirations.clear();
         };
     }
 
+    /// Moves the clock of the cache to `now` and drops the resolutions that expired. This takes constant time for
+    /// every resolution that expired.
+    pub fn advance_clock(&mut self, now: Instant) {
+        if let Some(ref mut neighbors) = self.0 {
+            debug_assert!(now >= neighbors.clock);
+            neighbors.clock = now;
+            while let Some(&(expiration, ipv4_addr)) = neighbors.expirations.front() {
+                if expiration > now {
+                    break;
+                }
+                neighbors.expirations.pop_front();
+                if let Some(i) = neighbors.position(ipv4_addr) {
+                    if neighbors.records[i].expiration == Some(expiration) {
+                        neighbors.remove(i);
+                    }
+                }
+            }
+        }
+    }
+
+    /// Returns the resolutions that were looked up since they were inserted and that expire within `window`, so that
+    /// they can be refreshed before they go cold. A resolution is only returned once until it is inserted again.
+    pub fn take_refresh_due(&mut self, window: Duration) -> Vec<(Ipv4Addr, MacAddress)> {
+        let mut due: Vec<(Ipv4Addr, MacAddress)> = Vec::new();
+        if let Some(ref mut neighbors) = self.0 {
+            let deadline: Instant = neighbors.clock + window;
+            for i in 0..neighbors.expirations.len() {
+                let (expiration, ipv4_addr): (Instant, Ipv4Addr) = neighbors.expirations[i];
+                if expiration > deadline {
+                    break;
+                }
+                if let Some(j) = neighbors.position(ipv4_addr) {
+                    let record: &mut Record = &mut neighbors.records[j];
+                    if record.expiration == Some(expiration) && record.hot.get() && !record.refreshing {
+                        record.refreshing = true;
+                        due.push((ipv4_addr, record.link_addr));
+                    }
+                }
+            }
+        }
+        due
+    }
+
     // Exports address resolutions that are stored in the ARP cache.
     #[cfg(test)]
     pub fn export(&self) -> HashMap<Ipv4Addr, MacAddress> {
         let mut map: HashMap<Ipv4Addr, MacAddress> = HashMap::default();
-        if let Some(ref cache) = self.0 {
-            for (k, v) in cache.iter() {
-                map.insert(*k, v.link_addr);
+        if let Some(ref neighbors) = self.0 {
+            for (k, v) in neighbors.keys.iter().zip(neighbors.records.iter()) {
+                map.insert(Ipv4Addr::from(*k), v.link_addr);
             }
         }
         map
     }
+}
 
-    #[cfg(test)]
-    pub fn advance_clock(&mut self, now: Instant) {
-        if let Some(ref mut cache) = self.0 {
-            cache.advance_clock(now)
+impl Neighbors {
+    /// Returns the position of `ipv4_addr` in the table.
+    fn position(&self, ipv4_addr: Ipv4Addr) -> Option<usize> {
+        if self.keys.len() <= SCAN_MAX_NEIGHBORS {
+            let key: u32 = u32::from(ipv4_addr);
+            self.keys.iter().position(|k: &u32| *k == key)
+        } else {
+            self.index.get(&ipv4_addr).copied()
+        }
+    }
+
+    fn insert(
+        &mut self,
+        ipv4_addr: Ipv4Addr,
+        link_addr: MacAddress,
+        expiration: Option<Instant>,
+    ) -> Option<MacAddress> {
+        let record: Record = Record {
+            link_addr,
+            expiration,
+            hot: Cell::new(false),
+            refreshing: false,
+        };
+        if let Some(expiration) = expiration {
+            self.expirations.push_back((expiration, ipv4_addr));
+        }
+        match self.position(ipv4_addr) {
+            Some(i) => {
+                let old: Record = std::mem::replace(&mut self.records[i], record);
+                Some(old.link_addr)
+            },
+            None => {
+                self.keys.push(u32::from(ipv4_addr));
+                self.records.push(record);
+                if self.keys.len() == SCAN_MAX_NEIGHBORS + 1 {
+                    // The table just outgrew scans, so build the index from scratch.
+                    for (i, k) in self.keys.iter().enumerate() {
+                        self.index.insert(Ipv4Addr::from(*k), i);
+                    }
+                } else if self.keys.len() > SCAN_MAX_NEIGHBORS {
+                    self.index.insert(ipv4_addr, self.keys.len() - 1);
+                }
+                None
+            },
+        }
+    }
+
+    /// Removes the neighbor at position `i`, moving the last neighbor in its place.
+    fn remove(&mut self, i: usize) {
+        let ipv4_addr: Ipv4Addr = Ipv4Addr::from(self.keys[i]);
+        self.keys.swap_remove(i);
+        self.records.swap_remove(i);
+        if !self.index.is_empty() {
+            self.index.remove(&ipv4_addr);
+            if let Some(k) = self.keys.get(i) {
+                self.index.insert(Ipv4Addr::from(*k), i);
+            }
+            if self.keys.len() <= SCAN_MAX_NEIGHBORS {
+                self.index.clear();
+            }
         }
     }
 }
@@ -77,3 +77,103 @@ fn export() -> Result<()> {
 
     Ok(())
 }
+
+/// Tests that a resolution expires once the clock of the cache passes its time to live, unless it was inserted again
+/// since, and that static resolutions never expire.
+#[test]
+fn expire_with_default_ttl() -> Result<()> {
+    let now: Instant = Instant::now();
+    let ttl: Duration = Duration::from_secs(10);
+
+    let mut map: HashMap<Ipv4Addr, MacAddress> = HashMap::new();
+    map.insert(test_helpers::ALICE_IPV4, test_helpers::ALICE_MAC);
+    let mut cache: ArpCache = ArpCache::new(now, Some(ttl), Some(&map), true);
+    cache.insert(test_helpers::BOB_IPV4, test_helpers::BOB_MAC);
+    cache.insert(test_helpers::CARRIE_IPV4, test_helpers::CARRIE_MAC);
+
+    // Insert Carrie again half way through, which pushes back its expiration.
+    cache.advance_clock(now + ttl / 2);
+    cache.insert(test_helpers::CARRIE_IPV4, test_helpers::CARRIE_MAC);
+
+    cache.advance_clock(now + ttl);
+    crate::ensure_eq!(cache.get(test_helpers::ALICE_IPV4), Some(&test_helpers::ALICE_MAC));
+    crate::ensure_eq!(cache.get(test_helpers::BOB_IPV4), None);
+    crate::ensure_eq!(cache.get(test_helpers::CARRIE_IPV4), Some(&test_helpers::CARRIE_MAC));
+
+    cache.advance_clock(now + ttl + ttl / 2);
+    crate::ensure_eq!(cache.get(test_helpers::ALICE_IPV4), Some(&test_helpers::ALICE_MAC));
+    crate::ensure_eq!(cache.get(test_helpers::CARRIE_IPV4), None);
+
+    Ok(())
+}
+
+/// Tests that only resolutions that were looked up are due for refresh shortly before they expire, and only once.
+#[test]
+fn take_refresh_due() -> Result<()> {
+    let now: Instant = Instant::now();
+    let ttl: Duration = Duration::from_secs(10);
+    let window: Duration = Duration::from_secs(2);
+
+    let mut cache: ArpCache = ArpCache::new(now, Some(ttl), None, true);
+    cache.insert(test_helpers::BOB_IPV4, test_helpers::BOB_MAC);
+    cache.insert(test_helpers::CARRIE_IPV4, test_helpers::CARRIE_MAC);
+    crate::ensure_eq!(cache.get(test_helpers::BOB_IPV4), Some(&test_helpers::BOB_MAC));
+
+    // Nothing is due before the window.
+    crate::ensure_eq!(cache.take_refresh_due(window), vec![]);
+
+    // Only Bob was looked up.
+    cache.advance_clock(now + ttl - window);
+    crate::ensure_eq!(
+        cache.take_refresh_due(window),
+        vec![(test_helpers::BOB_IPV4, test_helpers::BOB_MAC)]
+    );
+    crate::ensure_eq!(cache.take_refresh_due(window), vec![]);
+
+    // Once refreshed, Bob is due again within the window a time to live later.
+    cache.insert(test_helpers::BOB_IPV4, test_helpers::BOB_MAC);
+    cache.get(test_helpers::BOB_IPV4);
+    cache.advance_clock(now + ttl + ttl - 2 * window);
+    crate::ensure_eq!(
+        cache.take_refresh_due(window),
+        vec![(test_helpers::BOB_IPV4, test_helpers::BOB_MAC)]
+    );
+
+    Ok(())
+}
+
+/// Tests lookups, updates and expirations on a table of neighbors that is too large to scan.
+#[test]
+fn many_neighbors() -> Result<()> {
+    let now: Instant = Instant::now();
+    let ttl: Duration = Duration::from_secs(10);
+    const NUM_NEIGHBORS: u8 = 64;
+    let neighbor =
+        |i: u8| -> (Ipv4Addr, MacAddress) { (Ipv4Addr::new(10, 0, 0, i), MacAddress::new([0x02, 0, 0, 0, 0, i])) };
+
+    // Even neighbors expire first and odd ones expire later.
+    let mut cache: ArpCache = ArpCache::new(now, Some(ttl), None, true);
+    for i in (0..NUM_NEIGHBORS).step_by(2) {
+        let (ipv4_addr, link_addr): (Ipv4Addr, MacAddress) = neighbor(i);
+        crate::ensure_eq!(cache.insert(ipv4_addr, link_addr), None);
+    }
+    cache.advance_clock(now + ttl / 2);
+    for i in (1..NUM_NEIGHBORS).step_by(2) {
+        let (ipv4_addr, link_addr): (Ipv4Addr, MacAddress) = neighbor(i);
+        crate::ensure_eq!(cache.insert(ipv4_addr, link_addr), None);
+    }
+    for i in 0..NUM_NEIGHBORS {
+        let (ipv4_addr, link_addr): (Ipv4Addr, MacAddress) = neighbor(i);
+        crate::ensure_eq!(cache.get(ipv4_addr), Some(&link_addr));
+    }
+
+    cache.advance_clock(now + ttl);
+    for i in 0..NUM_NEIGHBORS {
+        let (ipv4_addr, link_addr): (Ipv4Addr, MacAddress) = neighbor(i);
+        let expected: Option<&MacAddress> = if i % 2 == 0 { None } else { Some(&link_addr) };
+        crate::ensure_eq!(cache.get(ipv4_addr), expected);
+    }
+    crate::ensure_eq!(cache.export().len(), (NUM_NEIGHBORS / 2) as usize);
+
+    Ok(())
+}
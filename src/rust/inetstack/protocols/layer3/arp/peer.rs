@@ -12,6 +12,7 @@ use crate::{
             header::{ArpHeader, ArpOperation},
         },
     },
+    perftools::stats::{self, Counter},
     runtime::{
         conditional_yield_with_timeout,
         fail::Fail,
@@ -26,16 +27,20 @@ use ::futures::{
 };
 use ::libc::ETIMEDOUT;
 use ::std::{
-    collections::{HashMap, LinkedList},
+    collections::{HashMap, LinkedList, VecDeque},
     net::Ipv4Addr,
     ops::{Deref, DerefMut},
-    time::Duration,
+    time::{Duration, Instant},
 };
 
 //======================================================================================================================
 // Constants
 //======================================================================================================================
 
+/// Maximum number of packets that wait for the resolution of a single neighbor. Once there are that many, the oldest
+/// one is dropped to make room for each new one, as a neighbor that does not answer would otherwise pin down buffers.
+const PENDING_MAX_PACKETS: usize = 32;
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -44,12 +49,16 @@ use ::std::{
 /// Arp Peer
 ///
 pub struct ArpPeer {
+    runtime: SharedDemiRuntime,
     layer2_endpoint: SharedLayer2Endpoint,
     local_ipv4_addr: Ipv4Addr,
     cache: ArpCache,
     waiters: HashMap<Ipv4Addr, LinkedList<Sender<MacAddress>>>,
     arp_config: ArpConfig,
     recv_queue: AsyncQueue<DemiBuffer>,
+    /// IPv4 packets that wait for the resolution of their next hop. A neighbor has an entry here for as long as a
+    /// resolution is in flight for it.
+    pending: HashMap<Ipv4Addr, VecDeque<DemiBuffer>>,
 }
 
 #[derive(Clone)]
@@ -77,12 +86,14 @@ impl SharedArpPeer {
         );
 
         let peer: SharedArpPeer = Self(SharedObject::new(ArpPeer {
+            runtime: runtime.clone(),
             layer2_endpoint,
             local_ipv4_addr: config.local_ipv4_addr()?,
             cache,
             waiters: HashMap::default(),
             arp_config,
             recv_queue: AsyncQueue::<DemiBuffer>::default(),
+            pending: HashMap::default(),
         }));
         // This is a future returned by the async function.
         runtime.insert_background_coroutine("bgc::inetstack::arp::background", Box::pin(peer.clone().poll().fuse()))?;
@@ -105,9 +116,26 @@ impl SharedArpPeer {
                 let _ = sender.send(link_addr);
             }
         }
+        self.do_flush(ipv4_addr, link_addr);
         self.cache.insert(ipv4_addr, link_addr)
     }
 
+    /// Transmits the packets that wait for the resolution of `ipv4_addr`, which resolved to `link_addr`.
+    fn do_flush(&mut self, ipv4_addr: Ipv4Addr, link_addr: MacAddress) {
+        if let Some(queue) = self.pending.remove(&ipv4_addr) {
+            debug!(
+                "do_flush(): flushing {} packets (ipv4_addr={:?})",
+                queue.len(),
+                ipv4_addr
+            );
+            for pkt in queue {
+                if let Err(e) = self.layer2_endpoint.transmit_ipv4_packet(link_addr, pkt) {
+                    warn!("do_flush(): could not transmit packet: {:?}", e);
+                }
+            }
+        }
+    }
+
     async fn do_wait_link_addr(&mut self, ipv4_addr: Ipv4Addr) -> MacAddress {
         let (tx, rx): (Sender<MacAddress>, Receiver<MacAddress>) = channel();
         if let Some(&link_addr) = self.cache.get(ipv4_addr) {
@@ -127,6 +155,7 @@ impl SharedArpPeer {
 
     async fn poll(mut self) {
         loop {
+            self.do_refresh();
             let buf: DemiBuffer = match self.recv_queue.pop(Some(Self::ARP_CLEANUP_TIMEOUT)).await {
                 Ok(buf) => buf,
                 Err(Fail { errno, cause: _ }) if errno == libc::ETIMEDOUT || errno == libc::EAGAIN => continue,
@@ -228,17 +257,90 @@ impl SharedArpPeer {
                         header.get_sender_protocol_addr(),
                         header.get_sender_hardware_addr()
                     );
-                    self.cache
-                        .insert(header.get_sender_protocol_addr(), header.get_sender_hardware_addr());
+                    self.do_insert(header.get_sender_protocol_addr(), header.get_sender_hardware_addr());
                 },
             }
         }
     }
 
+    /// Drops expired resolutions and asks the neighbors whose resolutions are in use and about to expire to confirm
+    /// them. The request goes straight to the link address that is cached, and the reply extends the resolution before
+    /// it expires, so senders never see a miss for an active neighbor.
+    fn do_refresh(&mut self) {
+        let now: Instant = self.runtime.get_now();
+        self.cache.advance_clock(now);
+        let window: Duration = (self.arp_config.get_cache_ttl() / 4).max(2 * Self::ARP_CLEANUP_TIMEOUT);
+        for (ipv4_addr, link_addr) in self.cache.take_refresh_due(window) {
+            debug!(
+                "do_refresh(): refreshing (ipv4_addr={:?}, link_addr={:?})",
+                ipv4_addr, link_addr
+            );
+            let header: ArpHeader = ArpHeader::new(
+                ArpOperation::Request,
+                self.layer2_endpoint.get_local_link_addr(),
+                self.local_ipv4_addr,
+                link_addr,
+                ipv4_addr,
+            );
+            if let Err(e) = self
+                .layer2_endpoint
+                .transmit_arp_packet(link_addr, header.create_and_serialize())
+            {
+                warn!("do_refresh(): could not send packet: {:?}", e);
+            }
+        }
+    }
+
     pub fn try_query(&self, ipv4_addr: Ipv4Addr) -> Option<MacAddress> {
         self.cache.get(ipv4_addr).cloned()
     }
 
+    /// Transmits an IPv4 packet to `ipv4_addr` without waiting for its resolution. If the link address of `ipv4_addr`
+    /// is not cached, the packet is queued and a resolution is started, unless one is in flight already. Queued packets
+    /// go out as soon as the reply arrives, and they are dropped if the resolution times out.
+    pub fn transmit_ipv4_packet(&mut self, ipv4_addr: Ipv4Addr, pkt: DemiBuffer) -> Result<(), Fail> {
+        if let Some(&link_addr) = self.cache.get(ipv4_addr) {
+            return self.layer2_endpoint.transmit_ipv4_packet(link_addr, pkt);
+        }
+
+        if let Some(queue) = self.pending.get_mut(&ipv4_addr) {
+            if queue.len() == PENDING_MAX_PACKETS {
+                warn!(
+                    "transmit_ipv4_packet(): dropping oldest pending packet (ipv4_addr={:?})",
+                    ipv4_addr
+                );
+                queue.pop_front();
+                stats::count(Counter::Drops, 1);
+            }
+            queue.push_back(pkt);
+            return Ok(());
+        }
+
+        let coroutine = Box::pin(self.clone().resolve(ipv4_addr).fuse());
+        self.runtime
+            .insert_background_coroutine("bgc::inetstack::arp::resolve", coroutine)?;
+        self.pending.insert(ipv4_addr, VecDeque::from([pkt]));
+        Ok(())
+    }
+
+    /// Resolves `ipv4_addr` for the packets that wait for it.
+    async fn resolve(mut self, ipv4_addr: Ipv4Addr) {
+        match self.query(ipv4_addr).await {
+            Ok(link_addr) => self.do_flush(ipv4_addr, link_addr),
+            Err(e) => {
+                if let Some(queue) = self.pending.remove(&ipv4_addr) {
+                    warn!(
+                        "resolve(): dropping {} pending packets (ipv4_addr={:?}): {:?}",
+                        queue.len(),
+                        ipv4_addr,
+                        e
+                    );
+                    stats::count(Counter::Drops, queue.len() as u64);
+                }
+            },
+        }
+    }
+
     pub async fn query(&mut self, ipv4_addr: Ipv4Addr) -> Result<MacAddress, Fail> {
         if let Some(&link_addr) = self.cache.get(ipv4_addr) {
             return Ok(link_addr);
@@ -10,17 +10,22 @@ use crate::{
         protocols::{
             layer2::{EtherType2, Ethernet2Header},
             layer3::arp::header::{ArpHeader, ArpOperation},
+            MAX_HEADER_SIZE,
         },
-        test_helpers::{self, SharedEngine, SharedTestPhysicalLayer},
+        test_helpers::{self, engine::TIMEOUT_SECONDS, SharedEngine, SharedTestPhysicalLayer},
         SharedInetStack,
     },
-    runtime::{memory::DemiBuffer, network::types::MacAddress},
+    runtime::{
+        memory::DemiBuffer,
+        network::types::MacAddress,
+        queue::{OperationResult, QDesc, QToken},
+    },
 };
 use ::anyhow::Result;
 use ::futures::FutureExt;
 use ::std::{
     collections::{HashMap, VecDeque},
-    net::Ipv4Addr,
+    net::{Ipv4Addr, SocketAddrV4},
     time::{Duration, Instant},
 };
 
@@ -191,6 +196,61 @@ fn arp_cache_timeout() -> Result<()> {
     Ok(())
 }
 
+/// Tests that a datagram to a neighbor that is not in the ARP cache does not block the sender, and that it goes out
+/// once the neighbor answers the ARP request.
+#[test]
+fn arp_pending_flush_on_reply() -> Result<()> {
+    let mut now: Instant = Instant::now();
+    let local_mac: MacAddress = test_helpers::ALICE_MAC;
+    let local_ipv4: Ipv4Addr = test_helpers::ALICE_IPV4;
+    let remote_mac: MacAddress = test_helpers::CARRIE_MAC;
+    let remote_ipv4: Ipv4Addr = test_helpers::CARRIE_IPV4;
+    let mut engine: SharedEngine = new_engine(now, test_helpers::ALICE_CONFIG_PATH)?;
+
+    // Push a datagram to Carrie, who is not in the ARP cache. The push completes right away.
+    let qd: QDesc = engine.udp_socket()?;
+    engine.udp_bind(qd, SocketAddrV4::new(local_ipv4, 80))?;
+    let buf: DemiBuffer = DemiBuffer::from_slice_with_headroom(&[0x5a; 32], MAX_HEADER_SIZE)?;
+    let qt: QToken = engine.udp_pushto(qd, buf, SocketAddrV4::new(remote_ipv4, 80))?;
+    match engine.wait(qt, TIMEOUT_SECONDS)? {
+        (_, OperationResult::Push) => {},
+        _ => anyhow::bail!("push should succeed"),
+    };
+    engine.poll();
+    engine.poll();
+
+    // Only the ARP request goes out.
+    let mut buffers: VecDeque<DemiBuffer> = engine.pop_all_frames();
+    crate::ensure_eq!(buffers.len(), 1);
+    let mut pkt: DemiBuffer = buffers.pop_front().unwrap();
+    let eth2_header: Ethernet2Header = Ethernet2Header::parse_and_strip(&mut pkt)?;
+    crate::ensure_eq!(eth2_header.ether_type(), EtherType2::Arp);
+    let arp_header: ArpHeader = ArpHeader::parse_and_consume(pkt)?;
+    crate::ensure_eq!(arp_header.get_operation(), ArpOperation::Request);
+    crate::ensure_eq!(arp_header.get_destination_protocol_addr(), remote_ipv4);
+
+    // Carrie answers.
+    let reply: ArpHeader = ArpHeader::new(ArpOperation::Reply, remote_mac, remote_ipv4, local_mac, local_ipv4);
+    let mut pkt: DemiBuffer = reply.create_and_serialize();
+    Ethernet2Header::new(local_mac, remote_mac, EtherType2::Arp).serialize_and_attach(&mut pkt);
+    engine.push_frame(pkt);
+    now += Duration::from_micros(1);
+    engine.advance_clock(now);
+    engine.poll();
+    engine.poll();
+
+    // The datagram went out to Carrie.
+    let mut buffers: VecDeque<DemiBuffer> = engine.pop_all_frames();
+    crate::ensure_eq!(buffers.len(), 1);
+    let mut pkt: DemiBuffer = buffers.pop_front().unwrap();
+    let eth2_header: Ethernet2Header = Ethernet2Header::parse_and_strip(&mut pkt)?;
+    crate::ensure_eq!(eth2_header.dst_addr(), remote_mac);
+    crate::ensure_eq!(eth2_header.src_addr(), local_mac);
+    crate::ensure_eq!(eth2_header.ether_type(), EtherType2::Ipv4);
+
+    Ok(())
+}
+
 //======================================================================================================================
 // Test Helpers
 //======================================================================================================================
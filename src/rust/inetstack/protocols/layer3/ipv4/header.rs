@@ -6,7 +6,7 @@
 //======================================================================================================================
 
 use crate::{
-    inetstack::protocols::layer3::ip::IpProtocol,
+    inetstack::protocols::{checksum, layer3::ip::IpProtocol},
     runtime::{fail::Fail, memory::DemiBuffer},
 };
 use ::libc::{EBADMSG, ENOTSUP};
@@ -34,6 +34,15 @@ const DEFAULT_IPV4_TTL: u8 = 255;
 /// Version number for IPv4.
 const IPV4_VERSION: u8 = 4;
 
+/// ECN codepoint of packets from transports that do not support ECN (RFC 3168).
+pub const IPV4_ECN_NOT_ECT: u8 = 0;
+
+/// ECN codepoint of packets from ECN-capable transports (ECT(0), RFC 3168).
+pub const IPV4_ECN_ECT0: u8 = 2;
+
+/// ECN codepoint that congested routers set on packets from ECN-capable transports (CE, RFC 3168).
+pub const IPV4_ECN_CE: u8 = 3;
+
 /// IPv4 Control Flag: Datagram has evil intent (see RFC 3514).
 const IPV4_CTRL_FLAG_EVIL: u8 = 0x4;
 
@@ -136,11 +145,8 @@ impl Ipv4Header {
             warn!("ignoring dscp field (dscp={:?})", dscp);
         }
 
-        // Explicit congestion notification.
+        // Explicit congestion notification. TCP reports congestion marks to its peer.
         let ecn: u8 = hdr_buf[1] & 3;
-        if ecn != 0 {
-            warn!("ignoring ecn field (ecn={:?})", ecn);
-        }
 
         let total_length: u16 = u16::from_be_bytes([hdr_buf[2], hdr_buf[3]]);
         if total_length < hdr_size {
@@ -277,6 +283,14 @@ impl Ipv4Header {
         self.protocol
     }
 
+    pub fn get_ecn(&self) -> u8 {
+        self.ecn
+    }
+
+    pub fn set_ecn(&mut self, ecn: u8) {
+        self.ecn = ecn & 3;
+    }
+
     pub fn compute_checksum(buf: &[u8]) -> u16 {
         let mut state: u32 = 0xffff;
 
@@ -286,14 +300,10 @@ impl Ipv4Header {
             return 0;
         }
 
-        for i in 0..5 {
-            state += u16::from_be_bytes([buf[2 * i], buf[2 * i + 1]]) as u32;
-        }
         // Skip the 5th u16 since octets 10-12 are the header checksum, whose value should be zero when
         // computing a checksum.
-        for i in 6..10 {
-            state += u16::from_be_bytes([buf[2 * i], buf[2 * i + 1]]) as u32;
-        }
+        state += checksum::ones_complement_sum(&buf[0..10]) as u32;
+        state += checksum::ones_complement_sum(&buf[12..20]) as u32;
         while state > 0xffff {
             state -= 0xffff;
         }
@@ -10,4 +10,6 @@ mod tests;
 // Exports
 //======================================================================================================================
 
-pub use self::header::{Ipv4Header, IPV4_HEADER_MAX_SIZE, IPV4_HEADER_MIN_SIZE};
+pub use self::header::{
+    Ipv4Header, IPV4_ECN_CE, IPV4_ECN_ECT0, IPV4_ECN_NOT_ECT, IPV4_HEADER_MAX_SIZE, IPV4_HEADER_MIN_SIZE,
+};
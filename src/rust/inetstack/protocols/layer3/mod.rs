@@ -12,16 +12,22 @@ pub mod ipv4;
 
 use arrayvec::ArrayVec;
 
-pub use self::{arp::SharedArpPeer, icmpv4::SharedIcmpv4Peer, ip::IpProtocol, ipv4::Ipv4Header};
+pub use self::{
+    arp::SharedArpPeer,
+    icmpv4::SharedIcmpv4Peer,
+    ip::IpProtocol,
+    ipv4::{Ipv4Header, IPV4_ECN_CE, IPV4_ECN_ECT0, IPV4_ECN_NOT_ECT},
+};
 
 use crate::{
     demi_sgarray_t,
     demikernel::config::Config,
     inetstack::protocols::layer2::{EtherType2, SharedLayer2Endpoint},
+    perftools::stats::{self, Counter},
     runtime::{
         fail::Fail,
         memory::{DemiBuffer, MemoryRuntime},
-        network::consts::RECEIVE_BATCH_SIZE,
+        network::{consts::RECEIVE_BATCH_SIZE, rss::RssSteering},
         SharedDemiRuntime, SharedObject,
     },
     MacAddress,
@@ -68,8 +74,8 @@ impl SharedLayer3Endpoint {
         })))
     }
 
-    pub fn receive(&mut self) -> Result<ArrayVec<(Ipv4Addr, IpProtocol, DemiBuffer), RECEIVE_BATCH_SIZE>, Fail> {
-        let mut batch: ArrayVec<(Ipv4Addr, IpProtocol, DemiBuffer), RECEIVE_BATCH_SIZE> = ArrayVec::new();
+    pub fn receive(&mut self) -> Result<ArrayVec<(Ipv4Header, DemiBuffer), RECEIVE_BATCH_SIZE>, Fail> {
+        let mut batch: ArrayVec<(Ipv4Header, DemiBuffer), RECEIVE_BATCH_SIZE> = ArrayVec::new();
         for (eth2_type, mut packet) in self.layer2_endpoint.receive()? {
             match eth2_type {
                 EtherType2::Arp => {
@@ -82,6 +88,7 @@ impl SharedLayer3Endpoint {
                         Err(e) => {
                             let cause: String = format!("Invalid destination address: {:?}", e);
                             warn!("dropping packet: {}", cause);
+                            stats::count(Counter::Drops, 1);
                             continue;
                         },
                     };
@@ -91,6 +98,7 @@ impl SharedLayer3Endpoint {
                     if header.get_dest_addr() != self.local_ipv4_addr && !header.get_dest_addr().is_broadcast() {
                         let cause: String = format!("Invalid destination address");
                         warn!("dropping packet: {}", cause);
+                        stats::count(Counter::Drops, 1);
                         continue;
                     }
 
@@ -101,16 +109,16 @@ impl SharedLayer3Endpoint {
                     {
                         let cause: String = format!("invalid remote address (remote={})", header.get_src_addr());
                         warn!("dropping packet: {}", &cause);
+                        stats::count(Counter::Drops, 1);
                         continue;
                     }
 
-                    let protocol: IpProtocol = header.get_protocol();
-                    match protocol {
+                    match header.get_protocol() {
                         IpProtocol::ICMPv4 => {
                             self.icmpv4.receive(header, packet);
                             continue;
                         },
-                        _ => batch.push((header.get_src_addr(), protocol, packet)),
+                        _ => batch.push((header, packet)),
                     }
                 },
                 EtherType2::Ipv6 => warn!("Ipv6 not supported yet"), // Ignore for now.
@@ -119,51 +127,68 @@ impl SharedLayer3Endpoint {
         Ok(batch)
     }
 
-    pub fn transmit_tcp_packet_nonblocking(&mut self, remote_ipv4_addr: Ipv4Addr, pkt: DemiBuffer) -> Result<(), Fail> {
-        let remote_link_addr: MacAddress = match self.arp.try_query(remote_ipv4_addr) {
-            Some(addr) => addr,
-            _ => return Err(Fail::new(libc::EAGAIN, "destination not in ARP cache")),
-        };
-
-        self.transmit_packet(remote_ipv4_addr, remote_link_addr, IpProtocol::TCP, pkt)
-    }
-
-    pub async fn transmit_tcp_packet_blocking(
+    /// Sends a TCP segment with the given ECN codepoint, which is [IPV4_ECN_ECT0] for data segments of connections that
+    /// negotiated ECN and [IPV4_ECN_NOT_ECT] otherwise. If the link address of `remote_ipv4_addr` is not known yet, the
+    /// segment waits in the ARP layer until it is.
+    pub fn transmit_tcp_packet_nonblocking(
         &mut self,
         remote_ipv4_addr: Ipv4Addr,
+        ecn: u8,
         pkt: DemiBuffer,
     ) -> Result<(), Fail> {
-        let remote_link_addr: MacAddress = self.arp.query(remote_ipv4_addr).await?;
-
-        self.transmit_packet(remote_ipv4_addr, remote_link_addr, IpProtocol::TCP, pkt)
+        self.transmit_packet(remote_ipv4_addr, IpProtocol::TCP, ecn, pkt)
     }
 
-    pub async fn transmit_udp_packet_blocking(
-        &mut self,
-        remote_ipv4_addr: Ipv4Addr,
-        pkt: DemiBuffer,
-    ) -> Result<(), Fail> {
-        let remote_link_addr: MacAddress = self.arp.query(remote_ipv4_addr).await?;
-
-        self.transmit_packet(remote_ipv4_addr, remote_link_addr, IpProtocol::UDP, pkt)
+    /// Sends a UDP datagram. If the link address of `remote_ipv4_addr` is not known yet, the datagram waits in the ARP
+    /// layer until it is.
+    pub fn transmit_udp_packet_nonblocking(&mut self, remote_ipv4_addr: Ipv4Addr, pkt: DemiBuffer) -> Result<(), Fail> {
+        self.transmit_packet(remote_ipv4_addr, IpProtocol::UDP, IPV4_ECN_NOT_ECT, pkt)
     }
 
-    pub fn transmit_packet(
+    fn transmit_packet(
         &mut self,
         remote_ipv4_addr: Ipv4Addr,
-        remote_link_addr: MacAddress,
         ip_protocol: IpProtocol,
+        ecn: u8,
         mut pkt: DemiBuffer,
     ) -> Result<(), Fail> {
-        let ipv4_header: Ipv4Header = Ipv4Header::new(self.local_ipv4_addr, remote_ipv4_addr, ip_protocol);
+        let mut ipv4_header: Ipv4Header = Ipv4Header::new(self.local_ipv4_addr, remote_ipv4_addr, ip_protocol);
+        ipv4_header.set_ecn(ecn);
         ipv4_header.serialize_and_attach(&mut pkt);
-        self.layer2_endpoint.transmit_ipv4_packet(remote_link_addr, pkt)
+        self.arp.transmit_ipv4_packet(remote_ipv4_addr, pkt)
+    }
+
+    /// Returns the link address of `remote_ipv4_addr` if it is in the ARP cache. This never sends an ARP request.
+    pub fn try_query_link_addr(&self, remote_ipv4_addr: Ipv4Addr) -> Option<MacAddress> {
+        self.arp.try_query(remote_ipv4_addr)
+    }
+
+    /// Transmits a frame whose IPv4 and Ethernet headers were already attached.
+    pub fn transmit_frame(&mut self, frame: DemiBuffer) -> Result<(), Fail> {
+        self.layer2_endpoint.transmit_frame(frame)
+    }
+
+    /// Flushes packets staged in the lower layers.
+    pub fn flush(&mut self) -> Result<(), Fail> {
+        self.layer2_endpoint.flush()
     }
 
     pub fn get_local_addr(&self) -> Ipv4Addr {
         self.local_ipv4_addr
     }
 
+    pub fn get_local_link_addr(&self) -> MacAddress {
+        self.layer2_endpoint.get_local_link_addr()
+    }
+
+    pub fn get_rss_steering(&self) -> Option<RssSteering> {
+        self.layer2_endpoint.get_rss_steering()
+    }
+
+    pub fn get_tcp_segmentation_offload(&self) -> bool {
+        self.layer2_endpoint.get_tcp_segmentation_offload()
+    }
+
     #[cfg(test)]
     pub async fn ping(&mut self, addr: Ipv4Addr, timeout: Option<Duration>) -> Result<Duration, Fail> {
         self.icmpv4.ping(addr, timeout).await
@@ -204,8 +229,8 @@ impl MemoryRuntime for SharedLayer3Endpoint {
         self.layer2_endpoint.into_sgarray(buf)
     }
 
-    fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        self.layer2_endpoint.sgaalloc(size)
+    fn sgaallocv(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
+        self.layer2_endpoint.sgaallocv(seglens)
     }
 
     fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
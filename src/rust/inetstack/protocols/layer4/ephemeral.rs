@@ -47,6 +47,21 @@ impl EphemeralPorts {
         ))
     }
 
+    // The first port number that satisfies `predicate` will be allocated. This is used to pick a port number for which
+    // the return traffic of a flow is steered back to the queue that opened it.
+    pub fn alloc_matching<F: Fn(u16) -> bool>(&mut self, predicate: F) -> Result<u16, Fail> {
+        match self.port_numbers.iter().position(|&port_number| predicate(port_number)) {
+            Some(index) => Ok(self
+                .port_numbers
+                .remove(index)
+                .expect("index should be within the bounds of the pool")),
+            None => Err(Fail::new(
+                libc::EADDRINUSE,
+                "all matching port numbers in the ephemeral range are currently in use",
+            )),
+        }
+    }
+
     // A specific port number will be reserved, if available.
     pub fn reserve(&mut self, port_number: u16) -> Result<(), Fail> {
         if !self.port_numbers.contains(&port_number) {
@@ -194,6 +209,34 @@ mod test {
         Ok(())
     }
 
+    #[test]
+    fn test_alloc_matching_and_free() -> Result<()> {
+        let mut port_numbers: EphemeralPorts = EphemeralPorts::default();
+
+        // Allocate all even port numbers.
+        for _ in (FIRST_PRIVATE_PORT_NUMBER..=LAST_PRIVATE_PORT_NUMBER).step_by(2) {
+            match port_numbers.alloc_matching(|port_number| port_number % 2 == 0) {
+                Ok(port_number) => crate::ensure_eq!(port_number % 2, 0),
+                Err(e) => anyhow::bail!("failed to allocate an ephemeral port (error={:?})", &e),
+            }
+        }
+
+        if port_numbers.alloc_matching(|port_number| port_number % 2 == 0).is_ok() {
+            anyhow::bail!("all even ports should be allocated");
+        }
+
+        // Odd port numbers should still be available.
+        if let Err(e) = port_numbers.reserve(FIRST_PRIVATE_PORT_NUMBER + 1) {
+            anyhow::bail!("failed to allocate an ephemeral port (error={:?})", &e);
+        }
+
+        if let Err(e) = port_numbers.free(FIRST_PRIVATE_PORT_NUMBER) {
+            anyhow::bail!("failed to free ephemeral port (error={:?})", &e);
+        }
+
+        Ok(())
+    }
+
     #[test]
     fn test_free_unallocated_port() -> Result<()> {
         let mut port_numbers: EphemeralPorts = EphemeralPorts::default();
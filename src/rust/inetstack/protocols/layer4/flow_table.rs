@@ -0,0 +1,378 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::expect_some;
+use ::std::{mem, net::SocketAddrV4};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of slots of an empty table. This must be a power of two.
+const MIN_CAPACITY: usize = 16;
+
+/// Tag of an empty slot. Occupied slots always have the lowest bit of their tag set.
+const EMPTY: u32 = 0;
+
+/// Multiplier of the hash function (the 64-bit golden ratio).
+const HASH_MULTIPLIER: u64 = 0x9e37_79b9_7f4a_7c15;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Endpoints of a connection, packed into two words so comparing keys takes two instructions.
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub struct FlowKey {
+    /// Local IPv4 address in the upper half and remote IPv4 address in the lower half.
+    addrs: u64,
+    /// Local port in the upper half and remote port in the lower half.
+    ports: u32,
+}
+
+/// Open-addressing hash table that maps the endpoints of connections to their state, for the lookups on the receive
+/// path.
+///
+/// Slots are probed linearly. A separate array holds a 32-bit tag per slot, taken from the hash of its key, so a
+/// probe scans sixteen slots per cache line and only compares keys on tag matches. Removed entries are filled by
+/// shifting the rest of their probe run backwards, so there are no tombstones and a lookup stops at the first empty
+/// slot. The table doubles whenever it becomes three-quarters full.
+///
+/// The hash is keyed with a seed that callers must draw from a source of entropy that remote hosts cannot observe, such
+/// as [RandomState](std::collections::hash_map::RandomState), so that they cannot pick addresses that collide.
+pub struct FlowTable<V> {
+    /// Seed of the hash function.
+    seed: u64,
+    /// Tag of each slot, or [EMPTY].
+    tags: Vec<u32>,
+    /// Entry of each slot.
+    entries: Vec<Option<(FlowKey, V)>>,
+    /// Number of slots minus one.
+    mask: usize,
+    /// Number of entries.
+    len: usize,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl FlowKey {
+    pub fn new(local: SocketAddrV4, remote: SocketAddrV4) -> Self {
+        Self {
+            addrs: ((u32::from(*local.ip()) as u64) << 32) | u32::from(*remote.ip()) as u64,
+            ports: ((local.port() as u32) << 16) | remote.port() as u32,
+        }
+    }
+}
+
+impl<V> FlowTable<V> {
+    /// Creates an empty table whose hash function is keyed with `seed`. See [FlowTable] on how to pick it.
+    pub fn new(seed: u64) -> Self {
+        Self {
+            seed,
+            tags: vec![EMPTY; MIN_CAPACITY],
+            entries: Self::empty_entries(MIN_CAPACITY),
+            mask: MIN_CAPACITY - 1,
+            len: 0,
+        }
+    }
+
+    /// Returns the number of entries in the table.
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    /// Returns whether the table has no entries.
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    /// Hashes `key`. Callers that look up several keys in a row hash them once, prefetch their slots with
+    /// [prefetch](Self::prefetch) and then look them up with [get_mut_with_hash](Self::get_mut_with_hash).
+    pub fn hash(&self, key: &FlowKey) -> u64 {
+        let mut hash: u64 = (key.addrs ^ self.seed).wrapping_mul(HASH_MULTIPLIER);
+        hash ^= (key.ports as u64) ^ (self.seed >> 32);
+        hash = hash.wrapping_mul(HASH_MULTIPLIER);
+        hash ^ (hash >> 29)
+    }
+
+    /// Brings the first probed slot of a key with hash `hash` into the cache, without waiting for it.
+    #[cfg_attr(not(target_arch = "x86_64"), allow(unused_variables))]
+    pub fn prefetch(&self, hash: u64) {
+        #[cfg(target_arch = "x86_64")]
+        {
+            use ::std::arch::x86_64::{_mm_prefetch, _MM_HINT_T0};
+            let index: usize = self.index(hash);
+            // Safety: the index is within both arrays and prefetching never faults.
+            unsafe {
+                _mm_prefetch::<_MM_HINT_T0>(self.tags.as_ptr().add(index) as *const i8);
+                _mm_prefetch::<_MM_HINT_T0>(self.entries.as_ptr().add(index) as *const i8);
+            }
+        }
+    }
+
+    /// Looks up the entry of `key`.
+    pub fn get_mut(&mut self, key: &FlowKey) -> Option<&mut V> {
+        let hash: u64 = self.hash(key);
+        self.get_mut_with_hash(key, hash)
+    }
+
+    /// Looks up the entry of `key`, whose hash `hash` was computed by [hash](Self::hash).
+    pub fn get_mut_with_hash(&mut self, key: &FlowKey, hash: u64) -> Option<&mut V> {
+        debug_assert_eq!(hash, self.hash(key));
+        let index: usize = self.find(key, hash)?;
+        self.entries[index].as_mut().map(|(_, value)| value)
+    }
+
+    /// Inserts `value` under `key`, returning the value that was already stored under it, if any.
+    pub fn insert(&mut self, key: FlowKey, value: V) -> Option<V> {
+        let hash: u64 = self.hash(&key);
+        if let Some(index) = self.find(&key, hash) {
+            let (_, old_value): &mut (FlowKey, V) =
+                expect_some!(self.entries[index].as_mut(), "occupied slot must hold an entry");
+            return Some(mem::replace(old_value, value));
+        }
+
+        if (self.len + 1) * 4 > self.tags.len() * 3 {
+            self.grow();
+        }
+        self.place(key, value, hash);
+        self.len += 1;
+        None
+    }
+
+    /// Removes the entry of `key`, returning its value.
+    pub fn remove(&mut self, key: &FlowKey) -> Option<V> {
+        let hash: u64 = self.hash(key);
+        let index: usize = self.find(key, hash)?;
+        let (_, value): (FlowKey, V) = expect_some!(self.entries[index].take(), "occupied slot must hold an entry");
+
+        // Shift back the entries that follow in the probe run and whose home slot is not past the hole, so that
+        // every entry stays reachable from its home slot without crossing an empty slot.
+        let mut hole: usize = index;
+        let mut next: usize = (index + 1) & self.mask;
+        while self.tags[next] != EMPTY {
+            let home: usize = match &self.entries[next] {
+                Some((next_key, _)) => self.index(self.hash(next_key)),
+                None => unreachable!("occupied slot must hold an entry"),
+            };
+            if next.wrapping_sub(home) & self.mask >= next.wrapping_sub(hole) & self.mask {
+                self.tags[hole] = self.tags[next];
+                self.entries.swap(hole, next);
+                hole = next;
+            }
+            next = (next + 1) & self.mask;
+        }
+        self.tags[hole] = EMPTY;
+        self.len -= 1;
+        Some(value)
+    }
+
+    /// Returns the slot that holds `key`, if any.
+    fn find(&self, key: &FlowKey, hash: u64) -> Option<usize> {
+        let tag: u32 = Self::tag(hash);
+        let mut index: usize = self.index(hash);
+        // The table is never full, so every probe run ends with an empty slot.
+        loop {
+            match self.tags[index] {
+                EMPTY => return None,
+                t if t == tag => match &self.entries[index] {
+                    Some((entry_key, _)) if entry_key == key => return Some(index),
+                    _ => (),
+                },
+                _ => (),
+            }
+            index = (index + 1) & self.mask;
+        }
+    }
+
+    /// Stores an entry in the first empty slot of its probe run.
+    fn place(&mut self, key: FlowKey, value: V, hash: u64) {
+        let mut index: usize = self.index(hash);
+        while self.tags[index] != EMPTY {
+            index = (index + 1) & self.mask;
+        }
+        self.tags[index] = Self::tag(hash);
+        self.entries[index] = Some((key, value));
+    }
+
+    /// Doubles the number of slots and rehashes all entries.
+    fn grow(&mut self) {
+        let capacity: usize = self.tags.len() * 2;
+        let entries: Vec<Option<(FlowKey, V)>> = mem::replace(&mut self.entries, Self::empty_entries(capacity));
+        self.tags = vec![EMPTY; capacity];
+        self.mask = capacity - 1;
+        for (key, value) in entries.into_iter().flatten() {
+            let hash: u64 = self.hash(&key);
+            self.place(key, value, hash);
+        }
+    }
+
+    fn empty_entries(capacity: usize) -> Vec<Option<(FlowKey, V)>> {
+        let mut entries: Vec<Option<(FlowKey, V)>> = Vec::with_capacity(capacity);
+        entries.resize_with(capacity, || None);
+        entries
+    }
+
+    /// Home slot of a key with hash `hash`. This takes the upper bits, which are independent of the tag.
+    fn index(&self, hash: u64) -> usize {
+        (hash >> 32) as usize & self.mask
+    }
+
+    fn tag(hash: u64) -> u32 {
+        hash as u32 | 1
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use super::{FlowKey, FlowTable};
+    use ::anyhow::Result;
+    use ::rand::{prelude::SmallRng, seq::SliceRandom, Rng, SeedableRng};
+    use ::std::{
+        collections::HashMap,
+        net::{Ipv4Addr, SocketAddrV4},
+    };
+    use ::test::{black_box, Bencher};
+
+    /// Returns the key of the `i`-th of many connections of a server.
+    fn key(i: usize) -> FlowKey {
+        let local: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 1), 80);
+        let remote: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::from(0x0a00_0000 | (i >> 16) as u32), i as u16);
+        FlowKey::new(local, remote)
+    }
+
+    #[test]
+    fn insert_get_remove() -> Result<()> {
+        let mut table: FlowTable<usize> = FlowTable::new(7);
+        for i in 0..1000 {
+            crate::ensure_eq!(table.insert(key(i), i), None::<usize>);
+        }
+        crate::ensure_eq!(table.len(), 1000);
+        crate::ensure_eq!(table.insert(key(3), 33), Some(3));
+        crate::ensure_eq!(table.len(), 1000);
+
+        for i in (0..1000).step_by(2) {
+            crate::ensure_eq!(table.remove(&key(i)), Some(if i == 3 { 33 } else { i }));
+        }
+        crate::ensure_eq!(table.len(), 500);
+        for i in 0..1000 {
+            let expected: Option<usize> = match i {
+                _ if i % 2 == 0 => None,
+                3 => Some(33),
+                _ => Some(i),
+            };
+            crate::ensure_eq!(table.get_mut(&key(i)).copied(), expected);
+        }
+        crate::ensure_eq!(table.remove(&key(0)), None::<usize>);
+
+        for i in (1..1000).step_by(2) {
+            table.remove(&key(i));
+        }
+        crate::ensure_eq!(table.is_empty(), true);
+
+        Ok(())
+    }
+
+    /// Mixes random inserts and removes on a small table, so that probe runs often wrap around its end, and checks
+    /// the table against a [HashMap].
+    #[test]
+    fn matches_hash_map() -> Result<()> {
+        let mut rng: SmallRng = SmallRng::seed_from_u64(42);
+        let mut table: FlowTable<u32> = FlowTable::new(rng.gen());
+        let mut reference: HashMap<usize, u32> = HashMap::new();
+        for _ in 0..100_000 {
+            let i: usize = rng.gen_range(0..24);
+            if rng.gen_bool(0.5) {
+                let value: u32 = rng.gen();
+                crate::ensure_eq!(table.insert(key(i), value), reference.insert(i, value));
+            } else {
+                crate::ensure_eq!(table.remove(&key(i)), reference.remove(&i));
+            }
+            crate::ensure_eq!(table.len(), reference.len());
+        }
+        for i in 0..24 {
+            crate::ensure_eq!(table.get_mut(&key(i)).copied(), reference.get(&i).copied());
+        }
+
+        Ok(())
+    }
+
+    /// Looks up random connections among `count` established ones.
+    fn bench_flow_table(b: &mut Bencher, count: usize) {
+        let mut table: FlowTable<usize> = FlowTable::new(7);
+        for i in 0..count {
+            table.insert(key(i), i);
+        }
+        let mut keys: Vec<FlowKey> = (0..count).map(key).collect();
+        keys.shuffle(&mut SmallRng::seed_from_u64(42));
+        let mut next: usize = 0;
+
+        b.iter(|| {
+            let key: &FlowKey = &keys[next];
+            next = (next + 1) % keys.len();
+            black_box(table.get_mut(black_box(key)).copied())
+        });
+    }
+
+    /// Same as [bench_flow_table], with the standard [HashMap] as a baseline.
+    fn bench_hash_map(b: &mut Bencher, count: usize) {
+        let mut table: HashMap<(SocketAddrV4, SocketAddrV4), usize> = HashMap::new();
+        let endpoints = |i: usize| {
+            let local: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 1), 80);
+            let remote: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::from(0x0a00_0000 | (i >> 16) as u32), i as u16);
+            (local, remote)
+        };
+        for i in 0..count {
+            table.insert(endpoints(i), i);
+        }
+        let mut keys: Vec<(SocketAddrV4, SocketAddrV4)> = (0..count).map(endpoints).collect();
+        keys.shuffle(&mut SmallRng::seed_from_u64(42));
+        let mut next: usize = 0;
+
+        b.iter(|| {
+            let key: &(SocketAddrV4, SocketAddrV4) = &keys[next];
+            next = (next + 1) % keys.len();
+            black_box(table.get_mut(black_box(key)).copied())
+        });
+    }
+
+    #[bench]
+    fn bench_flow_table_1k(b: &mut Bencher) {
+        bench_flow_table(b, 1 << 10);
+    }
+
+    #[bench]
+    fn bench_flow_table_64k(b: &mut Bencher) {
+        bench_flow_table(b, 1 << 16);
+    }
+
+    #[bench]
+    fn bench_flow_table_1m(b: &mut Bencher) {
+        bench_flow_table(b, 1 << 20);
+    }
+
+    #[bench]
+    fn bench_hash_map_1k(b: &mut Bencher) {
+        bench_hash_map(b, 1 << 10);
+    }
+
+    #[bench]
+    fn bench_hash_map_64k(b: &mut Bencher) {
+        bench_hash_map(b, 1 << 16);
+    }
+
+    #[bench]
+    fn bench_hash_map_1m(b: &mut Bencher) {
+        bench_hash_map(b, 1 << 20);
+    }
+}
@@ -6,6 +6,7 @@
 //======================================================================================================================
 
 pub mod ephemeral;
+pub mod flow_table;
 pub mod tcp;
 pub mod udp;
 
@@ -20,7 +21,7 @@ use crate::{
     demikernel::config::Config,
     expect_some,
     inetstack::protocols::{
-        layer3::{ip::IpProtocol, SharedLayer3Endpoint},
+        layer3::{ip::IpProtocol, Ipv4Header, SharedLayer3Endpoint, IPV4_ECN_CE},
         layer4::{
             ephemeral::EphemeralPorts,
             tcp::{SharedTcpPeer, SharedTcpSocket},
@@ -30,7 +31,7 @@ use crate::{
     runtime::{
         fail::Fail,
         memory::{DemiBuffer, MemoryRuntime},
-        network::{consts::RECEIVE_BATCH_SIZE, unwrap_socketaddr},
+        network::{consts::RECEIVE_BATCH_SIZE, rss::RssSteering, unwrap_socketaddr},
         SharedDemiRuntime,
     },
     timer, SocketOption,
@@ -51,6 +52,8 @@ pub struct Peer {
     udp: SharedUdpPeer,
     layer3_endpoint: SharedLayer3Endpoint,
     ephemeral_ports: EphemeralPorts,
+    /// Flow steering of the underlying hardware. This is only set if the stack serves one of several receive queues.
+    rss_steering: Option<RssSteering>,
 }
 
 /// Socket Representation.
@@ -74,11 +77,13 @@ impl Peer {
         let udp: SharedUdpPeer = SharedUdpPeer::new(config, runtime.clone(), layer3_endpoint.clone())?;
         let tcp: SharedTcpPeer = SharedTcpPeer::new(config, runtime.clone(), layer3_endpoint.clone(), rng_seed)?;
 
+        let rss_steering: Option<RssSteering> = layer3_endpoint.get_rss_steering();
         Ok(Peer {
             tcp,
             udp,
             layer3_endpoint,
             ephemeral_ports: EphemeralPorts::default(),
+            rss_steering,
         })
     }
 
@@ -94,16 +99,35 @@ impl Peer {
         }
     }
 
-    fn receive_batch(&mut self, batch: ArrayVec<(Ipv4Addr, IpProtocol, DemiBuffer), RECEIVE_BATCH_SIZE>) {
+    /// Flushes packets staged in the lower layers.
+    pub fn flush(&mut self) {
+        if let Err(e) = self.layer3_endpoint.flush() {
+            warn!(
+                "Could not flush packets to network interface, continuing ... (error={:?})",
+                e
+            );
+        }
+    }
+
+    fn receive_batch(&mut self, batch: ArrayVec<(Ipv4Header, DemiBuffer), RECEIVE_BATCH_SIZE>) {
         timer!("inetstack::poll_bg_work::for::for");
         trace!("found packets: {:?}", batch.len());
-        for (src_ipv4_addr, ip_type, payload) in batch {
-            match ip_type {
-                IpProtocol::TCP => self.tcp.receive(src_ipv4_addr, payload),
+        // TCP segments are handed over together, so the TCP peer can overlap the lookups of their connections.
+        let mut tcp_batch: ArrayVec<(Ipv4Addr, bool, DemiBuffer), RECEIVE_BATCH_SIZE> = ArrayVec::new();
+        for (ipv4_hdr, payload) in batch {
+            let src_ipv4_addr: Ipv4Addr = ipv4_hdr.get_src_addr();
+            match ipv4_hdr.get_protocol() {
+                IpProtocol::TCP => {
+                    let congestion_experienced: bool = ipv4_hdr.get_ecn() == IPV4_ECN_CE;
+                    tcp_batch.push((src_ipv4_addr, congestion_experienced, payload))
+                },
                 IpProtocol::UDP => self.udp.receive(src_ipv4_addr, payload),
                 _ => unreachable!("Should have been handled at a lower layer"),
             }
         }
+        if !tcp_batch.is_empty() {
+            self.tcp.receive_batch(tcp_batch);
+        }
     }
 
     pub fn socket(&mut self, domain: Domain, typ: Type) -> Result<Socket, Fail> {
@@ -276,7 +300,17 @@ impl Peer {
                 // If not bound, allocate an ephemeral port.
                 let local: SocketAddrV4 = match socket.local() {
                     Some(local) => local,
-                    None => SocketAddrV4::new(self.layer3_endpoint.get_local_addr(), self.ephemeral_ports.alloc()?),
+                    None => {
+                        let local_ipv4_addr: Ipv4Addr = self.layer3_endpoint.get_local_addr();
+                        let port: u16 = match self.rss_steering {
+                            // Pick a port for which the replies of the remote are steered back to our own queue.
+                            Some(rss_steering) => self.ephemeral_ports.alloc_matching(|port| {
+                                rss_steering.is_local_flow(&SocketAddrV4::new(local_ipv4_addr, port), &remote)
+                            })?,
+                            None => self.ephemeral_ports.alloc()?,
+                        };
+                        SocketAddrV4::new(local_ipv4_addr, port)
+                    },
                 };
 
                 self.tcp.connect(socket, local, remote).await
@@ -394,8 +428,8 @@ impl MemoryRuntime for Peer {
         self.layer3_endpoint.into_sgarray(buf)
     }
 
-    fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        self.layer3_endpoint.sgaalloc(size)
+    fn sgaallocv(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
+        self.layer3_endpoint.sgaallocv(seglens)
     }
 
     fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
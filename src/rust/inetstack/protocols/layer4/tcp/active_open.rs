@@ -9,13 +9,10 @@ use crate::{
     collections::{async_queue::SharedAsyncQueue, async_value::SharedAsyncValue},
     expect_some,
     inetstack::protocols::{
-        layer3::SharedLayer3Endpoint,
+        layer3::{SharedLayer3Endpoint, IPV4_ECN_NOT_ECT},
         layer4::tcp::{
             constants::{FALLBACK_MSS, MAX_WINDOW_SCALE},
-            established::{
-                congestion_control::{self, CongestionControl},
-                EstablishedSocket,
-            },
+            established::{congestion_control, EstablishedSocket},
             header::{TcpHeader, TcpOptions2},
             SeqNumber,
         },
@@ -138,16 +135,21 @@ impl SharedActiveOpenSocket {
             self.tcp_config.get_rx_checksum_offload(),
         );
         self.layer3_endpoint
-            .transmit_tcp_packet_nonblocking(dst_ipv4_addr, pkt)?;
+            .transmit_tcp_packet_nonblocking(dst_ipv4_addr, IPV4_ECN_NOT_ECT, pkt)?;
 
         let mut remote_window_scale = None;
         let mut mss = FALLBACK_MSS;
+        let mut sack_permitted: bool = false;
         for option in header.iter_options() {
             match option {
                 TcpOptions2::WindowScale(w) => {
                     info!("Received window scale: {}", w);
                     remote_window_scale = Some(*w);
                 },
+                TcpOptions2::SelectiveAcknowlegementPermitted => {
+                    info!("Received SACK permitted");
+                    sack_permitted = true;
+                },
                 TcpOptions2::MaximumSegmentSize(m) => {
                     info!("Received advertised MSS: {}", m);
                     mss = *m as usize;
@@ -155,6 +157,8 @@ impl SharedActiveOpenSocket {
                 _ => continue,
             }
         }
+        // Our peer agreed to ECN if it answered our ECN-setup SYN with ECE but not CWR (RFC 3168).
+        let ecn_capable: bool = self.socket_options.get_congestion_control().uses_ecn() && header.ece && !header.cwr;
 
         let (local_window_scale, remote_window_scale): (u8, u8) = match remote_window_scale {
             Some(remote_window_scale) => {
@@ -207,7 +211,9 @@ impl SharedActiveOpenSocket {
             tx_window_size,
             remote_window_scale,
             mss,
-            congestion_control::None::new,
+            sack_permitted,
+            ecn_capable,
+            congestion_control::constructor(self.socket_options.get_congestion_control()),
             None,
         )?)
     }
@@ -232,6 +238,16 @@ impl SharedActiveOpenSocket {
             tcp_hdr.push_option(TcpOptions2::WindowScale(self.tcp_config.get_window_scale()));
             info!("Advertising window scale: {}", self.tcp_config.get_window_scale());
 
+            tcp_hdr.push_option(TcpOptions2::SelectiveAcknowlegementPermitted);
+            info!("Advertising SACK permitted");
+
+            // Offer ECN with an ECN-setup SYN if our congestion control reacts to marks (RFC 3168).
+            if self.socket_options.get_congestion_control().uses_ecn() {
+                tcp_hdr.ece = true;
+                tcp_hdr.cwr = true;
+                info!("Offering ECN");
+            }
+
             debug!("Sending SYN {:?}", tcp_hdr);
             let dst_ipv4_addr: Ipv4Addr = self.remote.ip().clone();
             let mut pkt: DemiBuffer = DemiBuffer::new_with_headroom(0, MAX_HEADER_SIZE as u16);
@@ -244,8 +260,7 @@ impl SharedActiveOpenSocket {
             // Send SYN.
             if let Err(e) = self
                 .layer3_endpoint
-                .transmit_tcp_packet_blocking(dst_ipv4_addr, pkt)
-                .await
+                .transmit_tcp_packet_nonblocking(dst_ipv4_addr, IPV4_ECN_NOT_ECT, pkt)
             {
                 warn!("Could not send SYN: {:?}", e);
                 continue;
@@ -0,0 +1,512 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// This is BBR congestion control (draft-ietf-ccwg-bbr). Rather than reacting to loss, BBR builds a model of the path
+// from delivery rate samples: the bottleneck bandwidth is the maximum delivery rate over the last few rounds, and the
+// propagation delay is the minimum RTT over the last few seconds. Segments are paced at a multiple of the bandwidth and
+// the data in flight is bounded by a multiple of the bandwidth-delay product, which keeps the bottleneck busy without
+// filling its queue. As in BBRv2, we also bound the data in flight below the level at which we last saw loss. Unlike
+// BBRv2, this does not detect application-limited samples, does not respond to ECN marks and probes for bandwidth in a
+// single phase.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    collections::async_value::SharedAsyncValue,
+    inetstack::protocols::layer4::tcp::{
+        established::congestion_control::{
+            CongestionControl, ExplicitCongestionNotification, FastRetransmitRecovery, LimitedTransmit, Options,
+            Pacing, RateSample, SlowStartCongestionAvoidance,
+        },
+        SeqNumber,
+    },
+};
+use ::std::{
+    cmp::{max, min},
+    fmt::Debug,
+    time::{Duration, Instant},
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of rounds over which the maximum delivery rate is the estimate of the bottleneck bandwidth.
+const BW_FILTER_ROUNDS: usize = 10;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+enum Mode {
+    // Doubles the sending rate every round until the bandwidth stops growing.
+    Startup,
+    // Drains the queue that startup built up.
+    Drain,
+    // Cycles the pacing rate around the bandwidth to probe for more of it.
+    ProbeBw,
+    // Shrinks cwnd for a while to let queues drain and measure the propagation delay again.
+    ProbeRtt,
+}
+
+#[derive(Debug)]
+pub struct Bbr {
+    mss: u32,
+    cwnd: SharedAsyncValue<u32>, // Congestion window: Max number of bytes that may be in flight to prevent congestion.
+    initial_cwnd: u32,           // The value of cwnd until we have a model of the path.
+    mode: Mode,
+    pacing_gain: f64,
+    cwnd_gain: f64,
+    pacing_rate: Option<u64>, // In bytes per second, once we have a bandwidth sample.
+
+    // Path Model.
+    bw_filter: [u64; BW_FILTER_ROUNDS], // Maximum delivery rate of each of the last rounds, in bytes per second.
+    round_count: u64,                   // Number of rounds; a round ends once a segment sent in it is acknowledged.
+    next_round_delivered: u64,          // Delivered bytes at which the current round ends.
+    round_start: bool,                  // Whether the last rate sample started a new round.
+    min_rtt: Option<Duration>,
+    min_rtt_stamp: Instant, // When min_rtt was last measured.
+    bytes_in_flight: u32,
+    inflight_hi: u32, // Bound on the data in flight, which loss lowers (BBRv2).
+
+    // Startup State.
+    full_bw: u64,       // Highest bandwidth estimate in startup.
+    full_bw_count: u32, // Number of rounds in which the bandwidth estimate did not grow much over full_bw.
+    filled_pipe: bool,  // Whether startup found the bottleneck bandwidth.
+
+    // Probe State.
+    cycle_index: usize,                    // Phase of the pacing gain cycle in ProbeBw.
+    cycle_stamp: Instant,                  // When the current phase of the gain cycle started.
+    probe_rtt_done_stamp: Option<Instant>, // When ProbeRtt ends, once the data in flight is low enough.
+    prior_cwnd: u32,                       // The value of cwnd before ProbeRtt or RTO, which we restore afterwards.
+
+    // Fast Retransmit State.
+    duplicate_ack_count: u32, // The number of consecutive duplicate ACKs we've received.
+    fast_retransmit_now: SharedAsyncValue<bool>, // Flag to cause the retransmitter to retransmit a segment now.
+
+    limited_transmit_cwnd_increase: SharedAsyncValue<u32>, // Always 0, BBR does not use limited transmit.
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl Bbr {
+    const DUP_ACK_THRESHOLD: u32 = 3;
+    const STARTUP_PACING_GAIN: f64 = 2.77;
+    const STARTUP_CWND_GAIN: f64 = 2.;
+    const DRAIN_PACING_GAIN: f64 = 0.35;
+    const PROBE_BW_CWND_GAIN: f64 = 2.;
+    const PROBE_RTT_CWND_GAIN: f64 = 0.5;
+    // Pacing gains of the phases of ProbeBw, each of which lasts for about one min_rtt.
+    const PACING_GAIN_CYCLE: [f64; 8] = [1.25, 0.75, 1., 1., 1., 1., 1., 1.];
+    // Pace slightly below the estimated bandwidth so that queues do not build up.
+    const PACING_MARGIN: f64 = 0.99;
+    // Startup ends once the bandwidth estimate grows by less than this factor for FULL_BW_ROUNDS rounds.
+    const FULL_BW_GROWTH: f64 = 1.25;
+    const FULL_BW_ROUNDS: u32 = 3;
+    const MIN_RTT_WINDOW: Duration = Duration::from_secs(5);
+    const PROBE_RTT_DURATION: Duration = Duration::from_millis(200);
+    // Fraction of the data in flight at a loss that inflight_hi keeps (BBRv2).
+    const BETA: f64 = 0.7;
+    // Segments that cwnd always allows to keep the ACK clock going.
+    const MIN_PIPE_SEGMENTS: u32 = 4;
+
+    fn max_bw(&self) -> u64 {
+        self.bw_filter.iter().copied().max().unwrap_or(0)
+    }
+
+    fn min_pipe_cwnd(&self) -> u32 {
+        Self::MIN_PIPE_SEGMENTS * self.mss
+    }
+
+    /// Returns `gain` times the estimated bandwidth-delay product, or the initial cwnd while we have no model yet.
+    fn bdp(&self, gain: f64) -> u32 {
+        match (self.min_rtt, self.max_bw()) {
+            (Some(min_rtt), bw) if bw > 0 => {
+                let bdp: f64 = gain * bw as f64 * min_rtt.as_secs_f64();
+                min(bdp as u64, u32::MAX as u64) as u32
+            },
+            _ => (gain * self.initial_cwnd as f64) as u32,
+        }
+    }
+
+    fn probe_rtt_cwnd(&self) -> u32 {
+        max(self.bdp(Self::PROBE_RTT_CWND_GAIN), self.min_pipe_cwnd())
+    }
+
+    /// Counts rounds of delivery and keeps the delivery rate of the sample in the bandwidth filter.
+    fn update_bw(&mut self, sample: &RateSample) {
+        if sample.prior_delivered >= self.next_round_delivered {
+            self.next_round_delivered = sample.prior_delivered + sample.delivered;
+            self.round_count += 1;
+            self.round_start = true;
+            self.bw_filter[(self.round_count % BW_FILTER_ROUNDS as u64) as usize] = 0;
+        } else {
+            self.round_start = false;
+        }
+
+        // Samples over intervals shorter than min_rtt come from compressed ACKs and overestimate the bandwidth.
+        let too_short: bool = self.min_rtt.map_or(false, |min_rtt| sample.interval < min_rtt);
+        if sample.interval.is_zero() || too_short {
+            return;
+        }
+        let bw: u64 = (sample.delivered as f64 / sample.interval.as_secs_f64()) as u64;
+        let slot: &mut u64 = &mut self.bw_filter[(self.round_count % BW_FILTER_ROUNDS as u64) as usize];
+        *slot = max(*slot, bw);
+    }
+
+    /// Keeps the minimum RTT of the last MIN_RTT_WINDOW and returns whether the previous minimum expired.
+    fn update_min_rtt(&mut self, sample: &RateSample) -> bool {
+        let expired: bool = sample.now > self.min_rtt_stamp + Self::MIN_RTT_WINDOW;
+        if self.min_rtt.map_or(true, |min_rtt| sample.rtt <= min_rtt) || expired {
+            self.min_rtt = Some(sample.rtt);
+            self.min_rtt_stamp = sample.now;
+        }
+        expired
+    }
+
+    fn check_full_pipe(&mut self) {
+        if self.filled_pipe || !self.round_start {
+            return;
+        }
+        let max_bw: u64 = self.max_bw();
+        if max_bw as f64 >= self.full_bw as f64 * Self::FULL_BW_GROWTH {
+            self.full_bw = max_bw;
+            self.full_bw_count = 0;
+            return;
+        }
+        self.full_bw_count += 1;
+        self.filled_pipe = self.full_bw_count >= Self::FULL_BW_ROUNDS;
+    }
+
+    fn enter_startup(&mut self) {
+        self.mode = Mode::Startup;
+        self.pacing_gain = Self::STARTUP_PACING_GAIN;
+        self.cwnd_gain = Self::STARTUP_CWND_GAIN;
+    }
+
+    fn enter_probe_bw(&mut self, now: Instant) {
+        self.mode = Mode::ProbeBw;
+        self.cwnd_gain = Self::PROBE_BW_CWND_GAIN;
+        // Start in one of the cruising phases so that connections that share a bottleneck do not probe in lockstep.
+        self.cycle_index = 2 + (self.round_count as usize % (Self::PACING_GAIN_CYCLE.len() - 2));
+        self.pacing_gain = Self::PACING_GAIN_CYCLE[self.cycle_index];
+        self.cycle_stamp = now;
+    }
+
+    fn enter_probe_rtt(&mut self) {
+        self.mode = Mode::ProbeRtt;
+        self.pacing_gain = 1.;
+        self.cwnd_gain = 1.;
+        self.prior_cwnd = max(self.prior_cwnd, self.cwnd.get());
+        self.probe_rtt_done_stamp = None;
+    }
+
+    fn update_mode(&mut self, now: Instant, min_rtt_expired: bool) {
+        match self.mode {
+            Mode::Startup if self.filled_pipe => {
+                self.mode = Mode::Drain;
+                self.pacing_gain = Self::DRAIN_PACING_GAIN;
+                self.cwnd_gain = Self::STARTUP_CWND_GAIN;
+            },
+            Mode::Drain if self.bytes_in_flight <= self.bdp(1.) => self.enter_probe_bw(now),
+            Mode::ProbeBw => {
+                let phase_done: bool = self.min_rtt.map_or(false, |min_rtt| now > self.cycle_stamp + min_rtt);
+                if phase_done {
+                    self.cycle_index = (self.cycle_index + 1) % Self::PACING_GAIN_CYCLE.len();
+                    self.pacing_gain = Self::PACING_GAIN_CYCLE[self.cycle_index];
+                    self.cycle_stamp = now;
+                }
+                // Probing for bandwidth also probes for a higher bound on the data in flight.
+                if self.pacing_gain > 1. && self.round_start {
+                    self.inflight_hi = self.inflight_hi.saturating_add(max(self.inflight_hi / 4, self.mss));
+                }
+            },
+            Mode::ProbeRtt => match self.probe_rtt_done_stamp {
+                None if self.bytes_in_flight <= self.probe_rtt_cwnd() => {
+                    self.probe_rtt_done_stamp = Some(now + Self::PROBE_RTT_DURATION);
+                },
+                Some(done_stamp) if now >= done_stamp => {
+                    self.min_rtt_stamp = now;
+                    self.cwnd.set(max(self.cwnd.get(), self.prior_cwnd));
+                    self.prior_cwnd = 0;
+                    if self.filled_pipe {
+                        self.enter_probe_bw(now);
+                    } else {
+                        self.enter_startup();
+                    }
+                },
+                _ => (),
+            },
+            _ => (),
+        }
+
+        if min_rtt_expired && self.mode != Mode::ProbeRtt {
+            self.enter_probe_rtt();
+        }
+    }
+
+    fn update_pacing_rate(&mut self) {
+        let max_bw: u64 = self.max_bw();
+        if max_bw == 0 {
+            return;
+        }
+        let rate: u64 = (self.pacing_gain * max_bw as f64 * Self::PACING_MARGIN) as u64;
+        // Until the pipe is full, never slow down, as the bandwidth estimate may still be low.
+        if self.filled_pipe || self.pacing_rate.map_or(true, |pacing_rate| rate > pacing_rate) {
+            self.pacing_rate = Some(max(rate, 1));
+        }
+    }
+
+    fn update_cwnd(&mut self, bytes_acknowledged: u32) {
+        let target: u32 = self
+            .bdp(self.cwnd_gain)
+            .saturating_add(Self::DUP_ACK_THRESHOLD * self.mss);
+        let cwnd: u32 = self.cwnd.get();
+        let mut new_cwnd: u32 = if self.filled_pipe {
+            min(cwnd.saturating_add(bytes_acknowledged), target)
+        } else if cwnd < target {
+            cwnd.saturating_add(bytes_acknowledged)
+        } else {
+            cwnd
+        };
+        new_cwnd = max(min(new_cwnd, self.inflight_hi), self.min_pipe_cwnd());
+        if self.mode == Mode::ProbeRtt {
+            new_cwnd = min(new_cwnd, self.probe_rtt_cwnd());
+        }
+        if new_cwnd != cwnd {
+            self.cwnd.set(new_cwnd);
+        }
+    }
+
+    /// Lowers the bound on the data in flight to a fraction of what was in flight at the loss (BBRv2). Loss also ends
+    /// startup, as the pipe is evidently full.
+    fn on_loss(&mut self) {
+        let inflight: u32 = match self.bytes_in_flight {
+            0 => self.cwnd.get(),
+            bytes_in_flight => bytes_in_flight,
+        };
+        self.inflight_hi = max((inflight as f64 * Self::BETA) as u32, self.min_pipe_cwnd());
+        self.filled_pipe = true;
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl CongestionControl for Bbr {
+    fn new(mss: usize, _seq_no: SeqNumber, _options: Option<Options>) -> Box<dyn CongestionControl> {
+        let mss: u32 = mss.try_into().unwrap();
+        // The initial value of cwnd is set according to RFC5681, section 3.1, page 7.
+        let initial_cwnd: u32 = match mss {
+            0..=1095 => 4 * mss,
+            1096..=2190 => 3 * mss,
+            _ => 2 * mss,
+        };
+        let now: Instant = Instant::now();
+
+        Box::new(Self {
+            mss,
+            cwnd: SharedAsyncValue::new(initial_cwnd),
+            initial_cwnd,
+            mode: Mode::Startup,
+            pacing_gain: Self::STARTUP_PACING_GAIN,
+            cwnd_gain: Self::STARTUP_CWND_GAIN,
+            pacing_rate: None,
+
+            bw_filter: [0; BW_FILTER_ROUNDS],
+            round_count: 0,
+            next_round_delivered: 0,
+            round_start: false,
+            min_rtt: None,
+            min_rtt_stamp: now,
+            bytes_in_flight: 0,
+            inflight_hi: u32::MAX,
+
+            full_bw: 0,
+            full_bw_count: 0,
+            filled_pipe: false,
+
+            cycle_index: 0,
+            cycle_stamp: now,
+            probe_rtt_done_stamp: None,
+            prior_cwnd: 0,
+
+            duplicate_ack_count: 0,
+            fast_retransmit_now: SharedAsyncValue::new(false),
+
+            limited_transmit_cwnd_increase: SharedAsyncValue::new(0),
+        })
+    }
+}
+
+impl SlowStartCongestionAvoidance for Bbr {
+    fn get_cwnd(&self) -> SharedAsyncValue<u32> {
+        self.cwnd.clone()
+    }
+
+    fn on_ack_received(
+        &mut self,
+        _rto: Duration,
+        send_unacked: SeqNumber,
+        send_next: SeqNumber,
+        ack_seq_no: SeqNumber,
+    ) {
+        let bytes_acknowledged: u32 = (ack_seq_no - send_unacked).into();
+        self.bytes_in_flight = (send_next - ack_seq_no).into();
+        if bytes_acknowledged == 0 {
+            // ACK is a duplicate
+            self.duplicate_ack_count += 1;
+            if self.duplicate_ack_count == Self::DUP_ACK_THRESHOLD {
+                self.on_loss();
+                self.fast_retransmit_now.set(true);
+            }
+        } else {
+            self.duplicate_ack_count = 0;
+            self.update_cwnd(bytes_acknowledged);
+        }
+    }
+
+    fn on_rto(&mut self, _send_unacked: SeqNumber) {
+        self.on_loss();
+        self.prior_cwnd = max(self.prior_cwnd, self.cwnd.get());
+        self.cwnd.set(self.mss);
+    }
+}
+
+impl FastRetransmitRecovery for Bbr {
+    fn get_duplicate_ack_count(&self) -> u32 {
+        self.duplicate_ack_count
+    }
+
+    fn get_retransmit_now_flag(&self) -> SharedAsyncValue<bool> {
+        self.fast_retransmit_now.clone()
+    }
+
+    fn on_fast_retransmit(&mut self) {
+        self.fast_retransmit_now.set_without_notify(false);
+    }
+}
+
+impl LimitedTransmit for Bbr {
+    fn get_limited_transmit_cwnd_increase(&self) -> SharedAsyncValue<u32> {
+        self.limited_transmit_cwnd_increase.clone()
+    }
+}
+
+impl ExplicitCongestionNotification for Bbr {}
+
+impl Pacing for Bbr {
+    fn get_pacing_rate(&self) -> Option<u64> {
+        self.pacing_rate
+    }
+
+    fn on_rate_sample(&mut self, sample: &RateSample) {
+        self.bytes_in_flight = sample.bytes_in_flight;
+        self.update_bw(sample);
+        let min_rtt_expired: bool = self.update_min_rtt(sample);
+        self.check_full_pipe();
+        self.update_mode(sample.now, min_rtt_expired);
+        self.update_pacing_rate();
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::inetstack::protocols::layer4::tcp::{
+        established::congestion_control::{Bbr, CongestionControl, RateSample},
+        SeqNumber,
+    };
+    use ::anyhow::Result;
+    use ::std::{
+        cmp::min,
+        time::{Duration, Instant},
+    };
+
+    const MSS: u32 = 1000;
+    const RTT: Duration = Duration::from_millis(10);
+
+    /// Feeds `cc` a sample that ends a round, at `bw` bytes per second.
+    fn deliver_round(cc: &mut Box<dyn CongestionControl>, delivered: &mut u64, now: &mut Instant, bw: u64) {
+        let bytes: u64 = bw * RTT.as_millis() as u64 / 1000;
+        let prior_delivered: u64 = *delivered;
+        *delivered += bytes;
+        *now += RTT;
+        cc.on_rate_sample(&RateSample {
+            delivered: bytes,
+            prior_delivered,
+            interval: RTT,
+            rtt: RTT,
+            bytes_in_flight: bytes as u32,
+            now: *now,
+        });
+    }
+
+    /// Checks that startup leaves once the bandwidth stops growing and that cwnd then settles near the BDP.
+    #[test]
+    fn test_bbr_startup_to_probe_bw() -> Result<()> {
+        let mut cc: Box<dyn CongestionControl> = Bbr::new(MSS as usize, SeqNumber::from(0), None);
+        crate::ensure_eq!(cc.get_pacing_rate(), None);
+
+        let mut delivered: u64 = 0;
+        let mut now: Instant = Instant::now();
+        let bw: u64 = 10_000_000;
+        for round in 0..10 {
+            deliver_round(&mut cc, &mut delivered, &mut now, min(bw, 1_000_000 << round));
+        }
+        // The pacing rate tracks the bottleneck bandwidth, up or down by the gain of the current phase.
+        let pacing_rate: u64 = cc.get_pacing_rate().unwrap_or(0);
+        crate::ensure_eq!(pacing_rate >= bw / 2, true);
+        crate::ensure_eq!(pacing_rate <= bw * 2, true);
+
+        // Grow cwnd with ACKs and check that it stops at about twice the BDP.
+        let mut send_unacked: SeqNumber = SeqNumber::from(0);
+        for _ in 0..1000 {
+            let ack_seq_no: SeqNumber = send_unacked + SeqNumber::from(MSS);
+            cc.on_ack_received(RTT, send_unacked, ack_seq_no + SeqNumber::from(MSS), ack_seq_no);
+            send_unacked = ack_seq_no;
+        }
+        let bdp: u32 = (bw * RTT.as_millis() as u64 / 1000) as u32;
+        crate::ensure_eq!(cc.get_cwnd().get(), 2 * bdp + 3 * MSS);
+        Ok(())
+    }
+
+    /// Checks that loss bounds cwnd below the data that was in flight.
+    #[test]
+    fn test_bbr_loss_bounds_inflight() -> Result<()> {
+        let mut cc: Box<dyn CongestionControl> = Bbr::new(MSS as usize, SeqNumber::from(0), None);
+        let mut delivered: u64 = 0;
+        let mut now: Instant = Instant::now();
+        for _ in 0..3 {
+            deliver_round(&mut cc, &mut delivered, &mut now, 10_000_000);
+        }
+
+        // Grow cwnd well beyond what is in flight at the loss.
+        let mut send_unacked: SeqNumber = SeqNumber::from(0);
+        for _ in 0..100 {
+            let ack_seq_no: SeqNumber = send_unacked + SeqNumber::from(MSS);
+            cc.on_ack_received(RTT, send_unacked, ack_seq_no + SeqNumber::from(MSS), ack_seq_no);
+            send_unacked = ack_seq_no;
+        }
+        crate::ensure_eq!(cc.get_cwnd().get() > 50 * MSS, true);
+
+        let send_next: SeqNumber = send_unacked + SeqNumber::from(50 * MSS);
+        for _ in 0..3 {
+            cc.on_ack_received(RTT, send_unacked, send_next, send_unacked);
+        }
+        crate::ensure_eq!(cc.get_retransmit_now_flag().get(), true);
+        let ack_seq_no: SeqNumber = send_unacked + SeqNumber::from(MSS);
+        cc.on_ack_received(RTT, send_unacked, send_next, ack_seq_no);
+        crate::ensure_eq!(cc.get_cwnd().get(), 35 * MSS);
+        Ok(())
+    }
+}
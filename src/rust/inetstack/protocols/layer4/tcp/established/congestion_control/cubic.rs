@@ -17,7 +17,8 @@ use crate::{
     collections::async_value::SharedAsyncValue,
     inetstack::protocols::layer4::tcp::{
         established::congestion_control::{
-            CongestionControl, FastRetransmitRecovery, LimitedTransmit, Options, SlowStartCongestionAvoidance,
+            CongestionControl, ExplicitCongestionNotification, FastRetransmitRecovery, LimitedTransmit, Options,
+            Pacing, SlowStartCongestionAvoidance,
         },
         SeqNumber,
     },
@@ -356,3 +357,7 @@ impl LimitedTransmit for Cubic {
         self.limited_transmit_cwnd_increase.clone()
     }
 }
+
+impl ExplicitCongestionNotification for Cubic {}
+
+impl Pacing for Cubic {}
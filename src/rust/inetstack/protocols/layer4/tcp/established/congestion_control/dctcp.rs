@@ -0,0 +1,352 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// This is Data Center TCP (RFC 8257). Windows grow as in standard TCP (RFC 5681) and loss is handled with NewReno fast
+// recovery (RFC 6582), but the response to ECN marks differs: rather than halving cwnd on every mark, the sender keeps
+// an estimate (alpha) of the fraction of bytes that switches marked over the last windows of data, and cuts cwnd in
+// proportion to it, at most once per window. This only makes sense on networks whose switches mark packets at a
+// shallow queue threshold, such as data centers.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    collections::async_value::SharedAsyncValue,
+    inetstack::protocols::layer4::tcp::{
+        established::congestion_control::{
+            CongestionControl, ExplicitCongestionNotification, FastRetransmitRecovery, LimitedTransmit, Options,
+            Pacing, SlowStartCongestionAvoidance,
+        },
+        SeqNumber,
+    },
+};
+use ::std::{
+    cmp::{max, min},
+    fmt::Debug,
+    time::Duration,
+};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+#[derive(Debug)]
+pub struct Dctcp {
+    mss: u32,
+    // Slow Start / Congestion Avoidance State.
+    cwnd: SharedAsyncValue<u32>, // Congestion window: Max number of bytes that may be in flight to prevent congestion.
+    ssthresh: u32, // The size of cwnd at which we will change from using slow start to congestion avoidance.
+
+    // ECN State.
+    alpha: f64,              // Estimate of the fraction of bytes that get marked, between 0 and 1.
+    g: f64,                  // Weight given to the fraction of marked bytes of the last window when updating alpha.
+    ece: bool,               // Whether the ACK that we are processing echoes a Congestion Experienced mark.
+    window_end: SeqNumber,   // The end of the current observation window, which spans one window of data.
+    bytes_acked: u32,        // Bytes acknowledged in the current observation window.
+    bytes_marked: u32,       // Bytes acknowledged by ACKs that echo a mark in the current observation window.
+    reduced_in_window: bool, // Whether cwnd has already been cut for marks in the current observation window.
+    cwr_pending: bool,       // Whether the next segment of new data should carry the CWR flag.
+
+    // Fast Recovery / Fast Retransmit State
+    duplicate_ack_count: u32, // The number of consecutive duplicate ACKs we've received.
+    fast_retransmit_now: SharedAsyncValue<bool>, // Flag to cause the retransmitter to retransmit a segment now.
+    in_fast_recovery: bool,   // Are we currently in the `fast recovery` algorithm.
+    recover: SeqNumber, // If we receive dup ACKs with sequence numbers greater than this we'll attempt fast recovery.
+
+    limited_transmit_cwnd_increase: SharedAsyncValue<u32>, // The amount by which cwnd should be increased due to the limited transit algorithm.
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl Dctcp {
+    const DUP_ACK_THRESHOLD: u32 = 3;
+    // Default weight of new samples in the estimate of alpha (RFC 8257, section 4.2).
+    const DEFAULT_G: f64 = 1. / 16.;
+
+    fn on_dup_ack_received(&mut self, send_unacked: SeqNumber, send_next: SeqNumber, ack_seq_no: SeqNumber) {
+        self.duplicate_ack_count += 1;
+        if self.duplicate_ack_count < Self::DUP_ACK_THRESHOLD {
+            self.limited_transmit_cwnd_increase.modify(|ltci| ltci + self.mss);
+        }
+
+        let ack_covers_recover: bool = ack_seq_no - SeqNumber::from(1) > self.recover;
+        if self.duplicate_ack_count == Self::DUP_ACK_THRESHOLD && !self.in_fast_recovery && ack_covers_recover {
+            let bytes_outstanding: u32 = (send_next - send_unacked).into();
+            self.ssthresh = max(bytes_outstanding / 2, 2 * self.mss);
+            self.cwnd.set(self.ssthresh + Self::DUP_ACK_THRESHOLD * self.mss);
+            self.recover = send_next;
+            self.in_fast_recovery = true;
+            self.fast_retransmit_now.set(true);
+        } else if self.in_fast_recovery {
+            self.cwnd.modify(|c| c + self.mss);
+        }
+    }
+
+    fn on_ack_received_fast_recovery(&mut self, send_unacked: SeqNumber, send_next: SeqNumber, ack_seq_no: SeqNumber) {
+        let bytes_acknowledged: u32 = (ack_seq_no - send_unacked).into();
+        let mss: u32 = self.mss;
+
+        if ack_seq_no > self.recover {
+            // Full acknowledgement.
+            let bytes_outstanding: u32 = (send_next - ack_seq_no).into();
+            self.cwnd.set(min(self.ssthresh, max(bytes_outstanding, mss) + mss));
+            self.in_fast_recovery = false;
+        } else {
+            // Partial acknowledgement: the next hole is lost as well.
+            self.fast_retransmit_now.set(true);
+            let deflated_cwnd: u32 = self.cwnd.get().saturating_sub(bytes_acknowledged);
+            if bytes_acknowledged >= mss {
+                self.cwnd.set(deflated_cwnd + mss);
+            } else {
+                self.cwnd.set(deflated_cwnd);
+            }
+        }
+    }
+
+    fn on_ack_received_ss_ca(&mut self, bytes_acknowledged: u32) {
+        let mss: u32 = self.mss;
+        let cwnd: u32 = self.cwnd.get();
+
+        if cwnd < self.ssthresh {
+            // Slow start.
+            self.cwnd.set(cwnd + min(bytes_acknowledged, mss));
+        } else {
+            // Congestion avoidance: grow by about one MSS per window of data.
+            let cwnd_inc: u64 = (mss as u64 * bytes_acknowledged as u64) / cwnd as u64;
+            self.cwnd.set(cwnd + max(cwnd_inc as u32, 1));
+        }
+    }
+
+    /// Accounts for the bytes that an ACK acknowledges and updates alpha at the end of each observation window (RFC
+    /// 8257, section 3.3).
+    fn update_alpha(&mut self, send_next: SeqNumber, ack_seq_no: SeqNumber, bytes_acknowledged: u32) {
+        self.bytes_acked = self.bytes_acked.saturating_add(bytes_acknowledged);
+        if self.ece {
+            self.bytes_marked = self.bytes_marked.saturating_add(bytes_acknowledged);
+        }
+
+        if ack_seq_no > self.window_end {
+            let fraction: f64 = match self.bytes_acked {
+                0 => 0.,
+                bytes_acked => self.bytes_marked as f64 / bytes_acked as f64,
+            };
+            self.alpha = (1. - self.g) * self.alpha + self.g * fraction;
+            self.bytes_acked = 0;
+            self.bytes_marked = 0;
+            self.window_end = send_next;
+            self.reduced_in_window = false;
+        }
+    }
+
+    /// Cuts cwnd in proportion to the fraction of marked bytes, once per window (RFC 8257, section 3.3).
+    fn on_congestion_experienced(&mut self) {
+        if self.reduced_in_window || self.in_fast_recovery {
+            return;
+        }
+        let cwnd: u32 = self.cwnd.get();
+        let reduced_cwnd: u32 = max((cwnd as f64 * (1. - self.alpha / 2.)) as u32, 2 * self.mss);
+        self.ssthresh = reduced_cwnd;
+        self.cwnd.set(reduced_cwnd);
+        self.reduced_in_window = true;
+        self.cwr_pending = true;
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl CongestionControl for Dctcp {
+    fn new(mss: usize, seq_no: SeqNumber, options: Option<Options>) -> Box<dyn CongestionControl> {
+        let mss: u32 = mss.try_into().unwrap();
+        // The initial value of cwnd is set according to RFC5681, section 3.1, page 7.
+        let initial_cwnd: u32 = match mss {
+            0..=1095 => 4 * mss,
+            1096..=2190 => 3 * mss,
+            _ => 2 * mss,
+        };
+
+        let options: Options = options.unwrap_or_default();
+        let g: f64 = options.get_float("g").unwrap_or(Self::DEFAULT_G);
+        // RFC 8257 recommends to start with alpha at 1, which reacts to the first marks as standard TCP would.
+        let alpha: f64 = options.get_float("initial_alpha").unwrap_or(1.);
+
+        Box::new(Self {
+            mss,
+            cwnd: SharedAsyncValue::new(initial_cwnd),
+            ssthresh: u32::MAX, // According to RFC5681 ssthresh should be initialised 'arbitrarily high'.
+
+            alpha,
+            g,
+            ece: false,
+            window_end: seq_no,
+            bytes_acked: 0,
+            bytes_marked: 0,
+            reduced_in_window: false,
+            cwr_pending: false,
+
+            duplicate_ack_count: 0,
+            fast_retransmit_now: SharedAsyncValue::new(false),
+            in_fast_recovery: false,
+            recover: seq_no, // Recover set to initial send sequence number according to RFC6582.
+
+            limited_transmit_cwnd_increase: SharedAsyncValue::new(0),
+        })
+    }
+}
+
+impl SlowStartCongestionAvoidance for Dctcp {
+    fn get_cwnd(&self) -> SharedAsyncValue<u32> {
+        self.cwnd.clone()
+    }
+
+    fn on_send(&mut self, _rto: Duration, num_bytes_sent: u32) {
+        let new_value: u32 = self.limited_transmit_cwnd_increase.get().saturating_sub(num_bytes_sent);
+        self.limited_transmit_cwnd_increase.set_without_notify(new_value);
+    }
+
+    fn on_ack_received(
+        &mut self,
+        _rto: Duration,
+        send_unacked: SeqNumber,
+        send_next: SeqNumber,
+        ack_seq_no: SeqNumber,
+    ) {
+        let bytes_acknowledged: u32 = (ack_seq_no - send_unacked).into();
+        self.update_alpha(send_next, ack_seq_no, bytes_acknowledged);
+
+        if bytes_acknowledged == 0 {
+            // ACK is a duplicate
+            self.on_dup_ack_received(send_unacked, send_next, ack_seq_no);
+        } else {
+            self.duplicate_ack_count = 0;
+            if self.in_fast_recovery {
+                // Fast Recovery response to new data.
+                self.on_ack_received_fast_recovery(send_unacked, send_next, ack_seq_no);
+            } else {
+                self.on_ack_received_ss_ca(bytes_acknowledged);
+            }
+        }
+
+        if self.ece {
+            self.on_congestion_experienced();
+        }
+    }
+
+    fn on_rto(&mut self, send_unacked: SeqNumber) {
+        self.ssthresh = max(self.cwnd.get() / 2, 2 * self.mss);
+        self.cwnd.set(self.mss);
+        // Exit fast recovery/retransmit
+        self.recover = send_unacked;
+        self.in_fast_recovery = false;
+    }
+}
+
+impl FastRetransmitRecovery for Dctcp {
+    fn get_duplicate_ack_count(&self) -> u32 {
+        self.duplicate_ack_count
+    }
+
+    fn get_retransmit_now_flag(&self) -> SharedAsyncValue<bool> {
+        self.fast_retransmit_now.clone()
+    }
+
+    fn on_fast_retransmit(&mut self) {
+        self.fast_retransmit_now.set_without_notify(false);
+    }
+}
+
+impl LimitedTransmit for Dctcp {
+    fn get_limited_transmit_cwnd_increase(&self) -> SharedAsyncValue<u32> {
+        self.limited_transmit_cwnd_increase.clone()
+    }
+}
+
+impl ExplicitCongestionNotification for Dctcp {
+    fn on_ecn_echo(&mut self, ece: bool) {
+        self.ece = ece;
+    }
+
+    fn take_cwr(&mut self) -> bool {
+        ::std::mem::take(&mut self.cwr_pending)
+    }
+}
+
+impl Pacing for Dctcp {}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::inetstack::protocols::layer4::tcp::{
+        established::congestion_control::{CongestionControl, Dctcp},
+        SeqNumber,
+    };
+    use ::anyhow::Result;
+    use ::std::time::Duration;
+
+    const MSS: u32 = 1000;
+
+    // Bytes that remain in flight after each ACK, which sets the length of the observation windows.
+    const OUTSTANDING: u32 = 16 * MSS;
+
+    /// Acknowledges `num_segments` segments of MSS bytes, one at a time, with ACKs that echo marks or not.
+    fn ack_segments(cc: &mut Box<dyn CongestionControl>, seq_no: &mut SeqNumber, num_segments: u32, ece: bool) {
+        for _ in 0..num_segments {
+            let send_unacked: SeqNumber = *seq_no;
+            *seq_no = *seq_no + SeqNumber::from(MSS);
+            let send_next: SeqNumber = *seq_no + SeqNumber::from(OUTSTANDING);
+            cc.on_ecn_echo(ece);
+            cc.on_ack_received(Duration::from_secs(1), send_unacked, send_next, *seq_no);
+        }
+    }
+
+    /// Checks that marks cut cwnd at most once per window and in proportion to the fraction of marked bytes.
+    #[test]
+    fn test_dctcp_proportional_reduction() -> Result<()> {
+        let mut seq_no: SeqNumber = SeqNumber::from(0);
+        let mut cc: Box<dyn CongestionControl> = Dctcp::new(MSS as usize, seq_no, None);
+
+        // Without marks, alpha decays and cwnd grows in slow start.
+        ack_segments(&mut cc, &mut seq_no, 64, false);
+        let cwnd: u32 = cc.get_cwnd().get();
+        crate::ensure_eq!(cwnd > 16 * MSS, true);
+
+        // A marked ACK cuts cwnd by less than standard TCP would, and the next one in the same window does not cut it.
+        crate::ensure_eq!(cc.take_cwr(), false);
+        ack_segments(&mut cc, &mut seq_no, 1, true);
+        let reduced_cwnd: u32 = cc.get_cwnd().get();
+        crate::ensure_eq!(reduced_cwnd < cwnd, true);
+        crate::ensure_eq!(reduced_cwnd > cwnd / 2, true);
+        // Only the next segment of new data that we send after the cut carries CWR.
+        crate::ensure_eq!(cc.take_cwr(), true);
+        crate::ensure_eq!(cc.take_cwr(), false);
+        ack_segments(&mut cc, &mut seq_no, 1, true);
+        crate::ensure_eq!(cc.get_cwnd().get() >= reduced_cwnd, true);
+        crate::ensure_eq!(cc.take_cwr(), false);
+        Ok(())
+    }
+
+    /// Checks that the third duplicate ACK triggers a fast retransmit.
+    #[test]
+    fn test_dctcp_fast_retransmit() -> Result<()> {
+        let mut seq_no: SeqNumber = SeqNumber::from(0);
+        let mut cc: Box<dyn CongestionControl> = Dctcp::new(MSS as usize, seq_no, None);
+        ack_segments(&mut cc, &mut seq_no, 4, false);
+
+        let send_next: SeqNumber = seq_no + SeqNumber::from(8 * MSS);
+        for _ in 0..3 {
+            cc.on_ecn_echo(false);
+            cc.on_ack_received(Duration::from_secs(1), seq_no, send_next, seq_no);
+        }
+        crate::ensure_eq!(cc.get_duplicate_ack_count(), 3);
+        crate::ensure_eq!(cc.get_retransmit_now_flag().get(), true);
+        crate::ensure_eq!(cc.get_cwnd().get(), 7 * MSS);
+        Ok(())
+    }
+}
@@ -1,19 +1,43 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+mod bbr;
 mod cubic;
+mod dctcp;
 mod none;
 mod options;
 
 use crate::{collections::async_value::SharedAsyncValue, inetstack::protocols::layer4::tcp::SeqNumber};
-use ::std::{fmt::Debug, time::Duration};
+use ::std::{
+    fmt::Debug,
+    time::{Duration, Instant},
+};
 
 pub use self::{
+    bbr::Bbr,
     cubic::Cubic,
+    dctcp::Dctcp,
     none::None,
-    options::{OptionValue, Options},
+    options::{constructor, OptionValue, Options},
 };
 
+/// A sample of the rate at which our peer receives data, taken when an ACK acknowledges a segment that was sent only
+/// once (draft-cheng-iccrg-delivery-rate-estimation).
+#[derive(Clone, Copy, Debug)]
+pub struct RateSample {
+    /// Bytes that got delivered while the segment was in flight, the segment included.
+    pub delivered: u64,
+    /// Bytes that had been delivered when the segment was sent.
+    pub prior_delivered: u64,
+    /// Time over which `delivered` bytes got delivered.
+    pub interval: Duration,
+    /// Round-trip time of the segment.
+    pub rtt: Duration,
+    /// Bytes in flight once the ACK is processed.
+    pub bytes_in_flight: u32,
+    pub now: Instant,
+}
+
 pub trait SlowStartCongestionAvoidance {
     fn get_cwnd(&self) -> SharedAsyncValue<u32>;
 
@@ -56,7 +80,42 @@ where
     fn get_limited_transmit_cwnd_increase(&self) -> SharedAsyncValue<u32>;
 }
 
-pub trait CongestionControl: SlowStartCongestionAvoidance + FastRetransmitRecovery + LimitedTransmit + Debug {
+pub trait ExplicitCongestionNotification
+where
+    Self: SlowStartCongestionAvoidance,
+{
+    // Called immediately before on_ack_received() on connections that negotiated ECN, with whether the ACK echoes a
+    // Congestion Experienced mark (ECE).
+    fn on_ecn_echo(&mut self, _ece: bool) {}
+
+    // Called when sending a segment of new data. Returns whether the segment should carry the Congestion Window Reduced
+    // flag (CWR), which tells our peer that we reacted to its echoes and that it can stop setting ECE (RFC 3168).
+    fn take_cwr(&mut self) -> bool {
+        false
+    }
+}
+
+pub trait Pacing
+where
+    Self: SlowStartCongestionAvoidance,
+{
+    // Rate in bytes per second at which segments should be sent. `None` sends segments as fast as the windows allow.
+    fn get_pacing_rate(&self) -> Option<u64> {
+        None
+    }
+
+    // Called after on_ack_received() when the ACK yields a delivery rate sample.
+    fn on_rate_sample(&mut self, _sample: &RateSample) {}
+}
+
+pub trait CongestionControl:
+    SlowStartCongestionAvoidance
+    + FastRetransmitRecovery
+    + LimitedTransmit
+    + ExplicitCongestionNotification
+    + Pacing
+    + Debug
+{
     fn new(mss: usize, seq_no: SeqNumber, options: Option<options::Options>) -> Box<dyn CongestionControl>
     where
         Self: Sized;
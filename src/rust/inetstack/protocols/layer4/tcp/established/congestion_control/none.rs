@@ -9,7 +9,8 @@ use crate::{
     collections::async_value::SharedAsyncValue,
     inetstack::protocols::layer4::tcp::{
         established::congestion_control::{
-            CongestionControl, FastRetransmitRecovery, LimitedTransmit, Options, SlowStartCongestionAvoidance,
+            CongestionControl, ExplicitCongestionNotification, FastRetransmitRecovery, LimitedTransmit, Options,
+            Pacing, SlowStartCongestionAvoidance,
         },
         SeqNumber,
     },
@@ -57,3 +58,7 @@ impl LimitedTransmit for None {
         self.limited_retransmit_cwnd_increase.clone()
     }
 }
+
+impl ExplicitCongestionNotification for None {}
+
+impl Pacing for None {}
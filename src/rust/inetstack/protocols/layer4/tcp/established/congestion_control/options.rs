@@ -1,8 +1,25 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+use crate::{
+    inetstack::protocols::layer4::tcp::established::congestion_control::{
+        self, CongestionControl, CongestionControlConstructor,
+    },
+    runtime::network::socket::option::CongestionControlAlgorithm,
+};
 use std::collections::HashMap;
 
+/// Returns the constructor of a congestion control algorithm.
+pub fn constructor(algorithm: CongestionControlAlgorithm) -> CongestionControlConstructor {
+    match algorithm {
+        CongestionControlAlgorithm::None => congestion_control::None::new,
+        CongestionControlAlgorithm::Cubic => congestion_control::Cubic::new,
+        CongestionControlAlgorithm::Dctcp => congestion_control::Dctcp::new,
+        CongestionControlAlgorithm::Bbr => congestion_control::Bbr::new,
+        CongestionControlAlgorithm::Kernel(_) => unreachable!("TCP sockets reject algorithms that we do not implement"),
+    }
+}
+
 #[derive(Clone, Debug)]
 pub enum OptionValue {
     Bool(bool),
@@ -9,7 +9,8 @@ use crate::{
     async_timer,
     collections::{async_queue::SharedAsyncQueue, async_value::SharedAsyncValue},
     inetstack::protocols::{
-        layer3::SharedLayer3Endpoint,
+        checksum,
+        layer3::{SharedLayer3Endpoint, IPV4_ECN_ECT0, IPV4_ECN_NOT_ECT},
         layer4::tcp::{
             constants::MSL,
             established::{
@@ -17,7 +18,7 @@ use crate::{
                 receiver::Receiver,
                 sender::Sender,
             },
-            header::TcpHeader,
+            header::{SelectiveAcknowlegement, TcpHeader, TcpOptions2, MAX_SACK_BLOCKS, MIN_TCP_HEADER_SIZE},
             SeqNumber,
         },
         MAX_HEADER_SIZE,
@@ -98,6 +99,16 @@ pub struct ControlBlock {
     // Receive-side state information.  TODO: Consider incorporating this directly into ControlBlock.
     receiver: Receiver,
 
+    // Whether we may report the out-of-order data that we hold to our peer in SACK options (RFC 2018).
+    sack_permitted: bool,
+
+    // Whether both ends agreed to use ECN (RFC 3168), in which case our data segments are ECN-capable and our ACKs
+    // echo the Congestion Experienced marks that we receive.
+    ecn_capable: bool,
+
+    // Whether the last data segment that we received was marked Congestion Experienced.
+    ecn_ce_state: bool,
+
     // Congestion control trait implementation we're currently using.
     // TODO: Consider switching this to a static implementation to avoid V-table call overhead.
     congestion_control_algorithm: Box<dyn congestion_control::CongestionControl>,
@@ -125,6 +136,10 @@ impl SharedControlBlock {
         send_window_size_frames: u32,
         send_window_scale_shift_bits: u8,
         sender_mss: usize,
+        // Whether both ends agreed to use SACKs (RFC 2018) during the handshake.
+        sack_permitted: bool,
+        // Whether both ends agreed to use ECN (RFC 3168) during the handshake.
+        ecn_capable: bool,
         congestion_control_algorithm_constructor: CongestionControlConstructor,
         congestion_control_options: Option<congestion_control::Options>,
         mut recv_queue: SharedAsyncQueue<(Ipv4Addr, TcpHeader, DemiBuffer)>,
@@ -134,6 +149,7 @@ impl SharedControlBlock {
             send_window_size_frames,
             send_window_scale_shift_bits,
             sender_mss,
+            tcp_config.get_tcp_segmentation_offload(),
         );
         let receiver: Receiver = Receiver::new(
             receive_initial_seq_no,
@@ -141,6 +157,7 @@ impl SharedControlBlock {
             receive_ack_delay_timeout_secs,
             receive_window_size_frames,
             receive_window_scale_shift_bits,
+            tcp_config.get_zero_copy_pop(),
         );
         let congestion_control_algorithm =
             congestion_control_algorithm_constructor(sender_mss, sender_initial_seq_no, congestion_control_options);
@@ -154,6 +171,9 @@ impl SharedControlBlock {
             sender,
             state: State::Established,
             receiver,
+            sack_permitted,
+            ecn_capable,
+            ecn_ce_state: false,
             congestion_control_algorithm,
         }));
         trace!("receive_queue size {:?}", recv_queue.len());
@@ -177,6 +197,16 @@ impl SharedControlBlock {
         self.runtime.get_now()
     }
 
+    /// Returns the one's complement sum of `payload` that [ControlBlock::emit_with_payload_sum] expects, or `None` if
+    /// the NIC computes TCP checksums for us.
+    pub fn payload_sum(&self, payload: &DemiBuffer) -> Option<u16> {
+        if self.tcp_config.get_tx_checksum_offload() {
+            None
+        } else {
+            Some(checksum::ones_complement_sum(&payload[..]))
+        }
+    }
+
     pub fn receive(&mut self, tcp_hdr: TcpHeader, buf: DemiBuffer) {
         debug!(
             "{:?} Connection Receiving {} bytes + {:?}",
@@ -218,6 +248,27 @@ impl SharedControlBlock {
         self.congestion_control_algorithm.get_limited_transmit_cwnd_increase()
     }
 
+    pub fn congestion_control_get_pacing_rate(&self) -> Option<u64> {
+        self.congestion_control_algorithm.get_pacing_rate()
+    }
+
+    pub fn congestion_control_take_cwr(&mut self) -> bool {
+        self.ecn_capable && self.congestion_control_algorithm.take_cwr()
+    }
+
+    /// Tracks the Congestion Experienced marks of the data segments that we receive, which our ACKs echo in the ECE
+    /// flag. If the marking changes while we owe our peer an ACK, that ACK goes out right away and still reports the
+    /// previous marking, so our peer learns how many bytes were marked (RFC 8257, section 3.2).
+    pub fn ecn_on_data_received(&mut self, congestion_experienced: bool, ack_pending: bool) {
+        if !self.ecn_capable || congestion_experienced == self.ecn_ce_state {
+            return;
+        }
+        if ack_pending {
+            self.send_ack();
+        }
+        self.ecn_ce_state = congestion_experienced;
+    }
+
     pub fn process_ack(&mut self, header: &TcpHeader, now: Instant) -> Result<(), Fail> {
         let send_unacknowledged: SeqNumber = self.sender.get_unacked_seq_no();
         let send_next: SeqNumber = self.sender.get_next_seq_no();
@@ -227,6 +278,9 @@ impl SharedControlBlock {
         // We should either make separate calls for each case or integrate those cases directly.
         let rto: Duration = self.sender.get_rto();
 
+        if self.ecn_capable {
+            self.congestion_control_algorithm.on_ecn_echo(header.ece);
+        }
         self.congestion_control_algorithm
             .on_ack_received(rto, send_unacknowledged, send_next, header.ack_num);
 
@@ -234,7 +288,9 @@ impl SharedControlBlock {
         if header.ack_num <= send_next {
             // Does not matter when we get this since the clock will not move between the beginning of packet
             // processing and now without a call to advance_clock.
-            self.sender.process_ack(header, now);
+            if let Some(sample) = self.sender.process_ack(header, now) {
+                self.congestion_control_algorithm.on_rate_sample(&sample);
+            }
         } else {
             // This segment acknowledges data we have yet to send!?  Send an ACK and drop the segment.
             // TODO: See RFC 5961, this could be a Blind Data Injection Attack.
@@ -259,6 +315,7 @@ impl SharedControlBlock {
         // Note that once we reach a synchronized state we always include a valid acknowledgement number.
         header.ack = true;
         header.ack_num = self.receiver.receive_next_seq_no();
+        header.ece = self.ecn_capable && self.ecn_ce_state;
 
         // Return this header.
         header
@@ -275,8 +332,37 @@ impl SharedControlBlock {
         self.emit(header, None);
     }
 
+    /// Tells our peer about the out-of-order data that we hold, so that it only retransmits what is missing. The MSS
+    /// leaves no room for options, so a segment only carries as many SACK blocks as `payload_len` leaves room for, and
+    /// segments that the NIC cuts into MSS-sized packets carry none.
+    fn push_sack_option(&self, header: &mut TcpHeader, payload_len: usize) {
+        if !self.sack_permitted {
+            return;
+        }
+        let mut sacks: [SelectiveAcknowlegement; MAX_SACK_BLOCKS] = [SelectiveAcknowlegement {
+            begin: SeqNumber::from(0),
+            end: SeqNumber::from(0),
+        }; MAX_SACK_BLOCKS];
+        let num_available: usize = self.receiver.sack_blocks(&mut sacks);
+        let room: usize = self
+            .sender
+            .get_mss()
+            .saturating_sub(payload_len + header.compute_size() - MIN_TCP_HEADER_SIZE);
+        // The option is followed by an "End of options list" byte and padded to a multiple of 4 bytes.
+        let fits = |num_sacks: &usize| -> bool { (2 + 8 * *num_sacks + 1 + 3) & !0x3 <= room };
+        if let Some(num_sacks) = (1..=num_available).rev().find(fits) {
+            header.push_option(TcpOptions2::SelectiveAcknowlegement { num_sacks, sacks });
+        }
+    }
+
     /// Transmit this message to our connected peer.
     pub fn emit(&mut self, header: TcpHeader, body: Option<DemiBuffer>) {
+        self.emit_with_payload_sum(header, body, None)
+    }
+
+    /// Transmit this message to our connected peer, reusing the one's complement sum of `body` that was computed by
+    /// [ControlBlock::payload_sum] when it was first sent. If `payload_sum` is `None`, it is computed here if needed.
+    pub fn emit_with_payload_sum(&mut self, mut header: TcpHeader, body: Option<DemiBuffer>, payload_sum: Option<u16>) {
         // Only perform this debug print in debug builds.  debug_assertions is compiler set in non-optimized builds.
         let mut pkt = match body {
             Some(body) => {
@@ -291,19 +377,37 @@ impl SharedControlBlock {
 
         // This routine should only ever be called to send TCP segments that contain a valid ACK value.
         debug_assert!(header.ack);
+        self.push_sack_option(&mut header, pkt.len());
+
+        // Ask the NIC to cut segments that do not fit in a single packet. We always set this, since buffers that were
+        // received from the NIC may carry a stale value.
+        let mss: usize = self.sender.get_mss();
+        let tso_segment_size: u16 = if self.tcp_config.get_tcp_segmentation_offload() && pkt.len() > mss {
+            mss as u16
+        } else {
+            0
+        };
+        pkt.set_tso_segment_size(tso_segment_size);
+
+        // Only segments that carry data are ECN-capable, as nothing reacts to marks on pure ACKs (RFC 3168).
+        let ecn: u8 = if self.ecn_capable && pkt.len() > 0 {
+            IPV4_ECN_ECT0
+        } else {
+            IPV4_ECN_NOT_ECT
+        };
+
+        let payload_sum: Option<u16> = match payload_sum {
+            Some(payload_sum) if !self.tcp_config.get_tx_checksum_offload() => Some(payload_sum),
+            _ => self.payload_sum(&pkt),
+        };
 
         let remote_ipv4_addr: Ipv4Addr = self.remote.ip().clone();
-        header.serialize_and_attach(
-            &mut pkt,
-            self.local.ip(),
-            self.remote.ip(),
-            self.tcp_config.get_tx_checksum_offload(),
-        );
+        header.serialize_and_attach_with_payload_sum(&mut pkt, self.local.ip(), self.remote.ip(), payload_sum);
 
         // Call lower L3 layer to send the segment.
         if let Err(e) = self
             .layer3_endpoint
-            .transmit_tcp_packet_nonblocking(remote_ipv4_addr, pkt)
+            .transmit_tcp_packet_nonblocking(remote_ipv4_addr, ecn, pkt)
         {
             warn!("could not emit packet: {:?}", e);
             return;
@@ -3,6 +3,7 @@
 
 pub mod congestion_control;
 pub mod ctrlblk;
+mod reassembly;
 mod receiver;
 mod rto;
 mod sender;
@@ -59,6 +60,8 @@ impl EstablishedSocket {
         sender_window_size: u32,
         sender_window_scale: u8,
         sender_mss: usize,
+        sack_permitted: bool,
+        ecn_capable: bool,
         cc_constructor: CongestionControlConstructor,
         congestion_control_options: Option<congestion_control::Options>,
     ) -> Result<Self, Fail> {
@@ -78,6 +81,8 @@ impl EstablishedSocket {
             sender_window_size,
             sender_window_scale,
             sender_mss,
+            sack_permitted,
+            ecn_capable,
             cc_constructor,
             congestion_control_options,
             recv_queue.clone(),
@@ -0,0 +1,297 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    expect_ok,
+    inetstack::protocols::layer4::tcp::{
+        header::{SelectiveAcknowlegement, MAX_SACK_BLOCKS},
+        SeqNumber,
+    },
+    runtime::memory::DemiBuffer,
+};
+use ::std::collections::VecDeque;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Out-of-order segments that a receiver holds on to until the holes before them are filled.
+///
+/// Segments are kept in a ring, sorted by sequence number and without overlaps, so the place of a new segment is found
+/// with a binary search. Every stored segment lies ahead of RCV.NXT and within the receive window, so the distance from
+/// RCV.NXT orders them even when sequence numbers wrap around.
+pub struct ReassemblyQueue {
+    segments: VecDeque<(SeqNumber, DemiBuffer)>,
+    /// Maximum number of segments held. Segments at the end of the window are dropped first. The ring only grows as
+    /// segments arrive out of order, so connections that never see a hole take no memory for it.
+    capacity: usize,
+    /// Start of the segment that arrived last, which the first SACK block must cover (RFC 2018).
+    last_arrival: Option<SeqNumber>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl ReassemblyQueue {
+    pub fn new(capacity: usize) -> Self {
+        Self {
+            segments: VecDeque::new(),
+            capacity,
+            last_arrival: None,
+        }
+    }
+
+    #[cfg(test)]
+    pub fn len(&self) -> usize {
+        self.segments.len()
+    }
+
+    /// Stores a segment that starts at `start`, after RCV.NXT (`receive_next`). Data that is already held is trimmed
+    /// off the new segment, and held segments that the new one covers are replaced by it.
+    pub fn insert(&mut self, receive_next: SeqNumber, mut start: SeqNumber, mut buf: DemiBuffer) {
+        debug_assert!(start > receive_next);
+        debug_assert_ne!(buf.len(), 0);
+        let offset = |seq_no: SeqNumber| -> u32 { u32::from(seq_no - receive_next) };
+        let mut end: u32 = offset(start) + buf.len() as u32;
+
+        // The first held segment that ends after the start of the new one is the only one that may overlap its front.
+        let mut index: usize = self
+            .segments
+            .partition_point(|(seq_no, data)| offset(*seq_no) + data.len() as u32 <= offset(start));
+        if let Some((held_start, held)) = self.segments.get(index) {
+            let held_end: u32 = offset(*held_start) + held.len() as u32;
+            if offset(*held_start) <= offset(start) {
+                if end <= held_end {
+                    // We already hold all of this data.
+                    self.last_arrival = Some(*held_start);
+                    return;
+                }
+                let duplicate: u32 = held_end - offset(start);
+                start = start + SeqNumber::from(duplicate);
+                expect_ok!(
+                    buf.adjust(duplicate as usize),
+                    "'buf' should contain at least 'duplicate' bytes"
+                );
+                index += 1;
+            }
+        }
+
+        // Held segments that end within the new one are covered by it.
+        let covered: usize = self
+            .segments
+            .range(index..)
+            .take_while(|(seq_no, data)| offset(*seq_no) + data.len() as u32 <= end)
+            .count();
+        self.segments.drain(index..index + covered);
+
+        // The next held segment may overlap the back of the new one.
+        if let Some((held_start, _)) = self.segments.get(index) {
+            if offset(*held_start) < end {
+                let excess: u32 = end - offset(*held_start);
+                end -= excess;
+                expect_ok!(
+                    buf.trim(excess as usize),
+                    "'buf' should contain at least 'excess' bytes"
+                );
+            }
+        }
+        debug_assert_eq!(end - offset(start), buf.len() as u32);
+
+        self.segments.insert(index, (start, buf));
+        self.last_arrival = Some(start);
+
+        // Drop the segments at the end of the window if we hold too many. The receive window bounds how many bytes we
+        // hold, while this bounds how many entries a peer can make us keep by sending tiny segments.
+        self.segments.truncate(self.capacity);
+    }
+
+    /// Takes the held segment that starts at RCV.NXT (`receive_next`), if there is one.
+    pub fn pop_in_order(&mut self, receive_next: SeqNumber) -> Option<DemiBuffer> {
+        match self.segments.front() {
+            Some((start, _)) if *start == receive_next => self.segments.pop_front().map(|(_, buf)| buf),
+            _ => None,
+        }
+    }
+
+    /// Writes the SACK blocks that describe the held data to `blocks` and returns how many there are. Adjacent
+    /// segments are merged into a single block. The first block covers the segment that arrived last and the others
+    /// follow in sequence order (RFC 2018).
+    pub fn sack_blocks(
+        &self,
+        receive_next: SeqNumber,
+        blocks: &mut [SelectiveAcknowlegement; MAX_SACK_BLOCKS],
+    ) -> usize {
+        if self.segments.is_empty() {
+            return 0;
+        }
+
+        let mut num_blocks: usize = 0;
+        let latest: Option<SelectiveAcknowlegement> = self
+            .last_arrival
+            .and_then(|seq_no| self.block_around(receive_next, seq_no));
+        if let Some(latest) = latest {
+            blocks[0] = latest;
+            num_blocks = 1;
+        }
+
+        let mut current: Option<SelectiveAcknowlegement> = None;
+        for (start, data) in self.segments.iter() {
+            let end: SeqNumber = *start + SeqNumber::from(data.len() as u32);
+            current = match current {
+                Some(block) if block.end == *start => Some(SelectiveAcknowlegement {
+                    begin: block.begin,
+                    end,
+                }),
+                Some(block) => {
+                    if Some(block) != latest {
+                        blocks[num_blocks] = block;
+                        num_blocks += 1;
+                        if num_blocks == MAX_SACK_BLOCKS {
+                            return num_blocks;
+                        }
+                    }
+                    Some(SelectiveAcknowlegement { begin: *start, end })
+                },
+                None => Some(SelectiveAcknowlegement { begin: *start, end }),
+            };
+        }
+        if let Some(block) = current {
+            if Some(block) != latest {
+                blocks[num_blocks] = block;
+                num_blocks += 1;
+            }
+        }
+        num_blocks
+    }
+
+    /// Returns the block of contiguous held data that contains the segment that starts at `seq_no`.
+    fn block_around(&self, receive_next: SeqNumber, seq_no: SeqNumber) -> Option<SelectiveAcknowlegement> {
+        let offset = |seq_no: SeqNumber| -> u32 { u32::from(seq_no - receive_next) };
+        let index: usize = self
+            .segments
+            .partition_point(|(start, _)| offset(*start) < offset(seq_no));
+        match self.segments.get(index) {
+            Some((start, _)) if *start == seq_no => (),
+            _ => return None,
+        }
+        let mut begin: SeqNumber = seq_no;
+        for (start, data) in self.segments.range(..index).rev() {
+            if *start + SeqNumber::from(data.len() as u32) != begin {
+                break;
+            }
+            begin = *start;
+        }
+        let mut end: SeqNumber = seq_no;
+        for (start, data) in self.segments.range(index..) {
+            if *start != end {
+                break;
+            }
+            end = *start + SeqNumber::from(data.len() as u32);
+        }
+        Some(SelectiveAcknowlegement { begin, end })
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::{
+        inetstack::protocols::layer4::tcp::{
+            established::reassembly::ReassemblyQueue,
+            header::{SelectiveAcknowlegement, MAX_SACK_BLOCKS},
+            SeqNumber,
+        },
+        runtime::memory::DemiBuffer,
+    };
+    use ::anyhow::Result;
+
+    fn segment(start: u32, len: usize) -> Result<DemiBuffer> {
+        let data: Vec<u8> = (0..len).map(|i| (start as usize + i) as u8).collect();
+        Ok(DemiBuffer::from_slice(&data)?)
+    }
+
+    fn block(begin: u32, end: u32) -> SelectiveAcknowlegement {
+        SelectiveAcknowlegement {
+            begin: SeqNumber::from(begin),
+            end: SeqNumber::from(end),
+        }
+    }
+
+    /// Checks that overlapping segments are trimmed, covered segments are replaced and the data comes out in order.
+    #[test]
+    fn test_reassembly_overlaps() -> Result<()> {
+        let receive_next: SeqNumber = SeqNumber::from(u32::MAX - 50);
+        let mut queue: ReassemblyQueue = ReassemblyQueue::new(16);
+        let at = |offset: u32| -> SeqNumber { receive_next + SeqNumber::from(offset) };
+
+        queue.insert(receive_next, at(100), segment(100, 100)?);
+        queue.insert(receive_next, at(300), segment(300, 100)?);
+        // Overlaps the back of the first segment and the front of the second one.
+        queue.insert(receive_next, at(150), segment(150, 200)?);
+        // Duplicate.
+        queue.insert(receive_next, at(120), segment(120, 50)?);
+        crate::ensure_eq!(queue.len(), 3);
+        // Covers everything held so far.
+        queue.insert(receive_next, at(10), segment(10, 500)?);
+        crate::ensure_eq!(queue.len(), 1);
+
+        crate::ensure_eq!(queue.pop_in_order(receive_next).is_none(), true);
+        queue.insert(receive_next, at(1), segment(1, 20)?);
+
+        let mut receive_next: SeqNumber = at(1);
+        let mut data: Vec<u8> = Vec::new();
+        while let Some(buf) = queue.pop_in_order(receive_next) {
+            receive_next = receive_next + SeqNumber::from(buf.len() as u32);
+            data.extend_from_slice(&buf[..]);
+        }
+        crate::ensure_eq!(queue.len(), 0);
+        crate::ensure_eq!(data.len(), 509);
+        let expected: Vec<u8> = (0..509).map(|i| (1 + i) as u8).collect();
+        crate::ensure_eq!(data, expected);
+        Ok(())
+    }
+
+    /// Checks that SACK blocks merge adjacent segments and report the latest arrival first.
+    #[test]
+    fn test_reassembly_sack_blocks() -> Result<()> {
+        let receive_next: SeqNumber = SeqNumber::from(0);
+        let mut queue: ReassemblyQueue = ReassemblyQueue::new(16);
+        let mut blocks: [SelectiveAcknowlegement; MAX_SACK_BLOCKS] = [block(0, 0); MAX_SACK_BLOCKS];
+        crate::ensure_eq!(queue.sack_blocks(receive_next, &mut blocks), 0);
+
+        for start in [1000, 3000, 5000, 7000, 9000] {
+            queue.insert(receive_next, SeqNumber::from(start), segment(start, 1000)?);
+        }
+        queue.insert(receive_next, SeqNumber::from(4000), segment(4000, 1000)?);
+        crate::ensure_eq!(queue.sack_blocks(receive_next, &mut blocks), 4);
+        crate::ensure_eq!(blocks[0], block(3000, 6000));
+        crate::ensure_eq!(blocks[1], block(1000, 2000));
+        crate::ensure_eq!(blocks[2], block(7000, 8000));
+        crate::ensure_eq!(blocks[3], block(9000, 10000));
+        Ok(())
+    }
+
+    /// Checks that the segments at the end of the window are dropped once the queue is full.
+    #[test]
+    fn test_reassembly_capacity() -> Result<()> {
+        let receive_next: SeqNumber = SeqNumber::from(0);
+        let mut queue: ReassemblyQueue = ReassemblyQueue::new(2);
+        for start in [5000, 3000, 1000] {
+            queue.insert(receive_next, SeqNumber::from(start), segment(start, 100)?);
+        }
+        crate::ensure_eq!(queue.len(), 2);
+        let mut blocks: [SelectiveAcknowlegement; MAX_SACK_BLOCKS] = [block(0, 0); MAX_SACK_BLOCKS];
+        crate::ensure_eq!(queue.sack_blocks(receive_next, &mut blocks), 2);
+        crate::ensure_eq!(blocks[0], block(1000, 1100));
+        crate::ensure_eq!(blocks[1], block(3000, 3100));
+        Ok(())
+    }
+}
@@ -5,18 +5,18 @@
 // Imports
 //======================================================================================================================
 
-use ::std::{
-    collections::VecDeque,
-    time::{Duration, Instant},
-};
+use ::std::time::{Duration, Instant};
 
 use crate::{
     collections::{async_queue::AsyncQueue, async_value::SharedAsyncValue},
-    expect_ok,
+    expect_ok, expect_some,
     inetstack::protocols::layer4::tcp::{
-        established::ctrlblk::State, established::SharedControlBlock, header::TcpHeader, SeqNumber,
+        established::{ctrlblk::State, reassembly::ReassemblyQueue, SharedControlBlock},
+        header::{SelectiveAcknowlegement, TcpHeader, MAX_SACK_BLOCKS},
+        SeqNumber,
     },
-    runtime::{fail::Fail, memory::DemiBuffer},
+    perftools::stats::{self, Counter},
+    runtime::{fail::Fail, memory::DemiBuffer, types::DEMI_SGARRAY_MAXLEN},
 };
 
 use ::futures::never::Never;
@@ -25,10 +25,9 @@ use ::futures::never::Never;
 // Constants
 //======================================================================================================================
 
-// TODO: Review this value (and its purpose).  It (16 segments) seems awfully small (would make fast retransmit less
-// useful), and this mechanism isn't the best way to protect ourselves against deliberate out-of-order segment attacks.
-// Ideally, we'd limit out-of-order data to that which (along with the unread data) will fit in the receive window.
-const MAX_OUT_OF_ORDER_SIZE_FRAMES: usize = 16;
+// Maximum number of out-of-order segments that we hold on to. Out-of-order data is already limited by the receive
+// window, so this only protects us against deliberate floods of tiny out-of-order segments.
+const MAX_OUT_OF_ORDER_SIZE_FRAMES: usize = 1024;
 
 //======================================================================================================================
 // Data Structures
@@ -80,7 +79,11 @@ pub struct Receiver {
     // receive window) but can't yet present to the user because we're missing some other data that comes between this
     // and what we've already presented to the user.
     //
-    out_of_order_frames: VecDeque<(SeqNumber, DemiBuffer)>,
+    out_of_order_frames: ReassemblyQueue,
+
+    // Whether a pop hands out all of the in-order buffers that fit in a single scatter-gather array (chained together)
+    // rather than a single buffer.
+    zero_copy_pop: bool,
 }
 
 //======================================================================================================================
@@ -94,37 +97,41 @@ impl Receiver {
         ack_delay_timeout_secs: Duration,
         window_size_frames: u32,
         window_scale_shift_bits: u8,
+        zero_copy_pop: bool,
     ) -> Self {
         Self {
             reader_next_seq_no,
             receive_next_seq_no,
             fin_seq_no: SharedAsyncValue::new(None),
-            pop_queue: AsyncQueue::with_capacity(1024),
+            pop_queue: AsyncQueue::with_lazy_capacity(1024),
             ack_delay_timeout_secs,
             ack_deadline_time_secs: SharedAsyncValue::new(None),
             buffer_size_frames: window_size_frames,
             window_scale_shift_bits,
-            out_of_order_frames: VecDeque::with_capacity(64),
+            out_of_order_frames: ReassemblyQueue::new(MAX_OUT_OF_ORDER_SIZE_FRAMES),
+            zero_copy_pop,
         }
     }
 
     pub async fn pop(&mut self, size: Option<usize>) -> Result<DemiBuffer, Fail> {
         debug!("waiting on pop {:?}", size);
-        let buf: DemiBuffer = if let Some(size) = size {
-            let mut buf: DemiBuffer = self.pop_queue.pop(None).await?;
-            // Split the buffer if it's too big.
-            if buf.len() > size {
-                buf.split_front(size)?
-            } else {
-                buf
+        let mut buf: DemiBuffer = self.pop_queue.pop(None).await?;
+        if self.zero_copy_pop {
+            self.gather(&mut buf, size);
+        }
+
+        // Split the buffer if it's too big, and leave the rest for the next pop. The split does not copy any data.
+        if let Some(size) = size {
+            if buf.total_len() > size {
+                let front: DemiBuffer = buf.split_chain_front(size)?;
+                self.pop_queue.push_front(buf);
+                buf = front;
             }
-        } else {
-            self.pop_queue.pop(None).await?
-        };
+        }
 
-        match buf.len() {
+        match buf.total_len() {
             len if len > 0 => {
-                self.reader_next_seq_no = self.reader_next_seq_no + SeqNumber::from(buf.len() as u32);
+                self.reader_next_seq_no = self.reader_next_seq_no + SeqNumber::from(len as u32);
             },
             _ => {
                 debug!("found FIN");
@@ -135,6 +142,33 @@ impl Receiver {
         Ok(buf)
     }
 
+    /// Chains the in-order buffers that follow `buf` in the pop queue to it, until it holds at least `size` bytes or
+    /// as many segments as fit in a scatter-gather array. This stops at the FIN, which is left for the next pop.
+    fn gather(&mut self, buf: &mut DemiBuffer, size: Option<usize>) {
+        let size: usize = size.unwrap_or(usize::MAX);
+        let mut len: usize = buf.total_len();
+        let mut numsegs: usize = buf.num_segments();
+        if len == 0 {
+            return;
+        }
+
+        while len < size {
+            match self.pop_queue.get_front() {
+                Some(next)
+                    if next.len() > 0
+                        && next.is_heap_allocated() == buf.is_heap_allocated()
+                        && numsegs + next.num_segments() <= DEMI_SGARRAY_MAXLEN =>
+                {
+                    len += next.total_len();
+                    numsegs += next.num_segments();
+                },
+                _ => break,
+            }
+            let next: DemiBuffer = expect_some!(self.pop_queue.try_pop(), "pop queue should not be empty");
+            expect_ok!(buf.chain(next), "should be able to chain the buffers");
+        }
+    }
+
     pub fn receive(&mut self, tcp_hdr: TcpHeader, buf: DemiBuffer, cb: SharedControlBlock, now: Instant) {
         match self.process_packet(tcp_hdr, buf, cb, now) {
             Ok(()) => (),
@@ -198,7 +232,9 @@ impl Receiver {
         }
 
         if data.len() > 0 {
-            self.process_data(data, seg_start, seg_end, seg_len, &mut cb)?;
+            let ack_pending: bool = self.ack_deadline_time_secs.get().is_some();
+            cb.ecn_on_data_received(header.congestion_experienced, ack_pending);
+            self.process_data(data, seg_start, seg_len, &mut cb)?;
         }
 
         // Process FIN flag.
@@ -434,7 +470,6 @@ impl Receiver {
         &mut self,
         data: DemiBuffer,
         seg_start: SeqNumber,
-        seg_end: SeqNumber,
         seg_len: u32,
         cb: &mut SharedControlBlock,
     ) -> Result<(), Fail> {
@@ -447,7 +482,9 @@ impl Receiver {
             match cb.get_state() {
                 State::Established | State::FinWait1 | State::FinWait2 => {
                     debug_assert_eq!(seg_len, data.len() as u32);
-                    self.store_out_of_order_segment(seg_start, seg_end, data);
+                    stats::count(Counter::OutOfOrderBytes, seg_len as u64);
+                    self.out_of_order_frames
+                        .insert(self.receive_next_seq_no, seg_start, data);
                     // Sending an ACK here is only a "MAY" according to the RFCs, but helpful for fast retransmit.
                     trace!("process_data(): send ack on out-of-order segment");
                     cb.send_ack();
@@ -464,109 +501,6 @@ impl Receiver {
         Ok(())
     }
 
-    // This routine takes an incoming TCP segment and adds it to the out-of-order receive queue.
-    // If the new segment had a FIN it has been removed prior to this routine being called.
-    // Note: Since this is not the "fast path", this is written for clarity over efficiency.
-    //
-    fn store_out_of_order_segment(&mut self, mut new_start: SeqNumber, mut new_end: SeqNumber, mut buf: DemiBuffer) {
-        let mut action_index: usize = self.out_of_order_frames.len();
-        let mut another_pass_neeeded: bool = true;
-
-        while another_pass_neeeded {
-            another_pass_neeeded = false;
-
-            // Find the new segment's place in the out-of-order store.
-            // The out-of-order store is sorted by starting sequence number, and contains no duplicate data.
-            action_index = self.out_of_order_frames.len();
-            for index in 0..self.out_of_order_frames.len() {
-                let stored_segment: &(SeqNumber, DemiBuffer) = &self.out_of_order_frames[index];
-
-                // Properties of the segment stored at this index.
-                let stored_start: SeqNumber = stored_segment.0;
-                let stored_len: u32 = stored_segment.1.len() as u32;
-                debug_assert_ne!(stored_len, 0);
-                let stored_end: SeqNumber = stored_start + SeqNumber::from(stored_len - 1);
-
-                //
-                // The new data segment has six possibilites when compared to an existing out-of-order segment:
-                //
-                //                                |<- out-of-order segment ->|
-                //
-                // |<- new before->|    |<- new front overlap ->|    |<- new end overlap ->|    |<- new after ->|
-                //                                   |<- new duplicate ->|
-                //                            |<- new completely encompassing ->|
-                //
-                if new_start < stored_start {
-                    // The new segment starts before the start of this out-of-order segment.
-                    if new_end < stored_start {
-                        // The new segment comes completely before this out-of-order segment.
-                        // Since the out-of-order store is sorted, we don't need to check for overlap with any more.
-                        action_index = index;
-                        break;
-                    }
-                    // The end of the new segment overlaps with the start of this out-of-order segment.
-                    if stored_end < new_end {
-                        // The new segment ends after the end of this out-of-order segment.  In other words, the new
-                        // segment completely encompasses the out-of-order segment.
-
-                        // Set flags to remove the currently stored segment and re-run the insertion loop, as the
-                        // new segment may completely encompass even more segments.
-                        another_pass_neeeded = true;
-                        action_index = index;
-                        break;
-                    }
-                    // We have some data overlap between the new segment and the front of the out-of-order segment.
-                    // Trim the end of the new segment and stop checking for out-of-order overlap.
-                    let excess: u32 = u32::from(new_end - stored_start) + 1;
-                    new_end = new_end - SeqNumber::from(excess);
-                    expect_ok!(
-                        buf.trim(excess as usize),
-                        "'buf' should contain at least 'excess' bytes"
-                    );
-                    break;
-                } else {
-                    // The new segment starts at or after the start of this out-of-order segment.
-                    // This is the stored_start <= new_start case.
-                    if new_end <= stored_end {
-                        // And the new segment ends at or before this out-of-order segment.
-                        // The new segment's data is a complete duplicate of this out-of-order segment's data.
-                        // Just drop the new segment.
-                        return;
-                    }
-                    if stored_end < new_start {
-                        // The new segment comes entirely after this out-of-order segment.
-                        // Continue to check the next out-of-order segment for potential overlap.
-                        continue;
-                    }
-                    // We have some data overlap between the new segment and the end of the out-of-order segment.
-                    // Adjust the beginning of the new segment and continue on to check the next out-of-order segment.
-                    let duplicate: u32 = u32::from(stored_end - new_start);
-                    new_start = new_start + SeqNumber::from(duplicate);
-                    expect_ok!(
-                        buf.adjust(duplicate as usize),
-                        "'buf' should contain at least 'duplicate' bytes"
-                    );
-                    continue;
-                }
-            }
-
-            if another_pass_neeeded {
-                // The new segment completely encompassed an existing segment, which we will now remove.
-                self.out_of_order_frames.remove(action_index);
-            }
-        }
-
-        // Insert the new segment into the correct position.
-        self.out_of_order_frames.insert(action_index, (new_start, buf));
-
-        // If the out-of-order store now contains too many entries, delete the later entries.
-        // TODO: The out-of-order store is already limited (in size) by our receive window, while the below check
-        // imposes a limit on the number of entries.  Do we need this?  Presumably for attack mitigation?
-        while self.out_of_order_frames.len() > MAX_OUT_OF_ORDER_SIZE_FRAMES {
-            self.out_of_order_frames.pop_back();
-        }
-    }
-
     // This routine takes an incoming in-order TCP segment and adds the data to the user's receive queue.  If the new
     // segment fills a "hole" in the receive sequence number space allowing previously stored out-of-order data to now
     // be received, it receives that too.
@@ -587,22 +521,12 @@ impl Receiver {
 
         // Okay, we've successfully received some new data.  Check if any of the formerly out-of-order data waiting in
         // the out-of-order queue is now in-order.  If so, we can move it to the receive queue.
-        while !self.out_of_order_frames.is_empty() {
-            if let Some(stored_entry) = self.out_of_order_frames.front() {
-                if stored_entry.0 == self.receive_next_seq_no {
-                    // Move this entry's buffer from the out-of-order store to the receive queue.
-                    // This data is now considered to be "received" by TCP, and included in our RCV.NXT calculation.
-                    debug!("Recovering out-of-order packet at {}", self.receive_next_seq_no);
-                    if let Some(temp) = self.out_of_order_frames.pop_front() {
-                        self.receive_next_seq_no = self.receive_next_seq_no + SeqNumber::from(temp.1.len() as u32);
-                        // This inserts the segment and wakes a waiting pop coroutine.
-                        self.pop_queue.push(temp.1);
-                    }
-                } else {
-                    // Since our out-of-order list is sorted, we can stop when the next segment is not in sequence.
-                    break;
-                }
-            }
+        while let Some(buf) = self.out_of_order_frames.pop_in_order(self.receive_next_seq_no) {
+            // This data is now considered to be "received" by TCP, and included in our RCV.NXT calculation.
+            debug!("Recovering out-of-order packet at {}", self.receive_next_seq_no);
+            self.receive_next_seq_no = self.receive_next_seq_no + SeqNumber::from(buf.len() as u32);
+            // This inserts the segment and wakes a waiting pop coroutine.
+            self.pop_queue.push(buf);
         }
     }
 
@@ -619,6 +543,12 @@ impl Receiver {
         self.receive_next_seq_no
     }
 
+    /// Writes the SACK blocks that describe the out-of-order data that we hold to `blocks` and returns how many there
+    /// are.
+    pub fn sack_blocks(&self, blocks: &mut [SelectiveAcknowlegement; MAX_SACK_BLOCKS]) -> usize {
+        self.out_of_order_frames.sack_blocks(self.receive_next_seq_no, blocks)
+    }
+
     pub fn get_receive_window_size(&self) -> u32 {
         let bytes_unread: u32 = (self.receive_next_seq_no - self.reader_next_seq_no).into();
         self.buffer_size_frames - bytes_unread
@@ -647,7 +577,6 @@ impl Receiver {
             // - TCP should implement a delayed ACK
             // - The delay must be less than 500ms
             // - For a stream of full-sized segments, there should be an ack for every other segment.
-            // TODO: Implement SACKs
             match ack_deadline.wait_for_change_until(deadline).await {
                 Ok(value) => {
                     deadline = value;
@@ -666,3 +595,47 @@ impl Receiver {
         }
     }
 }
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::{
+        inetstack::protocols::layer4::tcp::{established::receiver::Receiver, SeqNumber},
+        runtime::memory::DemiBuffer,
+    };
+    use ::anyhow::Result;
+    use ::std::time::Duration;
+
+    /// Checks that a zero-copy pop chains the queued buffers until it has enough data and leaves the FIN in the queue.
+    #[test]
+    fn test_zero_copy_pop_gather() -> Result<()> {
+        let mut receiver: Receiver = Receiver::new(
+            SeqNumber::from(0),
+            SeqNumber::from(0),
+            Duration::from_millis(1),
+            0xffff,
+            0,
+            true,
+        );
+        for _ in 0..3 {
+            receiver.pop_queue.push(DemiBuffer::from_slice(&[0xab; 100])?);
+        }
+        receiver.pop_queue.push(DemiBuffer::new(0));
+
+        let mut buf: DemiBuffer = crate::expect_some!(receiver.pop_queue.try_pop(), "should have a buffer");
+        receiver.gather(&mut buf, Some(150));
+        crate::ensure_eq!(buf.num_segments(), 2);
+        crate::ensure_eq!(buf.total_len(), 200);
+        crate::ensure_eq!(receiver.pop_queue.len(), 2);
+
+        receiver.gather(&mut buf, None);
+        crate::ensure_eq!(buf.num_segments(), 3);
+        crate::ensure_eq!(buf.total_len(), 300);
+        crate::ensure_eq!(receiver.pop_queue.len(), 1);
+
+        Ok(())
+    }
+}
@@ -8,11 +8,15 @@
 use crate::{
     collections::{async_queue::SharedAsyncQueue, async_value::SharedAsyncValue},
     inetstack::protocols::layer4::tcp::{
-        established::{rto::RtoCalculator, SharedControlBlock},
-        header::TcpHeader,
+        established::{congestion_control::RateSample, rto::RtoCalculator, SharedControlBlock},
+        header::{SelectiveAcknowlegement, TcpHeader},
         SeqNumber,
     },
-    runtime::{conditional_yield_until, fail::Fail, memory::DemiBuffer},
+    perftools::stats::{self, Counter},
+    runtime::{
+        conditional_yield_until, fail::Fail, memory::DemiBuffer, network::consts::MAX_TSO_SEGMENT_SIZE,
+        yield_with_timeout,
+    },
 };
 use ::futures::{pin_mut, select_biased, FutureExt};
 use ::libc::{EBUSY, EINVAL};
@@ -35,6 +39,24 @@ pub struct UnackedSegment {
     pub bytes: Option<DemiBuffer>,
     // Set to `None` on retransmission to implement Karn's algorithm.
     pub initial_tx: Option<Instant>,
+    // One's complement sum of `bytes`, so that retransmissions do not have to checksum the payload again. `None` if it
+    // was not computed, either because there is no payload or because the NIC computes checksums for us.
+    pub payload_sum: Option<u16>,
+    // Set once our peer reports that it holds this segment in a SACK block (RFC 2018), so it is not retransmitted.
+    pub sacked: bool,
+    // Delivery progress of the connection when this segment was sent, from which its ACK samples the delivery rate.
+    pub delivery: DeliveryState,
+}
+
+// Delivery progress of a connection, as in draft-cheng-iccrg-delivery-rate-estimation.
+#[derive(Clone, Copy)]
+pub struct DeliveryState {
+    // Bytes delivered so far.
+    pub delivered: u64,
+    // When `delivered` was last updated.
+    pub delivered_time: Instant,
+    // When the first segment of the current sampling interval was sent.
+    pub first_sent_time: Instant,
 }
 
 // Hard limit for unsent queue.
@@ -43,11 +65,13 @@ pub struct UnackedSegment {
 const UNSENT_QUEUE_CUTOFF: usize = 1024;
 
 // Minimum size for unacknowledged queue. This number doesn't really matter very much, it just sets the initial size
-// of the unacked queue, below which memory allocation is not required.
+// of the unacked queue, below which memory allocation is not required. Room for it is only made once the first segment
+// is sent, so that idle connections do not hold on to it.
 const MIN_UNACKED_QUEUE_SIZE_FRAMES: usize = 64;
 
 // Minimum size for unsent queue. This number doesn't really matter very much, it just sets the initial size
-// of the unacked queue, below which memory allocation is not required.
+// of the unsent queue, below which memory allocation is not required. Room for it is only made once the first buffer
+// is pushed.
 const MIN_UNSENT_QUEUE_SIZE_FRAMES: usize = 64;
 
 // TODO: Consider moving retransmit timer and congestion control fields out of this structure.
@@ -72,6 +96,13 @@ pub struct Sender {
     // Queue of unacknowledged sent data.  RFC 793 calls this the "retransmission queue".
     unacked_queue: SharedAsyncQueue<UnackedSegment>,
 
+    // End of the highest block of data that our peer reported in a SACK option. Unacknowledged data below it that our
+    // peer did not report is presumed lost (RFC 6675).
+    highest_sacked_seq_no: Option<SeqNumber>,
+
+    // Holes below this sequence number have been retransmitted already during the current recovery.
+    sack_retransmit_next_seq_no: SeqNumber,
+
     // Send timers
     // Current retransmission timer expiration time.
     // TODO: Consider storing this directly in the RtoCalculator.
@@ -102,9 +133,19 @@ pub struct Sender {
     // RFC 1323: Number of bits to shift advertised window, defaults to zero.
     send_window_scale_shift_bits: u8,
 
+    // Delivery progress of this connection, for delivery rate samples.
+    delivery: DeliveryState,
+
+    // Earliest time at which the next segment may be sent when the congestion control algorithm sets a pacing rate.
+    next_paced_send_time: Option<Instant>,
+
     // Maximum Segment Size currently in use for this connection.
     // TODO: Revisit this once we support path MTU discovery.
     mss: usize,
+
+    // Largest payload that we put in a single segment. This is the MSS, unless the NIC cuts larger segments into
+    // MSS-sized packets for us (TCP segmentation offload).
+    max_segment_size: usize,
 }
 
 //======================================================================================================================
@@ -112,26 +153,47 @@ pub struct Sender {
 //======================================================================================================================
 
 impl Sender {
-    pub fn new(seq_no: SeqNumber, send_window: u32, send_window_scale_shift_bits: u8, mss: usize) -> Self {
+    pub fn new(
+        seq_no: SeqNumber,
+        send_window: u32,
+        send_window_scale_shift_bits: u8,
+        mss: usize,
+        tcp_segmentation_offload: bool,
+    ) -> Self {
+        let max_segment_size: usize = if tcp_segmentation_offload {
+            MAX_TSO_SEGMENT_SIZE
+        } else {
+            mss
+        };
+        let now: Instant = Instant::now();
         Self {
             send_unacked: SharedAsyncValue::new(seq_no),
-            unacked_queue: SharedAsyncQueue::with_capacity(MIN_UNACKED_QUEUE_SIZE_FRAMES),
+            unacked_queue: SharedAsyncQueue::with_lazy_capacity(MIN_UNACKED_QUEUE_SIZE_FRAMES),
+            highest_sacked_seq_no: None,
+            sack_retransmit_next_seq_no: seq_no,
             retransmit_deadline_time_secs: SharedAsyncValue::new(None),
             rto_calculator: RtoCalculator::new(),
             send_next_seq_no: SharedAsyncValue::new(seq_no),
             unsent_next_seq_no: seq_no,
             fin_seq_no: None,
-            unsent_queue: SharedAsyncQueue::with_capacity(MIN_UNSENT_QUEUE_SIZE_FRAMES),
+            unsent_queue: SharedAsyncQueue::with_lazy_capacity(MIN_UNSENT_QUEUE_SIZE_FRAMES),
             send_window: SharedAsyncValue::new(send_window),
             send_window_last_update_seq: seq_no,
             send_window_last_update_ack: seq_no,
             send_window_scale_shift_bits,
+            delivery: DeliveryState {
+                delivered: 0,
+                delivered_time: now,
+                first_sent_time: now,
+            },
+            next_paced_send_time: None,
             mss,
+            max_segment_size,
         }
     }
 
     // This function sends a packet and waits for it to be acked.
-    pub async fn push(&mut self, mut buf: DemiBuffer, mut cb: SharedControlBlock) -> Result<(), Fail> {
+    pub async fn push(&mut self, buf: DemiBuffer, mut cb: SharedControlBlock) -> Result<(), Fail> {
         // If the user is done sending (i.e. has called close on this connection), then they shouldn't be sending.
         debug_assert!(self.fin_seq_no.is_none());
         // Our API supports send buffers up to usize (variable, depends upon architecture) in size.  While we could
@@ -141,8 +203,8 @@ impl Sender {
         //
         // Review: Move this check up the stack (i.e. closer to the user)?
         //
-        let _: u32 = buf
-            .len()
+        let buf_len: u32 = buf
+            .total_len()
             .try_into()
             .map_err(|_| Fail::new(EINVAL, "buffer too large"))?;
 
@@ -151,13 +213,16 @@ impl Sender {
             return Err(Fail::new(EBUSY, "too many packets to send"));
         }
 
-        // Place the buffer in the unsent queue.
-        self.unsent_next_seq_no = self.unsent_next_seq_no + (buf.len() as u32).into();
-        if self.send_window.get() > 0 {
-            self.send_segment(&mut buf, &mut cb);
-        }
-        if buf.len() > 0 {
-            self.unsent_queue.push(Some(buf));
+        // Place the buffer in the unsent queue. The segments of a chained buffer are queued one after the other, so
+        // they go out on the wire without being copied into a single buffer.
+        self.unsent_next_seq_no = self.unsent_next_seq_no + buf_len.into();
+        if buf.is_multi_segment() {
+            let mut queued: bool = false;
+            for segment in buf.into_segments() {
+                queued = self.send_or_enqueue(segment, queued, &mut cb);
+            }
+        } else {
+            self.send_or_enqueue(buf, false, &mut cb);
         }
 
         // Wait until the sequnce number of the pushed buffer is acknowledged.
@@ -170,6 +235,24 @@ impl Sender {
         Ok(())
     }
 
+    /// Sends as much of `buf` as the window allows and places the rest in the unsent queue. Data is only sent right
+    /// away if nothing from the same push has been queued yet (i.e. `queued` is false), so that it goes out in order,
+    /// and if the congestion control algorithm does not pace segments, which the background sender does.
+    /// Returns whether some data has been queued.
+    fn send_or_enqueue(&mut self, mut buf: DemiBuffer, queued: bool, cb: &mut SharedControlBlock) -> bool {
+        if buf.len() == 0 {
+            return queued;
+        }
+        if !queued && self.send_window.get() > 0 && cb.congestion_control_get_pacing_rate().is_none() {
+            self.send_segment(&mut buf, cb);
+        }
+        if buf.len() > 0 {
+            self.unsent_queue.push(Some(buf));
+            return true;
+        }
+        queued
+    }
+
     // Places a FIN marker in the outgoing data stream. No data can be pushed after this.
     pub async fn push_fin_and_wait_for_ack(&mut self) -> Result<(), Fail> {
         debug_assert!(self.fin_seq_no.is_none());
@@ -217,6 +300,9 @@ impl Sender {
         let unacked_segment = UnackedSegment {
             bytes: None,
             initial_tx: Some(now),
+            payload_sum: None,
+            sacked: false,
+            delivery: self.delivery_state(now),
         };
         self.unacked_queue.push(unacked_segment);
         // Set the retransmit timer.
@@ -247,6 +333,14 @@ impl Sender {
                 // TODO: Nagle's algorithm - We need to coalese small buffers together to send MSS sized packets.
                 // TODO: Silly window syndrome - See RFC 1122's discussion of the SWS avoidance algorithm.
 
+                // Hold the segment back until the pacing rate lets it out.
+                if let Some(deadline) = self.next_paced_send_time {
+                    let now: Instant = cb.get_now();
+                    if deadline > now {
+                        yield_with_timeout(deadline - now).await;
+                    }
+                }
+
                 // We have some window, try to send some or all of the segment.
                 let _: usize = self.send_segment(&mut buffer, cb);
                 // If the buffer is now empty, then we sent all of it.
@@ -271,9 +365,13 @@ impl Sender {
         self.send_next_seq_no.modify(|s| s + SeqNumber::from(1));
 
         // Add the probe byte (as a new separate buffer) to our unacknowledged queue.
+        let now: Instant = cb.get_now();
         let unacked_segment = UnackedSegment {
             bytes: Some(probe.clone()),
-            initial_tx: Some(cb.get_now()),
+            initial_tx: Some(now),
+            payload_sum: None,
+            sacked: false,
+            delivery: self.delivery_state(now),
         };
         self.unacked_queue.push(unacked_segment);
 
@@ -334,22 +432,38 @@ impl Sender {
         if do_push {
             header.psh = true;
         }
-        cb.emit(header, Some(segment_data.clone()));
+        header.cwr = cb.congestion_control_take_cwr();
+        let payload_sum: Option<u16> = cb.payload_sum(&segment_data);
+        cb.emit_with_payload_sum(header, Some(segment_data.clone()), payload_sum);
 
         // Update SND.NXT.
         self.send_next_seq_no.modify(|s| s + SeqNumber::from(segment_data_len));
 
         // Put this segment on the unacknowledged list.
+        let now: Instant = cb.get_now();
         let unacked_segment = UnackedSegment {
             bytes: Some(segment_data),
-            initial_tx: Some(cb.get_now()),
+            initial_tx: Some(now),
+            payload_sum,
+            sacked: false,
+            delivery: self.delivery_state(now),
         };
         self.unacked_queue.push(unacked_segment);
 
         // Set the retransmit timer.
         if self.retransmit_deadline_time_secs.get().is_none() {
             let rto: Duration = self.rto_calculator.rto();
-            self.retransmit_deadline_time_secs.set(Some(cb.get_now() + rto));
+            self.retransmit_deadline_time_secs.set(Some(now + rto));
+        }
+
+        // Space segments out so that they leave at the pacing rate.
+        if let Some(pacing_rate) = cb.congestion_control_get_pacing_rate() {
+            let delay: Duration = Duration::from_secs_f64(segment_data_len as f64 / pacing_rate as f64);
+            let start: Instant = match self.next_paced_send_time {
+                Some(deadline) if deadline > now => deadline,
+                _ => now,
+            };
+            self.next_paced_send_time = Some(start + delay);
         }
         segment_data_len as usize
     }
@@ -370,7 +484,7 @@ impl Sender {
         let win_sz: u32 = self.send_window.get();
 
         if Self::has_open_window(win_sz, sent_data, effective_cwnd) {
-            Self::calculate_open_window_bytes(win_sz, sent_data, self.mss, effective_cwnd)
+            Self::calculate_open_window_bytes(win_sz, sent_data, self.max_segment_size, effective_cwnd)
         } else {
             0
         }
@@ -380,9 +494,9 @@ impl Sender {
         win_sz > 0 && win_sz >= sent_data && effective_cwnd >= sent_data
     }
 
-    fn calculate_open_window_bytes(win_sz: u32, sent_data: u32, mss: usize, effective_cwnd: u32) -> usize {
+    fn calculate_open_window_bytes(win_sz: u32, sent_data: u32, max_segment_size: usize, effective_cwnd: u32) -> usize {
         cmp::min(
-            cmp::min((win_sz - sent_data) as usize, mss),
+            cmp::min((win_sz - sent_data) as usize, max_segment_size),
             (effective_cwnd - sent_data) as usize,
         )
     }
@@ -426,6 +540,11 @@ impl Sender {
                     // TODO: Is this the best place for this?
                     // TODO: Why call into ControlBlock to get SND.UNA when congestion_control_on_rto() has access to it?
                     cb.congestion_control_on_rto(self.send_unacked.get());
+                    stats::count(Counter::RtoFires, 1);
+
+                    // RFC 2018 Section 8: Our peer may have dropped the data that it reported in SACK options, so
+                    // recover from the earliest unacknowledged segment on.
+                    self.clear_sack_scoreboard();
 
                     // RFC 6298 Section 5.4: Retransmit earliest unacknowledged segment.
                     self.retransmit(&mut cb);
@@ -446,8 +565,56 @@ impl Sender {
         }
     }
 
-    /// Retransmits the earliest segment that has not (yet) been acknowledged by our peer.
+    /// Retransmits the segments that our peer is missing. Without SACK information, this is the earliest segment that
+    /// has not (yet) been acknowledged by our peer. Otherwise, these are the holes below the highest SACKed data that
+    /// were not retransmitted during this recovery yet, up to a congestion window worth of data (RFC 6675).
     pub fn retransmit(&mut self, cb: &mut SharedControlBlock) {
+        let send_unacked: SeqNumber = self.send_unacked.get();
+        let highest_sacked: SeqNumber = match self.highest_sacked_seq_no {
+            Some(highest_sacked) if highest_sacked > send_unacked => highest_sacked,
+            _ => return self.retransmit_earliest(cb),
+        };
+        let budget: usize = cmp::max(cb.congestion_control_get_cwnd().get() as usize, self.mss);
+        let retransmit_next: SeqNumber = if self.sack_retransmit_next_seq_no > send_unacked {
+            self.sack_retransmit_next_seq_no
+        } else {
+            send_unacked
+        };
+
+        let mut retransmitted: usize = 0;
+        let mut seq_no: SeqNumber = send_unacked;
+        for segment in self.unacked_queue.get_mut_values() {
+            if seq_no >= highest_sacked || retransmitted >= budget {
+                break;
+            }
+            let len: u32 = segment.bytes.as_ref().map_or(1, |b| b.len() as u32);
+            if !segment.sacked && seq_no >= retransmit_next {
+                // See Karn's algorithm in retransmit_earliest().
+                segment.initial_tx.take();
+                let data: Option<DemiBuffer> = segment.bytes.as_ref().map(|b| b.clone());
+                let mut header: TcpHeader = cb.tcp_header();
+                header.seq_num = seq_no;
+                if data.is_some() {
+                    header.psh = true;
+                } else {
+                    header.fin = true;
+                }
+                cb.emit_with_payload_sum(header, data, segment.payload_sum);
+                stats::count(Counter::Retransmits, 1);
+                retransmitted += len as usize;
+                self.sack_retransmit_next_seq_no = seq_no + SeqNumber::from(len);
+            }
+            seq_no = seq_no + SeqNumber::from(len);
+        }
+
+        // Every hole was retransmitted once already, so our peer is still missing the earliest one.
+        if retransmitted == 0 {
+            self.retransmit_earliest(cb);
+        }
+    }
+
+    /// Retransmits the earliest segment that has not (yet) been acknowledged by our peer.
+    fn retransmit_earliest(&mut self, cb: &mut SharedControlBlock) {
         match self.unacked_queue.get_front_mut() {
             Some(segment) => {
                 // We're retransmitting this, so we can no longer use an ACK for it as an RTT measurement (as we can't
@@ -469,17 +636,19 @@ impl Sender {
                 } else {
                     header.fin = true;
                 }
-                cb.emit(header, data);
+                cb.emit_with_payload_sum(header, data, segment.payload_sum);
+                stats::count(Counter::Retransmits, 1);
             },
             None => (),
         }
     }
 
-    // Process an ack.
-    pub fn process_ack(&mut self, header: &TcpHeader, now: Instant) {
+    // Process an ack. Returns a delivery rate sample if the ACK acknowledges a segment that was only sent once.
+    pub fn process_ack(&mut self, header: &TcpHeader, now: Instant) -> Option<RateSample> {
         // Start by checking that the ACK acknowledges something new.
         // TODO: Look into removing Watched types.
         let send_unacknowledged: SeqNumber = self.send_unacked.get();
+        let mut sampled: Option<(DeliveryState, Instant)> = None;
 
         if send_unacknowledged < header.ack_num {
             // Remove the now acknowledged data from the unacknowledged queue, update the acked sequence number
@@ -493,7 +662,13 @@ impl Sender {
             while bytes_remaining != 0 {
                 bytes_remaining = match self.unacked_queue.try_pop() {
                     Some(segment) if segment.bytes.is_none() => self.process_acked_fin(bytes_remaining, header.ack_num),
-                    Some(segment) => self.process_acked_segment(bytes_remaining, segment, now),
+                    Some(segment) => {
+                        // The most recently sent segment gives the most recent sample.
+                        if let Some(initial_tx) = segment.initial_tx {
+                            sampled = Some((segment.delivery, initial_tx));
+                        }
+                        self.process_acked_segment(bytes_remaining, segment, now)
+                    },
                     None => {
                         unreachable!("There should be enough data in the unacked_queue for the number of bytes acked")
                     }, // Shouldn't have bytes_remaining with no segments remaining in unacked_queue.
@@ -502,6 +677,13 @@ impl Sender {
 
             // Update SND.UNA to SEG.ACK.
             self.send_unacked.set(header.ack_num);
+            if self
+                .highest_sacked_seq_no
+                .is_some_and(|highest_sacked| highest_sacked <= header.ack_num)
+            {
+                self.clear_sack_scoreboard();
+            }
+            self.update_sack_scoreboard(header.sack_blocks());
 
             // Check and update send window if necessary.
             self.update_send_window(header);
@@ -514,13 +696,108 @@ impl Sender {
                 debug_assert_eq!(self.send_next_seq_no.get(), header.ack_num);
             }
             self.retransmit_deadline_time_secs.set(retransmit_deadline_time_secs);
+
+            self.delivery.delivered += bytes_acknowledged as u64;
+            self.delivery.delivered_time = now;
+            sampled.map(|(delivery, initial_tx)| self.rate_sample(delivery, initial_tx, header.ack_num, now))
         } else {
-            // Duplicate ACK (doesn't acknowledge anything new).  We can mostly ignore this, except for fast-retransmit.
+            // Duplicate ACK (doesn't acknowledge anything new).  We can mostly ignore this, except for fast-retransmit
+            // and the SACK blocks that it carries.
             // TODO: Implement fast-retransmit.  In which case, we'd increment our dup-ack counter here.
             warn!("process_ack(): received duplicate ack ({:?})", header.ack_num);
+            self.update_sack_scoreboard(header.sack_blocks());
+            None
+        }
+    }
+
+    /// Returns the delivery progress to record in a segment that gets sent at `now`. A sampling interval starts when
+    /// nothing is in flight.
+    fn delivery_state(&mut self, now: Instant) -> DeliveryState {
+        if self.unacked_queue.is_empty() {
+            self.delivery.first_sent_time = now;
+            self.delivery.delivered_time = now;
+        }
+        self.delivery
+    }
+
+    /// Computes the delivery rate sample for the ACK of a segment that was sent at `sent_time`, when the connection was
+    /// at `prior` (draft-cheng-iccrg-delivery-rate-estimation, section 3.3).
+    fn rate_sample(
+        &mut self,
+        prior: DeliveryState,
+        sent_time: Instant,
+        ack_num: SeqNumber,
+        now: Instant,
+    ) -> RateSample {
+        self.delivery.first_sent_time = sent_time;
+        // The data may have been sent faster than it was acknowledged or the other way round, and the slower of the two
+        // bounds the delivery rate.
+        let send_elapsed: Duration = sent_time.saturating_duration_since(prior.first_sent_time);
+        let ack_elapsed: Duration = self
+            .delivery
+            .delivered_time
+            .saturating_duration_since(prior.delivered_time);
+        RateSample {
+            delivered: self.delivery.delivered - prior.delivered,
+            prior_delivered: prior.delivered,
+            interval: cmp::max(send_elapsed, ack_elapsed),
+            rtt: now.saturating_duration_since(sent_time),
+            bytes_in_flight: (self.send_next_seq_no.get() - ack_num).into(),
+            now,
         }
     }
 
+    /// Marks the unacknowledged segments that lie within any of the SACK blocks that our peer sent.
+    fn update_sack_scoreboard(&mut self, blocks: &[SelectiveAcknowlegement]) {
+        let send_unacked: SeqNumber = self.send_unacked.get();
+        let send_next: SeqNumber = self.send_next_seq_no.get();
+        // Ignore blocks that do not describe data in flight (e.g., D-SACKs from RFC 2883).
+        let is_valid = |block: &&SelectiveAcknowlegement| -> bool {
+            send_unacked < block.begin && block.begin < block.end && block.end <= send_next
+        };
+        let highest_sacked: SeqNumber = match blocks
+            .iter()
+            .filter(is_valid)
+            .map(|block| block.end)
+            .reduce(|highest, end| if end > highest { end } else { highest })
+        {
+            Some(end) => end,
+            None => return,
+        };
+
+        let mut seq_no: SeqNumber = send_unacked;
+        for segment in self.unacked_queue.get_mut_values() {
+            if seq_no >= highest_sacked {
+                break;
+            }
+            let end: SeqNumber = seq_no + SeqNumber::from(segment.bytes.as_ref().map_or(1, |b| b.len() as u32));
+            if !segment.sacked
+                && blocks
+                    .iter()
+                    .filter(is_valid)
+                    .any(|block| block.begin <= seq_no && end <= block.end)
+            {
+                segment.sacked = true;
+            }
+            seq_no = end;
+        }
+
+        self.highest_sacked_seq_no = match self.highest_sacked_seq_no {
+            Some(previous) if previous > highest_sacked => Some(previous),
+            _ => Some(highest_sacked),
+        };
+    }
+
+    /// Forgets what our peer reported in SACK options.
+    fn clear_sack_scoreboard(&mut self) {
+        if self.highest_sacked_seq_no.take().is_some() {
+            for segment in self.unacked_queue.get_mut_values() {
+                segment.sacked = false;
+            }
+        }
+        self.sack_retransmit_next_seq_no = self.send_unacked.get();
+    }
+
     fn process_acked_fin(&mut self, bytes_remaining: usize, ack_num: SeqNumber) -> usize {
         // This buffer is the end-of-send marker.  So we should only have one byte of acknowledged
         // sequence space remaining (corresponding to our FIN).
@@ -556,6 +833,9 @@ impl Sender {
                         .expect("Should be able to split back because we just checked the length"),
                 ),
                 initial_tx: None,
+                payload_sum: None,
+                sacked: segment.sacked,
+                delivery: segment.delivery,
             };
             // Leave this segment on the unacknowledged queue.
             self.unacked_queue.push_front(unacked_segment);
@@ -568,13 +848,10 @@ impl Sender {
     fn update_retransmit_deadline(&self, now: Instant) -> Option<Instant> {
         match self.unacked_queue.get_front() {
             Some(UnackedSegment {
-                bytes: _,
                 initial_tx: Some(initial_tx),
+                ..
             }) => Some(*initial_tx + self.rto_calculator.rto()),
-            Some(UnackedSegment {
-                bytes: _,
-                initial_tx: None,
-            }) => Some(now + self.rto_calculator.rto()),
+            Some(UnackedSegment { initial_tx: None, .. }) => Some(now + self.rto_calculator.rto()),
             None => None,
         }
     }
@@ -609,7 +886,11 @@ impl Sender {
         self.send_next_seq_no.get()
     }
 
-    // Get the current estimate of RTO.
+    /// Returns the maximum segment size that is currently in use for this connection.
+    pub fn get_mss(&self) -> usize {
+        self.mss
+    }
+
     pub fn get_rto(&self) -> Duration {
         self.rto_calculator.rto()
     }
@@ -627,6 +908,7 @@ impl fmt::Debug for Sender {
             .field("send_window", &self.send_window)
             .field("window_scale", &self.send_window_scale_shift_bits)
             .field("mss", &self.mss)
+            .field("max_segment_size", &self.max_segment_size)
             .finish()
     }
 }
@@ -2,19 +2,20 @@
 // Licensed under the MIT license.
 
 use crate::{
-    inetstack::protocols::{layer3::ip::IpProtocol, layer4::tcp::SeqNumber},
+    inetstack::protocols::{checksum, layer3::ip::IpProtocol, layer4::tcp::SeqNumber},
     runtime::{fail::Fail, memory::DemiBuffer},
 };
 use ::libc::EBADMSG;
 use ::std::{
     io::{Cursor, Read},
     net::Ipv4Addr,
-    slice::ChunksExact,
 };
 
 pub const MIN_TCP_HEADER_SIZE: usize = 20;
 pub const MAX_TCP_HEADER_SIZE: usize = 60;
 pub const MAX_TCP_OPTIONS: usize = 5;
+/// Maximum number of blocks in a SACK option, which is all that fits in the option space of a header.
+pub const MAX_SACK_BLOCKS: usize = 4;
 
 #[derive(Debug, Clone, Copy, PartialEq)]
 pub struct SelectiveAcknowlegement {
@@ -31,7 +32,7 @@ pub enum TcpOptions2 {
     SelectiveAcknowlegementPermitted,
     SelectiveAcknowlegement {
         num_sacks: usize,
-        sacks: [SelectiveAcknowlegement; 4],
+        sacks: [SelectiveAcknowlegement; MAX_SACK_BLOCKS],
     },
     Timestamp {
         sender_timestamp: u32,
@@ -131,6 +132,10 @@ pub struct TcpHeader {
 
     pub num_options: usize,
     pub option_list: [TcpOptions2; MAX_TCP_OPTIONS],
+
+    // Whether the IP packet that carried this segment was marked Congestion Experienced (RFC 3168). This is not part
+    // of the TCP header and is never serialized.
+    pub congestion_experienced: bool,
 }
 
 impl TcpHeader {
@@ -155,6 +160,7 @@ impl TcpHeader {
             urgent_pointer: 0,
             num_options: 0,
             option_list: [TcpOptions2::NoOperation; MAX_TCP_OPTIONS],
+            congestion_experienced: false,
         }
     }
 
@@ -202,7 +208,15 @@ impl TcpHeader {
 
         if !rx_checksum_offload {
             let checksum: u16 = u16::from_be_bytes([hdr_buf[16], hdr_buf[17]]);
-            if checksum != tcp_checksum(local_ipv4_addr, remote_ipv4_addr, hdr_buf, data_buf) {
+            if checksum
+                != tcp_checksum(
+                    local_ipv4_addr,
+                    remote_ipv4_addr,
+                    hdr_buf,
+                    data_buf.len(),
+                    checksum::ones_complement_sum(data_buf),
+                )
+            {
                 return Err(Fail::new(EBADMSG, "TCP checksum mismatch"));
             }
         }
@@ -261,10 +275,11 @@ impl TcpHeader {
                             10 | 18 | 26 | 34 => (option_length as usize - 2) / 8,
                             _ => return Err(Fail::new(EBADMSG, "invalid SACK size")),
                         };
-                        let mut sacks: [SelectiveAcknowlegement; 4] = [SelectiveAcknowlegement {
+                        let mut sacks: [SelectiveAcknowlegement; MAX_SACK_BLOCKS] = [SelectiveAcknowlegement {
                             begin: SeqNumber::from(0),
                             end: SeqNumber::from(0),
-                        }; 4];
+                        };
+                            MAX_SACK_BLOCKS];
                         for s in sacks.iter_mut().take(num_sacks) {
                             let mut temp: [u8; 4] = [0; 4];
                             option_rdr.read_exact(&mut temp)?;
@@ -323,6 +338,7 @@ impl TcpHeader {
 
             num_options,
             option_list,
+            congestion_experienced: false,
         })
     }
 
@@ -333,10 +349,29 @@ impl TcpHeader {
         src_ipv4_addr: &Ipv4Addr,
         dst_ipv4_addr: &Ipv4Addr,
         tx_checksum_offload: bool,
+    ) {
+        let payload_sum: Option<u16> = if tx_checksum_offload {
+            None
+        } else {
+            Some(checksum::ones_complement_sum(&pkt[..]))
+        };
+        self.serialize_and_attach_with_payload_sum(pkt, src_ipv4_addr, dst_ipv4_addr, payload_sum);
+    }
+
+    /// Serializes and prepends the header to `pkt`, like [TcpHeader::serialize_and_attach], but takes the one's
+    /// complement sum of the payload in `pkt` (see [checksum::ones_complement_sum]) rather than adding it up again. This
+    /// lets retransmissions of the same payload skip it. If `payload_sum` is `None`, the checksum is left for the NIC.
+    pub fn serialize_and_attach_with_payload_sum(
+        &self,
+        pkt: &mut DemiBuffer,
+        src_ipv4_addr: &Ipv4Addr,
+        dst_ipv4_addr: &Ipv4Addr,
+        payload_sum: Option<u16>,
     ) {
         let header_bytes: usize = self.compute_size();
         pkt.prepend(header_bytes).expect("Should have sufficient headroom");
-        let (hdr_buf, payload): (&mut [u8], &mut [u8]) = pkt[..].split_at_mut(header_bytes);
+        let payload_len: usize = pkt.len() - header_bytes;
+        let hdr_buf: &mut [u8] = &mut pkt[..header_bytes];
 
         let fixed_buf: &mut [u8; MIN_TCP_HEADER_SIZE] = (&mut hdr_buf[..MIN_TCP_HEADER_SIZE]).try_into().unwrap();
         fixed_buf[0..2].copy_from_slice(&self.src_port.to_be_bytes());
@@ -395,8 +430,8 @@ impl TcpHeader {
         }
 
         // Alright, we've fully filled out the header, time to compute the checksum.
-        if !tx_checksum_offload {
-            let checksum: u16 = tcp_checksum(src_ipv4_addr, dst_ipv4_addr, &hdr_buf[..], &payload);
+        if let Some(payload_sum) = payload_sum {
+            let checksum: u16 = tcp_checksum(src_ipv4_addr, dst_ipv4_addr, &hdr_buf[..], payload_len, payload_sum);
             hdr_buf[16..18].copy_from_slice(&checksum.to_be_bytes());
         } else {
             hdr_buf[16] = 0;
@@ -428,9 +463,27 @@ impl TcpHeader {
         self.option_list[self.num_options] = option;
         self.num_options += 1;
     }
+
+    /// Returns the blocks of the SACK option, if the header carries one.
+    pub fn sack_blocks(&self) -> &[SelectiveAcknowlegement] {
+        for option in self.iter_options() {
+            if let TcpOptions2::SelectiveAcknowlegement { num_sacks, sacks } = option {
+                return &sacks[..*num_sacks];
+            }
+        }
+        &[]
+    }
 }
 
-fn tcp_checksum(src_ipv4_addr: &Ipv4Addr, dst_ipv4_addr: &Ipv4Addr, header: &[u8], data: &[u8]) -> u16 {
+/// Computes the checksum of a TCP segment, given the length and the one's complement sum of its payload (see
+/// [checksum::ones_complement_sum]).
+fn tcp_checksum(
+    src_ipv4_addr: &Ipv4Addr,
+    dst_ipv4_addr: &Ipv4Addr,
+    header: &[u8],
+    payload_len: usize,
+    payload_sum: u16,
+) -> u16 {
     let mut state: u32 = 0xffff;
 
     // First, fold in a "pseudo-IP" header of...
@@ -448,7 +501,7 @@ fn tcp_checksum(src_ipv4_addr: &Ipv4Addr, dst_ipv4_addr: &Ipv4Addr, header: &[u8
     state += u16::from_be_bytes([0, IpProtocol::TCP as u8]) as u32;
 
     // 4) TCP segment length (2 bytes)
-    state += (header.len() + data.len()) as u32;
+    state += (header.len() + payload_len) as u32;
 
     let fixed_header: &[u8; MIN_TCP_HEADER_SIZE] = header[..MIN_TCP_HEADER_SIZE].try_into().unwrap();
 
@@ -488,15 +541,8 @@ fn tcp_checksum(src_ipv4_addr: &Ipv4Addr, dst_ipv4_addr: &Ipv4Addr, header: &[u8
         }
     }
 
-    // Finally, checksum the data itself.
-    let mut chunks_iter: ChunksExact<u8> = data.chunks_exact(2);
-    while let Some(chunk) = chunks_iter.next() {
-        state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
-    }
-    // Since the data may have an odd number of bytes, pad the last byte with zero if necessary.
-    if let Some(&b) = chunks_iter.remainder().get(0) {
-        state += u16::from_be_bytes([b, 0]) as u32;
-    }
+    // Finally, fold in the data itself, which the caller has already summed up.
+    state += payload_sum as u32;
 
     // NB: We don't need to subtract out 0xFFFF as we accumulate the sum. Since we use a u32 for
     // intermediate state, we would need 2^16 additions to overflow. This is well beyond the reach
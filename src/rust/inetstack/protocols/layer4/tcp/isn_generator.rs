@@ -1,21 +1,71 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
-use crate::inetstack::protocols::layer4::tcp::SeqNumber;
+use crate::inetstack::protocols::layer4::tcp::{constants::MAX_WINDOW_SCALE, SeqNumber};
 #[allow(unused_imports)]
-use std::{hash::Hasher, net::SocketAddrV4, num::Wrapping};
+use std::{
+    collections::hash_map::{DefaultHasher, RandomState},
+    hash::{BuildHasher, Hash, Hasher},
+    net::SocketAddrV4,
+    num::Wrapping,
+    time::Duration,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Period of the clock that SYN cookies carry.
+const SYN_COOKIE_PERIOD: Duration = Duration::from_secs(64);
+
+/// Number of periods for which a SYN cookie remains valid after it was sent, on top of the one it was sent in.
+const SYN_COOKIE_MAX_AGE: u32 = 2;
+
+/// Maximum segment sizes that a SYN cookie can carry. A cookie carries the index of the largest one that does not
+/// exceed the size that the peer advertised.
+const SYN_COOKIE_MSS_TABLE: [u16; 8] = [536, 1200, 1400, 1440, 1450, 1460, 4312, 8960];
+
+/// Value of the window scale field of a SYN cookie when the peer did not offer window scaling.
+const SYN_COOKIE_NO_WINDOW_SCALE: u32 = 0xf;
+
+// A SYN cookie is laid out as follows, from the most significant bit: 5 bits of clock, 3 bits of MSS index, 4 bits of
+// window scale, 1 bit of SACK permitted and 19 bits of a keyed hash of the connection, its clock and its options.
+const SYN_COOKIE_CLOCK_SHIFT: u32 = 27;
+const SYN_COOKIE_MSS_SHIFT: u32 = 24;
+const SYN_COOKIE_WINDOW_SCALE_SHIFT: u32 = 20;
+const SYN_COOKIE_SACK_SHIFT: u32 = 19;
+const SYN_COOKIE_HASH_MASK: u32 = (1 << SYN_COOKIE_SACK_SHIFT) - 1;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
 
 #[allow(dead_code)]
 pub struct IsnGenerator {
     nonce: u32,
     counter: Wrapping<u16>,
+    /// Key of the hash that authenticates SYN cookies.
+    cookie_key: RandomState,
 }
 
+/// Options of a SYN that a SYN cookie carries, so that a connection can be set up from its ACK alone.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct SynCookie {
+    pub mss: usize,
+    pub window_scale: Option<u8>,
+    pub sack_permitted: bool,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
 impl IsnGenerator {
     pub fn new(nonce: u32) -> Self {
         Self {
             nonce,
             counter: Wrapping(0),
+            cookie_key: RandomState::new(),
         }
     }
 
@@ -40,4 +90,230 @@ impl IsnGenerator {
         self.counter += Wrapping(1);
         isn
     }
+
+    /// Generates the ISN of a SYN+ACK that answers a SYN from `remote` with sequence number `remote_isn`, such that the
+    /// options in `cookie` can be recovered from the ACK that completes the handshake. `clock` is the time elapsed on
+    /// a clock that the same generator is checked against later. Returns `None` if the MSS of `cookie` is smaller than
+    /// all of those that a cookie can carry.
+    pub fn generate_cookie(
+        &self,
+        local: &SocketAddrV4,
+        remote: &SocketAddrV4,
+        remote_isn: SeqNumber,
+        clock: Duration,
+        cookie: SynCookie,
+    ) -> Option<SeqNumber> {
+        let mss_index: u32 = SYN_COOKIE_MSS_TABLE
+            .iter()
+            .rposition(|mss: &u16| *mss as usize <= cookie.mss)? as u32;
+        let window_scale: u32 = match cookie.window_scale {
+            Some(window_scale) => (window_scale as usize).min(MAX_WINDOW_SCALE) as u32,
+            None => SYN_COOKIE_NO_WINDOW_SCALE,
+        };
+        let period: u32 = Self::cookie_period(clock);
+        let options: u32 = (mss_index << SYN_COOKIE_MSS_SHIFT)
+            | (window_scale << SYN_COOKIE_WINDOW_SCALE_SHIFT)
+            | ((cookie.sack_permitted as u32) << SYN_COOKIE_SACK_SHIFT);
+        let hash: u32 = self.cookie_hash(local, remote, remote_isn, period, options);
+        Some(SeqNumber::from(
+            ((period & 0x1f) << SYN_COOKIE_CLOCK_SHIFT) | options | hash,
+        ))
+    }
+
+    /// Checks whether `isn` is a SYN cookie that this generator handed to `remote` in answer to a SYN with sequence
+    /// number `remote_isn`, no longer than [SYN_COOKIE_MAX_AGE] periods before `clock`. Returns the options that the
+    /// cookie carries if so.
+    pub fn check_cookie(
+        &self,
+        local: &SocketAddrV4,
+        remote: &SocketAddrV4,
+        remote_isn: SeqNumber,
+        isn: SeqNumber,
+        clock: Duration,
+    ) -> Option<SynCookie> {
+        let isn: u32 = u32::from(isn);
+        let now: u32 = Self::cookie_period(clock);
+        // The cookie only carries the low bits of its period, so recover the most recent period that matches them.
+        let age: u32 = now.wrapping_sub(isn >> SYN_COOKIE_CLOCK_SHIFT) & 0x1f;
+        if age > SYN_COOKIE_MAX_AGE || age > now {
+            return None;
+        }
+        let options: u32 = isn & !(0x1f << SYN_COOKIE_CLOCK_SHIFT) & !SYN_COOKIE_HASH_MASK;
+        if self.cookie_hash(local, remote, remote_isn, now - age, options) != isn & SYN_COOKIE_HASH_MASK {
+            return None;
+        }
+
+        let window_scale: u32 = (options >> SYN_COOKIE_WINDOW_SCALE_SHIFT) & 0xf;
+        Some(SynCookie {
+            mss: SYN_COOKIE_MSS_TABLE[(options >> SYN_COOKIE_MSS_SHIFT) as usize & 0x7] as usize,
+            window_scale: match window_scale {
+                SYN_COOKIE_NO_WINDOW_SCALE => None,
+                _ => Some(window_scale as u8),
+            },
+            sack_permitted: (options >> SYN_COOKIE_SACK_SHIFT) & 1 == 1,
+        })
+    }
+
+    /// Returns how long a SYN cookie remains valid, at most.
+    pub fn cookie_lifetime() -> Duration {
+        SYN_COOKIE_PERIOD * (SYN_COOKIE_MAX_AGE + 1)
+    }
+
+    fn cookie_period(clock: Duration) -> u32 {
+        (clock.as_secs() / SYN_COOKIE_PERIOD.as_secs()) as u32
+    }
+
+    fn cookie_hash(
+        &self,
+        local: &SocketAddrV4,
+        remote: &SocketAddrV4,
+        remote_isn: SeqNumber,
+        period: u32,
+        options: u32,
+    ) -> u32 {
+        let mut hasher: DefaultHasher = self.cookie_key.build_hasher();
+        local.hash(&mut hasher);
+        remote.hash(&mut hasher);
+        u32::from(remote_isn).hash(&mut hasher);
+        period.hash(&mut hasher);
+        options.hash(&mut hasher);
+        self.nonce.hash(&mut hasher);
+        hasher.finish() as u32 & SYN_COOKIE_HASH_MASK
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::inetstack::protocols::layer4::tcp::{
+        isn_generator::{IsnGenerator, SynCookie},
+        SeqNumber,
+    };
+    use ::anyhow::Result;
+    use ::std::{
+        net::{Ipv4Addr, SocketAddrV4},
+        time::Duration,
+    };
+
+    /// Checks that a SYN cookie carries the options of the SYN, rounding the MSS down to one that it can encode.
+    #[test]
+    fn test_syn_cookie_carries_options() -> Result<()> {
+        let generator: IsnGenerator = IsnGenerator::new(0xdeadbeef);
+        let local: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 1), 80);
+        let remote: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 2), 49152);
+        let remote_isn: SeqNumber = SeqNumber::from(0xffff_fff0);
+        let clock: Duration = Duration::from_secs(1000);
+
+        for (offered, expected) in [
+            (
+                SynCookie {
+                    mss: 1450,
+                    window_scale: Some(7),
+                    sack_permitted: true,
+                },
+                SynCookie {
+                    mss: 1450,
+                    window_scale: Some(7),
+                    sack_permitted: true,
+                },
+            ),
+            (
+                SynCookie {
+                    mss: 1000,
+                    window_scale: None,
+                    sack_permitted: false,
+                },
+                SynCookie {
+                    mss: 536,
+                    window_scale: None,
+                    sack_permitted: false,
+                },
+            ),
+            (
+                SynCookie {
+                    mss: 9000,
+                    window_scale: Some(14),
+                    sack_permitted: false,
+                },
+                SynCookie {
+                    mss: 8960,
+                    window_scale: Some(14),
+                    sack_permitted: false,
+                },
+            ),
+        ] {
+            let isn: SeqNumber = generator
+                .generate_cookie(&local, &remote, remote_isn, clock, offered)
+                .expect("a cookie should carry the MSS");
+            crate::ensure_eq!(
+                generator.check_cookie(&local, &remote, remote_isn, isn, clock),
+                Some(expected)
+            );
+        }
+
+        // A cookie cannot carry an MSS that is smaller than all of those in the table.
+        let too_small: SynCookie = SynCookie {
+            mss: 500,
+            window_scale: None,
+            sack_permitted: false,
+        };
+        crate::ensure_eq!(
+            generator.generate_cookie(&local, &remote, remote_isn, clock, too_small),
+            None
+        );
+
+        Ok(())
+    }
+
+    /// Checks that SYN cookies do not validate for another connection, once tampered with or once expired.
+    #[test]
+    fn test_syn_cookie_rejects_invalid() -> Result<()> {
+        let generator: IsnGenerator = IsnGenerator::new(0xdeadbeef);
+        let local: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 1), 80);
+        let remote: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 2), 49152);
+        let other: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 2), 49153);
+        let remote_isn: SeqNumber = SeqNumber::from(1234);
+        let clock: Duration = Duration::from_secs(10);
+        let cookie: SynCookie = SynCookie {
+            mss: 1460,
+            window_scale: Some(2),
+            sack_permitted: true,
+        };
+        let isn: SeqNumber = generator
+            .generate_cookie(&local, &remote, remote_isn, clock, cookie)
+            .expect("a cookie should carry the MSS");
+
+        crate::ensure_eq!(generator.check_cookie(&local, &other, remote_isn, isn, clock), None);
+        crate::ensure_eq!(
+            generator.check_cookie(&local, &remote, remote_isn + SeqNumber::from(1), isn, clock),
+            None
+        );
+        // Flip the SACK permitted bit.
+        let tampered: SeqNumber = SeqNumber::from(u32::from(isn) ^ (1 << 19));
+        crate::ensure_eq!(
+            generator.check_cookie(&local, &remote, remote_isn, tampered, clock),
+            None
+        );
+
+        // Cookies stay valid for a while and expire afterwards.
+        let later: Duration = clock + IsnGenerator::cookie_lifetime() - Duration::from_secs(64);
+        crate::ensure_eq!(
+            generator.check_cookie(&local, &remote, remote_isn, isn, later),
+            Some(cookie)
+        );
+        let expired: Duration = clock + IsnGenerator::cookie_lifetime();
+        crate::ensure_eq!(generator.check_cookie(&local, &remote, remote_isn, isn, expired), None);
+
+        // Cookies from another generator do not validate.
+        let other_generator: IsnGenerator = IsnGenerator::new(0xdeadbeef);
+        crate::ensure_eq!(
+            other_generator.check_cookie(&local, &remote, remote_isn, isn, clock),
+            None
+        );
+
+        Ok(())
+    }
 }
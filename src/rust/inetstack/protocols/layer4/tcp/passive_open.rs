@@ -12,15 +12,12 @@ use crate::{
     },
     expect_some,
     inetstack::protocols::{
-        layer3::SharedLayer3Endpoint,
+        layer3::{SharedLayer3Endpoint, IPV4_ECN_NOT_ECT},
         layer4::tcp::{
             constants::FALLBACK_MSS,
-            established::{
-                congestion_control::{self, CongestionControl},
-                EstablishedSocket,
-            },
+            established::{congestion_control, EstablishedSocket},
             header::{TcpHeader, TcpOptions2},
-            isn_generator::IsnGenerator,
+            isn_generator::{IsnGenerator, SynCookie},
             SeqNumber,
         },
         MAX_HEADER_SIZE,
@@ -39,7 +36,7 @@ use ::std::{
     collections::HashMap,
     net::{Ipv4Addr, SocketAddrV4},
     ops::{Deref, DerefMut},
-    time::Duration,
+    time::{Duration, Instant},
 };
 
 //======================================================================================================================
@@ -55,6 +52,13 @@ enum State {
     Closed,
 }
 
+/// A listening socket.
+///
+/// Every half-open connection takes an entry in `connections` and a coroutine that retransmits the SYN+ACK until the
+/// handshake completes, as long as half-open and accepted connections stay within the backlog. Past it, SYNs are
+/// answered with SYN cookies (RFC 4987) instead: the ISN of the SYN+ACK carries the options of the SYN, so no state is
+/// kept until the ACK comes back. Connections that completed their handshake wait for `accept()` in `ready`, a ring
+/// of `max_backlog` slots that is allocated once and never grows.
 pub struct PassiveSocket {
     // TCP Connection State.
     state: SharedAsyncValue<State>,
@@ -62,6 +66,11 @@ pub struct PassiveSocket {
     ready: AsyncQueue<(SocketAddrV4, Result<EstablishedSocket, Fail>)>,
     max_backlog: usize,
     isn_generator: IsnGenerator,
+    /// Time at which the socket started listening, from which the clock of SYN cookies runs.
+    cookie_epoch: Instant,
+    /// Time on the clock of SYN cookies at which the last one was sent, if any. ACKs are only checked for cookies
+    /// while cookies that were sent may still come back.
+    last_cookie: Option<Duration>,
     local: SocketAddrV4,
     runtime: SharedDemiRuntime,
     layer3_endpoint: SharedLayer3Endpoint,
@@ -87,12 +96,15 @@ impl SharedPassiveSocket {
         default_socket_options: TcpSocketOptions,
         nonce: u32,
     ) -> Result<Self, Fail> {
+        let cookie_epoch: Instant = runtime.get_now();
         Ok(Self(SharedObject::<PassiveSocket>::new(PassiveSocket {
             state: SharedAsyncValue::new(State::Listening),
             connections: HashMap::<SocketAddrV4, SharedAsyncQueue<(Ipv4Addr, TcpHeader, DemiBuffer)>>::new(),
-            ready: AsyncQueue::<(SocketAddrV4, Result<EstablishedSocket, Fail>)>::default(),
+            ready: AsyncQueue::<(SocketAddrV4, Result<EstablishedSocket, Fail>)>::with_capacity(max_backlog),
             max_backlog,
             isn_generator: IsnGenerator::new(nonce),
+            cookie_epoch,
+            last_cookie: None,
             local,
             runtime,
             layer3_endpoint,
@@ -136,6 +148,14 @@ impl SharedPassiveSocket {
             return;
         }
 
+        // See if this packet completes a handshake that was answered with a SYN cookie.
+        if tcp_hdr.ack && !tcp_hdr.syn && !tcp_hdr.rst {
+            if let Some(cookie) = self.check_syn_cookie(&remote, &tcp_hdr) {
+                self.complete_syn_cookie_handshake(remote, ipv4_addr, tcp_hdr, buf, cookie);
+                return;
+            }
+        }
+
         // Otherwise if not a SYN, then this packet is not for a new connection and we throw it away.
         if !tcp_hdr.syn || tcp_hdr.ack || tcp_hdr.rst {
             let cause: String = format!(
@@ -164,9 +184,9 @@ impl SharedPassiveSocket {
     fn handle_new_syn(&mut self, remote: SocketAddrV4, tcp_hdr: TcpHeader) {
         debug!("Received SYN: {:?}", tcp_hdr);
         let inflight_len: usize = self.connections.len();
-        // Check backlog. Since we might receive data even on connections that have completed their handshake, all
-        // ready sockets are also in the inflight table.
-        if inflight_len >= self.max_backlog {
+        // Check backlog. Connections that are waiting to be accepted fill up the ring, so there is no point in starting
+        // a handshake that could not complete.
+        if self.ready.len() >= self.max_backlog {
             let cause: String = format!(
                 "backlog full (inflight={}, ready={}, backlog={})",
                 inflight_len,
@@ -178,6 +198,13 @@ impl SharedPassiveSocket {
             return;
         }
 
+        // Every half-open connection with state has a slot of the ring reserved for it. Past that, fall back to a SYN
+        // cookie, which takes no state.
+        if inflight_len + self.ready.len() >= self.max_backlog {
+            self.send_syn_cookie(remote, tcp_hdr);
+            return;
+        }
+
         // Send SYN+ACK.
         let local: SocketAddrV4 = self.local.clone();
         let local_isn = self.isn_generator.generate(&local, &remote);
@@ -205,6 +232,98 @@ impl SharedPassiveSocket {
         self.connections.insert(remote, recv_queue);
     }
 
+    /// Answers a SYN from `remote` with a SYN+ACK whose ISN is a SYN cookie. The SYN is dropped if a cookie cannot carry
+    /// its MSS, as the backlog has no room to handle it with state either.
+    fn send_syn_cookie(&mut self, remote: SocketAddrV4, tcp_hdr: TcpHeader) {
+        let (remote_window_scale, mss, sack_permitted): (Option<u8>, usize, bool) = parse_syn_options(&tcp_hdr);
+        let cookie: SynCookie = SynCookie {
+            mss,
+            window_scale: remote_window_scale,
+            sack_permitted,
+        };
+        let clock: Duration = self.runtime.get_now() - self.cookie_epoch;
+        let local_isn: SeqNumber =
+            match self
+                .isn_generator
+                .generate_cookie(&self.local, &remote, tcp_hdr.seq_num, clock, cookie)
+            {
+                Some(local_isn) => local_isn,
+                None => {
+                    warn!(
+                        "send_syn_cookie(): dropping SYN from {:?}, its MSS is too small for a SYN cookie (mss={})",
+                        remote, mss
+                    );
+                    return;
+                },
+            };
+        self.last_cookie = Some(clock);
+        debug!("send_syn_cookie(): answering SYN from {:?} with a SYN cookie", remote);
+
+        // A SYN cookie has no room for ECN, so do not agree to it.
+        if let Err(e) = self.send_syn_ack(local_isn, tcp_hdr.seq_num, remote, sack_permitted, false) {
+            warn!("send_syn_cookie(): could not send SYN+ACK: {:?}", e);
+        }
+    }
+
+    /// Checks whether an ACK from `remote` carries a SYN cookie that we sent and returns the options of the SYN that
+    /// it answered if so.
+    fn check_syn_cookie(&self, remote: &SocketAddrV4, tcp_hdr: &TcpHeader) -> Option<SynCookie> {
+        let clock: Duration = self.runtime.get_now() - self.cookie_epoch;
+        match self.last_cookie {
+            Some(last_cookie) if clock - last_cookie < IsnGenerator::cookie_lifetime() => (),
+            _ => return None,
+        }
+        self.isn_generator.check_cookie(
+            &self.local,
+            remote,
+            tcp_hdr.seq_num - SeqNumber::from(1),
+            tcp_hdr.ack_num - SeqNumber::from(1),
+            clock,
+        )
+    }
+
+    /// Sets up the connection of an ACK that carries a valid SYN cookie and hands it to `accept()`.
+    fn complete_syn_cookie_handshake(
+        &mut self,
+        remote: SocketAddrV4,
+        ipv4_addr: Ipv4Addr,
+        tcp_hdr: TcpHeader,
+        buf: DemiBuffer,
+        cookie: SynCookie,
+    ) {
+        // The ring may have filled up since the SYN+ACK was sent. Slots that are reserved for half-open connections
+        // with state are not up for grabs.
+        if self.connections.len() + self.ready.len() >= self.max_backlog {
+            warn!(
+                "complete_syn_cookie_handshake(): backlog full (inflight={}, ready={}, backlog={})",
+                self.connections.len(),
+                self.ready.len(),
+                self.max_backlog
+            );
+            self.send_rst(&remote, tcp_hdr);
+            return;
+        }
+
+        let local_isn: SeqNumber = tcp_hdr.ack_num - SeqNumber::from(1);
+        let remote_isn: SeqNumber = tcp_hdr.seq_num - SeqNumber::from(1);
+        let header_window_size: u16 = tcp_hdr.window_size;
+        let recv_queue: SharedAsyncQueue<(Ipv4Addr, TcpHeader, DemiBuffer)> =
+            SharedAsyncQueue::<(Ipv4Addr, TcpHeader, DemiBuffer)>::default();
+        let result: Result<EstablishedSocket, Fail> = self.establish(
+            recv_queue,
+            remote,
+            local_isn,
+            remote_isn,
+            header_window_size,
+            cookie.window_scale,
+            cookie.mss,
+            cookie.sack_permitted,
+            false,
+            (ipv4_addr, tcp_hdr, buf),
+        );
+        self.ready.push((remote, result));
+    }
+
     /// Sends a RST segment to `remote`.
     fn send_rst(&mut self, remote: &SocketAddrV4, tcp_hdr: TcpHeader) {
         debug!("send_rst(): sending RST to {:?}", remote);
@@ -245,7 +364,10 @@ impl SharedPassiveSocket {
         );
 
         // Pass on to send through the L2 layer.
-        if let Err(e) = self.layer3_endpoint.transmit_tcp_packet_nonblocking(dst_ipv4_addr, pkt) {
+        if let Err(e) = self
+            .layer3_endpoint
+            .transmit_tcp_packet_nonblocking(dst_ipv4_addr, IPV4_ECN_NOT_ECT, pkt)
+        {
             warn!("Could not send RST: {:?}", e);
         }
     }
@@ -259,28 +381,16 @@ impl SharedPassiveSocket {
         recv_queue: SharedAsyncQueue<(Ipv4Addr, TcpHeader, DemiBuffer)>,
     ) {
         // Set up new inflight accept connection.
-        let mut remote_window_scale = None;
-        let mut mss = FALLBACK_MSS;
-        for option in tcp_hdr.iter_options() {
-            match option {
-                TcpOptions2::WindowScale(w) => {
-                    info!("Received window scale: {:?}", w);
-                    remote_window_scale = Some(*w);
-                },
-                TcpOptions2::MaximumSegmentSize(m) => {
-                    info!("Received advertised MSS: {}", m);
-                    mss = *m as usize;
-                },
-                _ => continue,
-            }
-        }
+        let (remote_window_scale, mss, sack_permitted): (Option<u8>, usize, bool) = parse_syn_options(&tcp_hdr);
+        // Agree to ECN if our peer offered it in an ECN-setup SYN and our congestion control reacts to marks (RFC 3168).
+        let ecn_capable: bool = tcp_hdr.ece && tcp_hdr.cwr && self.socket_options.get_congestion_control().uses_ecn();
 
         let mut handshake_retries: usize = self.tcp_config.get_handshake_retries();
         let handshake_timeout: Duration = self.tcp_config.get_handshake_timeout();
 
         loop {
             // Send the SYN + ACK.
-            if let Err(e) = self.send_syn_ack(local_isn, remote_isn, remote).await {
+            if let Err(e) = self.send_syn_ack(local_isn, remote_isn, remote, sack_permitted, ecn_capable) {
                 self.complete_handshake(remote, Err(e));
                 return;
             }
@@ -296,6 +406,8 @@ impl SharedPassiveSocket {
                 tcp_hdr.window_size,
                 remote_window_scale,
                 mss,
+                sack_permitted,
+                ecn_capable,
             );
 
             // Either we get an ack or a timeout.
@@ -310,8 +422,7 @@ impl SharedPassiveSocket {
                         handshake_retries = handshake_retries - 1;
                         continue;
                     } else {
-                        self.ready
-                            .push((remote, Err(Fail::new(ETIMEDOUT, "handshake timeout"))));
+                        self.complete_handshake(remote, Err(Fail::new(ETIMEDOUT, "handshake timeout")));
                         return;
                     }
                 },
@@ -323,11 +434,13 @@ impl SharedPassiveSocket {
         }
     }
 
-    async fn send_syn_ack(
+    fn send_syn_ack(
         &mut self,
         local_isn: SeqNumber,
         remote_isn: SeqNumber,
         remote: SocketAddrV4,
+        sack_permitted: bool,
+        ecn_capable: bool,
     ) -> Result<(), Fail> {
         let mut tcp_hdr = TcpHeader::new(self.local.port(), remote.port());
         tcp_hdr.syn = true;
@@ -343,6 +456,15 @@ impl SharedPassiveSocket {
         tcp_hdr.push_option(TcpOptions2::WindowScale(self.tcp_config.get_window_scale()));
         info!("Advertising window scale: {}", self.tcp_config.get_window_scale());
 
+        // Only agree to SACKs if our peer offered them (RFC 2018).
+        if sack_permitted {
+            tcp_hdr.push_option(TcpOptions2::SelectiveAcknowlegementPermitted);
+            info!("Advertising SACK permitted");
+        }
+
+        // An ECN-setup SYN+ACK carries ECE but not CWR.
+        tcp_hdr.ece = ecn_capable;
+
         debug!("Sending SYN+ACK: {:?}", tcp_hdr);
         let dst_ipv4_addr: Ipv4Addr = remote.ip().clone();
         let mut pkt: DemiBuffer = DemiBuffer::new_with_headroom(0, MAX_HEADER_SIZE as u16);
@@ -353,8 +475,7 @@ impl SharedPassiveSocket {
             self.tcp_config.get_rx_checksum_offload(),
         );
         self.layer3_endpoint
-            .transmit_tcp_packet_blocking(dst_ipv4_addr, pkt)
-            .await
+            .transmit_tcp_packet_nonblocking(dst_ipv4_addr, IPV4_ECN_NOT_ECT, pkt)
     }
 
     async fn wait_for_ack(
@@ -366,6 +487,8 @@ impl SharedPassiveSocket {
         header_window_size: u16,
         remote_window_scale: Option<u8>,
         mss: usize,
+        sack_permitted: bool,
+        ecn_capable: bool,
     ) -> Result<EstablishedSocket, Fail> {
         let (ipv4_hdr, tcp_hdr, buf) = recv_queue.pop(None).await?;
         debug!("Received ACK: {:?}", tcp_hdr);
@@ -375,6 +498,35 @@ impl SharedPassiveSocket {
             return Err(Fail::new(EBADMSG, "invalid SYN+ACK seq num"));
         }
 
+        self.establish(
+            recv_queue,
+            remote,
+            local_isn,
+            remote_isn,
+            header_window_size,
+            remote_window_scale,
+            mss,
+            sack_permitted,
+            ecn_capable,
+            (ipv4_hdr, tcp_hdr, buf),
+        )
+    }
+
+    /// Sets up the connection with `remote` once the ACK of its handshake, `ack`, came in. Data that the ACK carries is
+    /// delivered to the connection.
+    fn establish(
+        &self,
+        mut recv_queue: SharedAsyncQueue<(Ipv4Addr, TcpHeader, DemiBuffer)>,
+        remote: SocketAddrV4,
+        local_isn: SeqNumber,
+        remote_isn: SeqNumber,
+        header_window_size: u16,
+        remote_window_scale: Option<u8>,
+        mss: usize,
+        sack_permitted: bool,
+        ecn_capable: bool,
+        ack: (Ipv4Addr, TcpHeader, DemiBuffer),
+    ) -> Result<EstablishedSocket, Fail> {
         // Calculate the window.
         let (local_window_scale, remote_window_scale): (u8, u8) = match remote_window_scale {
             Some(remote_window_scale) => {
@@ -414,8 +566,8 @@ impl SharedPassiveSocket {
         );
 
         // If there is data with the SYN+ACK, deliver it.
-        if !buf.is_empty() {
-            recv_queue.push((ipv4_hdr, tcp_hdr, buf));
+        if !ack.2.is_empty() {
+            recv_queue.push(ack);
         }
 
         let new_socket: EstablishedSocket = EstablishedSocket::new(
@@ -434,7 +586,9 @@ impl SharedPassiveSocket {
             remote_window_size,
             remote_window_scale,
             mss,
-            congestion_control::None::new,
+            sack_permitted,
+            ecn_capable,
+            congestion_control::constructor(self.socket_options.get_congestion_control()),
             None,
         )?;
 
@@ -443,6 +597,8 @@ impl SharedPassiveSocket {
 
     fn complete_handshake(&mut self, remote: SocketAddrV4, result: Result<EstablishedSocket, Fail>) {
         self.connections.remove(&remote);
+        // The handshake had a slot of the ring reserved for it when it started.
+        debug_assert!(self.ready.len() < self.max_backlog);
         self.ready.push((remote, result));
     }
 }
@@ -464,3 +620,290 @@ impl DerefMut for SharedPassiveSocket {
         self.0.deref_mut()
     }
 }
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Returns the window scale, MSS and SACK permitted options of a SYN.
+fn parse_syn_options(tcp_hdr: &TcpHeader) -> (Option<u8>, usize, bool) {
+    let mut remote_window_scale: Option<u8> = None;
+    let mut mss: usize = FALLBACK_MSS;
+    let mut sack_permitted: bool = false;
+    for option in tcp_hdr.iter_options() {
+        match option {
+            TcpOptions2::WindowScale(w) => {
+                info!("Received window scale: {:?}", w);
+                remote_window_scale = Some(*w);
+            },
+            TcpOptions2::SelectiveAcknowlegementPermitted => {
+                info!("Received SACK permitted");
+                sack_permitted = true;
+            },
+            TcpOptions2::MaximumSegmentSize(m) => {
+                info!("Received advertised MSS: {}", m);
+                mss = *m as usize;
+            },
+            _ => continue,
+        }
+    }
+    (remote_window_scale, mss, sack_permitted)
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::{
+        inetstack::{
+            protocols::{
+                layer2::{EtherType2, Ethernet2Header},
+                layer3::{ip::IpProtocol, ipv4::Ipv4Header},
+                layer4::tcp::{
+                    header::{TcpHeader, TcpOptions2},
+                    isn_generator::IsnGenerator,
+                    SeqNumber,
+                },
+                MAX_HEADER_SIZE,
+            },
+            test_helpers::{self, engine::SharedEngine},
+        },
+        runtime::{
+            memory::DemiBuffer,
+            queue::{OperationResult, QDesc, QToken},
+        },
+    };
+    use ::anyhow::Result;
+    use ::std::{
+        net::{Ipv4Addr, SocketAddrV4},
+        time::Instant,
+    };
+
+    /// Port that Bob listens on.
+    const BOB_PORT: u16 = 80;
+    /// Number of times that Bob is polled for a frame or a connection before giving up.
+    const MAX_POLLS: usize = 16;
+
+    /// Makes Bob listen with a backlog of a single connection and fills it with a handshake that keeps state, from
+    /// Carrie's port `port`. Returns the listening socket and the SYN+ACK that Bob answered with.
+    fn listen_with_full_backlog(bob: &mut SharedEngine, port: u16, isn: SeqNumber) -> Result<(QDesc, TcpHeader)> {
+        let qd: QDesc = bob.tcp_socket()?;
+        bob.tcp_bind(qd, SocketAddrV4::new(test_helpers::BOB_IPV4, BOB_PORT))?;
+        bob.tcp_listen(qd, 1)?;
+        let syn_ack: TcpHeader = send_syn(bob, port, isn, 1460)?;
+        Ok((qd, syn_ack))
+    }
+
+    /// Sends a SYN from Carrie's port `port` that offers `mss` and returns the SYN+ACK that Bob answered with.
+    fn send_syn(bob: &mut SharedEngine, port: u16, isn: SeqNumber, mss: u16) -> Result<TcpHeader> {
+        let mut tcp_hdr: TcpHeader = TcpHeader::new(port, BOB_PORT);
+        tcp_hdr.syn = true;
+        tcp_hdr.seq_num = isn;
+        tcp_hdr.window_size = u16::MAX;
+        tcp_hdr.push_option(TcpOptions2::MaximumSegmentSize(mss));
+        bob.push_frame(frame_from_carrie(&tcp_hdr));
+
+        let mut segments: Vec<(TcpHeader, usize)> = segments_from_bob(bob)?;
+        crate::ensure_eq!(segments.len(), 1);
+        let (syn_ack, len): (TcpHeader, usize) = segments.remove(0);
+        crate::ensure_eq!(syn_ack.dst_port, port);
+        crate::ensure_eq!(syn_ack.syn, true);
+        crate::ensure_eq!(syn_ack.ack, true);
+        crate::ensure_eq!(syn_ack.ack_num, isn + SeqNumber::from(1));
+        crate::ensure_eq!(len, 0);
+        Ok(syn_ack)
+    }
+
+    /// Sends the ACK that ends a handshake from Carrie's port `port`.
+    fn send_ack(bob: &mut SharedEngine, port: u16, seq_num: SeqNumber, ack_num: SeqNumber) {
+        let mut tcp_hdr: TcpHeader = TcpHeader::new(port, BOB_PORT);
+        tcp_hdr.ack = true;
+        tcp_hdr.seq_num = seq_num;
+        tcp_hdr.ack_num = ack_num;
+        tcp_hdr.window_size = u16::MAX;
+        bob.push_frame(frame_from_carrie(&tcp_hdr));
+    }
+
+    /// Builds a frame that carries a segment from Carrie to Bob.
+    fn frame_from_carrie(tcp_hdr: &TcpHeader) -> DemiBuffer {
+        let mut pkt: DemiBuffer = DemiBuffer::new_with_headroom(0, MAX_HEADER_SIZE as u16);
+        tcp_hdr.serialize_and_attach(&mut pkt, &test_helpers::CARRIE_IPV4, &test_helpers::BOB_IPV4, false);
+        Ipv4Header::new(test_helpers::CARRIE_IPV4, test_helpers::BOB_IPV4, IpProtocol::TCP)
+            .serialize_and_attach(&mut pkt);
+        Ethernet2Header::new(test_helpers::BOB_MAC, test_helpers::CARRIE_MAC, EtherType2::Ipv4)
+            .serialize_and_attach(&mut pkt);
+        pkt
+    }
+
+    /// Polls Bob and returns the headers of the segments that it sent, along with the length of their payload.
+    fn segments_from_bob(bob: &mut SharedEngine) -> Result<Vec<(TcpHeader, usize)>> {
+        let mut segments: Vec<(TcpHeader, usize)> = Vec::new();
+        for _ in 0..MAX_POLLS {
+            bob.poll();
+            for mut pkt in bob.pop_all_frames() {
+                Ethernet2Header::parse_and_strip(&mut pkt)?;
+                let ipv4_hdr: Ipv4Header = Ipv4Header::parse_and_strip(&mut pkt)?;
+                crate::ensure_eq!(ipv4_hdr.get_dest_addr(), test_helpers::CARRIE_IPV4);
+                let src_ipv4_addr: Ipv4Addr = ipv4_hdr.get_src_addr();
+                let dst_ipv4_addr: Ipv4Addr = ipv4_hdr.get_dest_addr();
+                let tcp_hdr: TcpHeader = TcpHeader::parse_and_strip(&src_ipv4_addr, &dst_ipv4_addr, &mut pkt, true)?;
+                segments.push((tcp_hdr, pkt.len()));
+            }
+        }
+        Ok(segments)
+    }
+
+    /// Polls Bob until the accept `qt` completes and returns the new socket and the address of its peer, if it does.
+    fn poll_accept(bob: &mut SharedEngine, qt: QToken) -> Result<Option<(QDesc, SocketAddrV4)>> {
+        for _ in 0..MAX_POLLS {
+            bob.poll();
+            match bob.get_runtime().get_completed_task(&qt) {
+                Some((_, OperationResult::Accept(accepted))) => return Ok(Some(accepted)),
+                Some((_, result)) => anyhow::bail!("accept should succeed (result={:?})", result),
+                None => continue,
+            }
+        }
+        Ok(None)
+    }
+
+    /// Checks that Bob answers a segment from Carrie's port `port` with a RST and nothing else.
+    fn expect_rst(bob: &mut SharedEngine, port: u16) -> Result<()> {
+        let segments: Vec<(TcpHeader, usize)> = segments_from_bob(bob)?;
+        crate::ensure_eq!(segments.len(), 1);
+        crate::ensure_eq!(segments[0].0.dst_port, port);
+        crate::ensure_eq!(segments[0].0.rst, true);
+        Ok(())
+    }
+
+    /// Checks that a listener with a full backlog answers a SYN with a SYN cookie and that the ACK of the cookie sets up
+    /// a connection with the MSS that the cookie carried and the sequence numbers of the handshake.
+    #[test]
+    fn test_syn_cookie_handshake() -> Result<()> {
+        let now: Instant = Instant::now();
+        let mut bob: SharedEngine = test_helpers::new_bob(now);
+        let first_isn: SeqNumber = SeqNumber::from(1000);
+        let (qd, first_syn_ack): (QDesc, TcpHeader) = listen_with_full_backlog(&mut bob, 49152, first_isn)?;
+
+        // The backlog is full, so this one gets a cookie. Its MSS is rounded down to one that a cookie can carry.
+        let isn: SeqNumber = SeqNumber::from(0xffff_fff0);
+        let syn_ack: TcpHeader = send_syn(&mut bob, 49153, isn, 1300)?;
+        let cookie_mss: usize = 1200;
+
+        // Accept the first connection, which frees its slot of the backlog.
+        let qt: QToken = bob.tcp_accept(qd)?;
+        send_ack(
+            &mut bob,
+            49152,
+            first_isn + SeqNumber::from(1),
+            first_syn_ack.seq_num + SeqNumber::from(1),
+        );
+        let (_, remote): (QDesc, SocketAddrV4) = match poll_accept(&mut bob, qt)? {
+            Some(accepted) => accepted,
+            None => anyhow::bail!("first connection should be accepted"),
+        };
+        crate::ensure_eq!(remote, SocketAddrV4::new(test_helpers::CARRIE_IPV4, 49152));
+
+        // The ACK of the cookie sets up the second connection without Bob having kept any state for it.
+        let qt: QToken = bob.tcp_accept(qd)?;
+        send_ack(
+            &mut bob,
+            49153,
+            isn + SeqNumber::from(1),
+            syn_ack.seq_num + SeqNumber::from(1),
+        );
+        let (accepted_qd, remote): (QDesc, SocketAddrV4) = match poll_accept(&mut bob, qt)? {
+            Some(accepted) => accepted,
+            None => anyhow::bail!("connection of the cookie should be accepted"),
+        };
+        crate::ensure_eq!(remote, SocketAddrV4::new(test_helpers::CARRIE_IPV4, 49153));
+
+        // Data goes out in segments of the MSS of the cookie, right after the sequence numbers of the handshake.
+        bob.tcp_push(accepted_qd, DemiBuffer::new((2 * cookie_mss) as u16))?;
+        let segments: Vec<(TcpHeader, usize)> = segments_from_bob(&mut bob)?;
+        crate::ensure_eq!(segments.len(), 2);
+        for (i, (tcp_hdr, len)) in segments.iter().enumerate() {
+            crate::ensure_eq!(tcp_hdr.dst_port, 49153);
+            crate::ensure_eq!(
+                tcp_hdr.seq_num,
+                syn_ack.seq_num + SeqNumber::from((1 + i * cookie_mss) as u32)
+            );
+            crate::ensure_eq!(tcp_hdr.ack_num, isn + SeqNumber::from(1));
+            crate::ensure_eq!(*len, cookie_mss);
+        }
+
+        Ok(())
+    }
+
+    /// Checks that ACKs with a cookie that was tampered with or that expired are answered with a RST and do not set up
+    /// a connection.
+    #[test]
+    fn test_syn_cookie_rejects_invalid_ack() -> Result<()> {
+        let mut now: Instant = Instant::now();
+        let mut bob: SharedEngine = test_helpers::new_bob(now);
+        let first_isn: SeqNumber = SeqNumber::from(1000);
+        let (qd, first_syn_ack): (QDesc, TcpHeader) = listen_with_full_backlog(&mut bob, 49152, first_isn)?;
+        let isn: SeqNumber = SeqNumber::from(2000);
+        let syn_ack: TcpHeader = send_syn(&mut bob, 49153, isn, 1460)?;
+        let stale_isn: SeqNumber = SeqNumber::from(3000);
+        let stale_syn_ack: TcpHeader = send_syn(&mut bob, 49154, stale_isn, 1460)?;
+
+        // Accept the first connection, so that cookies are not turned down for lack of room in the backlog.
+        let qt: QToken = bob.tcp_accept(qd)?;
+        send_ack(
+            &mut bob,
+            49152,
+            first_isn + SeqNumber::from(1),
+            first_syn_ack.seq_num + SeqNumber::from(1),
+        );
+        if poll_accept(&mut bob, qt)?.is_none() {
+            anyhow::bail!("first connection should be accepted");
+        }
+
+        // A cookie that was tampered with and a cookie for another ISN of our peer do not check out.
+        let qt: QToken = bob.tcp_accept(qd)?;
+        send_ack(
+            &mut bob,
+            49153,
+            isn + SeqNumber::from(1),
+            syn_ack.seq_num + SeqNumber::from(2),
+        );
+        expect_rst(&mut bob, 49153)?;
+        send_ack(
+            &mut bob,
+            49153,
+            isn + SeqNumber::from(2),
+            syn_ack.seq_num + SeqNumber::from(1),
+        );
+        expect_rst(&mut bob, 49153)?;
+        crate::ensure_eq!(poll_accept(&mut bob, qt)?, None);
+
+        // The genuine ACK still sets up the connection.
+        send_ack(
+            &mut bob,
+            49153,
+            isn + SeqNumber::from(1),
+            syn_ack.seq_num + SeqNumber::from(1),
+        );
+        match poll_accept(&mut bob, qt)? {
+            Some((_, remote)) => crate::ensure_eq!(remote, SocketAddrV4::new(test_helpers::CARRIE_IPV4, 49153)),
+            None => anyhow::bail!("connection of the cookie should be accepted"),
+        }
+
+        // A cookie does not check out once it expired.
+        let qt: QToken = bob.tcp_accept(qd)?;
+        now += IsnGenerator::cookie_lifetime();
+        bob.advance_clock(now);
+        send_ack(
+            &mut bob,
+            49154,
+            stale_isn + SeqNumber::from(1),
+            stale_syn_ack.seq_num + SeqNumber::from(1),
+        );
+        expect_rst(&mut bob, 49154)?;
+        crate::ensure_eq!(poll_accept(&mut bob, qt)?, None);
+
+        Ok(())
+    }
+}
@@ -9,13 +9,18 @@ use crate::{
     demikernel::config::Config,
     inetstack::protocols::{
         layer3::SharedLayer3Endpoint,
-        layer4::tcp::{header::TcpHeader, isn_generator::IsnGenerator, socket::SharedTcpSocket, SeqNumber},
+        layer4::{
+            flow_table::{FlowKey, FlowTable},
+            tcp::{header::TcpHeader, isn_generator::IsnGenerator, socket::SharedTcpSocket, SeqNumber},
+        },
     },
+    perftools::stats::{self, Counter},
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
         network::{
             config::TcpConfig,
+            consts::RECEIVE_BATCH_SIZE,
             socket::{
                 option::{SocketOption, TcpSocketOptions},
                 SocketId,
@@ -24,10 +29,12 @@ use crate::{
         SharedDemiRuntime, SharedObject,
     },
 };
+use ::arrayvec::ArrayVec;
 use ::rand::{prelude::SmallRng, Rng, SeedableRng};
 
 use ::std::{
-    collections::HashMap,
+    collections::{hash_map::RandomState, HashMap},
+    hash::{BuildHasher, Hasher},
     net::{Ipv4Addr, SocketAddr, SocketAddrV4},
     ops::{Deref, DerefMut},
 };
@@ -44,7 +51,19 @@ pub struct TcpPeer {
     tcp_config: TcpConfig,
     default_socket_options: TcpSocketOptions,
     rng: SmallRng,
-    addresses: HashMap<SocketId, SharedTcpSocket>,
+    /// Established and connecting sockets, by local and remote address.
+    connections: FlowTable<SharedTcpSocket>,
+    /// Bound and listening sockets, by local address.
+    listeners: HashMap<SocketAddrV4, SharedTcpSocket>,
+}
+
+/// Incoming TCP segment whose header was parsed, along with the hash of its flow.
+struct ParsedSegment {
+    src_ipv4_addr: Ipv4Addr,
+    tcp_hdr: TcpHeader,
+    payload: DemiBuffer,
+    key: FlowKey,
+    hash: u64,
 }
 
 #[derive(Clone)]
@@ -63,15 +82,18 @@ impl SharedTcpPeer {
     ) -> Result<Self, Fail> {
         let mut rng: SmallRng = SmallRng::from_seed(rng_seed);
         let nonce: u32 = rng.gen();
+        // Key the flow table from the entropy of the process, not from the seed, which is fixed and known to everyone.
+        let flow_table_seed: u64 = RandomState::new().build_hasher().finish();
         Ok(Self(SharedObject::<TcpPeer>::new(TcpPeer {
             isn_generator: IsnGenerator::new(nonce),
             runtime,
             layer3_endpoint,
             local_ipv4_addr: config.local_ipv4_addr()?,
-            tcp_config: TcpConfig::new(config)?,
+            tcp_config: TcpConfig::new(config, layer3_endpoint.get_tcp_segmentation_offload())?,
             default_socket_options: TcpSocketOptions::new(config)?,
             rng,
-            addresses: HashMap::<SocketId, SharedTcpSocket>::new(),
+            connections: FlowTable::<SharedTcpSocket>::new(flow_table_seed),
+            listeners: HashMap::<SocketAddrV4, SharedTcpSocket>::new(),
         })))
     }
 
@@ -109,11 +131,11 @@ impl SharedTcpPeer {
         // All other checks should have been done already.
         debug_assert!(!Ipv4Addr::is_unspecified(local.ip()));
         debug_assert!(local.port() != 0);
-        debug_assert!(self.addresses.get(&SocketId::Passive(local)).is_none());
+        debug_assert!(self.listeners.get(&local).is_none());
 
         // Issue operation.
         socket.bind(local)?;
-        self.addresses.insert(SocketId::Passive(local), socket.clone());
+        self.listeners.insert(local, socket.clone());
         Ok(())
     }
 
@@ -130,8 +152,8 @@ impl SharedTcpPeer {
         // Wait for accept to complete.
         match socket.accept().await {
             Ok(socket) => {
-                self.addresses.insert(
-                    SocketId::Active(socket.local().unwrap(), socket.remote().unwrap()),
+                self.connections.insert(
+                    FlowKey::new(socket.local().unwrap(), socket.remote().unwrap()),
                     socket.clone(),
                 );
                 Ok(socket)
@@ -148,12 +170,12 @@ impl SharedTcpPeer {
         remote: SocketAddrV4,
     ) -> Result<(), Fail> {
         // If socket is already bound to a local address, use it but remove the old binding.
-        self.addresses.remove(&SocketId::Passive(local));
+        self.listeners.remove(&local);
         // Insert the connection to receive incoming packets for this address pair.
         // Should we remove the passive entry for the local address if the socket was previously bound?
         if self
-            .addresses
-            .insert(SocketId::Active(local, remote.clone()), socket.clone())
+            .connections
+            .insert(FlowKey::new(local, remote), socket.clone())
             .is_some()
         {
             // We should panic here because the ephemeral port allocator should not allocate the same port more than
@@ -166,7 +188,7 @@ impl SharedTcpPeer {
         let local_isn: SeqNumber = self.isn_generator.generate(&local, &remote);
         // Wait for connect to complete.
         if let Err(e) = socket.connect(local, remote, local_isn).await {
-            self.addresses.remove(&SocketId::Active(local, remote.clone()));
+            self.connections.remove(&FlowKey::new(local, remote));
             Err(e)
         } else {
             Ok(())
@@ -178,7 +200,8 @@ impl SharedTcpPeer {
         // TODO: Remove this copy after merging with the transport trait.
         // Wait for push to complete.
         socket.push(buf.clone()).await?;
-        buf.trim(buf.len())
+        buf.clear();
+        Ok(())
     }
 
     /// Sets up a coroutine for popping data from the socket.
@@ -199,23 +222,54 @@ impl SharedTcpPeer {
         // Wait for close to complete.
         // Handle result: If unsuccessful, free the new queue descriptor.
         if let Some(socket_id) = socket.close().await? {
-            self.addresses.remove(&socket_id);
+            self.remove_socket_id(&socket_id);
         }
         Ok(())
     }
 
     pub fn hard_close(&mut self, socket: &mut SharedTcpSocket) -> Result<(), Fail> {
         if let Some(socket_id) = socket.hard_close()? {
-            self.addresses.remove(&socket_id);
+            self.remove_socket_id(&socket_id);
         }
         Ok(())
     }
 
-    /// Processes an incoming TCP segment.
-    pub fn receive(&mut self, src_ipv4_addr: Ipv4Addr, mut buf: DemiBuffer) {
+    fn remove_socket_id(&mut self, socket_id: &SocketId) {
+        match socket_id {
+            SocketId::Active(local, remote) => {
+                self.connections.remove(&FlowKey::new(*local, *remote));
+            },
+            SocketId::Passive(local) => {
+                self.listeners.remove(local);
+            },
+        }
+    }
+
+    /// Processes a batch of incoming TCP segments, along with whether a router marked each of them with Congestion
+    /// Experienced (RFC 3168). All headers are parsed and the flow table slots of all segments are prefetched before
+    /// the first lookup, so the cache misses of the lookups overlap.
+    pub fn receive_batch(&mut self, batch: ArrayVec<(Ipv4Addr, bool, DemiBuffer), RECEIVE_BATCH_SIZE>) {
+        let mut segments: ArrayVec<ParsedSegment, RECEIVE_BATCH_SIZE> = ArrayVec::new();
+        for (src_ipv4_addr, congestion_experienced, buf) in batch {
+            if let Some(segment) = self.parse(src_ipv4_addr, congestion_experienced, buf) {
+                self.connections.prefetch(segment.hash);
+                segments.push(segment);
+            }
+        }
+        for segment in segments {
+            self.dispatch(segment);
+        }
+    }
+
+    fn parse(
+        &self,
+        src_ipv4_addr: Ipv4Addr,
+        congestion_experienced: bool,
+        mut buf: DemiBuffer,
+    ) -> Option<ParsedSegment> {
         // We can assume that the destination is our local IPv4 address; otherwise, the IP layer would have discarded
         // the packet already.
-        let tcp_hdr: TcpHeader = match TcpHeader::parse_and_strip(
+        let mut tcp_hdr: TcpHeader = match TcpHeader::parse_and_strip(
             &src_ipv4_addr,
             &self.local_ipv4_addr,
             &mut buf,
@@ -225,28 +279,48 @@ impl SharedTcpPeer {
             Err(e) => {
                 let cause: String = format!("invalid tcp header: {:?}", e);
                 error!("receive(): {}", &cause);
-                return;
+                stats::count(Counter::Drops, 1);
+                return None;
             },
         };
+        tcp_hdr.congestion_experienced = congestion_experienced;
         debug!("TCP received {:?}", tcp_hdr);
         let local: SocketAddrV4 = SocketAddrV4::new(self.local_ipv4_addr, tcp_hdr.dst_port);
         let remote: SocketAddrV4 = SocketAddrV4::new(src_ipv4_addr, tcp_hdr.src_port);
+        let key: FlowKey = FlowKey::new(local, remote);
+        let hash: u64 = self.connections.hash(&key);
+        Some(ParsedSegment {
+            src_ipv4_addr,
+            tcp_hdr,
+            payload: buf,
+            key,
+            hash,
+        })
+    }
 
-        // Retrieve the queue descriptor based on the incoming segment.
-        let socket: &mut SharedTcpSocket = match self.addresses.get_mut(&SocketId::Active(local, remote)) {
+    fn dispatch(&mut self, segment: ParsedSegment) {
+        // Retrieve the socket based on the incoming segment.
+        let socket: &mut SharedTcpSocket = match self.connections.get_mut_with_hash(&segment.key, segment.hash) {
             Some(socket) => socket,
-            None => match self.addresses.get_mut(&SocketId::Passive(local)) {
-                Some(socket) => socket,
-                None => {
-                    let cause: String = format!("no queue descriptor for remote address (remote={})", remote.ip());
-                    error!("receive(): {}", &cause);
-                    return;
-                },
+            None => {
+                let local: SocketAddrV4 = SocketAddrV4::new(self.local_ipv4_addr, segment.tcp_hdr.dst_port);
+                match self.listeners.get_mut(&local) {
+                    Some(socket) => socket,
+                    None => {
+                        let cause: String = format!(
+                            "no queue descriptor for remote address (remote={})",
+                            segment.src_ipv4_addr
+                        );
+                        error!("receive(): {}", &cause);
+                        stats::count(Counter::Drops, 1);
+                        return;
+                    },
+                }
             },
         };
 
         // Dispatch to further processing depending on the socket state.
-        socket.receive(src_ipv4_addr, tcp_hdr, buf)
+        socket.receive(segment.src_ipv4_addr, segment.tcp_hdr, segment.payload)
     }
 }
 
@@ -20,7 +20,7 @@ use crate::{
         network::{
             config::TcpConfig,
             socket::{
-                option::{SocketOption, TcpSocketOptions},
+                option::{CongestionControlAlgorithm, SocketOption, TcpSocketOptions},
                 SocketId,
             },
         },
@@ -104,6 +104,20 @@ impl SharedTcpSocket {
             SocketOption::Linger(linger) => self.socket_options.set_linger(linger),
             SocketOption::KeepAlive(keep_alive) => self.socket_options.set_keepalive(keep_alive),
             SocketOption::NoDelay(no_delay) => self.socket_options.set_nodelay(no_delay),
+            SocketOption::CongestionControl(algorithm @ CongestionControlAlgorithm::Kernel(_)) => {
+                let cause: String = format!(
+                    "congestion control algorithm is not implemented (name={:?})",
+                    algorithm.name()
+                );
+                warn!("set_socket_option(): {}", cause);
+                return Err(Fail::new(libc::ENOTSUP, &cause));
+            },
+            SocketOption::CongestionControl(algorithm) => self.socket_options.set_congestion_control(algorithm),
+            SocketOption::Priority(_) => {
+                let cause: &str = "socket priorities are set on the queue, not on the TCP socket";
+                warn!("set_socket_option(): {}", cause);
+                return Err(Fail::new(libc::ENOPROTOOPT, cause));
+            },
         }
         Ok(())
     }
@@ -115,6 +129,14 @@ impl SharedTcpSocket {
             SocketOption::Linger(_) => Ok(SocketOption::Linger(self.socket_options.get_linger())),
             SocketOption::KeepAlive(_) => Ok(SocketOption::KeepAlive(self.socket_options.get_keepalive())),
             SocketOption::NoDelay(_) => Ok(SocketOption::NoDelay(self.socket_options.get_nodelay())),
+            SocketOption::CongestionControl(_) => Ok(SocketOption::CongestionControl(
+                self.socket_options.get_congestion_control(),
+            )),
+            SocketOption::Priority(_) => {
+                let cause: &str = "socket priorities are set on the queue, not on the TCP socket";
+                warn!("get_socket_option(): {}", cause);
+                Err(Fail::new(libc::ENOPROTOOPT, cause))
+            },
         }
     }
 
@@ -6,11 +6,11 @@
 //======================================================================================================================
 
 use crate::{
-    inetstack::protocols::layer3::ip::IpProtocol,
+    inetstack::protocols::{checksum, layer3::ip::IpProtocol},
     runtime::{fail::Fail, memory::DemiBuffer},
 };
 use ::libc::EBADMSG;
-use ::std::{net::Ipv4Addr, slice::ChunksExact};
+use ::std::net::Ipv4Addr;
 
 //======================================================================================================================
 // Constants
@@ -137,7 +137,7 @@ impl UdpHeader {
     /// multiple of two octets.
     ///
     /// TODO: Write a unit test for this function.
-    fn checksum(src_ipv4_addr: &Ipv4Addr, dst_ipv4_addr: &Ipv4Addr, udp_hdr: &[u8], data: &[u8]) -> u16 {
+    pub fn checksum(src_ipv4_addr: &Ipv4Addr, dst_ipv4_addr: &Ipv4Addr, udp_hdr: &[u8], data: &[u8]) -> u16 {
         let mut state: u32 = 0xffff;
 
         // Source address (4 bytes)
@@ -171,15 +171,8 @@ impl UdpHeader {
         // Checksum (2 bytes, all zeros)
         state += 0;
 
-        // Payload.
-        let mut chunks_iter: ChunksExact<u8> = data.chunks_exact(2);
-        while let Some(chunk) = chunks_iter.next() {
-            state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
-        }
-        // Pad with zeros with payload has an odd number of bytes.
-        if let Some(&b) = chunks_iter.remainder().get(0) {
-            state += u16::from_be_bytes([b, 0]) as u32;
-        }
+        // Payload, padded with zeros if it has an odd number of bytes.
+        state += checksum::ones_complement_sum(data) as u32;
 
         // NOTE: We don't need to subtract out 0xFFFF as we accumulate the sum.
         // Since we use a u32 for intermediate state, we would need 2^16
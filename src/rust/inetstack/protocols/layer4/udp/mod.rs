@@ -10,6 +10,7 @@
 pub mod header;
 pub mod peer;
 pub mod socket;
+pub mod template;
 
 #[cfg(test)]
 mod tests;
@@ -11,6 +11,7 @@ use crate::{
         layer3::SharedLayer3Endpoint,
         layer4::udp::{header::UdpHeader, socket::SharedUdpSocket},
     },
+    perftools::stats::{self, Counter},
     runtime::{fail::Fail, memory::DemiBuffer, SharedDemiRuntime, SharedObject},
     timer,
 };
@@ -112,7 +113,8 @@ impl SharedUdpPeer {
         }
         // TODO: Remove copy once we actually use push coroutine for send.
         socket.push(remote, buf.clone()).await?;
-        buf.trim(buf.len())
+        buf.clear();
+        Ok(())
     }
 
     /// Pops data from a socket.
@@ -136,6 +138,7 @@ impl SharedUdpPeer {
                 Err(e) => {
                     let cause: String = format!("dropping packet: unable to parse UDP header");
                     warn!("{}: {:?}", cause, e);
+                    stats::count(Counter::Drops, 1);
                     return;
                 },
             };
@@ -158,6 +161,7 @@ impl SharedUdpPeer {
                         // details.
                         let cause: String = format!("dropping packet: port not bound");
                         warn!("{}: {:?}", cause, local);
+                        stats::count(Counter::Drops, 1);
                         return;
                     },
                 }
@@ -7,10 +7,20 @@
 
 use crate::{
     collections::async_queue::AsyncQueue,
-    inetstack::protocols::{layer3::SharedLayer3Endpoint, layer4::udp::header::UdpHeader},
-    runtime::{fail::Fail, memory::DemiBuffer, network::unwrap_socketaddr, SharedObject},
+    inetstack::protocols::{
+        layer3::SharedLayer3Endpoint,
+        layer4::udp::{header::UdpHeader, template::UdpHeaderTemplate},
+        MAX_HEADER_SIZE,
+    },
+    runtime::{
+        fail::Fail,
+        memory::DemiBuffer,
+        network::{types::MacAddress, unwrap_socketaddr},
+        SharedObject,
+    },
 };
 use ::std::{
+    collections::HashMap,
     fmt::Debug,
     net::{Ipv4Addr, SocketAddr, SocketAddrV4},
     ops::{Deref, DerefMut},
@@ -30,6 +40,10 @@ const RECV_QUEUE_MAX_SIZE: usize = 1024;
 #[allow(dead_code)]
 const SEND_QUEUE_MAX_SIZE: usize = 1024;
 
+// Maximum number of remote endpoints whose header templates a socket keeps. The whole cache is dropped once it fills
+// up, so that sockets that send to many endpoints do not grow it without bound.
+const HEADER_TEMPLATES_MAX_SIZE: usize = 64;
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -42,6 +56,8 @@ pub struct UdpSocket {
     // A queue of incoming packets as remote address and data buffer pairs.
     recv_queue: AsyncQueue<(SocketAddrV4, DemiBuffer)>,
     checksum_offload: bool,
+    // Headers of the datagrams sent to every remote endpoint whose link address was resolved.
+    header_templates: HashMap<SocketAddrV4, UdpHeaderTemplate>,
 }
 #[derive(Clone)]
 pub struct SharedUdpSocket(SharedObject<UdpSocket>);
@@ -62,6 +78,7 @@ impl SharedUdpSocket {
             layer3_endpoint,
             recv_queue: AsyncQueue::<(SocketAddrV4, DemiBuffer)>::default(),
             checksum_offload,
+            header_templates: HashMap::default(),
         })))
     }
 
@@ -86,13 +103,49 @@ impl SharedUdpSocket {
             error!("pushto(): {}", &cause);
             return Err(Fail::new(libc::ENOTSUP, &cause));
         };
+        // A datagram goes out as a single packet, so we gather the segments of a chained buffer into one.
+        if buf.is_multi_segment() {
+            buf = buf.coalesce(MAX_HEADER_SIZE as u16)?;
+        }
+        // Fast path: the link address is already known, so the headers come from the template of the remote endpoint.
+        if let Some(remote_link_addr) = self.layer3_endpoint.try_query_link_addr(*remote.ip()) {
+            let local: SocketAddrV4 = SocketAddrV4::new(self.local_ipv4_addr, port);
+            let checksum_offload: bool = self.checksum_offload;
+            let template: &UdpHeaderTemplate = self.get_header_template(local, remote, remote_link_addr);
+            template.attach(&mut buf, checksum_offload);
+            return self.layer3_endpoint.transmit_frame(buf);
+        }
         let udp_header: UdpHeader = UdpHeader::new(port, remote.port());
         debug!("UDP send {:?}", udp_header);
         udp_header.serialize_and_attach(&mut buf, &self.local_ipv4_addr, remote.ip(), self.checksum_offload);
         // Send the packet to the lower layer.
         self.layer3_endpoint
-            .transmit_udp_packet_blocking(remote.ip().clone(), buf)
-            .await
+            .transmit_udp_packet_nonblocking(remote.ip().clone(), buf)
+    }
+
+    /// Returns the header template for datagrams from `local` to `remote`, building it if there is none yet or if the
+    /// link address of `remote` changed since it was built.
+    fn get_header_template(
+        &mut self,
+        local: SocketAddrV4,
+        remote: SocketAddrV4,
+        remote_link_addr: MacAddress,
+    ) -> &UdpHeaderTemplate {
+        let is_stale: bool = match self.header_templates.get(&remote) {
+            Some(template) => template.remote_link_addr() != remote_link_addr,
+            None => {
+                if self.header_templates.len() >= HEADER_TEMPLATES_MAX_SIZE {
+                    self.header_templates.clear();
+                }
+                true
+            },
+        };
+        if is_stale {
+            let local_link_addr: MacAddress = self.layer3_endpoint.get_local_link_addr();
+            let template: UdpHeaderTemplate = UdpHeaderTemplate::new(local_link_addr, remote_link_addr, local, remote);
+            self.header_templates.insert(remote, template);
+        }
+        &self.header_templates[&remote]
     }
 
     pub async fn pop(&mut self, size: usize) -> Result<(SocketAddrV4, DemiBuffer), Fail> {
@@ -103,7 +156,7 @@ impl SharedUdpSocket {
                     let mut buf: DemiBuffer = msg.1;
                     // We got more bytes than expected, so we trim the buffer.
                     if size < buf.len() {
-                        buf.trim(size - buf.len())?;
+                        buf.trim(buf.len() - size)?;
                     };
                     return Ok((remote, buf));
                 },
@@ -0,0 +1,157 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    inetstack::protocols::{
+        layer2::{EtherType2, Ethernet2Header, ETHERNET2_HEADER_SIZE},
+        layer3::{
+            ip::IpProtocol,
+            ipv4::{Ipv4Header, IPV4_HEADER_MIN_SIZE},
+        },
+        layer4::udp::header::{UdpHeader, UDP_HEADER_SIZE},
+    },
+    runtime::{memory::DemiBuffer, network::types::MacAddress},
+};
+use ::std::net::{Ipv4Addr, SocketAddrV4};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Offset of the IPv4 header in a template.
+const IPV4_HEADER_OFFSET: usize = ETHERNET2_HEADER_SIZE;
+
+/// Offset of the UDP header in a template.
+const UDP_HEADER_OFFSET: usize = IPV4_HEADER_OFFSET + IPV4_HEADER_MIN_SIZE as usize;
+
+/// Size of the Ethernet, IPv4 and UDP headers of a datagram (in bytes).
+pub const UDP_HEADER_TEMPLATE_SIZE: usize = UDP_HEADER_OFFSET + UDP_HEADER_SIZE;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Headers that every datagram from one local endpoint to one remote endpoint starts with. Only the lengths and the
+/// checksums differ from one datagram to the next, so attaching them is a copy followed by a few fixups.
+pub struct UdpHeaderTemplate {
+    /// Link address that the remote IPv4 address resolved to when the template was built.
+    remote_link_addr: MacAddress,
+    local_ipv4_addr: Ipv4Addr,
+    remote_ipv4_addr: Ipv4Addr,
+    bytes: [u8; UDP_HEADER_TEMPLATE_SIZE],
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl UdpHeaderTemplate {
+    /// Builds the headers of datagrams from `local` to `remote`, with the same serializers as the regular send path.
+    pub fn new(
+        local_link_addr: MacAddress,
+        remote_link_addr: MacAddress,
+        local: SocketAddrV4,
+        remote: SocketAddrV4,
+    ) -> Self {
+        let mut buf: DemiBuffer = DemiBuffer::new_with_headroom(0, UDP_HEADER_TEMPLATE_SIZE as u16);
+        UdpHeader::new(local.port(), remote.port()).serialize_and_attach(&mut buf, local.ip(), remote.ip(), true);
+        Ipv4Header::new(*local.ip(), *remote.ip(), IpProtocol::UDP).serialize_and_attach(&mut buf);
+        Ethernet2Header::new(remote_link_addr, local_link_addr, EtherType2::Ipv4).serialize_and_attach(&mut buf);
+
+        let mut bytes: [u8; UDP_HEADER_TEMPLATE_SIZE] = [0; UDP_HEADER_TEMPLATE_SIZE];
+        bytes.copy_from_slice(&buf[..]);
+        Self {
+            remote_link_addr,
+            local_ipv4_addr: *local.ip(),
+            remote_ipv4_addr: *remote.ip(),
+            bytes,
+        }
+    }
+
+    /// Returns the link address that this template sends to.
+    pub fn remote_link_addr(&self) -> MacAddress {
+        self.remote_link_addr
+    }
+
+    /// Prepends the headers to the payload in [buf] and fills in the lengths and checksums, turning it into a frame
+    /// that is ready to be transmitted. Assumes that there is enough headroom for the headers.
+    pub fn attach(&self, buf: &mut DemiBuffer, checksum_offload: bool) {
+        buf.prepend(UDP_HEADER_TEMPLATE_SIZE)
+            .expect("Should have enough headroom");
+        let frame: &mut [u8] = &mut buf[..];
+        let frame_size_bytes: usize = frame.len();
+        frame[..UDP_HEADER_TEMPLATE_SIZE].copy_from_slice(&self.bytes);
+
+        // IPv4 total length and header checksum.
+        let ipv4_header: &mut [u8] = &mut frame[IPV4_HEADER_OFFSET..UDP_HEADER_OFFSET];
+        ipv4_header[2..4].copy_from_slice(&((frame_size_bytes - IPV4_HEADER_OFFSET) as u16).to_be_bytes());
+        let checksum: u16 = Ipv4Header::compute_checksum(ipv4_header);
+        ipv4_header[10..12].copy_from_slice(&checksum.to_be_bytes());
+
+        // UDP length and checksum.
+        let (udp_header, payload): (&mut [u8], &mut [u8]) = frame[UDP_HEADER_OFFSET..].split_at_mut(UDP_HEADER_SIZE);
+        udp_header[4..6].copy_from_slice(&((frame_size_bytes - UDP_HEADER_OFFSET) as u16).to_be_bytes());
+        if !checksum_offload {
+            let checksum: u16 = UdpHeader::checksum(&self.local_ipv4_addr, &self.remote_ipv4_addr, udp_header, payload);
+            udp_header[6..8].copy_from_slice(&checksum.to_be_bytes());
+        }
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::{
+        inetstack::protocols::{
+            layer2::{EtherType2, Ethernet2Header},
+            layer3::{ip::IpProtocol, ipv4::Ipv4Header},
+            layer4::udp::{header::UdpHeader, template::UdpHeaderTemplate},
+            MAX_HEADER_SIZE,
+        },
+        runtime::{memory::DemiBuffer, network::types::MacAddress},
+    };
+    use ::anyhow::Result;
+    use ::std::net::{Ipv4Addr, SocketAddrV4};
+
+    /// Tests if attaching a template yields the same frame as serializing every header, for payloads of several sizes
+    /// and with and without checksum offload.
+    #[test]
+    fn udp_header_template_matches_serializers() -> Result<()> {
+        let local_link_addr: MacAddress = MacAddress::new([0x12, 0x23, 0x45, 0x67, 0x89, 0xab]);
+        let remote_link_addr: MacAddress = MacAddress::new([0xab, 0x89, 0x67, 0x45, 0x23, 0x12]);
+        let local: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 1), 4242);
+        let remote: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 2), 8080);
+        let template: UdpHeaderTemplate = UdpHeaderTemplate::new(local_link_addr, remote_link_addr, local, remote);
+
+        for checksum_offload in [false, true] {
+            for len in [0, 1, 17, 256, 1472] {
+                let payload: Vec<u8> = (0..len).map(|i: usize| i as u8).collect();
+
+                let mut expected: DemiBuffer = DemiBuffer::from_slice_with_headroom(&payload, MAX_HEADER_SIZE)?;
+                UdpHeader::new(local.port(), remote.port()).serialize_and_attach(
+                    &mut expected,
+                    local.ip(),
+                    remote.ip(),
+                    checksum_offload,
+                );
+                Ipv4Header::new(*local.ip(), *remote.ip(), IpProtocol::UDP).serialize_and_attach(&mut expected);
+                Ethernet2Header::new(remote_link_addr, local_link_addr, EtherType2::Ipv4)
+                    .serialize_and_attach(&mut expected);
+
+                let mut frame: DemiBuffer = DemiBuffer::from_slice_with_headroom(&payload, MAX_HEADER_SIZE)?;
+                template.attach(&mut frame, checksum_offload);
+
+                crate::ensure_eq!(&frame[..], &expected[..]);
+            }
+        }
+
+        Ok(())
+    }
+}
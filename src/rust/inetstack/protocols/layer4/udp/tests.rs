@@ -109,6 +109,53 @@ fn udp_push_pop() -> Result<()> {
     Ok(())
 }
 
+/// Tests if back-to-back datagrams of different sizes to the same remote endpoint, whose headers after the first one
+/// come from the header template of the socket, are received intact.
+#[test]
+fn udp_push_pop_many_same_remote() -> Result<()> {
+    let now: Instant = Instant::now();
+
+    // Setup Bob.
+    let mut bob: SharedEngine = test_helpers::new_bob(now);
+    let bob_addr: SocketAddrV4 = SocketAddrV4::new(test_helpers::BOB_IPV4, 80);
+    let bob_fd: QDesc = bob.udp_socket()?;
+    bob.udp_bind(bob_fd, bob_addr)?;
+
+    // Setup Carrie.
+    let mut carrie: SharedEngine = test_helpers::new_carrie(now);
+    let carrie_addr: SocketAddrV4 = SocketAddrV4::new(test_helpers::CARRIE_IPV4, 80);
+    let carrie_fd: QDesc = carrie.udp_socket()?;
+    carrie.udp_bind(carrie_fd, carrie_addr)?;
+
+    for len in [32, 1, 512, 33] {
+        // Send data to Carrie.
+        let buf: DemiBuffer = DemiBuffer::from_slice_with_headroom(&vec![len as u8; len][..], MAX_HEADER_SIZE)
+            .expect("slice should fit in DemiBuffer");
+        let bob_qt: QToken = bob.udp_pushto(bob_fd, buf.clone(), carrie_addr)?;
+        match bob.wait(bob_qt, TIMEOUT_SECONDS)? {
+            (_, OperationResult::Push) => {},
+            _ => anyhow::bail!("Push failed"),
+        };
+
+        // Take a packet from Bob and deliver to Carrie.
+        carrie.push_frame(bob.pop_frame());
+        let carrie_qt: QToken = carrie.udp_pop(carrie_fd)?;
+        let (remote_addr, received_buf): (Option<SocketAddrV4>, DemiBuffer) =
+            match carrie.wait(carrie_qt, TIMEOUT_SECONDS)? {
+                (_, OperationResult::Pop(addr, buf)) => (addr, buf),
+                _ => anyhow::bail!("Pop failed"),
+            };
+        assert_eq!(remote_addr.unwrap(), bob_addr);
+        assert_eq!(received_buf[..], buf[..]);
+    }
+
+    // Close peers.
+    bob.udp_close(bob_fd)?;
+    carrie.udp_close(carrie_fd)?;
+
+    Ok(())
+}
+
 //======================================================================================================================
 // Push & Pop
 //======================================================================================================================
@@ -5,17 +5,12 @@
 // Exports
 //======================================================================================================================
 
+pub mod checksum;
 pub mod layer1;
 pub mod layer2;
 pub mod layer3;
 pub mod layer4;
 
-//======================================================================================================================
-// Imports
-//======================================================================================================================
-
-use ::std::slice::ChunksExact;
-
 //======================================================================================================================
 // Constants
 //======================================================================================================================
@@ -45,21 +40,12 @@ pub enum Protocol {
 /// to turn into a 16-bit element. Also, this may use
 /// an initial value depending on the parameter `"start"`.
 pub fn compute_generic_checksum(buf: &[u8], start: Option<u32>) -> u32 {
-    let mut state: u32 = match start {
+    let state: u32 = match start {
         Some(state) => state,
         None => 0xFFFF,
     };
 
-    let mut chunks_iter: ChunksExact<u8> = buf.chunks_exact(2);
-    while let Some(chunk) = chunks_iter.next() {
-        state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
-    }
-
-    if let Some(&b) = chunks_iter.remainder().get(0) {
-        state += u16::from_be_bytes([b, 0]) as u32;
-    }
-
-    state
+    state + checksum::ones_complement_sum(buf) as u32
 }
 
 /// Folds 32-bit sum into 16-bit checksum value.
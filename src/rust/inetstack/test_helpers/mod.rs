@@ -3,6 +3,7 @@
 
 pub mod engine;
 pub mod physical_layer;
+pub mod replay;
 pub use engine::SharedEngine;
 pub use physical_layer::SharedTestPhysicalLayer;
 
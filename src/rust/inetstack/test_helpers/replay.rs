@@ -0,0 +1,1004 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Packet trace replay.
+//!
+//! A replay feeds the frames of a pcap capture that were sent to one host through a full inetstack that plays that
+//! host, as fast as it can take them, on a virtual clock that follows the timestamps of the capture. It reports how
+//! many packets the stack takes per second, and how many heap allocations and instructions it spends on each one, so
+//! that regressions of the receive path show up without a NIC.
+//!
+//! The stack plays the host at the `local_ipv4_addr` of its configuration, which the `LOCAL_IPV4_ADDR` environment
+//! variable overrides. It listens on every TCP port that the capture opens connections to and binds every UDP port
+//! that the capture sends datagrams to, and it pops everything that arrives, as `tcp-dump` and `udp-dump` do. Frames
+//! that the host sent are not replayed, but the ISNs of its SYN+ACKs are, so that the acknowledgment numbers of the
+//! segments that follow can be rewritten to match the ISNs of the stack. Captures of hosts that open connections
+//! themselves are not supported.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    demikernel::config::Config,
+    inetstack::{
+        protocols::checksum,
+        test_helpers::{engine::SharedEngine, physical_layer::SharedTestPhysicalLayer, ALICE_CONFIG_PATH},
+    },
+    runtime::{
+        fail::Fail, memory::DemiBuffer, network::types::MacAddress, OperationResult, QDesc, QToken, SharedDemiRuntime,
+    },
+};
+use ::std::{
+    alloc::{GlobalAlloc, Layout},
+    cell::Cell,
+    collections::{HashMap, HashSet},
+    fs,
+    net::{Ipv4Addr, SocketAddrV4},
+    num::Wrapping,
+    time::{Duration, Instant},
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Magic numbers of pcap files with timestamps in microseconds and in nanoseconds, as read in the byte order of the
+/// file.
+const PCAP_MAGIC_MICROS: u32 = 0xa1b2c3d4;
+const PCAP_MAGIC_NANOS: u32 = 0xa1b23c4d;
+
+/// Magic number of pcapng files, which are not supported.
+const PCAPNG_MAGIC: u32 = 0x0a0d0d0a;
+
+/// Sizes of the file header and of the record headers of a pcap file.
+const PCAP_HEADER_SIZE: usize = 24;
+const PCAP_RECORD_HEADER_SIZE: usize = 16;
+
+/// Link type of Ethernet captures.
+const LINKTYPE_ETHERNET: u32 = 1;
+
+const ETHERNET2_HEADER_SIZE: usize = 14;
+const ETHERTYPE_IPV4: u16 = 0x0800;
+const ETHERTYPE_ARP: u16 = 0x0806;
+const IPPROTO_TCP: u8 = 6;
+const IPPROTO_UDP: u8 = 17;
+const TCP_FLAG_SYN: u8 = 0x02;
+const TCP_FLAG_ACK: u8 = 0x10;
+
+/// Requests that enable and disable a performance counter.
+#[cfg(target_os = "linux")]
+const PERF_EVENT_IOC_ENABLE: libc::c_ulong = 0x2400;
+#[cfg(target_os = "linux")]
+const PERF_EVENT_IOC_DISABLE: libc::c_ulong = 0x2401;
+
+/// Backlog of the sockets that listen on the ports that the capture opens connections to.
+const LISTEN_BACKLOG: usize = 1024;
+
+//======================================================================================================================
+// Thread local variable
+//======================================================================================================================
+
+thread_local! {
+    /// Number of heap allocations that this thread made so far.
+    static ALLOCATIONS: Cell<u64> = const { Cell::new(0) };
+}
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Allocator that counts the allocations of every thread and hands them to the allocator that it wraps.
+pub struct CountingAllocator<A: GlobalAlloc>(pub A);
+
+/// A frame of a capture.
+pub struct CapturedFrame {
+    /// Time at which the frame was captured, since the Unix epoch.
+    pub timestamp: Duration,
+    pub bytes: Vec<u8>,
+}
+
+/// Results of a replay.
+#[derive(Debug)]
+pub struct ReplayReport {
+    /// Number of frames that were fed to the stack.
+    pub packets: usize,
+    /// Number of bytes that the sockets popped.
+    pub popped_bytes: usize,
+    /// Wall-clock time that the stack took to go through the frames.
+    pub elapsed: Duration,
+    /// Heap allocations during the replay.
+    pub allocations: u64,
+    /// Instructions that were retired in user mode during the replay, if the platform counts them.
+    pub instructions: Option<u64>,
+}
+
+/// Header fields of an IPv4 frame that a replay looks at, and the offset of its transport header.
+struct Ipv4Frame {
+    src_addr: Ipv4Addr,
+    dst_addr: Ipv4Addr,
+    protocol: u8,
+    l4_offset: usize,
+}
+
+/// Sequence spaces of the host in a connection that the capture holds: the ISN that the host picked in the capture and
+/// the one that the stack picked in the replay.
+#[derive(Default)]
+struct Handshake {
+    captured_isn: Option<u32>,
+    replayed_isn: Option<u32>,
+}
+
+/// Operations that the replay keeps going.
+enum Operation {
+    Accept(QDesc),
+    TcpPop(QDesc),
+    UdpPop(QDesc),
+    Close,
+}
+
+/// An operation in flight, and its result once it completed.
+struct InFlight {
+    operation: Operation,
+    result: Option<OperationResult>,
+}
+
+/// Stack that a capture is replayed against, and the sockets that take in its traffic.
+struct Replay {
+    engine: SharedEngine,
+    local_link_addr: MacAddress,
+    local_ipv4_addr: Ipv4Addr,
+    /// Peers whose link addresses the stack was told about.
+    peers: HashSet<Ipv4Addr>,
+    /// Handshakes by remote endpoint and local port.
+    handshakes: HashMap<(SocketAddrV4, u16), Handshake>,
+    /// Ports on which the stack listens for TCP connections or receives UDP datagrams.
+    tcp_ports: HashSet<u16>,
+    udp_ports: HashSet<u16>,
+    /// Operations in flight.
+    operations: HashMap<QToken, InFlight>,
+    /// Operations that were issued while going through the ones that completed, reused across frames.
+    reissued: Vec<(QToken, Operation)>,
+    popped_bytes: usize,
+}
+
+/// Accumulates the wall-clock time, heap allocations and instructions of the stack while it takes frames, leaving out
+/// what the replay does in between.
+struct Meter {
+    elapsed: Duration,
+    allocations: u64,
+    #[cfg(target_os = "linux")]
+    counter: Option<InstructionCounter>,
+    resumed_at: Instant,
+    allocations_at_resume: u64,
+}
+
+/// Counter of the instructions that the calling thread retires in user mode.
+#[cfg(target_os = "linux")]
+struct InstructionCounter(libc::c_int);
+
+/// Attributes of a performance counter, as they were in the first version of `perf_event_open()`.
+#[cfg(target_os = "linux")]
+#[repr(C)]
+struct PerfEventAttr {
+    typ: u32,
+    size: u32,
+    config: u64,
+    sample_period: u64,
+    sample_type: u64,
+    read_format: u64,
+    flags: u64,
+    wakeup_events: u32,
+    bp_type: u32,
+    config1: u64,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl ReplayReport {
+    /// Formats the report as the results of a benchmark run, which `tools/benchmark.py compare` takes. The run is
+    /// called `name`.
+    pub fn to_json(&self, name: &str) -> String {
+        let packets: f64 = self.packets.max(1) as f64;
+        let mut metrics: String = format!(
+            "\"packets_per_sec\": {:.0}, \"allocations_per_packet\": {:.3}",
+            self.packets as f64 / self.elapsed.as_secs_f64().max(f64::MIN_POSITIVE),
+            self.allocations as f64 / packets
+        );
+        if let Some(instructions) = self.instructions {
+            metrics.push_str(&format!(
+                ", \"instructions_per_packet\": {:.0}",
+                instructions as f64 / packets
+            ));
+        }
+        format!(
+            "{{\"libos\": \"inetstack\", \"results\": [{{\"name\": \"replay-{}\", \"n\": {}, \"metrics\": {{{}}}}}]}}",
+            name, self.packets, metrics
+        )
+    }
+}
+
+impl Replay {
+    fn new(now: Instant) -> Result<Self, Fail> {
+        let config: Config = Config::new(ALICE_CONFIG_PATH.to_string())?;
+        let network: SharedTestPhysicalLayer = SharedTestPhysicalLayer::new_test(now);
+        Ok(Self {
+            engine: SharedEngine::new(ALICE_CONFIG_PATH, network, now)?,
+            local_link_addr: config.local_link_addr()?,
+            local_ipv4_addr: config.local_ipv4_addr()?,
+            peers: HashSet::new(),
+            handshakes: HashMap::new(),
+            tcp_ports: HashSet::new(),
+            udp_ports: HashSet::new(),
+            operations: HashMap::new(),
+            reissued: Vec::new(),
+            popped_bytes: 0,
+        })
+    }
+
+    /// Prepares `frame` to be fed to the stack if the host received it. Returns the buffer that the stack should take,
+    /// or `None` if the frame is not replayed.
+    fn prepare(&mut self, frame: &[u8]) -> Result<Option<DemiBuffer>, Fail> {
+        let ipv4: Ipv4Frame = match parse_ipv4(frame) {
+            Some(ipv4) => ipv4,
+            None => return Ok(None),
+        };
+        if ipv4.src_addr == self.local_ipv4_addr {
+            self.learn_captured_isn(frame, &ipv4);
+            return Ok(None);
+        }
+        if ipv4.dst_addr != self.local_ipv4_addr {
+            return Ok(None);
+        }
+
+        // The capture may have been taken before the peer was resolved, or on a host that did not need to, so hand the
+        // stack the link address of every new peer first.
+        if self.peers.insert(ipv4.src_addr) {
+            let remote_link_addr: MacAddress = MacAddress::from_bytes(&frame[6..12]);
+            self.engine.push_frame(self.arp_reply(remote_link_addr, ipv4.src_addr));
+        }
+
+        // Rewrite the frame in the buffer that the stack takes, as a NIC would have written it there.
+        let mut buf: DemiBuffer = DemiBuffer::from_slice(frame)?;
+        buf[0..6].copy_from_slice(&self.local_link_addr.octets());
+        match ipv4.protocol {
+            IPPROTO_TCP => self.prepare_tcp(&mut buf, &ipv4)?,
+            IPPROTO_UDP => self.prepare_udp(&buf, &ipv4)?,
+            _ => (),
+        }
+        Ok(Some(buf))
+    }
+
+    /// Goes through what the stack did with the last frame that it took.
+    fn settle(&mut self) -> Result<(), Fail> {
+        self.learn_replayed_isns();
+        self.complete_operations()
+    }
+
+    /// Opens a listening socket for connections to new ports and rewrites the acknowledgment number of a segment that
+    /// the host received, from the sequence space of the host in the capture to that of the stack.
+    fn prepare_tcp(&mut self, frame: &mut [u8], ipv4: &Ipv4Frame) -> Result<(), Fail> {
+        let tcp: &mut [u8] = match frame.get_mut(ipv4.l4_offset..ipv4.l4_offset + 20) {
+            Some(tcp) => tcp,
+            None => return Ok(()),
+        };
+        let src_port: u16 = u16::from_be_bytes([tcp[0], tcp[1]]);
+        let dst_port: u16 = u16::from_be_bytes([tcp[2], tcp[3]]);
+        let flags: u8 = tcp[13];
+
+        if flags & (TCP_FLAG_SYN | TCP_FLAG_ACK) == TCP_FLAG_SYN && self.tcp_ports.insert(dst_port) {
+            let qd: QDesc = self.engine.tcp_socket()?;
+            self.engine
+                .tcp_bind(qd, SocketAddrV4::new(self.local_ipv4_addr, dst_port))?;
+            self.engine.tcp_listen(qd, LISTEN_BACKLOG)?;
+            let qt: QToken = self.engine.tcp_accept(qd)?;
+            self.operations.insert(qt, InFlight::new(Operation::Accept(qd)));
+        }
+
+        if flags & TCP_FLAG_ACK != 0 {
+            let remote: SocketAddrV4 = SocketAddrV4::new(ipv4.src_addr, src_port);
+            if let Some(Handshake {
+                captured_isn: Some(captured_isn),
+                replayed_isn: Some(replayed_isn),
+            }) = self.handshakes.get(&(remote, dst_port))
+            {
+                let ack_num: u32 = u32::from_be_bytes([tcp[8], tcp[9], tcp[10], tcp[11]]);
+                let rewritten: u32 = (Wrapping(ack_num) - Wrapping(*captured_isn) + Wrapping(*replayed_isn)).0;
+                tcp[8..12].copy_from_slice(&rewritten.to_be_bytes());
+                let old_checksum: u16 = u16::from_be_bytes([tcp[16], tcp[17]]);
+                let new_checksum: u16 = checksum::update32(old_checksum, ack_num, rewritten);
+                tcp[16..18].copy_from_slice(&new_checksum.to_be_bytes());
+            }
+        }
+        Ok(())
+    }
+
+    /// Binds a socket to new ports that datagrams are sent to.
+    fn prepare_udp(&mut self, frame: &[u8], ipv4: &Ipv4Frame) -> Result<(), Fail> {
+        let udp: &[u8] = match frame.get(ipv4.l4_offset..ipv4.l4_offset + 8) {
+            Some(udp) => udp,
+            None => return Ok(()),
+        };
+        let dst_port: u16 = u16::from_be_bytes([udp[2], udp[3]]);
+        if self.udp_ports.insert(dst_port) {
+            let qd: QDesc = self.engine.udp_socket()?;
+            self.engine
+                .udp_bind(qd, SocketAddrV4::new(self.local_ipv4_addr, dst_port))?;
+            let qt: QToken = self.engine.udp_pop(qd)?;
+            self.operations.insert(qt, InFlight::new(Operation::UdpPop(qd)));
+        }
+        Ok(())
+    }
+
+    /// Remembers the ISN of a SYN+ACK that the host sent in the capture.
+    fn learn_captured_isn(&mut self, frame: &[u8], ipv4: &Ipv4Frame) {
+        if let Some((remote, local_port, isn)) = parse_syn_ack(frame, ipv4) {
+            self.handshakes.entry((remote, local_port)).or_default().captured_isn = Some(isn);
+        }
+    }
+
+    /// Remembers the ISNs of the SYN+ACKs that the stack sent, and drops everything that it sent.
+    fn learn_replayed_isns(&mut self) {
+        for frame in self.engine.pop_all_frames() {
+            if let Some(ipv4) = parse_ipv4(&frame) {
+                if let Some((remote, local_port, isn)) = parse_syn_ack(&frame, &ipv4) {
+                    self.handshakes.entry((remote, local_port)).or_default().replayed_isn = Some(isn);
+                }
+            }
+        }
+    }
+
+    /// Takes the results of the operations that completed and keeps the sockets going: listening sockets accept the
+    /// next connection, and connected sockets pop again until the peer closes them.
+    fn complete_operations(&mut self) -> Result<(), Fail> {
+        let mut runtime: SharedDemiRuntime = self.engine.get_runtime();
+        let completed = self
+            .operations
+            .extract_if(|qt: &QToken, in_flight: &mut InFlight| -> bool {
+                in_flight.result = runtime.get_completed_task(qt).map(|(_, result)| result);
+                in_flight.result.is_some()
+            });
+        for (_, in_flight) in completed {
+            let result: OperationResult = in_flight.result.expect("operation should have completed");
+            match (in_flight.operation, result) {
+                (Operation::Accept(qd), OperationResult::Accept((new_qd, _))) => {
+                    let qt: QToken = self.engine.tcp_accept(qd)?;
+                    self.reissued.push((qt, Operation::Accept(qd)));
+                    let qt: QToken = self.engine.tcp_pop(new_qd)?;
+                    self.reissued.push((qt, Operation::TcpPop(new_qd)));
+                },
+                (Operation::TcpPop(qd), OperationResult::Pop(_, buf)) if buf.len() > 0 => {
+                    self.popped_bytes += buf.len();
+                    let qt: QToken = self.engine.tcp_pop(qd)?;
+                    self.reissued.push((qt, Operation::TcpPop(qd)));
+                },
+                (Operation::TcpPop(qd), OperationResult::Pop(_, _)) => {
+                    let qt: QToken = self.engine.tcp_async_close(qd)?;
+                    self.reissued.push((qt, Operation::Close));
+                },
+                (Operation::UdpPop(qd), OperationResult::Pop(_, buf)) => {
+                    self.popped_bytes += buf.len();
+                    let qt: QToken = self.engine.udp_pop(qd)?;
+                    self.reissued.push((qt, Operation::UdpPop(qd)));
+                },
+                (_, OperationResult::Failed(e)) => debug!("complete_operations(): operation failed: {:?}", e),
+                _ => (),
+            }
+        }
+        for (qt, operation) in self.reissued.drain(..) {
+            self.operations.insert(qt, InFlight::new(operation));
+        }
+        Ok(())
+    }
+
+    /// Builds an ARP reply that tells the stack that `remote_ipv4_addr` is at `remote_link_addr`.
+    fn arp_reply(&self, remote_link_addr: MacAddress, remote_ipv4_addr: Ipv4Addr) -> DemiBuffer {
+        let mut frame: Vec<u8> = Vec::with_capacity(ETHERNET2_HEADER_SIZE + 28);
+        frame.extend_from_slice(&self.local_link_addr.octets());
+        frame.extend_from_slice(&remote_link_addr.octets());
+        frame.extend_from_slice(&ETHERTYPE_ARP.to_be_bytes());
+        // Ethernet, IPv4, address lengths and reply.
+        frame.extend_from_slice(&[0, 1, 0x08, 0x00, 6, 4, 0, 2]);
+        frame.extend_from_slice(&remote_link_addr.octets());
+        frame.extend_from_slice(&remote_ipv4_addr.octets());
+        frame.extend_from_slice(&self.local_link_addr.octets());
+        frame.extend_from_slice(&self.local_ipv4_addr.octets());
+        DemiBuffer::from_slice(&frame).expect("ARP reply should fit in a buffer")
+    }
+}
+
+impl InFlight {
+    fn new(operation: Operation) -> Self {
+        Self {
+            operation,
+            result: None,
+        }
+    }
+}
+
+impl Meter {
+    /// Creates a meter that is paused.
+    fn new() -> Self {
+        Self {
+            elapsed: Duration::ZERO,
+            allocations: 0,
+            #[cfg(target_os = "linux")]
+            counter: InstructionCounter::open(),
+            resumed_at: Instant::now(),
+            allocations_at_resume: 0,
+        }
+    }
+
+    fn resume(&mut self) {
+        #[cfg(target_os = "linux")]
+        if let Some(counter) = self.counter.as_ref() {
+            counter.resume();
+        }
+        self.allocations_at_resume = allocations();
+        self.resumed_at = Instant::now();
+    }
+
+    fn pause(&mut self) {
+        self.elapsed += self.resumed_at.elapsed();
+        self.allocations += allocations() - self.allocations_at_resume;
+        #[cfg(target_os = "linux")]
+        if let Some(counter) = self.counter.as_ref() {
+            counter.pause();
+        }
+    }
+
+    /// Returns how many instructions were retired while the meter ran, if the platform counts them.
+    fn instructions(self) -> Option<u64> {
+        #[cfg(target_os = "linux")]
+        return self.counter.and_then(InstructionCounter::stop);
+        #[cfg(not(target_os = "linux"))]
+        return None;
+    }
+}
+
+#[cfg(target_os = "linux")]
+impl InstructionCounter {
+    /// Opens a counter that is paused, or returns `None` if the kernel does not let this process count instructions.
+    fn open() -> Option<Self> {
+        const PERF_TYPE_HARDWARE: u32 = 0;
+        const PERF_COUNT_HW_INSTRUCTIONS: u64 = 1;
+        const PERF_ATTR_SIZE_VER0: u32 = 64;
+        // disabled, exclude_kernel and exclude_hv.
+        const FLAGS: u64 = (1 << 0) | (1 << 5) | (1 << 6);
+        const PERF_EVENT_IOC_RESET: libc::c_ulong = 0x2403;
+
+        let attr: PerfEventAttr = PerfEventAttr {
+            typ: PERF_TYPE_HARDWARE,
+            size: PERF_ATTR_SIZE_VER0,
+            config: PERF_COUNT_HW_INSTRUCTIONS,
+            sample_period: 0,
+            sample_type: 0,
+            read_format: 0,
+            flags: FLAGS,
+            wakeup_events: 0,
+            bp_type: 0,
+            config1: 0,
+        };
+        // Count this thread, on any CPU.
+        let fd: libc::c_long = unsafe {
+            libc::syscall(
+                libc::SYS_perf_event_open,
+                &attr as *const PerfEventAttr,
+                0 as libc::pid_t,
+                -1 as libc::c_int,
+                -1 as libc::c_int,
+                0 as libc::c_ulong,
+            )
+        };
+        if fd < 0 {
+            warn!("InstructionCounter::open(): cannot count instructions (perf_event_paranoid may forbid it)");
+            return None;
+        }
+        let counter: Self = Self(fd as libc::c_int);
+        unsafe {
+            libc::ioctl(counter.0, PERF_EVENT_IOC_RESET, 0);
+        }
+        Some(counter)
+    }
+
+    fn resume(&self) {
+        unsafe { libc::ioctl(self.0, PERF_EVENT_IOC_ENABLE, 0) };
+    }
+
+    fn pause(&self) {
+        unsafe { libc::ioctl(self.0, PERF_EVENT_IOC_DISABLE, 0) };
+    }
+
+    /// Closes the counter and returns how many instructions it counted.
+    fn stop(self) -> Option<u64> {
+        let mut count: u64 = 0;
+        let nbytes: isize = unsafe { libc::read(self.0, &mut count as *mut u64 as *mut libc::c_void, 8) };
+        if nbytes == 8 {
+            Some(count)
+        } else {
+            None
+        }
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+unsafe impl<A: GlobalAlloc> GlobalAlloc for CountingAllocator<A> {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        count_allocation();
+        self.0.alloc(layout)
+    }
+
+    unsafe fn alloc_zeroed(&self, layout: Layout) -> *mut u8 {
+        count_allocation();
+        self.0.alloc_zeroed(layout)
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        count_allocation();
+        self.0.realloc(ptr, layout, new_size)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        self.0.dealloc(ptr, layout)
+    }
+}
+
+#[cfg(target_os = "linux")]
+impl Drop for InstructionCounter {
+    fn drop(&mut self) {
+        unsafe { libc::close(self.0) };
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Returns how many heap allocations the calling thread made so far.
+pub fn allocations() -> u64 {
+    ALLOCATIONS.try_with(|count: &Cell<u64>| count.get()).unwrap_or(0)
+}
+
+fn count_allocation() {
+    // The counter is gone while the thread is torn down.
+    let _ = ALLOCATIONS.try_with(|count: &Cell<u64>| count.set(count.get() + 1));
+}
+
+/// Reads the frames of the pcap capture in the file at `path`.
+pub fn read_pcap_file(path: &str) -> Result<Vec<CapturedFrame>, Fail> {
+    match fs::read(path) {
+        Ok(bytes) => read_pcap(&bytes),
+        Err(e) => {
+            let cause: String = format!("cannot read capture (path={:?}, error={:?})", path, e);
+            error!("read_pcap_file(): {}", cause);
+            Err(Fail::new(libc::ENOENT, &cause))
+        },
+    }
+}
+
+/// Parses a pcap capture of Ethernet frames, in either byte order and with timestamps in microseconds or nanoseconds.
+/// Frames that were truncated when they were captured are skipped.
+pub fn read_pcap(bytes: &[u8]) -> Result<Vec<CapturedFrame>, Fail> {
+    if bytes.len() < PCAP_HEADER_SIZE {
+        let cause: String = format!("capture too short (len={:?})", bytes.len());
+        error!("read_pcap(): {}", cause);
+        return Err(Fail::new(libc::EINVAL, &cause));
+    }
+
+    let magic: u32 = u32::from_le_bytes([bytes[0], bytes[1], bytes[2], bytes[3]]);
+    let (big_endian, nanos): (bool, bool) = match magic {
+        PCAP_MAGIC_MICROS => (false, false),
+        PCAP_MAGIC_NANOS => (false, true),
+        _ if magic.swap_bytes() == PCAP_MAGIC_MICROS => (true, false),
+        _ if magic.swap_bytes() == PCAP_MAGIC_NANOS => (true, true),
+        PCAPNG_MAGIC => {
+            let cause: &str = "pcapng captures are not supported, convert them with editcap -F pcap";
+            error!("read_pcap(): {}", cause);
+            return Err(Fail::new(libc::ENOTSUP, cause));
+        },
+        _ => {
+            let cause: String = format!("not a pcap capture (magic={:#x})", magic);
+            error!("read_pcap(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        },
+    };
+    let read_u32 = |offset: usize| -> u32 {
+        let word: [u8; 4] = bytes[offset..offset + 4].try_into().unwrap();
+        if big_endian {
+            u32::from_be_bytes(word)
+        } else {
+            u32::from_le_bytes(word)
+        }
+    };
+
+    let linktype: u32 = read_u32(20);
+    if linktype != LINKTYPE_ETHERNET {
+        let cause: String = format!("only Ethernet captures are supported (linktype={:?})", linktype);
+        error!("read_pcap(): {}", cause);
+        return Err(Fail::new(libc::ENOTSUP, &cause));
+    }
+
+    let mut frames: Vec<CapturedFrame> = Vec::new();
+    let mut offset: usize = PCAP_HEADER_SIZE;
+    while offset + PCAP_RECORD_HEADER_SIZE <= bytes.len() {
+        let secs: u32 = read_u32(offset);
+        let frac: u32 = read_u32(offset + 4);
+        let captured_len: usize = read_u32(offset + 8) as usize;
+        let original_len: usize = read_u32(offset + 12) as usize;
+        offset += PCAP_RECORD_HEADER_SIZE;
+        if offset + captured_len > bytes.len() {
+            warn!("read_pcap(): capture ends in the middle of a frame");
+            break;
+        }
+        if captured_len == original_len {
+            let subsec: Duration = if nanos {
+                Duration::from_nanos(frac as u64)
+            } else {
+                Duration::from_micros(frac as u64)
+            };
+            frames.push(CapturedFrame {
+                timestamp: Duration::from_secs(secs as u64) + subsec,
+                bytes: bytes[offset..offset + captured_len].to_vec(),
+            });
+        }
+        offset += captured_len;
+    }
+    Ok(frames)
+}
+
+/// Replays `frames` through a stack, on a virtual clock that starts at the timestamp of the first frame and moves with
+/// the timestamps of the frames.
+pub fn replay(frames: &[CapturedFrame]) -> Result<ReplayReport, Fail> {
+    let start: Instant = Instant::now();
+    let mut replay: Replay = Replay::new(start)?;
+    let first_timestamp: Duration = frames
+        .first()
+        .map_or(Duration::ZERO, |frame: &CapturedFrame| frame.timestamp);
+    let mut clock: Duration = Duration::ZERO;
+    let mut packets: usize = 0;
+
+    // Only the time that the stack takes to process the frames is metered, not the parsing and rewriting of the
+    // frames, nor going through the results of the operations and the frames that the stack sent.
+    let mut meter: Meter = Meter::new();
+    for frame in frames {
+        // Captures that were merged from several interfaces may go back in time a little.
+        let timestamp: Duration = frame.timestamp.saturating_sub(first_timestamp);
+        if timestamp > clock {
+            clock = timestamp;
+            replay.engine.advance_clock(start + clock);
+        }
+        let buf: DemiBuffer = match replay.prepare(&frame.bytes)? {
+            Some(buf) => buf,
+            None => continue,
+        };
+        meter.resume();
+        replay.engine.push_frame(buf);
+        meter.pause();
+        replay.settle()?;
+        packets += 1;
+    }
+
+    let elapsed: Duration = meter.elapsed;
+    let allocations: u64 = meter.allocations;
+    let instructions: Option<u64> = meter.instructions();
+
+    Ok(ReplayReport {
+        packets,
+        popped_bytes: replay.popped_bytes,
+        elapsed,
+        allocations,
+        instructions,
+    })
+}
+
+/// Parses the Ethernet and IPv4 headers of `frame`, if it carries an IPv4 packet.
+fn parse_ipv4(frame: &[u8]) -> Option<Ipv4Frame> {
+    let ethertype: u16 = u16::from_be_bytes(frame.get(12..14)?.try_into().ok()?);
+    let ip: &[u8] = frame.get(ETHERNET2_HEADER_SIZE..ETHERNET2_HEADER_SIZE + 20)?;
+    if ethertype != ETHERTYPE_IPV4 || ip[0] >> 4 != 4 {
+        return None;
+    }
+    Some(Ipv4Frame {
+        src_addr: Ipv4Addr::new(ip[12], ip[13], ip[14], ip[15]),
+        dst_addr: Ipv4Addr::new(ip[16], ip[17], ip[18], ip[19]),
+        protocol: ip[9],
+        l4_offset: ETHERNET2_HEADER_SIZE + (ip[0] & 0xf) as usize * 4,
+    })
+}
+
+/// Parses a SYN+ACK in `frame`, returning its destination, its source port and its sequence number.
+fn parse_syn_ack(frame: &[u8], ipv4: &Ipv4Frame) -> Option<(SocketAddrV4, u16, u32)> {
+    let tcp: &[u8] = frame.get(ipv4.l4_offset..ipv4.l4_offset + 20)?;
+    if ipv4.protocol != IPPROTO_TCP || tcp[13] & (TCP_FLAG_SYN | TCP_FLAG_ACK) != TCP_FLAG_SYN | TCP_FLAG_ACK {
+        return None;
+    }
+    let src_port: u16 = u16::from_be_bytes([tcp[0], tcp[1]]);
+    let dst_port: u16 = u16::from_be_bytes([tcp[2], tcp[3]]);
+    let seq_num: u32 = u32::from_be_bytes([tcp[4], tcp[5], tcp[6], tcp[7]]);
+    Some((SocketAddrV4::new(ipv4.dst_addr, dst_port), src_port, seq_num))
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::{
+        inetstack::{
+            protocols::{
+                layer2::{EtherType2, Ethernet2Header},
+                layer3::{ip::IpProtocol, ipv4::Ipv4Header},
+                layer4::{tcp::header::TcpHeader, udp::header::UdpHeader},
+                MAX_HEADER_SIZE,
+            },
+            test_helpers::{
+                self,
+                replay::{read_pcap, read_pcap_file, replay, CapturedFrame, ReplayReport},
+            },
+        },
+        runtime::memory::DemiBuffer,
+        MacAddress,
+    };
+    use ::anyhow::Result;
+    use ::std::{
+        env,
+        net::{Ipv4Addr, SocketAddrV4},
+        path::Path,
+        time::Duration,
+    };
+
+    /// Writes `frames` as a little-endian pcap capture with timestamps in microseconds.
+    fn write_pcap(frames: &[CapturedFrame]) -> Vec<u8> {
+        let mut bytes: Vec<u8> = Vec::new();
+        for word in [0xa1b2c3d4u32, 0x00040002, 0, 0, 65535, 1] {
+            bytes.extend_from_slice(&word.to_le_bytes());
+        }
+        for frame in frames {
+            for word in [
+                frame.timestamp.as_secs() as u32,
+                frame.timestamp.subsec_micros(),
+                frame.bytes.len() as u32,
+                frame.bytes.len() as u32,
+            ] {
+                bytes.extend_from_slice(&word.to_le_bytes());
+            }
+            bytes.extend_from_slice(&frame.bytes);
+        }
+        bytes
+    }
+
+    /// Builds a frame that carries `payload` in `l4_header` from `src` to `dst`.
+    fn build_frame(
+        src: (MacAddress, Ipv4Addr),
+        dst: (MacAddress, Ipv4Addr),
+        protocol: IpProtocol,
+        l4_header: impl FnOnce(&mut DemiBuffer),
+        payload: &[u8],
+    ) -> Vec<u8> {
+        let mut buf: DemiBuffer = DemiBuffer::from_slice_with_headroom(payload, MAX_HEADER_SIZE).unwrap();
+        l4_header(&mut buf);
+        Ipv4Header::new(src.1, dst.1, protocol).serialize_and_attach(&mut buf);
+        Ethernet2Header::new(dst.0, src.0, EtherType2::Ipv4).serialize_and_attach(&mut buf);
+        buf[..].to_vec()
+    }
+
+    fn build_tcp_frame(
+        src: (MacAddress, SocketAddrV4),
+        dst: (MacAddress, SocketAddrV4),
+        seq_num: u32,
+        ack_num: Option<u32>,
+        syn: bool,
+        fin: bool,
+        payload: &[u8],
+    ) -> Vec<u8> {
+        let mut header: TcpHeader = TcpHeader::new(src.1.port(), dst.1.port());
+        header.seq_num = seq_num.into();
+        header.ack_num = ack_num.unwrap_or(0).into();
+        header.ack = ack_num.is_some();
+        header.syn = syn;
+        header.fin = fin;
+        header.window_size = 65535;
+        build_frame(
+            (src.0, *src.1.ip()),
+            (dst.0, *dst.1.ip()),
+            IpProtocol::TCP,
+            |buf: &mut DemiBuffer| header.serialize_and_attach(buf, src.1.ip(), dst.1.ip(), false),
+            payload,
+        )
+    }
+
+    /// Checks that captures are read in both byte orders and with both timestamp resolutions, and that other formats are
+    /// rejected.
+    #[test]
+    fn test_replay_read_pcap() -> Result<()> {
+        let frames: Vec<CapturedFrame> = vec![
+            CapturedFrame {
+                timestamp: Duration::new(1, 2000),
+                bytes: vec![1, 2, 3],
+            },
+            CapturedFrame {
+                timestamp: Duration::new(3, 4000),
+                bytes: vec![4; 60],
+            },
+        ];
+        let little_endian: Vec<u8> = write_pcap(&frames);
+
+        // Swap the byte order of every header, and switch the magic number to the one of nanosecond timestamps.
+        let mut big_endian: Vec<u8> = little_endian.clone();
+        for (i, word) in big_endian[..24].chunks_mut(4).enumerate() {
+            if i != 1 {
+                word.reverse();
+            }
+        }
+        big_endian[0..4].copy_from_slice(&0xa1b23c4du32.to_be_bytes());
+        let mut offset: usize = 24;
+        for frame in &frames {
+            for word in big_endian[offset..offset + 16].chunks_mut(4) {
+                word.reverse();
+            }
+            offset += 16 + frame.bytes.len();
+        }
+
+        for (bytes, nanos_per_unit) in [(little_endian, 1000), (big_endian, 1)] {
+            let read: Vec<CapturedFrame> = read_pcap(&bytes)?;
+            crate::ensure_eq!(read.len(), frames.len());
+            for (read, frame) in read.iter().zip(frames.iter()) {
+                crate::ensure_eq!(
+                    read.timestamp,
+                    Duration::new(
+                        frame.timestamp.as_secs(),
+                        frame.timestamp.subsec_micros() * nanos_per_unit
+                    )
+                );
+                crate::ensure_eq!(read.bytes, frame.bytes);
+            }
+        }
+
+        // pcapng and captures of other link types.
+        crate::ensure_eq!(
+            read_pcap(&[0x0a, 0x0d, 0x0d, 0x0a].repeat(6)).err().unwrap().errno,
+            libc::ENOTSUP
+        );
+        let mut raw_ip: Vec<u8> = write_pcap(&frames);
+        raw_ip[20..24].copy_from_slice(&101u32.to_le_bytes());
+        crate::ensure_eq!(read_pcap(&raw_ip).err().unwrap().errno, libc::ENOTSUP);
+
+        Ok(())
+    }
+
+    /// Checks that a replay delivers the datagrams that the host received, and skips the ones that it sent.
+    #[test]
+    fn test_replay_udp_capture() -> Result<()> {
+        const NUM_DATAGRAMS: usize = 100;
+        let local: SocketAddrV4 = SocketAddrV4::new(test_helpers::ALICE_IPV4, 8080);
+        let remote: SocketAddrV4 = SocketAddrV4::new(test_helpers::BOB_IPV4, 4242);
+        let payload: [u8; 100] = [0xab; 100];
+
+        let mut frames: Vec<CapturedFrame> = Vec::new();
+        for i in 0..NUM_DATAGRAMS {
+            for (src, dst) in [
+                ((test_helpers::BOB_MAC, remote), (test_helpers::ALICE_MAC, local)),
+                ((test_helpers::ALICE_MAC, local), (test_helpers::BOB_MAC, remote)),
+            ] {
+                frames.push(CapturedFrame {
+                    timestamp: Duration::from_secs(1_000_000) + Duration::from_micros(i as u64 * 10),
+                    bytes: build_frame(
+                        (src.0, *src.1.ip()),
+                        (dst.0, *dst.1.ip()),
+                        IpProtocol::UDP,
+                        |buf: &mut DemiBuffer| {
+                            UdpHeader::new(src.1.port(), dst.1.port()).serialize_and_attach(
+                                buf,
+                                src.1.ip(),
+                                dst.1.ip(),
+                                false,
+                            )
+                        },
+                        &payload,
+                    ),
+                });
+            }
+        }
+
+        let report: ReplayReport = replay(&read_pcap(&write_pcap(&frames))?)?;
+        crate::ensure_eq!(report.packets, NUM_DATAGRAMS);
+        crate::ensure_eq!(report.popped_bytes, NUM_DATAGRAMS * payload.len());
+
+        Ok(())
+    }
+
+    /// Checks that a replay accepts the connections that the host accepted and delivers their data, although the ISN of
+    /// the host in the capture is not the one that the stack picks.
+    #[test]
+    fn test_replay_tcp_capture() -> Result<()> {
+        const NUM_SEGMENTS: u32 = 10;
+        const CAPTURED_ISN: u32 = 0xfffff000;
+        const REMOTE_ISN: u32 = 1000;
+        let local: (MacAddress, SocketAddrV4) =
+            (test_helpers::ALICE_MAC, SocketAddrV4::new(test_helpers::ALICE_IPV4, 80));
+        let remote: (MacAddress, SocketAddrV4) =
+            (test_helpers::BOB_MAC, SocketAddrV4::new(test_helpers::BOB_IPV4, 49152));
+        let payload: [u8; 500] = [0xcd; 500];
+
+        let mut frames: Vec<Vec<u8>> = vec![
+            build_tcp_frame(remote, local, REMOTE_ISN, None, true, false, &[]),
+            build_tcp_frame(local, remote, CAPTURED_ISN, Some(REMOTE_ISN + 1), true, false, &[]),
+            build_tcp_frame(remote, local, REMOTE_ISN + 1, Some(CAPTURED_ISN + 1), false, false, &[]),
+        ];
+        let mut seq_num: u32 = REMOTE_ISN + 1;
+        for _ in 0..NUM_SEGMENTS {
+            frames.push(build_tcp_frame(
+                remote,
+                local,
+                seq_num,
+                Some(CAPTURED_ISN + 1),
+                false,
+                false,
+                &payload,
+            ));
+            seq_num += payload.len() as u32;
+            frames.push(build_tcp_frame(
+                local,
+                remote,
+                CAPTURED_ISN + 1,
+                Some(seq_num),
+                false,
+                false,
+                &[],
+            ));
+        }
+        frames.push(build_tcp_frame(
+            remote,
+            local,
+            seq_num,
+            Some(CAPTURED_ISN + 1),
+            false,
+            true,
+            &[],
+        ));
+        let frames: Vec<CapturedFrame> = frames
+            .into_iter()
+            .enumerate()
+            .map(|(i, bytes): (usize, Vec<u8>)| CapturedFrame {
+                timestamp: Duration::from_millis(i as u64),
+                bytes,
+            })
+            .collect();
+
+        let report: ReplayReport = replay(&frames)?;
+        crate::ensure_eq!(report.packets, 3 + NUM_SEGMENTS as usize);
+        crate::ensure_eq!(report.popped_bytes, NUM_SEGMENTS as usize * payload.len());
+
+        Ok(())
+    }
+
+    /// Replays the capture at the path in the `PCAP` environment variable, if it is set, and prints its report on a line
+    /// of its own.
+    #[test]
+    fn test_replay_pcap() -> Result<()> {
+        let path: String = match env::var("PCAP") {
+            Ok(path) => path,
+            Err(_) => {
+                warn!("test_replay_pcap(): no capture to replay (PCAP is not set)");
+                return Ok(());
+            },
+        };
+
+        let frames: Vec<CapturedFrame> = read_pcap_file(&path)?;
+        let report: ReplayReport = replay(&frames)?;
+        let name: &str = Path::new(&path)
+            .file_stem()
+            .and_then(|stem| stem.to_str())
+            .unwrap_or("pcap");
+        info!("test_replay_pcap(): replayed {:?}: {:?}", path, report);
+        println!("{}", report.to_json(name));
+
+        Ok(())
+    }
+}
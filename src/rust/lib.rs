@@ -32,6 +32,9 @@ mod catpowder;
 #[cfg(all(feature = "catnap-libos"))]
 mod catnap;
 
+#[cfg(feature = "catmem-libos")]
+mod catmem;
+
 pub use self::demikernel::libos::{name::LibOSName, LibOS};
 pub use crate::runtime::{
     network::{
@@ -39,16 +42,23 @@ pub use crate::runtime::{
         types::{MacAddress, Port16},
     },
     types::{demi_sgarray_t, demi_sgaseg_t},
-    OperationResult, QDesc, QToken, QType,
+    OperationResult, QDesc, QToken, QType, WaitSetId,
 };
 
 pub mod demikernel;
 
 use mimalloc::MiMalloc;
 
+#[cfg(not(test))]
 #[global_allocator]
 static GLOBAL: MiMalloc = MiMalloc;
 
+/// Unit tests count allocations, so that replays can report how many the stack makes.
+#[cfg(test)]
+#[global_allocator]
+static GLOBAL: inetstack::test_helpers::replay::CountingAllocator<MiMalloc> =
+    inetstack::test_helpers::replay::CountingAllocator(MiMalloc);
+
 //======================================================================================================================
 // Macros
 //======================================================================================================================
@@ -0,0 +1,216 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::fail::Fail;
+use ::std::{ffi::CString, ptr};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Mount point of the hugetlbfs file system that is set up by scripts/setup/hugepages.sh.
+const HUGETLBFS_MOUNT_POINT: &str = "/mnt/huge";
+
+/// Size of the hugepages of [HUGETLBFS_MOUNT_POINT].
+const HUGEPAGE_SIZE: usize = 2 * 1024 * 1024;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A named region of memory that is mapped by several processes.
+pub struct SharedMemory {
+    /// Path of the backing file. This is a POSIX shared memory object name or a file in hugetlbfs.
+    path: CString,
+    /// Is the backing file a POSIX shared memory object?
+    is_posix: bool,
+    /// Did we create the region? The creator removes its name when it unmaps it.
+    is_owner: bool,
+    /// Start of the mapping.
+    ptr: *mut u8,
+    /// Size of the mapping.
+    len: usize,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl SharedMemory {
+    /// Creates a shared memory region of `len` bytes named `name`. The region is zero-filled.
+    pub fn create(name: &str, len: usize) -> Result<Self, Fail> {
+        Self::map(Self::posix_path(name)?, true, true, len)
+    }
+
+    /// Opens the shared memory region of `len` bytes named `name`.
+    pub fn open(name: &str, len: usize) -> Result<Self, Fail> {
+        Self::map(Self::posix_path(name)?, true, false, len)
+    }
+
+    /// Same as [create](Self::create), but the region lives on hugepages. Its size is rounded up to whole hugepages.
+    pub fn create_on_hugepages(name: &str, len: usize) -> Result<Self, Fail> {
+        Self::map(
+            Self::hugetlbfs_path(name)?,
+            false,
+            true,
+            len.next_multiple_of(HUGEPAGE_SIZE),
+        )
+    }
+
+    /// Same as [open](Self::open), for regions created by [create_on_hugepages](Self::create_on_hugepages).
+    pub fn open_on_hugepages(name: &str, len: usize) -> Result<Self, Fail> {
+        Self::map(
+            Self::hugetlbfs_path(name)?,
+            false,
+            false,
+            len.next_multiple_of(HUGEPAGE_SIZE),
+        )
+    }
+
+    /// Returns a pointer to the start of the region.
+    pub fn as_mut_ptr(&mut self) -> *mut u8 {
+        self.ptr
+    }
+
+    /// Returns the size of the region.
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    fn map(path: CString, is_posix: bool, is_owner: bool, len: usize) -> Result<Self, Fail> {
+        let flags: libc::c_int = libc::O_RDWR | if is_owner { libc::O_CREAT } else { 0 };
+        let mode: libc::mode_t = libc::S_IRUSR | libc::S_IWUSR;
+        let fd: libc::c_int = unsafe {
+            if is_posix {
+                libc::shm_open(path.as_ptr(), flags, mode)
+            } else {
+                libc::open(path.as_ptr(), flags, mode as libc::c_uint)
+            }
+        };
+        if fd < 0 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            let cause: String = format!(
+                "failed to open shared memory region (path={:?}, errno={:?})",
+                path, errno
+            );
+            error!("map(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+
+        // Only the creator sizes the region, so that openers never truncate a region that is in use.
+        if is_owner && unsafe { libc::ftruncate(fd, len as libc::off_t) } != 0 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            unsafe { libc::close(fd) };
+            let cause: String = format!(
+                "failed to size shared memory region (path={:?}, errno={:?})",
+                path, errno
+            );
+            error!("map(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+
+        // Openers check the size instead, because touching a mapping past the end of its file raises SIGBUS.
+        if !is_owner {
+            let mut stat: libc::stat = unsafe { ::std::mem::zeroed() };
+            if unsafe { libc::fstat(fd, &mut stat) } != 0 || (stat.st_size as usize) < len {
+                unsafe { libc::close(fd) };
+                let cause: String = format!("shared memory region is too small (path={:?}, len={:?})", path, len);
+                error!("map(): {}", cause);
+                return Err(Fail::new(libc::EINVAL, &cause));
+            }
+        }
+
+        // Fault the whole region in right away, so that the first accesses on the data path do not take page faults.
+        let ptr: *mut libc::c_void = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED | libc::MAP_POPULATE,
+                fd,
+                0,
+            )
+        };
+        let errno: libc::c_int = unsafe { *libc::__errno_location() };
+        // The mapping holds its own reference to the file.
+        unsafe { libc::close(fd) };
+        if ptr == libc::MAP_FAILED {
+            let cause: String = format!(
+                "failed to map shared memory region (path={:?}, errno={:?})",
+                path, errno
+            );
+            error!("map(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+
+        Ok(Self {
+            path,
+            is_posix,
+            is_owner,
+            ptr: ptr.cast(),
+            len,
+        })
+    }
+
+    fn posix_path(name: &str) -> Result<CString, Fail> {
+        // Names of POSIX shared memory objects start with a slash and have no other.
+        Self::to_path(format!("/{}", Self::check_name(name)?))
+    }
+
+    fn hugetlbfs_path(name: &str) -> Result<CString, Fail> {
+        Self::to_path(format!("{}/{}", HUGETLBFS_MOUNT_POINT, Self::check_name(name)?))
+    }
+
+    /// Checks that `name`, without its leading slash, if any, can name a file.
+    fn check_name(name: &str) -> Result<&str, Fail> {
+        let name: &str = name.strip_prefix('/').unwrap_or(name);
+        if name.is_empty() || name.contains('/') || name == "." || name == ".." {
+            let cause: String = format!("invalid shared memory region name (name={:?})", name);
+            error!("check_name(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        Ok(name)
+    }
+
+    fn to_path(path: String) -> Result<CString, Fail> {
+        match CString::new(path) {
+            Ok(path) => Ok(path),
+            Err(_) => {
+                let cause: String = format!("shared memory region name contains a null byte");
+                error!("to_path(): {}", cause);
+                Err(Fail::new(libc::EINVAL, &cause))
+            },
+        }
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Drop for SharedMemory {
+    fn drop(&mut self) {
+        if unsafe { libc::munmap(self.ptr.cast(), self.len) } != 0 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            warn!("drop(): failed to unmap shared memory region (errno={:?})", errno);
+        }
+        // Processes that still map the region keep it alive, but it can no longer be opened.
+        if self.is_owner {
+            let ret: libc::c_int = unsafe {
+                if self.is_posix {
+                    libc::shm_unlink(self.path.as_ptr())
+                } else {
+                    libc::unlink(self.path.as_ptr())
+                }
+            };
+            if ret != 0 {
+                let errno: libc::c_int = unsafe { *libc::__errno_location() };
+                warn!("drop(): failed to remove shared memory region (errno={:?})", errno);
+            }
+        }
+    }
+}
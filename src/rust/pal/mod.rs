@@ -9,6 +9,9 @@
 // datastructures. This layer exists because of the differences between the Windows/Linux libc/WinSock implementations
 // of the corresponding Rust libraries.
 
+#[cfg(target_os = "linux")]
+pub mod linux;
+
 //======================================================================================================================
 // Common imports
 //======================================================================================================================
@@ -82,6 +85,9 @@ pub const SOL_SOCKET: i32 = libc::SOL_SOCKET;
 #[cfg(target_os = "linux")]
 pub const SO_LINGER: i32 = libc::SO_LINGER;
 
+#[cfg(target_os = "linux")]
+pub const SO_PRIORITY: i32 = libc::SO_PRIORITY;
+
 //======================================================================================================================
 // Windows data structures
 //======================================================================================================================
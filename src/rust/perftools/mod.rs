@@ -2,3 +2,4 @@
 // Licensed under the MIT license.
 
 pub mod profiler;
+pub mod stats;
@@ -0,0 +1,206 @@
+// Copyright(c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! This module provides a fixed-size log-linear histogram, in the spirit of HDR histograms.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::types::demi_latency_t;
+use ::std::cell::Cell;
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Every power of two is split into 2^SUB_BUCKET_BITS buckets, so a value lands in a bucket that is at most 1/16 of
+/// the value wide.
+const SUB_BUCKET_BITS: u32 = 4;
+const SUB_BUCKETS: usize = 1 << SUB_BUCKET_BITS;
+
+/// Values below [SUB_BUCKETS] get a bucket each, and every power of two above gets [SUB_BUCKETS] of them.
+const NUM_BUCKETS: usize = (u64::BITS - SUB_BUCKET_BITS + 1) as usize * SUB_BUCKETS;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A histogram of 64-bit values. Recording a value takes a handful of instructions and never allocates, and the
+/// memory footprint is fixed (under 8 KB). Counts are kept in cells so that a thread-local histogram can be updated
+/// through a shared reference.
+pub struct Histogram {
+    buckets: [Cell<u64>; NUM_BUCKETS],
+    count: Cell<u64>,
+    sum: Cell<u64>,
+    min: Cell<u64>,
+    max: Cell<u64>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl Histogram {
+    pub const fn new() -> Self {
+        Self {
+            buckets: [const { Cell::new(0) }; NUM_BUCKETS],
+            count: Cell::new(0),
+            sum: Cell::new(0),
+            min: Cell::new(u64::MAX),
+            max: Cell::new(0),
+        }
+    }
+
+    /// Records one occurrence of `value`.
+    #[inline]
+    pub fn record(&self, value: u64) {
+        let bucket: &Cell<u64> = &self.buckets[Self::bucket_of(value)];
+        bucket.set(bucket.get() + 1);
+        self.count.set(self.count.get() + 1);
+        self.sum.set(self.sum.get().saturating_add(value));
+        if value < self.min.get() {
+            self.min.set(value);
+        }
+        if value > self.max.get() {
+            self.max.set(value);
+        }
+    }
+
+    /// Returns the number of values that were recorded.
+    pub fn count(&self) -> u64 {
+        self.count.get()
+    }
+
+    /// Returns the smallest value `v` such that at least a fraction `q` of the recorded values are not larger than `v`,
+    /// up to the width of its bucket. Returns zero if nothing was recorded.
+    pub fn percentile(&self, q: f64) -> u64 {
+        let count: u64 = self.count.get();
+        if count == 0 {
+            return 0;
+        }
+        let rank: u64 = ((q * count as f64).ceil() as u64).clamp(1, count);
+        let mut seen: u64 = 0;
+        for (i, bucket) in self.buckets.iter().enumerate() {
+            seen += bucket.get();
+            if seen >= rank {
+                // The top of the bucket may overshoot the largest value that was recorded.
+                return Self::highest_in_bucket(i).min(self.max.get());
+            }
+        }
+        self.max.get()
+    }
+
+    /// Summarizes this histogram.
+    pub fn summary(&self) -> demi_latency_t {
+        let count: u64 = self.count.get();
+        if count == 0 {
+            return demi_latency_t::default();
+        }
+        demi_latency_t {
+            count,
+            min_ns: self.min.get(),
+            mean_ns: self.sum.get() / count,
+            p50_ns: self.percentile(0.5),
+            p99_ns: self.percentile(0.99),
+            p999_ns: self.percentile(0.999),
+            max_ns: self.max.get(),
+        }
+    }
+
+    /// Forgets every value that was recorded.
+    pub fn reset(&self) {
+        for bucket in self.buckets.iter() {
+            bucket.set(0);
+        }
+        self.count.set(0);
+        self.sum.set(0);
+        self.min.set(u64::MAX);
+        self.max.set(0);
+    }
+
+    /// Returns the bucket of `value`. The bucket of a value of 2^e or more (for e >= [SUB_BUCKET_BITS]) is given by
+    /// e and by the [SUB_BUCKET_BITS] bits that follow the leading one.
+    #[inline]
+    fn bucket_of(value: u64) -> usize {
+        if value < SUB_BUCKETS as u64 {
+            return value as usize;
+        }
+        let shift: u32 = u64::BITS - 1 - value.leading_zeros() - SUB_BUCKET_BITS;
+        let sub_bucket: usize = (value >> shift) as usize - SUB_BUCKETS;
+        (shift as usize + 1) * SUB_BUCKETS + sub_bucket
+    }
+
+    /// Returns the largest value that lands in bucket `i`.
+    fn highest_in_bucket(i: usize) -> u64 {
+        if i < SUB_BUCKETS {
+            return i as u64;
+        }
+        let shift: u32 = (i / SUB_BUCKETS - 1) as u32;
+        let lowest: u64 = ((SUB_BUCKETS + i % SUB_BUCKETS) as u64) << shift;
+        lowest + ((1u64 << shift) - 1)
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use super::{Histogram, NUM_BUCKETS};
+    use crate::runtime::types::demi_latency_t;
+    use ::anyhow::Result;
+
+    /// Tests if every value lands in a bucket whose range holds it, and if buckets are ordered like their values.
+    #[test]
+    fn bucket_ranges() -> Result<()> {
+        let mut values: Vec<u64> = (0..1024).collect();
+        values.extend((4..64).flat_map(|e: u32| [(1u64 << e) - 1, 1u64 << e, (1u64 << e) + 1]));
+        values.push(u64::MAX);
+        values.sort();
+
+        let mut last: usize = 0;
+        for value in values {
+            let i: usize = Histogram::bucket_of(value);
+            crate::ensure_eq!(i < NUM_BUCKETS, true);
+            crate::ensure_eq!(i >= last, true);
+            crate::ensure_eq!(Histogram::highest_in_bucket(i) >= value, true);
+            if i > 0 {
+                crate::ensure_eq!(Histogram::highest_in_bucket(i - 1) < value, true);
+            }
+            last = i;
+        }
+        crate::ensure_eq!(Histogram::bucket_of(u64::MAX), NUM_BUCKETS - 1);
+
+        Ok(())
+    }
+
+    /// Tests if percentiles are within the precision of the histogram.
+    #[test]
+    fn percentiles() -> Result<()> {
+        let histogram: Histogram = Histogram::new();
+        crate::ensure_eq!(histogram.percentile(0.5), 0);
+
+        for value in 1..=10_000u64 {
+            histogram.record(value * 100);
+        }
+        for (q, expected) in [(0.5, 500_000u64), (0.99, 990_000), (0.999, 999_000), (1.0, 1_000_000)] {
+            let p: u64 = histogram.percentile(q);
+            crate::ensure_eq!(p >= expected, true);
+            crate::ensure_eq!(p - expected <= expected / 16, true);
+        }
+
+        let summary: demi_latency_t = histogram.summary();
+        crate::ensure_eq!(summary.count, 10_000);
+        crate::ensure_eq!(summary.min_ns, 100);
+        crate::ensure_eq!(summary.max_ns, 1_000_000);
+        crate::ensure_eq!(summary.mean_ns, 500_050);
+
+        histogram.reset();
+        crate::ensure_eq!(histogram.count(), 0);
+        crate::ensure_eq!(histogram.summary(), Default::default());
+
+        Ok(())
+    }
+}
@@ -0,0 +1,297 @@
+// Copyright(c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! This module provides always-on statistics for the Demikernel libOSes. Unlike the profiler, which is only built with
+//! the `profiler` feature, these are cheap enough to keep in production builds: every counter and histogram belongs to
+//! the thread that updates it, so recording is a plain add on a thread-local cell, without locks, atomics or
+//! allocations. A libOS runs on a single thread, so these are per-core statistics. The benchmarks at the end of this
+//! file measure what recording costs.
+
+//======================================================================================================================
+// Exports
+//======================================================================================================================
+
+mod histogram;
+pub use self::histogram::Histogram;
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::types::{demi_callback_t, demi_latency_t, demi_stats_t};
+use ::std::{cell::Cell, time::Duration};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Events that are counted.
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub enum Counter {
+    /// Packets (or datagrams and socket reads, on LibOSes without a network stack of their own) received.
+    PacketsIn,
+    /// Packets (or datagrams and socket writes, on LibOSes without a network stack of their own) sent.
+    PacketsOut,
+    BytesIn,
+    BytesOut,
+    /// Packets that were dropped because they were malformed, unexpected or could not be delivered.
+    Drops,
+    /// TCP segments that were sent again.
+    Retransmits,
+    /// Expirations of the TCP retransmission timer.
+    RtoFires,
+    /// Bytes of TCP data that arrived ahead of a hole and were held for reassembly.
+    OutOfOrderBytes,
+    /// Allocations that failed because a memory pool was empty.
+    MempoolExhausted,
+}
+
+/// Latencies that are recorded.
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub enum Latency {
+    /// Time from a push until it completes. On TCP sockets of the inetstack, a push completes once it is acknowledged.
+    /// Elsewhere, it completes once the data was handed to the kernel or the device, so this is not a round trip.
+    PushCompletion,
+    /// Time from a pop until data is available.
+    PopWait,
+}
+
+/// A set of counters. Each set is owned by a single thread.
+pub struct Counters([Cell<u64>; NUM_COUNTERS]);
+
+/// Statistics of a thread.
+struct Stats {
+    counters: Counters,
+    push_completion: Histogram,
+    pop_wait: Histogram,
+}
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+const NUM_COUNTERS: usize = Counter::MempoolExhausted as usize + 1;
+
+/// Names under which counters are exported, in the order of [Counter].
+const COUNTER_NAMES: [&str; NUM_COUNTERS] = [
+    "stats::packets_in",
+    "stats::packets_out",
+    "stats::bytes_in",
+    "stats::bytes_out",
+    "stats::drops",
+    "stats::retransmits",
+    "stats::rto_fires",
+    "stats::ooo_bytes",
+    "stats::mempool_exhausted",
+];
+
+thread_local!(
+    /// Statistics of the current thread.
+    static STATS: Stats = const {
+        Stats {
+            counters: Counters::new(),
+            push_completion: Histogram::new(),
+            pop_wait: Histogram::new(),
+        }
+    }
+);
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl Counters {
+    pub const fn new() -> Self {
+        Self([const { Cell::new(0) }; NUM_COUNTERS])
+    }
+
+    /// Adds `n` to `counter`.
+    #[inline]
+    pub fn add(&self, counter: Counter, n: u64) {
+        let cell: &Cell<u64> = &self.0[counter as usize];
+        cell.set(cell.get().wrapping_add(n));
+    }
+
+    pub fn get(&self, counter: Counter) -> u64 {
+        self.0[counter as usize].get()
+    }
+
+    /// Copies the counters into `stats`.
+    pub fn fill(&self, stats: &mut demi_stats_t) {
+        stats.packets_in = self.get(Counter::PacketsIn);
+        stats.packets_out = self.get(Counter::PacketsOut);
+        stats.bytes_in = self.get(Counter::BytesIn);
+        stats.bytes_out = self.get(Counter::BytesOut);
+        stats.drops = self.get(Counter::Drops);
+        stats.retransmits = self.get(Counter::Retransmits);
+        stats.rto_fires = self.get(Counter::RtoFires);
+        stats.ooo_bytes = self.get(Counter::OutOfOrderBytes);
+        stats.mempool_exhausted = self.get(Counter::MempoolExhausted);
+    }
+}
+
+/// Adds `n` to `counter` on the current thread.
+#[inline]
+pub fn count(counter: Counter, n: u64) {
+    STATS.with(|stats: &Stats| stats.counters.add(counter, n));
+}
+
+/// Records one occurrence of `latency` on the current thread.
+#[inline]
+pub fn record(latency: Latency, duration: Duration) {
+    let ns: u64 = duration.as_nanos().try_into().unwrap_or(u64::MAX);
+    STATS.with(|stats: &Stats| match latency {
+        Latency::PushCompletion => stats.push_completion.record(ns),
+        Latency::PopWait => stats.pop_wait.record(ns),
+    });
+}
+
+/// Returns the statistics of the current thread.
+pub fn snapshot() -> demi_stats_t {
+    STATS.with(|stats: &Stats| {
+        let mut snapshot: demi_stats_t = demi_stats_t::default();
+        stats.counters.fill(&mut snapshot);
+        snapshot.push_completion = stats.push_completion.summary();
+        snapshot.pop_wait = stats.pop_wait.summary();
+        snapshot
+    })
+}
+
+/// Reports every statistic of the current thread to `callback`, as a name and a value. Names start with "stats::", so
+/// that they stand apart from the scopes that the profiler reports through the same callback.
+pub fn export(callback: demi_callback_t) {
+    let snapshot: demi_stats_t = snapshot();
+    let report = |name: &str, value: u64| callback(name.as_ptr() as *const i8, name.len() as u32, value);
+    STATS.with(|stats: &Stats| {
+        for (i, name) in COUNTER_NAMES.iter().enumerate() {
+            report(name, stats.counters.0[i].get());
+        }
+    });
+    let latencies: [(&str, &demi_latency_t); 2] = [
+        ("stats::push_completion", &snapshot.push_completion),
+        ("stats::pop_wait", &snapshot.pop_wait),
+    ];
+    for (prefix, latency) in latencies {
+        for (suffix, value) in [
+            ("count", latency.count),
+            ("min_ns", latency.min_ns),
+            ("mean_ns", latency.mean_ns),
+            ("p50_ns", latency.p50_ns),
+            ("p99_ns", latency.p99_ns),
+            ("p999_ns", latency.p999_ns),
+            ("max_ns", latency.max_ns),
+        ] {
+            report(&format!("{}::{}", prefix, suffix), value);
+        }
+    }
+}
+
+/// Resets the statistics of the current thread.
+pub fn reset() {
+    STATS.with(|stats: &Stats| {
+        for cell in stats.counters.0.iter() {
+            cell.set(0);
+        }
+        stats.push_completion.reset();
+        stats.pop_wait.reset();
+    });
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::{
+        perftools::stats::{self, Counter, Counters, Latency, COUNTER_NAMES},
+        runtime::types::demi_stats_t,
+    };
+    use ::anyhow::Result;
+    use ::std::{
+        cell::{Ref, RefCell},
+        collections::HashMap,
+        thread,
+        time::Duration,
+    };
+    use ::test::{black_box, Bencher};
+
+    thread_local!(
+        static EXPORTED: RefCell<HashMap<String, u64>> = RefCell::new(HashMap::new())
+    );
+
+    extern "C" fn collect(name: *const std::ffi::c_char, len: u32, value: u64) {
+        let name: &[u8] = unsafe { std::slice::from_raw_parts(name as *const u8, len as usize) };
+        let name: String = String::from_utf8(name.to_vec()).expect("names should be valid UTF-8");
+        EXPORTED.with(|exported| exported.borrow_mut().insert(name, value));
+    }
+
+    /// Tests if counters and latencies show up in snapshots and exports, and only on the thread that recorded them.
+    #[test]
+    fn snapshot_and_export() -> Result<()> {
+        // Run on a thread of our own, so that other tests do not touch these statistics.
+        thread::spawn(|| -> Result<()> {
+            stats::count(Counter::PacketsIn, 1);
+            stats::count(Counter::BytesIn, 1500);
+            stats::count(Counter::BytesIn, 500);
+            stats::count(Counter::Retransmits, 3);
+            stats::record(Latency::PushCompletion, Duration::from_micros(10));
+            stats::record(Latency::PushCompletion, Duration::from_micros(30));
+
+            let snapshot: demi_stats_t = stats::snapshot();
+            crate::ensure_eq!(snapshot.packets_in, 1);
+            crate::ensure_eq!(snapshot.bytes_in, 2000);
+            crate::ensure_eq!(snapshot.retransmits, 3);
+            crate::ensure_eq!(snapshot.packets_out, 0);
+            crate::ensure_eq!(snapshot.push_completion.count, 2);
+            crate::ensure_eq!(snapshot.push_completion.min_ns, 10_000);
+            crate::ensure_eq!(snapshot.push_completion.max_ns, 30_000);
+            crate::ensure_eq!(snapshot.push_completion.mean_ns, 20_000);
+            crate::ensure_eq!(snapshot.pop_wait.count, 0);
+
+            // Another thread has statistics of its own.
+            let other: demi_stats_t = thread::spawn(stats::snapshot).join().expect("thread should not panic");
+            crate::ensure_eq!(other, demi_stats_t::default());
+
+            stats::export(collect);
+            EXPORTED.with(|exported| -> Result<()> {
+                let exported: Ref<HashMap<String, u64>> = exported.borrow();
+                crate::ensure_eq!(exported.len(), COUNTER_NAMES.len() + 2 * 7);
+                crate::ensure_eq!(exported.get("stats::bytes_in"), Some(&2000));
+                crate::ensure_eq!(exported.get("stats::push_completion::count"), Some(&2));
+                crate::ensure_eq!(exported.get("stats::pop_wait::max_ns"), Some(&0));
+                Ok(())
+            })?;
+
+            stats::reset();
+            crate::ensure_eq!(stats::snapshot(), demi_stats_t::default());
+            Ok(())
+        })
+        .join()
+        .expect("thread should not panic")
+    }
+
+    /// Tests if counters that belong to a socket add up on their own.
+    #[test]
+    fn counters() -> Result<()> {
+        let counters: Counters = Counters::new();
+        counters.add(Counter::PacketsOut, 2);
+        counters.add(Counter::BytesOut, 64);
+        let mut snapshot: demi_stats_t = demi_stats_t::default();
+        counters.fill(&mut snapshot);
+        crate::ensure_eq!(snapshot.packets_out, 2);
+        crate::ensure_eq!(snapshot.bytes_out, 64);
+        crate::ensure_eq!(snapshot.packets_in, 0);
+        Ok(())
+    }
+
+    #[bench]
+    fn bench_stats_count(b: &mut Bencher) {
+        b.iter(|| stats::count(Counter::PacketsIn, black_box(1)));
+    }
+
+    #[bench]
+    fn bench_stats_record(b: &mut Bencher) {
+        b.iter(|| stats::record(Latency::PushCompletion, black_box(Duration::from_micros(10))));
+    }
+}
@@ -0,0 +1,195 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Completion queues.
+//!
+//! A completion queue is a single-producer, single-consumer ring of `demi_qresult_t` that lives in memory owned by the
+//! application. The runtime writes the result of every operation that completes while the application is not waiting
+//! on it straight into the ring, and the application drains the ring by reading it directly, without any call into
+//! Demikernel. The layout of the ring matches `demi_cq_t` in `include/demi/types.h`:
+//!
+//! | head: u64 | tail: u64 | entries: [demi_qresult_t; N] |
+//!
+//! Entries are packed back to back, as `demi_qresult_t` is packed in C, and `N` is the largest power of two that fits in
+//! the ring. The application owns `head` and Demikernel owns `tail`.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    collections::ring::{Ring, RingBuffer, RingProducer},
+    runtime::{fail::Fail, types::demi_qresult_t, OperationResult, QDesc, QToken},
+};
+use ::std::{mem, ptr};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Size of an entry in a completion queue, which is a `demi_qresult_t`.
+pub const DEMI_CQE_SIZE: usize = mem::size_of::<demi_qresult_t>();
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Converts the result of a completed operation into its representation for the application.
+pub type ResultFormatter = Box<dyn Fn(QToken, QDesc, OperationResult) -> demi_qresult_t>;
+
+/// An entry in a completion queue: the bytes of a `demi_qresult_t`, without its alignment.
+#[repr(C, packed)]
+#[derive(Copy, Clone)]
+struct CompletionEntry([u8; DEMI_CQE_SIZE]);
+
+/// A completion queue that is shared with the application.
+pub struct CompletionQueue {
+    /// Underlying ring, in memory owned by the application.
+    ring: RingBuffer<CompletionEntry, u64>,
+    /// Converts operation results into queue results.
+    format: ResultFormatter,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl CompletionQueue {
+    /// Builds a completion queue on top of the `size` bytes of memory at `ptr`. The memory must outlive the completion
+    /// queue.
+    pub fn from_raw_parts(ptr: *mut u8, size: usize, format: ResultFormatter) -> Result<Self, Fail> {
+        let ring: RingBuffer<CompletionEntry, u64> = RingBuffer::from_raw_parts(true, ptr, size)?;
+        // One slot is always left empty to tell a full ring from an empty one.
+        if ring.capacity() == 0 {
+            let cause: String = format!("completion queue is too small (size={:?})", size);
+            error!("from_raw_parts(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        Ok(Self { ring, format })
+    }
+
+    /// Returns the number of entries that the completion queue can hold.
+    pub fn capacity(&self) -> usize {
+        self.ring.capacity() as usize
+    }
+
+    /// Writes the result of a completed operation into the completion queue. If the completion queue is full, the
+    /// result is handed back to the caller.
+    pub fn try_push(&self, qt: QToken, qd: QDesc, result: OperationResult) -> Result<(), (QDesc, OperationResult)> {
+        let mut producer: RingProducer<CompletionEntry, u64> = self.ring.producer();
+        // Check for room first, because formatting the result hands its buffers over to the application.
+        if producer.sync_get_ready_count() == 0 {
+            return Err((qd, result));
+        }
+
+        let qr: demi_qresult_t = (self.format)(qt, qd, result);
+        let mut entry: CompletionEntry = CompletionEntry([0; DEMI_CQE_SIZE]);
+        // Safety: the entry has the size of a queue result.
+        unsafe {
+            ptr::copy_nonoverlapping(
+                &qr as *const demi_qresult_t as *const u8,
+                entry.0.as_mut_ptr(),
+                DEMI_CQE_SIZE,
+            )
+        };
+        match producer.try_enqueue(entry) {
+            Ok(()) => Ok(()),
+            Err(_) => unreachable!("there is a single producer and it checked for room"),
+        }
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::runtime::{
+        completion_queue::{CompletionQueue, ResultFormatter, DEMI_CQE_SIZE},
+        types::{demi_opcode_t, demi_qresult_t},
+        OperationResult, QDesc, QToken,
+    };
+    use ::anyhow::Result;
+    use ::std::{mem, ptr};
+
+    /// Number of entries in the test completion queue.
+    const NUM_ENTRIES: usize = 4;
+
+    fn formatter() -> ResultFormatter {
+        Box::new(|qt: QToken, qd: QDesc, _: OperationResult| -> demi_qresult_t {
+            let mut qr: demi_qresult_t = unsafe { mem::zeroed() };
+            qr.qr_opcode = demi_opcode_t::DEMI_OPC_CLOSE;
+            qr.qr_qd = qd.into();
+            qr.qr_qt = qt.into();
+            qr
+        })
+    }
+
+    /// Checks that results land in the memory of the application until the ring is full.
+    #[test]
+    fn test_completion_queue_push_until_full() -> Result<()> {
+        // Head and tail, followed by the entries.
+        let mut region: Vec<u64> = vec![u64::MAX; 2 + (NUM_ENTRIES * DEMI_CQE_SIZE).div_ceil(8)];
+        let size: usize = region.len() * mem::size_of::<u64>();
+        let cq: CompletionQueue = CompletionQueue::from_raw_parts(region.as_mut_ptr() as *mut u8, size, formatter())?;
+        crate::ensure_eq!(cq.capacity(), NUM_ENTRIES - 1);
+        crate::ensure_eq!(region[0], 0);
+        crate::ensure_eq!(region[1], 0);
+
+        for i in 0..(NUM_ENTRIES - 1) {
+            if cq
+                .try_push(QToken::from(i as u64), QDesc::from(7), OperationResult::Close)
+                .is_err()
+            {
+                anyhow::bail!("completion queue should not be full");
+            }
+        }
+        crate::ensure_eq!(
+            cq.try_push(QToken::from(0), QDesc::from(7), OperationResult::Close)
+                .is_err(),
+            true
+        );
+
+        // Read the ring the way the application would.
+        crate::ensure_eq!(region[1], (NUM_ENTRIES - 1) as u64);
+        let entries: *const u8 = unsafe { (region.as_ptr() as *const u8).add(2 * mem::size_of::<u64>()) };
+        for i in 0..(NUM_ENTRIES - 1) {
+            let mut qr: demi_qresult_t = unsafe { mem::zeroed() };
+            unsafe {
+                ptr::copy_nonoverlapping(
+                    entries.add(i * DEMI_CQE_SIZE),
+                    &mut qr as *mut demi_qresult_t as *mut u8,
+                    DEMI_CQE_SIZE,
+                )
+            };
+            crate::ensure_eq!(qr.qr_opcode, demi_opcode_t::DEMI_OPC_CLOSE);
+            crate::ensure_eq!(qr.qr_qd, 7);
+            crate::ensure_eq!(qr.qr_qt, i as u64);
+        }
+
+        // Consuming an entry makes room for another one.
+        region[0] = 1;
+        if cq
+            .try_push(QToken::from(0), QDesc::from(7), OperationResult::Close)
+            .is_err()
+        {
+            anyhow::bail!("completion queue should have room");
+        }
+
+        Ok(())
+    }
+
+    /// Checks that a region that cannot hold any entry is rejected.
+    #[test]
+    fn test_completion_queue_too_small() -> Result<()> {
+        let mut region: Vec<u64> = vec![0; 2 + DEMI_CQE_SIZE.div_ceil(8)];
+        let size: usize = region.len() * mem::size_of::<u64>();
+        crate::ensure_eq!(
+            CompletionQueue::from_raw_parts(region.as_mut_ptr() as *mut u8, size, formatter()).is_err(),
+            true
+        );
+
+        Ok(())
+    }
+}
@@ -0,0 +1,152 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Idle policies.
+//!
+//! A thread that waits on Demikernel runs the scheduler until the operations that it waits on complete. When no
+//! operation completes for a while, the idle policy decides whether the thread keeps spinning, gives its core away to
+//! other threads or goes to sleep until it has to check again.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use ::std::{
+    thread,
+    time::{Duration, Instant},
+};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// What a waiting thread does while no operation completes.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub enum IdlePolicy {
+    /// Keep running the scheduler. This gives the lowest latency but burns a whole core.
+    #[default]
+    BusyPoll,
+    /// Keep running the scheduler for `spin`, then also yield the core to other threads until `yield_for` more has
+    /// elapsed, and from then on sleep for up to `max_sleep` between passes over the scheduler.
+    Adaptive {
+        spin: Duration,
+        yield_for: Duration,
+        max_sleep: Duration,
+    },
+}
+
+/// Applies an [IdlePolicy] to the passes of a waiting thread over the scheduler.
+#[derive(Default)]
+pub struct IdleBackoff {
+    policy: IdlePolicy,
+    /// When the current idle period started, if any.
+    idle_since: Option<Instant>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl IdleBackoff {
+    pub fn new(policy: IdlePolicy) -> Self {
+        Self {
+            policy,
+            idle_since: None,
+        }
+    }
+
+    pub fn set_policy(&mut self, policy: IdlePolicy) {
+        self.policy = policy;
+        self.idle_since = None;
+    }
+
+    /// Ends the current idle period, because some operation completed.
+    pub fn reset(&mut self) {
+        self.idle_since = None;
+    }
+
+    /// Backs off after a pass over the scheduler in which no operation completed. A sleep lasts no longer than the
+    /// duration given by `limit`, which is only computed when going to sleep. Returns true if the thread gave its core
+    /// away, so that the caller knows that time went by.
+    pub fn idle<F: FnOnce() -> Duration>(&mut self, limit: F) -> bool {
+        let (spin, yield_for, max_sleep): (Duration, Duration, Duration) = match self.policy {
+            IdlePolicy::BusyPoll => return false,
+            IdlePolicy::Adaptive {
+                spin,
+                yield_for,
+                max_sleep,
+            } => (spin, yield_for, max_sleep),
+        };
+
+        let now: Instant = Instant::now();
+        let idle_time: Duration = now - *self.idle_since.get_or_insert(now);
+        if idle_time < spin {
+            false
+        } else if idle_time < spin + yield_for {
+            thread::yield_now();
+            true
+        } else {
+            let sleep_time: Duration = max_sleep.min(limit());
+            if !sleep_time.is_zero() {
+                thread::sleep(sleep_time);
+            }
+            true
+        }
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::runtime::idle::{IdleBackoff, IdlePolicy};
+    use ::anyhow::Result;
+    use ::std::time::{Duration, Instant};
+
+    /// Checks that a busy-polling thread never gives its core away.
+    #[test]
+    fn test_idle_busy_poll() -> Result<()> {
+        let mut backoff: IdleBackoff = IdleBackoff::new(IdlePolicy::BusyPoll);
+        for _ in 0..1024 {
+            crate::ensure_eq!(
+                backoff.idle(|| unreachable!("busy-polling threads do not sleep")),
+                false
+            );
+        }
+
+        Ok(())
+    }
+
+    /// Checks that an adaptive thread spins first, then sleeps no longer than allowed, and spins again after making
+    /// progress.
+    #[test]
+    fn test_idle_adaptive() -> Result<()> {
+        let mut backoff: IdleBackoff = IdleBackoff::new(IdlePolicy::Adaptive {
+            spin: Duration::from_secs(3600),
+            yield_for: Duration::ZERO,
+            max_sleep: Duration::from_millis(1),
+        });
+        crate::ensure_eq!(backoff.idle(|| unreachable!("spinning threads do not sleep")), false);
+
+        backoff.set_policy(IdlePolicy::Adaptive {
+            spin: Duration::ZERO,
+            yield_for: Duration::ZERO,
+            max_sleep: Duration::from_secs(3600),
+        });
+        let start: Instant = Instant::now();
+        crate::ensure_eq!(backoff.idle(|| Duration::from_millis(1)), true);
+        crate::ensure_eq!(start.elapsed() < Duration::from_secs(1), true);
+
+        backoff.set_policy(IdlePolicy::Adaptive {
+            spin: Duration::from_secs(3600),
+            yield_for: Duration::ZERO,
+            max_sleep: Duration::from_millis(1),
+        });
+        backoff.reset();
+        crate::ensure_eq!(backoff.idle(|| unreachable!("spinning threads do not sleep")), false);
+
+        Ok(())
+    }
+}
@@ -12,6 +12,14 @@ use crate::{
     runtime::memory::{demibuffer::MetaData, memory_pool::MemoryPool},
 };
 
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of bytes at the start of every buffer of a [`BufferPool`] that hold the metadata of a `DemiBuffer`. The data
+/// of the buffer follows them.
+pub const BUFFER_METADATA_SIZE: usize = std::mem::size_of::<MetaData>();
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -28,7 +36,7 @@ pub struct BufferPool(Rc<MemoryPool>);
 impl BufferPool {
     pub fn new(buffer_data_size: u16) -> Result<Self, LayoutError> {
         Ok(Self(MemoryPool::new(
-            NonZeroUsize::new(std::mem::size_of::<MetaData>() + buffer_data_size as usize).unwrap(),
+            NonZeroUsize::new(BUFFER_METADATA_SIZE + buffer_data_size as usize).unwrap(),
             NonZeroUsize::new(CPU_DATA_CACHE_LINE_SIZE_IN_BYTES).unwrap(),
         )?))
     }
@@ -13,10 +13,11 @@
 // Note: if compiled without the "libdpdk" feature defined, the DPDK-specific functionality won't be present.
 
 // Note on buffer chain support:
-// DPDK has a concept of MBuf chaining where multiple MBufs may be linked together to form a "packet".  While the
-// DemiBuffer routines for heap-allocated buffers also now support this functionality, it isn't yet exposed via the
-// DemiBuffer interface.
-// TODO: Expose buffer chain support once we have a solid use case.
+// DPDK has a concept of MBuf chaining where multiple MBufs may be linked together to form a "packet".  The DemiBuffer
+// routines for heap-allocated buffers also support this functionality.  Chains are built with chain(), and back the
+// scatter-gather arrays with multiple segments.  Note that len(), deref(), adjust() and split_back() only operate on
+// the first segment of a chain, so code that may receive a chain should use total_len() and segments(), or take the
+// chain apart with into_segments().
 
 // Note on intrusive queueing:
 // Since all DemiBuffer types keep the metadata for each "view" in a separate allocated region, they can be queued
@@ -30,11 +31,12 @@
 
 #[cfg(feature = "libdpdk")]
 use crate::runtime::libdpdk::{
-    rte_errno, rte_mbuf, rte_mempool, rte_pktmbuf_adj, rte_pktmbuf_clone, rte_pktmbuf_free, rte_pktmbuf_prepend,
-    rte_pktmbuf_trim,
+    rte_errno, rte_mbuf, rte_mempool, rte_pktmbuf_adj, rte_pktmbuf_chain, rte_pktmbuf_clone, rte_pktmbuf_free,
+    rte_pktmbuf_prepend, rte_pktmbuf_trim,
 };
 use crate::{
     pal::CPU_DATA_CACHE_LINE_SIZE_IN_BYTES,
+    perftools::stats::{self, Counter},
     runtime::{
         fail::Fail,
         memory::{
@@ -110,8 +112,8 @@ pub(super) struct MetaData {
     // Pointer to the MetaData of the next segment in this packet's chain (must be NULL in last segment).
     next: Option<NonNull<MetaData>>,
 
-    // Various fields for TX offload.
-    _tx_offload: MaybeUninit<u64>,
+    // Various fields for TX offload (L2/L3/L4 header lengths and TSO segment size).
+    tx_offload: u64,
 
     // Pointer to shared info. Used to manage external buffers.
     _shinfo: MaybeUninit<u64>,
@@ -171,6 +173,11 @@ const _: () = assert!(std::mem::size_of::<Option<Rc<MemoryPool>>>() == std::mem:
 // points to another MetaData's directly attached data.
 const METADATA_F_INDIRECT: u64 = 1 << 62;
 
+// Position of the TSO segment size in the TX offload field. This exactly mimics the tx_offload bitfield of DPDK MBufs,
+// which packs l2_len (7 bits), l3_len (9 bits) and l4_len (8 bits) before tso_segsz (16 bits).
+const METADATA_TX_OFFLOAD_TSO_SEGSZ_SHIFT: u64 = 24;
+const METADATA_TX_OFFLOAD_TSO_SEGSZ_MASK: u64 = 0xffff << METADATA_TX_OFFLOAD_TSO_SEGSZ_SHIFT;
+
 impl MetaData {
     // Note on Reference Counts:
     // Since we are currently single-threaded, there is no need to use atomic operations for refcnt manipulations.
@@ -191,6 +198,7 @@ impl MetaData {
             buf_len: values.buf_len,
             pool: values.pool,
             next: values.next,
+            tx_offload: 0,
 
             // Unused fields
             _buf_iova: MaybeUninit::uninit(),
@@ -201,7 +209,6 @@ impl MetaData {
             _various1: MaybeUninit::uninit(),
             _various2: MaybeUninit::uninit(),
             _vlan_tci_outer: MaybeUninit::uninit(),
-            _tx_offload: MaybeUninit::uninit(),
             _timesync: MaybeUninit::uninit(),
             _dynfield: MaybeUninit::uninit(),
 
@@ -346,7 +353,10 @@ impl DemiBuffer {
     pub fn new_in_pool(pool: &BufferPool) -> Option<Self> {
         let buffer: PoolBuf = match pool.pool().get() {
             Some(buffer) => buffer,
-            None => return None,
+            None => {
+                stats::count(Counter::MempoolExhausted, 1);
+                return None;
+            },
         };
 
         let (mut buffer, pool): (NonNull<[MaybeUninit<u8>]>, Rc<MemoryPool>) = PoolBuf::into_raw(buffer);
@@ -366,6 +376,35 @@ impl DemiBuffer {
         ))
     }
 
+    /// Create a new buffer with `capacity` bytes of data after `headroom` bytes of reserved headroom, using a buffer
+    /// from the specified [`BufferPool`]. If the pool is empty, this method returns `None`. The buffers of the pool must
+    /// be large enough to hold both the data and the headroom.
+    pub fn new_in_pool_with_headroom(pool: &BufferPool, capacity: u16, headroom: u16) -> Option<Self> {
+        let buffer: PoolBuf = match pool.pool().get() {
+            Some(buffer) => buffer,
+            None => {
+                stats::count(Counter::MempoolExhausted, 1);
+                return None;
+            },
+        };
+
+        let (mut buffer, pool): (NonNull<[MaybeUninit<u8>]>, Rc<MemoryPool>) = PoolBuf::into_raw(buffer);
+
+        // Safety: the buffer size and alignment requirements are enforced by BufferPool.
+        let (metadata_buf, buffer): (&mut MaybeUninit<MetaData>, &mut [MaybeUninit<u8>]) =
+            unsafe { split_buffer_for_metadata(buffer.as_mut()) };
+
+        assert!(capacity as usize + headroom as usize <= buffer.len());
+
+        Some(Self::new_from_parts(
+            metadata_buf,
+            buffer.as_mut_ptr(),
+            headroom,
+            capacity,
+            Some(pool),
+        ))
+    }
+
     /// Create a new DemiBuffer in the specified memory, with relevant configuration values.
     fn new_from_parts(
         metadata_buf: &mut MaybeUninit<MetaData>,
@@ -726,6 +765,184 @@ impl DemiBuffer {
         Ok(cloned_buf)
     }
 
+    /// Returns the total length of the data stored in all segments of the `DemiBuffer` chain.
+    pub fn total_len(&self) -> usize {
+        self.segments().map(|segment: &[u8]| segment.len()).sum()
+    }
+
+    /// Returns the number of segments in the `DemiBuffer` chain.
+    pub fn num_segments(&self) -> usize {
+        // Note: Since MetaData mimics the layout of DPDK MBufs, this works for DPDK-allocated buffers as well.
+        self.as_metadata().nb_segs as usize
+    }
+
+    /// Returns an iterator over the data of the segments in the `DemiBuffer` chain, in order.
+    pub fn segments(&self) -> Segments<'_> {
+        Segments {
+            next: Some(self.get_ptr::<MetaData>()),
+            _phantom: PhantomData,
+        }
+    }
+
+    /// Appends the `tail` chain to the end of the `DemiBuffer` chain. Both buffers must be of the same type.
+    pub fn chain(&mut self, tail: DemiBuffer) -> Result<(), Fail> {
+        if self.get_tag() != tail.get_tag() {
+            let cause: String = format!("cannot chain buffers of different types");
+            error!("chain(): {}", &cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        match self.get_tag() {
+            Tag::Heap => {
+                let md_tail: &mut MetaData = tail.as_metadata();
+                let md_first: &mut MetaData = self.as_metadata();
+                md_first.nb_segs = match md_first.nb_segs.checked_add(md_tail.nb_segs) {
+                    Some(nb_segs) => nb_segs,
+                    None => {
+                        let cause: String = format!("too many segments in buffer chain");
+                        error!("chain(): {}", &cause);
+                        return Err(Fail::new(libc::EOVERFLOW, &cause));
+                    },
+                };
+                md_first.pkt_len += md_tail.pkt_len;
+                md_first.get_last_segment().next = Some(tail.get_ptr::<MetaData>());
+            },
+            #[cfg(feature = "libdpdk")]
+            Tag::Dpdk => {
+                // Safety: rte_pktmbuf_chain is a FFI, which is safe since we call it with actual MBuf pointers.
+                if unsafe { rte_pktmbuf_chain(self.as_mbuf(), tail.as_mbuf()) } != 0 {
+                    let cause: String = format!("too many segments in buffer chain");
+                    error!("chain(): {}", &cause);
+                    return Err(Fail::new(libc::EOVERFLOW, &cause));
+                }
+            },
+        }
+
+        // The chain now holds the reference of `tail`.
+        mem::forget(tail);
+        Ok(())
+    }
+
+    /// Splits the `DemiBuffer` chain at the given `offset` and returns a new chain containing the data before the split
+    /// point. The data after the split point stays in the original chain. No data is copied: whole segments are moved
+    /// from one chain to the other, and the segment that straddles the split point (if any) is cloned.
+    pub fn split_chain_front(&mut self, offset: usize) -> Result<Self, Fail> {
+        if !self.is_multi_segment() {
+            return self.split_front(offset);
+        }
+
+        // Check if split offset is valid.
+        if self.total_len() < offset {
+            let cause: String = format!("cannot split buffer chain at given offset (offset={:?})", offset);
+            error!("split_chain_front(): {}", &cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        let mut front: Option<DemiBuffer> = None;
+        let mut back: Option<DemiBuffer> = None;
+        let mut remaining: usize = offset;
+        for mut segment in mem::replace(self, DemiBuffer::new(0)).into_segments() {
+            if remaining > 0 && remaining >= segment.len() {
+                remaining -= segment.len();
+                Self::append_segment(&mut front, segment)?;
+            } else {
+                if remaining > 0 {
+                    Self::append_segment(&mut front, segment.split_front(remaining)?)?;
+                    remaining = 0;
+                }
+                Self::append_segment(&mut back, segment)?;
+            }
+        }
+
+        *self = back.unwrap_or_else(|| DemiBuffer::new(0));
+        Ok(front.unwrap_or_else(|| DemiBuffer::new(0)))
+    }
+
+    /// Appends `segment` to the end of the chain that starts at `head`, which becomes `segment` if there is none.
+    fn append_segment(head: &mut Option<DemiBuffer>, segment: DemiBuffer) -> Result<(), Fail> {
+        match head {
+            Some(head) => head.chain(segment),
+            None => {
+                *head = Some(segment);
+                Ok(())
+            },
+        }
+    }
+
+    /// Takes the `DemiBuffer` chain apart, returning its segments in order as single-segment buffers.
+    pub fn into_segments(self) -> Vec<DemiBuffer> {
+        let tag: usize = usize::from(self.tagged_ptr.addr()) & Tag::MASK;
+        let mut segments: Vec<DemiBuffer> = Vec::with_capacity(self.num_segments());
+        let mut next_entry: Option<NonNull<MetaData>> = Some(self.get_ptr::<MetaData>());
+        // The segments take over the references of the chain.
+        mem::forget(self);
+
+        while let Some(mut entry) = next_entry {
+            // Safety: This is safe, as `entry` is aligned, dereferenceable, and the MetaData struct it points to is
+            // initialized.  Since MetaData mimics the layout of DPDK MBufs, this works for MBuf chains as well.
+            let metadata: &mut MetaData = unsafe { entry.as_mut() };
+            next_entry = metadata.next.take();
+            metadata.nb_segs = 1;
+            metadata.pkt_len = metadata.data_len as u32;
+            segments.push(DemiBuffer {
+                tagged_ptr: entry.with_addr(entry.addr() | tag),
+                _phantom: PhantomData,
+            });
+        }
+
+        segments
+    }
+
+    /// Copies the data of all segments in the `DemiBuffer` chain into a new single-segment heap-allocated buffer, with
+    /// `headroom` bytes reserved in front of the data.
+    pub fn coalesce(&self, headroom: u16) -> Result<DemiBuffer, Fail> {
+        let total_len: usize = self.total_len();
+        if total_len + headroom as usize > u16::MAX as usize {
+            let cause: String = format!("buffer chain is too long to coalesce (len={:?})", total_len);
+            error!("coalesce(): {}", &cause);
+            return Err(Fail::new(libc::EMSGSIZE, &cause));
+        }
+
+        let mut buf: DemiBuffer = DemiBuffer::new_with_headroom(total_len as u16, headroom);
+        let mut offset: usize = 0;
+        for segment in self.segments() {
+            buf[offset..(offset + segment.len())].copy_from_slice(segment);
+            offset += segment.len();
+        }
+
+        Ok(buf)
+    }
+
+    /// Removes all data from the `DemiBuffer` chain.
+    pub fn clear(&mut self) {
+        let mut next_entry: Option<NonNull<MetaData>> = Some(self.get_ptr::<MetaData>());
+        while let Some(mut entry) = next_entry {
+            // Safety: This is safe, as `entry` is aligned, dereferenceable, and the MetaData struct it points to is
+            // initialized.  Since MetaData mimics the layout of DPDK MBufs, this works for MBuf chains as well.
+            let metadata: &mut MetaData = unsafe { entry.as_mut() };
+            next_entry = metadata.next;
+            metadata.data_len = 0;
+        }
+        self.as_metadata().pkt_len = 0;
+    }
+
+    /// Returns the size of the segments into which the NIC should cut this packet on transmission, or zero if the packet
+    /// should be sent as it is (see [DemiBuffer::set_tso_segment_size]).
+    pub fn tso_segment_size(&self) -> u16 {
+        let metadata: &mut MetaData = self.as_metadata();
+        ((metadata.tx_offload & METADATA_TX_OFFLOAD_TSO_SEGSZ_MASK) >> METADATA_TX_OFFLOAD_TSO_SEGSZ_SHIFT) as u16
+    }
+
+    /// Asks the NIC to cut this packet into segments of `size` bytes of payload on transmission (TCP segmentation
+    /// offload). A size of zero sends the packet as it is. Physical layers that do not support segmentation offload
+    /// ignore this.
+    // Note: Since MetaData mimics the layout of DPDK MBufs, this sets the tso_segsz field of DPDK-allocated buffers.
+    pub fn set_tso_segment_size(&mut self, size: u16) {
+        let metadata: &mut MetaData = self.as_metadata();
+        metadata.tx_offload = (metadata.tx_offload & !METADATA_TX_OFFLOAD_TSO_SEGSZ_MASK)
+            | ((size as u64) << METADATA_TX_OFFLOAD_TSO_SEGSZ_SHIFT);
+    }
+
     /// Consumes the `DemiBuffer`, returning a raw token (useful for FFI) that can be used with `from_raw()`.
     // Note the type of the token is arbitrary, it should be treated as an opaque value.
     pub fn into_raw(self) -> NonNull<u8> {
@@ -801,7 +1018,7 @@ impl DemiBuffer {
     ///
     /// If the target [DemiBuffer] has multiple segments, `true` is returned. Otherwise, `false` is returned instead.
     ///
-    fn is_multi_segment(&self) -> bool {
+    pub fn is_multi_segment(&self) -> bool {
         match self.get_tag() {
             Tag::Heap => {
                 let md_front: &MetaData = self.as_metadata();
@@ -909,6 +1126,38 @@ fn free_metadata_data(mut buffer: NonNull<MetaData>) {
     }
 }
 
+// ---------------------
+// Segment Iterator
+// ---------------------
+
+/// Iterator over the data of the segments in a [DemiBuffer] chain (see [DemiBuffer::segments]).
+pub struct Segments<'a> {
+    next: Option<NonNull<MetaData>>,
+    _phantom: PhantomData<&'a DemiBuffer>,
+}
+
+impl<'a> Iterator for Segments<'a> {
+    type Item = &'a [u8];
+
+    fn next(&mut self) -> Option<&'a [u8]> {
+        // Safety: This is safe, as the pointer is aligned, dereferenceable, and the MetaData struct it points to is
+        // initialized.  The segment outlives the iterator, since the iterator borrows the chain.
+        let metadata: &'a MetaData = unsafe { self.next?.as_ref() };
+        self.next = metadata.next;
+        if metadata.data_len == 0 {
+            return Some(&[]);
+        }
+        // Safety: The call to from_raw_parts is safe, as its arguments refer to a valid readable memory region within
+        // the segment's buffer.
+        Some(unsafe {
+            slice::from_raw_parts(
+                metadata.buf_addr.offset(metadata.data_off as isize),
+                metadata.data_len as usize,
+            )
+        })
+    }
+}
+
 // ---------------------
 // Trait Implementations
 // ---------------------
@@ -1382,4 +1631,91 @@ mod tests {
 
         Ok(())
     }
+
+    // Test building, cloning, walking, and taking apart buffer chains.
+    #[test]
+    fn chain() -> Result<()> {
+        let parts: [&[u8]; 3] = [b"header", b"a somewhat longer body", b"trailer"];
+        let mut buf: DemiBuffer = DemiBuffer::from_slice(parts[0])?;
+        crate::ensure_eq!(buf.is_multi_segment(), false);
+        buf.chain(DemiBuffer::from_slice(parts[1])?)?;
+        buf.chain(DemiBuffer::from_slice(parts[2])?)?;
+        crate::ensure_eq!(buf.is_multi_segment(), true);
+        crate::ensure_eq!(buf.num_segments(), 3);
+        crate::ensure_eq!(buf.len(), parts[0].len());
+        crate::ensure_eq!(buf.total_len(), parts.concat().len());
+
+        // A clone has the same segments.
+        let clone: DemiBuffer = buf.clone();
+        crate::ensure_eq!(clone.num_segments(), 3);
+        crate::ensure_eq!(clone.segments().collect::<Vec<&[u8]>>(), parts.to_vec());
+        crate::ensure_eq!(&clone.coalesce(0)?[..], &parts.concat()[..]);
+
+        // Taking the original apart leaves the clone untouched.
+        let segments: Vec<DemiBuffer> = buf.into_segments();
+        crate::ensure_eq!(segments.len(), 3);
+        for (segment, part) in segments.iter().zip(parts.iter()) {
+            crate::ensure_eq!(segment.num_segments(), 1);
+            crate::ensure_eq!(&segment[..], *part);
+        }
+        crate::ensure_eq!(clone.total_len(), parts.concat().len());
+
+        // Clearing a chain empties every segment.
+        let mut clone: DemiBuffer = clone;
+        clone.clear();
+        crate::ensure_eq!(clone.total_len(), 0);
+        crate::ensure_eq!(clone.num_segments(), 3);
+
+        Ok(())
+    }
+
+    // Test splitting a buffer chain inside a segment and at a segment boundary.
+    #[test]
+    fn split_chain_front() -> Result<()> {
+        let parts: [&[u8]; 3] = [b"header", b"body", b"trailer"];
+        let mut buf: DemiBuffer = DemiBuffer::from_slice(parts[0])?;
+        buf.chain(DemiBuffer::from_slice(parts[1])?)?;
+        buf.chain(DemiBuffer::from_slice(parts[2])?)?;
+
+        // Split inside the second segment.
+        let front: DemiBuffer = buf.split_chain_front(8)?;
+        crate::ensure_eq!(front.num_segments(), 2);
+        crate::ensure_eq!(&front.coalesce(0)?[..], b"headerbo");
+        crate::ensure_eq!(buf.num_segments(), 2);
+        crate::ensure_eq!(&buf.coalesce(0)?[..], b"dytrailer");
+
+        // Split at the segment boundary.
+        let front: DemiBuffer = buf.split_chain_front(2)?;
+        crate::ensure_eq!(front.num_segments(), 1);
+        crate::ensure_eq!(&front[..], b"dy");
+        crate::ensure_eq!(buf.num_segments(), 1);
+        crate::ensure_eq!(&buf[..], b"trailer");
+
+        // Splitting beyond the end of the chain fails.
+        let mut buf: DemiBuffer = DemiBuffer::from_slice(parts[0])?;
+        buf.chain(DemiBuffer::from_slice(parts[1])?)?;
+        crate::ensure_eq!(buf.split_chain_front(11).is_err(), true);
+        crate::ensure_eq!(buf.total_len(), 10);
+
+        Ok(())
+    }
+
+    // Test that setting the TSO segment size leaves the data untouched and that clones start without one.
+    #[test]
+    fn tso_segment_size() -> Result<()> {
+        let mut buf: DemiBuffer = DemiBuffer::new(4096);
+        crate::ensure_eq!(buf.tso_segment_size(), 0);
+
+        buf.set_tso_segment_size(1450);
+        crate::ensure_eq!(buf.tso_segment_size(), 1450);
+        crate::ensure_eq!(buf.len(), 4096);
+
+        let clone: DemiBuffer = buf.clone();
+        crate::ensure_eq!(clone.tso_segment_size(), 0);
+
+        buf.set_tso_segment_size(0);
+        crate::ensure_eq!(buf.tso_segment_size(), 0);
+
+        Ok(())
+    }
 }
@@ -4,6 +4,8 @@
 mod buffer_pool;
 mod demibuffer;
 mod memory_pool;
+mod prefault;
+mod size_class_pool;
 
 //======================================================================================================================
 // Imports
@@ -11,7 +13,7 @@ mod memory_pool;
 
 use crate::runtime::{
     fail::Fail,
-    types::{demi_sgarray_t, demi_sgaseg_t},
+    types::{demi_sgarray_t, demi_sgaseg_t, DEMI_SGARRAY_MAXLEN},
 };
 use ::libc::c_void;
 use ::std::{
@@ -23,7 +25,16 @@ use ::std::{
 // Exports
 //======================================================================================================================
 
-pub use self::{buffer_pool::*, demibuffer::*};
+pub use self::{buffer_pool::*, demibuffer::*, prefault::*, size_class_pool::*};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Maximum size of a single segment of a scatter-gather array. A buffer cannot hold more than [u16::MAX] bytes, so
+/// this leaves room for the headroom that is reserved in front of the data for packet headers (must match
+/// `DEMI_SGASEG_MAXSIZE` in `include/demi/types.h`).
+pub const DEMI_SGASEG_MAXSIZE: usize = 63 * 1024;
 
 //======================================================================================================================
 // Traits
@@ -36,136 +47,219 @@ pub use self::{buffer_pool::*, demibuffer::*};
 pub trait MemoryRuntime {
     /// Converts a buffer into a scatter-gather array.
     fn into_sgarray(&self, buf: DemiBuffer) -> Result<demi_sgarray_t, Fail> {
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: buf.len() as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+        buffer_into_sgarray(buf)
     }
 
-    /// Allocates a scatter-gather array.
+    /// Allocates a scatter-gather array. Sizes that do not fit in a single segment are spread across several segments.
     fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // TODO: Allocate an array of buffers if requested size is too large for a single buffer.
-
         // We can't allocate a zero-sized buffer.
         if size == 0 {
-            let cause: String = format!("cannot allocate a zero-sized buffer");
+            let cause: &str = "cannot allocate a zero-sized buffer";
             error!("sgaalloc(): {}", cause);
-            return Err(Fail::new(libc::EINVAL, &cause));
+            return Err(Fail::new(libc::EINVAL, cause));
         }
 
-        // We can't allocate more than a single buffer.
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
+        // We can't allocate more than the segments of a single scatter-gather array can hold.
+        if size > DEMI_SGARRAY_MAXLEN * DEMI_SGASEG_MAXSIZE {
+            let cause: String = format!("size too large for a single demi_sgarray_t (size={:?})", size);
+            error!("sgaalloc(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
         }
 
-        // First allocate the underlying DemiBuffer.
-        let buf: DemiBuffer = DemiBuffer::new(size as u16);
-
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
+        let mut seglens: [usize; DEMI_SGARRAY_MAXLEN] = [DEMI_SGASEG_MAXSIZE; DEMI_SGARRAY_MAXLEN];
+        let numsegs: usize = size.div_ceil(DEMI_SGASEG_MAXSIZE);
+        seglens[numsegs - 1] = size - (numsegs - 1) * DEMI_SGASEG_MAXSIZE;
+        self.sgaallocv(&seglens[..numsegs])
+    }
+
+    /// Allocates a scatter-gather array with one segment of each of the sizes in `seglens`.
+    fn sgaallocv(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
+        alloc_sgarray(seglens, |size: usize| -> Result<DemiBuffer, Fail> {
+            Ok(DemiBuffer::new(size as u16))
         })
     }
 
     /// Releases a scatter-gather array.
     fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
-        // Check arguments.
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
+        free_sgarray(sga)
+    }
+
+    /// Clones a scatter-gather array. The segments of the scatter-gather array are chained together in the returned
+    /// buffer.
+    fn clone_sgarray(&self, sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
+        clone_sgarray(sga)
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Converts a buffer chain into a scatter-gather array with one segment for each buffer in the chain. The
+/// scatter-gather array inherits the reference of the chain.
+pub fn buffer_into_sgarray(buf: DemiBuffer) -> Result<demi_sgarray_t, Fail> {
+    let numsegs: usize = buf.num_segments();
+    if numsegs > DEMI_SGARRAY_MAXLEN {
+        let cause: String = format!("too many segments for a single demi_sgarray_t (numsegs={:?})", numsegs);
+        error!("into_sgarray(): {}", cause);
+        return Err(Fail::new(libc::EMSGSIZE, &cause));
+    }
+
+    // Create a scatter-gather segment to expose each buffer of the chain to the user.
+    let mut sga_segs: [demi_sgaseg_t; DEMI_SGARRAY_MAXLEN] = [demi_sgaseg_t {
+        sgaseg_buf: ptr::null_mut(),
+        sgaseg_len: 0,
+    }; DEMI_SGARRAY_MAXLEN];
+    for (sga_seg, segment) in sga_segs.iter_mut().zip(buf.segments()) {
+        sga_seg.sgaseg_buf = segment.as_ptr() as *mut c_void;
+        sga_seg.sgaseg_len = segment.len() as u32;
+    }
+
+    // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
+    Ok(demi_sgarray_t {
+        sga_buf: buf.into_raw().as_ptr() as *mut c_void,
+        sga_numsegs: numsegs as u32,
+        sga_segs,
+        sga_addr: unsafe { mem::zeroed() },
+    })
+}
+
+/// Allocates a scatter-gather array with one segment of each of the sizes in `seglens`, using `alloc_segment` to
+/// allocate the buffer of each segment.
+pub fn alloc_sgarray<F>(seglens: &[usize], mut alloc_segment: F) -> Result<demi_sgarray_t, Fail>
+where
+    F: FnMut(usize) -> Result<DemiBuffer, Fail>,
+{
+    if seglens.is_empty() || seglens.len() > DEMI_SGARRAY_MAXLEN {
+        let cause: String = format!("invalid number of segments (numsegs={:?})", seglens.len());
+        error!("sgaalloc(): {}", cause);
+        return Err(Fail::new(libc::EINVAL, &cause));
+    }
+
+    let mut head: Option<DemiBuffer> = None;
+    for size in seglens.iter().copied() {
+        // We can't allocate zero-sized segments, nor segments that do not fit in a single buffer.
+        if size == 0 || size > DEMI_SGASEG_MAXSIZE {
+            let cause: String = format!("invalid segment size (size={:?})", size);
+            error!("sgaalloc(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
         }
 
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
+        // Any segments that were already allocated are released on failure.
+        let segment: DemiBuffer = alloc_segment(size)?;
+        match head {
+            Some(ref mut head) => head.chain(segment)?,
+            None => head = Some(segment),
         }
+    }
 
-        // Convert back to a DemiBuffer and drop it.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
-        drop(buf);
+    // This unwrap won't panic as we checked above that there is at least one segment.
+    buffer_into_sgarray(head.unwrap())
+}
 
-        Ok(())
+/// Releases a scatter-gather array, along with all of its segments.
+pub fn free_sgarray(sga: demi_sgarray_t) -> Result<(), Fail> {
+    // Check arguments.
+    if sga.sga_numsegs == 0 || sga.sga_numsegs as usize > DEMI_SGARRAY_MAXLEN {
+        return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
     }
 
-    /// Clones a scatter-gather array.
-    fn clone_sgarray(&self, sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
-        // Check arguments.
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
-        }
+    if sga.sga_buf == ptr::null_mut() {
+        return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
+    }
+
+    // Convert back to a DemiBuffer and drop it.
+    // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
+    let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
+    // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
+    // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
+    let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
+    drop(buf);
+
+    Ok(())
+}
+
+/// Clones a scatter-gather array into a buffer chain with one buffer for each segment.
+pub fn clone_sgarray(sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
+    // Check arguments.
+    let numsegs: usize = sga.sga_numsegs as usize;
+    if numsegs == 0 || numsegs > DEMI_SGARRAY_MAXLEN {
+        return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
+    }
+
+    if sga.sga_buf == ptr::null_mut() {
+        return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
+    }
 
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
+    // Convert back to a DemiBuffer.
+    // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
+    let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
+    // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
+    // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
+    let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
+    let mut clone: DemiBuffer = buf.clone();
+
+    // Don't drop buf, as it holds the same reference to the data as the sgarray (which should keep it).
+    mem::forget(buf);
+
+    if clone.num_segments() != numsegs {
+        return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
+    }
+
+    // Fast path for scatter-gather arrays with a single segment.
+    if numsegs == 1 {
+        adjust_to_sgaseg(&mut clone, &sga.sga_segs[0])?;
+        return Ok(clone);
+    }
+
+    // Adjust every segment on its own, and then chain them back together.
+    let mut head: Option<DemiBuffer> = None;
+    for (mut segment, sga_seg) in clone.into_segments().into_iter().zip(sga.sga_segs.iter()) {
+        adjust_to_sgaseg(&mut segment, sga_seg)?;
+        match head {
+            Some(ref mut head) => head.chain(segment)?,
+            None => head = Some(segment),
         }
+    }
 
-        // Convert back to a DemiBuffer.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
-        let mut clone: DemiBuffer = buf.clone();
-
-        // Don't drop buf, as it holds the same reference to the data as the sgarray (which should keep it).
-        mem::forget(buf);
-
-        // Check to see if the user has reduced the size of the buffer described by the sgarray segment since we
-        // provided it to them.  They could have increased the starting address of the buffer (`sgaseg_buf`),
-        // decreased the ending address of the buffer (`sgaseg_buf + sgaseg_len`), or both.
-        let sga_data: *const u8 = sga.sga_segs[0].sgaseg_buf as *const u8;
-        let sga_len: usize = sga.sga_segs[0].sgaseg_len as usize;
-        let clone_data: *const u8 = clone.as_ptr();
-        let mut clone_len: usize = clone.len();
-        if sga_data != clone_data || sga_len != clone_len {
-            // We need to adjust the DemiBuffer to match the user's changes.
-
-            // First check that the user didn't do something non-sensical, like change the buffer description to
-            // reference address space outside of the DemiBuffer's allocated memory area.
-            if sga_data < clone_data || sga_data.addr() + sga_len > clone_data.addr() + clone_len {
-                return Err(Fail::new(
-                    libc::EINVAL,
-                    "demi_sgarray_t describes data outside backing buffer's allocated region",
-                ));
-            }
-
-            // Calculate the amount the new starting address is ahead of the old.  And then adjust `clone` to match.
-            let adjustment_amount: usize = sga_data.addr() - clone_data.addr();
-            clone.adjust(adjustment_amount)?;
-
-            // An adjustment above would have reduced clone.len() by the adjustment amount.
-            clone_len -= adjustment_amount;
-            debug_assert_eq!(clone_len, clone.len());
-
-            // Trim the clone down to size.
-            let trim_amount: usize = clone_len - sga_len;
-            clone.trim(trim_amount)?;
+    // Return the clone.
+    // This unwrap won't panic as we checked above that there is more than one segment.
+    Ok(head.unwrap())
+}
+
+/// Adjusts a single-segment buffer to match the user's changes to the scatter-gather segment that exposes it.
+fn adjust_to_sgaseg(buf: &mut DemiBuffer, sga_seg: &demi_sgaseg_t) -> Result<(), Fail> {
+    // Check to see if the user has reduced the size of the buffer described by the sgarray segment since we
+    // provided it to them.  They could have increased the starting address of the buffer (`sgaseg_buf`),
+    // decreased the ending address of the buffer (`sgaseg_buf + sgaseg_len`), or both.
+    let sga_data: *const u8 = sga_seg.sgaseg_buf as *const u8;
+    let sga_len: usize = sga_seg.sgaseg_len as usize;
+    let buf_data: *const u8 = buf.as_ptr();
+    let mut buf_len: usize = buf.len();
+    if sga_data != buf_data || sga_len != buf_len {
+        // We need to adjust the DemiBuffer to match the user's changes.
+
+        // First check that the user didn't do something non-sensical, like change the buffer description to
+        // reference address space outside of the DemiBuffer's allocated memory area.
+        if sga_data < buf_data || sga_data.addr() + sga_len > buf_data.addr() + buf_len {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "demi_sgarray_t describes data outside backing buffer's allocated region",
+            ));
         }
 
-        // Return the clone.
-        Ok(clone)
+        // Calculate the amount the new starting address is ahead of the old.  And then adjust `buf` to match.
+        let adjustment_amount: usize = sga_data.addr() - buf_data.addr();
+        buf.adjust(adjustment_amount)?;
+
+        // An adjustment above would have reduced buf.len() by the adjustment amount.
+        buf_len -= adjustment_amount;
+        debug_assert_eq!(buf_len, buf.len());
+
+        // Trim the buffer down to size.
+        let trim_amount: usize = buf_len - sga_len;
+        buf.trim(trim_amount)?;
     }
+
+    Ok(())
 }
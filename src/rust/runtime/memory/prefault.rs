@@ -0,0 +1,168 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Prefaulting.
+//!
+//! Memory that was mapped but never touched takes a page fault on first access, which lands on the data path the
+//! first time a buffer is used. Prefaulting touches every page of a pool up front instead, splitting large pools
+//! across threads, and locks the pool in memory so that its pages are never swapped out afterwards.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::fail::Fail;
+use ::std::{
+    mem::MaybeUninit,
+    ptr,
+    sync::atomic::{AtomicUsize, Ordering},
+    thread,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Stride at which memory is touched. Hugepages are multiples of this size, so this touches every page of any size.
+const TOUCH_STRIDE: usize = 4096;
+
+/// Size of the pieces that memory is split into for touching. Less memory than this is not worth a thread of its own.
+const PIECE_SIZE: usize = 64 * 1024 * 1024;
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Faults in every page of the memory spans in `spans`, each given as its start address and length, and locks them in
+/// memory. Pages are touched by as many threads as there are cores, up to one thread per [PIECE_SIZE] bytes. The
+/// contents of the memory are left unchanged. Locking fails if it exceeds `RLIMIT_MEMLOCK`, but the memory is faulted
+/// in regardless.
+///
+/// # Safety
+///
+/// Every span must be valid for reads and writes, and nothing else may access it while this runs.
+pub unsafe fn prefault(spans: &[(*mut u8, usize)]) -> Result<(), Fail> {
+    touch_all(spans, PIECE_SIZE);
+    for (addr, len) in spans {
+        lock(*addr, *len)?;
+    }
+    Ok(())
+}
+
+/// Touches every page of the memory spans in `spans`, split into pieces of at most `piece_size` bytes.
+unsafe fn touch_all(spans: &[(*mut u8, usize)], piece_size: usize) {
+    let pieces: Vec<(usize, usize)> = split(spans, piece_size);
+    let num_threads: usize = match thread::available_parallelism() {
+        Ok(n) => n.get().min(pieces.len()),
+        Err(_) => 1,
+    };
+
+    // Threads take the next piece that nobody has taken yet, so a slow thread does not hold up the others.
+    let next: AtomicUsize = AtomicUsize::new(0);
+    let touch_pieces = || {
+        while let Some((addr, len)) = pieces.get(next.fetch_add(1, Ordering::Relaxed)) {
+            // The caller guarantees that the piece is valid and not accessed by anything else.
+            touch(*addr as *mut u8, *len);
+        }
+    };
+    if num_threads > 1 {
+        thread::scope(|s| {
+            for _ in 0..num_threads {
+                s.spawn(touch_pieces);
+            }
+        });
+    } else {
+        touch_pieces();
+    }
+}
+
+/// Splits memory spans into pieces of at most `piece_size` bytes, given as their start address and length.
+fn split(spans: &[(*mut u8, usize)], piece_size: usize) -> Vec<(usize, usize)> {
+    let mut pieces: Vec<(usize, usize)> = Vec::new();
+    for (addr, len) in spans {
+        let mut offset: usize = 0;
+        while offset < *len {
+            let piece_len: usize = piece_size.min(*len - offset);
+            pieces.push((*addr as usize + offset, piece_len));
+            offset += piece_len;
+        }
+    }
+    pieces
+}
+
+/// Touches every page of `len` bytes at `addr`, by writing back what every page holds.
+unsafe fn touch(addr: *mut u8, len: usize) {
+    if len == 0 {
+        return;
+    }
+    let base: *mut MaybeUninit<u8> = addr.cast();
+    // The span may start in the middle of a page, so also touch its last byte, which may sit on one more page.
+    for offset in (0..len).step_by(TOUCH_STRIDE).chain([len - 1]) {
+        let byte: *mut MaybeUninit<u8> = base.add(offset);
+        ptr::write_volatile(byte, ptr::read_volatile(byte));
+    }
+}
+
+/// Locks `len` bytes at `addr` in memory.
+#[cfg(target_os = "linux")]
+fn lock(addr: *mut u8, len: usize) -> Result<(), Fail> {
+    if unsafe { libc::mlock(addr as *const libc::c_void, len) } != 0 {
+        let errno: libc::c_int = unsafe { *libc::__errno_location() };
+        let cause: String = format!("failed to lock memory (len={:?}, errno={:?})", len, errno);
+        warn!("lock(): {}", cause);
+        return Err(Fail::new(errno, &cause));
+    }
+    Ok(())
+}
+
+/// Locks `len` bytes at `addr` in memory.
+#[cfg(not(target_os = "linux"))]
+fn lock(_addr: *mut u8, _len: usize) -> Result<(), Fail> {
+    let cause: String = format!("locking memory is not supported on this platform");
+    warn!("lock(): {}", cause);
+    Err(Fail::new(libc::ENOTSUP, &cause))
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::runtime::memory::prefault::{prefault, split, touch_all};
+    use ::anyhow::Result;
+
+    /// Checks that spans are split into pieces that cover them exactly.
+    #[test]
+    fn test_prefault_split_spans() -> Result<()> {
+        let spans: [(*mut u8, usize); 3] = [
+            (0x1000 as *mut u8, 10),
+            (0x10000 as *mut u8, 4),
+            (0x20000 as *mut u8, 0),
+        ];
+        let pieces: Vec<(usize, usize)> = split(&spans, 4);
+        crate::ensure_eq!(pieces, vec![(0x1000, 4), (0x1004, 4), (0x1008, 2), (0x10000, 4)]);
+
+        Ok(())
+    }
+
+    /// Checks that prefaulting leaves the contents of memory unchanged.
+    #[test]
+    fn test_prefault_keeps_contents() -> Result<()> {
+        let mut first: Vec<u8> = (0..3 * 4096 + 17).map(|i: usize| i as u8).collect();
+        let mut second: Vec<u8> = vec![0xab; 100];
+        let spans: [(*mut u8, usize); 2] = [(first.as_mut_ptr(), first.len()), (second.as_mut_ptr(), second.len())];
+
+        // Locking may fail under a low RLIMIT_MEMLOCK, which does not matter here.
+        let _ = unsafe { prefault(&spans) };
+        crate::ensure_eq!(first.iter().enumerate().all(|(i, b)| *b == i as u8), true);
+        crate::ensure_eq!(second.iter().all(|b: &u8| *b == 0xab), true);
+
+        // Small pieces spread the spans across threads.
+        unsafe { touch_all(&spans, 4096) };
+        crate::ensure_eq!(first.iter().enumerate().all(|(i, b)| *b == i as u8), true);
+        crate::ensure_eq!(second.iter().all(|b: &u8| *b == 0xab), true);
+
+        Ok(())
+    }
+}
@@ -0,0 +1,554 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Size-class pools.
+//!
+//! A set of [BufferPool]s that serves the buffers of scatter-gather arrays. Every class holds buffers that take a
+//! power-of-two number of bytes together with their metadata, so that they pack pages without leaving gaps, and hold
+//! from [MIN_SIZE_CLASS] to [MAX_SIZE_CLASS] bytes of data. A request is served by the smallest class that fits it, so a
+//! buffer that is released goes back to its class and is reused by the next request of a similar size, instead of
+//! going through the global allocator on every allocation. Classes grow on demand, one region of [REGION_SIZE] bytes at
+//! a time, and regions may be backed by 2 MB hugepages. Regions may also be prefaulted, so that the first use of a
+//! buffer does not take a page fault. Every class counts the requests that it served from a free buffer (hits) and the
+//! ones that made it grow (misses).
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    demikernel::config::Config,
+    runtime::{
+        fail::Fail,
+        memory::{self, BufferPool, DemiBuffer, BUFFER_METADATA_SIZE},
+    },
+};
+use ::std::{
+    alloc::{self, Layout},
+    cell::{Cell, RefCell},
+    mem::{self, MaybeUninit},
+    num::NonZeroUsize,
+    ptr::NonNull,
+    rc::Rc,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of bytes that a buffer of the smallest class takes, metadata included.
+const MIN_CLASS_FOOTPRINT: usize = 256;
+
+/// Number of bytes that a buffer of the largest class takes, metadata included.
+const MAX_CLASS_FOOTPRINT: usize = 64 * 1024;
+
+/// Number of bytes that a buffer of the smallest class holds.
+pub const MIN_SIZE_CLASS: usize = MIN_CLASS_FOOTPRINT - BUFFER_METADATA_SIZE;
+
+/// Number of bytes that a buffer of the largest class holds. Larger requests, up to [u16::MAX] bytes, are served from
+/// the heap.
+pub const MAX_SIZE_CLASS: usize = MAX_CLASS_FOOTPRINT - BUFFER_METADATA_SIZE;
+
+/// Number of size classes.
+pub const NUM_SIZE_CLASSES: usize = (MAX_CLASS_FOOTPRINT / MIN_CLASS_FOOTPRINT).trailing_zeros() as usize + 1;
+
+/// Size of the regions that classes grow by. This matches the size of a hugepage.
+const REGION_SIZE: usize = 2 * 1024 * 1024;
+
+/// Size of the pages that regions are made of, when they do not come from hugepages.
+const PAGE_SIZE: usize = 4096;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Counters of a size class.
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct SizeClassStats {
+    /// Number of bytes that a buffer of this class holds.
+    pub capacity: usize,
+    /// Number of requests that were served from a free buffer.
+    pub hits: u64,
+    /// Number of requests that found no free buffer and made the class grow.
+    pub misses: u64,
+    /// Number of buffers in the class, whether free or not.
+    pub num_buffers: usize,
+    /// Number of free buffers in the class.
+    pub num_free_buffers: usize,
+}
+
+/// A contiguous span of memory that the buffers of a size class are carved out of.
+struct Region {
+    ptr: NonNull<MaybeUninit<u8>>,
+    /// Whether the region is backed by hugepages.
+    hugepages: bool,
+}
+
+/// A pool of buffers of a single size.
+struct SizeClass {
+    pool: BufferPool,
+    /// Number of bytes that a buffer of this class holds.
+    capacity: usize,
+    /// Regions that hold the buffers of this class.
+    regions: RefCell<Vec<Region>>,
+    /// Number of buffers that were carved out of the regions.
+    num_buffers: Cell<usize>,
+    hits: Cell<u64>,
+    misses: Cell<u64>,
+}
+
+/// A set of pools of buffers, one for every size class.
+pub struct SizeClassPools {
+    classes: Vec<SizeClass>,
+    /// Whether new regions should be backed by hugepages.
+    hugepages: Cell<bool>,
+    /// Whether new regions should be prefaulted and locked in memory.
+    prefault: Cell<bool>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl Region {
+    /// Allocates a new region, backed by hugepages if `hugepages` is set.
+    fn new(hugepages: bool) -> Result<Self, Fail> {
+        if hugepages {
+            return Self::new_on_hugepages();
+        }
+
+        // This unwrap will never panic, as the region has a fixed size and alignment.
+        let layout: Layout = Layout::from_size_align(REGION_SIZE, PAGE_SIZE).unwrap();
+        // Safety: the layout has a non-zero size.
+        match NonNull::new(unsafe { alloc::alloc(layout) }) {
+            Some(ptr) => Ok(Self {
+                ptr: ptr.cast(),
+                hugepages: false,
+            }),
+            None => {
+                let cause: String = format!("failed to allocate region (size={:?})", REGION_SIZE);
+                error!("new(): {}", cause);
+                Err(Fail::new(libc::ENOMEM, &cause))
+            },
+        }
+    }
+
+    /// Maps a new region onto hugepages.
+    #[cfg(target_os = "linux")]
+    fn new_on_hugepages() -> Result<Self, Fail> {
+        let ptr: *mut libc::c_void = unsafe {
+            libc::mmap(
+                ::std::ptr::null_mut(),
+                REGION_SIZE,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_PRIVATE | libc::MAP_ANONYMOUS | libc::MAP_HUGETLB,
+                -1,
+                0,
+            )
+        };
+        if ptr == libc::MAP_FAILED {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            let cause: String = format!("failed to map region onto hugepages (errno={:?})", errno);
+            warn!("new_on_hugepages(): {}", cause);
+            return Err(Fail::new(errno, &cause));
+        }
+        Ok(Self {
+            // This unwrap will never panic, as mmap() does not map anything at address zero.
+            ptr: NonNull::new(ptr.cast()).unwrap(),
+            hugepages: true,
+        })
+    }
+
+    /// Maps a new region onto hugepages.
+    #[cfg(not(target_os = "linux"))]
+    fn new_on_hugepages() -> Result<Self, Fail> {
+        let cause: &str = "hugepages are not supported on this platform";
+        warn!("new_on_hugepages(): {}", cause);
+        Err(Fail::new(libc::ENOTSUP, cause))
+    }
+
+    /// Returns the memory of the region.
+    fn as_slice(&self) -> NonNull<[MaybeUninit<u8>]> {
+        NonNull::slice_from_raw_parts(self.ptr, REGION_SIZE)
+    }
+
+    /// Faults in every page of the region and locks it in memory.
+    fn prefault(&self) -> Result<(), Fail> {
+        // Safety: the region is valid for its whole size and not in use yet, as no buffer was carved out of it.
+        unsafe { memory::prefault(&[(self.ptr.as_ptr().cast(), REGION_SIZE)]) }
+    }
+
+    /// Returns the size of the pages that the region is made of.
+    fn page_size(&self) -> NonZeroUsize {
+        // This unwrap will never panic, as both page sizes are non-zero.
+        NonZeroUsize::new(if self.hugepages { REGION_SIZE } else { PAGE_SIZE }).unwrap()
+    }
+}
+
+impl SizeClass {
+    fn new(capacity: usize) -> Result<Self, Fail> {
+        let pool: BufferPool = match BufferPool::new(capacity as u16) {
+            Ok(pool) => pool,
+            Err(e) => {
+                let cause: String = format!("invalid size class (capacity={:?}): {:?}", capacity, e);
+                error!("new(): {}", cause);
+                return Err(Fail::new(libc::EINVAL, &cause));
+            },
+        };
+        Ok(Self {
+            pool,
+            capacity,
+            regions: RefCell::new(Vec::new()),
+            num_buffers: Cell::new(0),
+            hits: Cell::new(0),
+            misses: Cell::new(0),
+        })
+    }
+
+    /// Adds a new region to the class and carves buffers out of it. The region is prefaulted if `prefault` is set.
+    fn grow(&self, hugepages: bool, prefault: bool) -> Result<(), Fail> {
+        let region: Region = Region::new(hugepages)?;
+        if prefault {
+            if let Err(e) = region.prefault() {
+                warn!(
+                    "grow(): failed to prefault region (capacity={:?}): {:?}",
+                    self.capacity, e
+                );
+            }
+        }
+        let num_free_buffers: usize = self.pool.pool().len();
+        // Safety: the region lives as long as the class, and longer if any of its buffers is still in use.
+        unsafe { self.pool.pool().populate(region.as_slice(), region.page_size())? };
+        self.num_buffers
+            .set(self.num_buffers.get() + self.pool.pool().len() - num_free_buffers);
+        self.regions.borrow_mut().push(region);
+        Ok(())
+    }
+
+    fn stats(&self) -> SizeClassStats {
+        SizeClassStats {
+            capacity: self.capacity,
+            hits: self.hits.get(),
+            misses: self.misses.get(),
+            num_buffers: self.num_buffers.get(),
+            num_free_buffers: self.pool.pool().len(),
+        }
+    }
+}
+
+impl SizeClassPools {
+    /// Creates an empty set of pools. New regions are backed by hugepages if `hugepages` is set.
+    pub fn new(hugepages: bool) -> Result<Rc<Self>, Fail> {
+        let mut classes: Vec<SizeClass> = Vec::with_capacity(NUM_SIZE_CLASSES);
+        for index in 0..NUM_SIZE_CLASSES {
+            classes.push(SizeClass::new(Self::class_capacity(index))?);
+        }
+        Ok(Rc::new(Self {
+            classes,
+            hugepages: Cell::new(hugepages),
+            prefault: Cell::new(false),
+        }))
+    }
+
+    /// Creates a set of pools as set up in `config`. Returns `None` if the pools are disabled.
+    pub fn from_config(config: &Config) -> Result<Option<Rc<Self>>, Fail> {
+        let enabled: bool = match config.sgaalloc_pools() {
+            Ok(enabled) => enabled,
+            Err(_) => {
+                warn!("No setting for scatter-gather array pools. Enabling them by default.");
+                true
+            },
+        };
+        if !enabled {
+            return Ok(None);
+        }
+
+        let hugepages: bool = match config.sgaalloc_hugepages() {
+            Ok(hugepages) => hugepages,
+            Err(_) => {
+                warn!("No setting for scatter-gather array pools on hugepages. Disabling them by default.");
+                false
+            },
+        };
+        let pools: Rc<Self> = Self::new(hugepages)?;
+
+        let prefault: bool = match config.prefault_pools() {
+            Ok(prefault) => prefault,
+            Err(_) => {
+                warn!("No setting for prefaulting pools. Disabling it by default.");
+                false
+            },
+        };
+        if prefault {
+            pools.prefault()?;
+        }
+        Ok(Some(pools))
+    }
+
+    /// Grows every class that has no region yet and prefaults every region that is added from now on, so that classes
+    /// serve their first buffers without taking page faults.
+    pub fn prefault(&self) -> Result<(), Fail> {
+        self.prefault.set(true);
+        for class in self.classes.iter() {
+            if class.num_buffers.get() == 0 {
+                self.grow(class)?;
+            }
+        }
+        Ok(())
+    }
+
+    /// Allocates a buffer that holds `size` bytes of data after `headroom` bytes of reserved headroom. The buffer comes
+    /// from the smallest class that fits both. If no class fits them or that class cannot grow, the buffer comes from
+    /// the heap.
+    pub fn alloc(&self, size: usize, headroom: usize) -> Result<DemiBuffer, Fail> {
+        let class: &SizeClass = match Self::class_index(size + headroom) {
+            Some(index) => &self.classes[index],
+            None if size + headroom <= u16::MAX as usize => {
+                return Ok(DemiBuffer::new_with_headroom(size as u16, headroom as u16))
+            },
+            None => {
+                let cause: String = format!("buffer is too large (size={:?}, headroom={:?})", size, headroom);
+                error!("alloc(): {}", cause);
+                return Err(Fail::new(libc::EINVAL, &cause));
+            },
+        };
+
+        if class.pool.pool().is_empty() {
+            class.misses.set(class.misses.get() + 1);
+            if let Err(e) = self.grow(class) {
+                warn!(
+                    "alloc(): failed to grow size class (capacity={:?}): {:?}",
+                    class.capacity, e
+                );
+                return Ok(DemiBuffer::new_with_headroom(size as u16, headroom as u16));
+            }
+        } else {
+            class.hits.set(class.hits.get() + 1);
+        }
+
+        match DemiBuffer::new_in_pool_with_headroom(&class.pool, size as u16, headroom as u16) {
+            Some(buf) => Ok(buf),
+            None => unreachable!("the size class has free buffers"),
+        }
+    }
+
+    /// Returns the counters of every size class, from the smallest to the largest.
+    pub fn stats(&self) -> impl Iterator<Item = SizeClassStats> + '_ {
+        self.classes.iter().map(SizeClass::stats)
+    }
+
+    /// Grows `class`, falling back to regular pages for good if hugepages run out.
+    fn grow(&self, class: &SizeClass) -> Result<(), Fail> {
+        if self.hugepages.get() {
+            match class.grow(true, self.prefault.get()) {
+                Ok(()) => return Ok(()),
+                Err(_) => {
+                    warn!("grow(): ran out of hugepages, falling back to regular pages");
+                    self.hugepages.set(false);
+                },
+            }
+        }
+        class.grow(false, self.prefault.get())
+    }
+
+    /// Returns the index of the smallest class that holds `size` bytes, if any.
+    fn class_index(size: usize) -> Option<usize> {
+        if size > MAX_SIZE_CLASS {
+            return None;
+        }
+        let footprint: usize = (size + BUFFER_METADATA_SIZE)
+            .max(MIN_CLASS_FOOTPRINT)
+            .next_power_of_two();
+        Some((footprint / MIN_CLASS_FOOTPRINT).trailing_zeros() as usize)
+    }
+
+    /// Returns the number of bytes that a buffer of the class at `index` holds.
+    fn class_capacity(index: usize) -> usize {
+        (MIN_CLASS_FOOTPRINT << index) - BUFFER_METADATA_SIZE
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Drop for Region {
+    fn drop(&mut self) {
+        if self.hugepages {
+            #[cfg(target_os = "linux")]
+            if unsafe { libc::munmap(self.ptr.as_ptr().cast(), REGION_SIZE) } != 0 {
+                let errno: libc::c_int = unsafe { *libc::__errno_location() };
+                warn!("drop(): failed to unmap region (errno={:?})", errno);
+            }
+        } else {
+            // This unwrap will never panic, as the region has a fixed size and alignment.
+            let layout: Layout = Layout::from_size_align(REGION_SIZE, PAGE_SIZE).unwrap();
+            // Safety: the region was allocated with the same layout.
+            unsafe { alloc::dealloc(self.ptr.as_ptr().cast(), layout) };
+        }
+    }
+}
+
+impl Drop for SizeClassPools {
+    fn drop(&mut self) {
+        for class in self.classes.iter() {
+            let stats: SizeClassStats = class.stats();
+            trace!("drop(): {:?}", stats);
+            // Buffers that are still in use keep pointing into the regions of their class, so leak those regions.
+            if stats.num_free_buffers < stats.num_buffers {
+                warn!(
+                    "drop(): leaking regions of size class with buffers in use (capacity={:?}, in_use={:?})",
+                    stats.capacity,
+                    stats.num_buffers - stats.num_free_buffers
+                );
+                mem::forget(class.regions.take());
+            }
+        }
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::runtime::memory::{
+        size_class_pool::{SizeClassPools, SizeClassStats, MAX_SIZE_CLASS, MIN_SIZE_CLASS, NUM_SIZE_CLASSES},
+        DemiBuffer, BUFFER_METADATA_SIZE,
+    };
+    use ::anyhow::Result;
+    use ::std::rc::Rc;
+    use ::test::{black_box, Bencher};
+
+    /// Returns the counters of the class that holds `capacity` bytes.
+    fn stats_of(pools: &SizeClassPools, capacity: usize) -> SizeClassStats {
+        pools
+            .stats()
+            .find(|stats: &SizeClassStats| stats.capacity == capacity)
+            .unwrap()
+    }
+
+    /// Checks that requests are served by the smallest class that fits them.
+    #[test]
+    fn test_size_class_pools_pick_smallest_class() -> Result<()> {
+        crate::ensure_eq!(NUM_SIZE_CLASSES, 9);
+        crate::ensure_eq!(SizeClassPools::class_index(0), Some(0));
+        crate::ensure_eq!(SizeClassPools::class_index(MIN_SIZE_CLASS), Some(0));
+        crate::ensure_eq!(SizeClassPools::class_index(MIN_SIZE_CLASS + 1), Some(1));
+        crate::ensure_eq!(SizeClassPools::class_index(1500), Some(3));
+        crate::ensure_eq!(SizeClassPools::class_index(MAX_SIZE_CLASS), Some(NUM_SIZE_CLASSES - 1));
+        crate::ensure_eq!(SizeClassPools::class_index(MAX_SIZE_CLASS + 1), None);
+        crate::ensure_eq!(SizeClassPools::class_capacity(0), MIN_SIZE_CLASS);
+        crate::ensure_eq!(SizeClassPools::class_capacity(NUM_SIZE_CLASSES - 1), MAX_SIZE_CLASS);
+
+        // Buffers take a power-of-two number of bytes, metadata included.
+        for index in 0..NUM_SIZE_CLASSES {
+            crate::ensure_eq!(
+                (SizeClassPools::class_capacity(index) + BUFFER_METADATA_SIZE).is_power_of_two(),
+                true
+            );
+        }
+
+        let pools: Rc<SizeClassPools> = SizeClassPools::new(false)?;
+        let buf: DemiBuffer = pools.alloc(1000, 24)?;
+        crate::ensure_eq!(buf.len(), 1000);
+        crate::ensure_eq!(stats_of(&pools, 1024 - BUFFER_METADATA_SIZE).misses, 0);
+        crate::ensure_eq!(stats_of(&pools, 2048 - BUFFER_METADATA_SIZE).misses, 1);
+
+        // Requests that no class fits come from the heap.
+        let buf: DemiBuffer = pools.alloc(u16::MAX as usize, 0)?;
+        crate::ensure_eq!(buf.len(), u16::MAX as usize);
+        crate::ensure_eq!(pools.alloc(u16::MAX as usize + 1, 0).is_err(), true);
+
+        Ok(())
+    }
+
+    /// Checks that released buffers go back to their class and are reused.
+    #[test]
+    fn test_size_class_pools_reuse_buffers() -> Result<()> {
+        let pools: Rc<SizeClassPools> = SizeClassPools::new(false)?;
+        let buf: DemiBuffer = pools.alloc(MIN_SIZE_CLASS, 0)?;
+        let stats: SizeClassStats = stats_of(&pools, MIN_SIZE_CLASS);
+        crate::ensure_eq!(stats.hits, 0);
+        crate::ensure_eq!(stats.misses, 1);
+        crate::ensure_eq!(stats.num_free_buffers, stats.num_buffers - 1);
+
+        let ptr: *const u8 = buf.as_ptr();
+        drop(buf);
+        crate::ensure_eq!(stats_of(&pools, MIN_SIZE_CLASS).num_free_buffers, stats.num_buffers);
+
+        let buf: DemiBuffer = pools.alloc(32, 0)?;
+        crate::ensure_eq!(buf.as_ptr(), ptr);
+        crate::ensure_eq!(stats_of(&pools, MIN_SIZE_CLASS).hits, 1);
+        crate::ensure_eq!(stats_of(&pools, MIN_SIZE_CLASS).misses, 1);
+
+        Ok(())
+    }
+
+    /// Checks that a class grows once it runs out of buffers.
+    #[test]
+    fn test_size_class_pools_grow() -> Result<()> {
+        let pools: Rc<SizeClassPools> = SizeClassPools::new(false)?;
+        let mut bufs: Vec<DemiBuffer> = vec![pools.alloc(MAX_SIZE_CLASS, 0)?];
+        let num_buffers: usize = stats_of(&pools, MAX_SIZE_CLASS).num_buffers;
+        for _ in 0..num_buffers {
+            bufs.push(pools.alloc(MAX_SIZE_CLASS, 0)?);
+        }
+
+        let stats: SizeClassStats = stats_of(&pools, MAX_SIZE_CLASS);
+        crate::ensure_eq!(stats.misses, 2);
+        crate::ensure_eq!(stats.hits, num_buffers as u64 - 1);
+        crate::ensure_eq!(stats.num_buffers, 2 * num_buffers);
+
+        Ok(())
+    }
+
+    /// Checks that prefaulting grows every class up front, so that first requests are hits.
+    #[test]
+    fn test_size_class_pools_prefault() -> Result<()> {
+        let pools: Rc<SizeClassPools> = SizeClassPools::new(false)?;
+        pools.prefault()?;
+        for stats in pools.stats() {
+            crate::ensure_eq!(stats.num_buffers > 0, true);
+            crate::ensure_eq!(stats.num_free_buffers, stats.num_buffers);
+        }
+
+        let buf: DemiBuffer = pools.alloc(1000, 24)?;
+        crate::ensure_eq!(buf.len(), 1000);
+        crate::ensure_eq!(stats_of(&pools, 2048 - BUFFER_METADATA_SIZE).hits, 1);
+        crate::ensure_eq!(stats_of(&pools, 2048 - BUFFER_METADATA_SIZE).misses, 0);
+
+        Ok(())
+    }
+
+    /// Checks that headroom is reserved in front of the data, for the network stack to prepend headers.
+    #[test]
+    fn test_size_class_pools_reserve_headroom() -> Result<()> {
+        let pools: Rc<SizeClassPools> = SizeClassPools::new(false)?;
+        let mut buf: DemiBuffer = pools.alloc(100, 28)?;
+        crate::ensure_eq!(buf.len(), 100);
+        buf.prepend(28)?;
+        crate::ensure_eq!(buf.len(), 128);
+        crate::ensure_eq!(buf.prepend(1).is_err(), true);
+
+        Ok(())
+    }
+
+    #[bench]
+    fn bench_size_class_pools_alloc_free(b: &mut Bencher) {
+        let pools: Rc<SizeClassPools> = SizeClassPools::new(false).unwrap();
+        b.iter(|| {
+            let buf: DemiBuffer = pools.alloc(black_box(1024), 0).unwrap();
+            black_box(buf);
+        });
+    }
+
+    #[bench]
+    fn bench_heap_alloc_free(b: &mut Bencher) {
+        b.iter(|| {
+            let buf: DemiBuffer = DemiBuffer::new(black_box(1024));
+            black_box(buf);
+        });
+    }
+}
@@ -5,8 +5,10 @@
 // Exports
 //======================================================================================================================
 
+pub mod completion_queue;
 pub mod condition_variable;
 pub mod fail;
+pub mod idle;
 pub mod limits;
 pub mod logging;
 pub mod memory;
@@ -14,11 +16,13 @@ pub mod network;
 pub mod queue;
 pub mod scheduler;
 pub mod types;
+pub mod waitset;
 pub use condition_variable::SharedConditionVariable;
 mod poll;
 mod timer;
 pub use queue::{BackgroundTask, Operation, OperationResult, OperationTask, QDesc, QToken, QType};
 pub use scheduler::TaskId;
+pub use waitset::WaitSetId;
 
 #[cfg(feature = "libdpdk")]
 pub use demikernel_dpdk_bindings as libdpdk;
@@ -36,15 +40,19 @@ use crate::coroutine_timer;
 use crate::{
     expect_some,
     runtime::{
+        completion_queue::CompletionQueue,
         fail::Fail,
+        idle::{IdleBackoff, IdlePolicy},
         network::socket::SocketId,
         network::SocketIdToQDescMap,
         poll::PollFuture,
         queue::{IoQueue, IoQueueTable},
         scheduler::{SharedScheduler, TaskWithResult},
+        waitset::WaitSet,
     },
 };
 use ::futures::{future::FusedFuture, select_biased, Future, FutureExt};
+use ::slab::Slab;
 
 use ::std::{
     any::Any,
@@ -78,6 +86,14 @@ pub struct DemiRuntime {
     ts_iters: usize,
     /// Tasks that have been completed and removed from the
     completed_tasks: HashMap<QToken, (QDesc, OperationResult)>,
+    /// Registered wait sets.
+    wait_sets: Slab<WaitSet>,
+    /// Wait set that each registered queue token belongs to.
+    wait_set_members: HashMap<QToken, WaitSetId>,
+    /// Completion queue that is shared with the application, if one is registered.
+    completion_queue: Option<CompletionQueue>,
+    /// Decides what waits do while no operation completes.
+    idle: IdleBackoff,
 }
 
 #[derive(Clone)]
@@ -113,6 +129,10 @@ impl SharedDemiRuntime {
             socket_id_to_qdesc_map: SocketIdToQDescMap::default(),
             ts_iters: 0,
             completed_tasks: HashMap::<QToken, (QDesc, OperationResult)>::new(),
+            wait_sets: Slab::<WaitSet>::new(),
+            wait_set_members: HashMap::<QToken, WaitSetId>::new(),
+            completion_queue: None,
+            idle: IdleBackoff::default(),
         }))
     }
 
@@ -125,6 +145,16 @@ impl SharedDemiRuntime {
         self.insert_coroutine(task_name, coroutine)
     }
 
+    /// Inserts the `coroutine` named `task_name` into the task group of `group_id`.
+    pub fn insert_io_coroutine_with_group_id<F: FusedFuture<Output = (QDesc, OperationResult)> + 'static>(
+        &mut self,
+        group_id: TaskId,
+        task_name: &'static str,
+        coroutine: Pin<Box<F>>,
+    ) -> Result<QToken, Fail> {
+        self.schedule_coroutine(Some(group_id), task_name, coroutine)
+    }
+
     /// Inserts the background `coroutine` named `task_name` into the scheduler
     pub fn insert_background_coroutine<F: FusedFuture<Output = ()> + 'static>(
         &mut self,
@@ -140,6 +170,19 @@ impl SharedDemiRuntime {
         task_name: &'static str,
         coroutine: Pin<Box<F>>,
     ) -> Result<QToken, Fail>
+    where
+        F::Output: Unpin + Clone + Any,
+    {
+        self.schedule_coroutine(None, task_name, coroutine)
+    }
+
+    /// Inserts a coroutine into the task group of `group_id` or, if none is given, into that of the running coroutine.
+    fn schedule_coroutine<F: FusedFuture + 'static>(
+        &mut self,
+        group_id: Option<TaskId>,
+        task_name: &'static str,
+        coroutine: Pin<Box<F>>,
+    ) -> Result<QToken, Fail>
     where
         F::Output: Unpin + Clone + Any,
     {
@@ -147,7 +190,11 @@ impl SharedDemiRuntime {
         #[cfg(feature = "profiler")]
         let coroutine = coroutine_timer!(task_name, coroutine);
         let task: TaskWithResult<F::Output> = TaskWithResult::<F::Output>::new(task_name, coroutine);
-        match self.scheduler.insert_task(task) {
+        let task_id: Option<TaskId> = match group_id {
+            Some(group_id) => self.scheduler.insert_task_with_group_id(group_id, task),
+            None => self.scheduler.insert_task(task),
+        };
+        match task_id {
             Some(task_id) => Ok(task_id.into()),
             None => {
                 let cause: String = format!("cannot schedule coroutine (task_name={:?})", &task_name);
@@ -157,6 +204,46 @@ impl SharedDemiRuntime {
         }
     }
 
+    /// Creates a task group. Groups take turns to run their coroutines, so those of one group cannot hold back those of
+    /// another one.
+    pub fn create_task_group(&mut self) -> TaskId {
+        self.scheduler.create_group()
+    }
+
+    /// Removes the task group of `group_id`. Coroutines that are still in it keep running until they complete.
+    pub fn remove_task_group(&mut self, group_id: TaskId) {
+        if !self.scheduler.remove_group(group_id) {
+            warn!("remove_task_group(): no such task group (group_id={:?})", group_id);
+        }
+    }
+
+    /// Sets the number of coroutines that the task group of `group_id` may run on each of its turns.
+    pub fn set_task_group_weight(&mut self, group_id: TaskId, weight: usize) -> Result<(), Fail> {
+        if weight == 0 {
+            let cause: String = format!("task group weight must be positive (group_id={:?})", group_id);
+            warn!("set_task_group_weight(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        if !self.scheduler.set_group_weight(group_id, weight) {
+            let cause: String = format!("no such task group (group_id={:?})", group_id);
+            warn!("set_task_group_weight(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+        Ok(())
+    }
+
+    /// Returns the number of coroutines that the task group of `group_id` may run on each of its turns.
+    pub fn get_task_group_weight(&self, group_id: TaskId) -> Result<usize, Fail> {
+        match self.scheduler.get_group_weight(group_id) {
+            Some(weight) => Ok(weight),
+            None => {
+                let cause: String = format!("no such task group (group_id={:?})", group_id);
+                warn!("get_task_group_weight(): {}", cause);
+                Err(Fail::new(libc::EINVAL, &cause))
+            },
+        }
+    }
+
     /// This is just a single-token convenience wrapper for wait_any().
     pub fn wait(&mut self, qt: QToken, timeout: Duration) -> Result<(usize, QToken, QDesc, OperationResult), Fail> {
         trace!("wait(): qt={:?}, timeout={:?}", qt, timeout);
@@ -169,7 +256,7 @@ impl SharedDemiRuntime {
     }
 
     pub fn timedwait(&mut self, qt: QToken, abstime: Option<SystemTime>) -> Result<(QDesc, OperationResult), Fail> {
-        if let Some((qd, result)) = self.completed_tasks.remove(&qt) {
+        if let Some((qd, result)) = self.get_completed_task(&qt) {
             return Ok((qd, result));
         }
         if !self.scheduler.is_valid_task(&TaskId::from(qt)) {
@@ -191,21 +278,26 @@ impl SharedDemiRuntime {
                     let (qd, result): (QDesc, OperationResult) =
                         expect_some!(operation_task.get_result(), "coroutine not finished");
 
+                    self.idle.reset();
                     // Check whether it matches any of the queue tokens that we are waiting on.
                     if completed_qt == qt {
+                        self.leave_wait_set(&qt);
                         return Ok((qd, result));
                     }
 
                     // If not a queue token that we are waiting on, then insert into our list of completed tasks.
-                    self.completed_tasks.insert(qt, (qd, result));
+                    self.complete_task(completed_qt, qd, result);
                 }
             }
             // Check the timeout.
-            if let Some(abstime) = abstime {
-                if SystemTime::now() >= abstime {
-                    return Err(Fail::new(libc::ETIMEDOUT, "wait timed out"));
-                }
-            }
+            let remaining_time: Duration = match abstime {
+                Some(abstime) => match abstime.duration_since(SystemTime::now()) {
+                    Ok(remaining_time) if !remaining_time.is_zero() => remaining_time,
+                    _ => return Err(Fail::new(libc::ETIMEDOUT, "wait timed out")),
+                },
+                None => Duration::MAX,
+            };
+            self.backoff(remaining_time);
 
             // Advance the clock and continue running tasks.
             self.advance_clock_to_now();
@@ -243,6 +335,7 @@ impl SharedDemiRuntime {
             if let Some((i, qd, result)) = self.run_any(qts, remaining_time) {
                 return Ok((i, qts[i], qd, result));
             }
+            self.backoff(remaining_time);
             // Otherwise, move time forward.
             self.advance_clock_to_now();
             let now: Instant = self.get_now();
@@ -258,7 +351,9 @@ impl SharedDemiRuntime {
     }
 
     pub fn get_completed_task(&mut self, qt: &QToken) -> Option<(QDesc, OperationResult)> {
-        self.completed_tasks.remove(qt)
+        let (qd, result): (QDesc, OperationResult) = self.completed_tasks.remove(qt)?;
+        self.leave_wait_set(qt);
+        Some((qd, result))
     }
 
     /// Waits until the next task is complete, passing the result to `acceptor`. The acceptor may return true to
@@ -270,7 +365,11 @@ impl SharedDemiRuntime {
         timeout: Duration,
     ) -> Result<(), Fail> {
         // 1. Check if any tasks are completed.
-        for (qt, (qd, result)) in self.completed_tasks.extract_if(|_, _| true) {
+        let runtime: &mut DemiRuntime = self.deref_mut();
+        for (qt, (qd, result)) in runtime.completed_tasks.extract_if(|_, _| true) {
+            if let Some(wsd) = runtime.wait_set_members.remove(&qt) {
+                runtime.wait_sets[wsd.into()].remove(&qt);
+            }
             if acceptor(qt, qd, result) == false {
                 return Ok(());
             }
@@ -285,9 +384,12 @@ impl SharedDemiRuntime {
         loop {
             // Run for one quanta and if one of our queue tokens completed, then return.
             if let Some((qt, qd, result)) = self.run_next(remaining_time) {
+                self.leave_wait_set(&qt);
                 if acceptor(qt, qd, result) == false {
                     return Ok(());
                 }
+            } else {
+                self.backoff(remaining_time);
             }
             // Otherwise, move time forward.
             self.advance_clock_to_now();
@@ -310,12 +412,13 @@ impl SharedDemiRuntime {
             // Check whether it matches any of the queue tokens that we are waiting on.
             for i in 0..qts.len() {
                 if qts[i] == qt {
+                    self.leave_wait_set(&qt);
                     return Some((i, qd, result));
                 }
             }
 
             // If not a queue token that we are waiting on, then insert into our list of completed tasks.
-            self.completed_tasks.insert(qt, (qd, result));
+            self.complete_task(qt, qd, result);
         }
 
         None
@@ -338,6 +441,7 @@ impl SharedDemiRuntime {
                 let (qd, result): (QDesc, OperationResult) =
                     expect_some!(operation_task.get_result(), "coroutine not finished");
 
+                self.idle.reset();
                 return Some((qt, qd, result));
             }
         }
@@ -345,6 +449,25 @@ impl SharedDemiRuntime {
         None
     }
 
+    /// Sets what waits do while no operation completes.
+    pub fn set_idle_policy(&mut self, policy: IdlePolicy) {
+        self.idle.set_policy(policy);
+    }
+
+    /// Backs off according to the idle policy after a pass over the scheduler in which no operation completed. A
+    /// sleep lasts neither longer than `remaining_time` nor past the next time out.
+    fn backoff(&mut self, remaining_time: Duration) {
+        let now: Instant = self.get_now();
+        let gave_core_away: bool = self.idle.idle(|| match timer::global_next_expiry() {
+            Some(expiry) => remaining_time.min(expiry.saturating_duration_since(now)),
+            None => remaining_time,
+        });
+        // Read the clock on the next pass, since time went by.
+        if gave_core_away {
+            self.ts_iters = 0;
+        }
+    }
+
     /// Performs a single pool on the underlying scheduler.
     pub fn poll(&mut self) {
         // For all ready tasks that were removed from the scheduler, add to our completed task list.
@@ -355,11 +478,197 @@ impl SharedDemiRuntime {
             if let Ok(mut operation_task) = OperationTask::try_from(boxed_task.as_any()) {
                 let (qd, result): (QDesc, OperationResult) =
                     expect_some!(operation_task.get_result(), "coroutine not finished");
-                self.completed_tasks.insert(qt, (qd, result));
+                self.complete_task(qt, qd, result);
             }
         }
     }
 
+    /// Records the result of a completed operation until it is reaped, and wakes up the wait set that it belongs to.
+    /// Results of operations outside of wait sets go straight to the completion queue of the application, if any.
+    fn complete_task(&mut self, qt: QToken, qd: QDesc, result: OperationResult) {
+        if let Some(wsd) = self.wait_set_members.get(&qt).copied() {
+            self.wait_sets[wsd.into()].notify(qt);
+            self.completed_tasks.insert(qt, (qd, result));
+            return;
+        }
+
+        // If the completion queue is full, keep the result here so that it can still be waited on.
+        let (qd, result): (QDesc, OperationResult) = match self.completion_queue.as_ref() {
+            Some(cq) => match cq.try_push(qt, qd, result) {
+                Ok(()) => return,
+                Err((qd, result)) => (qd, result),
+            },
+            None => (qd, result),
+        };
+        self.completed_tasks.insert(qt, (qd, result));
+    }
+
+    /// Registers a completion queue. There is at most one completion queue at a time.
+    pub fn register_completion_queue(&mut self, cq: CompletionQueue) -> Result<(), Fail> {
+        if self.completion_queue.is_some() {
+            let cause: String = format!("a completion queue is already registered");
+            warn!("register_completion_queue(): {}", cause);
+            return Err(Fail::new(libc::EBUSY, &cause));
+        }
+        self.completion_queue = Some(cq);
+        Ok(())
+    }
+
+    /// Unregisters the completion queue.
+    pub fn unregister_completion_queue(&mut self) -> Result<(), Fail> {
+        match self.completion_queue.take() {
+            Some(_) => Ok(()),
+            None => {
+                let cause: String = format!("no completion queue is registered");
+                warn!("unregister_completion_queue(): {}", cause);
+                Err(Fail::new(libc::ENOENT, &cause))
+            },
+        }
+    }
+
+    /// Removes `qt` from the wait set that it belongs to, if any.
+    fn leave_wait_set(&mut self, qt: &QToken) {
+        if let Some(wsd) = self.wait_set_members.remove(qt) {
+            self.wait_sets[wsd.into()].remove(qt);
+        }
+    }
+
+    /// Creates an empty wait set and returns its descriptor.
+    pub fn create_wait_set(&mut self) -> WaitSetId {
+        WaitSetId::from(self.wait_sets.insert(WaitSet::default()))
+    }
+
+    /// Releases the wait set `wsd`. The operations of its members keep running and may still be waited on.
+    pub fn close_wait_set(&mut self, wsd: WaitSetId) -> Result<(), Fail> {
+        let mut wait_set: WaitSet = match self.wait_sets.try_remove(wsd.into()) {
+            Some(wait_set) => wait_set,
+            None => {
+                let cause: String = format!("invalid wait set descriptor (wsd={:?})", wsd);
+                warn!("close_wait_set(): {}", cause);
+                return Err(Fail::new(libc::EBADF, &cause));
+            },
+        };
+        for qt in wait_set.drain() {
+            self.wait_set_members.remove(&qt);
+        }
+        Ok(())
+    }
+
+    /// Adds the pending operation `qt` to the wait set `wsd`. A queue token belongs to at most one wait set at a time.
+    pub fn wait_set_add(&mut self, wsd: WaitSetId, qt: QToken) -> Result<(), Fail> {
+        if !self.wait_sets.contains(wsd.into()) {
+            let cause: String = format!("invalid wait set descriptor (wsd={:?})", wsd);
+            warn!("wait_set_add(): {}", cause);
+            return Err(Fail::new(libc::EBADF, &cause));
+        }
+
+        let completed: bool = self.completed_tasks.contains_key(&qt);
+        if !completed && !self.scheduler.is_valid_task(&TaskId::from(qt)) {
+            let cause: String = format!("{:?} is not a valid queue token", qt);
+            warn!("wait_set_add(): {}", cause);
+            return Err(Fail::new(libc::EINVAL, &cause));
+        }
+
+        if let Some(other) = self.wait_set_members.get(&qt) {
+            let cause: String = format!("{:?} already belongs to a wait set (wsd={:?})", qt, other);
+            warn!("wait_set_add(): {}", cause);
+            return Err(Fail::new(libc::EEXIST, &cause));
+        }
+
+        self.wait_set_members.insert(qt, wsd);
+        let wait_set: &mut WaitSet = &mut self.wait_sets[wsd.into()];
+        wait_set.insert(qt);
+        // The operation may have completed before it joined the wait set.
+        if completed {
+            wait_set.notify(qt);
+        }
+        Ok(())
+    }
+
+    /// Removes the operation `qt` from the wait set `wsd`.
+    pub fn wait_set_remove(&mut self, wsd: WaitSetId, qt: QToken) -> Result<(), Fail> {
+        if !self.wait_sets.contains(wsd.into()) {
+            let cause: String = format!("invalid wait set descriptor (wsd={:?})", wsd);
+            warn!("wait_set_remove(): {}", cause);
+            return Err(Fail::new(libc::EBADF, &cause));
+        }
+
+        if self.wait_set_members.get(&qt) != Some(&wsd) {
+            let cause: String = format!("{:?} does not belong to wait set (wsd={:?})", qt, wsd);
+            warn!("wait_set_remove(): {}", cause);
+            return Err(Fail::new(libc::ENOENT, &cause));
+        }
+
+        self.leave_wait_set(&qt);
+        Ok(())
+    }
+
+    /// Waits until one of the operations in the wait set `wsd` has completed and returns the result. The completed
+    /// operation leaves the wait set.
+    pub fn wait_set_wait(
+        &mut self,
+        wsd: WaitSetId,
+        timeout: Duration,
+    ) -> Result<(QToken, QDesc, OperationResult), Fail> {
+        // 1. Check if any of the members have already completed.
+        match self.wait_sets.get(wsd.into()) {
+            Some(wait_set) if wait_set.is_empty() => {
+                let cause: String = format!("wait set has no members (wsd={:?})", wsd);
+                warn!("wait_set_wait(): {}", cause);
+                return Err(Fail::new(libc::EINVAL, &cause));
+            },
+            Some(_) => (),
+            None => {
+                let cause: String = format!("invalid wait set descriptor (wsd={:?})", wsd);
+                warn!("wait_set_wait(): {}", cause);
+                return Err(Fail::new(libc::EBADF, &cause));
+            },
+        }
+        if let Some(completed) = self.reap_wait_set(wsd) {
+            return Ok(completed);
+        }
+
+        // 2. None of the members have already completed, so start a timer and move the clock.
+        self.advance_clock_to_now();
+        let mut prev_time: Instant = self.get_now();
+        let mut remaining_time: Duration = timeout;
+
+        // 3. Invoke the scheduler and run some tasks.
+        loop {
+            // Run for one quanta and if one of our members completed, then return.
+            if let Some((qt, qd, result)) = self.run_next(remaining_time) {
+                self.complete_task(qt, qd, result);
+                if let Some(completed) = self.reap_wait_set(wsd) {
+                    return Ok(completed);
+                }
+            } else {
+                self.backoff(remaining_time);
+            }
+            // Otherwise, move time forward.
+            self.advance_clock_to_now();
+            let now: Instant = self.get_now();
+            let time_elapsed: Duration = now - prev_time;
+
+            if time_elapsed > remaining_time {
+                return Err(Fail::new(libc::ETIMEDOUT, "wait timed out"));
+            } else {
+                remaining_time = remaining_time - time_elapsed;
+                prev_time = now;
+            }
+        }
+    }
+
+    /// Removes the member of the wait set `wsd` that completed first and returns its result.
+    fn reap_wait_set(&mut self, wsd: WaitSetId) -> Option<(QToken, QDesc, OperationResult)> {
+        let qt: QToken = self.wait_sets.get_mut(wsd.into())?.pop_ready()?;
+        self.wait_set_members.remove(&qt);
+        let (qd, result): (QDesc, OperationResult) = expect_some!(
+            self.completed_tasks.remove(&qt),
+            "completed member should have a result"
+        );
+        Some((qt, qd, result))
+    }
+
     /// Allocates a queue of type `T` and returns the associated queue descriptor.
     pub fn alloc_queue<T: IoQueue>(&mut self, queue: T) -> QDesc {
         let qd: QDesc = self.qtable.alloc::<T>(queue);
@@ -516,6 +825,10 @@ impl Default for SharedDemiRuntime {
             socket_id_to_qdesc_map: SocketIdToQDescMap::default(),
             ts_iters: 0,
             completed_tasks: HashMap::<QToken, (QDesc, OperationResult)>::new(),
+            wait_sets: Slab::<WaitSet>::new(),
+            wait_set_members: HashMap::<QToken, WaitSetId>::new(),
+            completion_queue: None,
+            idle: IdleBackoff::default(),
         }))
     }
 }
@@ -613,7 +926,8 @@ pub trait Runtime: Clone + Unpin + 'static {}
 
 #[cfg(test)]
 mod tests {
-    use crate::runtime::{poll_yield, OperationResult, QDesc, QToken, SharedDemiRuntime};
+    use crate::runtime::{poll_yield, OperationResult, QDesc, QToken, SharedDemiRuntime, WaitSetId};
+    use ::anyhow::Result;
     use ::std::time::Duration;
     use futures::FutureExt;
     use test::Bencher;
@@ -631,6 +945,36 @@ mod tests {
         }
     }
 
+    /// Checks that a wait set returns its members in completion order and ignores operations outside of it.
+    #[test]
+    fn test_wait_set_wait() -> Result<()> {
+        let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
+        let wsd: WaitSetId = runtime.create_wait_set();
+
+        let outsider: QToken = runtime.insert_io_coroutine("dummy coroutine", Box::pin(dummy_coroutine(0).fuse()))?;
+        let slow: QToken = runtime.insert_io_coroutine("dummy coroutine", Box::pin(dummy_coroutine(8).fuse()))?;
+        let fast: QToken = runtime.insert_io_coroutine("dummy coroutine", Box::pin(dummy_coroutine(1).fuse()))?;
+        runtime.wait_set_add(wsd, slow)?;
+        runtime.wait_set_add(wsd, fast)?;
+        crate::ensure_eq!(runtime.wait_set_add(wsd, fast).is_err(), true);
+
+        let (qt, _, _): (QToken, QDesc, OperationResult) = runtime.wait_set_wait(wsd, Duration::from_secs(1))?;
+        crate::ensure_eq!(qt, fast);
+        let (qt, _, _): (QToken, QDesc, OperationResult) = runtime.wait_set_wait(wsd, Duration::from_secs(1))?;
+        crate::ensure_eq!(qt, slow);
+        crate::ensure_eq!(runtime.wait_set_wait(wsd, Duration::from_secs(1)).is_err(), true);
+
+        // Operations that complete outside of a wait set can still be waited on, and may join one afterwards.
+        runtime.wait_set_add(wsd, outsider)?;
+        let (qt, _, _): (QToken, QDesc, OperationResult) = runtime.wait_set_wait(wsd, Duration::ZERO)?;
+        crate::ensure_eq!(qt, outsider);
+
+        runtime.close_wait_set(wsd)?;
+        crate::ensure_eq!(runtime.close_wait_set(wsd).is_err(), true);
+
+        Ok(())
+    }
+
     #[bench]
     fn benchmark_insert_io_coroutine(b: &mut Bencher) {
         let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
@@ -719,4 +1063,22 @@ mod tests {
         // Run all of the tasks for one quanta
         b.iter(|| runtime.run_any(&qts, Duration::from_secs(1)));
     }
+
+    #[bench]
+    fn benchmark_wait_set_wait(b: &mut Bencher) {
+        const NUM_TASKS: usize = 1024;
+        let mut runtime: SharedDemiRuntime = SharedDemiRuntime::default();
+        let wsd: WaitSetId = runtime.create_wait_set();
+        // Insert a large number of coroutines and register them in the wait set.
+        for _ in 0..NUM_TASKS {
+            // Make the arg big enough that the coroutine doesn't exit.
+            let qt: QToken = runtime
+                .insert_io_coroutine("dummy coroutine", Box::pin(dummy_coroutine(1000000000).fuse()))
+                .expect("should be able to insert tasks");
+            runtime.wait_set_add(wsd, qt).expect("should be able to add tasks");
+        }
+
+        // Run all of the tasks for one small quanta
+        b.iter(|| runtime.wait_set_wait(wsd, Duration::ZERO));
+    }
 }
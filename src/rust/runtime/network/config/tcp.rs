@@ -30,6 +30,10 @@ pub struct TcpConfig {
     ack_delay_timeout: Duration,
     rx_checksum_offload: bool,
     tx_checksum_offload: bool,
+    /// Hand segments larger than the MSS to the NIC and let it cut them into MSS-sized packets.
+    tcp_segmentation_offload: bool,
+    /// Hand out all received segments that fit in a scatter-gather array on every pop, without copying them.
+    zero_copy_pop: bool,
 }
 
 //======================================================================================================================
@@ -37,7 +41,9 @@ pub struct TcpConfig {
 //======================================================================================================================
 
 impl TcpConfig {
-    pub fn new(config: &Config) -> Result<Self, Fail> {
+    /// Reads the TCP options of `config`. TCP segmentation offload is only enabled if the physical layer reports that
+    /// it can cut segments (`tcp_segmentation_offload_capable`).
+    pub fn new(config: &Config, tcp_segmentation_offload_capable: bool) -> Result<Self, Fail> {
         let mut options = Self::default();
 
         if let Ok(value) = config.mss() {
@@ -49,6 +55,18 @@ impl TcpConfig {
             options.rx_checksum_offload = value;
             options.tx_checksum_offload = value;
         }
+        if let Ok(mut value) = config.tcp_segmentation_offload() {
+            if value && !tcp_segmentation_offload_capable {
+                warn!("TCP segmentation offload is not supported by the physical layer. Disabling it.");
+                value = false;
+            }
+            options.tcp_segmentation_offload = value;
+            // The NIC computes the checksum of every segment that it cuts, so we must not compute it in software.
+            options.tx_checksum_offload |= value;
+        }
+        if let Ok(value) = config.tcp_zero_copy_pop() {
+            options.zero_copy_pop = value;
+        }
 
         Ok(options)
     }
@@ -84,6 +102,14 @@ impl TcpConfig {
     pub fn get_rx_checksum_offload(&self) -> bool {
         self.rx_checksum_offload
     }
+
+    pub fn get_tcp_segmentation_offload(&self) -> bool {
+        self.tcp_segmentation_offload
+    }
+
+    pub fn get_zero_copy_pop(&self) -> bool {
+        self.zero_copy_pop
+    }
 }
 
 //======================================================================================================================
@@ -101,6 +127,8 @@ impl Default for TcpConfig {
             window_scale: 0,
             rx_checksum_offload: false,
             tx_checksum_offload: false,
+            tcp_segmentation_offload: false,
+            zero_copy_pop: false,
         }
     }
 }
@@ -125,6 +153,8 @@ mod tests {
         crate::ensure_eq!(config.get_window_scale(), 0);
         crate::ensure_eq!(config.get_rx_checksum_offload(), false);
         crate::ensure_eq!(config.get_tx_checksum_offload(), false);
+        crate::ensure_eq!(config.get_tcp_segmentation_offload(), false);
+        crate::ensure_eq!(config.get_zero_copy_pop(), false);
 
         Ok(())
     }
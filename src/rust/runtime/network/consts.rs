@@ -20,6 +20,11 @@ pub const MIN_MSS: usize = FALLBACK_MSS;
 /// Maximum MSS Parameter for TCP
 pub const MAX_MSS: usize = u16::max_value() as usize;
 
+/// Largest TCP payload that the sender hands to the NIC at once with TCP segmentation offload. With the largest
+/// Ethernet, IPv4 and TCP headers, the resulting packet still fits in the 16-bit length of a
+/// [crate::memory::DemiBuffer].
+pub const MAX_TSO_SEGMENT_SIZE: usize = u16::max_value() as usize - (14 + 60 + 60);
+
 /// Maximum Segment Lifetime
 /// See: https://www.rfc-editor.org/rfc/rfc793.txt
 pub const MSL: Duration = Duration::from_secs(2);
@@ -36,10 +41,13 @@ pub const TCP_HANDSHAKE_TIMEOUT: Duration = Duration::from_secs(3);
 /// TODO: Auto-Discovery MTU Size
 pub const DEFAULT_MSS: usize = 1450;
 
-/// Length of a [crate::memory::DemiBuffer] batch.
-///
-/// TODO: This Should be Generic
-pub const RECEIVE_BATCH_SIZE: usize = 4;
+/// Maximum length of a [crate::memory::DemiBuffer] batch. This is the capacity of the batches that are handed up the
+/// network stack; the number of packets that a physical layer actually receives at once is set at runtime with the
+/// `receive_batch_size` option and is bounded by this value.
+pub const RECEIVE_BATCH_SIZE: usize = 64;
+
+/// Default number of packets that a physical layer receives at once, if no `receive_batch_size` option is given.
+pub const DEFAULT_RECEIVE_BATCH_SIZE: usize = 32;
 
 /// Maximum local and remote window scaling factor.
 /// See: RFC 1323, Section 2.3.
@@ -8,6 +8,7 @@
 pub mod config;
 pub mod consts;
 pub mod ring;
+pub mod rss;
 pub mod socket;
 pub mod transport;
 pub mod types;
@@ -0,0 +1,211 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use ::std::net::SocketAddrV4;
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Length of a Toeplitz hash key, in bytes. This is the key length that most NICs expect.
+pub const RSS_KEY_LEN: usize = 40;
+
+/// Symmetric Toeplitz hash key. Because the key repeats with a period of 16 bits, swapping the source and destination
+/// addresses (and ports) of a flow yields the same hash, so both directions of a flow are steered to the same queue.
+/// See: https://www.ndsl.kaist.edu/~kyoungsoo/papers/TR-symRSS.pdf
+pub const RSS_SYMMETRIC_KEY: [u8; RSS_KEY_LEN] = [
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d,
+    0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+    0x6d, 0x5a,
+];
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Describes how the NIC steers incoming flows to the receive queue that is served by this network stack. The NIC
+/// hashes every incoming TCP/UDP packet with [RSS_SYMMETRIC_KEY] and looks the hash up in a redirection table (RETA) of
+/// `reta_size` entries, where entry `i` points to queue `i % num_queues`.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct RssSteering {
+    /// Receive queue that is served by this network stack.
+    queue_id: u16,
+    /// Number of receive queues across which flows are spread.
+    num_queues: u16,
+    /// Number of entries in the redirection table of the NIC.
+    reta_size: u16,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl RssSteering {
+    pub fn new(queue_id: u16, num_queues: u16, reta_size: u16) -> Self {
+        debug_assert!(num_queues > 0);
+        debug_assert!(queue_id < num_queues);
+        Self {
+            queue_id,
+            num_queues,
+            reta_size,
+        }
+    }
+
+    /// Returns the receive queue that is served by this network stack.
+    pub fn queue_id(&self) -> u16 {
+        self.queue_id
+    }
+
+    /// Returns the number of receive queues across which flows are spread.
+    pub fn num_queues(&self) -> u16 {
+        self.num_queues
+    }
+
+    /// Returns the receive queue on which the NIC delivers the packets that `remote` sends to `local`.
+    pub fn steer(&self, local: &SocketAddrV4, remote: &SocketAddrV4) -> u16 {
+        // The NIC hashes the source address, destination address, source port and destination port of the incoming
+        // packet, in that order and in network byte order.
+        let mut input: [u8; 12] = [0; 12];
+        input[0..4].copy_from_slice(&remote.ip().octets());
+        input[4..8].copy_from_slice(&local.ip().octets());
+        input[8..10].copy_from_slice(&remote.port().to_be_bytes());
+        input[10..12].copy_from_slice(&local.port().to_be_bytes());
+
+        let hash: u32 = toeplitz_hash(&RSS_SYMMETRIC_KEY, &input);
+        let reta_index: u32 = if self.reta_size > 0 {
+            hash % self.reta_size as u32
+        } else {
+            hash
+        };
+        (reta_index % self.num_queues as u32) as u16
+    }
+
+    /// Checks if the packets that `remote` sends to `local` are delivered to the queue of this network stack.
+    pub fn is_local_flow(&self, local: &SocketAddrV4, remote: &SocketAddrV4) -> bool {
+        self.steer(local, remote) == self.queue_id
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Computes the Toeplitz hash of `input` using `key`, as specified by Microsoft's RSS. The key must be at least 4 bytes
+/// longer than the input.
+/// See: https://learn.microsoft.com/en-us/windows-hardware/drivers/network/rss-hashing-functions
+pub fn toeplitz_hash(key: &[u8], input: &[u8]) -> u32 {
+    debug_assert!(key.len() >= input.len() + 4);
+
+    let mut hash: u32 = 0;
+    // Leftmost 32 bits of the key, shifted left by one bit for every input bit that we consume.
+    let mut window: u32 = u32::from_be_bytes([key[0], key[1], key[2], key[3]]);
+    for (i, byte) in input.iter().enumerate() {
+        let next_key_byte: u8 = key[i + 4];
+        for bit in 0..8 {
+            if byte & (0x80 >> bit) != 0 {
+                hash ^= window;
+            }
+            window = (window << 1) | ((next_key_byte >> (7 - bit)) & 1) as u32;
+        }
+    }
+    hash
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::runtime::network::rss::{toeplitz_hash, RssSteering, RSS_KEY_LEN, RSS_SYMMETRIC_KEY};
+    use ::anyhow::Result;
+    use ::std::net::{Ipv4Addr, SocketAddrV4};
+
+    /// Default key from Microsoft's RSS verification suite.
+    const MICROSOFT_KEY: [u8; RSS_KEY_LEN] = [
+        0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0, 0xd0, 0xca,
+        0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b,
+        0xbe, 0xac, 0x01, 0xfa,
+    ];
+
+    fn hash_input(src: SocketAddrV4, dst: SocketAddrV4) -> [u8; 12] {
+        let mut input: [u8; 12] = [0; 12];
+        input[0..4].copy_from_slice(&src.ip().octets());
+        input[4..8].copy_from_slice(&dst.ip().octets());
+        input[8..10].copy_from_slice(&src.port().to_be_bytes());
+        input[10..12].copy_from_slice(&dst.port().to_be_bytes());
+        input
+    }
+
+    /// Checks the hash against the IPv4 and IPv4/TCP vectors of Microsoft's RSS verification suite.
+    #[test]
+    fn test_toeplitz_hash_verification_suite() -> Result<()> {
+        let vectors: [(SocketAddrV4, SocketAddrV4, u32, u32); 2] = [
+            (
+                SocketAddrV4::new(Ipv4Addr::new(66, 9, 149, 187), 2794),
+                SocketAddrV4::new(Ipv4Addr::new(161, 142, 100, 80), 1766),
+                0x323e8fc2,
+                0x51ccc178,
+            ),
+            (
+                SocketAddrV4::new(Ipv4Addr::new(199, 92, 111, 2), 14230),
+                SocketAddrV4::new(Ipv4Addr::new(65, 69, 140, 83), 4739),
+                0xd718262a,
+                0xc626b0ea,
+            ),
+        ];
+
+        for (src, dst, ipv4_hash, tcp_hash) in vectors {
+            let input: [u8; 12] = hash_input(src, dst);
+            crate::ensure_eq!(toeplitz_hash(&MICROSOFT_KEY, &input[..8]), ipv4_hash);
+            crate::ensure_eq!(toeplitz_hash(&MICROSOFT_KEY, &input), tcp_hash);
+        }
+
+        Ok(())
+    }
+
+    /// Checks that both directions of a flow have the same hash with the symmetric key.
+    #[test]
+    fn test_toeplitz_hash_is_symmetric() -> Result<()> {
+        let a: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 1), 49152);
+        for port in [80, 443, 12345, 65535] {
+            let b: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(10, 0, 0, 7), port);
+            crate::ensure_eq!(
+                toeplitz_hash(&RSS_SYMMETRIC_KEY, &hash_input(a, b)),
+                toeplitz_hash(&RSS_SYMMETRIC_KEY, &hash_input(b, a))
+            );
+        }
+
+        Ok(())
+    }
+
+    /// Checks that flows are steered to the same queue in both directions and that every queue gets some flows.
+    #[test]
+    fn test_steer_flows() -> Result<()> {
+        const NUM_QUEUES: u16 = 4;
+        let local_ipv4_addr: Ipv4Addr = Ipv4Addr::new(192, 168, 1, 1);
+        let remote: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 2), 80);
+
+        let mut flows_per_queue: [usize; NUM_QUEUES as usize] = [0; NUM_QUEUES as usize];
+        for port in 49152..50176 {
+            let local: SocketAddrV4 = SocketAddrV4::new(local_ipv4_addr, port);
+            let queue_id: u16 = RssSteering::new(0, NUM_QUEUES, 512).steer(&local, &remote);
+            crate::ensure_eq!(queue_id, RssSteering::new(0, NUM_QUEUES, 512).steer(&remote, &local));
+            crate::ensure_eq!(
+                RssSteering::new(queue_id, NUM_QUEUES, 512).is_local_flow(&local, &remote),
+                true
+            );
+            flows_per_queue[queue_id as usize] += 1;
+        }
+
+        for count in flows_per_queue {
+            crate::ensure_neq!(count, 0);
+        }
+
+        Ok(())
+    }
+}
@@ -26,6 +26,12 @@ const DEFAULT_KEEP_ALIVE: tcp_keepalive = tcp_keepalive {
     keepaliveinterval: 1000,
 };
 const DEFAULT_NO_DELAY: bool = true;
+const DEFAULT_CONGESTION_CONTROL: CongestionControlAlgorithm = CongestionControlAlgorithm::None;
+/// Longest name of a congestion control algorithm, including the terminating NUL (TCP_CA_NAME_MAX on Linux).
+pub const MAX_CONGESTION_CONTROL_NAME_LEN: usize = 16;
+/// Highest scheduling priority of a socket. This matches the highest priority that Linux lets unprivileged processes
+/// set with SO_PRIORITY.
+pub const MAX_SOCKET_PRIORITY: u8 = 6;
 
 //======================================================================================================================
 // Structures
@@ -37,6 +43,29 @@ pub enum SocketOption {
     Linger(Option<Duration>),
     KeepAlive(KeepAlive),
     NoDelay(bool),
+    /// Scheduling priority of the coroutines of the socket, from 0 to [MAX_SOCKET_PRIORITY]. This is handled by the
+    /// LibOS, not by the network transport.
+    Priority(u8),
+    /// Congestion control algorithm of TCP connections, like TCP_CONGESTION on Linux. Connections pick it up when
+    /// they get established.
+    CongestionControl(CongestionControlAlgorithm),
+}
+
+/// Congestion control algorithms that TCP connections can use.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum CongestionControlAlgorithm {
+    /// Send as fast as the receive window allows.
+    None,
+    /// CUBIC (RFC 8312).
+    Cubic,
+    /// Data Center TCP (RFC 8257), which reacts to the extent of ECN marks rather than to packet loss.
+    Dctcp,
+    /// BBR, which paces segments at the estimated bottleneck bandwidth and bounds the data in flight by the estimated
+    /// bandwidth-delay product.
+    Bbr,
+    /// An algorithm of the host kernel that we do not implement, like `reno`, by its NUL-padded name. Only transports
+    /// that leave congestion control to the kernel support it.
+    Kernel([u8; MAX_CONGESTION_CONTROL_NAME_LEN]),
 }
 
 #[derive(Debug, Clone, Copy)]
@@ -44,6 +73,54 @@ pub struct TcpSocketOptions {
     linger: Option<Duration>,
     keep_alive: KeepAlive,
     no_delay: bool,
+    congestion_control: CongestionControlAlgorithm,
+}
+
+impl CongestionControlAlgorithm {
+    /// Looks an algorithm up by name. Linux knows all but `none` by the same names.
+    pub fn from_name(name: &str) -> Option<Self> {
+        match name {
+            "none" => Some(Self::None),
+            "cubic" => Some(Self::Cubic),
+            "dctcp" => Some(Self::Dctcp),
+            "bbr" => Some(Self::Bbr),
+            _ => None,
+        }
+    }
+
+    /// Looks an algorithm of the host kernel up by name, falling back to [CongestionControlAlgorithm::Kernel] for the
+    /// ones that we do not implement.
+    pub fn from_kernel_name(name: &str) -> Option<Self> {
+        if let Some(algorithm) = Self::from_name(name) {
+            return Some(algorithm);
+        }
+        if name.is_empty() || name.len() >= MAX_CONGESTION_CONTROL_NAME_LEN || name.contains('\0') {
+            return None;
+        }
+        let mut padded_name: [u8; MAX_CONGESTION_CONTROL_NAME_LEN] = [0; MAX_CONGESTION_CONTROL_NAME_LEN];
+        padded_name[..name.len()].copy_from_slice(name.as_bytes());
+        Some(Self::Kernel(padded_name))
+    }
+
+    /// Returns the name of the algorithm.
+    pub fn name(&self) -> &str {
+        match self {
+            Self::None => "none",
+            Self::Cubic => "cubic",
+            Self::Dctcp => "dctcp",
+            Self::Bbr => "bbr",
+            Self::Kernel(padded_name) => {
+                let len: usize = padded_name.iter().position(|b| *b == 0).unwrap_or(padded_name.len());
+                // The name was copied from a string, so it is valid UTF-8.
+                ::std::str::from_utf8(&padded_name[..len]).unwrap_or_default()
+            },
+        }
+    }
+
+    /// Whether connections that use the algorithm negotiate ECN (RFC 3168).
+    pub fn uses_ecn(&self) -> bool {
+        *self == Self::Dctcp
+    }
 }
 
 impl TcpSocketOptions {
@@ -52,6 +129,7 @@ impl TcpSocketOptions {
             linger: config.linger().unwrap_or(DEFAULT_LINGER),
             keep_alive: config.tcp_keepalive().unwrap_or(DEFAULT_KEEP_ALIVE),
             no_delay: config.no_delay().unwrap_or(DEFAULT_NO_DELAY),
+            congestion_control: config.tcp_congestion_control().unwrap_or(DEFAULT_CONGESTION_CONTROL),
         })
     }
 
@@ -78,6 +156,14 @@ impl TcpSocketOptions {
     pub fn set_nodelay(&mut self, nodelay: bool) {
         self.no_delay = nodelay;
     }
+
+    pub fn get_congestion_control(&self) -> CongestionControlAlgorithm {
+        self.congestion_control
+    }
+
+    pub fn set_congestion_control(&mut self, congestion_control: CongestionControlAlgorithm) {
+        self.congestion_control = congestion_control;
+    }
 }
 
 impl Default for TcpSocketOptions {
@@ -86,6 +172,7 @@ impl Default for TcpSocketOptions {
             linger: DEFAULT_LINGER,
             keep_alive: DEFAULT_KEEP_ALIVE,
             no_delay: DEFAULT_NO_DELAY,
+            congestion_control: DEFAULT_CONGESTION_CONTROL,
         }
     }
 }
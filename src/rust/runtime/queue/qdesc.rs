@@ -7,6 +7,7 @@
 
 /// IO Queue Descriptor
 #[derive(Debug, Eq, PartialEq, Hash, Copy, Clone)]
+#[repr(C)]
 pub struct QDesc(u32);
 
 //======================================================================================================================
@@ -12,11 +12,11 @@
 //======================================================================================================================
 
 use crate::{
-    collections::{id_map::IdMap, pin_slab::PinSlab},
+    collections::pin_slab::PinSlab,
     expect_some,
     runtime::scheduler::{
-        page::{WakerPageRef, WakerRef},
-        scheduler::InternalId,
+        page::{ReadyQueue, WakerPageRef, WakerRef},
+        scheduler::{InternalId, DEFAULT_GROUP_WEIGHT},
         waker64::{WAKER_BIT_LENGTH, WAKER_BIT_LENGTH_SHIFT},
         Task, TaskId,
     },
@@ -24,8 +24,10 @@ use crate::{
 use ::bit_iter::BitIter;
 use ::futures::Future;
 use ::std::{
+    collections::{HashMap, VecDeque},
     pin::Pin,
     ptr::NonNull,
+    rc::Rc,
     task::{Context, Poll, Waker},
 };
 
@@ -34,14 +36,30 @@ use ::std::{
 //======================================================================================================================
 
 /// This represents a resource management group. All tasks belong to a task group. By default, a task belongs to the
-/// same task group as the allocating task.
-#[derive(Default)]
+/// same task group as the allocating task. Groups take turns to run their ready tasks, and the weight of a group is the
+/// number of tasks that it may run on each of its turns.
 pub struct TaskGroup {
-    ids: IdMap<TaskId, InternalId>,
+    /// Maps the ids of the tasks in this group, which the scheduler hands out, to their offsets in the pin slab.
+    ids: HashMap<TaskId, InternalId>,
     /// Stores all the tasks that are held by the scheduler.
     tasks: PinSlab<Box<dyn Task>>,
     /// Holds the waker bits for controlling task scheduling.
     waker_page_refs: Vec<WakerPageRef>,
+    /// Ready queue of the scheduler, which the waker pages of this group feed. Idle tasks cost nothing to the scheduler.
+    ready_queue: Rc<ReadyQueue>,
+    /// Index of this group in the scheduler.
+    group_index: usize,
+    /// Tasks that have been notified and wait for the turn of this group, in notification order.
+    ready_tasks: VecDeque<InternalId>,
+    /// Number of tasks that this group may run on each of its turns.
+    weight: usize,
+    /// Number of tasks that this group may still run on its current turn.
+    deficit: usize,
+    /// Whether this group is lined up to take turns in the scheduler.
+    active: bool,
+    /// Whether this group was removed while some of its tasks were still running. It is freed along with its last
+    /// task.
+    closing: bool,
 }
 
 //======================================================================================================================
@@ -49,6 +67,22 @@ pub struct TaskGroup {
 //======================================================================================================================
 
 impl TaskGroup {
+    /// Creates an empty task group that lives at `group_index` in the scheduler and feeds `ready_queue`.
+    pub fn new(ready_queue: Rc<ReadyQueue>, group_index: usize) -> Self {
+        Self {
+            ids: HashMap::new(),
+            tasks: PinSlab::default(),
+            waker_page_refs: Vec::new(),
+            ready_queue,
+            group_index,
+            ready_tasks: VecDeque::new(),
+            weight: DEFAULT_GROUP_WEIGHT,
+            deficit: 0,
+            active: false,
+            closing: false,
+        }
+    }
+
     /// Given a handle to a task, remove it from the scheduler
     pub fn remove(&mut self, task_id: TaskId) -> Option<Box<dyn Task>> {
         // We should not have a scheduler handle that refers to an invalid id, so unwrap and expect are safe here.
@@ -76,12 +110,12 @@ impl TaskGroup {
         }
     }
 
-    /// Insert a new task into our scheduler returning a handle corresponding to it.
-    pub fn insert(&mut self, task: Box<dyn Task>) -> Option<TaskId> {
+    /// Insert a new task with id `task_id` into our scheduler.
+    pub fn insert(&mut self, task_id: TaskId, task: Box<dyn Task>) -> Option<()> {
         let task_name: &'static str = task.get_name();
         // The pin slab index can be reverse-computed in a page index and an offset within the page.
         let pin_slab_index: usize = self.tasks.insert(task)?;
-        let task_id: TaskId = self.ids.insert_with_new_id(pin_slab_index.into());
+        self.ids.insert(task_id, pin_slab_index.into());
 
         self.add_new_pages_up_to_pin_slab_index(pin_slab_index.into());
 
@@ -100,7 +134,7 @@ impl TaskGroup {
         );
         // Set this task's id.
         expect_some!(self.tasks.get_pin_mut(pin_slab_index), "just allocated!").set_id(task_id);
-        Some(task_id)
+        Some(())
     }
 
     /// Computes the page and page offset of a given task based on its total offset.
@@ -118,14 +152,15 @@ impl TaskGroup {
     /// multiple pages because of the gap between the pin slab index and the current page index.
     fn add_new_pages_up_to_pin_slab_index(&mut self, pin_slab_index: usize) {
         while pin_slab_index >= (self.waker_page_refs.len() << WAKER_BIT_LENGTH_SHIFT) {
-            self.waker_page_refs.push(WakerPageRef::default());
+            let waker_page_index: usize = self.waker_page_refs.len();
+            self.waker_page_refs.push(WakerPageRef::with_ready_queue(
+                self.ready_queue.clone(),
+                self.group_index,
+                waker_page_index,
+            ));
         }
     }
 
-    pub fn get_num_waker_pages(&self) -> usize {
-        self.waker_page_refs.len()
-    }
-
     fn get_waker_page_offset(pin_slab_index: usize) -> usize {
         pin_slab_index & (WAKER_BIT_LENGTH - 1)
     }
@@ -134,18 +169,85 @@ impl TaskGroup {
         (waker_page_index << WAKER_BIT_LENGTH_SHIFT) + waker_page_offset
     }
 
-    pub fn get_offsets_for_ready_tasks(&mut self) -> Vec<InternalId> {
-        let mut result: Vec<InternalId> = vec![];
-        for i in 0..self.get_num_waker_pages() {
-            // Grab notified bits.
-            let notified: u64 = self.waker_page_refs[i].take_notified();
-            // Turn into bit iter.
-            let mut offset: Vec<InternalId> = BitIter::from(notified)
-                .map(|x| Self::get_pin_slab_index(i, x).into())
-                .collect();
-            result.append(&mut offset);
+    /// Moves the tasks of the waker page at `waker_page_index` that have been notified to the back of the ready tasks.
+    pub fn collect_notified_tasks(&mut self, waker_page_index: usize) {
+        // The page may be gone already if a removed group left its index to this one.
+        if let Some(waker_page_ref) = self.waker_page_refs.get(waker_page_index) {
+            // Grab notified bits. These may be gone already if the notified tasks were removed meanwhile.
+            let notified: u64 = waker_page_ref.take_notified();
+            self.ready_tasks.extend(
+                BitIter::from(notified).map(|x| InternalId::from(Self::get_pin_slab_index(waker_page_index, x))),
+            );
+        }
+    }
+
+    /// Takes the ready task that was notified first. Tasks that have been removed since they were notified are skipped.
+    pub fn pop_ready_task(&mut self) -> Option<InternalId> {
+        while let Some(internal_id) = self.ready_tasks.pop_front() {
+            if self.tasks.contains(internal_id.into()) {
+                return Some(internal_id);
+            }
         }
-        result
+        None
+    }
+
+    /// Checks if this group has any ready task.
+    pub fn has_ready_tasks(&self) -> bool {
+        !self.ready_tasks.is_empty()
+    }
+
+    /// Returns the number of ready tasks in this group, which may include some that have been removed meanwhile.
+    pub fn num_ready_tasks(&self) -> usize {
+        self.ready_tasks.len()
+    }
+
+    pub fn get_weight(&self) -> usize {
+        self.weight
+    }
+
+    pub fn set_weight(&mut self, weight: usize) {
+        debug_assert!(weight > 0);
+        self.weight = weight;
+    }
+
+    /// Checks if this group is in the middle of a turn.
+    pub fn is_in_turn(&self) -> bool {
+        self.deficit > 0
+    }
+
+    /// Starts a turn of this group, in which it may run as many tasks as its weight.
+    pub fn start_turn(&mut self) {
+        debug_assert!(!self.is_in_turn());
+        self.deficit = self.weight;
+    }
+
+    /// Accounts for a task that ran on the current turn. Returns true if the turn is over.
+    pub fn charge_task(&mut self) -> bool {
+        debug_assert!(self.deficit > 0);
+        self.deficit -= 1;
+        self.deficit == 0
+    }
+
+    /// Ends the current turn early, because the group ran out of ready tasks. Unused turns are not carried over.
+    pub fn end_turn(&mut self) {
+        self.deficit = 0;
+    }
+
+    pub fn is_active(&self) -> bool {
+        self.active
+    }
+
+    pub fn set_active(&mut self, active: bool) {
+        self.active = active;
+    }
+
+    pub fn is_closing(&self) -> bool {
+        self.closing
+    }
+
+    /// Marks this group to be freed along with its last task.
+    pub fn close(&mut self) {
+        self.closing = true;
     }
 
     /// Translates an internal task id to an external one. Expects the task to exist.
@@ -154,7 +256,7 @@ impl TaskGroup {
     }
 
     pub fn unchecked_external_to_internal_id(&self, task_id: &TaskId) -> InternalId {
-        expect_some!(self.ids.get(task_id), "Invalid id: {:?}", task_id)
+        *expect_some!(self.ids.get(task_id), "Invalid id: {:?}", task_id)
     }
 
     fn get_pinned_task_ptr(&mut self, pin_slab_index: usize) -> Pin<&mut Box<dyn Task>> {
@@ -193,13 +295,12 @@ impl TaskGroup {
 
     pub fn is_valid_task(&self, task_id: &TaskId) -> bool {
         if let Some(internal_id) = self.ids.get(task_id) {
-            self.tasks.contains(internal_id.into())
+            self.tasks.contains((*internal_id).into())
         } else {
             false
         }
     }
 
-    #[cfg(test)]
     pub fn num_tasks(&self) -> usize {
         self.ids.len()
     }
@@ -6,6 +6,7 @@
 //======================================================================================================================
 
 use crate::runtime::scheduler::waker64::{Waker64, WAKER_BIT_LENGTH};
+use ::std::{cell::UnsafeCell, mem, rc::Rc};
 
 //======================================================================================================================
 // Constants
@@ -32,17 +33,36 @@ pub struct WakerPage {
     refcount: Waker64,
     /// Flags wether or not a given future has been notified.
     notified: Waker64,
+    /// Ready queue of the scheduler, along with the index of the task group that owns this page and the index of this
+    /// page in the task group.
+    ready_queue: Option<(Rc<ReadyQueue>, usize, usize)>,
 }
 
+/// Indexes of the task groups and [WakerPage]s that have been notified since the queue was last drained. A page enters
+/// the queue when its first notification flag is set, so finding the tasks that are ready to run does not scan the
+/// pages of idle tasks.
+#[derive(Default)]
+pub struct ReadyQueue(UnsafeCell<Vec<(usize, usize)>>);
+
 //======================================================================================================================
 // Associate Functions
 //======================================================================================================================
 
 impl WakerPage {
+    /// Creates a [WakerPage] that enqueues itself as page `page_index` of group `group_index` in `ready_queue` when it
+    /// gets notified.
+    pub fn with_ready_queue(ready_queue: Rc<ReadyQueue>, group_index: usize, page_index: usize) -> Self {
+        Self {
+            refcount: Waker64::new(1),
+            notified: Waker64::new(0),
+            ready_queue: Some((ready_queue, group_index, page_index)),
+        }
+    }
+
     /// Sets the notification flag for the `ix` future in the target [WakerPage].
     pub fn notify(&self, ix: usize) {
         debug_assert!(ix < WAKER_BIT_LENGTH);
-        self.notified.fetch_or(1 << ix);
+        self.set_notified(1 << ix);
     }
 
     /// Takes out notification flags in the target [WakerPage].
@@ -53,18 +73,21 @@ impl WakerPage {
         self.notified.swap(0)
     }
 
-    /// Resets all flags in the target [WakerPage].
-    /// The reference count for the target page is reset to one.
-    pub fn reset(&mut self) {
-        self.refcount.swap(1);
-        self.notified.swap(0);
-    }
-
     /// Initialize flags for the `ix` future in the target [WakerPage].
     /// Notification and completed flags are reset after this operation.
     pub fn initialize(&self, ix: usize) {
         debug_assert!(ix < WAKER_BIT_LENGTH);
-        self.notified.fetch_or(1 << ix);
+        self.set_notified(1 << ix);
+    }
+
+    /// Sets the notification flags in `mask` and enqueues the target [WakerPage] if it had no notification flag set.
+    fn set_notified(&self, mask: u64) {
+        if self.notified.load() == 0 {
+            if let Some((ready_queue, group_index, page_index)) = self.ready_queue.as_ref() {
+                ready_queue.push(*group_index, *page_index);
+            }
+        }
+        self.notified.fetch_or(mask);
     }
 
     /// Clears flags for the `ix` future in the target [WakerPage]
@@ -95,6 +118,22 @@ impl WakerPage {
     }
 }
 
+impl ReadyQueue {
+    /// Enqueues the page at `page_index` in the group at `group_index`.
+    fn push(&self, group_index: usize, page_index: usize) {
+        let queue: &mut Vec<(usize, usize)> = unsafe { &mut *self.0.get() };
+        queue.push((group_index, page_index));
+    }
+
+    /// Swaps the contents of the target [ReadyQueue] with `pages`, which should be empty. This hands the enqueued pages
+    /// over to the caller and lets them reuse the same buffers over and over.
+    pub fn swap(&self, pages: &mut Vec<(usize, usize)>) {
+        debug_assert!(pages.is_empty());
+        let queue: &mut Vec<(usize, usize)> = unsafe { &mut *self.0.get() };
+        mem::swap(queue, pages);
+    }
+}
+
 //======================================================================================================================
 // Trait Implementations
 //======================================================================================================================
@@ -104,6 +143,7 @@ impl Default for WakerPage {
         Self {
             refcount: Waker64::new(1),
             notified: Waker64::new(0),
+            ready_queue: None,
         }
     }
 }
@@ -8,7 +8,7 @@
 use crate::{
     expect_ok,
     runtime::scheduler::{
-        page::{WakerPage, WAKER_PAGE_SIZE},
+        page::{ReadyQueue, WakerPage, WAKER_PAGE_SIZE},
         waker64::WAKER_BIT_LENGTH,
     },
 };
@@ -17,6 +17,7 @@ use ::std::{
     mem,
     ops::Deref,
     ptr::{self, NonNull},
+    rc::Rc,
 };
 
 //======================================================================================================================
@@ -37,6 +38,22 @@ impl WakerPageRef {
         Self(waker_page)
     }
 
+    /// Allocates a [WakerPage] that enqueues itself as page `page_index` of group `group_index` in `ready_queue` when it
+    /// gets notified.
+    pub fn with_ready_queue(ready_queue: Rc<ReadyQueue>, group_index: usize, page_index: usize) -> Self {
+        Self::allocate(WakerPage::with_ready_queue(ready_queue, group_index, page_index))
+    }
+
+    /// Moves `page` into memory that is aligned to its own size.
+    fn allocate(page: WakerPage) -> Self {
+        let layout: Layout = Layout::new::<WakerPage>();
+        assert_eq!(layout.align(), WAKER_PAGE_SIZE);
+        let ptr: NonNull<WakerPage> = expect_ok!(Global.allocate(layout), "Failed to allocate WakerPage").cast();
+        // Write the whole page, because the freshly allocated memory does not hold a valid page yet.
+        unsafe { ptr::write(ptr.as_ptr(), page) };
+        Self(ptr)
+    }
+
     /// Casts the target [WakerPageRef] into a [NonNull<u8>].
     ///
     /// The reference itself is not intended for reading/writing to
@@ -107,14 +124,7 @@ impl Deref for WakerPageRef {
 
 impl Default for WakerPageRef {
     fn default() -> Self {
-        let layout: Layout = Layout::new::<WakerPage>();
-        assert_eq!(layout.align(), WAKER_PAGE_SIZE);
-        let mut ptr: NonNull<WakerPage> = expect_ok!(Global.allocate(layout), "Failed to allocate WakerPage").cast();
-        unsafe {
-            let page: &mut WakerPage = ptr.as_mut();
-            page.reset();
-        }
-        Self(ptr)
+        Self::allocate(WakerPage::default())
     }
 }
 
@@ -15,16 +15,26 @@ use crate::{
     collections::id_map::IdMap,
     expect_some,
     runtime::{
-        scheduler::{group::TaskGroup, Task, TaskId},
+        scheduler::{group::TaskGroup, page::ReadyQueue, Task, TaskId},
         SharedObject,
     },
 };
 use ::slab::Slab;
 use ::std::{
+    collections::VecDeque,
+    mem,
     ops::{Deref, DerefMut},
+    rc::Rc,
     task::Waker,
 };
 
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of tasks that a group runs on each of its turns, unless told otherwise.
+pub const DEFAULT_GROUP_WEIGHT: usize = 1;
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -36,19 +46,24 @@ pub struct InternalId(usize);
 pub struct Scheduler {
     // Mapping between external task ids and internal ids (represents the offset into the slab where the task lives).
     ids: IdMap<TaskId, InternalId>,
-    // All tasks are in a single group but we will eventually break them up by Demikernel queue for fairness and
-    // performance isolation.
+    // Tasks are broken up in groups (e.g., one per Demikernel queue) for fairness and performance isolation.
     groups: Slab<TaskGroup>,
     // For external use only. If there are no coroutines running (i.e., we did not enter the scheduler through a wait),
     // this MUST be set to none because we cannot yield or wake unless inside a task/async coroutine.
     current_running_task: Box<Option<TaskId>>,
-    // These global variables are for our scheduling policy. For now, we simply use round robin.
     // The index of the current or last task that we ran.
     current_task_id: InternalId,
-    // The group index of the current or last task that we ran.
+    // The group index of the task that is running or, outside of tasks, the group that new tasks go into.
     current_group_id: InternalId,
-    // The current set of ready tasks in the group.
-    current_ready_tasks: Vec<InternalId>,
+    // The group that holds the tasks that do not belong to any other group. It is never removed.
+    root_group_id: InternalId,
+    // Waker pages that have been notified, across all groups.
+    ready_queue: Rc<ReadyQueue>,
+    // Spare buffer to drain the ready queue into.
+    ready_pages: Vec<(usize, usize)>,
+    // These global variables are for our scheduling policy. We use deficit round robin across groups.
+    // Groups that have ready tasks, in the order in which they take turns.
+    active_groups: VecDeque<InternalId>,
 }
 
 #[derive(Clone)]
@@ -59,8 +74,15 @@ pub struct SharedScheduler(SharedObject<Scheduler>);
 //======================================================================================================================
 
 impl Scheduler {
+    /// Creates an empty task group. This cannot be done from within a task, because adding a group may move the group
+    /// of the running task.
     pub fn create_group(&mut self) -> TaskId {
-        let internal_id: InternalId = self.groups.insert(TaskGroup::default()).into();
+        debug_assert!(self.current_running_task.is_none());
+        let group_index: usize = self.groups.vacant_key();
+        let internal_id: InternalId = self
+            .groups
+            .insert(TaskGroup::new(self.ready_queue.clone(), group_index))
+            .into();
         // Returns an identifier for the group.
         self.ids.insert_with_new_id(internal_id)
     }
@@ -87,35 +109,75 @@ impl Scheduler {
         self.groups.get_mut(group_id.into())
     }
 
-    /// The group id should be the one originally allocated for this group since the group should not have any running
-    /// tasks. Returns true if the task group was successfully removed.
+    /// The group id should be the one originally allocated for this group. Tasks that are still in the group keep
+    /// running, and the group is freed along with the last of them. Returns true if the task group was successfully
+    /// removed.
     pub fn remove_group(&mut self, group_id: TaskId) -> bool {
-        if let Some(internal_id) = self.ids.remove(&group_id) {
-            self.groups.remove(internal_id.into());
-            true
-        } else {
-            false
+        match self.ids.get(&group_id) {
+            Some(internal_id) if internal_id != self.root_group_id && self.groups.contains(internal_id.into()) => {
+                self.ids.remove(&group_id);
+                let group: &mut TaskGroup = &mut self.groups[internal_id.into()];
+                if group.num_tasks() == 0 {
+                    self.free_group(internal_id);
+                } else {
+                    group.close();
+                }
+                true
+            },
+            _ => false,
         }
     }
 
+    /// Frees the group at `internal_id`, which should not have any task left.
+    fn free_group(&mut self, internal_id: InternalId) {
+        let group: TaskGroup = self.groups.remove(internal_id.into());
+        debug_assert_eq!(group.num_tasks(), 0);
+        if group.is_active() {
+            self.active_groups.retain(|group_id| *group_id != internal_id);
+        }
+        if self.current_group_id == internal_id {
+            self.current_group_id = self.root_group_id;
+        }
+    }
+
+    /// Sets the number of tasks that the group of `group_id` runs on each of its turns. The id can either be that of
+    /// the group or that of a task in it. Returns true if the group exists.
+    pub fn set_group_weight(&mut self, group_id: TaskId, weight: usize) -> bool {
+        debug_assert!(weight > 0);
+        match self.get_mut_group(&group_id) {
+            Some(group) => {
+                group.set_weight(weight);
+                true
+            },
+            None => false,
+        }
+    }
+
+    /// Returns the number of tasks that the group of `group_id` runs on each of its turns, if the group exists.
+    pub fn get_group_weight(&self, group_id: TaskId) -> Option<usize> {
+        Some(self.get_group(&group_id)?.get_weight())
+    }
+
     /// The parent id can either be the id of the group or another task in the same group.
     pub fn insert_task<T: Task>(&mut self, task: T) -> Option<TaskId> {
-        let group: &mut TaskGroup = self.groups.get_mut(self.current_group_id.into())?;
-        let new_task_id: TaskId = group.insert(Box::new(task))?;
-        // Add a mapping so we can use this new task id to find the task in the future.
-        if let Some(existing) = self.ids.insert(new_task_id, self.current_group_id) {
-            panic!("should not exist an id: {:?}", existing);
-        }
-        Some(new_task_id)
+        self.insert_task_into_group(self.current_group_id, Box::new(task))
     }
 
     /// The parent id can either be the id of the group or another task in the same group.
     pub fn insert_task_with_group_id<T: Task>(&mut self, group_id: TaskId, task: T) -> Option<TaskId> {
         let group_id: InternalId = self.ids.get(&group_id)?;
+        self.insert_task_into_group(group_id, Box::new(task))
+    }
+
+    fn insert_task_into_group(&mut self, group_id: InternalId, task: Box<dyn Task>) -> Option<TaskId> {
         let group: &mut TaskGroup = self.groups.get_mut(group_id.into())?;
-        let new_task_id: TaskId = group.insert(Box::new(task))?;
-        // Add a mapping so we can use this new task id to find the task in the future.
-        self.ids.insert(new_task_id, group_id);
+        // Task ids are handed out here, so they are unique across groups. Add a mapping so we can use this new task id
+        // to find the task in the future.
+        let new_task_id: TaskId = self.ids.insert_with_new_id(group_id);
+        if group.insert(new_task_id, task).is_none() {
+            self.ids.remove(&new_task_id);
+            return None;
+        }
         Some(new_task_id)
     }
 
@@ -150,30 +212,42 @@ impl Scheduler {
         result
     }
 
-    /// Poll all tasks which are ready to run for [max_iterations]. This does the same thing as get_next_completed task
-    /// but does not stop until it has reached [max_iterations] and collects all of the
+    /// Runs the task at `task_id` in the group at `group_id`. Tasks that it inserts go into the same group. Returns the
+    /// task if it completed.
+    fn run_task(&mut self, group_id: InternalId, task_id: InternalId) -> Option<Box<dyn Task>> {
+        let insert_group_id: InternalId = mem::replace(&mut self.current_group_id, group_id);
+        self.current_task_id = task_id;
+        let result: Option<Box<dyn Task>> = self.poll_notified_task_and_remove_if_ready();
+        // Free the group if it was removed while this task was still running and this task was its last one.
+        let group: &TaskGroup = &self.groups[group_id.into()];
+        if group.is_closing() && group.num_tasks() == 0 {
+            self.free_group(group_id);
+        }
+        // The task may have freed the group that new tasks went into.
+        self.current_group_id = if self.groups.contains(insert_group_id.into()) {
+            insert_group_id
+        } else {
+            self.root_group_id
+        };
+        result
+    }
+
+    /// Poll all tasks which are ready to run. This does the same thing as get_next_completed_task but does not stop at
+    /// the first completed task and collects all of them.
     pub fn poll_all(&mut self) -> Vec<Box<dyn Task>> {
         let mut completed_tasks: Vec<Box<dyn Task>> = vec![];
-        let start_group = self.current_group_id;
-        loop {
-            self.current_task_id = {
-                match self.current_ready_tasks.pop() {
-                    Some(index) => index,
-                    None => {
-                        self.next_runnable_group();
-                        if self.current_group_id == start_group {
-                            break;
-                        }
-                        match self.current_ready_tasks.pop() {
-                            Some(index) => index,
-                            None => return completed_tasks,
-                        }
-                    },
-                }
+        // Run as many tasks as are ready now, so that tasks that keep waking themselves up do not keep us here forever.
+        self.collect_ready_tasks();
+        let num_ready_tasks: usize = self
+            .active_groups
+            .iter()
+            .map(|group_id| self.groups[usize::from(*group_id)].num_ready_tasks())
+            .sum();
+        for _ in 0..num_ready_tasks {
+            let Some((group_id, task_id)) = self.next_ready_task() else {
+                break;
             };
-
-            // Now that we have a runnable task, actually poll it.
-            if let Some(task) = self.poll_notified_task_and_remove_if_ready() {
+            if let Some(task) = self.run_task(group_id, task_id) {
                 completed_tasks.push(task);
             }
         }
@@ -184,51 +258,74 @@ impl Scheduler {
     /// of tasks.
     pub fn get_next_completed_task(&mut self, max_iterations: usize) -> Option<Box<dyn Task>> {
         for _ in 0..max_iterations {
-            self.current_task_id = {
-                match self.current_ready_tasks.pop() {
-                    Some(index) => index,
-                    None => {
-                        self.next_runnable_group();
-                        match self.current_ready_tasks.pop() {
-                            Some(index) => index,
-                            None => return None,
-                        }
-                    },
-                }
-            };
-
+            let (group_id, task_id): (InternalId, InternalId) = self.next_ready_task()?;
             // Now that we have a runnable task, actually poll it.
-            if let Some(task) = self.poll_notified_task_and_remove_if_ready() {
+            if let Some(task) = self.run_task(group_id, task_id) {
                 return Some(task);
             }
         }
         None
     }
 
-    /// Poll over all of the groups looking for a group with runnable tasks. Sets the current_group_id to the next
-    /// runnable task group and current_ready_tasks to a list of tasks that are runnable in that group.
-    fn next_runnable_group(&mut self) {
-        let starting_group_index: InternalId = self.current_group_id;
-        self.current_group_id = self.get_next_group_index();
-
+    /// Picks the next task to run with deficit round robin across the groups that have ready tasks. On each of its
+    /// turns, a group runs as many ready tasks as its weight and then goes to the back of the line. A group that runs
+    /// out of ready tasks leaves the line for good, so the groups with many ready tasks cannot hold back the others for
+    /// longer than the sum of their weights. Returns the group and the task, or None if no task is ready.
+    fn next_ready_task(&mut self) -> Option<(InternalId, InternalId)> {
         loop {
-            self.current_ready_tasks = self.groups[self.current_group_id.into()].get_offsets_for_ready_tasks();
-            if !self.current_ready_tasks.is_empty() {
-                return;
-            }
-            // If we reach this point, then we have looped all the way around without finding any runnable tasks.
-            if self.current_group_id == starting_group_index {
-                return;
+            // Pick up the tasks that have been notified since the last turn, so they get their fair share right away.
+            let in_turn: bool = match self.active_groups.front() {
+                Some(group_id) => self.groups[usize::from(*group_id)].is_in_turn(),
+                None => false,
+            };
+            if !in_turn {
+                self.collect_ready_tasks();
             }
 
-            self.current_group_id = self.get_next_group_index();
+            let group_id: InternalId = *self.active_groups.front()?;
+            let group: &mut TaskGroup = &mut self.groups[group_id.into()];
+            if !group.is_in_turn() {
+                group.start_turn();
+            }
+            match group.pop_ready_task() {
+                Some(task_id) => {
+                    if group.charge_task() {
+                        // The turn is over, so line up again if there is more to do.
+                        self.active_groups.pop_front();
+                        if group.has_ready_tasks() {
+                            self.active_groups.push_back(group_id);
+                        } else {
+                            group.set_active(false);
+                        }
+                    }
+                    return Some((group_id, task_id));
+                },
+                None => {
+                    group.end_turn();
+                    group.set_active(false);
+                    self.active_groups.pop_front();
+                },
+            }
         }
     }
 
-    /// Choose the index of the next group to run.
-    fn get_next_group_index(&self) -> InternalId {
-        // For now, we just choose the next group in the list.
-        InternalId::from((usize::from(self.current_group_id) + 1) % self.groups.len())
+    /// Hands the tasks of the waker pages that have been notified over to their groups, and lines up the groups that
+    /// were not taking turns already.
+    fn collect_ready_tasks(&mut self) {
+        let mut ready_pages: Vec<(usize, usize)> = mem::take(&mut self.ready_pages);
+        self.ready_queue.swap(&mut ready_pages);
+        for (group_index, waker_page_index) in ready_pages.drain(..) {
+            // Wakers may outlive their group.
+            let Some(group) = self.groups.get_mut(group_index) else {
+                continue;
+            };
+            group.collect_notified_tasks(waker_page_index);
+            if !group.is_active() && group.has_ready_tasks() {
+                group.set_active(true);
+                self.active_groups.push_back(group_index.into());
+            }
+        }
+        self.ready_pages = ready_pages;
     }
 
     #[allow(unused)]
@@ -268,9 +365,10 @@ impl Scheduler {
 
 impl Default for Scheduler {
     fn default() -> Self {
-        let group: TaskGroup = TaskGroup::default();
+        let ready_queue: Rc<ReadyQueue> = Rc::new(ReadyQueue::default());
         let mut ids: IdMap<TaskId, InternalId> = IdMap::<TaskId, InternalId>::default();
         let mut groups: Slab<TaskGroup> = Slab::<TaskGroup>::default();
+        let group: TaskGroup = TaskGroup::new(ready_queue.clone(), groups.vacant_key());
         let internal_id: InternalId = groups.insert(group).into();
         // Use 0 as a special task id for the root.
         let current_task: TaskId = TaskId::from(0);
@@ -281,7 +379,10 @@ impl Default for Scheduler {
             current_running_task: Box::new(None),
             current_group_id: internal_id,
             current_task_id: InternalId(0),
-            current_ready_tasks: vec![],
+            root_group_id: internal_id,
+            ready_queue,
+            ready_pages: vec![],
+            active_groups: VecDeque::new(),
         }
     }
 }
@@ -339,15 +440,17 @@ mod tests {
     use crate::{
         expect_some,
         runtime::scheduler::{
-            scheduler::{Scheduler, TaskId},
+            scheduler::{Scheduler, TaskId, DEFAULT_GROUP_WEIGHT},
             task::TaskWithResult,
         },
     };
     use ::anyhow::Result;
     use ::futures::FutureExt;
     use ::std::{
+        cell::Cell,
         future::Future,
         pin::Pin,
+        rc::Rc,
         task::{Context, Poll, Waker},
     };
     use ::test::{black_box, Bencher};
@@ -382,8 +485,66 @@ mod tests {
         }
     }
 
+    /// A coroutine that never completes and only runs again when somebody else wakes it up.
+    struct IdleCoroutine {
+        /// Number of times that the coroutine was polled.
+        num_polls: Rc<Cell<usize>>,
+    }
+
+    impl Future for IdleCoroutine {
+        type Output = ();
+
+        fn poll(self: Pin<&mut Self>, _ctx: &mut Context) -> Poll<Self::Output> {
+            self.num_polls.set(self.num_polls.get() + 1);
+            Poll::Pending
+        }
+    }
+
+    /// A coroutine that never completes and always wakes itself up again.
+    struct BusyCoroutine {
+        /// Number of times that the coroutine was polled.
+        num_polls: Rc<Cell<usize>>,
+    }
+
+    impl Future for BusyCoroutine {
+        type Output = ();
+
+        fn poll(self: Pin<&mut Self>, ctx: &mut Context) -> Poll<Self::Output> {
+            self.num_polls.set(self.num_polls.get() + 1);
+            ctx.waker().wake_by_ref();
+            Poll::Pending
+        }
+    }
+
     type DummyTask = TaskWithResult<()>;
 
+    /// Inserts `num_tasks` idle tasks into `scheduler` and returns their task ids.
+    fn insert_idle_tasks(scheduler: &mut Scheduler, num_tasks: usize, num_polls: &Rc<Cell<usize>>) -> Vec<TaskId> {
+        (0..num_tasks)
+            .map(|_| {
+                let coroutine: IdleCoroutine = IdleCoroutine {
+                    num_polls: num_polls.clone(),
+                };
+                let task: DummyTask = DummyTask::new("testing", Box::pin(coroutine.fuse()));
+                expect_some!(scheduler.insert_task(task), "couldn't insert future in scheduler")
+            })
+            .collect()
+    }
+
+    /// Inserts `num_tasks` busy tasks into the group of `group_id` in `scheduler`.
+    fn insert_busy_tasks(scheduler: &mut Scheduler, group_id: TaskId, num_tasks: usize, num_polls: &Rc<Cell<usize>>) {
+        for _ in 0..num_tasks {
+            let coroutine: BusyCoroutine = BusyCoroutine {
+                num_polls: num_polls.clone(),
+            };
+            let task: DummyTask = DummyTask::new("testing", Box::pin(coroutine.fuse()));
+            expect_some!(
+                scheduler.insert_task_with_group_id(group_id, task),
+                "couldn't insert future in scheduler"
+            );
+        }
+    }
+
     /// Tests if when inserting multiple tasks into the scheduler at once each, of them gets a unique identifier.
     #[test]
     fn insert_creates_unique_tasks_ids() -> Result<()> {
@@ -558,6 +719,108 @@ mod tests {
         Ok(())
     }
 
+    /// Tests that tasks are polled only after they are woken up.
+    #[test]
+    fn poll_skips_idle_tasks() -> Result<()> {
+        const NUM_TASKS: usize = 1000;
+        let mut scheduler: Scheduler = Scheduler::default();
+        let num_polls: Rc<Cell<usize>> = Rc::new(Cell::new(0));
+        let task_ids: Vec<TaskId> = insert_idle_tasks(&mut scheduler, NUM_TASKS, &num_polls);
+
+        // All tasks are inserted with the notification flag set, so the first pass runs each of them once.
+        crate::ensure_eq!(scheduler.poll_all().len(), 0);
+        crate::ensure_eq!(num_polls.get(), NUM_TASKS);
+        crate::ensure_eq!(scheduler.poll_all().len(), 0);
+        crate::ensure_eq!(num_polls.get(), NUM_TASKS);
+
+        // Waking up some tasks makes them and only them run again.
+        for task_id in [task_ids[0], task_ids[NUM_TASKS / 2], task_ids[NUM_TASKS - 1]] {
+            expect_some!(scheduler.get_waker(task_id), "task should exist").wake();
+        }
+        crate::ensure_eq!(scheduler.get_next_completed_task(MAX_ITERATIONS).is_none(), true);
+        crate::ensure_eq!(num_polls.get(), NUM_TASKS + 3);
+
+        // Tasks that are removed after being woken up are not polled.
+        expect_some!(scheduler.get_waker(task_ids[1]), "task should exist").wake();
+        scheduler.remove_task(task_ids[1]);
+        crate::ensure_eq!(scheduler.poll_all().len(), 0);
+        crate::ensure_eq!(num_polls.get(), NUM_TASKS + 3);
+
+        Ok(())
+    }
+
+    /// Tests that a group with many ready tasks does not hold back the tasks of other groups.
+    #[test]
+    fn busy_group_does_not_starve_others() -> Result<()> {
+        let mut scheduler: Scheduler = Scheduler::default();
+        let num_polls: Rc<Cell<usize>> = Rc::new(Cell::new(0));
+        let busy_group_id: TaskId = scheduler.create_group();
+        insert_busy_tasks(&mut scheduler, busy_group_id, 64, &num_polls);
+        let group_id: TaskId = scheduler.create_group();
+        let task: DummyTask = DummyTask::new("testing", Box::pin(DummyCoroutine::new(0).fuse()));
+        let Some(task_id) = scheduler.insert_task_with_group_id(group_id, task) else {
+            anyhow::bail!("insert() failed")
+        };
+
+        // The busy group runs a single task on its turn, then the other group gets its own.
+        if let Some(task) = scheduler.get_next_completed_task(2) {
+            crate::ensure_eq!(task.get_id(), task_id);
+        } else {
+            anyhow::bail!("task should have completed");
+        }
+        crate::ensure_eq!(num_polls.get(), 1);
+
+        Ok(())
+    }
+
+    /// Tests that groups with ready tasks share the scheduler in proportion to their weights.
+    #[test]
+    fn groups_share_by_weight() -> Result<()> {
+        const NUM_ROUNDS: usize = 100;
+        let mut scheduler: Scheduler = Scheduler::default();
+        let heavy_polls: Rc<Cell<usize>> = Rc::new(Cell::new(0));
+        let light_polls: Rc<Cell<usize>> = Rc::new(Cell::new(0));
+        let heavy_group_id: TaskId = scheduler.create_group();
+        let light_group_id: TaskId = scheduler.create_group();
+        crate::ensure_eq!(scheduler.set_group_weight(heavy_group_id, 3), true);
+        crate::ensure_eq!(scheduler.get_group_weight(heavy_group_id), Some(3));
+        crate::ensure_eq!(scheduler.get_group_weight(light_group_id), Some(DEFAULT_GROUP_WEIGHT));
+        insert_busy_tasks(&mut scheduler, heavy_group_id, 8, &heavy_polls);
+        insert_busy_tasks(&mut scheduler, light_group_id, 8, &light_polls);
+
+        crate::ensure_eq!(scheduler.get_next_completed_task(4 * NUM_ROUNDS).is_none(), true);
+        crate::ensure_eq!(heavy_polls.get(), 3 * NUM_ROUNDS);
+        crate::ensure_eq!(light_polls.get(), NUM_ROUNDS);
+
+        Ok(())
+    }
+
+    /// Tests that a group that is removed with running tasks is freed along with the last of them.
+    #[test]
+    fn remove_group_waits_for_its_tasks() -> Result<()> {
+        let mut scheduler: Scheduler = Scheduler::default();
+        let group_id: TaskId = scheduler.create_group();
+        let task: DummyTask = DummyTask::new("testing", Box::pin(DummyCoroutine::new(1).fuse()));
+        let Some(task_id) = scheduler.insert_task_with_group_id(group_id, task) else {
+            anyhow::bail!("insert() failed")
+        };
+
+        crate::ensure_eq!(scheduler.remove_group(group_id), true);
+        crate::ensure_eq!(scheduler.remove_group(group_id), false);
+        crate::ensure_eq!(scheduler.groups.len(), 2);
+        if let Some(task) = scheduler.get_next_completed_task(MAX_ITERATIONS) {
+            crate::ensure_eq!(task.get_id(), task_id);
+        } else {
+            anyhow::bail!("task should have completed");
+        }
+        crate::ensure_eq!(scheduler.groups.len(), 1);
+
+        // The root group is never removed.
+        crate::ensure_eq!(scheduler.remove_group(TaskId::from(0)), false);
+
+        Ok(())
+    }
+
     #[bench]
     fn benchmark_insert(b: &mut Bencher) {
         let mut scheduler: Scheduler = Scheduler::default();
@@ -606,4 +869,20 @@ mod tests {
             black_box(scheduler.get_next_completed_task(MAX_ITERATIONS));
         });
     }
+
+    /// Polls a single busy task alongside many idle ones, like the network stack alongside the background coroutines
+    /// of idle connections.
+    #[bench]
+    fn benchmark_poll_with_idle_tasks(b: &mut Bencher) {
+        const NUM_TASKS: usize = 16384;
+        let mut scheduler: Scheduler = Scheduler::default();
+        let num_polls: Rc<Cell<usize>> = Rc::new(Cell::new(0));
+        insert_idle_tasks(&mut scheduler, NUM_TASKS, &num_polls);
+        insert_busy_tasks(&mut scheduler, TaskId::from(0), 1, &num_polls);
+        scheduler.poll_all();
+
+        b.iter(|| {
+            black_box(scheduler.poll_all());
+        });
+    }
 }
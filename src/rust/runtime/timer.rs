@@ -7,10 +7,8 @@
 //======================================================================================================================
 // Imports
 //======================================================================================================================
-use crate::{expect_some, runtime::SharedObject};
-use ::core::cmp::Reverse;
+use crate::{collections::timing_wheel::TimingWheel, runtime::SharedObject};
 use ::std::{
-    collections::BinaryHeap,
     future::Future,
     ops::{Deref, DerefMut},
     pin::Pin,
@@ -35,12 +33,21 @@ static THREAD_TIME: SharedTimer = SharedTimer::default();
 /// The state of the coroutine using this condition variable.
 enum YieldState {
     Running,
-    Yielded(YieldPointId),
+    Yielded(TimerKey),
 }
 
 #[derive(Eq, PartialEq, Clone, Copy)]
 struct YieldPointId(u64);
 
+/// Locates the time out of a yield point in the timing wheel.
+#[derive(Eq, PartialEq, Clone, Copy)]
+struct TimerKey {
+    /// Key of the time out in the timing wheel, which is reused once the time out is gone.
+    key: usize,
+    /// Yield point that armed the time out.
+    id: YieldPointId,
+}
+
 struct YieldPoint {
     /// The time out.
     expiry: Instant,
@@ -49,16 +56,18 @@ struct YieldPoint {
 }
 
 struct TimerQueueEntry {
-    expiry: Instant,
     id: YieldPointId,
     waker: Waker,
 }
 
 /// Timer that holds one or more events for future wake up.
 pub struct Timer {
+    // Time from which the timing wheel counts ticks.
+    origin: Instant,
     now: Instant,
-    // Use a reverse to get a min heap.
-    heap: BinaryHeap<Reverse<TimerQueueEntry>>,
+    // Time outs, kept in a hierarchical timing wheel that ticks once every nanosecond. This gives O(1) insertion and
+    // removal, and fires time outs at their exact expiry.
+    wheel: TimingWheel<TimerQueueEntry>,
     // Monotonically increasing identifier for yield points.
     last_id: YieldPointId,
 }
@@ -81,20 +90,15 @@ impl SharedTimer {
     fn set_time(&mut self, now: Instant) {
         // Clear out existing timers because they are meaningless once time has been moved in a non-monotonically
         // increasing manner.
-        self.heap.clear();
+        self.wheel.reset(0);
+        self.origin = now;
         self.now = now;
     }
 
     fn advance_clock(&mut self, now: Instant) {
         assert!(self.now <= now);
-        while let Some(Reverse(entry)) = self.heap.peek() {
-            if now < entry.expiry {
-                break;
-            }
-            let entry: TimerQueueEntry =
-                expect_some!(self.heap.pop(), "should have an entry because we were able to peek").0;
-            entry.waker.wake_by_ref();
-        }
+        let ticks: u64 = self.ticks(now);
+        self.wheel.advance(ticks, |entry: TimerQueueEntry| entry.waker.wake());
         self.now = now;
     }
 
@@ -102,17 +106,36 @@ impl SharedTimer {
         self.now
     }
 
-    fn add_timeout(&mut self, expiry: Instant, waker: Waker) -> YieldPointId {
+    /// Returns a time that is not after the earliest time out, if there is any.
+    fn next_expiry(&self) -> Option<Instant> {
+        let ticks: u64 = self.wheel.next_deadline()?;
+        Some(self.origin + Duration::from_nanos(ticks))
+    }
+
+    fn add_timeout(&mut self, expiry: Instant, waker: Waker) -> TimerKey {
         let id = self.last_id;
         self.last_id.increment();
 
-        let entry: TimerQueueEntry = TimerQueueEntry { expiry, id, waker };
-        self.heap.push(Reverse(entry));
-        id
+        let ticks: u64 = self.ticks(expiry);
+        let key: usize = self.wheel.insert(ticks, TimerQueueEntry { id, waker });
+        TimerKey { key, id }
+    }
+
+    fn remove_timeout(&mut self, key: TimerKey) {
+        // The time out may have fired already, and its key may have been handed out to another yield point since.
+        if let Some(entry) = self.wheel.get(key.key) {
+            if entry.id == key.id {
+                self.wheel.remove(key.key);
+            }
+        }
     }
 
-    fn remove_timeout(&mut self, id: YieldPointId) {
-        self.heap.retain(|entry| entry.0.id != id);
+    /// Converts [instant] into ticks of the timing wheel.
+    fn ticks(&self, instant: Instant) -> u64 {
+        instant
+            .saturating_duration_since(self.origin)
+            .as_nanos()
+            .min(u64::MAX as u128) as u64
     }
 }
 
@@ -139,6 +162,11 @@ pub fn global_get_time() -> Instant {
     THREAD_TIME.with(|s| s.now())
 }
 
+/// Gets a time that is not after the earliest pending time out in the Demikernel system, if there is any.
+pub fn global_next_expiry() -> Option<Instant> {
+    THREAD_TIME.with(|s| s.next_expiry())
+}
+
 /// Blocks until the system time moves
 pub async fn wait(timeout: Duration) {
     let now: Instant = global_get_time();
@@ -159,9 +187,11 @@ pub async fn wait_until(expiry: Instant) {
 
 impl Default for SharedTimer {
     fn default() -> Self {
+        let now: Instant = Instant::now();
         Self(SharedObject::<Timer>::new(Timer {
-            now: Instant::now(),
-            heap: BinaryHeap::new(),
+            origin: now,
+            now,
+            wheel: TimingWheel::new(),
             last_id: YieldPointId(0),
         }))
     }
@@ -181,29 +211,6 @@ impl DerefMut for SharedTimer {
     }
 }
 
-impl PartialEq for TimerQueueEntry {
-    fn eq(&self, other: &TimerQueueEntry) -> bool {
-        // This is technically not correct. However for the usage in this module
-        // we only need to compare timers by expiration.
-        self.expiry == other.expiry
-    }
-}
-
-impl Eq for TimerQueueEntry {}
-
-impl PartialOrd for TimerQueueEntry {
-    fn partial_cmp(&self, other: &TimerQueueEntry) -> Option<core::cmp::Ordering> {
-        // Compare timer queue entries by expiration time
-        self.expiry.partial_cmp(&other.expiry)
-    }
-}
-
-impl Ord for TimerQueueEntry {
-    fn cmp(&self, other: &TimerQueueEntry) -> core::cmp::Ordering {
-        self.expiry.cmp(&other.expiry)
-    }
-}
-
 impl Future for YieldPoint {
     type Output = ();
 
@@ -215,9 +222,9 @@ impl Future for YieldPoint {
                 if self_.expiry <= global_get_time() {
                     Poll::Ready(())
                 } else {
-                    let id: YieldPointId =
+                    let key: TimerKey =
                         THREAD_TIME.with(|s| s.clone().add_timeout(self_.expiry, context.waker().clone()));
-                    self_.state = YieldState::Yielded(id);
+                    self_.state = YieldState::Yielded(key);
                     Poll::Pending
                 }
             },
@@ -235,8 +242,8 @@ impl Future for YieldPoint {
 
 impl Drop for YieldPoint {
     fn drop(&mut self) {
-        if let YieldState::Yielded(id) = self.state {
-            THREAD_TIME.with(|s| s.clone().remove_timeout(id));
+        if let YieldState::Yielded(key) = self.state {
+            THREAD_TIME.with(|s| s.clone().remove_timeout(key));
         }
     }
 }
@@ -247,16 +254,32 @@ impl Drop for YieldPoint {
 
 #[cfg(test)]
 mod tests {
-    use crate::runtime::timer::{global_advance_clock, wait};
+    use crate::runtime::timer::{global_advance_clock, wait, SharedTimer, TimerKey, THREAD_TIME};
     use ::anyhow::Result;
+    use ::rand::Rng;
+    use ::test::{black_box, Bencher};
     use futures::task::noop_waker_ref;
     use std::{
         future::Future,
         pin::Pin,
-        task::Context,
+        task::{Context, Waker},
         time::{Duration, Instant},
     };
 
+    /// Number of time outs that are armed in the large-scale tests, which is on par with the number of time outs armed
+    /// by 100k+ TCP connections.
+    const NUM_TIMEOUTS: usize = 1_000_000;
+
+    /// Arms [NUM_TIMEOUTS] time outs that expire within a minute.
+    fn arm_timeouts(timer: &mut SharedTimer) -> Vec<TimerKey> {
+        let mut rng = rand::thread_rng();
+        let now: Instant = timer.now();
+        let waker: Waker = noop_waker_ref().clone();
+        (0..NUM_TIMEOUTS)
+            .map(|_| timer.add_timeout(now + Duration::from_micros(rng.gen_range(1..60_000_000)), waker.clone()))
+            .collect()
+    }
+
     #[test]
     fn test_timer() -> Result<()> {
         let mut ctx = Context::from_waker(noop_waker_ref());
@@ -315,4 +338,64 @@ mod tests {
 
         Ok(())
     }
+
+    /// Checks that a yield point that is dropped before it expires takes its time out away from the timer.
+    #[test]
+    fn test_timer_cancel_on_drop() -> Result<()> {
+        let mut ctx = Context::from_waker(noop_waker_ref());
+        {
+            let wait_future = wait(Duration::from_secs(1));
+            futures::pin_mut!(wait_future);
+            crate::ensure_eq!(Future::poll(Pin::new(&mut wait_future), &mut ctx).is_ready(), false);
+            crate::ensure_eq!(THREAD_TIME.with(|s| s.wheel.len()), 1);
+        }
+        crate::ensure_eq!(THREAD_TIME.with(|s| s.wheel.len()), 0);
+
+        Ok(())
+    }
+
+    /// Checks the memory footprint of the timer with [NUM_TIMEOUTS] time outs armed.
+    #[test]
+    fn test_timer_footprint() -> Result<()> {
+        let mut timer: SharedTimer = SharedTimer::default();
+        let keys: Vec<TimerKey> = arm_timeouts(&mut timer);
+        crate::ensure_eq!(timer.wheel.len(), NUM_TIMEOUTS);
+        let bytes_per_timeout: usize = timer.wheel.footprint() / NUM_TIMEOUTS;
+        info!("footprint: {:?} bytes per time out", bytes_per_timeout);
+        crate::ensure_eq!(bytes_per_timeout <= 64, true);
+
+        // Cancelled time outs are gone right away.
+        for key in keys {
+            timer.remove_timeout(key);
+        }
+        crate::ensure_eq!(timer.wheel.is_empty(), true);
+
+        Ok(())
+    }
+
+    #[bench]
+    fn bench_arm_cancel(b: &mut Bencher) {
+        let mut timer: SharedTimer = SharedTimer::default();
+        arm_timeouts(&mut timer);
+        let waker: Waker = noop_waker_ref().clone();
+        let expiry: Instant = timer.now() + Duration::from_millis(200);
+
+        b.iter(|| {
+            let key: TimerKey = timer.add_timeout(black_box(expiry), waker.clone());
+            timer.remove_timeout(black_box(key));
+        });
+    }
+
+    #[bench]
+    fn bench_advance_clock(b: &mut Bencher) {
+        let mut timer: SharedTimer = SharedTimer::default();
+        arm_timeouts(&mut timer);
+        let mut now: Instant = timer.now();
+
+        // Every iteration moves time forward by 10 microseconds and fires the time outs that expire meanwhile.
+        b.iter(|| {
+            now += Duration::from_micros(10);
+            timer.advance_clock(black_box(now));
+        });
+    }
 }
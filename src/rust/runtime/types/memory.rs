@@ -5,8 +5,8 @@
 // Constants
 //======================================================================================================================
 
-/// Maximum Length for Scatter-Gather Arrays
-pub const DEMI_SGARRAY_MAXLEN: usize = 1;
+/// Maximum Length for Scatter-Gather Arrays (must match `DEMI_SGARRAY_MAXSIZE` in `include/demi/types.h`).
+pub const DEMI_SGARRAY_MAXLEN: usize = 16;
 
 //======================================================================================================================
 // Structures
@@ -6,6 +6,7 @@
 mod memory;
 mod ops;
 mod queue;
+mod stats;
 
 //======================================================================================================================
 // Exports
@@ -15,6 +16,7 @@ pub use self::{
     memory::{demi_sgarray_t, demi_sgaseg_t, DEMI_SGARRAY_MAXLEN},
     ops::{demi_accept_result_t, demi_opcode_t, demi_qr_value_t, demi_qresult_t},
     queue::demi_qtoken_t,
+    stats::{demi_latency_t, demi_stats_t},
 };
 
 //======================================================================================================================
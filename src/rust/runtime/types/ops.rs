@@ -38,6 +38,9 @@ pub union demi_qr_value_t {
 }
 
 /// Result
+///
+/// This structure is packed in C, so the padding that Rust would add at its end is spelled out (must match
+/// `demi_qresult_t` in `include/demi/types.h`).
 #[repr(C)]
 pub struct demi_qresult_t {
     pub qr_opcode: demi_opcode_t,
@@ -45,6 +48,7 @@ pub struct demi_qresult_t {
     pub qr_qt: demi_qtoken_t,
     pub qr_ret: i64,
     pub qr_value: demi_qr_value_t,
+    pub qr_pad: u32,
 }
 
 //======================================================================================================================
@@ -94,10 +98,12 @@ mod test {
         const QR_RET_SIZE: usize = 8;
         // Size of a demi_qr_value_t structure.
         const QR_VALUE_SIZE: usize = mem::size_of::<demi_qr_value_t>();
-        // Size of a demi_qresult_t structure.
+        // Size of a u32.
+        const QR_PAD_SIZE: usize = 4;
+        // Size of a demi_qresult_t structure. The C structure is packed, so Rust must not pad it any further.
         crate::ensure_eq!(
             mem::size_of::<demi_qresult_t>(),
-            QR_OPCODE_SIZE + QR_QD_SIZE + QR_QT_SIZE + QR_RET_SIZE + QR_VALUE_SIZE
+            QR_OPCODE_SIZE + QR_QD_SIZE + QR_QT_SIZE + QR_RET_SIZE + QR_VALUE_SIZE + QR_PAD_SIZE
         );
         Ok(())
     }
@@ -0,0 +1,56 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Summary of a latency histogram. Latencies are in nanoseconds and percentiles are within 1/16 of the true value.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default, Eq, PartialEq)]
+pub struct demi_latency_t {
+    pub count: u64,
+    pub min_ns: u64,
+    pub mean_ns: u64,
+    pub p50_ns: u64,
+    pub p99_ns: u64,
+    pub p999_ns: u64,
+    pub max_ns: u64,
+}
+
+/// Statistics of a socket or of a thread. Counters only increase, so rates are differences between two snapshots.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default, Eq, PartialEq)]
+pub struct demi_stats_t {
+    pub packets_in: u64,
+    pub packets_out: u64,
+    pub bytes_in: u64,
+    pub bytes_out: u64,
+    pub drops: u64,
+    pub retransmits: u64,
+    pub rto_fires: u64,
+    pub ooo_bytes: u64,
+    pub mempool_exhausted: u64,
+    pub push_completion: demi_latency_t,
+    pub pop_wait: demi_latency_t,
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+
+    use crate::runtime::types::stats::*;
+    use ::std::mem;
+
+    /// Tests if `demi_stats_t` has the expected size.
+    #[test]
+    fn test_size_demi_stats_t() -> Result<(), anyhow::Error> {
+        // Nine counters and two latency summaries of seven fields, all 64 bits wide.
+        const DEMI_STATS_SIZE: usize = (9 + 2 * 7) * 8;
+        crate::ensure_eq!(mem::size_of::<demi_stats_t>(), DEMI_STATS_SIZE);
+        Ok(())
+    }
+}
@@ -0,0 +1,168 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Wait sets.
+//!
+//! A wait set is a registered group of queue tokens that an application waits on as a whole. The runtime records, for
+//! every registered queue token, the wait set that it belongs to. When an operation completes, the runtime appends its
+//! queue token to the ready list of that wait set, so waiting on a wait set costs O(1) per completion regardless of the
+//! number of queue tokens that it holds.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::runtime::QToken;
+use ::std::collections::{HashSet, VecDeque};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Wait Set Descriptor
+#[derive(Debug, Eq, PartialEq, Hash, Copy, Clone)]
+#[repr(C)]
+pub struct WaitSetId(u32);
+
+/// A set of queue tokens along with the members that have completed and are waiting to be reaped.
+#[derive(Default)]
+pub struct WaitSet {
+    /// Queue tokens that belong to this wait set.
+    members: HashSet<QToken>,
+    /// Queue tokens of completed members, in completion order. A queue token that left the wait set after its
+    /// operation completed has a stale entry here, which is skipped when the list is drained.
+    ready: VecDeque<QToken>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+impl WaitSet {
+    /// Adds `qt` to the wait set. Returns false if it was already a member.
+    pub fn insert(&mut self, qt: QToken) -> bool {
+        self.members.insert(qt)
+    }
+
+    /// Removes `qt` from the wait set. Returns false if it was not a member.
+    pub fn remove(&mut self, qt: &QToken) -> bool {
+        self.members.remove(qt)
+    }
+
+    /// Checks if `qt` is a member of the wait set.
+    pub fn contains(&self, qt: &QToken) -> bool {
+        self.members.contains(qt)
+    }
+
+    /// Returns the number of members in the wait set.
+    pub fn len(&self) -> usize {
+        self.members.len()
+    }
+
+    /// Checks if the wait set has no members.
+    pub fn is_empty(&self) -> bool {
+        self.members.is_empty()
+    }
+
+    /// Records that the operation of member `qt` has completed.
+    pub fn notify(&mut self, qt: QToken) {
+        debug_assert!(self.members.contains(&qt));
+        self.ready.push_back(qt);
+    }
+
+    /// Removes the member that completed first from the wait set and returns it.
+    pub fn pop_ready(&mut self) -> Option<QToken> {
+        while let Some(qt) = self.ready.pop_front() {
+            if self.members.remove(&qt) {
+                return Some(qt);
+            }
+        }
+        None
+    }
+
+    /// Removes all members from the wait set and returns them.
+    pub fn drain(&mut self) -> impl Iterator<Item = QToken> + '_ {
+        self.ready.clear();
+        self.members.drain()
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl From<WaitSetId> for i32 {
+    /// Converts a [WaitSetId] to a [i32].
+    fn from(val: WaitSetId) -> Self {
+        val.0 as i32
+    }
+}
+
+impl From<i32> for WaitSetId {
+    /// Converts a [i32] to a [WaitSetId].
+    fn from(val: i32) -> Self {
+        WaitSetId(val as u32)
+    }
+}
+
+impl From<WaitSetId> for usize {
+    /// Converts a [WaitSetId] to a [usize].
+    fn from(val: WaitSetId) -> Self {
+        val.0 as usize
+    }
+}
+
+impl From<usize> for WaitSetId {
+    /// Converts a [usize] to a [WaitSetId].
+    fn from(val: usize) -> Self {
+        WaitSetId(val as u32)
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use crate::runtime::{waitset::WaitSet, QToken};
+    use ::anyhow::Result;
+
+    /// Checks that completed members are reaped in completion order and leave the wait set.
+    #[test]
+    fn test_wait_set_pop_ready_in_completion_order() -> Result<()> {
+        let mut wait_set: WaitSet = WaitSet::default();
+        for i in 1..=4 {
+            crate::ensure_eq!(wait_set.insert(QToken::from(i)), true);
+        }
+        crate::ensure_eq!(wait_set.insert(QToken::from(1)), false);
+
+        wait_set.notify(QToken::from(3));
+        wait_set.notify(QToken::from(1));
+        crate::ensure_eq!(wait_set.pop_ready(), Some(QToken::from(3)));
+        crate::ensure_eq!(wait_set.pop_ready(), Some(QToken::from(1)));
+        crate::ensure_eq!(wait_set.pop_ready(), None);
+        crate::ensure_eq!(wait_set.len(), 2);
+        crate::ensure_eq!(wait_set.contains(&QToken::from(3)), false);
+
+        Ok(())
+    }
+
+    /// Checks that members that leave the wait set after completing are not reaped.
+    #[test]
+    fn test_wait_set_skips_removed_members() -> Result<()> {
+        let mut wait_set: WaitSet = WaitSet::default();
+        wait_set.insert(QToken::from(1));
+        wait_set.insert(QToken::from(2));
+
+        wait_set.notify(QToken::from(1));
+        wait_set.notify(QToken::from(2));
+        crate::ensure_eq!(wait_set.remove(&QToken::from(1)), true);
+        crate::ensure_eq!(wait_set.remove(&QToken::from(1)), false);
+        crate::ensure_eq!(wait_set.pop_ready(), Some(QToken::from(2)));
+        crate::ensure_eq!(wait_set.pop_ready(), None);
+        crate::ensure_eq!(wait_set.is_empty(), true);
+
+        Ok(())
+    }
+}
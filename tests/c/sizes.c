@@ -61,7 +61,8 @@
 #define QR_QT_SIZE 8
 #define QR_RET_SIZE 8
 #define QR_VALUE_SIZE (MAX(DEMI_ACCEPT_RESULT_T_SIZE, DEMI_SGARRAY_T_SIZE))
-#define DEMI_QRESULT_T_SIZE (QR_OPCODE_SIZE + QR_QD_SIZE + QR_QT_SIZE + QR_RET_SIZE + QR_VALUE_SIZE)
+#define QR_PAD_SIZE 4
+#define DEMI_QRESULT_T_SIZE (QR_OPCODE_SIZE + QR_QD_SIZE + QR_QT_SIZE + QR_RET_SIZE + QR_VALUE_SIZE + QR_PAD_SIZE)
 #define DEMI_ARGS_ARGC_SIZE 4
 #define DEMI_ARGS_ARGV_SIZE 8
 #define DEMI_ARGS_CALLBACK_SIZE 8
@@ -32,6 +32,28 @@ static bool inval_socket(void)
     return (demi_socket(qd, domain, type, protocol) != 0);
 }
 
+/**
+ * @brief Issues an invalid call to demi_create_pipe().
+ */
+static bool inval_create_pipe(void)
+{
+    int *qd = NULL;
+    const char *name = NULL;
+
+    return (demi_create_pipe(qd, name) != 0);
+}
+
+/**
+ * @brief Issues an invalid call to demi_open_pipe().
+ */
+static bool inval_open_pipe(void)
+{
+    int *qd = NULL;
+    const char *name = NULL;
+
+    return (demi_open_pipe(qd, name) != 0);
+}
+
 /**
  * @brief Issues an invalid call to demi_listen().
  */
@@ -101,6 +123,20 @@ static bool inval_push(void)
     return (demi_push(qt, qd, sga) != 0);
 }
 
+/**
+ * @brief Issues an invalid call to demi_push_n().
+ */
+static bool inval_push_n(void)
+{
+    demi_qtoken_t *qts = NULL;
+    int *qds = NULL;
+    demi_sgarray_t *sgas = NULL;
+    int n = 1;
+    int nsubmitted = -1;
+
+    return ((demi_push_n(qts, qds, sgas, n, &nsubmitted) != 0) && (nsubmitted <= 0));
+}
+
 /**
  * @brief Issues an invalid call to demi_pushto().
  */
@@ -126,6 +162,35 @@ static bool inval_pop(void)
     return (demi_pop(qt, qd) != 0);
 }
 
+/**
+ * @brief Issues an invalid call to demi_pushto_n().
+ */
+static bool inval_pushto_n(void)
+{
+    demi_qtoken_t *qts = NULL;
+    int *sockqds = NULL;
+    demi_sgarray_t *sgas = NULL;
+    const struct sockaddr **dest_addrs = NULL;
+    socklen_t size = 0;
+    int n = 1;
+    int nsubmitted = -1;
+
+    return ((demi_pushto_n(qts, sockqds, sgas, dest_addrs, size, n, &nsubmitted) != 0) && (nsubmitted <= 0));
+}
+
+/**
+ * @brief Issues an invalid call to demi_pop_n().
+ */
+static bool inval_pop_n(void)
+{
+    demi_qtoken_t *qts = NULL;
+    int *qds = NULL;
+    int n = 1;
+    int nsubmitted = -1;
+
+    return ((demi_pop_n(qts, qds, n, &nsubmitted) != 0) && (nsubmitted <= 0));
+}
+
 /**
  * @brief Issues an invalid call to demi_setsockopt().
  */
@@ -164,6 +229,16 @@ static bool inval_getpeername(void)
     return (demi_getpeername(qd, NULL, NULL) != 0);
 }
 
+/**
+ * @brief Issues an invalid call to demi_getstats().
+ */
+static bool inval_getstats(void)
+{
+    int qd = -1;
+
+    return (demi_getstats(qd, NULL) != 0);
+}
+
 /*===================================================================================================================*
  * System Calls in demi/sga.h                                                                                        *
  *===================================================================================================================*/
@@ -179,6 +254,18 @@ static bool inval_sgaalloc(void)
     return (sga.sga_buf == NULL);
 }
 
+/**
+ * @brief Issues an invalid call to demi_sgaallocv().
+ */
+static bool inval_sgaallocv(void)
+{
+    const size_t *seglens = NULL;
+    uint32_t numsegs = 2;
+
+    demi_sgarray_t sga = demi_sgaallocv(seglens, numsegs);
+    return (sga.sga_buf == NULL);
+}
+
 /**
  * @brief Issues an invalid call to demi_sgafree().
  */
@@ -219,6 +306,80 @@ static bool inval_wait_any(void)
     return (demi_wait_any(qr, ready_offset, qts, num_qts, timeout) != 0);
 }
 
+/**
+ * @brief Issues an invalid system call to demi_waitset_create().
+ */
+static bool inval_waitset_create(void)
+{
+    int *wsd = NULL;
+
+    return (demi_waitset_create(wsd) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_waitset_close().
+ */
+static bool inval_waitset_close(void)
+{
+    int wsd = -1;
+
+    return (demi_waitset_close(wsd) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_waitset_add().
+ */
+static bool inval_waitset_add(void)
+{
+    int wsd = -1;
+    demi_qtoken_t qt = -1;
+
+    return (demi_waitset_add(wsd, qt) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_waitset_remove().
+ */
+static bool inval_waitset_remove(void)
+{
+    int wsd = -1;
+    demi_qtoken_t qt = -1;
+
+    return (demi_waitset_remove(wsd, qt) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_waitset_wait().
+ */
+static bool inval_waitset_wait(void)
+{
+    demi_qresult_t *qr = NULL;
+    int wsd = -1;
+    struct timespec *timeout = NULL;
+
+    return (demi_waitset_wait(qr, wsd, timeout) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_cq_register().
+ */
+static bool inval_cq_register(void)
+{
+    demi_cq_t *cq = NULL;
+    size_t size = 0;
+
+    return (demi_cq_register(cq, size) != 0);
+}
+
+/**
+ * @brief Issues an invalid system call to demi_cq_unregister().
+ */
+static bool inval_cq_unregister(void)
+{
+    // No completion queue is registered.
+    return (demi_cq_unregister() != 0);
+}
+
 #pragma GCC diagnostic pop
 
 /*===================================================================================================================*
@@ -241,19 +402,31 @@ static struct test tests_libos[] = {{inval_socket, "invalid demi_socket()"},   {
                                     {inval_bind, "invalid demi_bind()"},       {inval_close, "invalid_demi_close()"},
                                     {inval_connect, "invalid demi_connect()"}, {inval_listen, "invalid demi_listen()"},
                                     {inval_pop, "invalid demi_pop()"},         {inval_push, "invalid demi_push()"},
-                                    {inval_pushto, "invalid demi_pushto()"},   {inval_getpeername, "invalid demi_getpeername()"},
-                                    {inval_setsockopt, "invalid demi_setsockopt()"}, {inval_getsockopt, "invalid demi_getsockopt()}"}};
+                                    {inval_pop_n, "invalid demi_pop_n()"},     {inval_push_n, "invalid demi_push_n()"},
+                                    {inval_pushto, "invalid demi_pushto()"},   {inval_pushto_n, "invalid demi_pushto_n()"},
+                                    {inval_getpeername, "invalid demi_getpeername()"}, {inval_getstats, "invalid demi_getstats()"},
+                                    {inval_setsockopt, "invalid demi_setsockopt()"}, {inval_getsockopt, "invalid demi_getsockopt()}"},
+                                    {inval_create_pipe, "invalid demi_create_pipe()"}, {inval_open_pipe, "invalid demi_open_pipe()"}};
 
 /**
  * @brief Tests for system calls in demi/sga.h
  */
 static struct test tests_sga[] = {{inval_sgaalloc, "invalid demi_sgaalloc()"},
+                                  {inval_sgaallocv, "invalid demi_sgaallocv()"},
                                   {inval_sgafree, "invalid demi_sgafree()"}};
 
 /**
  * @brief Tests for system calls in demi/wait.h
  */
-static struct test tests_wait[] = {{inval_wait, "invalid demi_wait()"}, {inval_wait_any, "invalid demi_wait_any()"}};
+static struct test tests_wait[] = {{inval_wait, "invalid demi_wait()"},
+                                   {inval_wait_any, "invalid demi_wait_any()"},
+                                   {inval_waitset_create, "invalid demi_waitset_create()"},
+                                   {inval_waitset_close, "invalid demi_waitset_close()"},
+                                   {inval_waitset_add, "invalid demi_waitset_add()"},
+                                   {inval_waitset_remove, "invalid demi_waitset_remove()"},
+                                   {inval_waitset_wait, "invalid demi_waitset_wait()"},
+                                   {inval_cq_register, "invalid demi_cq_register()"},
+                                   {inval_cq_unregister, "invalid demi_cq_unregister()"}};
 
 /**
  * @brief Drives the application.
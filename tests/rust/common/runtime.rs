@@ -7,21 +7,16 @@
 
 use ::arrayvec::ArrayVec;
 use ::demikernel::{
-    demi_sgarray_t, demi_sgaseg_t,
+    demi_sgarray_t,
     inetstack::protocols::{layer1::PhysicalLayer, MAX_HEADER_SIZE},
     runtime::{
         fail::Fail,
-        memory::{DemiBuffer, MemoryRuntime},
+        memory::{self, DemiBuffer, MemoryRuntime},
         network::consts::RECEIVE_BATCH_SIZE,
         SharedObject,
     },
 };
-use ::libc::c_void;
-use ::log::error;
-use ::std::{
-    mem,
-    ops::{Deref, DerefMut},
-};
+use ::std::ops::{Deref, DerefMut};
 
 //======================================================================================================================
 // Structures
@@ -88,38 +83,10 @@ impl PhysicalLayer for SharedDummyRuntime {
 
 impl MemoryRuntime for SharedDummyRuntime {
     /// Allocates a scatter-gather array.
-    fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // TODO: Allocate an array of buffers if requested size is too large for a single buffer.
-
-        // We can't allocate a zero-sized buffer.
-        if size == 0 {
-            let cause: String = format!("cannot allocate a zero-sized buffer");
-            error!("sgaalloc(): {}", cause);
-            return Err(Fail::new(libc::EINVAL, &cause));
-        }
-
-        // We can't allocate more than a single buffer.
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
-        }
-
-        // First allocate the underlying DemiBuffer.
+    fn sgaallocv(&self, seglens: &[usize]) -> Result<demi_sgarray_t, Fail> {
         // Always allocate with header space for now even if we do not need it.
-        let buf: DemiBuffer = DemiBuffer::new_with_headroom(size as u16, MAX_HEADER_SIZE as u16);
-
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
+        memory::alloc_sgarray(seglens, |size: usize| -> Result<DemiBuffer, Fail> {
+            Ok(DemiBuffer::new_with_headroom(size as u16, MAX_HEADER_SIZE as u16))
         })
     }
 }
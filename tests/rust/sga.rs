@@ -171,3 +171,41 @@ fn test_unit_sga_alloc_free_loop_decoupled_small() -> Result<()> {
 fn test_unit_sga_alloc_free_loop_decoupled_big() -> Result<()> {
     do_test_unit_sga_alloc_free_loop_decoupled(SGA_SIZE_BIG)
 }
+
+//======================================================================================================================
+// test_unit_sga_alloc_free_multi()
+//======================================================================================================================
+
+/// Tests allocation and deallocation of a scatter-gather array with multiple segments.
+#[test]
+fn test_unit_sga_alloc_free_multi() -> Result<()> {
+    let libos_name: LibOSName = match LibOSName::from_env() {
+        Ok(libos_name) => libos_name.into(),
+        Err(e) => anyhow::bail!("{:?}", e),
+    };
+    let mut libos: LibOS = match LibOS::new(libos_name, None) {
+        Ok(libos) => libos,
+        Err(e) => anyhow::bail!("failed to initialize libos: {:?}", e),
+    };
+
+    let seglens: [usize; 3] = [SGA_SIZE_SMALL, SGA_SIZE_BIG, SGA_SIZE_SMALL];
+    let sga: demi_sgarray_t = match libos.sgaallocv(&seglens) {
+        Ok(sga) => sga,
+        Err(e) => anyhow::bail!("failed to allocate sga: {:?}", e),
+    };
+
+    // Check that every segment has the requested size.
+    if sga.sga_numsegs as usize != seglens.len() {
+        anyhow::bail!("sga has {:?} segments (expected={:?})", sga.sga_numsegs, seglens.len());
+    }
+    for (i, seglen) in seglens.iter().enumerate() {
+        if sga.sga_segs[i].sgaseg_len as usize != *seglen {
+            anyhow::bail!("sga segment {:?} has the wrong size (expected={:?})", i, seglen);
+        }
+    }
+
+    match libos.sgafree(sga) {
+        Ok(()) => Ok(()),
+        Err(e) => anyhow::bail!("failed to release sga: {:?}", e.cause),
+    }
+}
@@ -2,11 +2,13 @@
 # Licensed under the MIT license.
 
 import argparse
+import json
+import sys
 from os import mkdir
 from shutil import move, rmtree
 from os.path import isdir
 import yaml
-from ci.job.linux import CheckoutJobOnLinux, CleanupJobOnLinux, CompileJobOnLinux, TcpEchoTest
+from ci.job.linux import BenchmarkJobOnLinux, CheckoutJobOnLinux, CleanupJobOnLinux, CompileJobOnLinux, TcpEchoTest
 from ci.job.utils import set_commit_hash, set_libos
 import ci.git as git
 
@@ -61,6 +63,15 @@ def run_pipeline(
     if status["checkout"]:
         status["compile"] = CompileJobOnLinux(config).execute()
 
+    # STEP 3: Run microbenchmarks and keep their results, so that they can be compared across commits.
+    if status["checkout"] and status["compile"]:
+        job: BenchmarkJobOnLinux = BenchmarkJobOnLinux(config)
+        status["benchmarks"] = job.execute()
+        if status["benchmarks"]:
+            results: dict = read_results(job.results_path())
+            with open(f"{log_directory}/benchmarks-{libos}-{git.get_head_commit(branch)}.json", "w") as file:
+                json.dump(results, file)
+
     # STEP 4: Run system tests.
     if status["checkout"] and status["compile"]:
         ci_map = read_yaml()
@@ -83,12 +94,72 @@ def read_yaml():
     return yaml.safe_load(yaml_str)
 
 
+# Reads the results of a benchmark run, either from a JSON file or from a log that has them on a line of their own.
+def read_results(path: str) -> dict:
+    with open(path) as f:
+        text: str = f.read()
+    try:
+        return json.loads(text)
+    except json.JSONDecodeError:
+        for line in text.splitlines():
+            if line.startswith("{\"libos\""):
+                return json.loads(line)
+    raise Exception(f"no benchmark results in {path}")
+
+
+# Tells whether a larger value of a metric is better. Throughputs are, latencies and costs are not.
+def higher_is_better(metric: str) -> bool:
+    return metric.endswith("_per_sec")
+
+
+# Compares two benchmark runs of the same LibOS and prints a table of the differences. Returns the number of metrics
+# that got worse by more than threshold percent.
+def compare_results(baseline: dict, current: dict, threshold: float) -> int:
+    if baseline["libos"] != current["libos"]:
+        raise Exception(f"cannot compare results of {baseline['libos']} against results of {current['libos']}")
+
+    before: dict = {(r["name"], r["n"]): r["metrics"] for r in baseline["results"]}
+    nregressions: int = 0
+    print(f"libos = {current['libos']}")
+    print("| benchmark | n | metric | baseline | current | change |")
+    print("|---|---|---|---|---|---|")
+    for result in current["results"]:
+        key: tuple = (result["name"], result["n"])
+        if key not in before:
+            continue
+        for metric, value in result["metrics"].items():
+            old: float = before[key].get(metric)
+            if old is None or old == 0:
+                continue
+            change: float = (value - old) * 100.0 / old
+            worse: bool = change < -threshold if higher_is_better(metric) else change > threshold
+            nregressions += 1 if worse else 0
+            print("| {} | {} | {} | {:.2f} | {:.2f} | {:+.1f}%{} |".format(
+                key[0], key[1], metric, old, value, change, " (regression)" if worse else ""))
+    return nregressions
+
+
+# Drives the comparison of two benchmark runs.
+def compare_main(argv: list) -> int:
+    parser = argparse.ArgumentParser(
+        prog="benchmark.py compare", description="Compares two runs of the benchmarks of the same LibOS.")
+    parser.add_argument("baseline", help="results of the baseline run (JSON file or log)")
+    parser.add_argument("current", help="results of the current run (JSON file or log)")
+    parser.add_argument("--threshold", default=5.0, type=float, required=False,
+                        help="percentage by which a metric may get worse before it is reported as a regression")
+    args: argparse.Namespace = parser.parse_args(argv)
+
+    nregressions: int = compare_results(read_results(args.baseline), read_results(args.current), args.threshold)
+    return 1 if nregressions > 0 else 0
+
+
 # Reads and parses command line arguments.
 def read_args() -> argparse.Namespace:
     description: str = ""
     description += "Use this utility to run the performance regression system of Demikernel on a pair of remote host machines.\n"
     description += "Before using this utility, ensure that you have correctly setup the development environment on the remote machines.\n"
-    description += "For more information, check out the README.md file of the project."
+    description += "For more information, check out the README.md file of the project.\n"
+    description += "Run \"benchmark.py compare BASELINE CURRENT\" to compare the results of two runs."
 
     # Initialize parser.
     parser = argparse.ArgumentParser(
@@ -130,6 +201,9 @@ def read_args() -> argparse.Namespace:
 
 # Drives the program.
 def main():
+    if len(sys.argv) > 1 and sys.argv[1] == "compare":
+        sys.exit(compare_main(sys.argv[2:]))
+
     # Parse and read arguments from command line.
     args: argparse.Namespace = read_args()
 
@@ -93,6 +93,21 @@ class UnitTestCJobOnLinux(UnitTestJobOnLinux):
         return super().execute()
 
 
+class BenchmarkJobOnLinux(BaseLinuxJob):
+    def __init__(self, config: dict):
+        super().__init__(config, "benchmarks")
+
+    # Results are written in JSON to the standard output, which ends up in the log directory.
+    def execute(self) -> bool:
+        server_cmd: str = f"run-benchmarks-c LIBOS={super().libos()} ARGS=\\\"--json -\\\""
+        serverTask: RunOnLinux = RunOnLinux(
+            super().server(), super().repository(), server_cmd, super().is_debug(), super().is_sudo(), super().config_path())
+        return super().execute(serverTask)
+
+    def results_path(self) -> str:
+        return f"{super().log_directory()}/{self.name}-server-{super().server()}.stdout.txt"
+
+
 class EndToEndTestJobOnLinux(BaseLinuxJob):
 
     def __init__(self, config, job_name: str):